@@ -7,6 +7,17 @@ BUILD_DIR="build"
 DEBUG_DIR="debug"
 DEBUG_LOG="${DEBUG_DIR}/debug.log"
 
+# 基准程序（./build.sh bench 时额外生成）
+BENCH_OUTPUT="mikufy_bench"
+BENCH_SRC="src/bench.cpp"
+
+# 构建目标：默认只生成编辑器，bench 额外生成基准程序
+BUILD_TARGET="${1:-all}"
+if [ "${BUILD_TARGET}" != "all" ] && [ "${BUILD_TARGET}" != "bench" ]; then
+    echo "用法: $0 [bench]"
+    exit 1
+fi
+
 # 编译器设置
 CXX="g++"
 CXXFLAGS="-std=c++23 -O2 -Wall -Wextra -Wpedantic -c"
@@ -24,6 +35,29 @@ SRC_FILES=(
     "src/terminal_manager.cpp"
     "src/process_launcher.cpp"
     "src/terminal_window.cpp"
+    "src/thread_pool.cpp"
+    "src/piece_tree.cpp"
+    "src/scrollback.cpp"
+    "src/file_watcher.cpp"
+    "src/mime_cache.cpp"
+    "src/file_cache.cpp"
+    "src/http_parser.cpp"
+    "src/search_engine.cpp"
+    "src/metrics.cpp"
+    "src/logger.cpp"
+    "src/text_buffer_registry.cpp"
+    "src/file_operations.cpp"
+    "src/syntax_tokenizer.cpp"
+    "src/startup_trace.cpp"
+    "src/web_assets.cpp"
+    "src/json_fields.cpp"
+)
+
+# 预压缩的前端资源（生成同目录下的 .gz 和 .br）
+PRECOMPRESS_ASSETS=(
+    "web/app.js"
+    "web/style.css"
+    "web/virtual_editor.js"
 )
 
 # 颜色定义
@@ -41,6 +75,10 @@ get_compile_flags() {
     # 添加libmagic
     LDFLAGS+=" -lmagic"
 
+    # 添加RE2（全文搜索的正则表达式）
+    CXXFLAGS+=" $(pkg-config --cflags re2)"
+    LDFLAGS+=" $(pkg-config --libs re2)"
+
     # 添加nlohmann_json
     if pkg-config --exists nlohmann_json; then
         CXXFLAGS+=" $(pkg-config --cflags nlohmann_json)"
@@ -92,7 +130,7 @@ init_debug_log
 # 清理旧的构建文件
 echo -e "${COLOR_ORANGE}<INFO>${COLOR_RESET} 清理旧的构建产物..."
 rm -rf ${BUILD_DIR}
-rm -f ${OUTPUT_FILE}
+rm -f ${OUTPUT_FILE} ${BENCH_OUTPUT}
 
 # 创建构建目录
 mkdir -p ${BUILD_DIR}
@@ -205,6 +243,42 @@ else
     exit 1
 fi
 
+# 编译基准程序（链接除 main.o 之外的全部目标文件）
+if [ "${BUILD_TARGET}" = "bench" ]; then
+    echo ""
+    echo -e "${COLOR_ORANGE}<INFO>${COLOR_RESET} 正在编译 ${BENCH_OUTPUT}..."
+    BENCH_OBJ="${BUILD_DIR}/bench.o"
+    BENCH_LINK_OBJS=""
+    for obj_file in "${OBJ_FILES[@]}"; do
+        if [ "${obj_file}" != "${BUILD_DIR}/main.o" ]; then
+            BENCH_LINK_OBJS="${BENCH_LINK_OBJS} ${obj_file}"
+        fi
+    done
+
+    echo "编译: ${BENCH_SRC}" >> ${DEBUG_LOG}
+    if ${CXX} ${CXXFLAGS} ${INCLUDE_DIRS} ${BENCH_SRC} -o ${BENCH_OBJ} >> ${DEBUG_LOG} 2>&1 && \
+       ${CXX} ${BENCH_OBJ} ${BENCH_LINK_OBJS} -o ${BENCH_OUTPUT} ${LDFLAGS} >> ${DEBUG_LOG} 2>&1; then
+        chmod +x ${BENCH_OUTPUT}
+        echo -e "${COLOR_GREEN}[OK]${COLOR_RESET} ${BENCH_OUTPUT} 编译成功！"
+        echo -e "${COLOR_ORANGE}<INFO>${COLOR_RESET}   运行: ./${BENCH_OUTPUT} [--quick|--full] --output bench.json"
+    else
+        echo -e "${COLOR_RED}[ERROR]${COLOR_RESET} ${BENCH_OUTPUT} 编译失败！"
+        echo -e "${COLOR_RED}[ERROR]${COLOR_RESET} 详细错误信息已保存到 ${DEBUG_LOG}"
+        exit 1
+    fi
+fi
+
+# 生成前端资源的预压缩版本（Web服务器按Accept-Encoding发送）
+echo ""
+echo -e "${COLOR_ORANGE}<INFO>${COLOR_RESET} 正在生成预压缩的前端资源..."
+for asset in "${PRECOMPRESS_ASSETS[@]}"; do
+    [ -f "${asset}" ] || continue
+    gzip -9 -n -k -f "${asset}" >> ${DEBUG_LOG} 2>&1
+    if command -v brotli > /dev/null 2>&1; then
+        brotli -q 11 -k -f "${asset}" >> ${DEBUG_LOG} 2>&1
+    fi
+done
+
 echo ""
 echo "编译日志已保存到: ${DEBUG_LOG}"
 echo ""
@@ -219,7 +219,8 @@ Build-Depends: debhelper-compat (= 13),
                 libgtk-4-dev,
                 libglib2.0-dev,
                 libmagic-dev,
-                nlohmann-json3-dev
+                nlohmann-json3-dev,
+                libre2-dev
 Standards-Version: 4.6.0
 Homepage: https://github.com/MikuTrive/Mikufy/tree/mikufy-v2.11-nova
 
@@ -248,6 +249,10 @@ EOF
 export CXXFLAGS += $(shell pkg-config --cflags webkitgtk-6.0 gtk4)
 export LDFLAGS += $(shell pkg-config --libs webkitgtk-6.0 gtk4) -lmagic
 
+# 添加 RE2（全文搜索的正则表达式）
+export CXXFLAGS += $(shell pkg-config --cflags re2)
+export LDFLAGS += $(shell pkg-config --libs re2)
+
 # 添加 nlohmann_json 如果可用
 ifeq ($(shell pkg-config --exists nlohmann_json && echo yes),yes)
     export CXXFLAGS += $(shell pkg-config --cflags nlohmann_json)
@@ -270,6 +275,22 @@ override_dh_auto_build:
 	    src/terminal_manager.cpp \
 	    src/process_launcher.cpp \
 	    src/terminal_window.cpp \
+	    src/thread_pool.cpp \
+	    src/piece_tree.cpp \
+	    src/scrollback.cpp \
+	    src/file_watcher.cpp \
+	    src/mime_cache.cpp \
+	    src/file_cache.cpp \
+	    src/http_parser.cpp \
+	    src/search_engine.cpp \
+	    src/metrics.cpp \
+	    src/logger.cpp \
+	    src/text_buffer_registry.cpp \
+	    src/file_operations.cpp \
+	    src/syntax_tokenizer.cpp \
+	    src/startup_trace.cpp \
+	    src/web_assets.cpp \
+	    src/json_fields.cpp \
 	    $(LDFLAGS) \
 	    -o mikufy
 
@@ -0,0 +1,170 @@
+/*
+ * Mikufy v2.11-nova - 文件内容缓存头文件
+ *
+ * 本文件定义了FileCache类，缓存最近读取的文本文件内容。
+ *
+ * 主要功能:
+ * - 按路径哈希分片，每个分片一把锁，并发读取不同文件不互相等待
+ * - 分片内是侵入式LRU：哈希表保存链表迭代器，命中和淘汰都是O(1)
+ * - 内容以共享的只读缓冲区交给调用者，命中时不拷贝
+ * - 每次命中都用(inode, 修改时间, 大小)校验，外部修改后不会返回旧内容
+ * - 按内容、路径和节点开销计算内存占用，所有分片共享一个总上限
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_FILE_CACHE_H
+#define MIKUFY_FILE_CACHE_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <atomic>		/* std::atomic */
+#include <cstddef>		/* size_t */
+#include <cstdint>		/* uint64_t */
+#include <list>			/* std::list LRU链表 */
+#include <memory>		/* std::shared_ptr */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view 哈希表键 */
+#include <unordered_map>	/* std::unordered_map */
+#include <sys/stat.h>		/* struct stat */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 分片数量（2的幂） */
+#define FILE_CACHE_SHARDS		16
+
+/*
+ * ============================================================================
+ * 类型定义
+ * ============================================================================
+ */
+
+/* 共享的只读文件内容，缓存淘汰后持有者仍可继续使用 */
+using FileContent = std::shared_ptr<const std::string>;
+
+/*
+ * ============================================================================
+ * FileCache类定义
+ * ============================================================================
+ */
+
+/**
+ * FileCache - 分片LRU文件内容缓存
+ *
+ * 所有方法都是线程安全的，同一时刻最多持有一个分片的锁。
+ * 淘汰按分片轮流取各自最久未使用的条目，是全局LRU的近似。
+ */
+class FileCache
+{
+public:
+	/**
+	 * FileCache - 构造函数
+	 *
+	 * @capacity: 所有分片合计的内存上限（字节）
+	 */
+	explicit FileCache(size_t capacity);
+
+	/* 禁止拷贝和移动 */
+	FileCache(const FileCache &) = delete;
+	FileCache &operator=(const FileCache &) = delete;
+	FileCache(FileCache &&) = delete;
+	FileCache &operator=(FileCache &&) = delete;
+
+	/**
+	 * get - 查找文件内容
+	 *
+	 * @path: 文件路径
+	 * @st: 文件当前的stat结果，与缓存时不一致则丢弃该条目
+	 *
+	 * 返回值: 命中返回内容，未命中或已过期返回nullptr
+	 */
+	FileContent get(const std::string &path, const struct stat &st);
+
+	/**
+	 * put - 缓存文件内容
+	 *
+	 * 超过上限时淘汰其他条目；单个内容超过上限时不缓存。
+	 *
+	 * @path: 文件路径
+	 * @st: 读取内容时（读取前）的stat结果
+	 * @content: 文件内容
+	 */
+	void put(const std::string &path, const struct stat &st,
+		 FileContent content);
+
+	/**
+	 * invalidate - 丢弃一个文件的缓存
+	 */
+	void invalidate(const std::string &path);
+
+	/**
+	 * invalidate_prefix - 丢弃路径以prefix开头的所有缓存
+	 *
+	 * 需要遍历所有条目，只在目录被删除或重命名时使用。
+	 */
+	void invalidate_prefix(const std::string &prefix);
+
+	/**
+	 * clear - 清空所有缓存
+	 */
+	void clear(void);
+
+	/**
+	 * memory_usage - 当前计入上限的内存（字节）
+	 */
+	size_t memory_usage(void) const;
+
+private:
+	/* 缓存条目，path只保存这一份，哈希表的键指向它 */
+	struct Entry {
+		std::string path;
+		FileContent content;
+		uint64_t ino;		/* 校验用：inode */
+		int64_t mtime_ns;	/* 校验用：修改时间 */
+		uint64_t size;		/* 校验用：文件大小 */
+		size_t charge;		/* 计入上限的字节数 */
+	};
+
+	using EntryList = std::list<Entry>;
+
+	struct Shard {
+		EntryList lru;		/* 表头是最近使用的条目 */
+		std::unordered_map<std::string_view, EntryList::iterator> index;
+		std::mutex mutex;
+	};
+
+	Shard shards[FILE_CACHE_SHARDS];
+	const size_t capacity;			/* 内存上限 */
+	std::atomic<size_t> usage;		/* 所有分片合计的占用 */
+	std::atomic<size_t> evict_cursor;	/* 下一个淘汰的分片 */
+
+	/**
+	 * shard_for - 路径所在的分片
+	 */
+	Shard &shard_for(const std::string &path);
+
+	/**
+	 * erase_locked - 从分片中移除一个条目（调用者持有分片锁）
+	 */
+	void erase_locked(Shard &shard, EntryList::iterator it);
+
+	/**
+	 * evict_over_capacity - 淘汰条目直到占用不超过上限
+	 *
+	 * @keep: 刚插入的内容，不淘汰它
+	 */
+	void evict_over_capacity(const FileContent &keep);
+};
+
+#endif /* MIKUFY_FILE_CACHE_H */
@@ -30,6 +30,8 @@
  */
 
 #include "main.h"		/* 全局定义和数据结构 */
+#include "file_cache.h"		/* FileCache 文件内容缓存 */
+#include "mime_cache.h"		/* MimeCache 文件类型缓存 */
 #include <fstream>		/* std::ifstream, std::ofstream 文件流 */
 #include <sstream>		/* std::stringstream 字符串流 */
 #include <unordered_set>	/* std::unordered_set 哈希集合 */
@@ -75,8 +77,8 @@ public:
 	/**
 	 * FileManager - 构造函数
 	 *
-	 * 初始化FileManager对象，创建libmagic句柄用于文件类型检测。
-	 * 构造函数会调用init_magic()方法来初始化libmagic数据库。
+	 * 初始化FileManager对象。libmagic句柄在第一次需要libmagic
+	 * 检测文件类型时才由init_magic()创建，不在构造函数中加载。
 	 *
 	 * 注意: 如果libmagic初始化失败，后续的文件类型检测功能
 	 *       将不可用，但文件读写操作仍可正常工作。
@@ -119,12 +121,29 @@ public:
 	 *
 	 * 返回值: 成功返回true，失败返回false
 	 *
-	 * 注意: 该方法会限制最多读取1000个条目，防止在大目录中卡死。
-	 *       如果目录内容超过1000项，后续条目将被忽略。
+	 * 注意: 只返回排序后的前 MAX_DIR_ENTRIES 个条目，需要全部条目
+	 *       时使用 list_directory() 分页读取。
 	 */
 	bool get_directory_contents(const std::string &path,
 				    std::vector<FileInfo> &files);
 
+	/**
+	 * list_directory - 分页读取目录内容
+	 *
+	 * 用大缓冲区的 getdents64() 一次读出所有名称，在服务器端排序，
+	 * 只对本页的条目调用 statx() 获取大小。第一页的耗时只取决于
+	 * 目录条目数的读取和排序，与每个条目的stat无关。
+	 *
+	 * @path: 目录路径
+	 * @cursor: 上一页返回的游标，空表示第一页
+	 * @limit: 本页最多的条目数（1 ~ MAX_DIR_PAGE_SIZE）
+	 * @page: 输出参数，本页内容
+	 *
+	 * 返回值: 成功返回true，目录无法打开或游标无效返回false
+	 */
+	bool list_directory(const std::string &path, const std::string &cursor,
+			    size_t limit, DirectoryPage &page);
+
 	/* ====================================================================
 	 * 公共方法 - 文件读取
 	 * ==================================================================== */
@@ -146,6 +165,19 @@ public:
 	 */
 	bool read_file(const std::string &path, std::string &content);
 
+	/**
+	 * read_file - 读取文本文件内容（共享缓冲区）
+	 *
+	 * 与上面的版本相同，但直接返回缓存中的只读缓冲区，缓存命中时
+	 * 不拷贝文件内容。缓冲区在条目被淘汰后仍然有效。
+	 *
+	 * @path: 要读取的文件路径
+	 * @content: 输出参数，文件内容
+	 *
+	 * 返回值: 成功返回true，失败返回false
+	 */
+	bool read_file(const std::string &path, FileContent &content);
+
 	/**
 	 * read_file_binary - 读取二进制文件内容
 	 *
@@ -242,14 +274,16 @@ public:
 	 * delete_directory_recursive - 递归删除目录
 	 *
 	 * 递归删除指定目录及其所有子目录和文件。该方法会先删除
-	 * 目录中的所有内容，最后删除目录本身。
+	 * 目录中的所有内容，最后删除目录本身。所有操作相对于目录fd
+	 * （openat()/unlinkat()），不跟随符号链接。
 	 *
 	 * @path: 要删除的目录路径
 	 *
 	 * 返回值: 成功返回true，失败返回false
 	 *
 	 * 注意: 这是一个危险操作，删除的内容无法恢复。
-	 *       该方法仅供delete_item()内部调用。
+	 *       该方法仅供delete_item()内部调用，在调用线程中顺序
+	 *       执行；大目录树请用 FileOperationJob 在后台并行删除。
 	 */
 	bool delete_directory_recursive(const std::string &path);
 
@@ -351,28 +385,27 @@ public:
 	 *
 	 * 根据文件的MIME类型判断是否为二进制文件。常见的文本类型
 	 * （如text/ *、application/json等）将被识别为文本文件。
+	 * 判定结果来自classify_file()，同一文件未修改时不再检测。
 	 *
 	 * @path: 文件路径
 	 *
 	 * 返回值: 是二进制文件返回true，是文本文件返回false
 	 *
-	 * 注意: 该方法依赖于libmagic库的正确初始化。
-	 *       空文件被认为是文本文件。
+	 * 注意: 空文件被认为是文本文件。
 	 */
 	bool is_binary_file(const std::string &path);
 
 	/**
 	 * get_mime_type - 获取文件MIME类型
 	 *
-	 * 使用libmagic库检测文件的MIME类型。MIME类型用于标识
-	 * 文件的类型和格式。
+	 * 检测文件的MIME类型。MIME类型用于标识文件的类型和格式。
+	 * 判定结果来自classify_file()，同一文件未修改时不再检测。
 	 *
 	 * @path: 文件路径
 	 *
 	 * 返回值: MIME类型字符串，失败返回"application/octet-stream"
 	 *
-	 * 注意: 该方法依赖于libmagic库的正确初始化。
-	 *       对于未知类型，返回默认的octet-stream类型。
+	 * 注意: 对于未知类型，返回默认的octet-stream类型。
 	 */
 	std::string get_mime_type(const std::string &path);
 
@@ -430,27 +463,35 @@ public:
 	 */
 	std::string get_file_extension(const std::string &filename);
 
+	/* ====================================================================
+	 * 公共方法 - 缓存失效
+	 * ==================================================================== */
+
+	/**
+	 * invalidate_path - 使路径及其下所有文件的缓存失效
+	 *
+	 * 文件系统监视器发现外部修改时调用，下次读取将重新从磁盘加载。
+	 *
+	 * @path: 文件或目录路径
+	 */
+	void invalidate_path(const std::string &path);
+
 private:
 	/* ====================================================================
 	 * 私有成员变量
 	 * ==================================================================== */
 
 	magic_t magic_cookie;	/* libmagic句柄，用于文件类型检测 */
+	bool magic_initialized;	/* 是否已尝试初始化libmagic */
+	std::mutex magic_mutex;	/* 保护magic_cookie，libmagic句柄不是线程安全的 */
 	std::mutex mutex;	/* 互斥锁，保证线程安全 */
+	MimeCache mime_cache;	/* 文件类型判定缓存，退出时持久化 */
 
 	/*
-	 * 文件内容缓存相关
-	 * 使用LRU（最近最少使用）缓存策略，提升重复读取同一文件的性能
+	 * 文件内容缓存
+	 * 分片LRU，自带锁，读取文件不需要持有mutex
 	 */
-	struct FileCacheEntry {
-		std::string content;		/* 文件内容 */
-		std::chrono::system_clock::time_point timestamp;	/* 缓存时间戳 */
-		size_t size;			/* 文件大小（字节） */
-	};
-
-	std::unordered_map<std::string, FileCacheEntry> file_cache;	/* 文件缓存哈希表 */
-	std::list<std::string> file_cache_lru;	/* LRU链表，记录访问顺序 */
-	size_t cache_size;		/* 当前缓存大小（字节） */
+	FileCache file_cache;
 
 	/* ====================================================================
 	 * 私有方法 - libmagic管理
@@ -459,12 +500,12 @@ private:
 	/**
 	 * init_magic - 初始化libmagic库
 	 *
-	 * 打开libmagic数据库并加载默认的magic文件。该方法在
-	 * 构造函数中调用，用于初始化文件类型检测功能。
+	 * 打开libmagic数据库并加载默认的magic文件。第一次需要
+	 * libmagic时调用，之后直接返回上次的结果。
 	 *
-	 * 返回值: 成功返回true，失败返回false
+	 * 返回值: libmagic可用返回true，否则返回false
 	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
+	 * 注意: 该方法需要持有magic_mutex才能调用。
 	 */
 	bool init_magic(void);
 
@@ -473,75 +514,50 @@ private:
 	 *
 	 * 关闭libmagic句柄并释放相关资源。该方法在析构函数中调用。
 	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
+	 * 注意: 该方法自己获取magic_mutex。
 	 */
 	void cleanup_magic(void);
 
 	/* ====================================================================
-	 * 私有方法 - 缓存管理
+	 * 私有方法 - 文件类型判定
 	 * ==================================================================== */
 
 	/**
-	 * get_cached_file - 从缓存中获取文件内容
+	 * classify_file - 判定文件的MIME类型和是否为二进制
 	 *
-	 * 尝试从缓存中获取指定路径的文件内容。
-	 * 如果缓存命中，更新LRU链表，将文件移到链表头部。
+	 * 先查mime_cache；未命中时由sniff_file()读取文件头快速判定，
+	 * 只有文件头无法判定时才调用libmagic。普通文件的结果存入缓存。
 	 *
 	 * @path: 文件路径
-	 * @content: 输出参数，存储缓存的内容
-	 *
-	 * 返回值: 缓存命中返回true，未命中返回false
-	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
-	 */
-	bool get_cached_file(const std::string &path, std::string &content);
-
-	/**
-	 * cache_file - 将文件内容缓存
-	 *
-	 * 将文件内容添加到缓存中。
-	 * 如果缓存已满，按照LRU策略淘汰最久未使用的文件。
-	 *
-	 * @path: 文件路径
-	 * @content: 文件内容
-	 * @size: 文件大小（字节）
-	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
-	 */
-	void cache_file(const std::string &path, const std::string &content,
-			size_t size);
-
-	/**
-	 * evict_cache - 淘汰缓存条目
-	 *
-	 * 按照LRU策略淘汰最久未使用的缓存条目，直到缓存大小低于限制。
+	 * @info: 输出参数，判定结果
 	 *
-	 * @required_size: 需要释放的空间大小（字节）
+	 * 返回值: 文件存在返回true
 	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
+	 * 注意: 该方法不获取mutex，调用者可能已经持有锁。
 	 */
-	void evict_cache(size_t required_size);
+	bool classify_file(const std::string &path, MimeInfo &info);
 
 	/**
-	 * invalidate_cache - 使指定文件的缓存失效
+	 * sniff_file - 根据文件头和扩展名快速判定
 	 *
-	 * 使指定文件的缓存失效，下次读取时将重新从磁盘加载。
-	 * 在文件被修改后应调用此方法。
+	 * 读取前MIME_SNIFF_SIZE字节：带常见格式签名的是对应的二进制
+	 * 类型；不含NUL且是合法UTF-8的是文本，MIME类型按扩展名给出。
 	 *
 	 * @path: 文件路径
+	 * @info: 输出参数，判定结果
 	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
+	 * 返回值: 能够判定返回true，需要交给libmagic返回false
 	 */
-	void invalidate_cache(const std::string &path);
+	static bool sniff_file(const std::string &path, MimeInfo &info);
 
 	/**
-	 * clear_cache - 清空所有缓存
+	 * is_binary_mime - 判断MIME类型是否表示二进制文件
 	 *
-	 * 清空所有文件缓存，释放内存。
+	 * @mime_type: MIME类型字符串
 	 *
-	 * 注意: 该方法需要持有互斥锁才能调用。
+	 * 返回值: 二进制类型返回true
 	 */
-	void clear_cache(void);
+	static bool is_binary_mime(const std::string &mime_type);
 };
 
 #endif /* MIKUFY_FILE_MANAGER_H */
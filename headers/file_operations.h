@@ -0,0 +1,285 @@
+/*
+ * Mikufy v2.11-nova - 批量文件操作头文件
+ *
+ * 本文件定义了FileOperationJob类，在后台线程池中执行删除、复制和
+ * 移动整个目录树的任务。
+ *
+ * 主要功能:
+ * - 所有系统调用都相对于已打开的目录fd（openat()、unlinkat()、
+ *   fstatat()、mkdirat()），不拼接完整路径，也不重复解析路径
+ * - 目录树的各个子树由多个工作任务并行处理，目录在其所有子项
+ *   完成后才删除（或设置权限）
+ * - 不跟随符号链接：删除只删除链接本身，复制时复制链接
+ * - 可以随时取消，进度按时间间隔回调
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_FILE_OPERATIONS_H
+#define MIKUFY_FILE_OPERATIONS_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include "thread_pool.h"	/* ThreadPool并行执行 */
+#include <atomic>		/* std::atomic 取消标志、进度计数 */
+#include <chrono>		/* std::chrono::steady_clock 耗时统计 */
+#include <condition_variable>	/* std::condition_variable */
+#include <cstdint>		/* uint64_t */
+#include <deque>		/* std::deque 待处理的条目 */
+#include <expected>		/* std::expected 参数错误 */
+#include <functional>		/* std::function */
+#include <memory>		/* std::shared_ptr, std::enable_shared_from_this */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 批量文件操作的最大并行线程数（实际数量取min(CPU核心数, 此值)） */
+#define FILE_OPERATION_MAX_THREADS	4
+
+/* 两次进度回调之间的最短间隔（毫秒） */
+#define FILE_OPERATION_REPORT_INTERVAL	100
+
+/* 复制文件时每次copy_file_range()的字节数（两次之间检查取消） */
+#define FILE_OPERATION_COPY_CHUNK	(8 * 1024 * 1024)
+
+/* 保留的已结束任务数（供查询状态） */
+#define FILE_OPERATION_KEEP_FINISHED	16
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * FileOperationKind - 操作类型
+ */
+enum class FileOperationKind {
+	DELETE,			/* 删除 */
+	COPY,			/* 复制到目标目录 */
+	MOVE			/* 移动到目标目录 */
+};
+
+/**
+ * FileOperationState - 任务状态
+ */
+enum class FileOperationState {
+	RUNNING,		/* 进行中（包括排队等待线程） */
+	DONE,			/* 全部成功 */
+	FAILED,			/* 结束，部分条目失败 */
+	CANCELLED		/* 已取消（已处理的条目不恢复） */
+};
+
+/**
+ * FileOperationProgress - 任务进度
+ */
+struct FileOperationProgress {
+	uint64_t id;			/* 任务ID */
+	FileOperationKind kind;		/* 操作类型 */
+	FileOperationState state;	/* 任务状态 */
+	uint64_t found;			/* 已发现的条目数（目录树边处理边遍历） */
+	uint64_t done;			/* 已处理的条目数 */
+	uint64_t bytes;			/* 已复制的字节数 */
+	uint64_t errors;		/* 失败的条目数 */
+	std::string first_error;	/* 第一个错误（"路径: 原因"） */
+	uint64_t elapsed_ms;		/* 已用时间 */
+};
+
+/*
+ * ============================================================================
+ * FileOperationJob类定义
+ * ============================================================================
+ */
+
+/**
+ * FileOperationJob - 一次批量文件操作
+ *
+ * start()把若干个工作任务提交到线程池：每个任务从共享的队列中取出
+ * 目录（读取目录项，子目录和需要复制的文件放回队列）或文件。每个
+ * 正在处理的目录记录未完成的子项数，最后一个子项完成时删除该目录
+ * （复制时设置目标目录的权限），再通知它的父目录。
+ *
+ * 移动先对每个源执行renameat2(RENAME_NOREPLACE)，跨文件系统的源
+ * 先复制，全部复制成功后再删除。目标已存在的条目报告为失败，不会
+ * 覆盖。
+ *
+ * 线程池中的任务按提交顺序执行，同时提交的多个操作依次进行。
+ * 必须由std::shared_ptr持有，工作任务持有引用直到退出。所有方法
+ * 都是线程安全的。
+ */
+class FileOperationJob : public std::enable_shared_from_this<FileOperationJob>
+{
+public:
+	/* 进度回调（在工作线程中调用），结束时一定会调用一次 */
+	using ProgressCallback =
+		std::function<void(const FileOperationProgress &)>;
+
+	/**
+	 * FileOperationJob - 构造函数
+	 *
+	 * @id: 任务ID
+	 * @kind: 操作类型
+	 * @sources: 要处理的文件或目录（绝对路径）
+	 * @destination: 复制或移动的目标目录（删除时忽略）
+	 */
+	FileOperationJob(uint64_t id, FileOperationKind kind,
+			 std::vector<std::string> sources,
+			 std::string destination);
+
+	/* 禁止拷贝和移动 */
+	FileOperationJob(const FileOperationJob &) = delete;
+	FileOperationJob &operator=(const FileOperationJob &) = delete;
+
+	/**
+	 * start - 检查参数并开始执行
+	 *
+	 * @pool: 执行操作的线程池
+	 * @callback: 进度回调
+	 *
+	 * 返回值: 成功提交返回空值，参数错误或线程池未运行时返回
+	 *         错误信息（此时不会调用回调）
+	 */
+	std::expected<void, std::string> start(ThreadPool &pool,
+					       ProgressCallback callback);
+
+	/**
+	 * cancel - 取消操作
+	 *
+	 * 工作任务处理完当前条目（复制大文件时为当前块）后退出。
+	 */
+	void cancel(void);
+
+	/**
+	 * progress - 获取当前进度
+	 */
+	FileOperationProgress progress(void) const;
+
+	/**
+	 * finished - 操作是否已结束
+	 */
+	bool finished(void) const { return done_flag; }
+
+	/**
+	 * id - 任务ID
+	 */
+	uint64_t id(void) const { return job_id; }
+
+private:
+	struct DirNode;
+
+	/* 待处理的条目：父目录中名为name的文件或目录 */
+	struct WorkItem {
+		std::shared_ptr<DirNode> parent;
+		std::string name;
+		unsigned char type;	/* DT_DIR、DT_REG、DT_LNK等 */
+	};
+
+	/* 一个阶段：对一组源执行删除或复制 */
+	struct Phase {
+		FileOperationKind kind;	/* DELETE 或 COPY */
+		std::vector<std::string> sources;
+	};
+
+	const uint64_t job_id;
+	const FileOperationKind kind;
+	const std::vector<std::string> sources;
+	const std::string destination;
+	const std::chrono::steady_clock::time_point started;
+	ProgressCallback callback;
+
+	std::mutex queue_mutex;		/* 保护以下成员 */
+	std::condition_variable queue_cond; /* 有新工作或全部完成 */
+	std::deque<WorkItem> queue;
+	size_t active;			/* 正在处理条目的任务数 */
+	size_t workers;			/* 尚未退出的工作任务数 */
+	std::vector<Phase> phases;	/* 依次执行的阶段 */
+	size_t phase_index;		/* 下一个要开始的阶段 */
+	FileOperationKind phase_kind;	/* 当前阶段的操作 */
+
+	mutable std::mutex error_mutex;	/* 保护first_error */
+	std::string first_error;
+
+	std::atomic<bool> cancelled;
+	std::atomic<bool> done_flag;
+	std::atomic<FileOperationState> state;
+	std::atomic<uint64_t> found;
+	std::atomic<uint64_t> done;
+	std::atomic<uint64_t> bytes;
+	std::atomic<uint64_t> errors;
+	std::atomic<int64_t> last_report_ms; /* 上次回调时的耗时 */
+	std::atomic<int64_t> finished_ms; /* 结束时的耗时 */
+
+	/**
+	 * elapsed_ms - 开始以来的毫秒数
+	 */
+	int64_t elapsed_ms(void) const;
+
+	/**
+	 * worker - 工作任务主循环
+	 */
+	void worker(void);
+
+	/**
+	 * finish_worker - 一个工作任务退出，最后一个报告结束
+	 */
+	void finish_worker(void);
+
+	/**
+	 * begin_phase_locked - 开始下一个阶段（调用者持有queue_mutex）
+	 *
+	 * 返回值: 放入了新的条目返回true，没有更多阶段返回false
+	 */
+	bool begin_phase_locked(void);
+
+	/**
+	 * process_directory - 处理一个目录：打开、读取目录项、分发子项
+	 *
+	 * @dents: 工作任务复用的getdents64()缓冲区
+	 */
+	void process_directory(WorkItem &item, std::vector<char> &dents);
+
+	/**
+	 * process_entry - 删除或复制一个非目录条目
+	 */
+	void process_entry(const DirNode &parent, const char *name,
+			   unsigned char type);
+
+	/**
+	 * copy_file - 复制一个常规文件
+	 */
+	void copy_file(const DirNode &parent, const char *name);
+
+	/**
+	 * finish_child - 一个子项完成，最后一个子项完成时结束该目录
+	 */
+	void finish_child(std::shared_ptr<DirNode> node);
+
+	/**
+	 * push_items - 把一批条目放入队列
+	 */
+	void push_items(std::vector<WorkItem> &items);
+
+	/**
+	 * record_error - 记录一个条目失败
+	 */
+	void record_error(const DirNode *parent, const char *name, int err);
+
+	/**
+	 * item_done - 一个条目处理完成，按间隔回调进度
+	 */
+	void item_done(void);
+};
+
+#endif /* MIKUFY_FILE_OPERATIONS_H */
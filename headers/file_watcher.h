@@ -0,0 +1,211 @@
+/*
+ * Mikufy v2.11-nova - 文件系统监视器头文件
+ *
+ * 本文件定义了FileWatcher类的接口，使用inotify监视前端已展开的
+ * 目录，把目录内的变化整理成增量（新增、删除、重命名、修改）通知
+ * 给Web服务器推送，同时使FileManager中相关文件的缓存失效。
+ *
+ * 主要功能:
+ * - 只监视前端请求的目录（不递归），数量有上限
+ * - 独立线程读取inotify事件，短时间内的事件合并为一批
+ * - 同一批内按cookie配对IN_MOVED_FROM/IN_MOVED_TO得到重命名
+ * - 单个目录一批内变化过多（如git checkout）时只通知重新加载该目录
+ * - inotify队列溢出时通知重新加载所有监视的目录
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_FILE_WATCHER_H
+#define MIKUFY_FILE_WATCHER_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include "file_manager.h"	/* FileManager缓存失效 */
+#include <chrono>		/* std::chrono::steady_clock */
+#include <cstdint>		/* uint32_t */
+#include <functional>		/* std::function */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <thread>		/* std::jthread */
+#include <unordered_map>	/* std::unordered_map */
+#include <vector>		/* std::vector */
+#include <sys/inotify.h>	/* inotify_init1(), inotify_add_watch() */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 一批中第一个事件到达后等待这么久（毫秒）再发送，把一连串变化合并为一批 */
+#define FILE_WATCH_COALESCE_MS		50
+
+/* 单个目录一批内的增量超过此数时改为通知重新加载该目录 */
+#define FILE_WATCH_MAX_DELTAS		256
+
+/* 最多同时监视的目录数 */
+#define FILE_WATCH_MAX_DIRS		64
+
+/* 监视的事件：目录项变化、文件写入完成/属性改变、目录自身被删除或移走 */
+#define FILE_WATCH_EVENTS	(IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+				 IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | \
+				 IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | \
+				 IN_EXCL_UNLINK)
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * FileDelta - 目录内的一项变化
+ */
+struct FileDelta {
+	enum class Kind {
+		ADD,		/* 新建或移入 */
+		REMOVE,		/* 删除或移出 */
+		RENAME,		/* 在监视的目录之间重命名 */
+		MODIFY,		/* 内容或属性改变 */
+		RESCAN		/* 变化过多或事件丢失，需要重新加载目录 */
+	};
+
+	Kind kind;
+	std::string directory;		/* 变化所在的目录 */
+	std::string path;		/* 变化后的路径（RESCAN时为空） */
+	std::string old_directory;	/* RENAME时原来所在的目录 */
+	std::string old_path;		/* RENAME时原来的路径 */
+	bool is_directory;		/* 是否是目录 */
+	bool is_hidden;			/* 名称以.开头（目录列表不显示） */
+	size_t size;			/* ADD/MODIFY/RENAME时的文件大小 */
+
+	FileDelta() : kind(Kind::MODIFY), is_directory(false),
+		      is_hidden(false), size(0) {}
+};
+
+/*
+ * ============================================================================
+ * FileWatcher类定义
+ * ============================================================================
+ */
+
+/**
+ * FileWatcher - 基于inotify的目录监视器
+ *
+ * watch_directories()可以在任意线程调用；增量回调在监视线程中
+ * 调用，回调中应只做序列化和通知。
+ */
+class FileWatcher
+{
+public:
+	/* 增量回调类型，每批变化调用一次 */
+	using DeltaCallback = std::function<void(const std::vector<FileDelta> &)>;
+
+	/**
+	 * FileWatcher - 构造函数
+	 *
+	 * @file_manager: 收到变化时使其缓存失效的文件管理器，可以为nullptr
+	 */
+	explicit FileWatcher(FileManager *file_manager);
+
+	/**
+	 * ~FileWatcher - 析构函数
+	 *
+	 * 调用stop()停止监视线程并关闭inotify实例。
+	 */
+	~FileWatcher(void);
+
+	/* 禁止拷贝和移动 */
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+	FileWatcher(FileWatcher &&) = delete;
+	FileWatcher &operator=(FileWatcher &&) = delete;
+
+	/**
+	 * start - 创建inotify实例并启动监视线程
+	 *
+	 * @callback: 增量回调
+	 *
+	 * 返回值: 成功返回true，inotify不可用或已在运行返回false
+	 */
+	bool start(DeltaCallback callback);
+
+	/**
+	 * stop - 停止监视线程，移除所有监视
+	 */
+	void stop(void);
+
+	/**
+	 * is_running - 检查监视线程是否在运行
+	 */
+	bool is_running(void) const;
+
+	/**
+	 * watch_directories - 设置要监视的目录
+	 *
+	 * 替换当前的监视集合：不在列表中的目录停止监视，新目录开始监视。
+	 * 超过FILE_WATCH_MAX_DIRS的部分被忽略。
+	 *
+	 * @directories: 目录路径列表
+	 *
+	 * 返回值: 实际在监视的目录
+	 */
+	std::vector<std::string> watch_directories(
+			const std::vector<std::string> &directories);
+
+private:
+	FileManager *file_manager;	/* 缓存失效的目标 */
+	DeltaCallback callback;		/* 增量回调 */
+	int inotify_fd;			/* inotify实例 */
+	int wake_fd;			/* 唤醒监视线程的eventfd（停止时写入） */
+	std::jthread thread;		/* 监视线程 */
+
+	/* 监视描述符和目录的对应关系，受mutex保护 */
+	std::unordered_map<int, std::string> wd_paths;
+	std::unordered_map<std::string, int> path_wds;
+	mutable std::mutex mutex;
+
+	/* 以下成员只在监视线程中访问 */
+	std::vector<FileDelta> pending;			/* 当前批次的增量 */
+	std::unordered_map<uint32_t, size_t> moves;	/* 未配对的IN_MOVED_FROM */
+	bool overflowed;				/* 当前批次中队列溢出过 */
+	std::chrono::steady_clock::time_point batch_deadline; /* 当前批次的发送时间 */
+
+	/**
+	 * thread_func - 监视线程主循环
+	 */
+	void thread_func(std::stop_token token);
+
+	/**
+	 * read_events - 读取并解析inotify中所有可读的事件
+	 */
+	void read_events(void);
+
+	/**
+	 * handle_event - 把一个inotify事件转换为增量
+	 */
+	void handle_event(const struct inotify_event &event);
+
+	/**
+	 * add_delta - 把一项变化加入当前批次，合并相邻的重复修改
+	 */
+	void add_delta(FileDelta delta);
+
+	/**
+	 * flush_pending - 使缓存失效并把当前批次交给回调
+	 */
+	void flush_pending(void);
+
+	/**
+	 * remove_watch_locked - 移除一个目录的监视（调用者持有锁）
+	 */
+	void remove_watch_locked(const std::string &directory);
+};
+
+#endif /* MIKUFY_FILE_WATCHER_H */
@@ -0,0 +1,259 @@
+/*
+ * Mikufy v2.11-nova - HTTP请求解析器头文件
+ *
+ * 本文件定义了HttpRequestParser类，在数据到达时增量解析HTTP/1.1
+ * 请求，供WebServer的事件循环使用。
+ *
+ * 主要功能:
+ * - 请求头只扫描一次：每次只在新到达的数据中查找头部结束标记
+ * - 按Content-Length预留接收缓冲区，请求体收齐后直接移交，不再拷贝
+ * - 支持Transfer-Encoding: chunked
+ * - 请求体可以交给回调逐段处理（上传直接写入文件），不在内存中累积
+ * - 请求行、请求头和解码后的查询参数放在每个请求一块的缓冲区中，
+ *   各字段是指向其中的string_view，解析一个请求只分配一次内存
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_HTTP_PARSER_H
+#define MIKUFY_HTTP_PARSER_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstddef>		/* size_t */
+#include <cstdint>		/* uint64_t */
+#include <functional>		/* std::function */
+#include <memory>		/* std::unique_ptr 请求缓冲区 */
+#include <span>			/* std::span */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * HttpField - 一个请求头或查询参数
+ */
+struct HttpField {
+	std::string_view name;
+	std::string_view value;
+};
+
+/**
+ * HttpHeaders - 请求头（按出现顺序）
+ */
+class HttpHeaders
+{
+public:
+	HttpHeaders(void) = default;
+	explicit HttpHeaders(std::span<const HttpField> fields) : fields(fields) {}
+
+	/**
+	 * find - 按名称（不区分大小写）查找请求头
+	 *
+	 * 同名的请求头取最后一个。
+	 *
+	 * 返回值: 请求头的值，不存在时返回nullptr
+	 */
+	const std::string_view *find(std::string_view name) const;
+
+	auto begin(void) const { return fields.begin(); }
+	auto end(void) const { return fields.end(); }
+	size_t size(void) const { return fields.size(); }
+
+private:
+	std::span<const HttpField> fields;
+};
+
+/**
+ * HttpQuery - URL解码后的查询参数（按出现顺序）
+ */
+class HttpQuery
+{
+public:
+	HttpQuery(void) = default;
+	explicit HttpQuery(std::span<const HttpField> fields) : fields(fields) {}
+
+	/**
+	 * find - 查找查询参数（区分大小写）
+	 *
+	 * 同名的参数取最后一个。
+	 *
+	 * 返回值: 参数的值，不存在时返回nullptr
+	 */
+	const std::string_view *find(std::string_view name) const;
+
+	/**
+	 * get - 查询参数的值，不存在时返回空字符串
+	 */
+	std::string_view get(std::string_view name) const
+	{
+		const std::string_view *value = find(name);
+		return value ? *value : std::string_view();
+	}
+
+	auto begin(void) const { return fields.begin(); }
+	auto end(void) const { return fields.end(); }
+	size_t size(void) const { return fields.size(); }
+
+private:
+	std::span<const HttpField> fields;
+};
+
+/**
+ * HttpRequest - 解析后的HTTP请求
+ *
+ * method、path、headers和query指向arena，随请求一起移动，可以
+ * 交给工作线程；不能拷贝。
+ */
+struct HttpRequest {
+	std::string_view method;	/* 请求方法 */
+	std::string_view path;		/* 请求目标（含查询字符串） */
+	HttpHeaders headers;		/* 请求头 */
+	HttpQuery query;		/* 查询参数 */
+	std::string body;		/* 请求体（交给回调处理时为空） */
+	uint64_t content_length;	/* 请求体字节数（分块传输时请求完整后才有效） */
+	bool chunked;			/* Transfer-Encoding: chunked */
+	bool keep_alive;		/* 响应后是否保持连接 */
+	bool expect_continue;		/* 客户端等待"100 Continue" */
+
+	/* 字段数组、请求头原文和解码后的查询参数 */
+	std::unique_ptr<std::byte[]> arena;
+
+	HttpRequest()
+		: content_length(0), chunked(false), keep_alive(false),
+		  expect_continue(false) {}
+
+	/* 不含查询字符串的路径 */
+	std::string_view route_path(void) const
+	{
+		return path.substr(0, path.find('?'));
+	}
+};
+
+/**
+ * HttpParseStatus - parse()的结果
+ */
+enum class HttpParseStatus {
+	INCOMPLETE,		/* 需要更多数据 */
+	HEADERS_COMPLETE,	/* 请求头已解析，可以设置请求体回调 */
+	COMPLETE,		/* 请求完整 */
+	ERROR			/* 非法请求，见error_status() */
+};
+
+/*
+ * ============================================================================
+ * HttpRequestParser类定义
+ * ============================================================================
+ */
+
+/**
+ * HttpRequestParser - 增量HTTP请求解析器
+ *
+ * 每个连接一个实例，由事件循环线程独占访问。parse()消耗缓冲区
+ * 开头属于当前请求的数据，之后的数据（流水线请求）留在缓冲区中；
+ * 取走请求后调用reset()开始解析下一个请求。
+ */
+class HttpRequestParser
+{
+public:
+	/* 请求体回调：每段解码后的数据调用一次 */
+	using BodySink = std::function<void(const char *data, size_t length)>;
+
+	/**
+	 * HttpRequestParser - 构造函数
+	 *
+	 * @max_header_size: 请求头的最大长度，超过返回400
+	 * @max_body_size: 缓存在内存中的请求体的最大长度，超过返回413
+	 *                 （设置了请求体回调时不受限制）
+	 */
+	HttpRequestParser(size_t max_header_size, uint64_t max_body_size);
+
+	/**
+	 * parse - 解析缓冲区中的数据
+	 *
+	 * @buffer: 接收缓冲区，已解析的数据会被移除
+	 *
+	 * 请求头解析完成时返回一次HEADERS_COMPLETE，调用者可以在此时
+	 * 检查请求并设置请求体回调，然后再次调用parse()。
+	 *
+	 * 返回值: 解析状态
+	 */
+	HttpParseStatus parse(std::string &buffer);
+
+	/**
+	 * set_body_sink - 把请求体交给回调而不是缓存在内存中
+	 *
+	 * 只能在parse()返回HEADERS_COMPLETE之后调用。
+	 */
+	void set_body_sink(BodySink sink);
+
+	/**
+	 * request - 当前请求（请求头解析完成后有效）
+	 */
+	HttpRequest &request(void) { return current; }
+
+	/**
+	 * error_status - 返回ERROR时应答的HTTP状态码
+	 */
+	int error_status(void) const { return error; }
+
+	/**
+	 * reset - 丢弃当前请求，准备解析下一个请求
+	 */
+	void reset(void);
+
+private:
+	/* 解析阶段 */
+	enum class State {
+		HEADERS,	/* 等待请求头 */
+		BODY,		/* 按Content-Length接收请求体 */
+		CHUNK_SIZE,	/* 等待分块大小行 */
+		CHUNK_DATA,	/* 接收分块数据 */
+		CHUNK_END,	/* 等待分块数据后的CRLF */
+		TRAILERS,	/* 等待尾部字段结束 */
+		DONE		/* 请求完整 */
+	};
+
+	const size_t max_header_size;
+	const uint64_t max_body_size;
+	State state;
+	size_t scan_offset;		/* 下次查找头部结束标记的位置 */
+	uint64_t remaining;		/* 当前分块或请求体剩余的字节数 */
+	uint64_t received;		/* 已接收的请求体字节数 */
+	int error;			/* 出错时的HTTP状态码 */
+	HttpRequest current;
+	BodySink sink;
+
+	/**
+	 * parse_head - 解析请求行和请求头
+	 *
+	 * @head: 不含结束空行的请求头
+	 *
+	 * 返回值: 成功返回true，失败时设置error
+	 */
+	bool parse_head(std::string_view head);
+
+	/**
+	 * deliver - 把请求体数据交给回调或追加到请求体
+	 *
+	 * 返回值: 未超过请求体上限返回true
+	 */
+	bool deliver(const char *data, size_t length);
+
+	/**
+	 * fail - 进入错误状态
+	 */
+	HttpParseStatus fail(int status);
+};
+
+#endif /* MIKUFY_HTTP_PARSER_H */
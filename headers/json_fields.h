@@ -0,0 +1,119 @@
+/*
+ * Mikufy v2.11-nova - JSON字段提取头文件
+ *
+ * 本文件定义了JsonFields类，用SAX方式从JSON请求体中直接取出顶层
+ * 字段，不建立json文档树。用于调用频繁、字段固定的接口（取行、
+ * 插入文本、读取终端输出）。
+ *
+ * 主要功能:
+ * - 只取事先绑定的顶层字段，写入调用者的变量；其他字段和嵌套的
+ *   对象、数组跳过，不保存
+ * - 字符串直接移动到目标变量，数字不经过中间的json对象
+ * - 缺少必需字段或类型不符时给出错误信息
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_JSON_FIELDS_H
+#define MIKUFY_JSON_FIELDS_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstddef>		/* size_t */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 一次最多绑定的字段数 */
+#define JSON_FIELDS_MAX		8
+
+/*
+ * ============================================================================
+ * JsonFields类定义
+ * ============================================================================
+ */
+
+/**
+ * JsonFields - 顶层JSON字段的提取器
+ *
+ * 用法：为每个字段调用一次bind()，然后调用parse()。绑定的变量在
+ * parse()返回前必须有效。
+ */
+class JsonFields
+{
+public:
+	JsonFields(void) : count(0) {}
+
+	/* 禁止拷贝（保存的是变量地址） */
+	JsonFields(const JsonFields &) = delete;
+	JsonFields &operator=(const JsonFields &) = delete;
+
+	/**
+	 * bind - 绑定一个字段
+	 *
+	 * @key: 字段名
+	 * @target: 字段值写入的变量
+	 * @required: 为false时字段可以缺少或为null，变量保持原值
+	 *
+	 * 整数字段也接受值为整数的浮点数；无符号字段不接受负数。
+	 */
+	void bind(std::string_view key, std::string &target, bool required = true);
+	void bind(std::string_view key, size_t &target, bool required = true);
+	void bind(std::string_view key, int &target, bool required = true);
+	void bind(std::string_view key, bool &target, bool required = true);
+
+	/**
+	 * parse - 解析JSON文本并填充绑定的变量
+	 *
+	 * @text: JSON文本，顶层必须是对象
+	 *
+	 * 返回: 成功返回true；失败时error()给出原因
+	 */
+	bool parse(std::string_view text);
+
+	/**
+	 * error - 最近一次parse()失败的原因
+	 */
+	const std::string &error(void) const { return message; }
+
+private:
+	/* 字段类型 */
+	enum class Kind {
+		STRING,
+		SIZE,
+		INT,
+		BOOL
+	};
+
+	struct Field {
+		std::string_view key;
+		Kind kind;
+		void *target;
+		bool required;
+		bool seen;
+	};
+
+	Field fields[JSON_FIELDS_MAX];
+	size_t count;
+	std::string message;
+
+	friend class JsonFieldsSax;
+
+	/**
+	 * add - 追加一个绑定
+	 */
+	void add(std::string_view key, Kind kind, void *target, bool required);
+};
+
+#endif /* MIKUFY_JSON_FIELDS_H */
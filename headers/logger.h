@@ -0,0 +1,177 @@
+/*
+ * Mikufy v2.11-nova - 异步日志头文件
+ *
+ * 本文件定义了Logger类和log_debug()等日志函数。日志按级别过滤，
+ * 低于当前级别的日志不格式化；通过的日志放入队列，由后台线程批量
+ * 写出，调用线程不等待终端输出。
+ *
+ * 日志级别由环境变量 MIKUFY_LOG_LEVEL 设置（debug、info、warn、
+ * error、off），默认info。INFO及以下写到标准输出，WARN和ERROR写到
+ * 标准错误。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_LOGGER_H
+#define MIKUFY_LOGGER_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <atomic>		/* std::atomic 当前级别 */
+#include <condition_variable>	/* std::condition_variable */
+#include <cstdint>		/* uint64_t */
+#include <format>		/* std::format 日志格式化 */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+#include <thread>		/* std::thread 写出线程 */
+#include <utility>		/* std::forward */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 等待写出的日志超过此字节数时丢弃新日志（写出跟不上时不无限增长） */
+#define LOG_QUEUE_MAX_BYTES	(4 * 1024 * 1024)
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * LogLevel - 日志级别
+ */
+enum class LogLevel {
+	DEBUG,		/* 调试（每个请求一条等高频日志） */
+	INFO,		/* 一般信息 */
+	WARN,		/* 警告 */
+	ERROR,		/* 错误 */
+	OFF		/* 关闭所有日志 */
+};
+
+/*
+ * ============================================================================
+ * Logger类定义
+ * ============================================================================
+ */
+
+/**
+ * Logger - 异步日志
+ *
+ * 日志按级别追加到标准输出或标准错误的待写缓冲区，写出线程每次
+ * 取走整个缓冲区一次写出。进程退出时（atexit）等待缓冲区写完。
+ * 所有方法都是线程安全的。
+ */
+class Logger
+{
+public:
+	/**
+	 * instance - 获取全局日志
+	 */
+	static Logger &instance(void);
+
+	/* 禁止拷贝和移动 */
+	Logger(const Logger &) = delete;
+	Logger &operator=(const Logger &) = delete;
+
+	/**
+	 * enabled - 指定级别的日志是否会输出
+	 */
+	bool enabled(LogLevel level) const
+	{
+		return level >= threshold.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * set_level - 设置输出的最低级别
+	 */
+	void set_level(LogLevel level);
+
+	/**
+	 * write - 追加一条日志（不含换行）
+	 *
+	 * 待写缓冲区已满时丢弃并计数，之后写出一条提示。
+	 */
+	void write(LogLevel level, std::string_view message);
+
+	/**
+	 * flush - 等待已追加的日志全部写出
+	 */
+	void flush(void);
+
+private:
+	Logger(void);
+
+	std::atomic<LogLevel> threshold;
+
+	std::mutex mutex;		/* 保护以下成员 */
+	std::condition_variable cond;	/* 有新日志或已写完 */
+	std::string out_pending;	/* 等待写到标准输出的日志 */
+	std::string err_pending;	/* 等待写到标准错误的日志 */
+	uint64_t dropped;		/* 缓冲区满时丢弃的条数 */
+	uint64_t appended;		/* 已追加的批次序号 */
+	uint64_t written;		/* 已写出的批次序号 */
+
+	/**
+	 * writer_loop - 写出线程主循环
+	 */
+	void writer_loop(void);
+};
+
+/*
+ * ============================================================================
+ * 日志函数
+ * ============================================================================
+ */
+
+/**
+ * log_message - 按级别格式化并追加一条日志
+ *
+ * 级别被过滤时不格式化参数。
+ */
+template <typename... Args>
+void log_message(LogLevel level, std::format_string<Args...> fmt,
+		 Args &&...args)
+{
+	Logger &logger = Logger::instance();
+	if (!logger.enabled(level))
+		return;
+
+	logger.write(level, std::format(fmt, std::forward<Args>(args)...));
+}
+
+template <typename... Args>
+void log_debug(std::format_string<Args...> fmt, Args &&...args)
+{
+	log_message(LogLevel::DEBUG, fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void log_info(std::format_string<Args...> fmt, Args &&...args)
+{
+	log_message(LogLevel::INFO, fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void log_warn(std::format_string<Args...> fmt, Args &&...args)
+{
+	log_message(LogLevel::WARN, fmt, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void log_error(std::format_string<Args...> fmt, Args &&...args)
+{
+	log_message(LogLevel::ERROR, fmt, std::forward<Args>(args)...);
+}
+
+#endif /* MIKUFY_LOGGER_H */
@@ -137,9 +137,15 @@ using json = nlohmann::json;
 /* 文件读取大小限制（字节），约50MB，防止内存溢出 */
 #define MAX_FILE_READ_SIZE	52428800
 
-/* 目录内容读取限制（条目数），防止大目录导致性能问题 */
+/* 目录内容读取限制（条目数），未指定分页大小时一页的条目数 */
 #define MAX_DIR_ENTRIES		2000
 
+/* 目录分页：一页最多的条目数 */
+#define MAX_DIR_PAGE_SIZE	10000
+
+/* 目录分页：getdents64() 一次读取的缓冲区大小（256KB） */
+#define DIR_READ_BUFFER_SIZE	(256 * 1024)
+
 /*
  * ============================================================================
  * 数据结构定义
@@ -169,6 +175,24 @@ struct FileInfo {
 	bool is_binary;			/* 是否为二进制文件 */
 };
 
+/**
+ * DirectoryPage - 目录列表的一页
+ *
+ * 条目按目录在前、名称（不区分大小写）排序。游标是本页最后一个
+ * 条目的排序键，下一页从严格大于它的条目开始，翻页期间目录增删
+ * 条目不会导致重复或跳过已有的条目。
+ *
+ * 成员说明:
+ * @files: 本页的条目
+ * @total: 目录中可见条目（不含隐藏文件）的总数
+ * @next_cursor: 下一页的游标，空表示没有更多
+ */
+struct DirectoryPage {
+	std::vector<FileInfo> files;
+	size_t total = 0;
+	std::string next_cursor;
+};
+
 /**
  * HttpResponse - HTTP响应结构体
  *
@@ -180,32 +204,38 @@ struct FileInfo {
  * @status_text: HTTP状态文本描述（如"OK"、"Not Found"）
  * @headers: HTTP响应头的键值对映射
  * @body: HTTP响应体内容（字符串形式）
+ * @shared_body: 共享的只读响应体（如缓存的静态文件），非空时代替body
+ * @file_body: 直接从文件发送的响应体，非空时代替body
  */
+struct HttpFileBody;
+
 struct HttpResponse {
 	int status_code;						/* 状态码 */
 	std::string status_text;					/* 状态文本 */
 	std::map<std::string, std::string> headers;	/* 响应头映射 */
 	std::string body;						/* 响应体内容 */
+	std::shared_ptr<const std::string> shared_body;		/* 共享响应体 */
+	std::shared_ptr<HttpFileBody> file_body;		/* 文件响应体 */
 };
 
 /**
- * HttpHandler - HTTP请求处理函数类型定义
- *
- * 这是一个函数类型别名，定义了HTTP请求处理器的签名。所有
- * API端点处理函数都必须符合此签名。该类型用于构建路由表，
- * 将URL路径映射到对应的处理函数。
- *
- * 参数说明:
- * @path: 请求的URL路径（可能包含查询参数）
- * @headers: 请求头键值对映射
- * @body: 请求体内容（POST/PUT请求）
+ * HttpFileBody - 从文件发送的响应体
  *
- * 返回值: HttpResponse结构体，包含处理后的响应数据
+ * 持有打开的文件描述符，析构时关闭。事件循环使用sendfile()从
+ * offset开始发送length字节，文件内容不经过用户态缓冲区。
  */
-using HttpHandler = std::function<HttpResponse(
-			const std::string &,
-			const std::map<std::string, std::string> &,
-			const std::string &)>;
+struct HttpFileBody {
+	int fd;				/* 打开的文件 */
+	off_t offset;			/* 下一个要发送的字节 */
+	size_t length;			/* 剩余字节数 */
+
+	HttpFileBody(int file_fd, size_t file_length)
+		: fd(file_fd), offset(0), length(file_length) {}
+	~HttpFileBody(void) { if (fd >= 0) close(fd); }
+
+	HttpFileBody(const HttpFileBody &) = delete;
+	HttpFileBody &operator=(const HttpFileBody &) = delete;
+};
 
 /**
  * MessageType - 前端与后端通信的消息类型枚举
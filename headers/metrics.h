@@ -0,0 +1,208 @@
+/*
+ * Mikufy v2.11-nova - 运行指标头文件
+ *
+ * 本文件定义了进程内的指标注册表Metrics，以及计数器MetricCounter
+ * 和延迟直方图MetricHistogram，供 /api/metrics 以Prometheus文本格式
+ * 导出。
+ *
+ * 主要功能:
+ * - 指标在注册时分配一次，之后的更新只是relaxed原子加法，不加锁
+ * - 直方图使用固定的指数桶（50us ~ 10s），覆盖请求和编辑的延迟
+ * - 同名同标签的指标只注册一次，各模块可以在静态变量中持有引用
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_METRICS_H
+#define MIKUFY_METRICS_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <atomic>		/* std::atomic */
+#include <chrono>		/* std::chrono::steady_clock */
+#include <cstdint>		/* uint64_t */
+#include <map>			/* std::map 按名称排序的指标族 */
+#include <memory>		/* std::unique_ptr */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 直方图的桶数（不含+Inf） */
+#define METRICS_HISTOGRAM_BUCKETS	16
+
+/*
+ * ============================================================================
+ * 指标类型定义
+ * ============================================================================
+ */
+
+/**
+ * MetricCounter - 单调递增的计数器
+ */
+class MetricCounter
+{
+public:
+	MetricCounter(void) : value(0) {}
+
+	/**
+	 * add - 增加计数
+	 */
+	void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+
+	/**
+	 * get - 当前值
+	 */
+	uint64_t get(void) const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value;
+};
+
+/**
+ * MetricHistogram - 延迟直方图
+ *
+ * 桶的上界（秒）见 metrics.cpp 中的 histogram_bounds。每个桶只记录
+ * 落在其中的次数，导出时再累加成Prometheus要求的累计计数。
+ */
+class MetricHistogram
+{
+public:
+	MetricHistogram(void);
+
+	/**
+	 * observe - 记录一次耗时
+	 */
+	void observe(std::chrono::steady_clock::duration elapsed);
+
+	/**
+	 * render - 以Prometheus文本格式输出
+	 *
+	 * @out: 输出追加到末尾
+	 * @name: 指标名称
+	 * @labels: 已格式化的标签（可以为空）
+	 */
+	void render(std::string &out, std::string_view name,
+		    std::string_view labels) const;
+
+private:
+	std::atomic<uint64_t> buckets[METRICS_HISTOGRAM_BUCKETS + 1];
+	std::atomic<uint64_t> sum_ns;	/* 耗时总和（纳秒） */
+};
+
+/**
+ * MetricTimer - 作用域计时器，析构时把耗时记入直方图
+ */
+class MetricTimer
+{
+public:
+	explicit MetricTimer(MetricHistogram &histogram)
+		: histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+	~MetricTimer(void)
+	{
+		histogram.observe(std::chrono::steady_clock::now() - start);
+	}
+
+	MetricTimer(const MetricTimer &) = delete;
+	MetricTimer &operator=(const MetricTimer &) = delete;
+
+private:
+	MetricHistogram &histogram;
+	const std::chrono::steady_clock::time_point start;
+};
+
+/*
+ * ============================================================================
+ * Metrics类定义
+ * ============================================================================
+ */
+
+/**
+ * Metrics - 进程内的指标注册表
+ *
+ * 注册和导出加锁，指标本身的更新不经过注册表。注册的指标在进程
+ * 退出前一直有效，返回的引用可以长期保存。所有方法都是线程安全的。
+ */
+class Metrics
+{
+public:
+	/**
+	 * instance - 获取全局注册表
+	 */
+	static Metrics &instance(void);
+
+	/* 禁止拷贝和移动 */
+	Metrics(const Metrics &) = delete;
+	Metrics &operator=(const Metrics &) = delete;
+
+	/**
+	 * counter - 注册（或取得已注册的）计数器
+	 *
+	 * @name: 指标名称，计数器应以_total结尾
+	 * @help: 说明
+	 * @labels: 已格式化的标签，见label()
+	 */
+	MetricCounter &counter(const std::string &name, const std::string &help,
+			       const std::string &labels = "");
+
+	/**
+	 * histogram - 注册（或取得已注册的）直方图
+	 *
+	 * @name: 指标名称，应以_seconds结尾
+	 * @help: 说明
+	 * @labels: 已格式化的标签，见label()
+	 */
+	MetricHistogram &histogram(const std::string &name,
+				   const std::string &help,
+				   const std::string &labels = "");
+
+	/**
+	 * render - 以Prometheus文本格式导出所有指标
+	 *
+	 * @out: 输出追加到末尾
+	 */
+	void render(std::string &out);
+
+	/**
+	 * render_gauge - 以Prometheus文本格式输出一个瞬时值
+	 *
+	 * 瞬时值由持有状态的模块在导出时自行读取，不在注册表中登记，
+	 * 避免注册表引用生命周期更短的对象。
+	 */
+	static void render_gauge(std::string &out, std::string_view name,
+				 std::string_view help, double value);
+
+	/**
+	 * label - 格式化一个标签 name="value"（转义value）
+	 */
+	static std::string label(std::string_view name, std::string_view value);
+
+private:
+	Metrics(void) = default;
+
+	/* 同名指标的集合（一个HELP/TYPE，多组标签） */
+	struct Family {
+		std::string help;
+		bool is_histogram;
+		std::vector<std::pair<std::string, std::unique_ptr<MetricCounter>>> counters;
+		std::vector<std::pair<std::string, std::unique_ptr<MetricHistogram>>> histograms;
+	};
+
+	std::mutex mutex;			/* 保护families */
+	std::map<std::string, Family> families;
+};
+
+#endif /* MIKUFY_METRICS_H */
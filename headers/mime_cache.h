@@ -0,0 +1,169 @@
+/*
+ * Mikufy v2.11-nova - 文件类型缓存头文件
+ *
+ * 本文件定义了MimeCache类，缓存文件的MIME类型和文本/二进制判定，
+ * 避免每次打开文件都调用libmagic。
+ *
+ * 主要功能:
+ * - 以(设备号, inode, 修改时间, 大小)为键，文件被修改后自动失效
+ * - 条目数有上限，超出后淘汰一半
+ * - 退出时保存到XDG缓存目录，下次启动时加载
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_MIME_CACHE_H
+#define MIKUFY_MIME_CACHE_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstdint>		/* uint64_t */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <unordered_map>	/* std::unordered_map */
+#include <sys/stat.h>		/* struct stat */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 最多缓存的条目数 */
+#define MIME_CACHE_MAX_ENTRIES		65536
+
+/* 缓存文件的第一行，格式改变时修改版本号使旧文件被忽略 */
+#define MIME_CACHE_FILE_HEADER		"MIKUFY-MIME 1"
+
+/* 缓存文件相对于XDG缓存目录的路径 */
+#define MIME_CACHE_FILE_NAME		"mikufy/mime-cache"
+
+/* 快速判定时读取的文件头字节数 */
+#define MIME_SNIFF_SIZE			4096
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * MimeInfo - 文件类型判定结果
+ */
+struct MimeInfo {
+	std::string mime_type;		/* MIME类型 */
+	bool is_binary;			/* 是否为二进制文件 */
+
+	MimeInfo() : is_binary(false) {}
+};
+
+/*
+ * ============================================================================
+ * MimeCache类定义
+ * ============================================================================
+ */
+
+/**
+ * MimeCache - 文件类型缓存
+ *
+ * 所有方法都是线程安全的。同一个文件换了内容但修改时间和大小都
+ * 不变的情况不做处理，libmagic的结果本身也只是推测。
+ */
+class MimeCache
+{
+public:
+	/**
+	 * MimeCache - 构造函数
+	 *
+	 * @file_path: 缓存文件路径，为空表示不持久化
+	 *
+	 * 缓存文件存在时立即加载。
+	 */
+	explicit MimeCache(std::string file_path);
+
+	/**
+	 * ~MimeCache - 析构函数
+	 *
+	 * 有新条目时保存缓存文件。
+	 */
+	~MimeCache(void);
+
+	/* 禁止拷贝和移动 */
+	MimeCache(const MimeCache &) = delete;
+	MimeCache &operator=(const MimeCache &) = delete;
+	MimeCache(MimeCache &&) = delete;
+	MimeCache &operator=(MimeCache &&) = delete;
+
+	/**
+	 * default_path - 默认的缓存文件路径
+	 *
+	 * 返回值: $XDG_CACHE_HOME或~/.cache下的MIME_CACHE_FILE_NAME，
+	 *         两个环境变量都没有时返回空字符串
+	 */
+	static std::string default_path(void);
+
+	/**
+	 * lookup - 查找文件的判定结果
+	 *
+	 * @st: 文件的stat结果
+	 * @info: 输出参数，命中时填充
+	 *
+	 * 返回值: 命中返回true
+	 */
+	bool lookup(const struct stat &st, MimeInfo &info);
+
+	/**
+	 * store - 保存文件的判定结果
+	 *
+	 * @st: 文件的stat结果
+	 * @info: 判定结果
+	 */
+	void store(const struct stat &st, const MimeInfo &info);
+
+	/**
+	 * save - 把缓存写入缓存文件
+	 *
+	 * 先写临时文件再重命名，进程中途退出不会留下半个文件。
+	 *
+	 * 返回值: 成功或无需保存返回true
+	 */
+	bool save(void);
+
+private:
+	/* 缓存键：文件身份加上修改时间和大小 */
+	struct Key {
+		uint64_t dev;
+		uint64_t ino;
+		int64_t mtime_ns;
+		uint64_t size;
+
+		bool operator==(const Key &other) const = default;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const;
+	};
+
+	std::unordered_map<Key, MimeInfo, KeyHash> entries;
+	std::string file_path;		/* 缓存文件路径 */
+	bool dirty;			/* 加载之后有新条目 */
+	std::mutex mutex;		/* 保护以上成员 */
+
+	/**
+	 * make_key - 从stat结果构造缓存键
+	 */
+	static Key make_key(const struct stat &st);
+
+	/**
+	 * load - 加载缓存文件，格式不符的行被忽略
+	 */
+	void load(void);
+};
+
+#endif /* MIKUFY_MIME_CACHE_H */
@@ -0,0 +1,282 @@
+/*
+ * Mikufy v2.11-nova - Piece 树头文件
+ *
+ * 本文件定义了 TextBuffer 使用的 Piece 树。Piece 树是按文本顺序
+ * 组织的红黑树，每个节点保存一个 Piece，并维护子树的字节数和
+ * 换行符数，使得按位置查找 Piece、按行号查找行首都是 O(log n)，
+ * 插入和删除 Piece 也是 O(log n)，与编辑历史的长短无关。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循 Linux 内核代码风格规范
+ */
+
+#ifndef MIKUFY_PIECE_TREE_H
+#define MIKUFY_PIECE_TREE_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstddef>		/* size_t */
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * PieceType - Piece 类型枚举
+ *
+ * 定义 Piece 指向的缓冲区类型
+ */
+enum class PieceType {
+	ORIGINAL,	/* 指向原始缓冲区（文件内容） */
+	ADD		/* 指向添加缓冲区（用户编辑内容） */
+};
+
+/**
+ * Piece - 文本段
+ *
+ * Piece Table 的基本单元，表示文本的一个连续段
+ *
+ * 成员说明:
+ * @type: Piece 类型（ORIGINAL 或 ADD）
+ * @offset: 在缓冲区中的起始偏移
+ * @length: 段长度（字符数）
+ *
+ * 设计要点:
+ *   - 使用 offset + length 引用缓冲区内容，避免字符串拷贝
+ *   - 支持高效的拼接和分割操作
+ */
+struct Piece {
+	PieceType type;		/* Piece 类型 */
+	size_t offset;		/* 缓冲区偏移 */
+	size_t length;		/* 段长度 */
+
+	/**
+	 * 默认构造函数
+	 */
+	Piece(void) : type(PieceType::ORIGINAL), offset(0), length(0)
+	{
+	}
+
+	/**
+	 * 构造函数
+	 */
+	Piece(PieceType t, size_t off, size_t len)
+		: type(t), offset(off), length(len)
+	{
+	}
+};
+
+/**
+ * PieceNode - Piece 树节点
+ *
+ * 成员说明:
+ * @piece: 节点保存的 Piece
+ * @line_feeds: Piece 内的换行符数量
+ * @subtree_length: 以该节点为根的子树的总字节数
+ * @subtree_line_feeds: 以该节点为根的子树的总换行符数
+ * @parent/@left/@right: 树结构指针（空子树指向哨兵节点）
+ * @red: 红黑树颜色
+ */
+struct PieceNode {
+	Piece piece;
+	size_t line_feeds;
+	size_t subtree_length;
+	size_t subtree_line_feeds;
+	PieceNode *parent;
+	PieceNode *left;
+	PieceNode *right;
+	bool red;
+};
+
+/*
+ * ============================================================================
+ * PieceTree 类定义
+ * ============================================================================
+ */
+
+/**
+ * PieceTree - 以文本顺序排列 Piece 的红黑树
+ *
+ * 树的中序遍历即为文档内容。节点不存储绝对位置，位置由查找路径上
+ * 左子树的 subtree_length 累加得到，因此插入或删除一个 Piece 只需
+ * 更新到根路径上的统计信息。
+ *
+ * 对外接口中"没有节点"统一用 nullptr 表示，哨兵节点不会泄露给调用者。
+ *
+ * 注意: 该类不是线程安全的，由 TextBuffer 的锁保护。
+ */
+class PieceTree
+{
+public:
+	PieceTree(void);
+	~PieceTree(void);
+
+	/* 禁止拷贝和移动（节点指针指向内部哨兵） */
+	PieceTree(const PieceTree &) = delete;
+	PieceTree &operator=(const PieceTree &) = delete;
+	PieceTree(PieceTree &&) = delete;
+	PieceTree &operator=(PieceTree &&) = delete;
+
+	/**
+	 * clear - 删除所有节点
+	 */
+	void clear(void);
+
+	/**
+	 * empty - 树是否为空
+	 */
+	bool empty(void) const
+	{
+		return root == nil;
+	}
+
+	/**
+	 * length - 文档总字节数
+	 */
+	size_t length(void) const
+	{
+		return root->subtree_length;
+	}
+
+	/**
+	 * line_feed_count - 文档中的换行符总数
+	 */
+	size_t line_feed_count(void) const
+	{
+		return root->subtree_line_feeds;
+	}
+
+	/**
+	 * piece_count - 节点（Piece）数量
+	 */
+	size_t piece_count(void) const
+	{
+		return count;
+	}
+
+	/* ====================================================================
+	 * 遍历
+	 * ==================================================================== */
+
+	/**
+	 * first - 第一个节点，树为空时返回 nullptr
+	 */
+	PieceNode *first(void) const;
+
+	/**
+	 * last - 最后一个节点，树为空时返回 nullptr
+	 */
+	PieceNode *last(void) const;
+
+	/**
+	 * next - 中序后继节点，没有时返回 nullptr
+	 */
+	PieceNode *next(PieceNode *node) const;
+
+	/**
+	 * prev - 中序前驱节点，没有时返回 nullptr
+	 */
+	PieceNode *prev(PieceNode *node) const;
+
+	/* ====================================================================
+	 * 查找
+	 * ==================================================================== */
+
+	/**
+	 * find_by_offset - 查找包含指定位置的节点
+	 *
+	 * @pos: 文档中的字节位置
+	 * @piece_start: 输出参数，节点 Piece 在文档中的起始位置
+	 *
+	 * 返回值: 满足 piece_start <= pos < piece_start + length 的节点，
+	 *         pos 超出文档末尾时返回 nullptr
+	 */
+	PieceNode *find_by_offset(size_t pos, size_t &piece_start) const;
+
+	/**
+	 * find_by_offset - 查找包含指定位置的节点，同时返回之前的换行符数
+	 *
+	 * @pos: 文档中的字节位置
+	 * @piece_start: 输出参数，节点 Piece 在文档中的起始位置
+	 * @line_feeds_before: 输出参数，该节点之前的换行符总数
+	 *
+	 * 返回值: 同上
+	 */
+	PieceNode *find_by_offset(size_t pos, size_t &piece_start,
+				  size_t &line_feeds_before) const;
+
+	/**
+	 * find_by_line_feed - 查找包含第 index 个换行符的节点
+	 *
+	 * @index: 换行符序号（从0开始）
+	 * @piece_start: 输出参数，节点 Piece 在文档中的起始位置
+	 * @line_feeds_before: 输出参数，该节点之前的换行符总数
+	 *
+	 * 返回值: 找到的节点，index 超出换行符总数时返回 nullptr
+	 */
+	PieceNode *find_by_line_feed(size_t index, size_t &piece_start,
+				     size_t &line_feeds_before) const;
+
+	/**
+	 * offset_of - 计算节点 Piece 在文档中的起始位置
+	 */
+	size_t offset_of(const PieceNode *node) const;
+
+	/* ====================================================================
+	 * 修改
+	 * ==================================================================== */
+
+	/**
+	 * insert_before - 在指定节点之前插入 Piece
+	 *
+	 * @pos: 插入到该节点之前，nullptr 表示追加到文档末尾
+	 * @piece: 新 Piece
+	 * @line_feeds: 新 Piece 内的换行符数量
+	 *
+	 * 返回值: 新节点
+	 */
+	PieceNode *insert_before(PieceNode *pos, const Piece &piece,
+				 size_t line_feeds);
+
+	/**
+	 * update - 原地修改节点的 Piece（例如截断或扩展）
+	 *
+	 * @node: 要修改的节点
+	 * @piece: 新 Piece
+	 * @line_feeds: 新 Piece 内的换行符数量
+	 */
+	void update(PieceNode *node, const Piece &piece, size_t line_feeds);
+
+	/**
+	 * erase - 删除节点
+	 *
+	 * @node: 要删除的节点，调用后该指针失效
+	 */
+	void erase(PieceNode *node);
+
+private:
+	PieceNode nil_node;	/* 哨兵节点（黑色，统计信息恒为0） */
+	PieceNode *nil;		/* 指向 nil_node */
+	PieceNode *root;	/* 根节点，空树时为 nil */
+	size_t count;		/* 节点数量 */
+
+	PieceNode *minimum(PieceNode *node) const;
+	PieceNode *maximum(PieceNode *node) const;
+	void recompute(PieceNode *node);
+	void update_path(PieceNode *node);
+	void rotate_left(PieceNode *x);
+	void rotate_right(PieceNode *x);
+	void insert_fixup(PieceNode *z);
+	void erase_fixup(PieceNode *x);
+	void transplant(PieceNode *u, PieceNode *v);
+	void destroy(PieceNode *node);
+};
+
+#endif /* MIKUFY_PIECE_TREE_H */
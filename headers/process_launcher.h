@@ -6,6 +6,8 @@
  *
  * 核心特性:
  * - 运行时GUI检测：X11窗口检测 + Wayland连接检测
+ * - 事件驱动：订阅X11窗口创建事件，用pidfd等待进程退出，不轮询窗口树
+ * - 按可执行文件缓存检测结果，文件未变化时再次启动无需检测
  * - 可配置超时时间（默认500ms）
  * - CLI程序：返回PTY文件描述符，用于终端显示
  * - GUI程序：简单fork+execve，无PTY
@@ -33,6 +35,7 @@
 #include <memory>
 #include <functional>
 #include <chrono>
+#include <sys/types.h>
 
 /*
  * ============================================================================
@@ -88,9 +91,14 @@ struct LaunchResult {
  *
  * 使用运行时检测方法区分CLI和GUI程序：
  * 1. 先在PTY中启动进程
- * 2. 在超时时间内检测X11窗口或Wayland连接
+ * 2. 在超时时间内检测X11窗口或显示服务器（Wayland/X11）连接
  * 3. 如果检测到GUI窗口：终止PTY进程，重新用fork+execve启动
  * 4. 如果未检测到GUI窗口：继续在PTY中运行
+ *
+ * 检测结果按可执行文件（设备号、inode、大小和修改时间）缓存在
+ * 进程内，所有ProcessLauncher实例共享。缓存命中时跳过检测直接
+ * 以对应方式启动。只缓存确定的结果（检测到GUI，或进程在检测期间
+ * 退出）；超时的结果不缓存，冷启动较慢的GUI程序下次会再次检测。
  */
 class ProcessLauncher {
 public:
@@ -140,6 +148,26 @@ public:
 	 */
 	uint32_t get_detection_timeout() const;
 
+	/**
+	 * cached_type - 查询可执行文件之前的检测结果
+	 *
+	 * @param executable: 可执行文件路径
+	 * @return std::optional<ProcessType>: 文件未变化时返回上次检测的
+	 *         类型，没有记录或文件已变化时返回std::nullopt
+	 */
+	static std::optional<ProcessType> cached_type(const std::string &executable);
+
+	/**
+	 * terminate_process - 终止子进程并回收
+	 *
+	 * 先发送SIGTERM，等待grace_ms后仍未退出则发送SIGKILL。
+	 * 等待通过pidfd进行，进程退出后立即返回。
+	 *
+	 * @param pid: 子进程ID
+	 * @param grace_ms: SIGTERM后等待的时间（毫秒）
+	 */
+	void terminate_process(pid_t pid, uint32_t grace_ms);
+
 	/**
 	 * spawn_cli_in_pty - 直接在PTY中启动CLI程序（跳过检测）
 	 *
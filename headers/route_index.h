@@ -0,0 +1,147 @@
+/*
+ * Mikufy v2.11-nova - 路由索引头文件
+ *
+ * 本文件定义了RouteIndex类，在编译时为固定的路由表建立完美哈希，
+ * 把URL路径映射到路由表中的下标。
+ *
+ * 主要功能:
+ * - 构造函数是consteval的，哈希种子在编译时搜索，路由路径重复或
+ *   找不到种子时编译失败
+ * - 查找只计算一次哈希、比较一次字符串，不分配内存，不需要锁
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_ROUTE_INDEX_H
+#define MIKUFY_ROUTE_INDEX_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstddef>		/* size_t */
+#include <cstdint>		/* uint8_t, uint32_t */
+#include <string_view>		/* std::string_view */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 哈希槽数（2的幂）；路由数不超过槽数的1/4时很快能找到种子 */
+#define ROUTE_INDEX_SLOTS	256
+
+/* 空槽 */
+#define ROUTE_INDEX_EMPTY	0xff
+
+/* 搜索种子的次数上限 */
+#define ROUTE_INDEX_MAX_SEEDS	4096
+
+/*
+ * ============================================================================
+ * RouteIndex类定义
+ * ============================================================================
+ */
+
+/**
+ * RouteIndex - 编译时建立的路由完美哈希
+ *
+ * 每个路由占一个槽，槽中保存路径（用于确认）和路由表下标。
+ */
+class RouteIndex
+{
+public:
+	/**
+	 * RouteIndex - 为路由表建立索引
+	 *
+	 * @routes: 路由表，元素有path成员（std::string_view）
+	 *
+	 * 依次尝试种子，直到所有路径落在不同的槽中。
+	 */
+	template <typename Route, size_t N>
+	consteval RouteIndex(const Route (&routes)[N])
+		: seed(0), slots{}
+	{
+		static_assert(N * 4 <= ROUTE_INDEX_SLOTS, "路由过多");
+
+		for (uint32_t candidate = 1; candidate <= ROUTE_INDEX_MAX_SEEDS;
+		     candidate++) {
+			if (try_seed(routes, candidate))
+				return;
+		}
+
+		/* 编译时执行到这里即报错：路径重复或种子不够 */
+		throw "RouteIndex: 找不到无冲突的哈希种子";
+	}
+
+	/**
+	 * find - 查找路径
+	 *
+	 * @path: 不含查询字符串的路径
+	 *
+	 * 返回: 路由表下标，不存在时返回-1
+	 */
+	constexpr int find(std::string_view path) const
+	{
+		const Slot &slot = slots[hash(path, seed) & (ROUTE_INDEX_SLOTS - 1)];
+		if (slot.index == ROUTE_INDEX_EMPTY || slot.path != path)
+			return -1;
+		return slot.index;
+	}
+
+private:
+	struct Slot {
+		std::string_view path;
+		uint8_t index = ROUTE_INDEX_EMPTY;
+	};
+
+	uint32_t seed;
+	Slot slots[ROUTE_INDEX_SLOTS];
+
+	/**
+	 * hash - 带种子的FNV-1a，最后混合高位
+	 */
+	static constexpr uint32_t hash(std::string_view path, uint32_t seed)
+	{
+		uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+		for (char c : path) {
+			h ^= static_cast<unsigned char>(c);
+			h *= 16777619u;
+		}
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 12;
+		return h;
+	}
+
+	/**
+	 * try_seed - 用指定种子放置所有路由
+	 *
+	 * 返回: 没有冲突返回true，此时slots和seed已更新
+	 */
+	template <typename Route, size_t N>
+	consteval bool try_seed(const Route (&routes)[N], uint32_t candidate)
+	{
+		for (Slot &slot : slots)
+			slot = Slot();
+
+		for (size_t i = 0; i < N; i++) {
+			Slot &slot = slots[hash(routes[i].path, candidate) &
+					   (ROUTE_INDEX_SLOTS - 1)];
+			if (slot.index != ROUTE_INDEX_EMPTY)
+				return false;
+			slot.path = routes[i].path;
+			slot.index = static_cast<uint8_t>(i);
+		}
+
+		seed = candidate;
+		return true;
+	}
+};
+
+#endif /* MIKUFY_ROUTE_INDEX_H */
@@ -0,0 +1,240 @@
+/*
+ * Mikufy v2.11-nova - 终端回滚缓冲区头文件
+ *
+ * 本文件定义了Scrollback类和ScrollbackPagePool类，为每个终端进程
+ * 保存输出历史。
+ *
+ * 主要功能:
+ * - 按页分配：输出到来时才从共享页池取页，进程结束后页归还页池
+ * - 每进程内存上限，超出后丢弃（或换出到磁盘）最早的已读页
+ * - 可选的磁盘换出：很长的会话把较早的输出写入匿名临时文件
+ * - 按字节序号读取，断线重连的客户端可以从上次的位置继续
+ * - 单生产者写入不加锁，生产者只在换页时短暂持锁
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_SCROLLBACK_H
+#define MIKUFY_SCROLLBACK_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <atomic>		/* std::atomic */
+#include <cstddef>		/* size_t */
+#include <cstdint>		/* uint64_t */
+#include <deque>		/* std::deque 页队列 */
+#include <functional>		/* std::function */
+#include <mutex>		/* std::mutex */
+#include <span>			/* std::span */
+#include <string_view>		/* std::string_view */
+#include <vector>		/* std::vector 空闲页 */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 每页字节数 */
+#define SCROLLBACK_PAGE_SIZE		(64 * 1024)
+
+/* 页池最多缓存的空闲页数，超出的页直接释放 */
+#define SCROLLBACK_POOL_MAX_FREE	64
+
+/* 每个进程默认保留在内存中的输出上限 */
+#define SCROLLBACK_DEFAULT_LIMIT	(4 * 1024 * 1024)
+
+/* 默认的磁盘换出上限，0表示不换出 */
+#define SCROLLBACK_DEFAULT_SPILL_LIMIT	0
+
+/* 换出文件所在目录（使用O_TMPFILE创建，不留下文件名） */
+#define SCROLLBACK_SPILL_DIR		"/tmp"
+
+/*
+ * ============================================================================
+ * ScrollbackPagePool类定义
+ * ============================================================================
+ */
+
+/**
+ * ScrollbackPagePool - 所有终端进程共享的页池
+ *
+ * 频繁启动的短命令不必每次都向分配器申请大块内存。页池在首次
+ * 使用时创建且从不销毁，静态对象析构期间释放页也是安全的。
+ */
+class ScrollbackPagePool
+{
+public:
+	/**
+	 * instance - 获取全局页池
+	 */
+	static ScrollbackPagePool &instance(void);
+
+	/**
+	 * acquire - 取一页（SCROLLBACK_PAGE_SIZE字节，内容未初始化）
+	 */
+	char *acquire(void);
+
+	/**
+	 * release - 归还一页
+	 */
+	void release(char *page);
+
+private:
+	ScrollbackPagePool(void) = default;
+
+	std::vector<char *> free_pages;	/* 空闲页 */
+	std::mutex mutex;		/* 保护free_pages */
+};
+
+/*
+ * ============================================================================
+ * Scrollback类定义
+ * ============================================================================
+ */
+
+/**
+ * Scrollback - 单个终端进程的输出历史
+ *
+ * 输出按字节编号：序号从0开始，每写入一个字节加1。保留范围是
+ * [first_seq(), end_seq())，其中较早的部分可能在换出文件中。
+ *
+ * 生产者（IO线程）用write_span()/commit_write()直接在页内读入数据；
+ * 读取方在外部串行化后调用read_from()/advance()。
+ *
+ * 消费位置（consumed_seq）之后的数据不会被丢弃：内存和换出上限都
+ * 用完时write_span()返回空区域，由调用者暂停读取PTY，等消费位置
+ * 前进后再继续，保证背压一直传递到子进程。
+ */
+class Scrollback
+{
+public:
+	/**
+	 * SeqVisitor - 读取回调，参数是数据段的起始序号和内容
+	 *
+	 * 视图指向页内或临时缓冲区，只在回调内有效。
+	 */
+	using SeqVisitor = std::function<void(uint64_t seq, std::string_view chunk)>;
+
+	/**
+	 * Scrollback - 构造函数
+	 *
+	 * @memory_limit: 内存中最多保留的字节数（至少一页）
+	 * @spill_limit: 换出文件最多保留的字节数，0表示不换出
+	 */
+	Scrollback(size_t memory_limit = SCROLLBACK_DEFAULT_LIMIT,
+		   size_t spill_limit = SCROLLBACK_DEFAULT_SPILL_LIMIT);
+
+	/**
+	 * ~Scrollback - 析构函数
+	 *
+	 * 把所有页归还页池，关闭换出文件。
+	 */
+	~Scrollback(void);
+
+	/* 禁止拷贝和移动 */
+	Scrollback(const Scrollback &) = delete;
+	Scrollback &operator=(const Scrollback &) = delete;
+	Scrollback(Scrollback &&) = delete;
+	Scrollback &operator=(Scrollback &&) = delete;
+
+	/**
+	 * write_span - 获取当前页的空闲区域（生产者）
+	 *
+	 * 当前页写满时换一页，必要时丢弃或换出最早的页。
+	 *
+	 * 返回值: 可写区域；未读数据已达上限时为空
+	 */
+	std::span<char> write_span(void);
+
+	/**
+	 * commit_write - 提交写入write_span()的数据（生产者）
+	 */
+	void commit_write(size_t size);
+
+	/**
+	 * read_from - 从指定序号开始读取（不改变消费位置）
+	 *
+	 * @seq: 起始序号，早于first_seq()时从first_seq()开始
+	 * @max_bytes: 最多读取的字节数
+	 * @visitor: 读取回调，每段连续数据调用一次
+	 *
+	 * 返回值: 读到的最后一个字节之后的序号
+	 */
+	uint64_t read_from(uint64_t seq, size_t max_bytes,
+			   const SeqVisitor &visitor);
+
+	/**
+	 * advance - 把消费位置前移到seq（已经更靠后时不变）
+	 *
+	 * 消费位置之前的数据才允许被丢弃。
+	 */
+	void advance(uint64_t seq);
+
+	/**
+	 * first_seq - 最早仍可读取的序号
+	 */
+	uint64_t first_seq(void);
+
+	/**
+	 * end_seq - 已写入的总字节数，即下一个字节的序号
+	 */
+	uint64_t end_seq(void) const;
+
+	/**
+	 * consumed_seq - 当前消费位置
+	 */
+	uint64_t consumed_seq(void) const;
+
+	/**
+	 * unconsumed - 消费位置之后尚未读取的字节数
+	 */
+	size_t unconsumed(void) const;
+
+private:
+	/* 以下成员受mutex保护，生产者只在换页时访问 */
+	std::deque<char *> pages;	/* 内存中的页，第i页从mem_seq + i * 页大小开始 */
+	uint64_t mem_seq;		/* 第一页的起始序号 */
+	uint64_t base_seq;		/* 最早仍可读取的序号 */
+	int spill_fd;			/* 换出文件，文件偏移即序号；-1表示未打开 */
+	bool spill_failed;		/* 换出文件不可用，退回直接丢弃 */
+	std::vector<char> spill_scratch; /* 读取换出数据的临时缓冲区 */
+	std::mutex mutex;
+
+	const size_t memory_limit;	/* 内存上限（按页取整） */
+	const size_t spill_limit;	/* 换出上限，0表示不换出 */
+
+	/* 生产者私有：当前页及其已写入字节数 */
+	char *write_page;
+	size_t write_offset;
+
+	std::atomic<uint64_t> head;	/* 已写入的总字节数（生产者写） */
+	std::atomic<uint64_t> consumed;	/* 消费位置（读取方写） */
+
+	/**
+	 * make_room_locked - 为新页腾出空间（调用者持有锁）
+	 *
+	 * 返回值: 可以再分配一页返回true
+	 */
+	bool make_room_locked(void);
+
+	/**
+	 * spill_front_locked - 把最早的一页写入换出文件（调用者持有锁）
+	 *
+	 * 返回值: 成功返回true
+	 */
+	bool spill_front_locked(void);
+
+	/**
+	 * drop_front_locked - 丢弃最早的一页（调用者持有锁）
+	 */
+	void drop_front_locked(void);
+};
+
+#endif /* MIKUFY_SCROLLBACK_H */
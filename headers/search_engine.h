@@ -0,0 +1,360 @@
+/*
+ * Mikufy v2.11-nova - 全文搜索头文件
+ *
+ * 本文件定义了搜索模式SearchPattern和工作区搜索任务SearchJob，
+ * 为Web服务器提供缓冲区内搜索和整个工作区的并行搜索。
+ *
+ * 主要功能:
+ * - 字面量搜索用memmem()（glibc中为向量化实现）整块查找，不区分
+ *   大小写时用两个memchr()竞争定位首字符
+ * - 正则表达式用RE2（自动机实现，不回溯、不递归）匹配：先在整个
+ *   文本块中定位候选行，再在候选行内逐个匹配
+ * - 直接遍历TextBuffer的Piece，除跨Piece的行外不拷贝内容
+ * - 工作区搜索在线程池中并行遍历目录和搜索文件，按文件流式输出
+ *   结果；已打开的文件搜索TextBuffer中未保存的内容
+ *
+ * 搜索按行进行（与grep相同）：匹配不跨越换行符。行号和列号都从0
+ * 开始，列号是行内的字节偏移。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_SEARCH_ENGINE_H
+#define MIKUFY_SEARCH_ENGINE_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include "file_manager.h"	/* FileManager二进制文件判定 */
+#include "text_buffer.h"	/* TextBuffer缓冲区内搜索 */
+#include "thread_pool.h"	/* ThreadPool并行搜索 */
+#include <atomic>		/* std::atomic 取消标志、结果计数 */
+#include <chrono>		/* std::chrono::steady_clock 耗时统计 */
+#include <condition_variable>	/* std::condition_variable */
+#include <cstdint>		/* uint64_t */
+#include <deque>		/* std::deque 待搜索的目录和文件 */
+#include <expected>		/* std::expected 编译错误 */
+#include <functional>		/* std::function */
+#include <memory>		/* std::shared_ptr, std::enable_shared_from_this */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 前向声明
+ * ============================================================================
+ */
+
+namespace re2 {
+class RE2;
+}
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 工作区搜索的最大并行线程数（实际数量取min(CPU核心数, 此值)） */
+#define SEARCH_MAX_THREADS		8
+
+/* 未指定时一次搜索最多返回的匹配数 */
+#define SEARCH_DEFAULT_MAX_RESULTS	10000
+
+/* 匹配所在行的预览最多保留的字节数 */
+#define SEARCH_PREVIEW_MAX		200
+
+/* 预览窗口中匹配之前保留的字节数（行太长时） */
+#define SEARCH_PREVIEW_CONTEXT		40
+
+/* 工作区搜索跳过超过此大小的文件（256MB） */
+#define SEARCH_MAX_FILE_SIZE		(256LL * 1024LL * 1024LL)
+
+/* 不小于此大小的文件用mmap()读取，更小的文件read()到复用的缓冲区 */
+#define SEARCH_MMAP_MIN_SIZE		(1024 * 1024)
+
+/* 等待发送的结果超过此值时工作线程暂停，直到连接取走（背压） */
+#define SEARCH_OUTPUT_HIGH_WATER	(1024 * 1024)
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * SearchOptions - 搜索参数
+ */
+struct SearchOptions {
+	std::string pattern;		/* 搜索内容 */
+	bool regex;			/* pattern是RE2语法的正则表达式 */
+	bool case_sensitive;		/* 区分大小写（字面量只折叠ASCII） */
+	bool whole_word;		/* 匹配两侧不能是单词字符 */
+	size_t max_results;		/* 最多返回的匹配数 */
+
+	SearchOptions()
+		: regex(false), case_sensitive(false), whole_word(false),
+		  max_results(SEARCH_DEFAULT_MAX_RESULTS) {}
+};
+
+/**
+ * SearchMatch - 一处匹配
+ */
+struct SearchMatch {
+	size_t line;			/* 行号（从0开始） */
+	size_t column;			/* 行内字节偏移 */
+	size_t length;			/* 匹配的字节数 */
+	uint64_t offset;		/* 文档内的字节偏移 */
+	std::string preview;		/* 所在行（过长时截取匹配附近） */
+	size_t preview_column;		/* 匹配在preview中的字节偏移 */
+};
+
+/*
+ * ============================================================================
+ * SearchPattern类定义
+ * ============================================================================
+ */
+
+/**
+ * SearchPattern - 编译后的搜索模式
+ *
+ * 编译后只读，可以在多个线程中同时使用。
+ */
+class SearchPattern
+{
+public:
+	/**
+	 * compile - 编译搜索模式
+	 *
+	 * @options: 搜索参数
+	 *
+	 * 返回值: 成功返回搜索模式，模式为空、包含换行符或正则表达式
+	 *         非法时返回错误信息
+	 */
+	static std::expected<SearchPattern, std::string>
+	compile(const SearchOptions &options);
+
+	/**
+	 * scan - 在由完整行组成的文本块中查找
+	 *
+	 * @block: 文本块，从行首开始，除最后一行外都以换行符结尾
+	 * @first_line: 文本块第一行的行号
+	 * @base_offset: 文本块在文档中的字节偏移
+	 * @matches: 输出参数，匹配追加到末尾
+	 * @limit: matches最多增长到的数量
+	 *
+	 * 返回值: 找到的匹配数（达到limit时停止）
+	 */
+	size_t scan(std::string_view block, size_t first_line,
+		    uint64_t base_offset, std::vector<SearchMatch> &matches,
+		    size_t limit) const;
+
+	/**
+	 * search_buffer - 搜索TextBuffer的当前内容
+	 *
+	 * 在TextBuffer的共享锁内遍历Piece，行内不跨Piece时直接在Piece
+	 * 中查找；跨Piece的行拼接后查找。
+	 *
+	 * @buffer: 文本缓冲区
+	 * @matches: 输出参数，匹配追加到末尾
+	 * @limit: matches最多增长到的数量
+	 * @cancel: 非空且变为true时尽快停止
+	 *
+	 * 返回值: 找到的匹配数
+	 */
+	size_t search_buffer(TextBuffer &buffer, std::vector<SearchMatch> &matches,
+			     size_t limit,
+			     const std::atomic<bool> *cancel = nullptr) const;
+
+	/**
+	 * max_results - 编译时指定的最多匹配数
+	 */
+	size_t max_results(void) const { return options.max_results; }
+
+private:
+	SearchOptions options;
+	std::string folded;		/* 不区分大小写时转为小写的pattern */
+	std::shared_ptr<const re2::RE2> regex;	/* 正则表达式模式 */
+	bool regex_prefilter = false;	/* 可以先在整个文本块中定位候选行 */
+
+	/**
+	 * find_literal - 查找字面量的下一次出现
+	 *
+	 * 返回值: 匹配起始位置，没有时返回nullptr
+	 */
+	const char *find_literal(const char *begin, const char *end) const;
+
+	/**
+	 * scan_literal - scan()的字面量实现
+	 */
+	size_t scan_literal(std::string_view block, size_t first_line,
+			    uint64_t base_offset,
+			    std::vector<SearchMatch> &matches,
+			    size_t limit) const;
+
+	/**
+	 * scan_regex - scan()的正则表达式实现
+	 */
+	size_t scan_regex(std::string_view block, size_t first_line,
+			  uint64_t base_offset, std::vector<SearchMatch> &matches,
+			  size_t limit) const;
+
+	/**
+	 * is_word_boundary - 检查[begin, end)两侧是否不是单词字符
+	 */
+	bool is_word_boundary(std::string_view line, size_t begin,
+			      size_t end) const;
+};
+
+/*
+ * ============================================================================
+ * SearchJob类定义
+ * ============================================================================
+ */
+
+/**
+ * SearchJob - 一次工作区搜索
+ *
+ * start()把若干个工作任务提交到线程池：每个任务从共享的队列中
+ * 取出目录（读取目录项，子目录和文件放回队列）或文件（搜索）。
+ * 隐藏文件和目录（与目录列表一致）、符号链接指向的目录、超过
+ * SEARCH_MAX_FILE_SIZE的文件和二进制文件被跳过。
+ *
+ * 结果编码为Server-Sent Events追加到输出缓冲区，由连接通过
+ * take_output()取走:
+ *   event: results  data {"path": 文件, "matches": [...]}，每个文件一个
+ *   event: done     data {"files": 搜索的文件数, "matches": 匹配数,
+ *                         "truncated": 是否有超出上限的匹配, "elapsedMs": 耗时}
+ * 输出缓冲区从空变为非空以及搜索结束时调用就绪回调。
+ *
+ * 必须由std::shared_ptr持有，工作任务持有引用直到退出。所有方法
+ * 都是线程安全的。
+ */
+class SearchJob : public std::enable_shared_from_this<SearchJob>
+{
+public:
+	/* 返回路径对应的已打开的TextBuffer，没有时返回nullptr */
+	using BufferLookup =
+		std::function<std::shared_ptr<TextBuffer>(const std::string &)>;
+
+	/* 有新输出或搜索结束时调用（在工作线程中） */
+	using ReadyCallback = std::function<void(void)>;
+
+	/**
+	 * SearchJob - 构造函数
+	 *
+	 * @file_manager: 提供二进制文件判定（命中缓存时不读取文件）
+	 * @root: 搜索的根目录
+	 * @pattern: 编译后的搜索模式
+	 * @lookup: 查找已打开的TextBuffer
+	 */
+	SearchJob(FileManager *file_manager, std::string root,
+		  SearchPattern pattern, BufferLookup lookup);
+
+	/* 禁止拷贝和移动 */
+	SearchJob(const SearchJob &) = delete;
+	SearchJob &operator=(const SearchJob &) = delete;
+
+	/**
+	 * start - 开始搜索
+	 *
+	 * @pool: 执行搜索的线程池
+	 * @ready: 就绪回调
+	 *
+	 * 返回值: 成功提交返回true
+	 */
+	bool start(ThreadPool &pool, ReadyCallback ready);
+
+	/**
+	 * cancel - 取消搜索
+	 *
+	 * 工作任务尽快退出（等待背压的任务也会被唤醒），不再调用就绪
+	 * 回调。
+	 */
+	void cancel(void);
+
+	/**
+	 * take_output - 取走等待发送的输出
+	 *
+	 * @out: 输出追加到末尾
+	 *
+	 * 返回值: 搜索已结束且所有输出都已取走时返回true
+	 */
+	bool take_output(std::string &out);
+
+private:
+	FileManager *file_manager;
+	const std::string root;
+	const SearchPattern pattern;
+	const BufferLookup lookup;
+	ReadyCallback ready;
+	const std::chrono::steady_clock::time_point started;
+
+	/* 待处理的目录和文件 */
+	struct WorkItem {
+		std::string path;
+		bool is_directory;
+	};
+
+	std::mutex queue_mutex;		/* 保护queue、active和workers */
+	std::condition_variable queue_cond; /* 有新工作或全部完成 */
+	std::deque<WorkItem> queue;
+	size_t active;			/* 正在处理工作项的任务数 */
+	size_t workers;			/* 尚未退出的工作任务数 */
+
+	std::mutex output_mutex;	/* 保护output和finished */
+	std::condition_variable output_cond; /* 输出被取走或已取消 */
+	std::string output;		/* 等待发送的SSE事件 */
+	bool finished;			/* done事件已追加 */
+
+	std::atomic<bool> cancelled;
+	std::atomic<size_t> result_count; /* 已输出的匹配数 */
+	std::atomic<size_t> file_count;	/* 已搜索的文件数 */
+	std::atomic<bool> truncated;	/* 有超出上限的匹配未输出 */
+
+	/**
+	 * stopping - 已取消或已达到匹配数上限
+	 */
+	bool stopping(void) const { return cancelled || truncated; }
+
+	/**
+	 * worker - 工作任务主循环
+	 */
+	void worker(void);
+
+	/**
+	 * finish_worker - 一个工作任务退出，最后一个追加done事件
+	 */
+	void finish_worker(void);
+
+	/**
+	 * scan_directory - 读取目录项，子目录和文件放入队列
+	 */
+	void scan_directory(const std::string &path);
+
+	/**
+	 * search_file - 搜索一个文件并输出结果
+	 *
+	 * @read_buffer: 工作任务复用的读缓冲区
+	 */
+	void search_file(const std::string &path, std::string &read_buffer);
+
+	/**
+	 * emit - 把一个文件的匹配编码为results事件
+	 */
+	void emit(const std::string &path, const std::vector<SearchMatch> &matches);
+
+	/**
+	 * append_output - 追加SSE事件，输出积压时等待
+	 */
+	void append_output(std::string event, bool last);
+};
+
+#endif /* MIKUFY_SEARCH_ENGINE_H */
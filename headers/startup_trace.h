@@ -0,0 +1,142 @@
+/*
+ * Mikufy v2.11-nova - 启动耗时跟踪头文件
+ *
+ * 本文件定义了StartupTrace类，记录启动过程中各阶段完成的时间点，
+ * 用于测量从进程启动到前端可以交互（time-to-interactive）的耗时。
+ *
+ * 主要功能:
+ * - 时间从进程创建时算起（/proc/self/stat 的启动时间），包括动态
+ *   链接WebKit等库的时间，不只是main()之后的部分
+ * - 各线程都可以记录时间点，同时记录线程号，看得出哪些阶段重叠
+ * - 前端初始化完成后结束跟踪，把各阶段耗时写入日志；结果也通过
+ *   /api/startup-trace 和 /api/metrics 导出
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_STARTUP_TRACE_H
+#define MIKUFY_STARTUP_TRACE_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstdint>		/* int64_t */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+#include <sys/types.h>		/* pid_t */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 最多记录的时间点数（超出后忽略，防止前端反复上报） */
+#define STARTUP_TRACE_MAX_MARKS	64
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * StartupMark - 一个时间点
+ */
+struct StartupMark {
+	std::string name;	/* 阶段名称 */
+	int64_t elapsed_us;	/* 进程启动以来的微秒数 */
+	pid_t tid;		/* 记录时所在的线程 */
+};
+
+/*
+ * ============================================================================
+ * StartupTrace类定义
+ * ============================================================================
+ */
+
+/**
+ * StartupTrace - 全局的启动耗时跟踪
+ *
+ * 所有方法都是线程安全的。
+ */
+class StartupTrace
+{
+public:
+	/**
+	 * instance - 获取全局跟踪对象
+	 */
+	static StartupTrace &instance(void);
+
+	/* 禁止拷贝和移动 */
+	StartupTrace(const StartupTrace &) = delete;
+	StartupTrace &operator=(const StartupTrace &) = delete;
+
+	/**
+	 * mark - 记录一个阶段完成
+	 *
+	 * 结束后的记录被忽略。
+	 */
+	void mark(std::string_view name);
+
+	/**
+	 * finish - 记录最后一个阶段并结束跟踪
+	 *
+	 * 只有第一次调用有效，把各阶段耗时写入日志。
+	 *
+	 * 返回值: 本次调用结束了跟踪返回true
+	 */
+	bool finish(std::string_view name);
+
+	/**
+	 * finished - 跟踪是否已结束
+	 */
+	bool finished(void) const;
+
+	/**
+	 * marks - 取得已记录的时间点（按记录顺序）
+	 */
+	std::vector<StartupMark> marks(void) const;
+
+	/**
+	 * render - 以Prometheus文本格式输出各阶段耗时
+	 *
+	 * @out: 输出追加到末尾
+	 */
+	void render(std::string &out) const;
+
+private:
+	StartupTrace(void);
+
+	mutable std::mutex mutex;	/* 保护以下成员 */
+	std::vector<StartupMark> entries;
+	bool done;
+
+	const int64_t origin_us;	/* 进程启动时的CLOCK_BOOTTIME */
+
+	/**
+	 * now_us - 当前的CLOCK_BOOTTIME（微秒）
+	 */
+	static int64_t now_us(void);
+
+	/**
+	 * process_start_us - 进程启动时的CLOCK_BOOTTIME（微秒）
+	 *
+	 * 无法读取/proc时退回到第一次调用instance()的时间。
+	 */
+	static int64_t process_start_us(void);
+
+	/**
+	 * append_locked - 追加一个时间点（调用者持有mutex）
+	 */
+	void append_locked(std::string_view name);
+};
+
+#endif /* MIKUFY_STARTUP_TRACE_H */
@@ -0,0 +1,184 @@
+/*
+ * Mikufy v2.11-nova - 语法词法分析头文件
+ *
+ * 本文件定义了SyntaxLanguage类，为虚拟编辑器逐行生成语法高亮的
+ * 词法单元（注释、字符串、数字、关键字、预处理指令）。
+ *
+ * 主要功能:
+ * - 按语言名称（detect_language_simple() 的结果）选择规则，多种
+ *   语言共用 C 系、#注释系、标记语言等几类规则，只有关键字表不同
+ * - 每行的分析只依赖行内容和行首的词法状态（是否处于块注释、
+ *   多行字符串中），返回行尾的状态，TextBuffer 按行保存行首状态，
+ *   编辑后只需从修改的行重新分析到状态收敛为止
+ * - 只要状态不要词法单元时跳过关键字查找
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_SYNTAX_TOKENIZER_H
+#define MIKUFY_SYNTAX_TOKENIZER_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <cstdint>		/* uint8_t, uint32_t */
+#include <span>			/* std::span */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+#include <unordered_set>	/* std::unordered_set 关键字表 */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 文件开头（第一行行首）的词法状态 */
+#define SYNTAX_STATE_INITIAL	0
+
+/* 词法状态只使用低7位，最高位留给 TextBuffer 标记待确认的行 */
+#define SYNTAX_STATE_MASK	0x7f
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * SyntaxTokenKind - 词法单元类型（数值即 /api/get-lines 返回的类型）
+ */
+enum class SyntaxTokenKind : uint8_t {
+	COMMENT = 1,		/* 注释 */
+	STRING = 2,		/* 字符串、字符字面量 */
+	NUMBER = 3,		/* 数字字面量 */
+	KEYWORD = 4,		/* 关键字（标记语言中为标签名） */
+	PREPROCESSOR = 5	/* 预处理指令 */
+};
+
+/**
+ * SyntaxToken - 一行中的一个词法单元
+ *
+ * 偏移和长度是行内的字节数（UTF-8），发给前端前用
+ * syntax_tokens_to_utf16() 换算成 UTF-16 单位。
+ */
+struct SyntaxToken {
+	uint32_t start;		/* 起始偏移 */
+	uint32_t length;	/* 长度 */
+	SyntaxTokenKind kind;	/* 类型 */
+};
+
+/*
+ * ============================================================================
+ * SyntaxLanguage类定义
+ * ============================================================================
+ */
+
+/**
+ * SyntaxLanguage - 一种语言的词法规则
+ *
+ * 对象由 find() 返回，在程序运行期间一直有效，可以在多个线程中
+ * 同时使用。
+ */
+class SyntaxLanguage
+{
+public:
+	/* 词法规则 */
+	struct Rules {
+		std::string_view line_comment;	/* 行注释，如 "//" */
+		std::string_view line_comment_alt; /* 第二种行注释，如 PHP 的 "#" */
+		std::string_view block_open;	/* 块注释开头 */
+		std::string_view block_close;	/* 块注释结尾 */
+		std::string_view quotes;	/* 字符串的引号 */
+		bool escapes;			/* 反斜杠转义 */
+		bool triple_quotes;		/* """ 和 ''' 多行字符串 */
+		bool multiline_backtick;	/* 反引号字符串可以跨行 */
+		bool short_char_literals;	/* 单引号只用于短字符字面量（Rust 的生命周期） */
+		bool preprocessor;		/* 行首 # 是预处理指令 */
+		bool comment_after_space;	/* 行注释只在空白之后生效（shell 的 $#） */
+		bool case_insensitive;		/* 关键字不区分大小写 */
+		bool markup;			/* 标记语言（HTML/XML） */
+	};
+
+	/**
+	 * SyntaxLanguage - 构造函数
+	 *
+	 * @name: 语言名称
+	 * @rules: 词法规则
+	 * @keywords: 以空格分隔的关键字（不区分大小写时为小写），
+	 *            必须是静态字符串
+	 */
+	SyntaxLanguage(std::string name, const Rules &rules,
+		       std::string_view keywords);
+
+	/**
+	 * find - 按语言名称查找词法规则
+	 *
+	 * 返回值: 没有对应规则（包括 "plaintext"）时返回nullptr
+	 */
+	static const SyntaxLanguage *find(std::string_view name);
+
+	/**
+	 * name - 语言名称
+	 */
+	const std::string &name(void) const { return language_name; }
+
+	/**
+	 * lex_line - 分析一行
+	 *
+	 * @line: 行内容（不含换行符）
+	 * @state: 行首的词法状态
+	 * @tokens: 非空时把词法单元按顺序追加到末尾
+	 *
+	 * 返回值: 行尾（下一行行首）的词法状态
+	 */
+	uint8_t lex_line(std::string_view line, uint8_t state,
+			 std::vector<SyntaxToken> *tokens) const;
+
+private:
+	std::string language_name;
+	Rules rules;
+	std::unordered_set<std::string_view> keywords;
+
+	/**
+	 * lex_markup - 标记语言的 lex_line()
+	 */
+	uint8_t lex_markup(std::string_view line, uint8_t state,
+			   std::vector<SyntaxToken> *tokens) const;
+
+	/**
+	 * scan_string - 从 from 开始找字符串的结尾引号
+	 *
+	 * @end: 输出参数，结尾引号之后的位置；没有结尾引号时为行尾
+	 *
+	 * 返回值: 找到结尾引号返回true
+	 */
+	bool scan_string(std::string_view line, size_t from, char quote,
+			 size_t &end) const;
+
+	/**
+	 * is_keyword - 单词是否为关键字
+	 */
+	bool is_keyword(std::string_view word) const;
+};
+
+/**
+ * syntax_tokens_to_utf16 - 把词法单元的字节偏移换算成 UTF-16 单位
+ *
+ * @line: 行内容
+ * @tokens: 按起始偏移排列、互不重叠的词法单元
+ * @out: 输出参数，换算后的词法单元（先清空）
+ *
+ * 整行只遍历一次。
+ */
+void syntax_tokens_to_utf16(std::string_view line,
+			    std::span<const SyntaxToken> tokens,
+			    std::vector<SyntaxToken> &out);
+
+#endif /* MIKUFY_SYNTAX_TOKENIZER_H */
@@ -9,7 +9,7 @@
  * - epoll事件驱动：高性能I/O多路复用，支持大量并发进程
  * - 非阻塞I/O：所有I/O操作都设置为非阻塞模式
  * - 独立IO线程：使用std::jthread持续读取进程输出，不阻塞UI线程
- * - 环形缓冲区：高效管理高频输出，支持万行级别输出
+ * - 分页回滚缓冲区：按需分配、每进程上限、可换出到磁盘、按序号续读
  * - RAII资源管理：自动清理资源，无内存泄漏
  * - C++23特性：std::expected, std::jthread, concepts, std::format
  *
@@ -41,7 +41,8 @@
 #include <format>
 #include <ranges>
 #include <concepts>
-#include <array>
+#include <span>
+#include <string_view>
 
 /*
  * ============================================================================
@@ -52,6 +53,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <signal.h>
@@ -59,6 +62,8 @@
 #include <pty.h>
 #include <time.h>
 
+#include "scrollback.h"
+
 /*
  * ============================================================================
  * 常量定义
@@ -68,12 +73,15 @@
 /* 最大事件数 */
 #define MAX_EPOLL_EVENTS	64
 
-/* 缓冲区大小（环形缓冲区） */
-#define RING_BUFFER_SIZE	(1 << 20) /* 1MB */
-
-/* 超时时间（毫秒） */
+/* 有进程等待清理时epoll_wait的超时时间（毫秒），否则无限等待 */
 #define EPOLL_TIMEOUT_MS	100
 
+/* 进程结束后，未被取走的输出最多保留的时间（秒） */
+#define TERMINAL_OUTPUT_LINGER_SEC	5
+
+/* 每个进程等待写入PTY的输入最多保留的字节数，超出时拒绝新的输入 */
+#define TERMINAL_INPUT_QUEUE_LIMIT	(1024 * 1024)
+
 /* 终端尺寸 */
 #define TERMINAL_DEFAULT_COLS	80
 #define TERMINAL_DEFAULT_ROWS	24
@@ -85,6 +93,7 @@
  */
 
 class TerminalManager;
+class TerminalProcess;
 
 /*
  * ============================================================================
@@ -130,51 +139,21 @@ struct ProcessInfo {
 			start_time(0), exit_code(-1) {}
 };
 
-/*
- * ============================================================================
- * RingBuffer类 - 环形缓冲区
- * ============================================================================
- */
-
 /**
- * RingBuffer - 固定大小环形缓冲区
+ * EpollTag - epoll事件来源
  *
- * 使用无锁设计，支持高效的高频数据写入和读取。
+ * epoll_event.data.ptr指向此标签，IO线程由此直接定位到进程，
+ * 不需要持锁遍历进程表查找fd。
  */
-class RingBuffer {
-public:
-	RingBuffer() : head_(0), tail_(0), full_(false) {}
-
-	/**
-	 * write - 写入数据到缓冲区
-	 */
-	size_t write(const char *data, size_t size);
-
-	/**
-	 * read - 从缓冲区读取数据
-	 */
-	size_t read(char *buffer, size_t size);
-
-	/**
-	 * available - 获取可读取的字节数
-	 */
-	size_t available() const;
-
-	/**
-	 * capacity - 获取缓冲区容量
-	 */
-	size_t capacity() const;
-
-	/**
-	 * clear - 清空缓冲区
-	 */
-	void clear();
-
-private:
-	std::array<char, RING_BUFFER_SIZE> buffer_;
-	size_t head_;		/* 写指针 */
-	size_t tail_;		/* 读指针 */
-	bool full_;		/* 是否已满 */
+struct EpollTag {
+	enum class Kind {
+		PTY,		/* PTY可读，或有待写入的输入时可写 */
+		EXIT,		/* pidfd可读：进程已退出 */
+		WAKE		/* eventfd：唤醒IO线程 */
+	};
+
+	Kind kind;
+	TerminalProcess *process;	/* WAKE时为nullptr */
 };
 
 /*
@@ -190,8 +169,21 @@ private:
  */
 class TerminalProcess {
 public:
+	/**
+	 * OutputVisitor - 输出访问回调，参数是回滚缓冲区内的一段连续数据
+	 */
+	using OutputVisitor = std::function<void(std::string_view chunk)>;
+
+	/**
+	 * TerminalProcess - 构造函数
+	 *
+	 * @scrollback_limit: 输出在内存中最多保留的字节数
+	 * @spill_limit: 输出换出到磁盘最多保留的字节数，0表示不换出
+	 */
 	TerminalProcess(pid_t pid, int pty_fd, const std::string &command,
-			const std::string &working_dir);
+			const std::string &working_dir,
+			size_t scrollback_limit = SCROLLBACK_DEFAULT_LIMIT,
+			size_t spill_limit = SCROLLBACK_DEFAULT_SPILL_LIMIT);
 	~TerminalProcess();
 
 	/* 禁止拷贝 */
@@ -204,6 +196,8 @@ public:
 
 	/**
 	 * set_size - 设置终端尺寸
+	 *
+	 * 尺寸没有变化时不调用ioctl()，也不会向进程发送SIGWINCH。
 	 */
 	void set_size(const TerminalSize &size);
 
@@ -214,8 +208,22 @@ public:
 
 	/**
 	 * send_input - 发送输入到进程
+	 *
+	 * 没有排队的输入时直接write()，PTY写不下的部分放入输入队列，
+	 * 并为PTY注册EPOLLOUT，由IO线程在可写时继续写入。调用者不会
+	 * 因为进程读得慢而阻塞。
+	 *
+	 * 返回值: 已写入或已排队返回空值；进程已结束、输入队列已满
+	 *         （见TERMINAL_INPUT_QUEUE_LIMIT）或写入出错返回错误
 	 */
-	std::expected<void, std::string> send_input(const std::string &input);
+	std::expected<void, std::string> send_input(std::string_view input);
+
+	/**
+	 * flush_input - 把排队的输入写入PTY（PTY可写时由IO线程调用）
+	 *
+	 * 队列写完后取消EPOLLOUT。PTY已关闭时丢弃队列。
+	 */
+	void flush_input();
 
 	/**
 	 * read_output - 读取输出（非阻塞）
@@ -223,15 +231,68 @@ public:
 	std::expected<TerminalOutput, std::string> read_output();
 
 	/**
-	 * read_from_pty - 从PTY读取数据到缓冲区（由IO线程调用）
+	 * consume_output - 从消费位置开始直接取走输出
+	 *
+	 * 回调收到的视图指向缓冲区内部，只在回调内有效。
+	 * 读取方由TerminalManager的processes_mutex_串行化。
+	 *
+	 * @max_bytes: 最多取走的字节数
+	 * @visitor: 输出访问回调，每段连续数据调用一次
+	 *
+	 * 返回值: 取走的字节数
+	 */
+	size_t consume_output(size_t max_bytes, const OutputVisitor &visitor);
+
+	/**
+	 * read_output_from - 从指定序号开始读取输出，并把消费位置前移到读完处
+	 *
+	 * @seq: 起始序号，早于仍保留的最早输出时从最早输出开始
+	 * @max_bytes: 最多读取的字节数
+	 * @visitor: 读取回调，参数是数据段的起始序号和内容
+	 *
+	 * 返回值: 读到的最后一个字节之后的序号
 	 */
-	void read_from_pty();
+	uint64_t read_output_from(uint64_t seq, size_t max_bytes,
+				  const Scrollback::SeqVisitor &visitor);
+
+	/**
+	 * output_cursor - 获取消费位置（尚未被读取的第一个字节的序号）
+	 */
+	uint64_t output_cursor() const;
+
+	/**
+	 * read_from_pty - 从PTY读取数据到缓冲区（由IO线程调用，生产者）
+	 *
+	 * read()直接写入回滚缓冲区当前页的空闲区域，不加锁。未读输出
+	 * 达到上限时停止读取（不丢弃数据），消费位置前移后重新激活PTY
+	 * 的epoll事件，背压因此一直传递到子进程的write()。
+	 *
+	 * 返回值: 读到新数据或PTY已关闭返回true
+	 */
+	bool read_from_pty();
+
+	/**
+	 * set_epoll_fd - 记录PTY所在的epoll实例，用于解除背压后重新激活
+	 */
+	void set_epoll_fd(int epoll_fd);
 
 	/**
 	 * is_running - 检查进程是否运行
 	 */
 	bool is_running() const;
 
+	/**
+	 * mark_exited - 记录进程已退出（pidfd可读时由IO线程调用）
+	 */
+	void mark_exited();
+
+	/**
+	 * should_reap - 检查进程是否可以被清理
+	 *
+	 * 进程已结束且输出已被取走，或结束已超过TERMINAL_OUTPUT_LINGER_SEC秒。
+	 */
+	bool should_reap(time_t now);
+
 	/**
 	 * get_pid - 获取进程ID
 	 */
@@ -242,6 +303,17 @@ public:
 	 */
 	int get_pty_fd() const;
 
+	/**
+	 * get_pid_fd - 获取pidfd，内核不支持pidfd_open时为-1
+	 */
+	int get_pid_fd() const;
+
+	/**
+	 * pty_tag / exit_tag - 注册到epoll时使用的事件标签
+	 */
+	EpollTag *pty_tag();
+	EpollTag *exit_tag();
+
 	/**
 	 * get_command - 获取执行的命令
 	 */
@@ -264,14 +336,52 @@ public:
 
 private:
 	mutable ProcessInfo info_;
-	RingBuffer output_buffer_;
-	RingBuffer error_buffer_;
-	mutable std::mutex mutex_;
+	Scrollback output_;		/* 输出历史（PTY合并了stdout和stderr） */
+	mutable std::mutex mutex_;	/* 保护info_，输出缓冲区不需要 */
+	std::atomic<bool> throttled_;	/* 未读输出已达上限，PTY中还有未读数据 */
+	time_t finished_time_;		/* 发现进程结束的时间，0表示未结束 */
+	int pid_fd_;			/* 进程退出时可读的pidfd */
+	int epoll_fd_;			/* PTY所在的epoll实例 */
+	EpollTag pty_tag_;		/* PTY事件标签 */
+	EpollTag exit_tag_;		/* 退出事件标签 */
+
+	std::mutex input_mutex_;	/* 保护输入队列和PTY的epoll事件掩码 */
+	std::string input_queue_;	/* 等待写入PTY的输入 */
+	size_t input_offset_;		/* input_queue_中已写入的字节数 */
 
 	/**
 	 * set_nonblocking - 设置文件描述符为非阻塞
 	 */
 	void set_nonblocking(int fd);
+
+	/**
+	 * rearm_pty - 重新激活PTY的边沿触发事件
+	 */
+	void rearm_pty();
+
+	/**
+	 * update_pty_events_locked - 按输入队列是否为空设置PTY的事件掩码
+	 *
+	 * 调用者持有input_mutex_。
+	 */
+	void update_pty_events_locked();
+
+	/**
+	 * write_queued_locked - 尽量写出输入队列（调用者持有input_mutex_）
+	 *
+	 * 返回值: 成功（包括PTY暂时写不下）返回0，否则返回errno
+	 */
+	int write_queued_locked();
+
+	/**
+	 * is_running_locked - is_running() 的实现（调用者持有锁）
+	 */
+	bool is_running_locked() const;
+
+	/**
+	 * resume_if_throttled - 消费位置前移后解除PTY的背压
+	 */
+	void resume_if_throttled();
 };
 
 /*
@@ -292,6 +402,14 @@ public:
 	 */
 	using OutputCallback = std::function<void(pid_t, const TerminalOutput &)>;
 
+	/**
+	 * OutputReadyCallback - 输出就绪通知回调类型
+	 *
+	 * 进程有新输出或已被清理时在IO线程中调用，回调中应只做通知，
+	 * 数据由接收方通过get_output()按自己的速度取走。
+	 */
+	using OutputReadyCallback = std::function<void(pid_t)>;
+
 	TerminalManager();
 	~TerminalManager();
 
@@ -327,15 +445,49 @@ public:
 
 	/**
 	 * send_input - 发送输入到进程
+	 *
+	 * 不会阻塞，见TerminalProcess::send_input()。
 	 */
 	std::expected<void, std::string> send_input(
-			pid_t pid, const std::string &input);
+			pid_t pid, std::string_view input);
 
 	/**
 	 * get_output - 获取进程输出
 	 */
 	std::expected<TerminalOutput, std::string> get_output(pid_t pid);
 
+	/**
+	 * read_output_from - 不经拷贝地从指定序号读取进程输出
+	 *
+	 * 断线重连的客户端用上次读到的序号继续读取，不会丢失或重复输出。
+	 * 读完后消费位置前移到返回的序号，get_output()不会再返回这部分。
+	 *
+	 * @pid: 进程ID
+	 * @seq: 起始序号
+	 * @max_bytes: 最多读取的字节数
+	 * @visitor: 读取回调，视图只在回调内有效
+	 *
+	 * 返回值: 读到的最后一个字节之后的序号，或进程不存在的错误
+	 */
+	std::expected<uint64_t, std::string> read_output_from(
+			pid_t pid, uint64_t seq, size_t max_bytes,
+			const Scrollback::SeqVisitor &visitor);
+
+	/**
+	 * get_output_cursor - 获取进程输出的消费位置
+	 *
+	 * 返回值: 尚未被读取的第一个字节的序号，或进程不存在的错误
+	 */
+	std::expected<uint64_t, std::string> get_output_cursor(pid_t pid);
+
+	/**
+	 * set_scrollback_limits - 设置新进程的输出保留上限
+	 *
+	 * @memory_limit: 每个进程在内存中最多保留的字节数
+	 * @spill_limit: 每个进程换出到磁盘最多保留的字节数，0表示不换出
+	 */
+	void set_scrollback_limits(size_t memory_limit, size_t spill_limit);
+
 	/**
 	 * set_terminal_size - 设置终端尺寸
 	 */
@@ -367,6 +519,13 @@ public:
 	 */
 	void set_output_callback(OutputCallback callback);
 
+	/**
+	 * set_output_ready_callback - 设置输出就绪通知回调
+	 *
+	 * 必须在start()之前设置。
+	 */
+	void set_output_ready_callback(OutputReadyCallback callback);
+
 private:
 	/* epoll文件描述符 */
 	int epoll_fd_;
@@ -383,9 +542,29 @@ private:
 	/* 互斥锁 */
 	std::mutex processes_mutex_;
 
+	/* 唤醒IO线程的eventfd（停止、终止进程时写入） */
+	int wake_fd_;
+	EpollTag wake_tag_;
+
+	/* 已结束（或已请求终止）、等待清理的进程，受processes_mutex_保护 */
+	std::vector<pid_t> finished_;
+
+	/* 没有pidfd、需要定期waitpid检查的进程数，受processes_mutex_保护 */
+	size_t unwatched_count_;
+
+	/* 有待清理或需轮询的进程时epoll_wait才带超时，仅IO线程访问 */
+	bool needs_sweep_;
+
+	/* 新进程的输出保留上限 */
+	std::atomic<size_t> scrollback_limit_;
+	std::atomic<size_t> spill_limit_;
+
 	/* 输出回调 */
 	OutputCallback output_callback_;
 
+	/* 输出就绪通知回调 */
+	OutputReadyCallback output_ready_callback_;
+
 	/**
 	 * io_thread_func - IO线程函数
 	 */
@@ -398,9 +577,17 @@ private:
 
 	/**
 	 * cleanup_finished_processes - 清理已完成的进程
+	 *
+	 * 只检查finished_中的进程（以及没有pidfd的进程），
+	 * 不随进程总数增长。
 	 */
 	void cleanup_finished_processes();
 
+	/**
+	 * wake_io_thread - 唤醒阻塞在epoll_wait中的IO线程
+	 */
+	void wake_io_thread();
+
 	/**
 	 * setup_signal_handler - 设置SIGCHLD信号处理器
 	 */
@@ -11,7 +11,7 @@
  *
  * 主要功能:
  *   - 使用 mmap 高效读取大文件
- *   - O(log n) 的插入和删除操作
+ *   - Piece 保存在红黑树中，O(log n) 的定位、插入和删除操作
  *   - 高效的行范围查询
  *   - 支持大文件的虚拟化渲染
  *
@@ -31,14 +31,22 @@
  */
 
 #include "main.h"
+#include "piece_tree.h"		/* PieceTree 红黑树 */
+#include "syntax_tokenizer.h"	/* SyntaxLanguage 逐行词法分析 */
 #include <sys/mman.h>		/* mmap(), munmap() */
 #include <sys/stat.h>		/* stat() */
 #include <fcntl.h>		/* open(), O_RDONLY */
 #include <unistd.h>		/* close() */
-#include <deque>			/* std::deque 用于 Piece 列表 */
+#include <pthread.h>		/* pthread_rwlock_t 写者优先读写锁 */
 #include <algorithm>		/* std::lower_bound */
+#include <chrono>		/* std::chrono::steady_clock 撤销合并计时 */
+#include <deque>		/* std::deque 撤销历史 */
 #include <expected>		/* C++23 std::expected 错误处理 */
 #include <format>		/* C++23 std::format 字符串格式化 */
+#include <functional>		/* std::function 行访问回调 */
+#include <shared_mutex>		/* std::shared_lock */
+#include <span>			/* std::span 行分段视图 */
+#include <string_view>		/* std::string_view 零拷贝视图 */
 
 /*
  * ============================================================================
@@ -49,15 +57,49 @@
 /* 最大文件大小（1GB），超过此大小将拒绝加载 */
 #define MAX_FILE_SIZE		(1024LL * 1024LL * 1024LL)
 
-/* 添加缓冲区初始大小（1MB） */
-#define INITIAL_ADD_BUFFER_SIZE	(1024 * 1024)
-
-/* 添加缓冲区扩展大小（1MB） */
-#define ADD_BUFFER_GROW_SIZE	(1024 * 1024)
+/* 添加缓冲区：每个块的大小（1MB），逻辑偏移的高位即块号 */
+#define ADD_CHUNK_SHIFT		20
+#define ADD_CHUNK_SIZE		(1UL << ADD_CHUNK_SHIFT)
 
 /* Piece 阈值：超过此大小的 Piece 不再合并 */
 #define MAX_PIECE_SIZE		(64 * 1024)
 
+/* 换行符索引：超过此大小的区域分块后多线程扫描（8MB） */
+#define PARALLEL_INDEX_MIN_SIZE	(8 * 1024 * 1024)
+
+/* 换行符索引：多线程扫描的最大线程数 */
+#define MAX_INDEX_THREADS	8
+
+/* 换行符索引：超过此大小的文件在后台建立完整索引（64MB） */
+#define ASYNC_INDEX_MIN_SIZE	(64 * 1024 * 1024)
+
+/* 换行符索引：后台建立索引时同步扫描的文件开头部分（4MB） */
+#define INDEX_PREFIX_SIZE	(4 * 1024 * 1024)
+
+/* 换行符索引：扫描时每隔此大小检查一次取消标志（4MB） */
+#define INDEX_CANCEL_CHECK_SIZE	(4 * 1024 * 1024)
+
+/* 压缩索引：每隔此数量的换行符保留一个检查点 */
+#define LINE_CHECKPOINT_INTERVAL	1024
+
+/* 语法状态：行首状态的最高位，表示该行的状态需要重新确认 */
+#define SYNTAX_STATE_DIRTY	0x80
+
+/* 撤销历史的默认内存上限（16MB），超过后丢弃最早的记录 */
+#define UNDO_MEMORY_LIMIT	(16 * 1024 * 1024)
+
+/* 撤销合并：间隔不超过此时间（毫秒）的连续输入/删除合并为一步 */
+#define UNDO_COALESCE_MS	1000
+
+/* 撤销合并：只合并不超过此字节数且不含换行符的编辑（单次按键） */
+#define UNDO_COALESCE_MAX_BYTES	16
+
+/* 保存：不小于此大小的 ORIGINAL Piece 用 copy_file_range() 在内核中复制（256KB） */
+#define SAVE_COPY_RANGE_MIN	(256 * 1024)
+
+/* 保存：单次 writev() 最多提交的 Piece 数 */
+#define SAVE_MAX_IOVECS		1024
+
 /*
  * ============================================================================
  * 数据结构定义
@@ -65,64 +107,160 @@
  */
 
 /**
- * PieceType - Piece 类型枚举
+ * RwMutex - 写者优先的读写锁
+ *
+ * std::shared_mutex 在 glibc 上是读者优先的 pthread_rwlock：只要
+ * 读者的共享锁不断重叠（多个视图持续刷新），编辑就永远拿不到独占
+ * 锁。这里使用 PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP，有写者
+ * 等待时新的读者排在它后面。
+ *
+ * 满足 SharedMutex 要求，可以与 std::shared_lock、std::unique_lock
+ * 和 std::condition_variable_any 一起使用。
  *
- * 定义 Piece 指向的缓冲区类型
+ * 注意: 同一线程不能重复获取共享锁（有写者等待时会死锁）。
  */
-enum class PieceType {
-	ORIGINAL,	/* 指向原始缓冲区（文件内容） */
-	ADD		/* 指向添加缓冲区（用户编辑内容） */
+class RwMutex
+{
+public:
+	RwMutex(void)
+	{
+		pthread_rwlockattr_t attr;
+		pthread_rwlockattr_init(&attr);
+		pthread_rwlockattr_setkind_np(&attr,
+			PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+		pthread_rwlock_init(&rwlock, &attr);
+		pthread_rwlockattr_destroy(&attr);
+	}
+
+	~RwMutex(void) { pthread_rwlock_destroy(&rwlock); }
+
+	RwMutex(const RwMutex &) = delete;
+	RwMutex &operator=(const RwMutex &) = delete;
+
+	void lock(void) { pthread_rwlock_wrlock(&rwlock); }
+	bool try_lock(void) { return pthread_rwlock_trywrlock(&rwlock) == 0; }
+	void unlock(void) { pthread_rwlock_unlock(&rwlock); }
+
+	void lock_shared(void) { pthread_rwlock_rdlock(&rwlock); }
+	bool try_lock_shared(void)
+	{
+		return pthread_rwlock_tryrdlock(&rwlock) == 0;
+	}
+	void unlock_shared(void) { pthread_rwlock_unlock(&rwlock); }
+
+private:
+	pthread_rwlock_t rwlock;
 };
 
 /**
- * Piece - 文本段
- *
- * Piece Table 的基本单元，表示文本的一个连续段
+ * AddArena - 只追加的分块添加缓冲区
  *
- * 成员说明:
- * @type: Piece 类型（ORIGINAL 或 ADD）
- * @offset: 在缓冲区中的起始偏移
- * @length: 段长度（字符数）
+ * 追加的内容写入 ADD_CHUNK_SIZE 大小的块，写满后分配新块，已有
+ * 内容从不移动：扩展不需要拷贝，指向添加缓冲区的 string_view 在
+ * 编辑之后仍然有效（直到 clear()）。
  *
- * 设计要点:
- *   - 使用 offset + length 引用缓冲区内容，避免字符串拷贝
- *   - 支持高效的拼接和分割操作
+ * 对外是一段连续的逻辑偏移，偏移按 ADD_CHUNK_SHIFT 拆成块号和块内
+ * 偏移，定位是 O(1)。每次追加的内容在内存中连续：当前块剩余空间
+ * 不够时跳到下一个块，超过一个块的内容单独分配，占用多个连续的
+ * 块号。跳过的块尾不会被引用，浪费小于一次追加的长度。
  */
-struct Piece {
-	PieceType type;		/* Piece 类型 */
-	size_t offset;		/* 缓冲区偏移 */
-	size_t length;		/* 段长度 */
+class AddArena
+{
+public:
+	AddArena(void) : used(0), block_end(0) {}
+
+	AddArena(const AddArena &) = delete;
+	AddArena &operator=(const AddArena &) = delete;
+
+	/**
+	 * append - 追加内容
+	 *
+	 * @text: 要追加的内容（不能为空）
+	 *
+	 * 返回值: 内容的逻辑偏移
+	 */
+	size_t append(std::string_view text);
+
+	/**
+	 * data - 逻辑偏移对应的内存地址
+	 */
+	const char *data(size_t offset) const
+	{
+		return slots[offset >> ADD_CHUNK_SHIFT].base +
+		       (offset & (ADD_CHUNK_SIZE - 1));
+	}
 
 	/**
-	 * 默认构造函数
+	 * is_allocation_start - 偏移是否为一次分配的开头
+	 *
+	 * 逻辑上相邻的两段内容只有在这种情况下才不在同一次分配，
+	 * 合并 Piece 前需要检查。
 	 */
-	Piece(void) : type(PieceType::ORIGINAL), offset(0), length(0)
+	bool is_allocation_start(size_t offset) const
 	{
+		return (offset & (ADD_CHUNK_SIZE - 1)) == 0 &&
+		       (offset >> ADD_CHUNK_SHIFT) < slots.size() &&
+		       slots[offset >> ADD_CHUNK_SHIFT].first;
 	}
 
 	/**
-	 * 构造函数
+	 * size - 逻辑末尾（下一次追加的起点之前）
+	 */
+	size_t size(void) const { return used; }
+
+	/**
+	 * memory_usage - 已分配的内存（字节）
 	 */
-	Piece(PieceType t, size_t off, size_t len)
-		: type(t), offset(off), length(len)
+	size_t memory_usage(void) const
 	{
+		return slots.size() * ADD_CHUNK_SIZE;
 	}
+
+	/**
+	 * clear - 释放所有块
+	 */
+	void clear(void);
+
+private:
+	/* 每个块号对应的内存，first表示是一次分配的第一个块 */
+	struct Slot {
+		char *base;
+		bool first;
+	};
+
+	std::vector<std::unique_ptr<char[]>> blocks;	/* 所有分配 */
+	std::vector<Slot> slots;			/* 块号 -> 内存 */
+	size_t used;		/* 已使用的逻辑末尾 */
+	size_t block_end;	/* 当前分配的逻辑末尾 */
 };
 
 /**
- * LineInfo - 行信息
- *
- * 表示一行文本的元数据信息，用于快速定位和渲染
+ * EditRecord - 撤销历史中的一次编辑
  *
- * 成员说明:
- * @start_index: 行在文本中的起始索引
- * @length: 行长度（字符数）
- * @piece_index: 行起始位置所在的 Piece 索引
+ * 每次编辑都看作"在 pos 处删除 removed，再插入 inserted"。两边都
+ * 只保存 Piece：原始映射和只追加的添加缓冲区中的内容不会再改变，
+ * 撤销和重做只是把一组 Piece 换回另一组，代价与原来的编辑相同，
+ * 与删除或插入的文本大小无关。
  */
-struct LineInfo {
-	size_t start_index;	/* 行起始索引 */
-	size_t length;		/* 行长度 */
-	size_t piece_index;	/* 起始 Piece 索引 */
+struct EditRecord {
+	size_t pos;			/* 编辑位置 */
+	std::vector<Piece> removed;	/* 被删除的内容 */
+	std::vector<Piece> inserted;	/* 插入的内容 */
+	size_t removed_length;		/* 被删除内容的字节数 */
+	size_t inserted_length;		/* 插入内容的字节数 */
+	bool coalescable;		/* 单次按键大小，之后的按键可以合并进来 */
+	std::chrono::steady_clock::time_point time; /* 最后一次合并的时间 */
+
+	EditRecord(void)
+		: pos(0), removed_length(0), inserted_length(0),
+		  coalescable(false) {}
+
+	/* 计入撤销历史内存上限的字节数 */
+	size_t charge(void) const
+	{
+		return sizeof(EditRecord) +
+		       (removed.capacity() + inserted.capacity()) * sizeof(Piece);
+	}
 };
 
 /*
@@ -138,9 +276,15 @@ struct LineInfo {
  *
  * 设计特点:
  *   - 使用 mmap 映射原始文件，避免大文件一次性加载到内存
- *   - Piece Table 架构提供 O(log n) 的插入和删除操作
- *   - 行缓存机制加速行范围查询
- *   - 线程安全：使用互斥锁保护所有操作
+ *   - Piece 树（红黑树）维护子树字节数和换行符数，按位置定位
+ *     Piece 为 O(log n)，不随编辑次数退化
+ *   - 行索引由 Piece 树的换行符统计隐式维护，编辑只扫描新插入的文本，
+ *     不需要重建整个行表
+ *   - 添加缓冲区是分块的 AddArena，扩展时已有内容不移动
+ *   - 线程安全：读写锁保护所有操作。查询（get_lines、visit_lines、
+ *     save 等）持有共享锁，多个视图可以同时读取；编辑持有独占锁
+ *   - 设置语言后按行保存行首的词法状态，编辑只把修改的行标记为
+ *     待确认，重新分析从修改处开始，状态与保存的一致即停止
  *
  * 使用示例:
  * @code
@@ -154,10 +298,40 @@ struct LineInfo {
 class TextBuffer
 {
 public:
+	/**
+	 * LineVisitor - 行访问回调
+	 *
+	 * @line: 行号（从0开始）
+	 * @fragments: 行内容的分段视图（不含换行符），按顺序拼接即为
+	 *             整行；跨越多个 Piece 的行会有多个分段，空行没有分段
+	 */
+	using LineVisitor = std::function<void(
+		size_t line, std::span<const std::string_view> fragments)>;
+
+	/**
+	 * ChunkVisitor - 内容块访问回调
+	 *
+	 * @chunk: 一个 Piece 的内容，按文本顺序依次给出
+	 *
+	 * 返回值: 继续遍历返回true，返回false时停止
+	 */
+	using ChunkVisitor = std::function<bool(std::string_view chunk)>;
+
+	/**
+	 * TokenVisitor - 带词法单元的行访问回调
+	 *
+	 * @line: 行号（从0开始）
+	 * @text: 行内容（不含换行符），跨越多个 Piece 的行是拼接后的副本
+	 * @tokens: 行内的词法单元（字节偏移），未设置语言时为空
+	 */
+	using TokenVisitor = std::function<void(
+		size_t line, std::string_view text,
+		std::span<const SyntaxToken> tokens)>;
+
 	/**
 	 * TextBuffer - 构造函数
 	 *
-	 * 初始化文本缓冲区，预分配添加缓冲区。
+	 * 初始化文本缓冲区。添加缓冲区在第一次编辑时才分配。
 	 */
 	TextBuffer(void);
 
@@ -195,6 +369,9 @@ public:
 	 * 返回值: 加载成功返回true，失败返回false
 	 *
 	 * 注意: 此方法会清空之前的缓冲区内容。
+	 *       超过 ASYNC_INDEX_MIN_SIZE 的文件只同步索引开头部分，
+	 *       剩余部分在后台线程中建立索引，期间 get_line_count()
+	 *       返回已索引的行数，编辑操作会等待索引完成。
 	 */
 	bool load_file(const std::string &path);
 
@@ -218,6 +395,13 @@ public:
 	 */
 	size_t get_line_count(void);
 
+	/**
+	 * is_indexing - 是否正在后台建立换行符索引
+	 *
+	 * 返回值: 索引尚未完成返回true
+	 */
+	bool is_indexing(void);
+
 	/**
 	 * get_char_count - 获取总字符数
 	 *
@@ -258,6 +442,73 @@ public:
 	bool get_lines(size_t start_line, size_t end_line,
 		       std::vector<std::string> &lines);
 
+	/**
+	 * visit_lines - 零拷贝遍历指定行范围
+	 *
+	 * 只加锁一次、只定位一次起始 Piece，然后顺序遍历整个窗口，
+	 * 把每一行以指向 mmap 区域/添加缓冲区的视图交给回调，
+	 * 不分配任何行字符串。
+	 *
+	 * @start_line: 起始行号（包含）
+	 * @end_line: 结束行号（不包含）
+	 * @visitor: 行访问回调
+	 *
+	 * 返回值: 成功返回true，范围为空返回false
+	 *
+	 * 注意: 回调在持有锁时执行，视图只在回调内有效；回调中不能
+	 *       调用本对象的其他方法。
+	 */
+	bool visit_lines(size_t start_line, size_t end_line,
+			 const LineVisitor &visitor);
+
+	/**
+	 * visit_chunks - 零拷贝按顺序遍历所有 Piece 的内容
+	 *
+	 * 整个遍历期间持有共享锁，回调中的视图在回调返回前有效。
+	 * 用于需要扫描全部内容的场合（如全文搜索），不经过行索引。
+	 *
+	 * @visitor: 内容块访问回调
+	 *
+	 * 返回值: 遍历完所有 Piece 返回true，被回调中止返回false
+	 *
+	 * 注意: 回调中不能调用本缓冲区的其他方法。
+	 */
+	bool visit_chunks(const ChunkVisitor &visitor);
+
+	/**
+	 * visit_tokens - 遍历指定行范围及其词法单元
+	 *
+	 * 词法分析需要行首的状态：从第一个待确认的行开始向后分析（只
+	 * 计算状态，不生成词法单元），遇到与保存的状态相同、且之后没有
+	 * 修改过的行时直接跳到下一处修改，直到 start_line；窗口内的行
+	 * 生成词法单元并顺便保存各行行首的状态。未修改的区域不会被
+	 * 重复分析，第一次跳到文件深处时需要把前面的部分分析一遍。
+	 *
+	 * @start_line: 起始行号（包含）
+	 * @end_line: 结束行号（不包含）
+	 * @visitor: 行访问回调
+	 *
+	 * 返回值: 成功返回true，范围为空返回false
+	 *
+	 * 注意: 同一缓冲区的多个 visit_tokens() 互相串行（共用状态表）；
+	 *       回调中不能调用本对象的其他方法。
+	 */
+	bool visit_tokens(size_t start_line, size_t end_line,
+			  const TokenVisitor &visitor);
+
+	/**
+	 * set_language - 设置语法高亮的语言
+	 *
+	 * @language: 词法规则，nullptr 表示纯文本；与当前不同时丢弃
+	 *            已保存的状态
+	 */
+	void set_language(const SyntaxLanguage *language);
+
+	/**
+	 * get_language - 当前的词法规则（可能为nullptr）
+	 */
+	const SyntaxLanguage *get_language(void);
+
 	/**
 	 * get_text - 获取指定索引范围的文本
 	 *
@@ -318,6 +569,124 @@ public:
 	 */
 	bool replace(size_t start_pos, size_t end_pos, const std::string &text);
 
+	/* ====================================================================
+	 * 文件保存
+	 * ==================================================================== */
+
+	/**
+	 * save - 把当前内容写入文件
+	 *
+	 * 按文本顺序遍历 Piece：ADD Piece 和较小的 ORIGINAL Piece 直接
+	 * 作为 iovec 用 writev() 写出，较大的 ORIGINAL Piece 用
+	 * copy_file_range() 从原文件复制，不经过用户空间。内容先写入
+	 * 目标目录下的临时文件，fsync() 后重命名为目标文件。
+	 *
+	 * @path: 目标文件路径，为空时保存到加载的文件
+	 *
+	 * 返回值: 成功返回写入的字节数，失败返回错误信息
+	 *
+	 * 注意: 保存到加载的文件时，原文件被替换为新的 inode，原来的
+	 *       映射仍然有效，保存后可以继续编辑和再次保存。
+	 *       只在写出内容期间持有锁，fsync() 时不阻塞其他操作。
+	 */
+	std::expected<size_t, std::string> save(const std::string &path);
+
+	/* ====================================================================
+	 * 撤销和重做
+	 * ==================================================================== */
+
+	/**
+	 * undo - 撤销最近一次编辑
+	 *
+	 * @cursor: 输出参数，撤销后的光标位置（恢复的内容之后）
+	 *
+	 * 返回值: 有可撤销的编辑返回true
+	 */
+	bool undo(size_t &cursor);
+
+	/**
+	 * redo - 重做最近一次撤销的编辑
+	 *
+	 * @cursor: 输出参数，重做后的光标位置（插入的内容之后）
+	 *
+	 * 返回值: 有可重做的编辑返回true
+	 */
+	bool redo(size_t &cursor);
+
+	/**
+	 * can_undo - 是否有可撤销的编辑
+	 */
+	bool can_undo(void);
+
+	/**
+	 * can_redo - 是否有可重做的编辑
+	 */
+	bool can_redo(void);
+
+	/**
+	 * break_undo_group - 结束当前的合并
+	 *
+	 * 之后的编辑即使紧接着上一次也单独成为一步（例如光标移动之后）。
+	 */
+	void break_undo_group(void);
+
+	/**
+	 * set_undo_limit - 设置撤销历史的内存上限
+	 *
+	 * @bytes: 上限（字节），超过时从最早的记录开始丢弃
+	 */
+	void set_undo_limit(size_t bytes);
+
+	/**
+	 * undo_memory_usage - 撤销历史当前占用的内存（字节）
+	 */
+	size_t undo_memory_usage(void);
+
+	/* ====================================================================
+	 * 公共方法 - 内存管理
+	 * ==================================================================== */
+
+	/**
+	 * compact - 压缩后台缓冲区占用的内存
+	 *
+	 * 把原始缓冲区的完整换行符索引换成每 LINE_CHECKPOINT_INTERVAL
+	 * 个换行符一个的检查点，并用 MADV_DONTNEED 释放映射的驻留页，
+	 * 同时丢弃语法状态（重新获得焦点后按需重建）。
+	 * 压缩后仍可读取，行定位从检查点开始用 memchr 扫描；编辑和
+	 * restore_index() 会先恢复完整索引。
+	 *
+	 * 返回值: 压缩成功返回true；后台索引未完成或已压缩返回false
+	 */
+	bool compact(void);
+
+	/**
+	 * restore_index - 恢复完整的换行符索引（标签重新获得焦点时）
+	 *
+	 * 返回值: 之前处于压缩状态返回true
+	 */
+	bool restore_index(void);
+
+	/**
+	 * is_compacted - 是否处于压缩状态
+	 */
+	bool is_compacted(void);
+
+	/**
+	 * advise_window - 提示内核预读可见窗口附近的内容
+	 *
+	 * 对 [start_line, end_line) 前后各一个窗口范围内的原始缓冲区
+	 * 区域调用 MADV_WILLNEED，滚动时不必等待缺页读盘。
+	 */
+	void advise_window(size_t start_line, size_t end_line);
+
+	/**
+	 * memory_usage - 估算占用的内存（字节）
+	 *
+	 * 包括换行符索引、语法状态、添加缓冲区、撤销历史和 Piece 节点；映射在
+	 * 压缩前按整个文件计入（最坏情况下全部驻留）。
+	 */
+	size_t memory_usage(void);
+
 private:
 	/* ====================================================================
 	 * 私有成员变量
@@ -329,42 +698,57 @@ private:
 	int mmap_fd;			/* 文件描述符 */
 
 	/* 添加缓冲区 */
-	char *add_buffer;		/* 添加缓冲区指针 */
-	size_t add_buffer_size;	/* 添加缓冲区总大小 */
-	size_t add_buffer_used;	/* 添加缓冲区已使用大小 */
+	AddArena add_buffer;		/* 只追加的分块缓冲区 */
 
-	/* Piece 列表 */
-	std::deque<Piece> pieces;	/* Piece 双端队列 */
+	/* Piece 树 */
+	PieceTree pieces;		/* 按文本顺序排列的 Piece 红黑树 */
 
-	/* 行缓存 */
-	std::vector<LineInfo> line_cache;	/* 行信息缓存 */
-	bool line_cache_valid;			/* 行缓存是否有效 */
+	/* 换行符索引（各缓冲区中所有 '\n' 的偏移，升序） */
+	std::vector<size_t> original_line_feeds;	/* 原始缓冲区 */
+	std::vector<size_t> add_line_feeds;		/* 添加缓冲区（只追加） */
+
+	/* 压缩状态：原始缓冲区只保留第 0, I, 2I... 个换行符的偏移 */
+	std::vector<size_t> original_checkpoints;
+	bool compacted;				/* original_line_feeds 已释放 */
+
+	/*
+	 * 语法状态：syntax_states[i] 是第 i 行行首的词法状态，
+	 * [0, syntax_valid) 行的状态都已确认；之后的行带 SYNTAX_STATE_DIRTY
+	 * 表示它与上一行之间有修改，不带的只要上一行的状态正确就正确。
+	 * 读取时在共享锁内由 syntax_mutex 保护，编辑持有独占锁直接修改。
+	 */
+	const SyntaxLanguage *syntax_language;	/* nullptr 表示纯文本 */
+	std::vector<uint8_t> syntax_states;
+	size_t syntax_valid;
+	std::mutex syntax_mutex;
 
 	/* 统计信息 */
 	size_t line_count;			/* 总行数 */
 	size_t char_count;			/* 总字符数 */
 
-	/* 互斥锁 */
-	std::mutex mutex;			/* 保护所有操作 */
+	/* 读写锁 */
+	RwMutex mutex;				/* 查询持有共享锁，修改持有独占锁 */
+
+	/* 后台索引 */
+	std::thread index_thread;		/* 后台建立换行符索引的线程 */
+	std::atomic<bool> index_cancel;		/* 通知后台索引线程退出 */
+	bool indexing;				/* 后台索引是否进行中 */
+	std::condition_variable_any index_cond;	/* 后台索引完成通知 */
 
 	/* 文件路径 */
 	std::string file_path;		/* 当前加载的文件路径 */
 
+	/* 撤销历史 */
+	std::deque<EditRecord> undo_stack;	/* 表尾是最近的编辑 */
+	std::vector<EditRecord> redo_stack;	/* 表尾是最近撤销的编辑 */
+	size_t history_memory;			/* 两个栈合计的 charge() */
+	size_t history_limit;			/* 内存上限 */
+	bool coalesce_break;			/* 下一次编辑不与上一步合并 */
+
 	/* ====================================================================
 	 * 私有方法 - 缓冲区管理
 	 * ==================================================================== */
 
-	/**
-	 * grow_add_buffer - 扩展添加缓冲区
-	 *
-	 * 当添加缓冲区空间不足时，扩展缓冲区大小。
-	 *
-	 * @required_size: 需要的空间大小
-	 *
-	 * 返回值: 成功返回true，失败返回false
-	 */
-	bool grow_add_buffer(size_t required_size);
-
 	/**
 	 * append_to_add_buffer - 追加内容到添加缓冲区
 	 *
@@ -384,55 +768,296 @@ private:
 	/**
 	 * split_piece - 分割 Piece
 	 *
-	 * 在指定位置分割 Piece，将一个 Piece 分割为两个。
+	 * 在指定位置把节点的 Piece 分割为两个，前半部分留在原节点。
 	 *
-	 * @index: Piece 索引
-	 * @offset: 分割位置（相对于 Piece 起始）
+	 * @node: Piece 节点
+	 * @offset: 分割位置（相对于 Piece 起始，必须在 (0, length) 内）
 	 *
-	 * 返回值: 分割后的索引（第二个 Piece 的索引）
+	 * 返回值: 后半部分的新节点
 	 */
-	size_t split_piece(size_t index, size_t offset);
+	PieceNode *split_piece(PieceNode *node, size_t offset);
 
 	/**
-	 * merge_pieces - 合并相邻的 Piece
+	 * merge_pieces - 尝试把新 Piece 合并到前一个 Piece
+	 *
+	 * 连续输入时新内容紧跟在添加缓冲区末尾，与前一个 ADD Piece
+	 * 首尾相接，直接扩展前一个 Piece 即可，避免 Piece 数量增长。
 	 *
-	 * 合并类型相同且连续的相邻 Piece，减少 Piece 列表大小。
+	 * @prev: 新 Piece 之前的节点（可为 nullptr）
+	 * @piece: 新 Piece
 	 *
-	 * @index: 起始 Piece 索引
+	 * 返回值: 合并成功返回true
 	 */
-	void merge_pieces(size_t index);
+	bool merge_pieces(PieceNode *prev, const Piece &piece);
 
 	/**
 	 * find_piece_for_position - 查找包含指定位置的 Piece
 	 *
-	 * 查找包含字符位置 pos 的 Piece。
+	 * 查找包含字符位置 pos 的 Piece，O(log n)。
 	 *
 	 * @pos: 字符位置
-	 * @piece_index: 输出参数，存储 Piece 索引
+	 * @node: 输出参数，Piece 节点；pos 位于文档末尾时为 nullptr
 	 * @offset_in_piece: 输出参数，存储在 Piece 内的偏移
 	 *
-	 * 返回值: 成功返回true，失败返回false
+	 * 返回值: pos 在 [0, 总长度] 内返回true，否则返回false
 	 */
-	bool find_piece_for_position(size_t pos, size_t &piece_index,
+	bool find_piece_for_position(size_t pos, PieceNode *&node,
 				     size_t &offset_in_piece);
 
+	/**
+	 * count_line_feeds - 统计 Piece 内的换行符数量
+	 *
+	 * 在对应缓冲区的换行符索引中二分查找，O(log n)。
+	 *
+	 * @piece: Piece 引用
+	 *
+	 * 返回值: 换行符数量
+	 */
+	size_t count_line_feeds(const Piece &piece) const;
+
+	/**
+	 * piece_data - 获取 Piece 内容的起始指针
+	 */
+	const char *piece_data(const Piece &piece) const;
+
+	/**
+	 * write_pieces_locked - 按文本顺序把所有 Piece 写入 fd（调用者持有锁）
+	 *
+	 * @fd: 目标文件描述符，从当前文件位置开始写
+	 *
+	 * 返回值: 成功返回写入的字节数，失败返回错误信息
+	 */
+	std::expected<size_t, std::string> write_pieces_locked(int fd);
+
+	/* ====================================================================
+	 * 私有方法 - 无锁实现（调用者必须持有 mutex）
+	 * ==================================================================== */
+
+	/**
+	 * close_locked - close() 的实现
+	 */
+	void close_locked(void);
+
+	/**
+	 * get_text_locked - get_text() 的实现
+	 */
+	bool get_text_locked(size_t start_pos, size_t end_pos,
+			     std::string &text);
+
+	/**
+	 * visit_lines_locked - visit_lines() 的实现
+	 */
+	bool visit_lines_locked(size_t start_line, size_t end_line,
+				const LineVisitor &visitor);
+
+	/**
+	 * insert_locked - insert() 的实现，不更新统计信息
+	 */
+	bool insert_locked(size_t pos, const std::string &text,
+			   Piece *inserted = nullptr);
+
+	/**
+	 * insert_piece_locked - 在 pos 处插入一个已有的 Piece
+	 */
+	bool insert_piece_locked(size_t pos, const Piece &piece);
+
+	/**
+	 * delete_range_locked - delete_range() 的实现，不更新统计信息
+	 *
+	 * @removed: 非空时按顺序追加被删除的 Piece
+	 */
+	bool delete_range_locked(size_t start_pos, size_t end_pos,
+				 std::vector<Piece> *removed = nullptr);
+
+	/* ====================================================================
+	 * 私有方法 - 撤销历史（调用者必须持有 mutex）
+	 * ==================================================================== */
+
+	/**
+	 * record_edit_locked - 记录一次编辑并清空重做栈
+	 *
+	 * 能与上一步合并时合并，之后按内存上限丢弃最早的记录。
+	 */
+	void record_edit_locked(EditRecord record);
+
+	/**
+	 * coalesce_edit_locked - 尝试把编辑合并到上一步
+	 *
+	 * 连续输入（插入位置紧接上一次插入的内容之后）、连续退格和
+	 * 连续向前删除会合并。
+	 *
+	 * 返回值: 合并成功返回true
+	 */
+	bool coalesce_edit_locked(const EditRecord &record);
+
+	/**
+	 * append_piece - 把 Piece 追加到列表末尾，与最后一个相邻时合并
+	 */
+	void append_piece(std::vector<Piece> &list, const Piece &piece) const;
+
+	/**
+	 * swap_pieces_locked - 把 [pos, pos + length) 替换为一组 Piece
+	 */
+	bool swap_pieces_locked(size_t pos, size_t length,
+				const std::vector<Piece> &replacement);
+
+	/**
+	 * trim_history_locked - 丢弃最早的记录直到不超过内存上限
+	 */
+	void trim_history_locked(void);
+
+	/**
+	 * clear_history_locked - 清空撤销和重做历史
+	 */
+	void clear_history_locked(void);
+
+	/**
+	 * update_statistics - 编辑后刷新 line_count 和 char_count
+	 */
+	void update_statistics(void);
+
+	/* ====================================================================
+	 * 私有方法 - 语法状态
+	 * ==================================================================== */
+
+	/**
+	 * invalidate_syntax_locked - 编辑后更新语法状态表（调用者持有独占锁）
+	 *
+	 * 编辑前第 first_line 到 old_last_line 行被替换成了现在的
+	 * first_line 到 new_last_line 行：状态表中间的部分随之删除或
+	 * 插入，被替换的行和紧接着的一行标记为待确认。
+	 */
+	void invalidate_syntax_locked(size_t first_line, size_t old_last_line,
+				      size_t new_last_line);
+
+	/**
+	 * reset_syntax_locked - 丢弃所有语法状态
+	 */
+	void reset_syntax_locked(void);
+
+	/* ====================================================================
+	 * 私有方法 - 换行符索引
+	 * ==================================================================== */
+
+	/**
+	 * scan_line_feeds - 扫描区域内的换行符
+	 *
+	 * 使用 memchr（glibc 中为 SSE2/AVX2 向量化实现）逐个跳到下一个
+	 * 换行符，而不是逐字节比较。
+	 *
+	 * @data: 缓冲区起始指针
+	 * @begin: 扫描起始偏移（包含）
+	 * @end: 扫描结束偏移（不包含）
+	 * @out: 输出参数，换行符偏移追加到末尾
+	 * @cancel: 取消标志，非空时每扫描 INDEX_CANCEL_CHECK_SIZE 检查
+	 *          一次，置位后提前返回，out 中只有部分结果
+	 */
+	static void scan_line_feeds(const char *data, size_t begin, size_t end,
+				    std::vector<size_t> &out,
+				    const std::atomic<bool> *cancel = nullptr);
+
+	/**
+	 * build_line_feed_index - 建立区域内的换行符索引
+	 *
+	 * 区域超过 PARALLEL_INDEX_MIN_SIZE 时按CPU核心数分块，
+	 * 各线程独立扫描后按顺序拼接。
+	 *
+	 * @data: 缓冲区起始指针
+	 * @begin: 扫描起始偏移（包含）
+	 * @end: 扫描结束偏移（不包含）
+	 * @out: 输出参数，换行符偏移追加到末尾
+	 * @cancel: 取消标志，传给每个扫描线程，语义同 scan_line_feeds()
+	 */
+	static void build_line_feed_index(const char *data, size_t begin,
+					  size_t end, std::vector<size_t> &out,
+					  const std::atomic<bool> *cancel = nullptr);
+
+	/**
+	 * index_worker - 后台索引线程主函数
+	 *
+	 * 索引 INDEX_PREFIX_SIZE 之后的部分，完成后在锁内替换索引、
+	 * 更新原始 Piece 的换行符数量并唤醒等待的编辑操作。
+	 */
+	void index_worker(void);
+
+	/**
+	 * stop_indexing - 取消并回收后台索引线程
+	 *
+	 * 注意: 调用时不能持有 mutex（索引线程完成时需要获取 mutex）。
+	 */
+	void stop_indexing(void);
+
+	/**
+	 * wait_for_index - 等待后台索引完成
+	 *
+	 * 编辑操作依赖完整的换行符索引，在修改 Piece 树之前调用。
+	 * 缓冲区处于压缩状态时同时恢复完整索引。
+	 *
+	 * @lock: 已持有的独占锁
+	 */
+	void wait_for_index(std::unique_lock<RwMutex> &lock);
+
 	/* ====================================================================
 	 * 私有方法 - 行管理
 	 * ==================================================================== */
 
 	/**
-	 * rebuild_line_cache - 重建行缓存
+	 * count_feeds_before - 缓冲区中 offset 之前的换行符数量
+	 *
+	 * 压缩状态下从 offset 之前最近的检查点扫描，最多扫描
+	 * LINE_CHECKPOINT_INTERVAL 个换行符。
+	 */
+	size_t count_feeds_before(PieceType type, size_t offset) const;
+
+	/**
+	 * feed_position - 缓冲区中第 rank 个换行符的偏移
+	 */
+	size_t feed_position(PieceType type, size_t rank) const;
+
+	/**
+	 * expand_index_locked - 从原始缓冲区重建完整索引（调用者持有独占锁）
+	 */
+	void expand_index_locked(void);
+
+	/**
+	 * advise_range - 对原始缓冲区 [begin, end) 调用 madvise
+	 */
+	void advise_range(size_t begin, size_t end, int advice) const;
+
+	/**
+	 * line_feed_offset - 获取第 index 个换行符在文档中的位置
 	 *
-	 * 遍历所有 Piece，重建行信息缓存。
+	 * 先在 Piece 树中按换行符数量下降找到所在 Piece，再在缓冲区的
+	 * 换行符索引中直接取下标，O(log n)。
 	 *
-	 * 返回值: 成功返回true，失败返回false
+	 * @index: 换行符序号（从0开始，必须小于换行符总数）
+	 *
+	 * 返回值: 换行符的字符位置
+	 */
+	size_t line_feed_offset(size_t index);
+
+	/**
+	 * line_start - 获取指定行的起始位置
+	 *
+	 * @line: 行号（从0开始，不超过换行符总数）
+	 *
+	 * 返回值: 行首字符位置
+	 */
+	size_t line_start(size_t line);
+
+	/**
+	 * line_end - 获取指定行的结束位置（不含换行符）
+	 *
+	 * @line: 行号（从0开始）
+	 *
+	 * 返回值: 行尾位置（换行符位置或文档末尾）
 	 */
-	bool rebuild_line_cache(void);
+	size_t line_end(size_t line);
 
 	/**
 	 * find_line_for_position - 查找包含指定位置的行
 	 *
-	 * 查找包含字符位置 pos 的行号。
+	 * 行号等于该位置之前的换行符数量，O(log n)。
 	 *
 	 * @pos: 字符位置
 	 *
@@ -0,0 +1,152 @@
+/*
+ * Mikufy v2.11-nova - 文本缓冲区注册表头文件
+ *
+ * 本文件定义了TextBufferRegistry类，管理所有虚拟打开的TextBuffer。
+ *
+ * 主要功能:
+ * - 缓冲区以shared_ptr共享，关闭或淘汰不影响正在使用它的请求
+ * - 记录每个缓冲区最后一次获得焦点（前台访问）的顺序和时间
+ * - 所有缓冲区合计超过内存预算时，从最久未获得焦点的开始压缩
+ *   （见 TextBuffer::compact()），长时间空闲的缓冲区也会被压缩
+ * - 前台访问压缩过的缓冲区时恢复完整的换行符索引
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_TEXT_BUFFER_REGISTRY_H
+#define MIKUFY_TEXT_BUFFER_REGISTRY_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include "text_buffer.h"	/* TextBuffer */
+#include <atomic>		/* std::atomic 内存预算 */
+#include <chrono>		/* std::chrono::steady_clock */
+#include <memory>		/* std::shared_ptr */
+#include <mutex>		/* std::mutex */
+#include <string>		/* std::string */
+#include <unordered_map>	/* std::unordered_map */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 所有打开的缓冲区合计的默认内存预算（512MB） */
+#define TEXTBUFFER_MEMORY_BUDGET	(512ULL * 1024 * 1024)
+
+/* 超过此时间（秒）没有获得焦点的缓冲区即使未超预算也压缩 */
+#define TEXTBUFFER_IDLE_TIMEOUT		300
+
+/*
+ * ============================================================================
+ * TextBufferRegistry类定义
+ * ============================================================================
+ */
+
+/**
+ * TextBufferRegistry - 文件路径到TextBuffer的注册表
+ *
+ * 所有方法都是线程安全的。注册表的锁只保护映射本身，压缩、恢复
+ * 索引和统计内存都在锁外进行（各缓冲区有自己的读写锁）。
+ *
+ * 前台访问（acquire）表示该文件是用户正在查看或编辑的标签，
+ * 后台访问（find）用于搜索、保存、统计等，不改变淘汰顺序。
+ */
+class TextBufferRegistry
+{
+public:
+	/**
+	 * TextBufferRegistry - 构造函数
+	 *
+	 * @budget: 内存预算（字节）
+	 */
+	explicit TextBufferRegistry(size_t budget = TEXTBUFFER_MEMORY_BUDGET);
+
+	/* 禁止拷贝和移动 */
+	TextBufferRegistry(const TextBufferRegistry &) = delete;
+	TextBufferRegistry &operator=(const TextBufferRegistry &) = delete;
+	TextBufferRegistry(TextBufferRegistry &&) = delete;
+	TextBufferRegistry &operator=(TextBufferRegistry &&) = delete;
+
+	/**
+	 * find - 后台访问一个已打开的缓冲区
+	 *
+	 * 返回值: 未打开返回nullptr
+	 */
+	std::shared_ptr<TextBuffer> find(const std::string &path);
+
+	/**
+	 * acquire - 前台访问一个已打开的缓冲区
+	 *
+	 * 把它标记为最近获得焦点，压缩过的先恢复完整索引。
+	 *
+	 * 返回值: 未打开返回nullptr
+	 */
+	std::shared_ptr<TextBuffer> acquire(const std::string &path);
+
+	/**
+	 * insert - 注册新加载的缓冲区（视为获得焦点）
+	 *
+	 * 同一路径已被其他请求注册时保留已有的缓冲区。
+	 *
+	 * 返回值: 注册表中该路径的缓冲区
+	 */
+	std::shared_ptr<TextBuffer> insert(const std::string &path,
+					   std::shared_ptr<TextBuffer> buffer);
+
+	/**
+	 * erase - 移除一个缓冲区
+	 *
+	 * 返回值: 存在并已移除返回true
+	 */
+	bool erase(const std::string &path);
+
+	/**
+	 * clear - 移除所有缓冲区
+	 */
+	void clear(void);
+
+	/**
+	 * snapshot - 取得所有缓冲区（用于统计）
+	 */
+	std::vector<std::shared_ptr<TextBuffer>> snapshot(void);
+
+	/**
+	 * set_budget - 设置内存预算（字节）
+	 */
+	void set_budget(size_t bytes);
+
+	/**
+	 * trim - 按内存预算和空闲时间压缩后台缓冲区
+	 *
+	 * 最近获得焦点的缓冲区不压缩。已有trim()在进行时直接返回。
+	 *
+	 * 返回值: 本次压缩的缓冲区数量
+	 */
+	size_t trim(void);
+
+private:
+	/* 一个已打开的缓冲区 */
+	struct Entry {
+		std::shared_ptr<TextBuffer> buffer;
+		uint64_t focus_seq;	/* 最后一次获得焦点的序号 */
+		std::chrono::steady_clock::time_point focus_time;
+	};
+
+	std::mutex mutex;		/* 保护entries和focus_counter */
+	std::unordered_map<std::string, Entry> entries;
+	uint64_t focus_counter;		/* 递增的焦点序号 */
+
+	std::atomic<size_t> budget;	/* 内存预算（字节） */
+	std::mutex trim_mutex;		/* 串行化trim() */
+};
+
+#endif /* MIKUFY_TEXT_BUFFER_REGISTRY_H */
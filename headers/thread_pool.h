@@ -0,0 +1,118 @@
+/*
+ * Mikufy v2.11-nova - 线程池头文件
+ *
+ * 本文件定义了ThreadPool类的接口，提供一个固定大小的工作线程池，
+ * 用于把耗时的请求处理从I/O事件循环中卸载出去。
+ *
+ * 主要功能:
+ * - 固定数量的工作线程（启动时创建，停止时统一回收）
+ * - FIFO任务队列，条件变量唤醒空闲线程
+ * - 停止时执行完队列中剩余的任务再退出
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_THREAD_POOL_H
+#define MIKUFY_THREAD_POOL_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include <condition_variable>	/* std::condition_variable */
+#include <cstddef>		/* size_t */
+#include <deque>		/* std::deque 任务队列 */
+#include <functional>		/* std::move_only_function */
+#include <mutex>		/* std::mutex */
+#include <thread>		/* std::thread */
+#include <vector>		/* std::vector */
+
+/*
+ * ============================================================================
+ * ThreadPool类定义
+ * ============================================================================
+ */
+
+/**
+ * ThreadPool - 固定大小的工作线程池
+ *
+ * 任务按提交顺序被空闲线程取出执行。任务内部抛出的异常会被
+ * 捕获并丢弃，不会终止工作线程。
+ */
+class ThreadPool
+{
+public:
+	/* 任务类型（可以捕获只能移动的对象，如HttpRequest） */
+	using Task = std::move_only_function<void(void)>;
+
+	/**
+	 * ThreadPool - 构造函数
+	 *
+	 * 只初始化状态，工作线程在start()中创建。
+	 */
+	ThreadPool(void);
+
+	/**
+	 * ~ThreadPool - 析构函数
+	 *
+	 * 调用stop()回收所有工作线程。
+	 */
+	~ThreadPool(void);
+
+	/* 禁止拷贝和移动 */
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	ThreadPool(ThreadPool &&) = delete;
+	ThreadPool &operator=(ThreadPool &&) = delete;
+
+	/**
+	 * start - 创建工作线程
+	 *
+	 * @thread_count: 工作线程数量，为0时按CPU核心数选择
+	 *
+	 * 返回值: 成功返回true，线程池已在运行时返回false
+	 */
+	bool start(size_t thread_count);
+
+	/**
+	 * stop - 停止线程池
+	 *
+	 * 等待队列中已提交的任务执行完毕后回收所有工作线程。
+	 * 线程池未运行时调用是安全的。
+	 */
+	void stop(void);
+
+	/**
+	 * submit - 提交任务
+	 *
+	 * @task: 要执行的任务
+	 *
+	 * 返回值: 成功入队返回true，线程池未运行返回false
+	 */
+	bool submit(Task task);
+
+	/**
+	 * size - 获取工作线程数量
+	 *
+	 * 返回值: 当前工作线程数量
+	 */
+	size_t size(void) const;
+
+private:
+	std::vector<std::thread> workers;	/* 工作线程 */
+	std::deque<Task> tasks;			/* 待执行任务队列 */
+	mutable std::mutex mutex;		/* 保护tasks和stopping */
+	std::condition_variable cond;		/* 任务到达/停止通知 */
+	bool stopping;				/* 停止标志 */
+
+	/**
+	 * worker_loop - 工作线程主循环
+	 */
+	void worker_loop(void);
+};
+
+#endif /* MIKUFY_THREAD_POOL_H */
@@ -0,0 +1,119 @@
+/*
+ * Mikufy v2.11-nova - 内置前端资源头文件
+ *
+ * 本文件定义了WebAssetBundle类。首屏需要的前端资源（index.html、
+ * 脚本、样式表、图标）在编译时通过汇编器的 .incbin 嵌入可执行文件，
+ * 启动后直接从内存发送，不需要读取web目录。
+ *
+ * 主要功能:
+ * - 资源表按URL路径排序，查找为二分查找，不访问文件系统
+ * - ETag由内容哈希得到，在构造时计算，缓存校验不需要stat()
+ * - web目录中内容不同的文件（如更换壁纸后改写的style.css、开发时
+ *   修改的脚本）优先，对应的内置资源不再使用
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#ifndef MIKUFY_WEB_ASSETS_H
+#define MIKUFY_WEB_ASSETS_H
+
+/*
+ * ============================================================================
+ * 头文件包含
+ * ============================================================================
+ */
+
+#include "file_cache.h"		/* FileContent */
+#include <atomic>		/* std::atomic 资源是否被web目录覆盖 */
+#include <cstddef>		/* size_t */
+#include <memory>		/* std::unique_ptr */
+#include <string>		/* std::string */
+#include <string_view>		/* std::string_view */
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * WebAsset - 一个内置资源
+ */
+struct WebAsset {
+	std::string_view path;		/* URL路径，如 "/app.js" */
+	std::string_view mime_type;	/* Content-Type */
+	FileContent content;		/* 资源内容 */
+	std::string etag;		/* 带引号的ETag */
+};
+
+/*
+ * ============================================================================
+ * WebAssetBundle类定义
+ * ============================================================================
+ */
+
+/**
+ * WebAssetBundle - 内置前端资源的索引
+ *
+ * bind()在服务器开始接受连接之前调用；find()和invalidate()可以在
+ * 多个线程中同时调用。
+ */
+class WebAssetBundle
+{
+public:
+	WebAssetBundle(void);
+
+	/* 禁止拷贝和移动 */
+	WebAssetBundle(const WebAssetBundle &) = delete;
+	WebAssetBundle &operator=(const WebAssetBundle &) = delete;
+
+	/**
+	 * bind - 与web目录中的文件比较
+	 *
+	 * @web_root: web资源根目录
+	 *
+	 * web目录中存在且内容不同的资源从此改由web目录提供。
+	 *
+	 * 返回值: 仍从内存提供的资源数
+	 */
+	size_t bind(const std::string &web_root);
+
+	/**
+	 * find - 查找内置资源
+	 *
+	 * @path: URL路径（不含查询字符串）
+	 *
+	 * 返回值: 没有内置或已被web目录覆盖时返回nullptr
+	 */
+	const WebAsset *find(std::string_view path) const;
+
+	/**
+	 * invalidate - web目录中的文件被修改，不再使用对应的内置资源
+	 *
+	 * @path: URL路径
+	 */
+	void invalidate(std::string_view path);
+
+	/**
+	 * size - 内置资源数
+	 */
+	size_t size(void) const { return count; }
+
+private:
+	struct Entry {
+		WebAsset asset;
+		std::atomic<bool> overridden;	/* 已改由web目录提供 */
+	};
+
+	std::unique_ptr<Entry[]> entries;	/* 按路径排序 */
+	size_t count;
+
+	/**
+	 * lookup - 二分查找路径对应的条目
+	 */
+	Entry *lookup(std::string_view path) const;
+};
+
+#endif /* MIKUFY_WEB_ASSETS_H */
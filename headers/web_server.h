@@ -8,10 +8,10 @@
  *
  * 主要功能:
  * - HTTP服务器启动和监听
- * - 请求解析和路由分发
+ * - 请求解析和路由分发（编译时建立的路由完美哈希）
  * - API端点实现（文件操作、目录浏览等）
  * - 静态文件服务（HTML、CSS、JavaScript、图片等）
- * - URL编码/解码
+ * - URL编码（查询参数由HttpRequestParser解码）
  * - 线程安全的请求处理
  *
  * API端点列表:
@@ -24,10 +24,20 @@
  * - POST /api/create-file             创建文件
  * - POST /api/delete                  删除文件或目录
  * - POST /api/rename                  重命名文件或目录
+ * - POST /api/file-operation          在后台删除、复制或移动（返回任务ID）
+ * - GET  /api/file-operation-status   查询后台文件操作的进度
+ * - POST /api/cancel-file-operation   取消后台文件操作
  * - GET  /api/file-info               获取文件信息
  * - POST /api/save-all                保存所有文件
+ * - PUT  /api/upload-file             流式保存文件（请求体即文件内容）
+ * - POST /api/save-file-virtual       把虚拟打开的文件从TextBuffer保存到磁盘
+ * - POST /api/edit-undo               撤销虚拟文件的最近一次编辑
+ * - POST /api/edit-redo               重做虚拟文件最近撤销的编辑
+ * - GET  /api/search                  在工作区中并行搜索（流式返回结果）
+ * - POST /api/search-buffer           在已打开的文件中搜索
  * - POST /api/refresh                 刷新文件列表
  * - POST /api/change-wallpaper        更换壁纸
+ * - GET  /api/metrics                 运行指标（Prometheus文本格式）
  *
  * 2024 MiraTrive/MikuTrive
  * Author: [Your Name]
@@ -47,15 +57,288 @@
 #include "main.h"		/* 全局定义和数据结构 */
 #include "file_manager.h"	/* FileManager文件管理器类 */
 #include "text_buffer.h"		/* 文本缓冲区类 */
+#include "text_buffer_registry.h"	/* TextBufferRegistry 缓冲区注册表 */
 #include "terminal_manager.h"	/* TerminalManager终端管理器类 */
+#include "file_watcher.h"		/* FileWatcher文件系统监视器 */
+#include "file_operations.h"	/* FileOperationJob批量文件操作 */
+#include "thread_pool.h"		/* ThreadPool请求处理线程池 */
+#include "http_parser.h"		/* HttpRequestParser增量请求解析器 */
+#include "route_index.h"		/* RouteIndex路由完美哈希 */
+#include "search_engine.h"		/* SearchJob工作区搜索 */
+#include "metrics.h"			/* Metrics运行指标 */
+#include "startup_trace.h"		/* StartupTrace启动耗时跟踪 */
+#include "web_assets.h"		/* WebAssetBundle内置前端资源 */
+#include "logger.h"			/* 异步日志 */
 #include <unistd.h>		/* fork(), pipe(), dup2() */
 #include <sys/wait.h>		/* waitpid(), WIFEXITED() */
 #include <signal.h>		/* kill(), SIGTERM */
+#include <deque>		/* std::deque 上传写入队列 */
 
 /* 网络编程头文件 */
 #include <sys/socket.h>		/* socket(), bind(), listen() */
 #include <netinet/in.h>		/* struct sockaddr_in */
 #include <arpa/inet.h>		/* inet_addr() */
+#include <sys/epoll.h>		/* epoll_create1(), epoll_wait() */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 单次epoll_wait返回的最大事件数 */
+#define HTTP_MAX_EVENTS			64
+
+/* 请求处理工作线程数上限（实际数量取min(CPU核心数, 此值)） */
+#define HTTP_MAX_WORKER_THREADS		8
+
+/* 空闲keep-alive连接的超时时间（毫秒） */
+#define HTTP_KEEP_ALIVE_TIMEOUT_MS	30000
+
+/* 请求头的最大长度（64KB），超过视为非法请求 */
+#define HTTP_MAX_HEADER_SIZE		(64 * 1024)
+
+/* 缓存在内存中的请求体的最大长度（256MB），超过返回413 */
+#define HTTP_MAX_BODY_SIZE		(256LL * 1024LL * 1024LL)
+
+/* 每次可读事件最多接收的字节数 */
+#define HTTP_READ_BUDGET		(1024 * 1024)
+
+/*
+ * 流式上传等待写入文件的数据上限（8MB）：超过后暂停读取该连接，
+ * 写入线程把队列降到一半以下后恢复
+ */
+#define HTTP_UPLOAD_QUEUE_LIMIT		(8 * 1024 * 1024)
+
+/* 上传队列中合并小块数据的上限，减少写入次数 */
+#define HTTP_UPLOAD_CHUNK_SIZE		(256 * 1024)
+
+/* 上传写入线程数 */
+#define HTTP_UPLOAD_WRITER_THREADS	2
+
+/*
+ * 流式文件上传:
+ *   PUT /api/upload-file?path=目标文件路径（POST亦可）
+ * 请求体就是文件内容，可以用Content-Length或分块传输。请求体边接收
+ * 边写入目标目录下的临时文件（不在内存中缓存），收齐后fsync并
+ * 重命名为目标文件，替换是原子的；已有文件保留原来的权限。
+ * 响应为 {"success": true, "size": 字节数} 或 {"success": false,
+ * "error": "..."}。
+ */
+#define FILE_UPLOAD_PATH		"/api/upload-file"
+
+/*
+ * /api/get-lines 的二进制行帧格式，请求头 Accept 包含此类型时使用
+ * （所有整数均为小端 uint32）:
+ *   [0]  magic "MKLN"
+ *   [4]  起始行号
+ *   [8]  行数 n
+ *   [12] 文本区字节数 len
+ *   [16] 文本区：各行 UTF-8 内容首尾相接（不含换行符），补零到4字节对齐
+ *   [..] 行偏移表：n + 1 个文本区内的字节偏移，第 i 行为 [off[i], off[i+1])
+ * 请求了词法单元（tokens 为 true 且文件有对应的语言）时，偏移表之后
+ * 还有词法单元区，没有时帧在偏移表处结束:
+ *   [..] 词法单元索引：n + 1 项，第 i 行的词法单元为 [idx[i], idx[i+1])
+ *   [..] 词法单元：每个两项，起始列、(长度 << 4) | 类型，列和长度
+ *        都是 UTF-16 单位，类型见 SyntaxTokenKind
+ */
+#define LINES_FRAME_MIME		"application/x-mikufy-lines"
+#define LINES_FRAME_MAGIC		0x4e4c4b4dU	/* "MKLN" */
+#define LINES_FRAME_HEADER_SIZE		16
+#define LINES_FRAME_TOKEN_KIND_BITS	4
+
+/*
+ * 终端输出推送（Server-Sent Events）:
+ *   GET /api/terminal-stream?pid=N
+ * 每段输出推送一个 "event: output"，data 为 {"output": "..."}，
+ * id 为该段之后的输出序号；进程结束后推送 "event: exit"，
+ * data 为 {"pid": N}，随后关闭连接。
+ * 重连时按 Last-Event-ID 请求头（或 since=序号 参数）从断开处继续，
+ * 否则从尚未被读取的输出开始。
+ * 每个进程同时只有一个订阅者，新订阅会替换旧连接。
+ */
+#define TERMINAL_STREAM_PATH		"/api/terminal-stream"
+
+/*
+ * 终端输入批量提交:
+ *   POST /api/terminal-input-batch
+ * 请求体为 {"events": [{"pid": N, "input": "..."},
+ * {"pid": N, "cols": C, "rows": R}, ...]}，前端把一帧内的按键、粘贴和
+ * 窗口尺寸变化合并成一次请求。同一进程的事件按到达顺序应用，连续的
+ * 输入拼接后只写入一次，连续的尺寸变化只应用最后一次。
+ * 响应为 {"success": true, "results": [{"pid": N, "success": ...,
+ * "error": "..."}]}，每个进程一项，按首次出现的顺序。
+ * 终端输出推送是单向的（Server-Sent Events），输入不能走同一个连接。
+ */
+#define TERMINAL_INPUT_BATCH_PATH	"/api/terminal-input-batch"
+
+/* 推送连接未发送数据超过此值时暂停读取终端输出（背压） */
+#define TERMINAL_STREAM_HIGH_WATER	(256 * 1024)
+
+/* 单次调度最多读取的输出段数，避免持续输出的进程独占事件循环 */
+#define TERMINAL_STREAM_PUMP_BUDGET	16
+
+/*
+ * 目录变化推送（Server-Sent Events）:
+ *   GET /api/watch-stream
+ * 监视的目录（POST /api/watch-directories 设置）每批变化推送一个
+ * "event: changes"，data 为 {"changes": [...]}，每项的 type 为
+ * add/remove/rename/modify/rescan。积压超过 TERMINAL_STREAM_HIGH_WATER
+ * 的连接被关闭，客户端重连后应重新加载目录。
+ * 后台文件操作（POST /api/file-operation）的进度也在这里推送，每次
+ * 是一个 "event: operation"，data 与 /api/file-operation-status 的
+ * operation 字段相同；断线期间的进度可以用该接口查询。
+ */
+#define FILE_WATCH_STREAM_PATH		"/api/watch-stream"
+
+/*
+ * 工作区搜索（Server-Sent Events）:
+ *   GET /api/search?path=根目录&query=内容[&regex=1][&caseSensitive=1]
+ *       [&wholeWord=1][&maxResults=N]
+ * 每个有匹配的文件推送一个 "event: results"，搜索结束推送
+ * "event: done"，格式见 SearchJob。done 发送完后关闭连接（EventSource
+ * 会自动重连并重新搜索，前端应在收到 done 后关闭，或用 fetch() 读取）。
+ * 连接提前关闭时取消搜索。参数错误返回400。
+ */
+#define SEARCH_STREAM_PATH		"/api/search"
+
+/*
+ * 静态文件服务:
+ * 不超过 STATIC_CACHE_MAX_FILE 的文件缓存在内存中（合计不超过
+ * STATIC_CACHE_SIZE），更大的文件用 sendfile() 直接从文件发送。
+ * 响应带 ETag 和 Last-Modified，条件请求命中时返回 304。
+ * 同目录下存在不比原文件旧的 .br/.gz 文件且客户端接受时，发送
+ * 预压缩的版本（由 build.sh 生成）。
+ */
+#define STATIC_CACHE_SIZE		(32 * 1024 * 1024)
+#define STATIC_CACHE_MAX_FILE		(1024 * 1024)
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * HttpUpload - 正在接收的流式上传
+ *
+ * 请求体写入fd指向的临时文件。事件循环只把收到的数据放入队列，
+ * 由upload_pool中的写入任务写出：写入可能因脏页回写限流而阻塞，
+ * 不能在事件循环线程中进行。队列超过HTTP_UPLOAD_QUEUE_LIMIT时
+ * 事件循环暂停读取该连接。
+ *
+ * 打开或写入失败时记录errno并丢弃之后的数据，请求体收齐后再报告
+ * 错误。没有提交时析构函数删除临时文件（连接中途断开、写入失败等）。
+ */
+struct HttpUpload {
+	int fd;				/* 临时文件描述符，-1表示已关闭 */
+	std::string target_path;	/* 目标文件（已解析符号链接） */
+	std::string temp_path;		/* 临时文件 */
+	bool committed;			/* 已重命名为目标文件 */
+
+	std::mutex queue_mutex;		/* 保护以下成员 */
+	std::condition_variable queue_drained; /* 写入任务结束 */
+	std::deque<std::string> chunks;	/* 等待写入的数据 */
+	size_t queued;			/* chunks中的字节数 */
+	uint64_t size;			/* 已写入的字节数 */
+	int error;			/* 第一个错误的errno，0表示没有错误 */
+	bool writing;			/* 写入任务已提交且尚未结束 */
+	bool paused;			/* 事件循环已暂停读取该连接 */
+
+	HttpUpload()
+		: fd(-1), committed(false), queued(0), size(0), error(0),
+		  writing(false), paused(false) {}
+
+	~HttpUpload()
+	{
+		if (fd >= 0)
+			close(fd);
+		if (!committed && !temp_path.empty())
+			unlink(temp_path.c_str());
+	}
+
+	HttpUpload(const HttpUpload &) = delete;
+	HttpUpload &operator=(const HttpUpload &) = delete;
+
+	/*
+	 * 追加一段请求体（事件循环线程），出错后丢弃数据。
+	 * 返回true时调用者需要提交一个drain()任务。
+	 */
+	bool enqueue(const char *data, size_t length);
+
+	/* 队列超过上限时标记暂停（事件循环线程），返回是否应停止读取 */
+	bool pause_if_full(void);
+
+	/* 写出队列中的数据（写入线程），队列降下来时调用resume */
+	void drain(const std::function<void(void)> &resume);
+
+	/* 写入任务无法提交：记录错误并丢弃队列 */
+	void abort(int err);
+
+	/* 等待写入任务结束（工作线程），之后size和error不再变化 */
+	void wait_drained(void);
+};
+
+/**
+ * HttpConnection - 客户端连接状态
+ *
+ * 由事件循环线程独占访问。连接在busy期间不会被关闭，
+ * 因此工作线程回传结果时可以安全地用fd定位连接。
+ */
+struct HttpConnection {
+	int fd;				/* 客户端socket描述符 */
+	std::string in_buffer;		/* 已接收但尚未处理的数据 */
+	HttpRequestParser parser;	/* 当前请求的解析状态 */
+	std::shared_ptr<HttpUpload> upload; /* 当前请求是流式上传时有效 */
+	std::string out_buffer;		/* 待发送的响应数据 */
+	size_t out_offset;		/* out_buffer中已发送的字节数 */
+	std::shared_ptr<const std::string> out_shared; /* 紧跟out_buffer发送的共享响应体 */
+	size_t out_shared_offset;	/* out_shared中已发送的字节数 */
+	std::shared_ptr<HttpFileBody> out_file; /* 最后用sendfile()发送的文件响应体 */
+	bool busy;			/* 请求正在工作线程中处理 */
+	bool keep_alive;		/* 当前响应发送完后是否保持连接 */
+	bool peer_closed;		/* 对端已关闭写方向或连接出错 */
+	bool upload_paused;		/* 上传写入队列已满，暂停读取 */
+	pid_t stream_pid;		/* 终端输出推送的目标进程，-1表示普通连接 */
+	std::string stream_partial;	/* 推送时暂存的不完整UTF-8字符 */
+	uint64_t stream_seq;		/* 推送连接下一次读取的输出序号 */
+	bool watch_stream;		/* 目录变化推送连接 */
+	std::shared_ptr<SearchJob> search_job; /* 工作区搜索推送连接的搜索任务 */
+	std::chrono::steady_clock::time_point last_active; /* 最后活动时间 */
+
+	HttpConnection(int socket_fd)
+		: fd(socket_fd), parser(HTTP_MAX_HEADER_SIZE, HTTP_MAX_BODY_SIZE),
+		  out_offset(0), out_shared_offset(0), busy(false),
+		  keep_alive(true), peer_closed(false), upload_paused(false),
+		  stream_pid(-1),
+		  stream_seq(0), watch_stream(false),
+		  last_active(std::chrono::steady_clock::now()) {}
+
+	/* 推送连接不再读取请求 */
+	bool is_stream(void) const
+	{
+		return stream_pid >= 0 || watch_stream || search_job;
+	}
+
+	/* 当前响应还有未发送的部分 */
+	bool has_pending_output(void) const
+	{
+		return out_offset < out_buffer.size() ||
+		       (out_shared && out_shared_offset < out_shared->size()) ||
+		       (out_file && out_file->length > 0);
+	}
+};
+
+/**
+ * HttpCompletion - 工作线程处理完成的响应
+ */
+struct HttpCompletion {
+	int fd;				/* 目标连接 */
+	std::string data;		/* 序列化后的响应头（和普通响应体） */
+	std::shared_ptr<const std::string> shared_body; /* 共享响应体 */
+	std::shared_ptr<HttpFileBody> file_body; /* 文件响应体 */
+	bool keep_alive;		/* 发送完后是否保持连接 */
+};
 
 /*
  * ============================================================================
@@ -71,9 +354,10 @@
  * 可以高效地处理并发请求。
  *
  * 设计特点:
- * - 非阻塞I/O：使用poll()系统调用实现事件驱动
- * - 多线程：服务器主循环在独立线程中运行
- * - 路由表：使用std::map存储URL到处理器的映射
+ * - 非阻塞I/O：事件循环线程使用epoll管理监听socket和所有连接
+ * - HTTP/1.1 keep-alive：连接在响应后保持打开，按顺序处理后续请求
+ * - 工作线程池：路由处理器在线程池中执行，慢请求不会阻塞其他连接
+ * - 路由表：编译时确定的routes[]，由RouteIndex完美哈希按路径查找
  * - 线程安全：使用互斥锁保护共享资源
  * - 回调机制：支持打开文件夹对话框的回调
  *
@@ -184,6 +468,8 @@ public:
 	 *
 	 * 设置web资源文件（包括style.css、Background等）所在的目录路径。
 	 * 用于确保无论程序从哪个目录启动，都能正确找到和修改web资源文件。
+	 * 同时把内置资源与该目录中的文件比较，内容不同的改由目录提供。
+	 * 必须在start()之前调用。
 	 *
 	 * @path: web目录的绝对路径
 	 */
@@ -201,21 +487,102 @@ private:
 	std::thread server_thread;	/* 服务器线程对象 */
 	std::mutex mutex;		/* 互斥锁，保护共享资源 */
 
+	/* 事件循环相关（由服务器线程独占访问） */
+	int epoll_fd;			/* epoll实例描述符 */
+	int wake_fd;			/* eventfd，工作线程完成请求时唤醒事件循环 */
+	std::unordered_map<int, std::unique_ptr<HttpConnection>> connections;
+
+	/* 请求处理线程池 */
+	ThreadPool worker_pool;
+
+	/* 工作区搜索线程池，长时间的搜索不占用请求处理线程 */
+	ThreadPool search_pool;
+
+	/* 批量文件操作线程池 */
+	ThreadPool file_pool;
+
+	/* 流式上传写入线程池，写文件阻塞时不影响事件循环 */
+	ThreadPool upload_pool;
+
+	/* 后台文件操作（任务ID -> 任务），保留最近结束的几个供查询 */
+	std::map<uint64_t, std::shared_ptr<FileOperationJob>> file_jobs;
+	uint64_t next_file_job_id;	/* 下一个任务ID */
+	std::mutex file_jobs_mutex;	/* 保护file_jobs和next_file_job_id */
+
+	/* 工作线程完成的响应队列 */
+	std::vector<HttpCompletion> completions;
+	std::mutex completions_mutex;	/* 保护completions */
+
+	/* 终端输出推送连接（进程ID -> 连接fd），仅事件循环线程访问 */
+	std::unordered_map<pid_t, int> terminal_streams;
+
+	/* 有新输出等待推送的进程 */
+	std::vector<pid_t> ready_streams;
+	std::mutex ready_streams_mutex;	/* 保护ready_streams、ready_searches、ready_uploads、watch_events和streams_enabled */
+	bool streams_enabled;		/* wake_fd可用，可以接收输出通知 */
+
+	/* 目录变化推送连接，仅事件循环线程访问 */
+	std::vector<int> watch_streams;
+
+	/* 等待推送的目录变化事件（已编码的SSE文本） */
+	std::string watch_events;
+
+	/* 有新结果的搜索（连接fd和搜索任务，任务只用于确认连接未被替换） */
+	std::vector<std::pair<int, const SearchJob *>> ready_searches;
+
+	/* 写入队列已降下来、可以恢复读取的上传（连接fd和上传，上传只用于确认连接未被替换） */
+	std::vector<std::pair<int, const HttpUpload *>> ready_uploads;
+
 	/* 打开文件夹对话框回调函数 */
 	std::function<std::string(void)> open_folder_callback;
 
 	/* web资源根目录的绝对路径 */
 	std::string web_root_path;
 
-	/* HTTP路由表（URL路径 -> 处理函数） */
-	std::map<std::string, HttpHandler> routes;
+	/* 路由处理函数：查询参数已解码，请求头和请求体来自解析器 */
+	using RouteHandler = HttpResponse (WebServer::*)(const HttpQuery &query,
+							 const HttpHeaders &headers,
+							 const std::string &body);
+
+	/* 一个路由 */
+	struct Route {
+		std::string_view path;	/* 不含查询字符串的路径 */
+		RouteHandler handler;	/* nullptr: 推送和上传，在事件循环中处理 */
+	};
+
+	/* HTTP路由表（编译时确定，定义见web_server.cpp） */
+	static const Route routes[];
+
+	/* routes的完美哈希（编译时建立） */
+	static const RouteIndex route_index;
+
+	/* 一个路由的请求数和处理耗时 */
+	struct RouteMetrics {
+		MetricCounter *requests;
+		MetricHistogram *latency;
+	};
+
+	/*
+	 * 按路由表下标保存的指标，构造时为每个路由注册（构造后只读，
+	 * 工作线程无锁查找）；未匹配的路径（静态文件）计入static_metrics
+	 */
+	std::vector<RouteMetrics> route_metrics;
+	RouteMetrics static_metrics;
 
 	/* 终端管理器 */
 	std::unique_ptr<TerminalManager> terminal_manager;	/* 终端管理器指针 */
 
+	/* 目录监视器 */
+	std::unique_ptr<FileWatcher> file_watcher;
+
+	/* 静态资源缓存（工作线程共享，FileCache自带锁） */
+	FileCache static_cache;
+
+	/* 编译进程序的首屏资源 */
+	WebAssetBundle web_assets;
+
 	/* 高性能编辑器相关 */
-	std::unordered_map<std::string, TextBuffer *> text_buffers;	/* 文件路径 -> TextBuffer 映射 */
-	std::mutex text_buffers_mutex;				/* 保护 text_buffers 的互斥锁 */
+	TextBufferRegistry text_buffers;	/* 文件路径 -> TextBuffer，带内存预算 */
 
 	/* ====================================================================
 	 * 私有方法 - 服务器主循环
@@ -224,100 +591,332 @@ private:
 	/**
 	 * server_loop - 服务器主循环
 	 *
-	 * 服务器的主事件循环，在独立线程中运行。使用poll()系统
-	 * 调用等待客户端连接，接受连接并处理请求。当running标志
-	 * 为false时退出循环。
+	 * 服务器的主事件循环，在独立线程中运行。使用epoll等待
+	 * 新连接、连接可读/可写以及工作线程的完成通知，并定期
+	 * 关闭超时的空闲连接。当running标志为false时退出循环，
+	 * 退出前关闭所有连接。
 	 *
 	 * 注意: 该方法在服务器线程中运行，不应直接调用。
 	 */
 	void server_loop(void);
 
 	/**
-	 * accept_client - 接受客户端连接
-	 *
-	 * 接受一个待处理的客户端连接请求。
+	 * close_server_fds - 关闭监听socket、epoll实例和eventfd
+	 */
+	void close_server_fds(void);
+
+	/**
+	 * accept_clients - 接受所有待处理的客户端连接
 	 *
-	 * 返回值: 成功返回客户端socket描述符，失败返回-1
+	 * 循环调用accept4()直到没有待处理连接，新连接以非阻塞
+	 * 模式注册到epoll。
 	 *
 	 * 注意: 该方法应在server_loop()中调用。
 	 */
-	int accept_client(void);
+	void accept_clients(void);
+
+	/**
+	 * handle_connection_event - 处理单个连接上的epoll事件
+	 *
+	 * @fd: 客户端socket描述符
+	 * @events: epoll事件掩码
+	 */
+	void handle_connection_event(int fd, uint32_t events);
+
+	/**
+	 * read_connection - 读取连接上的可读数据
+	 *
+	 * 每次最多读取HTTP_READ_BUDGET字节，剩余数据等下一次可读事件。
+	 *
+	 * @conn: 连接状态
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool read_connection(HttpConnection &conn);
+
+	/**
+	 * dispatch_request - 把缓冲区中的下一个完整请求交给线程池
+	 *
+	 * 连接空闲时用parser解析in_buffer，请求完整后提交到工作线程池，
+	 * 并暂停该连接的读事件直到响应发送完毕。
+	 *
+	 * @conn: 连接状态
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool dispatch_request(HttpConnection &conn);
+
+	/**
+	 * begin_request_body - 请求头解析完成后决定如何接收请求体
+	 *
+	 * 流式上传的请求体交给临时文件；客户端等待"100 Continue"时
+	 * 先发送该临时响应。
+	 *
+	 * @conn: 连接状态
+	 */
+	void begin_request_body(HttpConnection &conn);
+
+	/**
+	 * handle_request - 处理一个完整的HTTP请求
+	 *
+	 * 执行路由处理器，未匹配时按静态文件处理。在工作线程中执行。
+	 *
+	 * @request: 解析后的请求
+	 *
+	 * 返回值: 处理器返回的响应（不含Connection头）
+	 */
+	HttpResponse handle_request(const HttpRequest &request);
+
+	/**
+	 * begin_upload - 为流式上传创建临时文件
+	 *
+	 * @query: 查询参数，path为目标文件
+	 *
+	 * 返回值: 上传状态，创建失败时fd为-1且error已设置
+	 */
+	std::shared_ptr<HttpUpload> begin_upload(const HttpQuery &query);
+
+	/**
+	 * queue_upload_data - 把一段上传数据交给写入线程
+	 *
+	 * @fd: 连接
+	 * @upload: 上传状态
+	 * @data: 数据
+	 * @length: 字节数
+	 *
+	 * 注意: 在事件循环线程中调用（请求体回调）。
+	 */
+	void queue_upload_data(int fd, const std::shared_ptr<HttpUpload> &upload,
+			       const char *data, size_t length);
+
+	/**
+	 * notify_upload_resume - 通知事件循环恢复读取上传连接
+	 *
+	 * 注意: 在写入线程中调用。
+	 */
+	void notify_upload_resume(int fd, const HttpUpload *upload);
+
+	/**
+	 * resume_uploads - 恢复读取所有收到通知的上传连接
+	 */
+	void resume_uploads(void);
+
+	/**
+	 * finish_upload - 提交接收完毕的上传
+	 *
+	 * 设置权限、fsync后把临时文件重命名为目标文件。在工作线程中执行。
+	 *
+	 * @upload: 上传状态
+	 *
+	 * 返回值: JSON响应
+	 */
+	HttpResponse finish_upload(HttpUpload &upload);
 
 	/**
-	 * handle_client - 处理客户端请求
+	 * complete_requests - 取回工作线程完成的响应并开始发送
 	 *
-	 * 读取并处理客户端发送的HTTP请求，构造响应并发送回客户端。
-	 * 处理完成后关闭客户端连接。
+	 * 在事件循环线程中响应唤醒eventfd时调用。
+	 */
+	void complete_requests(void);
+
+	/**
+	 * post_completion - 把响应交回事件循环线程
 	 *
-	 * @client_socket: 客户端socket描述符
+	 * @completion: 完成的响应
 	 *
-	 * 注意: 该方法会自动关闭客户端socket。
+	 * 注意: 在工作线程中调用。
 	 */
-	void handle_client(int client_socket);
+	void post_completion(HttpCompletion completion);
+
+	/**
+	 * flush_connection - 尽可能多地发送待发送数据
+	 *
+	 * 响应头和内存中的响应体合并为一次sendmsg()，文件响应体用
+	 * sendfile()发送。
+	 * socket发送缓冲区满时注册EPOLLOUT等待后续发送；发送完毕后
+	 * 根据keep_alive关闭连接或恢复读事件并处理流水线中的下一个请求。
+	 *
+	 * @conn: 连接状态
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool flush_connection(HttpConnection &conn);
+
+	/**
+	 * update_connection_events - 修改连接的epoll监听事件
+	 *
+	 * @fd: 客户端socket描述符
+	 * @events: 新的事件掩码
+	 */
+	void update_connection_events(int fd, uint32_t events);
+
+	/**
+	 * close_connection - 关闭连接并释放其状态
+	 *
+	 * @fd: 客户端socket描述符
+	 */
+	void close_connection(int fd);
+
+	/**
+	 * close_idle_connections - 关闭超时的空闲keep-alive连接
+	 */
+	void close_idle_connections(void);
 
 	/* ====================================================================
-	 * 私有方法 - HTTP协议处理
+	 * 私有方法 - 终端输出推送
 	 * ==================================================================== */
 
 	/**
-	 * parse_http_request - 解析HTTP请求
+	 * start_terminal_stream - 把连接切换为终端输出推送
 	 *
-	 * 解析原始HTTP请求字符串，提取方法、路径、请求头和请求体。
+	 * 在事件循环线程中处理 TERMINAL_STREAM_PATH 请求：发送SSE响应头
+	 * 后连接不再处理后续请求，只推送该进程的输出。
 	 *
-	 * @request: 原始HTTP请求字符串
-	 * @method: 输出参数，存储HTTP方法（GET/POST等）
-	 * @path: 输出参数，存储请求路径
-	 * @headers: 输出参数，存储请求头键值对
-	 * @body: 输出参数，存储请求体内容
+	 * @conn: 连接状态
+	 * @request: 解析后的请求
 	 *
-	 * 返回值: 解析成功返回true，失败返回false
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool start_terminal_stream(HttpConnection &conn,
+				   const HttpRequest &request);
+
+	/**
+	 * notify_terminal_stream - 通知事件循环进程有新输出
+	 *
+	 * @pid: 进程ID
 	 *
-	 * 注意: 该方法支持GET和POST请求。
+	 * 注意: 在TerminalManager的IO线程中调用。
 	 */
-	bool parse_http_request(const std::string &request,
-				std::string &method, std::string &path,
-				std::map<std::string, std::string> &headers,
-				std::string &body);
+	void notify_terminal_stream(pid_t pid);
 
 	/**
-	 * build_http_response - 构造HTTP响应
+	 * pump_terminal_streams - 推送所有收到通知的进程的输出
+	 */
+	void pump_terminal_streams(void);
+
+	/**
+	 * pump_terminal_stream - 读取进程输出并写入推送连接
 	 *
-	 * 根据HttpResponse结构体构造完整的HTTP响应字符串。
+	 * 连接积压超过 TERMINAL_STREAM_HIGH_WATER 时停止读取，等连接
+	 * 可写后继续；输出留在终端的回滚缓冲区中，未读输出达到上限后
+	 * 子进程的写入会被阻塞，背压因此一直传递到子进程。
 	 *
-	 * @response: HttpResponse结构体
+	 * @conn: 推送连接
 	 *
-	 * 返回值: HTTP响应字符串
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
 	 */
-	std::string build_http_response(const HttpResponse &response);
+	bool pump_terminal_stream(HttpConnection &conn);
 
 	/**
-	 * send_http_response - 发送HTTP响应
+	 * append_stream_output - 把一段终端输出编码为SSE事件追加到连接
 	 *
-	 * 将HTTP响应发送给客户端。
+	 * 末尾不完整的UTF-8字符暂存到下一段，保证每个事件都是有效文本。
 	 *
-	 * @client_socket: 客户端socket描述符
-	 * @response: HttpResponse结构体
+	 * @conn: 推送连接
+	 * @data: 终端输出
+	 * @end_seq: data之后的输出序号
+	 */
+	void append_stream_output(HttpConnection &conn, std::string_view data,
+				  uint64_t end_seq);
+
+	/* ====================================================================
+	 * 私有方法 - 目录变化推送
+	 * ==================================================================== */
+
+	/**
+	 * start_watch_stream - 把连接切换为目录变化推送
+	 *
+	 * @conn: 连接状态
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool start_watch_stream(HttpConnection &conn);
+
+	/**
+	 * notify_watch_stream - 编码一批目录变化并唤醒事件循环
+	 *
+	 * @deltas: 目录变化
 	 *
-	 * 返回值: 发送成功返回true，失败返回false
+	 * 注意: 在FileWatcher的监视线程中调用。
 	 */
-	bool send_http_response(int client_socket,
-				const HttpResponse &response);
+	void notify_watch_stream(const std::vector<FileDelta> &deltas);
+
+	/**
+	 * notify_file_operation - 编码文件操作进度并唤醒事件循环
+	 *
+	 * @progress: 任务进度
+	 *
+	 * 注意: 在文件操作的工作线程中调用。
+	 */
+	void notify_file_operation(const FileOperationProgress &progress);
+
+	/**
+	 * pump_watch_streams - 把等待推送的目录变化写入所有推送连接
+	 */
+	void pump_watch_streams(void);
 
 	/* ====================================================================
-	 * 私有方法 - URL处理
+	 * 私有方法 - 工作区搜索推送
+	 * ==================================================================== */
+
+	/**
+	 * start_search_stream - 开始工作区搜索，把连接切换为结果推送
+	 *
+	 * @conn: 连接状态
+	 * @request: 解析后的请求
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool start_search_stream(HttpConnection &conn, const HttpRequest &request);
+
+	/**
+	 * notify_search_stream - 通知事件循环搜索有新结果
+	 *
+	 * @fd: 推送连接
+	 * @job: 搜索任务
+	 *
+	 * 注意: 在搜索线程中调用。
+	 */
+	void notify_search_stream(int fd, const SearchJob *job);
+
+	/**
+	 * pump_search_streams - 推送所有收到通知的搜索的结果
+	 */
+	void pump_search_streams(void);
+
+	/**
+	 * pump_search_stream - 取走搜索结果写入推送连接
+	 *
+	 * 连接积压超过 TERMINAL_STREAM_HIGH_WATER 时不取结果，搜索线程
+	 * 在结果积压后暂停，背压一直传递到搜索。
+	 *
+	 * @conn: 推送连接
+	 *
+	 * 返回值: 连接仍然可用返回true，需要关闭返回false
+	 */
+	bool pump_search_stream(HttpConnection &conn);
+
+	/* ====================================================================
+	 * 私有方法 - HTTP协议处理
 	 * ==================================================================== */
 
 	/**
-	 * url_decode - URL解码
+	 * build_http_response - 构造HTTP响应
 	 *
-	 * 将URL编码的字符串解码为普通字符串。处理%XX格式的十六进制
-	 * 编码和+号表示的空格。
+	 * 根据HttpResponse结构体构造完整的HTTP响应字符串。响应头中
+	 * 没有Content-Length时自动补充，以便在keep-alive连接上分帧。
+	 * 设置了shared_body或file_body时只返回响应头，响应体由
+	 * flush_connection()直接发送，不再拷贝。
 	 *
-	 * @encoded: URL编码的字符串
+	 * @response: HttpResponse结构体
 	 *
-	 * 返回值: 解码后的字符串
+	 * 返回值: HTTP响应字符串
 	 */
-	std::string url_decode(const std::string &encoded);
+	std::string build_http_response(const HttpResponse &response);
+
+	/* ====================================================================
+	 * 私有方法 - URL处理
+	 * ==================================================================== */
 
 	/**
 	 * url_encode - URL编码
@@ -331,28 +930,68 @@ private:
 	 */
 	std::string url_encode(const std::string &decoded);
 
+	/* ====================================================================
+	 * 私有方法 - 路由管理
+	 * ==================================================================== */
+
 	/**
-	 * parse_query_string - 解析查询参数
+	 * find_route - 查找路由
 	 *
-	 * 解析URL查询字符串（?后面的部分），提取参数键值对。
+	 * @route: 不含查询字符串的路径
 	 *
-	 * @query_string: 查询字符串（不含?）
+	 * 返回: 路由表下标，不是API路径返回-1
+	 */
+	static int find_route(std::string_view route);
+
+	/**
+	 * register_route_metrics - 为路由表中的每个路由（包括推送路径）注册指标
 	 *
-	 * 返回值: 参数键值对映射
+	 * 在构造函数中调用。
 	 */
-	std::map<std::string, std::string> parse_query_string(
-				const std::string &query_string);
+	void register_route_metrics(void);
 
-	/* ====================================================================
-	 * 私有方法 - 路由管理
-	 * ==================================================================== */
+	/**
+	 * metrics_for_route - 查找路由的指标
+	 *
+	 * @route: 不含查询字符串的路径
+	 *
+	 * 返回: 路由的指标，未注册的路径返回static_metrics
+	 */
+	const RouteMetrics &metrics_for_route(std::string_view route) const;
 
 	/**
-	 * register_routes - 注册HTTP路由
+	 * handle_metrics - 导出运行指标
+	 *
+	 * 注册表中的计数器和直方图，加上导出时读取的瞬时值（已打开的
+	 * TextBuffer数量和大小、静态资源缓存占用）。
 	 *
-	 * 将所有API端点注册到路由表中。该方法在构造函数中调用。
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: 请求体（未使用）
+	 *
+	 * 返回: Prometheus文本格式（text/plain; version=0.0.4）的响应
 	 */
-	void register_routes(void);
+	HttpResponse handle_metrics(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_startup_trace - 记录和查询启动耗时
+	 *
+	 * 前端上报的阶段名称加上 "frontend:" 前缀记录到StartupTrace。
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体 { "mark": 阶段名称, "finish": 是否结束 }，
+	 *        为空时只查询
+	 *
+	 * 返回: JSON响应，包含success、finished和marks字段
+	 */
+	HttpResponse handle_startup_trace(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
 
 	/* ====================================================================
 	 * 私有方法 - API处理函数
@@ -365,18 +1004,18 @@ private:
 	 * 文件夹路径。
 	 */
 	HttpResponse handle_open_folder_dialog(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
 	 * handle_get_directory_contents - 处理获取目录内容API
 	 *
-	 * 获取指定目录下的所有文件和子目录列表。
+	 * 按游标分页获取指定目录下的文件和子目录列表（服务端排序）。
 	 */
 	HttpResponse handle_get_directory_contents(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -385,8 +1024,8 @@ private:
 	 * 读取文本文件内容并返回。
 	 */
 	HttpResponse handle_read_file(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -395,8 +1034,8 @@ private:
 	 * 读取二进制文件内容（图片、视频等）并返回。
 	 */
 	HttpResponse handle_read_binary_file(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -405,8 +1044,8 @@ private:
 	 * 将内容保存到指定文件。
 	 */
 	HttpResponse handle_save_file(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -415,8 +1054,8 @@ private:
 	 * 在指定路径创建新文件夹。
 	 */
 	HttpResponse handle_create_folder(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -425,8 +1064,8 @@ private:
 	 * 在指定路径创建新文件。
 	 */
 	HttpResponse handle_create_file(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -435,8 +1074,47 @@ private:
 	 * 删除指定的文件或目录。
 	 */
 	HttpResponse handle_delete(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_file_operation - 开始后台文件操作
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体，包含type（delete/copy/move）、paths数组，
+	 *        复制和移动时还有destination（目标目录）
+	 *
+	 * 返回: JSON响应，包含success和id，参数错误时包含error
+	 */
+	HttpResponse handle_file_operation(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_file_operation_status - 查询后台文件操作的进度
+	 *
+	 * 查询参数：id - 任务ID
+	 *
+	 * 返回: JSON响应，包含success和operation
+	 */
+	HttpResponse handle_file_operation_status(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_cancel_file_operation - 取消后台文件操作
+	 *
+	 * @body: JSON请求体，包含id
+	 *
+	 * 返回: JSON响应，包含success（任务存在且未结束）
+	 */
+	HttpResponse handle_cancel_file_operation(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -445,8 +1123,8 @@ private:
 	 * 重命名文件或目录。
 	 */
 	HttpResponse handle_rename(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -455,8 +1133,8 @@ private:
 	 * 获取文件的详细信息（类型、MIME等）。
 	 */
 	HttpResponse handle_get_file_info(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -465,8 +1143,8 @@ private:
 	 * 批量保存多个文件。
 	 */
 	HttpResponse handle_save_all(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -475,8 +1153,8 @@ private:
 	 * 刷新文件列表，返回成功响应。
 	 */
 	HttpResponse handle_refresh(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -484,15 +1162,32 @@ private:
 	 *
 	 * 只刷新指定目录的内容，用于智能刷新功能。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
-	 * @body: JSON请求体，包含directory字段
+	 * @body: JSON请求体，包含directory字段，可选limit和cursor
 	 *
-	 * 返回: JSON响应，包含success、directory、files字段
+	 * 返回: JSON响应，包含success、directory、files、total、
+	 *       next_cursor和has_more字段
 	 */
 	HttpResponse handle_refresh_directory(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_watch_directories - 处理设置监视目录API
+	 *
+	 * 替换监视的目录集合，这些目录的变化通过 FILE_WATCH_STREAM_PATH 推送。
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体，包含directories数组
+	 *
+	 * 返回: JSON响应，包含success、directories（实际监视的目录）字段
+	 */
+	HttpResponse handle_watch_directories(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -501,8 +1196,8 @@ private:
 	 * 更换编辑器背景壁纸。
 	 */
 	HttpResponse handle_change_wallpaper(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -511,8 +1206,8 @@ private:
 	 * 获取所有可用的壁纸文件列表。
 	 */
 	HttpResponse handle_get_wallpapers(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/* ====================================================================
@@ -525,15 +1220,17 @@ private:
 	 * 使用 TextBuffer (Piece Table) 架构打开文件，支持大文件的高效编辑。
 	 * 返回文件的元数据（总行数、总字符数），不返回全部内容。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path字段
 	 *
-	 * 返回: JSON响应，包含success、totalLines、totalChars、language字段
+	 * 返回: JSON响应，包含success、totalLines、totalChars、indexing、language字段
+	 *       indexing为true时totalLines只是已索引部分的行数；language
+	 *       是语法高亮使用的语言，没有对应的词法规则时为plaintext
 	 */
 	HttpResponse handle_open_file_virtual(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -542,15 +1239,19 @@ private:
 	 * 从 TextBuffer 中获取指定行范围的文本内容，用于虚拟滚动渲染。
 	 * 只返回可见区域的行，大幅减少数据传输量。
 	 *
-	 * @path: 请求路径（未使用）
-	 * @headers: 请求头（未使用）
-	 * @body: JSON请求体，包含path、start_line、end_line字段
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头，Accept 包含 LINES_FRAME_MIME 时返回二进制行帧
+	 * @body: JSON请求体，包含path、start_line、end_line字段，可选的
+	 *        tokens为true时同时返回语法高亮的词法单元
 	 *
-	 * 返回: JSON响应，包含success、lines、language字段
+	 * 返回: JSON响应，包含success、lines、language字段，请求了词法
+	 *       单元时还有tokens：每行一个 [起始列, 长度, 类型, ...] 数组
+	 *       （UTF-16 单位）；或 LINES_FRAME_MIME 类型的二进制行帧
+	 *       （出错时仍为JSON）
 	 */
 	HttpResponse handle_get_lines(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -558,15 +1259,15 @@ private:
 	 *
 	 * 获取当前打开文件的总行数。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path字段
 	 *
-	 * 返回: JSON响应，包含success、totalLines字段
+	 * 返回: JSON响应，包含success、totalLines、indexing字段
 	 */
 	HttpResponse handle_get_line_count(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -574,15 +1275,15 @@ private:
 	 *
 	 * 在指定位置插入文本到 TextBuffer 中。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path、position、text字段
 	 *
 	 * 返回: JSON响应，包含success、newTotalLines字段
 	 */
 	HttpResponse handle_edit_insert(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -590,15 +1291,15 @@ private:
 	 *
 	 * 删除指定范围的文本。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path、start_position、end_position字段
 	 *
 	 * 返回: JSON响应，包含success、newTotalLines字段
 	 */
 	HttpResponse handle_edit_delete(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -606,15 +1307,78 @@ private:
 	 *
 	 * 将指定范围的文本替换为新文本。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path、start_position、end_position、text字段
 	 *
 	 * 返回: JSON响应，包含success、newTotalLines字段
 	 */
 	HttpResponse handle_edit_replace(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_edit_history - 撤销或重做虚拟文件的编辑
+	 *
+	 * /api/edit-undo 和 /api/edit-redo 共用。
+	 *
+	 * @body: JSON请求体，包含path字段
+	 * @redo: true为重做，false为撤销
+	 *
+	 * 返回: JSON响应，包含success、cursor、newTotalLines、canUndo、
+	 *       canRedo字段
+	 */
+	HttpResponse handle_edit_history(const std::string &body, bool redo);
+
+	/**
+	 * handle_edit_undo - 撤销（/api/edit-undo）
+	 */
+	HttpResponse handle_edit_undo(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_edit_redo - 重做（/api/edit-redo）
+	 */
+	HttpResponse handle_edit_redo(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_search_buffer - 在已打开的文件中搜索
+	 *
+	 * 直接遍历 TextBuffer 的 Piece，包含未保存的编辑。
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体，包含path、query字段，可选regex、
+	 *        caseSensitive、wholeWord、maxResults字段
+	 *
+	 * 返回: JSON响应，包含success、matches和truncated字段
+	 */
+	HttpResponse handle_search_buffer(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_save_file_virtual - 保存虚拟文件
+	 *
+	 * 由 TextBuffer 直接把 Piece 写入磁盘，内容不经过前端。
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体，包含path字段（已打开的文件），可选target字段
+	 *        （另存为的路径）
+	 *
+	 * 返回: JSON响应，包含success和size字段
+	 */
+	HttpResponse handle_save_file_virtual(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -622,15 +1386,15 @@ private:
 	 *
 	 * 关闭并释放 TextBuffer 资源。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path字段
 	 *
 	 * 返回: JSON响应，包含success字段
 	 */
 	HttpResponse handle_close_file_virtual(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/* ====================================================================
@@ -642,15 +1406,15 @@ private:
 	 *
 	 * 获取当前用户名、主机名和当前路径信息。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含path字段
 	 *
 	 * 返回: JSON响应，包含success、user、hostname、path、isRoot字段
 	 */
 	HttpResponse handle_terminal_info(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -658,15 +1422,15 @@ private:
 	 *
 	 * 在指定路径下执行shell命令。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含command和path字段
 	 *
 	 * 返回: JSON响应，包含success、output、error、newPath、isRoot字段
 	 */
 	HttpResponse handle_terminal_execute(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -674,15 +1438,15 @@ private:
 	 *
 	 * 获取指定进程的标准输出和标准错误输出。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含pid字段
 	 *
 	 * 返回: JSON响应，包含success、output、error、is_running字段
 	 */
 	HttpResponse handle_terminal_get_output(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -690,15 +1454,32 @@ private:
 	 *
 	 * 向正在运行的进程发送输入数据。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含pid和input字段
 	 *
 	 * 返回: JSON响应，包含success字段
 	 */
 	HttpResponse handle_terminal_send_input(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
+			const std::string &body);
+
+	/**
+	 * handle_terminal_input_batch - 批量提交终端输入和尺寸变化
+	 *
+	 * 格式见TERMINAL_INPUT_BATCH_PATH。写入不会阻塞，PTY写不下的
+	 * 输入由TerminalManager排队。
+	 *
+	 * @query: 查询参数（未使用）
+	 * @headers: 请求头（未使用）
+	 * @body: JSON请求体，包含events数组
+	 *
+	 * 返回: JSON响应，包含success和results字段
+	 */
+	HttpResponse handle_terminal_input_batch(
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -706,15 +1487,15 @@ private:
 	 *
 	 * 终止指定的交互式进程。
 	 *
-	 * @path: 请求路径（未使用）
+	 * @query: 查询参数（未使用）
 	 * @headers: 请求头（未使用）
 	 * @body: JSON请求体，包含pid字段
 	 *
 	 * 返回: JSON响应，包含success字段
 	 */
 	HttpResponse handle_terminal_kill_process(
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
+			const HttpQuery &query,
+			const HttpHeaders &headers,
 			const std::string &body);
 
 	/**
@@ -734,21 +1515,57 @@ private:
 	 * 处理对静态资源文件（HTML、CSS、JS、图片等）的请求。
 	 *
 	 * @path: 请求的文件路径
+	 * @headers: 请求头（条件请求和Accept-Encoding）
 	 *
 	 * 返回值: HttpResponse结构体
 	 */
-	HttpResponse handle_static_file(const std::string &path);
+	HttpResponse handle_static_file(std::string_view path,
+					const HttpHeaders &headers);
 
 	/**
 	 * read_static_file - 读取静态文件内容
 	 *
 	 * 从磁盘读取静态文件的内容。
 	 *
-	 * @file_path: 文件路径（相对于web目录）
+	 * @file_path: 文件路径
+	 * @st: 输出参数，打开后fstat的结果（用作缓存校验）
+	 *
+	 * 返回值: 文件内容，失败返回nullptr
+	 */
+	FileContent read_static_file(const std::string &file_path,
+				     struct stat &st);
+
+	/**
+	 * set_file_body - 把文件设为响应体
+	 *
+	 * 小文件经static_cache从内存发送，大文件交给sendfile()。
+	 *
+	 * @response: 要填充的响应
+	 * @file_path: 文件路径
+	 * @st: 文件的stat结果
+	 * @cacheable: 是否允许放入static_cache
 	 *
-	 * 返回值: 文件内容字符串，失败返回空字符串
+	 * 返回值: 成功返回true，文件无法打开返回false
 	 */
-	std::string read_static_file(const std::string &file_path);
+	bool set_file_body(HttpResponse &response, const std::string &file_path,
+			   const struct stat &st, bool cacheable);
+
+	/**
+	 * check_not_modified - 设置缓存校验头并处理条件请求
+	 *
+	 * 设置ETag、Last-Modified和Cache-Control。If-None-Match（优先）
+	 * 或If-Modified-Since与当前版本一致时把响应改为304。
+	 *
+	 * @response: 要填充的响应
+	 * @st: 文件的stat结果
+	 * @etag_suffix: 区分同一文件不同编码版本的ETag后缀
+	 * @headers: 请求头
+	 *
+	 * 返回值: 返回304时为true
+	 */
+	bool check_not_modified(HttpResponse &response, const struct stat &st,
+				std::string_view etag_suffix,
+				const HttpHeaders &headers);
 
 	/**
 	 * get_http_mime_type - 获取文件的MIME类型
@@ -777,6 +1594,35 @@ private:
 	 */
 	std::string escape_html(const std::string &text);
 
+	/**
+	 * append_json_string - 追加 JSON 字符串内容
+	 *
+	 * 把文本按 JSON 字符串规则转义后追加到 out（不含两侧引号），
+	 * 用于热点接口直接拼接响应体。
+	 *
+	 * @out: 输出缓冲区
+	 * @text: 原始文本
+	 */
+	void append_json_string(std::string &out, std::string_view text);
+
+	/**
+	 * encode_lines_frame - 把行范围编码为二进制行帧
+	 *
+	 * 格式见 LINES_FRAME_MIME。文本直接从 TextBuffer 的行视图写入，
+	 * 偏移表在文本之后追加，整个窗口只遍历一次。
+	 *
+	 * @buffer: 文本缓冲区
+	 * @start_line: 起始行号（包含）
+	 * @end_line: 结束行号（不包含）
+	 * @with_tokens: 在偏移表之后追加词法单元区
+	 * @out: 输出缓冲区
+	 *
+	 * 返回值: 成功返回true，范围为空返回false
+	 */
+	bool encode_lines_frame(TextBuffer &buffer, size_t start_line,
+				size_t end_line, bool with_tokens,
+				std::string &out);
+
 	/**
 	 * detect_language_simple - 简化的语言检测函数
 	 *
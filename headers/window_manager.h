@@ -65,7 +65,7 @@
  * WebServer ws(&fm);
  * WindowManager wm(&ws);
  * if (wm.init()) {
- *     wm.load_frontend_page();
+ *     wm.load_frontend_page(WEB_SERVER_PORT);
  *     wm.show();
  *     wm.run();
  * }
@@ -80,7 +80,9 @@ public:
 	 * 初始化WindowManager对象，设置WebServer引用并初始化
 	 * GTK相关资源（如条件变量）。
 	 *
-	 * @web_server: WebServer对象的指针，用于服务器通信
+	 * @web_server: WebServer对象的指针，用于服务器通信；Web服务器
+	 *              与窗口并行启动时可以先传nullptr，之后调用
+	 *              set_web_server()
 	 */
 	WindowManager(WebServer *web_server);
 
@@ -157,9 +159,18 @@ public:
 	 *
 	 * 在WebView中加载前端页面。页面URL为本地Web服务器地址。
 	 *
+	 * @port: Web服务器端口
+	 *
 	 * 注意: WebServer必须已启动并正在监听。
 	 */
-	void load_frontend_page(void);
+	void load_frontend_page(int port);
+
+	/**
+	 * set_web_server - 设置WebServer指针
+	 *
+	 * @web_server: 已启动的WebServer
+	 */
+	void set_web_server(WebServer *web_server) { this->web_server = web_server; }
 
 	/* ====================================================================
 	 * 公共方法 - 文件对话框
@@ -27,6 +27,7 @@ src = lib.fileset.toSource {
             gtk4
             file
             nlohmann_json
+            re2
           ];
 
           buildPhase = ''
@@ -34,6 +35,7 @@ src = lib.fileset.toSource {
             g++ -std=c++23 -O2 -Wall -Wextra -Wpedantic \
                $(pkg-config --cflags webkitgtk-6.0 gtk4) \
                $(pkg-config --cflags nlohmann_json) \
+               $(pkg-config --cflags re2) \
                -Iheaders \
                src/main.cpp \
                src/file_manager.cpp \
@@ -43,10 +45,27 @@ src = lib.fileset.toSource {
                src/terminal_manager.cpp \
                src/process_launcher.cpp \
                src/terminal_window.cpp \
+               src/thread_pool.cpp \
+               src/piece_tree.cpp \
+               src/scrollback.cpp \
+               src/file_watcher.cpp \
+               src/mime_cache.cpp \
+               src/file_cache.cpp \
+               src/http_parser.cpp \
+               src/search_engine.cpp \
+               src/metrics.cpp \
+               src/logger.cpp \
+               src/text_buffer_registry.cpp \
+               src/file_operations.cpp \
+               src/syntax_tokenizer.cpp \
+               src/startup_trace.cpp \
+               src/web_assets.cpp \
+               src/json_fields.cpp \
                -o mikufy \
                $(pkg-config --libs webkitgtk-6.0 gtk4) \
                -lmagic \
-               $(pkg-config --libs nlohmann_json)
+               $(pkg-config --libs nlohmann_json) \
+               $(pkg-config --libs re2)
 
             # 编译 terminal_helper 独立程序
             g++ -std=c++23 -O2 -Wall -Wextra -Wpedantic \
@@ -176,12 +176,14 @@ BuildRequires:  file-devel
 BuildRequires:  glib2-devel
 BuildRequires:  file-libs
 BuildRequires:  nlohmann-json-devel
+BuildRequires:  re2-devel
 
 # 运行时依赖
 Requires:       webkitgtk6.0
 Requires:       gtk4
 Requires:       glib2
 Requires:       file-libs
+Requires:       re2
 
 %description
 Mikufy is a modern file editor with a beautiful web-based interface.
@@ -195,6 +197,10 @@ It provides syntax highlighting, file management, and a clean user experience.
 export CXXFLAGS="\$(pkg-config --cflags webkitgtk-6.0 gtk4)"
 export LDFLAGS="\$(pkg-config --libs webkitgtk-6.0 gtk4) -lmagic"
 
+# 添加 RE2（全文搜索的正则表达式）
+CXXFLAGS+=" \$(pkg-config --cflags re2)"
+LDFLAGS+=" \$(pkg-config --libs re2)"
+
 # 添加 nlohmann_json 如果可用
 if pkg-config --exists nlohmann_json 2>/dev/null; then
     CXXFLAGS+=" \$(pkg-config --cflags nlohmann_json)"
@@ -213,6 +219,22 @@ g++ -std=c++23 -O2 -Wall -Wextra -Wpedantic \\
     src/terminal_manager.cpp \\
     src/process_launcher.cpp \\
     src/terminal_window.cpp \\
+    src/thread_pool.cpp \\
+    src/piece_tree.cpp \\
+    src/scrollback.cpp \\
+    src/file_watcher.cpp \\
+    src/mime_cache.cpp \\
+    src/file_cache.cpp \\
+    src/http_parser.cpp \\
+    src/search_engine.cpp \\
+    src/metrics.cpp \\
+    src/logger.cpp \\
+    src/text_buffer_registry.cpp \\
+    src/file_operations.cpp \\
+    src/syntax_tokenizer.cpp \\
+    src/startup_trace.cpp \\
+    src/web_assets.cpp \\
+    src/json_fields.cpp \\
     \${LDFLAGS} \\
     -o mikufy
 
@@ -0,0 +1,1079 @@
+/*
+ * Mikufy v2.11-nova - 性能基准程序
+ *
+ * 这是一个独立的基准程序（./build.sh bench 生成 mikufy_bench），
+ * 直接链接编辑器的核心模块，测量:
+ * - TextBuffer: 加载大文件（含后台换行索引）、随机插入/删除序列、
+ *   随机位置的 get_lines 窗口
+ * - FileManager::get_directory_contents: 1万/10万条目的合成目录
+ * - FileCache: 多线程、工作集大于容量时的LRU命中和淘汰
+ * - Scrollback: 终端输出环形缓冲区的生产者/消费者吞吐
+ * - WebServer: 多连接keep-alive压测 /api/get-lines
+ *
+ * 测试数据由固定种子的伪随机数生成，同一种子的多次运行使用相同的
+ * 文件内容和操作序列。结果以JSON输出（默认标准输出），进度信息写到
+ * 标准错误。
+ *
+ * 用法: mikufy_bench [--quick|--full] [--filter 名称] [--output 文件]
+ *                    [--seed 种子] [--dir 临时目录] [--port 端口]
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/web_server.h"
+#include "../headers/scrollback.h"
+#include <netinet/tcp.h>	/* TCP_NODELAY */
+#include <sys/utsname.h>	/* uname() */
+#include <ftw.h>		/* nftw() 清理临时目录 */
+#include <algorithm>		/* std::sort */
+#include <atomic>		/* std::atomic */
+#include <chrono>		/* std::chrono::steady_clock */
+#include <cstdio>		/* fprintf() */
+#include <cstring>		/* memcpy(), strcmp() */
+#include <ctime>		/* time(), strftime() */
+#include <random>		/* std::mt19937_64 */
+#include <thread>		/* std::thread */
+
+/*
+ * ============================================================================
+ * 常量定义
+ * ============================================================================
+ */
+
+/* 默认随机数种子 */
+#define BENCH_DEFAULT_SEED		20250101ULL
+
+/* HTTP压测默认端口（避免与编辑器的8080冲突） */
+#define BENCH_DEFAULT_PORT		18091
+
+/* 生成测试文件时重复写出的随机文本块大小 */
+#define BENCH_TEXT_BLOCK_SIZE		(4 * 1024 * 1024)
+
+/* 测试文件的行最长字符数 */
+#define BENCH_MAX_LINE_LENGTH		120
+
+/* get_lines 窗口的行数（接近编辑器一屏加预取） */
+#define BENCH_WINDOW_LINES		100
+
+/*
+ * ============================================================================
+ * 数据结构定义
+ * ============================================================================
+ */
+
+/**
+ * BenchConfig - 运行参数
+ *
+ * 三档规模: quick 用于快速检查，默认档覆盖请求中的100MB和10万条目，
+ * full 额外加载1GB文件。
+ */
+struct BenchConfig {
+	bool quick = false;
+	bool full = false;
+	std::string filter;		/* 只运行名称包含此串的基准 */
+	std::string output;		/* JSON输出文件，空表示标准输出 */
+	std::string parent_dir = "/tmp";
+	uint64_t seed = BENCH_DEFAULT_SEED;
+	int port = BENCH_DEFAULT_PORT;
+
+	std::string work_dir;		/* 本次运行的临时目录 */
+};
+
+/**
+ * LatencyStats - 单次操作耗时分布（纳秒）
+ */
+struct LatencyStats {
+	std::vector<uint64_t> samples;
+
+	void add(std::chrono::steady_clock::duration elapsed)
+	{
+		samples.push_back(static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				elapsed).count()));
+	}
+
+	void merge(const LatencyStats &other)
+	{
+		samples.insert(samples.end(), other.samples.begin(),
+			       other.samples.end());
+	}
+
+	/**
+	 * to_json - 排序后输出均值和分位数
+	 */
+	json to_json(void)
+	{
+		json out = json::object();
+		if (samples.empty())
+			return out;
+
+		std::sort(samples.begin(), samples.end());
+		uint64_t sum = 0;
+		for (uint64_t value : samples)
+			sum += value;
+
+		auto percentile = [this](double p) {
+			size_t index = static_cast<size_t>(p * (samples.size() - 1));
+			return samples[index];
+		};
+
+		out["count"] = samples.size();
+		out["mean_ns"] = sum / samples.size();
+		out["p50_ns"] = percentile(0.50);
+		out["p90_ns"] = percentile(0.90);
+		out["p99_ns"] = percentile(0.99);
+		out["max_ns"] = samples.back();
+		return out;
+	}
+};
+
+/*
+ * ============================================================================
+ * 辅助函数
+ * ============================================================================
+ */
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+/**
+ * median - 多次重复的中位数
+ */
+static double median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+/**
+ * progress - 输出进度信息（标准错误，不混入JSON）
+ */
+template <typename... Args>
+static void progress(std::format_string<Args...> fmt, Args &&...args)
+{
+	std::string line = std::format(fmt, std::forward<Args>(args)...);
+	fprintf(stderr, "[bench] %s\n", line.c_str());
+}
+
+/**
+ * generate_text_file - 生成指定大小的合成文本文件
+ *
+ * 先按种子生成一个随机长度行组成的文本块，再重复写出到目标大小，
+ * 最后一次截断到行尾。相同种子和大小得到相同的文件。
+ *
+ * 返回值: 成功返回true
+ */
+static bool generate_text_file(const std::string &path, size_t size,
+			       uint64_t seed)
+{
+	static const char alphabet[] =
+		"abcdefghijklmnopqrstuvwxyz      ABCDEFGHIJ0123456789(){};=+-*/";
+	std::mt19937_64 rng(seed);
+	std::uniform_int_distribution<size_t> length_dist(0, BENCH_MAX_LINE_LENGTH);
+	std::uniform_int_distribution<size_t> char_dist(0, sizeof(alphabet) - 2);
+
+	std::string block;
+	block.reserve(BENCH_TEXT_BLOCK_SIZE + BENCH_MAX_LINE_LENGTH + 1);
+	while (block.size() < BENCH_TEXT_BLOCK_SIZE) {
+		size_t length = length_dist(rng);
+		for (size_t i = 0; i < length; i++)
+			block += alphabet[char_dist(rng)];
+		block += '\n';
+	}
+
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		      0644);
+	if (fd < 0)
+		return false;
+
+	size_t written = 0;
+	bool ok = true;
+	while (ok && written < size) {
+		size_t chunk = std::min(block.size(), size - written);
+		/* 最后一块截到换行处，文件以完整的行结束 */
+		if (chunk < block.size()) {
+			size_t newline = block.rfind('\n', chunk);
+			chunk = (newline == std::string::npos) ? chunk : newline + 1;
+			if (chunk == 0)
+				break;
+		}
+
+		size_t done = 0;
+		while (done < chunk) {
+			ssize_t n = write(fd, block.data() + done, chunk - done);
+			if (n <= 0) {
+				ok = false;
+				break;
+			}
+			done += static_cast<size_t>(n);
+		}
+		written += done;
+	}
+
+	close(fd);
+	return ok;
+}
+
+/**
+ * ensure_text_file - 生成（或复用本次运行已生成的）测试文件
+ */
+static std::string ensure_text_file(const BenchConfig &config, size_t size)
+{
+	std::string path = std::format("{}/text_{}.txt", config.work_dir, size);
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0)
+		return path;
+
+	progress("生成 {} MB 测试文件", size >> 20);
+	if (!generate_text_file(path, size, config.seed))
+		return "";
+	return path;
+}
+
+/**
+ * wait_indexed - 等待后台换行索引完成
+ */
+static void wait_indexed(TextBuffer &buffer)
+{
+	while (buffer.is_indexing())
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+/**
+ * remove_entry - nftw回调，删除一个条目
+ */
+static int remove_entry(const char *path, const struct stat *st, int type,
+			struct FTW *ftw)
+{
+	(void)st;
+	(void)type;
+	(void)ftw;
+	return remove(path);
+}
+
+/*
+ * ============================================================================
+ * TextBuffer 基准
+ * ============================================================================
+ */
+
+/**
+ * bench_textbuffer_load - 加载文件并等待换行索引完成
+ *
+ * load_seconds 是 load_file() 返回（可以开始显示）的时间，
+ * indexed_seconds 是行号全部可用的时间。数据来自页缓存（生成文件后
+ * 热的），测量的是编辑器本身而不是磁盘。
+ */
+static json bench_textbuffer_load(const BenchConfig &config, size_t size)
+{
+	json result;
+	result["name"] = std::format("textbuffer_load_{}mb", size >> 20);
+
+	std::string path = ensure_text_file(config, size);
+	if (path.empty()) {
+		result["error"] = "failed to generate test file";
+		return result;
+	}
+
+	const int repeat = 3;
+	std::vector<double> load_times;
+	std::vector<double> index_times;
+	size_t lines = 0;
+
+	for (int i = 0; i < repeat; i++) {
+		TextBuffer buffer;
+		auto start = bench_clock::now();
+		if (!buffer.load_file(path)) {
+			result["error"] = "load_file failed";
+			return result;
+		}
+		load_times.push_back(seconds_since(start));
+		wait_indexed(buffer);
+		index_times.push_back(seconds_since(start));
+		lines = buffer.get_line_count();
+	}
+
+	double indexed = median(index_times);
+	result["bytes"] = size;
+	result["lines"] = lines;
+	result["repeat"] = repeat;
+	result["load_seconds"] = median(load_times);
+	result["indexed_seconds"] = indexed;
+	result["indexed_mb_per_second"] = indexed > 0 ?
+		(size / 1048576.0) / indexed : 0;
+	result["runs_indexed_seconds"] = index_times;
+	return result;
+}
+
+/**
+ * bench_textbuffer_edit - 随机插入/删除序列
+ *
+ * 约七成插入（1~16字节）、三成删除（1~16字节），位置在整个文档上
+ * 均匀分布，模拟多光标或脚本批量修改。每次编辑单独计时。
+ */
+static json bench_textbuffer_edit(const BenchConfig &config)
+{
+	const size_t size = config.quick ? (4 << 20) : (16 << 20);
+	const size_t ops = config.quick ? 20000 : 200000;
+
+	json result;
+	result["name"] = "textbuffer_random_edits";
+
+	std::string path = ensure_text_file(config, size);
+	TextBuffer buffer;
+	if (path.empty() || !buffer.load_file(path)) {
+		result["error"] = "failed to load test file";
+		return result;
+	}
+	wait_indexed(buffer);
+
+	std::mt19937_64 rng(config.seed ^ 0x5eedULL);
+	std::uniform_int_distribution<int> kind_dist(0, 9);
+	std::uniform_int_distribution<size_t> length_dist(1, 16);
+	const std::string text(16, 'x');
+
+	LatencyStats inserts;
+	LatencyStats deletes;
+	size_t chars = buffer.get_char_count();
+
+	auto start = bench_clock::now();
+	for (size_t i = 0; i < ops; i++) {
+		size_t length = length_dist(rng);
+		size_t pos = std::uniform_int_distribution<size_t>(0, chars)(rng);
+
+		if (kind_dist(rng) < 7 || chars < length) {
+			auto op_start = bench_clock::now();
+			buffer.insert(pos, text.substr(0, length));
+			inserts.add(bench_clock::now() - op_start);
+			chars += length;
+		} else {
+			pos = std::min(pos, chars - length);
+			auto op_start = bench_clock::now();
+			buffer.delete_range(pos, pos + length);
+			deletes.add(bench_clock::now() - op_start);
+			chars -= length;
+		}
+	}
+	double elapsed = seconds_since(start);
+
+	result["initial_bytes"] = size;
+	result["ops"] = ops;
+	result["seconds"] = elapsed;
+	result["ops_per_second"] = elapsed > 0 ? ops / elapsed : 0;
+	result["insert"] = inserts.to_json();
+	result["delete"] = deletes.to_json();
+	result["final_chars_match"] = buffer.get_char_count() == chars;
+	return result;
+}
+
+/**
+ * bench_textbuffer_get_lines - 随机位置的行窗口
+ *
+ * 先做一批编辑让Piece树不再是单个Piece，再在整个文档上随机取
+ * BENCH_WINDOW_LINES 行的窗口。
+ */
+static json bench_textbuffer_get_lines(const BenchConfig &config)
+{
+	const size_t size = config.quick ? (16 << 20) : (100 << 20);
+	const size_t ops = config.quick ? 5000 : 20000;
+
+	json result;
+	result["name"] = "textbuffer_get_lines";
+
+	std::string path = ensure_text_file(config, size);
+	TextBuffer buffer;
+	if (path.empty() || !buffer.load_file(path)) {
+		result["error"] = "failed to load test file";
+		return result;
+	}
+	wait_indexed(buffer);
+
+	std::mt19937_64 rng(config.seed ^ 0x11e5ULL);
+	size_t chars = buffer.get_char_count();
+	for (int i = 0; i < 1000; i++) {
+		size_t pos = std::uniform_int_distribution<size_t>(0, chars)(rng);
+		buffer.insert(pos, "edit\n");
+		chars += 5;
+	}
+
+	const size_t total_lines = buffer.get_line_count();
+	const size_t max_start = total_lines > BENCH_WINDOW_LINES ?
+				 total_lines - BENCH_WINDOW_LINES : 0;
+	std::uniform_int_distribution<size_t> start_dist(0, max_start);
+
+	LatencyStats latency;
+	std::vector<std::string> lines;
+	size_t bytes = 0;
+
+	auto start = bench_clock::now();
+	for (size_t i = 0; i < ops; i++) {
+		size_t first = start_dist(rng);
+		lines.clear();
+		auto op_start = bench_clock::now();
+		buffer.get_lines(first, first + BENCH_WINDOW_LINES, lines);
+		latency.add(bench_clock::now() - op_start);
+		for (const auto &line : lines)
+			bytes += line.size();
+	}
+	double elapsed = seconds_since(start);
+
+	result["bytes"] = size;
+	result["lines"] = total_lines;
+	result["window_lines"] = BENCH_WINDOW_LINES;
+	result["ops"] = ops;
+	result["seconds"] = elapsed;
+	result["ops_per_second"] = elapsed > 0 ? ops / elapsed : 0;
+	result["bytes_returned"] = bytes;
+	result["latency"] = latency.to_json();
+	return result;
+}
+
+/*
+ * ============================================================================
+ * FileManager / FileCache 基准
+ * ============================================================================
+ */
+
+/**
+ * bench_directory_listing - 合成目录的列目录耗时
+ *
+ * 目录中每十个条目有一个子目录，其余是空文件。创建目录不计时。
+ */
+static json bench_directory_listing(const BenchConfig &config,
+				    FileManager &file_manager, size_t entries)
+{
+	json result;
+	result["name"] = std::format("directory_contents_{}", entries);
+
+	std::string dir = std::format("{}/dir_{}", config.work_dir, entries);
+	progress("创建 {} 个条目的目录", entries);
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+		result["error"] = "mkdir failed";
+		return result;
+	}
+
+	for (size_t i = 0; i < entries; i++) {
+		std::string entry = std::format("{}/entry_{:06}", dir, i);
+		if (i % 10 == 0) {
+			mkdir(entry.c_str(), 0755);
+			continue;
+		}
+		int fd = open(entry.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			result["error"] = "failed to create entries";
+			return result;
+		}
+		close(fd);
+	}
+
+	const int repeat = 5;
+	std::vector<double> times;
+	size_t returned = 0;
+	for (int i = 0; i < repeat; i++) {
+		std::vector<FileInfo> files;
+		auto start = bench_clock::now();
+		file_manager.get_directory_contents(dir, files);
+		times.push_back(seconds_since(start));
+		returned = files.size();
+	}
+
+	result["entries"] = entries;
+	result["entries_returned"] = returned;
+	result["repeat"] = repeat;
+	result["seconds"] = median(times);
+	result["runs_seconds"] = times;
+	return result;
+}
+
+/**
+ * bench_file_cache_churn - 工作集大于容量时的并发读取
+ *
+ * 键空间是容量的两倍，八成访问落在两成的热点键上；未命中时put，
+ * 触发淘汰。各线程使用不同种子，总操作序列仍然可复现。
+ */
+static json bench_file_cache_churn(const BenchConfig &config)
+{
+	const size_t entry_size = 4 * 1024;
+	const size_t capacity = 16 << 20;
+	const size_t keys = 2 * capacity / entry_size;
+	const size_t ops_per_thread = config.quick ? 100000 : 1000000;
+	const unsigned threads = std::max(1u, std::min(
+		4u, std::thread::hardware_concurrency()));
+
+	json result;
+	result["name"] = "file_cache_churn";
+
+	FileCache cache(capacity);
+
+	/* 每个键有独立的内容（淘汰时按内容区分刚插入的条目） */
+	std::vector<std::string> paths(keys);
+	std::vector<struct stat> stats(keys);
+	std::vector<FileContent> contents(keys);
+	for (size_t i = 0; i < keys; i++) {
+		contents[i] = std::make_shared<const std::string>(entry_size, 'c');
+		paths[i] = std::format("/bench/cache/file_{:06}", i);
+		memset(&stats[i], 0, sizeof(stats[i]));
+		stats[i].st_ino = i + 1;
+		stats[i].st_size = static_cast<off_t>(entry_size);
+		stats[i].st_mtim.tv_sec = 1;
+	}
+
+	std::atomic<uint64_t> hits(0);
+	std::vector<LatencyStats> latencies(threads);
+	std::vector<std::thread> workers;
+
+	auto start = bench_clock::now();
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			std::mt19937_64 rng(config.seed + t);
+			std::uniform_int_distribution<int> hot_dist(0, 9);
+			std::uniform_int_distribution<size_t> hot_key(0, keys / 5 - 1);
+			std::uniform_int_distribution<size_t> any_key(0, keys - 1);
+			uint64_t local_hits = 0;
+
+			for (size_t i = 0; i < ops_per_thread; i++) {
+				size_t key = hot_dist(rng) < 8 ? hot_key(rng) :
+								 any_key(rng);
+				auto op_start = bench_clock::now();
+				if (cache.get(paths[key], stats[key]))
+					local_hits++;
+				else
+					cache.put(paths[key], stats[key],
+						  contents[key]);
+				/* 每16次采样一次延迟，避免样本数组本身成为负担 */
+				if ((i & 15) == 0)
+					latencies[t].add(bench_clock::now() - op_start);
+			}
+			hits.fetch_add(local_hits);
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+	double elapsed = seconds_since(start);
+
+	LatencyStats latency;
+	for (const auto &stats_of_thread : latencies)
+		latency.merge(stats_of_thread);
+
+	const uint64_t total = ops_per_thread * threads;
+	result["threads"] = threads;
+	result["capacity_bytes"] = capacity;
+	result["keys"] = keys;
+	result["ops"] = total;
+	result["seconds"] = elapsed;
+	result["ops_per_second"] = elapsed > 0 ? total / elapsed : 0;
+	result["hit_rate"] = static_cast<double>(hits.load()) / total;
+	result["memory_usage"] = cache.memory_usage();
+	result["latency_sampled"] = latency.to_json();
+	return result;
+}
+
+/*
+ * ============================================================================
+ * Scrollback 基准
+ * ============================================================================
+ */
+
+/**
+ * bench_scrollback - 一个生产者、一个消费者的环形缓冲区吞吐
+ *
+ * 生产者按PTY读取的典型大小（4KB）提交，消费者每次最多读256KB后
+ * 前移消费位置，对应SSE推送终端输出的路径。
+ */
+static json bench_scrollback(const BenchConfig &config)
+{
+	const uint64_t total = config.quick ? (256ULL << 20) : (2048ULL << 20);
+	const size_t write_size = 4096;
+
+	json result;
+	result["name"] = "scrollback_throughput";
+
+	Scrollback scrollback;
+	char source[write_size];
+	memset(source, 'o', sizeof(source));
+
+	std::atomic<uint64_t> checksum(0);
+	uint64_t producer_stalls = 0;
+
+	auto start = bench_clock::now();
+	std::thread consumer([&] {
+		uint64_t seq = 0;
+		uint64_t sum = 0;
+		while (seq < total) {
+			uint64_t next = scrollback.read_from(seq, 256 * 1024,
+				[&sum](uint64_t chunk_seq, std::string_view chunk) {
+					(void)chunk_seq;
+					sum += chunk.size() + static_cast<unsigned char>(chunk[0]);
+				});
+			if (next == seq) {
+				std::this_thread::yield();
+				continue;
+			}
+			scrollback.advance(next);
+			seq = next;
+		}
+		checksum.store(sum);
+	});
+
+	uint64_t written = 0;
+	while (written < total) {
+		std::span<char> span = scrollback.write_span();
+		if (span.empty()) {
+			producer_stalls++;
+			std::this_thread::yield();
+			continue;
+		}
+		size_t n = std::min<uint64_t>({span.size(), write_size,
+					       total - written});
+		memcpy(span.data(), source, n);
+		scrollback.commit_write(n);
+		written += n;
+	}
+	consumer.join();
+	double elapsed = seconds_since(start);
+
+	result["bytes"] = total;
+	result["write_size"] = write_size;
+	result["seconds"] = elapsed;
+	result["mb_per_second"] = elapsed > 0 ? (total / 1048576.0) / elapsed : 0;
+	result["producer_stalls"] = producer_stalls;
+	result["checksum"] = checksum.load();
+	return result;
+}
+
+/*
+ * ============================================================================
+ * HTTP 压测
+ * ============================================================================
+ */
+
+/**
+ * HttpClient - 最小的keep-alive HTTP/1.1客户端（只用于压测）
+ */
+class HttpClient
+{
+public:
+	HttpClient(void) : fd(-1) {}
+	~HttpClient(void)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+
+	HttpClient(const HttpClient &) = delete;
+	HttpClient &operator=(const HttpClient &) = delete;
+
+	bool connect_to(int port)
+	{
+		fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return false;
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(static_cast<uint16_t>(port));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		return connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+			       sizeof(addr)) == 0;
+	}
+
+	/**
+	 * post - 发送POST请求并读取完整响应
+	 *
+	 * 返回值: HTTP状态码，连接或解析失败返回-1
+	 */
+	int post(const std::string &path, const std::string &body,
+		 const char *accept, std::string &response_body)
+	{
+		std::string request = std::format(
+			"POST {} HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+			"Content-Type: application/json\r\n"
+			"Accept: {}\r\nContent-Length: {}\r\n\r\n",
+			path, accept, body.size());
+		request += body;
+
+		size_t sent = 0;
+		while (sent < request.size()) {
+			ssize_t n = send(fd, request.data() + sent,
+					 request.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0)
+				return -1;
+			sent += static_cast<size_t>(n);
+		}
+
+		size_t header_end;
+		while ((header_end = pending.find("\r\n\r\n")) == std::string::npos) {
+			if (!fill())
+				return -1;
+		}
+
+		int status = -1;
+		if (sscanf(pending.c_str(), "HTTP/1.%*d %d", &status) != 1)
+			return -1;
+
+		size_t length = 0;
+		std::string_view headers(pending.data(), header_end);
+		size_t pos = 0;
+		while (pos < headers.size()) {
+			size_t eol = headers.find("\r\n", pos);
+			if (eol == std::string_view::npos)
+				eol = headers.size();
+			std::string_view line = headers.substr(pos, eol - pos);
+			if (line.size() > 15 &&
+			    strncasecmp(line.data(), "Content-Length:", 15) == 0)
+				length = strtoull(std::string(line.substr(15)).c_str(),
+						  nullptr, 10);
+			pos = eol + 2;
+		}
+
+		const size_t body_start = header_end + 4;
+		while (pending.size() < body_start + length) {
+			if (!fill())
+				return -1;
+		}
+
+		response_body.assign(pending, body_start, length);
+		pending.erase(0, body_start + length);
+		return status;
+	}
+
+private:
+	int fd;
+	std::string pending;	/* 已收到、尚未解析的数据 */
+
+	bool fill(void)
+	{
+		char buf[65536];
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n <= 0)
+			return false;
+		pending.append(buf, static_cast<size_t>(n));
+		return true;
+	}
+};
+
+/**
+ * bench_http_get_lines - 多连接压测 /api/get-lines
+ *
+ * 在本进程内启动WebServer，打开测试文件后，每个连接顺序发送随机
+ * 窗口的请求（keep-alive，不流水线）。分别测量JSON响应和二进制行帧。
+ */
+static json bench_http_get_lines(const BenchConfig &config,
+				 FileManager &file_manager)
+{
+	const size_t size = config.quick ? (4 << 20) : (16 << 20);
+	const size_t requests_per_connection = config.quick ? 1000 : 10000;
+	const unsigned connections = 8;
+
+	json result;
+	result["name"] = "http_get_lines";
+
+	std::string path = ensure_text_file(config, size);
+	if (path.empty()) {
+		result["error"] = "failed to generate test file";
+		return result;
+	}
+
+	WebServer server(&file_manager);
+	server.set_web_root_path(config.work_dir);
+	if (!server.start(config.port)) {
+		result["error"] = std::format("failed to listen on port {}",
+					      config.port);
+		return result;
+	}
+
+	/* 打开文件并等待索引完成，得到总行数 */
+	size_t total_lines = 0;
+	{
+		HttpClient client;
+		std::string body;
+		json open_request = {{"path", path}};
+		if (!client.connect_to(config.port) ||
+		    client.post("/api/open-file-virtual", open_request.dump(),
+				"application/json", body) != 200) {
+			server.stop();
+			result["error"] = "open-file-virtual failed";
+			return result;
+		}
+
+		while (true) {
+			if (client.post("/api/get-line-count", open_request.dump(),
+					"application/json", body) != 200)
+				break;
+			json reply = json::parse(body, nullptr, false);
+			if (reply.is_discarded() || !reply.value("success", false))
+				break;
+			total_lines = reply.value("totalLines", 0);
+			if (!reply.value("indexing", false))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	}
+
+	if (total_lines <= BENCH_WINDOW_LINES) {
+		server.stop();
+		result["error"] = "test file not indexed";
+		return result;
+	}
+
+	static const struct {
+		const char *mode;
+		const char *accept;
+	} modes[] = {
+		{ "json", "application/json" },
+		{ "frame", LINES_FRAME_MIME },
+	};
+
+	for (const auto &mode : modes) {
+		std::vector<LatencyStats> latencies(connections);
+		std::atomic<uint64_t> failures(0);
+		std::atomic<uint64_t> bytes(0);
+		std::vector<std::thread> clients;
+
+		auto start = bench_clock::now();
+		for (unsigned c = 0; c < connections; c++) {
+			clients.emplace_back([&, c] {
+				HttpClient client;
+				if (!client.connect_to(config.port)) {
+					failures.fetch_add(requests_per_connection);
+					return;
+				}
+
+				std::mt19937_64 rng(config.seed + 100 + c);
+				std::uniform_int_distribution<size_t> start_dist(
+					0, total_lines - BENCH_WINDOW_LINES);
+				std::string body;
+				uint64_t local_bytes = 0;
+
+				for (size_t i = 0; i < requests_per_connection; i++) {
+					size_t first = start_dist(rng);
+					std::string request = std::format(
+						"{{\"path\":\"{}\",\"start_line\":{},"
+						"\"end_line\":{}}}",
+						path, first, first + BENCH_WINDOW_LINES);
+
+					auto op_start = bench_clock::now();
+					int status = client.post("/api/get-lines", request,
+								 mode.accept, body);
+					latencies[c].add(bench_clock::now() - op_start);
+					if (status != 200) {
+						failures.fetch_add(requests_per_connection - i);
+						return;
+					}
+					local_bytes += body.size();
+				}
+				bytes.fetch_add(local_bytes);
+			});
+		}
+		for (auto &client : clients)
+			client.join();
+		double elapsed = seconds_since(start);
+
+		LatencyStats latency;
+		for (const auto &stats_of_connection : latencies)
+			latency.merge(stats_of_connection);
+
+		const uint64_t total = requests_per_connection * connections;
+		json entry;
+		entry["connections"] = connections;
+		entry["requests"] = total;
+		entry["failures"] = failures.load();
+		entry["seconds"] = elapsed;
+		entry["requests_per_second"] = elapsed > 0 ? total / elapsed : 0;
+		entry["response_bytes"] = bytes.load();
+		entry["latency"] = latency.to_json();
+		result[mode.mode] = entry;
+	}
+
+	server.stop();
+	result["file_bytes"] = size;
+	result["lines"] = total_lines;
+	result["window_lines"] = BENCH_WINDOW_LINES;
+	return result;
+}
+
+/*
+ * ============================================================================
+ * 主程序
+ * ============================================================================
+ */
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"用法: %s [选项]\n"
+		"  --quick          缩小规模，快速检查\n"
+		"  --full           额外加载1GB文件\n"
+		"  --filter NAME    只运行名称包含NAME的基准\n"
+		"  --output FILE    JSON结果写入FILE（默认标准输出）\n"
+		"  --seed N         随机数种子（默认%llu）\n"
+		"  --dir DIR        临时目录的父目录（默认/tmp）\n"
+		"  --port N         HTTP压测端口（默认%d）\n",
+		program, static_cast<unsigned long long>(BENCH_DEFAULT_SEED),
+		BENCH_DEFAULT_PORT);
+}
+
+/**
+ * parse_args - 解析命令行参数
+ *
+ * 返回值: 参数有效返回true
+ */
+static bool parse_args(int argc, char *argv[], BenchConfig &config)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const bool has_value = i + 1 < argc;
+
+		if (strcmp(arg, "--quick") == 0) {
+			config.quick = true;
+		} else if (strcmp(arg, "--full") == 0) {
+			config.full = true;
+		} else if (strcmp(arg, "--filter") == 0 && has_value) {
+			config.filter = argv[++i];
+		} else if (strcmp(arg, "--output") == 0 && has_value) {
+			config.output = argv[++i];
+		} else if (strcmp(arg, "--seed") == 0 && has_value) {
+			config.seed = strtoull(argv[++i], nullptr, 10);
+		} else if (strcmp(arg, "--dir") == 0 && has_value) {
+			config.parent_dir = argv[++i];
+		} else if (strcmp(arg, "--port") == 0 && has_value) {
+			config.port = atoi(argv[++i]);
+		} else {
+			return false;
+		}
+	}
+	return !(config.quick && config.full);
+}
+
+/**
+ * host_info - 运行环境（结果跨版本比较时需要）
+ */
+static json host_info(void)
+{
+	json host;
+	struct utsname name;
+	if (uname(&name) == 0) {
+		host["kernel"] = std::string(name.sysname) + " " + name.release;
+		host["machine"] = name.machine;
+	}
+	host["cpus"] = std::thread::hardware_concurrency();
+	host["compiler"] = __VERSION__;
+	return host;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchConfig config;
+	if (!parse_args(argc, argv, config)) {
+		print_usage(argv[0]);
+		return 2;
+	}
+
+	/* 基准期间只输出警告以上的日志，避免终端输出影响计时 */
+	Logger::instance().set_level(LogLevel::WARN);
+
+	/*
+	 * 各模块仍有直接写标准输出的提示信息，把它们转到标准错误，
+	 * 标准输出只留给JSON结果
+	 */
+	fflush(stdout);
+	int json_fd = dup(STDOUT_FILENO);
+	if (json_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+		fprintf(stderr, "无法重定向标准输出: %s\n", strerror(errno));
+		return 1;
+	}
+
+	std::string dir_template = config.parent_dir + "/mikufy-bench-XXXXXX";
+	if (!mkdtemp(dir_template.data())) {
+		fprintf(stderr, "无法创建临时目录: %s\n", strerror(errno));
+		return 1;
+	}
+	config.work_dir = dir_template;
+
+	FileManager file_manager;
+	json results = json::array();
+
+	auto run = [&](const std::string &name, const std::function<json()> &bench) {
+		if (!config.filter.empty() &&
+		    name.find(config.filter) == std::string::npos)
+			return;
+		progress("运行 {}", name);
+		json result = bench();
+		if (result.contains("error"))
+			progress("{} 失败: {}", name, result["error"].get<std::string>());
+		results.push_back(std::move(result));
+	};
+
+	const std::vector<size_t> load_sizes = config.quick ?
+		std::vector<size_t>{16ULL << 20} :
+		config.full ? std::vector<size_t>{100ULL << 20, 1024ULL << 20} :
+			      std::vector<size_t>{100ULL << 20};
+	for (size_t size : load_sizes) {
+		run(std::format("textbuffer_load_{}mb", size >> 20),
+		    [&] { return bench_textbuffer_load(config, size); });
+	}
+	run("textbuffer_random_edits",
+	    [&] { return bench_textbuffer_edit(config); });
+	run("textbuffer_get_lines",
+	    [&] { return bench_textbuffer_get_lines(config); });
+
+	const std::vector<size_t> dir_sizes = config.quick ?
+		std::vector<size_t>{10000} : std::vector<size_t>{10000, 100000};
+	for (size_t entries : dir_sizes) {
+		run(std::format("directory_contents_{}", entries), [&] {
+			return bench_directory_listing(config, file_manager, entries);
+		});
+	}
+	run("file_cache_churn", [&] { return bench_file_cache_churn(config); });
+	run("scrollback_throughput", [&] { return bench_scrollback(config); });
+	run("http_get_lines",
+	    [&] { return bench_http_get_lines(config, file_manager); });
+
+	nftw(config.work_dir.c_str(), remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+
+	char timestamp[32];
+	time_t now = time(nullptr);
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+	json report;
+	report["suite"] = "mikufy-bench";
+	report["version"] = "2.11-nova";
+	report["timestamp"] = timestamp;
+	report["profile"] = config.quick ? "quick" : config.full ? "full" : "default";
+	report["seed"] = config.seed;
+	report["host"] = host_info();
+	report["results"] = results;
+
+	std::string text = report.dump(2) + "\n";
+	if (config.output.empty()) {
+		FILE *file = fdopen(json_fd, "w");
+		if (!file)
+			return 1;
+		fwrite(text.data(), 1, text.size(), file);
+		fclose(file);
+	} else {
+		FILE *file = fopen(config.output.c_str(), "w");
+		if (!file) {
+			fprintf(stderr, "无法写入 %s: %s\n", config.output.c_str(),
+				strerror(errno));
+			return 1;
+		}
+		fwrite(text.data(), 1, text.size(), file);
+		fclose(file);
+		progress("结果已写入 {}", config.output);
+	}
+
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*
+ * Mikufy v2.11-nova - 文件内容缓存实现
+ *
+ * 本文件实现了FileCache类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/file_cache.h"
+#include <functional>		/* std::hash */
+#include <iterator>		/* std::prev, std::next */
+
+/* 每个条目除内容和路径外的固定开销估计：链表节点、哈希表节点和控制块 */
+#define FILE_CACHE_ENTRY_OVERHEAD	(sizeof(void *) * 12 + 64)
+
+/**
+ * mtime_ns - stat结果中的修改时间（纳秒）
+ */
+static int64_t mtime_ns(const struct stat &st)
+{
+	return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL +
+	       st.st_mtim.tv_nsec;
+}
+
+/**
+ * FileCache::FileCache - 构造函数
+ * @capacity: 所有分片合计的内存上限（字节）
+ */
+FileCache::FileCache(size_t capacity)
+	: capacity(capacity), usage(0), evict_cursor(0)
+{
+}
+
+/**
+ * FileCache::shard_for - 路径所在的分片
+ */
+FileCache::Shard &FileCache::shard_for(const std::string &path)
+{
+	const size_t h = std::hash<std::string_view>{}(path);
+	return shards[h & (FILE_CACHE_SHARDS - 1)];
+}
+
+/**
+ * FileCache::get - 查找文件内容
+ * @path: 文件路径
+ * @st: 文件当前的stat结果
+ *
+ * 命中时把条目移到链表头部（splice，不分配内存）。
+ */
+FileContent FileCache::get(const std::string &path, const struct stat &st)
+{
+	Shard &shard = shard_for(path);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	const auto it = shard.index.find(path);
+	if (it == shard.index.end())
+		return nullptr;
+
+	const EntryList::iterator entry = it->second;
+	if (entry->ino != static_cast<uint64_t>(st.st_ino) ||
+	    entry->mtime_ns != mtime_ns(st) ||
+	    entry->size != static_cast<uint64_t>(st.st_size)) {
+		/* 文件在缓存之后被修改或替换 */
+		erase_locked(shard, entry);
+		return nullptr;
+	}
+
+	shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+	return entry->content;
+}
+
+/**
+ * FileCache::put - 缓存文件内容
+ * @path: 文件路径
+ * @st: 读取内容前的stat结果
+ * @content: 文件内容
+ *
+ * 使用读取前的stat结果：读取期间文件被修改时，下次get()发现
+ * 修改时间不一致，缓存的内容不会被返回。
+ */
+void FileCache::put(const std::string &path, const struct stat &st,
+		    FileContent content)
+{
+	if (!content)
+		return;
+
+	const size_t charge = content->size() + path.size() +
+			      FILE_CACHE_ENTRY_OVERHEAD;
+
+	{
+		Shard &shard = shard_for(path);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		const auto it = shard.index.find(path);
+		if (it != shard.index.end())
+			erase_locked(shard, it->second);
+
+		if (charge > capacity)
+			return;
+
+		shard.lru.push_front(Entry{ path, content,
+					    static_cast<uint64_t>(st.st_ino),
+					    mtime_ns(st),
+					    static_cast<uint64_t>(st.st_size),
+					    charge });
+		shard.index.emplace(shard.lru.front().path, shard.lru.begin());
+		usage.fetch_add(charge, std::memory_order_relaxed);
+	}
+
+	if (usage.load(std::memory_order_relaxed) > capacity)
+		evict_over_capacity(content);
+}
+
+/**
+ * FileCache::erase_locked - 从分片中移除一个条目（调用者持有分片锁）
+ *
+ * 先从哈希表移除，键指向的字符串随后随链表节点一起释放。
+ */
+void FileCache::erase_locked(Shard &shard, EntryList::iterator it)
+{
+	usage.fetch_sub(it->charge, std::memory_order_relaxed);
+	shard.index.erase(it->path);
+	shard.lru.erase(it);
+}
+
+/**
+ * FileCache::evict_over_capacity - 淘汰条目直到占用不超过上限
+ * @keep: 刚插入的内容
+ *
+ * 从evict_cursor开始轮流取各分片的表尾，每次只锁一个分片。
+ * 所有分片都没有可淘汰的条目时停止。
+ */
+void FileCache::evict_over_capacity(const FileContent &keep)
+{
+	size_t idle = 0;
+
+	while (usage.load(std::memory_order_relaxed) > capacity &&
+	       idle < FILE_CACHE_SHARDS) {
+		const size_t index = evict_cursor.fetch_add(1,
+				std::memory_order_relaxed) & (FILE_CACHE_SHARDS - 1);
+		Shard &shard = shards[index];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		if (shard.lru.empty() || shard.lru.back().content == keep) {
+			idle++;
+			continue;
+		}
+
+		erase_locked(shard, std::prev(shard.lru.end()));
+		idle = 0;
+	}
+}
+
+/**
+ * FileCache::invalidate - 丢弃一个文件的缓存
+ */
+void FileCache::invalidate(const std::string &path)
+{
+	Shard &shard = shard_for(path);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	const auto it = shard.index.find(path);
+	if (it != shard.index.end())
+		erase_locked(shard, it->second);
+}
+
+/**
+ * FileCache::invalidate_prefix - 丢弃路径以prefix开头的所有缓存
+ */
+void FileCache::invalidate_prefix(const std::string &prefix)
+{
+	for (Shard &shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		for (auto it = shard.lru.begin(); it != shard.lru.end();) {
+			auto next = std::next(it);
+			if (it->path.starts_with(prefix))
+				erase_locked(shard, it);
+			it = next;
+		}
+	}
+}
+
+/**
+ * FileCache::clear - 清空所有缓存
+ */
+void FileCache::clear(void)
+{
+	for (Shard &shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		while (!shard.lru.empty())
+			erase_locked(shard, shard.lru.begin());
+	}
+}
+
+/**
+ * FileCache::memory_usage - 当前计入上限的内存（字节）
+ */
+size_t FileCache::memory_usage(void) const
+{
+	return usage.load(std::memory_order_relaxed);
+}
@@ -28,10 +28,23 @@
  */
 
 #include "../headers/file_manager.h"
+#include "../headers/metrics.h"	/* 文件缓存命中率 */
 #include <algorithm>		/* std::sort, std::find */
-#include <iostream>		/* std::cout, std::cerr */
+#include "../headers/logger.h"	/* log_warn(), log_error() */
+#include <cctype>		/* tolower() */
 #include <cerrno>		/* errno, strerror() */
 #include <format>		/* C++23 std::format */
+#include <string_view>		/* std::string_view 文件头签名 */
+
+/* read_file()的缓存命中情况和读取的字节数 */
+static MetricCounter &cache_hits = Metrics::instance().counter(
+	"mikufy_file_cache_hits_total", "read_file()命中文件缓存的次数");
+static MetricCounter &cache_misses = Metrics::instance().counter(
+	"mikufy_file_cache_misses_total", "read_file()未命中文件缓存的次数");
+static MetricCounter &cache_hit_bytes = Metrics::instance().counter(
+	"mikufy_file_cache_hit_bytes_total", "从文件缓存返回的字节数");
+static MetricCounter &disk_read_bytes = Metrics::instance().counter(
+	"mikufy_file_read_bytes_total", "read_file()从磁盘读取的字节数");
 
 /*
  * ============================================================================
@@ -42,12 +55,15 @@
 /**
  * FileManager - 构造函数
  *
- * 初始化FileManager对象，设置libmagic句柄为nullptr，并调用
- * init_magic()方法初始化libmagic库。同时初始化文件缓存。
+ * 初始化FileManager对象，设置libmagic句柄为nullptr。libmagic要加载
+ * 整个magic数据库，推迟到第一次需要时（classify_file()）才初始化，
+ * 不占用启动时间。同时初始化文件缓存，并从缓存目录加载上次保存的
+ * 文件类型判定结果。
  */
-FileManager::FileManager() : magic_cookie(nullptr), cache_size(0)
+FileManager::FileManager()
+	: magic_cookie(nullptr), magic_initialized(false),
+	  mime_cache(MimeCache::default_path()), file_cache(MAX_CACHE_SIZE)
 {
-	init_magic();
 }
 
 /**
@@ -72,13 +88,17 @@ FileManager::~FileManager(void)
  * 打开libmagic数据库并加载默认的magic文件。libmagic用于检测
  * 文件的MIME类型，判断文件是文本文件还是二进制文件。
  *
- * 返回值: 初始化成功返回true，失败返回false
+ * 只尝试一次，失败后不再重试（此后按application/octet-stream处理）。
  *
- * 注意: 该方法持有互斥锁，确保线程安全。
+ * 返回值: libmagic可用返回true，否则返回false
+ *
+ * 注意: 调用者必须持有magic_mutex。
  */
 bool FileManager::init_magic(void)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	if (magic_initialized)
+		return magic_cookie != nullptr;
+	magic_initialized = true;
 
 	/*
 	 * 打开libmagic数据库
@@ -111,7 +131,7 @@ bool FileManager::init_magic(void)
  */
 void FileManager::cleanup_magic(void)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::lock_guard<std::mutex> lock(magic_mutex);
 
 	if (magic_cookie) {
 		magic_close(magic_cookie);
@@ -125,118 +145,212 @@ void FileManager::cleanup_magic(void)
  * ============================================================================
  */
 
+/**
+ * DirEntryKey - 目录条目的排序键
+ *
+ * 名称连续存放在一个字符串中，条目只记录位置，读取10万个条目时
+ * 不为每个名称单独分配内存。
+ */
+struct DirEntryKey {
+	size_t offset;		/* 名称在names中的起始位置 */
+	size_t length;		/* 名称长度 */
+	bool is_directory;	/* 是否为目录 */
+	unsigned char d_type;	/* getdents64() 返回的类型 */
+};
+
+/**
+ * compare_dir_names - 比较两个名称（ASCII不区分大小写，相同时按字节）
+ */
+static int compare_dir_names(std::string_view a, std::string_view b)
+{
+	const size_t n = std::min(a.size(), b.size());
+
+	for (size_t i = 0; i < n; i++) {
+		int ca = tolower(static_cast<unsigned char>(a[i]));
+		int cb = tolower(static_cast<unsigned char>(b[i]));
+		if (ca != cb)
+			return ca - cb;
+	}
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	return a.compare(b);
+}
+
+/**
+ * dir_key_less - 目录在前，同类按名称
+ */
+static bool dir_key_less(bool a_directory, std::string_view a,
+			 bool b_directory, std::string_view b)
+{
+	if (a_directory != b_directory)
+		return a_directory;
+	return compare_dir_names(a, b) < 0;
+}
+
 /**
  * get_directory_contents - 获取目录内容
  *
  * 读取指定目录下的所有文件和子目录，并返回它们的详细信息。
- * 该方法会跳过"."和".."特殊目录，并限制最多读取1000个条目
- * 以防止在大目录中卡死。
+ * 该方法会跳过"."、".."和隐藏文件，只返回排序后的前
+ * MAX_DIR_ENTRIES 个条目。
  *
  * @path: 要读取的目录路径
- * @files: 输出参数，用于存储文件信息列表的引用
+ * @files: 输出参数，条目追加到末尾
  *
  * 返回值: 成功返回true，失败返回false
- *
- * 注意: 该方法持有互斥锁，确保线程安全。
  */
 bool FileManager::get_directory_contents(const std::string &path,
 					  std::vector<FileInfo> &files)
 {
-	std::lock_guard<std::mutex> lock(mutex);
-
-	/* 打开目录 */
-	DIR *dir = opendir(path.c_str());
-	if (!dir)
+	DirectoryPage page;
+	if (!list_directory(path, "", MAX_DIR_ENTRIES, page))
 		return false;
 
-	struct dirent *entry;
-	int count = 0;
+	files.insert(files.end(), std::make_move_iterator(page.files.begin()),
+		     std::make_move_iterator(page.files.end()));
+	return true;
+}
+
+/**
+ * list_directory - 分页读取目录内容
+ * @path: 目录路径
+ * @cursor: 上一页返回的游标（"d/名称" 或 "f/名称"），空表示第一页
+ * @limit: 本页最多的条目数
+ * @page: 输出参数，本页内容
+ *
+ * 只在本页内排序：过滤掉不大于游标的条目后用 partial_sort 取出
+ * 最小的 limit 个，O(n log limit)。不访问共享状态，不持有mutex。
+ *
+ * 返回值: 成功返回true，失败返回false
+ */
+bool FileManager::list_directory(const std::string &path,
+				 const std::string &cursor, size_t limit,
+				 DirectoryPage &page)
+{
+	page = DirectoryPage();
+	limit = std::clamp<size_t>(limit, 1, MAX_DIR_PAGE_SIZE);
+
+	/* 解析游标 */
+	const bool has_cursor = !cursor.empty();
+	bool cursor_directory = false;
+	std::string_view cursor_name;
+	if (has_cursor) {
+		if (cursor.size() < 2 || cursor[1] != '/' ||
+		    (cursor[0] != 'd' && cursor[0] != 'f'))
+			return false;
+		cursor_directory = cursor[0] == 'd';
+		cursor_name = std::string_view(cursor).substr(2);
+	}
+
+	int dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dir_fd < 0)
+		return false;
 
 	/*
-	 * 遍历目录中的所有条目
-	 * 优化：减少系统调用，延迟获取 MIME 类型
+	 * 一次读出所有名称，d_type 为 DT_UNKNOWN 的文件系统上才需要
+	 * 对每个条目 statx() 取类型
 	 */
-	while ((entry = readdir(dir)) != nullptr) {
-		/*
-		 * 跳过当前目录(.)和父目录(..)
-		 */
-		if (strcmp(entry->d_name, ".") == 0 ||
-		    strcmp(entry->d_name, "..") == 0)
-			continue;
+	std::string names;
+	std::vector<DirEntryKey> entries;
+	std::vector<char> buffer(DIR_READ_BUFFER_SIZE);
 
-		/*
-		 * 跳过隐藏文件（以.开头）
-		 */
-		if (entry->d_name[0] == '.' &&
-		    strcmp(entry->d_name, ".") != 0 &&
-		    strcmp(entry->d_name, "..") != 0)
-			continue;
+	while (true) {
+		ssize_t n = getdents64(dir_fd, buffer.data(), buffer.size());
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			close(dir_fd);
+			return false;
+		}
+		if (n == 0)
+			break;
 
-		FileInfo info;
-		info.name = entry->d_name;
+		for (ssize_t pos = 0; pos < n;) {
+			const struct dirent64 *entry =
+				reinterpret_cast<const struct dirent64 *>(
+					buffer.data() + pos);
+			pos += entry->d_reclen;
 
-		/* 构建完整路径 */
-		info.path = path;
-		if (info.path.back() != '/')
-			info.path += '/';
-		info.path += entry->d_name;
+			/* 跳过"."、".."和隐藏文件 */
+			if (entry->d_name[0] == '.')
+				continue;
 
-		/*
-		 * 获取文件状态信息
-		 * 优先使用 dirent 的 d_type 字段，避免 stat 调用
-		 */
-		if (entry->d_type != DT_UNKNOWN) {
-			/* 使用 dirent 提供的类型信息 */
-			info.is_directory = (entry->d_type == DT_DIR);
-			if (entry->d_type == DT_REG) {
-				/* 只对常规文件调用 stat 获取大小 */
-				struct stat stat_buf;
-				if (stat(info.path.c_str(), &stat_buf) == 0)
-					info.size = stat_buf.st_size;
-				else
-					info.size = 0;
-			} else {
-				info.size = 0;
+			bool is_directory = (entry->d_type == DT_DIR);
+			if (entry->d_type == DT_UNKNOWN) {
+				struct statx stx;
+				if (statx(dir_fd, entry->d_name, 0, STATX_TYPE,
+					  &stx) == 0)
+					is_directory = S_ISDIR(stx.stx_mode);
 			}
-		} else {
-			/* d_type 未知，必须调用 stat */
-			struct stat stat_buf;
-			if (stat(info.path.c_str(), &stat_buf) == 0) {
-				info.is_directory = S_ISDIR(stat_buf.st_mode);
-				info.size = stat_buf.st_size;
-			} else {
-				info.is_directory = false;
-				info.size = 0;
-			}
-		}
 
-		/*
-		 * 延迟获取 MIME 类型
-		 * 目录不需要检测，文件只在需要时检测（懒加载）
-		 */
-		if (info.is_directory) {
-			info.mime_type = "inode/directory";
-			info.is_binary = false;
-		} else {
-			/* 暂时不获取 MIME 类型，设置为空字符串 */
-			info.mime_type = "";
-			info.is_binary = false;
+			const size_t length = strlen(entry->d_name);
+			entries.push_back({ names.size(), length, is_directory,
+					    entry->d_type });
+			names.append(entry->d_name, length);
 		}
+	}
 
-		/* 将FileInfo添加到结果列表 */
-		files.push_back(info);
-		count++;
+	auto name_of = [&names](const DirEntryKey &key) {
+		return std::string_view(names).substr(key.offset, key.length);
+	};
+	auto key_less = [&name_of](const DirEntryKey &a, const DirEntryKey &b) {
+		return dir_key_less(a.is_directory, name_of(a),
+				    b.is_directory, name_of(b));
+	};
 
-		/*
-		 * 限制读取数量，防止在超大目录中卡死
-		 */
-		if (count >= MAX_DIR_ENTRIES)
-			break;
+	page.total = entries.size();
+
+	if (has_cursor) {
+		std::erase_if(entries, [&](const DirEntryKey &key) {
+			return !dir_key_less(cursor_directory, cursor_name,
+					     key.is_directory, name_of(key));
+		});
 	}
 
-	/* 关闭目录句柄 */
-	closedir(dir);
+	const bool more = entries.size() > limit;
+	if (more) {
+		std::partial_sort(entries.begin(), entries.begin() + limit,
+				  entries.end(), key_less);
+		entries.resize(limit);
+	} else {
+		std::sort(entries.begin(), entries.end(), key_less);
+	}
+
+	/*
+	 * 只对本页的常规文件取大小
+	 */
+	std::string prefix = path;
+	if (prefix.empty() || prefix.back() != '/')
+		prefix += '/';
+
+	page.files.reserve(entries.size());
+	for (const DirEntryKey &key : entries) {
+		FileInfo info;
+		info.name = name_of(key);
+		info.path = prefix + info.name;
+		info.is_directory = key.is_directory;
+		info.size = 0;
+		info.is_binary = false;
+		info.mime_type = key.is_directory ? "inode/directory" : "";
+
+		if (key.d_type == DT_REG ||
+		    (key.d_type == DT_UNKNOWN && !key.is_directory)) {
+			struct statx stx;
+			if (statx(dir_fd, info.name.c_str(), 0, STATX_SIZE,
+				  &stx) == 0)
+				info.size = stx.stx_size;
+		}
+
+		page.files.push_back(std::move(info));
+	}
+
+	if (more) {
+		const DirEntryKey &last = entries.back();
+		page.next_cursor = last.is_directory ? "d/" : "f/";
+		page.next_cursor += name_of(last);
+	}
 
+	close(dir_fd);
 	return true;
 }
 
@@ -250,54 +364,67 @@ bool FileManager::get_directory_contents(const std::string &path,
  * read_file - 读取文本文件内容
  *
  * 读取指定文件的内容并返回为字符串。该方法仅适用于文本文件，
- * 对于二进制文件会返回失败。文件内容以字符串形式返回。
- *
- * 优化要点:
- * - 使用LRU缓存机制，缓存已读取的文件内容
- * - 缓存命中时直接返回，避免磁盘I/O
- * - 缓存未命中时读取文件并缓存
- * - 使用内存预分配，减少重新分配次数
+ * 对于二进制文件会返回失败。内容从共享缓冲区拷贝一份交给调用者。
  *
  * @path: 要读取的文件路径
  * @content: 输出参数，用于存储文件内容的引用
  *
  * 返回值: 成功返回true，失败返回false
- *
- * 注意: 该方法持有互斥锁，确保线程安全。
  */
 bool FileManager::read_file(const std::string &path, std::string &content)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	FileContent shared;
+	if (!read_file(path, shared))
+		return false;
 
+	content = *shared;
+	return true;
+}
+
+/**
+ * read_file - 读取文本文件内容（共享缓冲区）
+ *
+ * 优化要点:
+ * - 使用分片LRU缓存，命中时直接返回共享缓冲区，不拷贝内容
+ * - 每次命中都用当前的stat结果校验，外部修改后重新从磁盘读取
+ * - 按fstat得到的大小一次分配、直接read()进字符串
+ *
+ * @path: 要读取的文件路径
+ * @content: 输出参数，文件内容
+ *
+ * 返回值: 成功返回true，失败返回false
+ *
+ * 注意: 缓存和文件类型判定各自加锁，该方法不持有mutex，
+ *       并发读取不同文件不会互相等待。
+ */
+bool FileManager::read_file(const std::string &path, FileContent &content)
+{
 	/*
-	 * 检查文件是否存在
+	 * 检查文件是否存在，同时得到校验缓存用的stat结果
 	 */
-	if (!is_file(path))
+	struct stat stat_buf;
+	if (stat(path.c_str(), &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode))
 		return false;
 
 	/*
 	 * 尝试从缓存中获取文件内容
 	 * 缓存命中时直接返回，大幅提升性能
 	 */
-	if (get_cached_file(path, content))
+	content = file_cache.get(path, stat_buf);
+	if (content) {
+		cache_hits.add();
+		cache_hit_bytes.add(content->size());
 		return true;
-
-	/*
-	 * 缓存未命中，从磁盘读取文件
-	 */
-
-	/*
-	 * 获取文件大小
-	 * 防止读取超大文件导致内存溢出
-	 */
-	const size_t file_size = get_file_size(path);
+	}
+	cache_misses.add();
 
 	/*
 	 * 检查文件大小是否超过限制
+	 * 防止读取超大文件导致内存溢出
 	 */
-	if (file_size > MAX_FILE_READ_SIZE) {
-		std::cerr << std::format("文件过大（{} 字节），超过限制 {} 字节",
-					file_size, MAX_FILE_READ_SIZE) << std::endl;
+	if (static_cast<size_t>(stat_buf.st_size) > MAX_FILE_READ_SIZE) {
+		log_warn("文件过大（{} 字节），超过限制 {} 字节",
+			 stat_buf.st_size, MAX_FILE_READ_SIZE);
 		return false;
 	}
 
@@ -307,46 +434,51 @@ bool FileManager::read_file(const std::string &path, std::string &content)
 	if (is_binary_file(path))
 		return false;
 
-	/*
-	 * 打开文件（二进制模式以保留原始编码）
-	 */
-	std::ifstream file(path, std::ios::binary);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0)
+		return false;
 
 	/*
-	 * 检查文件是否成功打开
+	 * 以打开后的fstat为准：读取期间文件被修改时，缓存的修改时间
+	 * 与之后的stat不一致，旧内容不会被返回
 	 */
-	if (!file.is_open())
+	if (fstat(fd, &stat_buf) != 0 ||
+	    static_cast<size_t>(stat_buf.st_size) > MAX_FILE_READ_SIZE) {
+		close(fd);
 		return false;
+	}
 
-	/*
-	 * 预分配内存
-	 * 避免多次重新分配，提高性能
-	 */
+	auto data = std::make_shared<std::string>();
 	try {
-		content.reserve(file_size);
+		data->resize(stat_buf.st_size);
 	} catch (const std::bad_alloc &) {
-		std::cerr << "内存分配失败，文件大小: " << file_size << std::endl;
-		file.close();
+		log_error("内存分配失败，文件大小: {}", stat_buf.st_size);
+		close(fd);
 		return false;
 	}
 
-	/*
-	 * 读取文件内容到字符串流
-	 */
-	std::stringstream buffer;
-	buffer << file.rdbuf();
-	content = buffer.str();
-
-	/*
-	 * 关闭文件
-	 */
-	file.close();
+	size_t total = 0;
+	while (total < data->size()) {
+		ssize_t ret = read(fd, data->data() + total, data->size() - total);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0) {
+			close(fd);
+			return false;
+		}
+		if (ret == 0)
+			break;	/* 文件在读取期间被截短 */
+		total += ret;
+	}
+	close(fd);
+	data->resize(total);
 
 	/*
 	 * 将文件内容缓存
-	 * 使用移动语义避免字符串拷贝
 	 */
-	cache_file(path, content, file_size);
+	disk_read_bytes.add(total);
+	content = std::move(data);
+	file_cache.put(path, stat_buf, content);
 
 	return true;
 }
@@ -454,7 +586,7 @@ bool FileManager::write_file(const std::string &path,
 	 * 文件已修改，需要清除旧缓存
 	 * 下次读取时将重新从磁盘加载
 	 */
-	invalidate_cache(path);
+	file_cache.invalidate(path);
 
 	return true;
 }
@@ -549,80 +681,92 @@ bool FileManager::delete_item(const std::string &path)
 {
 	std::lock_guard<std::mutex> lock(mutex);
 
-	/* 检查路径是否存在 */
-	if (!path_exists(path))
+	/* 检查路径是否存在（指向目录的符号链接按文件删除） */
+	struct stat stat_buf;
+	if (lstat(path.c_str(), &stat_buf) != 0)
 		return false;
 
 	/* 根据类型选择删除方法 */
-	if (is_directory(path))
+	if (S_ISDIR(stat_buf.st_mode))
 		return delete_directory_recursive(path);
 	else
 		return (unlink(path.c_str()) == 0);
 }
 
 /**
- * delete_directory_recursive - 递归删除目录
- *
- * 递归删除指定目录及其所有子目录和文件。该方法会先删除
- * 目录中的所有内容，最后删除目录本身。
- *
- * @path: 要删除的目录路径
+ * remove_tree_at - 删除父目录中的一个目录树
+ * @parent_fd: 父目录的fd（或AT_FDCWD）
+ * @name: 目录名称（parent_fd为AT_FDCWD时可以是完整路径）
  *
- * 返回值: 成功返回true，失败返回false
- *
- * 注意: 这是一个危险操作，删除的内容无法恢复。
+ * 所有操作都相对于已打开的目录fd，不拼接路径。不跟随符号链接：
+ * 指向目录的链接只删除链接本身。
  */
-bool FileManager::delete_directory_recursive(const std::string &path)
+static bool remove_tree_at(int parent_fd, const char *name)
 {
-	/* 打开目录 */
-	DIR *dir = opendir(path.c_str());
-	if (!dir)
+	int fd = openat(parent_fd, name,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
 		return false;
 
+	DIR *dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return false;
+	}
+
 	struct dirent *entry;
 	bool success = true;
 
-	/* 遍历目录中的所有条目 */
 	while ((entry = readdir(dir)) != nullptr) {
-		/*
-		 * 跳过当前目录(.)和父目录(..)
-		 * 必须跳过这两个，否则会导致无限递归
-		 */
+		/* 跳过当前目录(.)和父目录(..) */
 		if (strcmp(entry->d_name, ".") == 0 ||
 		    strcmp(entry->d_name, "..") == 0)
 			continue;
 
-		/* 构建完整路径 */
-		std::string item_path = path;
-		if (item_path.back() != '/')
-			item_path += '/';
-		item_path += entry->d_name;
-
-		/* 获取文件状态 */
-		struct stat stat_buf;
-		if (stat(item_path.c_str(), &stat_buf) == 0) {
-			if (S_ISDIR(stat_buf.st_mode)) {
-				/* 递归删除子目录 */
-				if (!delete_directory_recursive(item_path))
-					success = false;
-			} else {
-				/* 删除文件 */
-				if (unlink(item_path.c_str()) != 0)
-					success = false;
-			}
+		bool is_dir = (entry->d_type == DT_DIR);
+		if (entry->d_type == DT_UNKNOWN) {
+			struct stat stat_buf;
+			if (fstatat(fd, entry->d_name, &stat_buf,
+				    AT_SYMLINK_NOFOLLOW) == 0)
+				is_dir = S_ISDIR(stat_buf.st_mode);
+		}
+
+		if (is_dir) {
+			if (!remove_tree_at(fd, entry->d_name))
+				success = false;
+		} else if (unlinkat(fd, entry->d_name, 0) != 0) {
+			success = false;
 		}
 	}
 
-	/* 关闭目录句柄 */
+	/* 关闭目录句柄（同时关闭fd） */
 	closedir(dir);
 
 	/* 删除空目录 */
-	if (rmdir(path.c_str()) != 0)
+	if (unlinkat(parent_fd, name, AT_REMOVEDIR) != 0)
 		success = false;
 
 	return success;
 }
 
+/**
+ * delete_directory_recursive - 递归删除目录
+ *
+ * 递归删除指定目录及其所有子目录和文件。该方法会先删除
+ * 目录中的所有内容，最后删除目录本身。
+ *
+ * @path: 要删除的目录路径
+ *
+ * 返回值: 成功返回true，失败返回false
+ *
+ * 注意: 这是一个危险操作，删除的内容无法恢复。大目录树应使用
+ *       FileOperationJob在后台删除。
+ */
+bool FileManager::delete_directory_recursive(const std::string &path)
+{
+	return remove_tree_at(AT_FDCWD, path.c_str());
+}
+
 /*
  * ============================================================================
  * 公共方法实现 - 重命名操作
@@ -683,10 +827,15 @@ bool FileManager::get_file_info(const std::string &path, FileInfo &info)
 	info.is_directory = S_ISDIR(stat_buf.st_mode);
 	info.size = stat_buf.st_size;
 
-	/* 填充MIME类型信息 */
+	/* 填充MIME类型信息，一次判定同时得到两项 */
 	if (!info.is_directory) {
-		info.mime_type = get_mime_type(path);
-		info.is_binary = is_binary_file(path);
+		MimeInfo mime;
+		if (!classify_file(path, mime)) {
+			mime.mime_type = "application/octet-stream";
+			mime.is_binary = true;
+		}
+		info.mime_type = std::move(mime.mime_type);
+		info.is_binary = mime.is_binary;
 	} else {
 		info.mime_type = "inode/directory";
 		info.is_binary = false;
@@ -776,11 +925,7 @@ size_t FileManager::get_file_size(const std::string &path)
 /**
  * is_binary_file - 判断文件是否为二进制文件
  *
- * 根据文件的MIME类型判断是否为二进制文件。常见的文本类型
- * （如text/ *、application/json等）将被识别为文本文件。
- *
- * 使用哈希表实现O(1)时间复杂度的查找，替代原有的O(n)循环查找。
- * 这对频繁的文件类型检测有显著性能提升。
+ * 判定结果来自classify_file()，文件不存在时按二进制处理。
  *
  * @path: 文件路径
  *
@@ -789,6 +934,271 @@ size_t FileManager::get_file_size(const std::string &path)
  * 注意: 该方法不获取锁，因为调用者可能已经持有锁。
  */
 bool FileManager::is_binary_file(const std::string &path)
+{
+	MimeInfo info;
+	if (!classify_file(path, info))
+		return true;
+
+	return info.is_binary;
+}
+
+/**
+ * get_mime_type - 获取文件MIME类型
+ *
+ * 判定结果来自classify_file()。
+ *
+ * @path: 文件路径
+ *
+ * 返回值: MIME类型字符串，失败返回"application/octet-stream"
+ *
+ * 注意: 该方法不获取锁，因为调用者可能已经持有锁。
+ */
+std::string FileManager::get_mime_type(const std::string &path)
+{
+	MimeInfo info;
+	if (!classify_file(path, info))
+		return "application/octet-stream";
+
+	return info.mime_type;
+}
+
+/*
+ * ============================================================================
+ * 私有方法实现 - 文件类型判定
+ * ============================================================================
+ */
+
+/**
+ * classify_file - 判定文件的MIME类型和是否为二进制
+ *
+ * 目录、设备、FIFO等非普通文件直接交给libmagic（它不会读取这些
+ * 文件的内容），结果也不缓存。
+ *
+ * @path: 文件路径
+ * @info: 输出参数，判定结果
+ *
+ * 返回值: 文件存在返回true
+ *
+ * 注意: 该方法不获取mutex，因为调用者可能已经持有锁。
+ */
+bool FileManager::classify_file(const std::string &path, MimeInfo &info)
+{
+	struct stat stat_buf;
+	if (stat(path.c_str(), &stat_buf) != 0)
+		return false;
+
+	const bool regular = S_ISREG(stat_buf.st_mode);
+	if (regular && mime_cache.lookup(stat_buf, info))
+		return true;
+
+	if (!regular || !sniff_file(path, info)) {
+		/* 快速判定失败，使用libmagic检测 */
+		const char *mime_type = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(magic_mutex);
+			if (init_magic())
+				mime_type = magic_file(magic_cookie, path.c_str());
+			info.mime_type = mime_type ? mime_type :
+					 "application/octet-stream";
+		}
+		info.is_binary = is_binary_mime(info.mime_type);
+	}
+
+	if (regular)
+		mime_cache.store(stat_buf, info);
+
+	return true;
+}
+
+/**
+ * is_utf8_text - 检查数据是否是合法的UTF-8文本
+ * @data: 文件开头的数据
+ * @truncated: 数据是否被截断（末尾不完整的多字节字符不算错误）
+ *
+ * 除常见的空白和转义字符外不允许出现控制字符。
+ */
+static bool is_utf8_text(std::string_view data, bool truncated)
+{
+	size_t i = 0;
+
+	while (i < data.size()) {
+		const unsigned char c = data[i];
+
+		if (c < 0x80) {
+			if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' &&
+			    c != '\f' && c != '\v' && c != '\a' && c != '\b' &&
+			    c != 0x1b)
+				return false;
+			if (c == 0x7f)
+				return false;
+			i++;
+			continue;
+		}
+
+		/* 多字节字符：根据首字节确定长度，拒绝过长编码和代理区 */
+		size_t len;
+		unsigned char min_second = 0x80, max_second = 0xbf;
+		if (c >= 0xc2 && c <= 0xdf) {
+			len = 2;
+		} else if (c >= 0xe0 && c <= 0xef) {
+			len = 3;
+			if (c == 0xe0)
+				min_second = 0xa0;
+			else if (c == 0xed)
+				max_second = 0x9f;
+		} else if (c >= 0xf0 && c <= 0xf4) {
+			len = 4;
+			if (c == 0xf0)
+				min_second = 0x90;
+			else if (c == 0xf4)
+				max_second = 0x8f;
+		} else {
+			return false;
+		}
+
+		if (i + len > data.size())
+			return truncated;
+
+		const unsigned char second = data[i + 1];
+		if (second < min_second || second > max_second)
+			return false;
+		for (size_t k = 2; k < len; k++) {
+			if ((static_cast<unsigned char>(data[i + k]) & 0xc0) != 0x80)
+				return false;
+		}
+
+		i += len;
+	}
+
+	return true;
+}
+
+/**
+ * sniff_file - 根据文件头和扩展名快速判定
+ *
+ * 只处理能确定结果的情况：常见二进制格式的签名，以及扩展名已知
+ * 的UTF-8文本。没有扩展名或扩展名未知的文本（Makefile、README等）
+ * 仍交给libmagic，保证给出的MIME类型与之前一致。
+ *
+ * @path: 文件路径
+ * @info: 输出参数，判定结果
+ *
+ * 返回值: 能够判定返回true，需要交给libmagic返回false
+ */
+bool FileManager::sniff_file(const std::string &path, MimeInfo &info)
+{
+	using namespace std::string_view_literals;
+
+	/* 常见二进制格式的文件头签名 */
+	static const struct {
+		std::string_view magic;
+		const char *mime_type;
+	} signatures[] = {
+		{ "\x89PNG\r\n\x1a\n"sv,	"image/png" },
+		{ "\xff\xd8\xff"sv,		"image/jpeg" },
+		{ "GIF87a"sv,			"image/gif" },
+		{ "GIF89a"sv,			"image/gif" },
+		{ "%PDF-"sv,			"application/pdf" },
+		{ "PK\x03\x04"sv,		"application/zip" },
+		{ "\x1f\x8b"sv,		"application/gzip" },
+		{ "7z\xbc\xaf\x27\x1c"sv,	"application/x-7z-compressed" },
+		{ "\xfd" "7zXZ\0"sv,		"application/x-xz" },
+		{ "\x7f" "ELF"sv,		"application/x-executable" },
+		{ "\0asm"sv,			"application/wasm" },
+		{ "SQLite format 3\0"sv,	"application/vnd.sqlite3" },
+		{ "OggS"sv,			"audio/ogg" },
+		{ "fLaC"sv,			"audio/flac" },
+	};
+
+	/* 扩展名已知的文本文件及其MIME类型 */
+	static const std::unordered_map<std::string_view, const char *> text_types = {
+		{ ".txt", "text/plain" },	{ ".log", "text/plain" },
+		{ ".md", "text/markdown" },	{ ".markdown", "text/markdown" },
+		{ ".c", "text/x-c" },		{ ".h", "text/x-c" },
+		{ ".cpp", "text/x-c++" },	{ ".cc", "text/x-c++" },
+		{ ".cxx", "text/x-c++" },	{ ".hpp", "text/x-c++" },
+		{ ".hh", "text/x-c++" },	{ ".hxx", "text/x-c++" },
+		{ ".js", "text/javascript" },	{ ".mjs", "text/javascript" },
+		{ ".ts", "text/plain" },	{ ".json", "application/json" },
+		{ ".html", "text/html" },	{ ".htm", "text/html" },
+		{ ".css", "text/css" },		{ ".xml", "text/xml" },
+		{ ".py", "text/x-python" },	{ ".sh", "text/x-shellscript" },
+		{ ".rb", "text/x-ruby" },	{ ".php", "text/x-php" },
+		{ ".pl", "text/x-perl" },	{ ".sql", "text/x-sql" },
+		{ ".yaml", "text/yaml" },	{ ".yml", "text/yaml" },
+		{ ".toml", "text/x-toml" },	{ ".ini", "text/x-ini" },
+		{ ".rs", "text/plain" },	{ ".go", "text/plain" },
+		{ ".java", "text/x-java" },	{ ".lua", "text/x-lua" },
+		{ ".nix", "text/plain" },	{ ".cmake", "text/plain" },
+		{ ".csv", "text/csv" },		{ ".conf", "text/plain" },
+	};
+
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0)
+		return false;
+
+	char buf[MIME_SNIFF_SIZE];
+	ssize_t n;
+	do {
+		n = read(fd, buf, sizeof(buf));
+	} while (n < 0 && errno == EINTR);
+	close(fd);
+
+	if (n < 0)
+		return false;
+
+	if (n == 0) {
+		info.mime_type = "inode/x-empty";
+		info.is_binary = false;
+		return true;
+	}
+
+	const std::string_view head(buf, n);
+	for (const auto &sig : signatures) {
+		if (head.starts_with(sig.magic)) {
+			info.mime_type = sig.mime_type;
+			info.is_binary = true;
+			return true;
+		}
+	}
+
+	/* 扩展名：最后一个/之后的最后一个.，统一转为小写 */
+	const size_t slash = path.find_last_of('/');
+	const size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos ||
+	    (slash != std::string::npos && dot < slash) ||
+	    path.size() - dot > 16)
+		return false;
+
+	char ext[16];
+	size_t ext_len = path.size() - dot;
+	for (size_t i = 0; i < ext_len; i++)
+		ext[i] = static_cast<char>(tolower(
+			static_cast<unsigned char>(path[dot + i])));
+
+	const auto it = text_types.find(std::string_view(ext, ext_len));
+	if (it == text_types.end())
+		return false;
+
+	if (!is_utf8_text(head, static_cast<size_t>(n) == sizeof(buf)))
+		return false;
+
+	info.mime_type = it->second;
+	info.is_binary = false;
+	return true;
+}
+
+/**
+ * is_binary_mime - 判断MIME类型是否表示二进制文件
+ *
+ * 常见的文本类型（如text/ *、application/json等）将被识别为文本。
+ * 使用哈希表实现O(1)时间复杂度的查找，替代原有的O(n)循环查找。
+ *
+ * @mime_type: MIME类型字符串
+ *
+ * 返回值: 二进制类型返回true，文本类型返回false
+ */
+bool FileManager::is_binary_mime(const std::string &mime_type)
 {
 	/*
 	 * 静态哈希表存储所有已知的文本MIME类型
@@ -879,8 +1289,6 @@ bool FileManager::is_binary_file(const std::string &path)
 		"application/x-rss+xml"
 	};
 
-	std::string mime_type = get_mime_type(path);
-
 	/*
 	 * 空文件不是二进制文件
 	 * libmagic可能返回不同的空文件类型字符串
@@ -913,31 +1321,6 @@ bool FileManager::is_binary_file(const std::string &path)
 	return (text_mime_types.find(mime_type) == text_mime_types.end());
 }
 
-/**
- * get_mime_type - 获取文件MIME类型
- *
- * 使用libmagic库检测文件的MIME类型。MIME类型用于标识
- * 文件的类型和格式。
- *
- * @path: 文件路径
- *
- * 返回值: MIME类型字符串，失败返回"application/octet-stream"
- *
- * 注意: 该方法不获取锁，因为调用者可能已经持有锁。
- */
-std::string FileManager::get_mime_type(const std::string &path)
-{
-	/* 检查libmagic是否已初始化 */
-	if (!magic_cookie)
-		return "application/octet-stream";
-
-	/* 使用libmagic检测文件类型 */
-	const char *mime_type = magic_file(magic_cookie, path.c_str());
-	if (!mime_type)
-		return "application/octet-stream";
-
-	return std::string(mime_type);
-}
 
 /*
  * ============================================================================
@@ -1144,264 +1527,24 @@ std::string FileManager::get_file_extension(const std::string &filename)
 
 /*
  * ============================================================================
- * 缓存管理方法实现
+ * 公共方法实现 - 缓存失效
  * ============================================================================
  */
 
 /**
- * get_cached_file - 从缓存中获取文件内容
- *
- * 尝试从缓存中获取指定路径的文件内容。
- * 如果缓存命中，更新LRU链表，将文件移到链表头部。
- *
- * 优化要点:
- * - 使用哈希表实现O(1)查找
- * - 使用LRU链表管理访问顺序
- * - 缓存命中时更新时间戳和LRU链表
- *
- * @path: 文件路径
- * @content: 输出参数，存储缓存的内容
- *
- * 返回值: 缓存命中返回true，未命中返回false
- *
- * 注意: 该方法需要持有互斥锁才能调用。
- */
-bool FileManager::get_cached_file(const std::string &path, std::string &content)
-{
-	/*
-	 * 在哈希表中查找缓存条目
-	 */
-	const auto it = file_cache.find(path);
-
-	/*
-	 * 缓存未命中
-	 */
-	if (it == file_cache.end())
-		return false;
-
-	/*
-	 * 缓存命中，更新时间戳
-	 */
-	it->second.timestamp = std::chrono::system_clock::now();
-
-	/*
-	 * 更新LRU链表
-	 * 从原位置移除，插入到头部
-	 */
-	file_cache_lru.remove(path);
-	file_cache_lru.push_front(path);
-
-	/*
-	 * 返回缓存内容
-	 */
-	content = it->second.content;
-
-	return true;
-}
-
-/**
- * cache_file - 将文件内容缓存
- *
- * 将文件内容添加到缓存中。
- * 如果缓存已满，按照LRU策略淘汰最久未使用的文件。
- *
- * 优化要点:
- * - 使用LRU策略管理缓存，淘汰最久未使用的条目
- * - 预先检查缓存大小，避免频繁的淘汰操作
- * - 使用移动语义减少字符串拷贝
- *
- * @path: 文件路径
- * @content: 文件内容
- * @size: 文件大小（字节）
- *
- * 注意: 该方法需要持有互斥锁才能调用。
- */
-void FileManager::cache_file(const std::string &path, const std::string &content,
-			     size_t size)
-{
-	/*
-	 * 检查文件是否已在缓存中
-	 */
-	const auto it = file_cache.find(path);
-
-	/*
-	 * 如果文件已在缓存中，先移除旧的条目
-	 */
-	if (it != file_cache.end()) {
-		/*
-		 * 从LRU链表中移除
-		 */
-		file_cache_lru.remove(path);
-
-		/*
-		 * 从缓存大小中减去旧文件大小
-		 */
-		cache_size -= it->second.size;
-
-		/*
-		 * 从哈希表中移除
-		 */
-		file_cache.erase(it);
-	}
-
-	/*
-	 * 检查是否需要淘汰缓存
-	 * 如果新文件大小超过缓存限制，直接拒绝缓存
-	 */
-	if (size > MAX_CACHE_SIZE)
-		return;
-
-	/*
-	 * 检查缓存空间是否足够
-	 * 如果不足，淘汰最久未使用的文件
-	 */
-	if (cache_size + size > MAX_CACHE_SIZE)
-		evict_cache(cache_size + size - MAX_CACHE_SIZE);
-
-	/*
-	 * 创建新的缓存条目
-	 */
-	FileCacheEntry entry;
-	entry.content = content;
-	entry.timestamp = std::chrono::system_clock::now();
-	entry.size = size;
-
-	/*
-	 * 添加到哈希表
-	 */
-	file_cache[path] = std::move(entry);
-
-	/*
-	 * 添加到LRU链表头部
-	 */
-	file_cache_lru.push_front(path);
-
-	/*
-	 * 更新缓存大小
-	 */
-	cache_size += size;
-}
-
-/**
- * evict_cache - 淘汰缓存条目
+ * invalidate_path - 使路径及其下所有文件的缓存失效
  *
- * 按照LRU策略淘汰最久未使用的缓存条目，直到缓存大小低于限制。
- *
- * 优化要点:
- * - 从LRU链表尾部开始淘汰，保证淘汰最久未使用的条目
- * - 同时更新哈希表和LRU链表
- * - 循环淘汰直到满足大小要求
+ * 目录被删除或重命名时其下的文件也全部失效。
  *
- * @required_size: 需要释放的空间大小（字节）
- *
- * 注意: 该方法需要持有互斥锁才能调用。
- */
-void FileManager::evict_cache(size_t required_size)
-{
-	/*
-	 * 循环淘汰，直到释放足够的空间
-	 */
-	while (!file_cache_lru.empty() && required_size > 0) {
-		/*
-		 * 获取LRU链表尾部（最久未使用）的文件路径
-		 */
-		const std::string lru_path = file_cache_lru.back();
-
-		/*
-		 * 在哈希表中查找该文件
-		 */
-		const auto it = file_cache.find(lru_path);
-
-		/*
-		 * 如果找到，从缓存中移除
-		 */
-		if (it != file_cache.end()) {
-			/*
-			 * 减少缓存大小
-			 */
-			cache_size -= it->second.size;
-
-			/*
-			 * 减少需要释放的空间
-			 */
-			if (it->second.size <= required_size) {
-				required_size -= it->second.size;
-			} else {
-				required_size = 0;
-			}
-
-			/*
-			 * 从哈希表中移除
-			 */
-			file_cache.erase(it);
-		}
-
-		/*
-		 * 从LRU链表中移除
-		 */
-		file_cache_lru.pop_back();
-	}
-}
-
-/**
- * invalidate_cache - 使指定文件的缓存失效
- *
- * 使指定文件的缓存失效，下次读取时将重新从磁盘加载。
- * 在文件被修改后应调用此方法。
- *
- * @path: 文件路径
- *
- * 注意: 该方法需要持有互斥锁才能调用。
- */
-void FileManager::invalidate_cache(const std::string &path)
-{
-	/*
-	 * 在哈希表中查找缓存条目
-	 */
-	const auto it = file_cache.find(path);
-
-	/*
-	 * 如果找到，从缓存中移除
-	 */
-	if (it != file_cache.end()) {
-		/*
-		 * 减少缓存大小
-		 */
-		cache_size -= it->second.size;
-
-		/*
-		 * 从哈希表中移除
-		 */
-		file_cache.erase(it);
-
-		/*
-		 * 从LRU链表中移除
-		 */
-		file_cache_lru.remove(path);
-	}
-}
-
-/**
- * clear_cache - 清空所有缓存
- *
- * 清空所有文件缓存，释放内存。
- *
- * 注意: 该方法需要持有互斥锁才能调用。
+ * @path: 文件或目录路径
  */
-void FileManager::clear_cache(void)
+void FileManager::invalidate_path(const std::string &path)
 {
-	/*
-	 * 清空哈希表
-	 */
-	file_cache.clear();
+	file_cache.invalidate(path);
 
-	/*
-	 * 清空LRU链表
-	 */
-	file_cache_lru.clear();
+	std::string prefix = path;
+	if (prefix.empty() || prefix.back() != '/')
+		prefix += '/';
 
-	/*
-	 * 重置缓存大小
-	 */
-	cache_size = 0;
+	file_cache.invalidate_prefix(prefix);
 }
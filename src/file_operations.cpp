@@ -0,0 +1,666 @@
+/*
+ * Mikufy v2.11-nova - 批量文件操作实现
+ *
+ * 本文件实现了FileOperationJob类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/file_operations.h"
+#include "../headers/main.h"		/* DIR_READ_BUFFER_SIZE */
+#include "../headers/logger.h"
+#include <algorithm>		/* std::min */
+#include <cerrno>		/* errno */
+#include <climits>		/* PATH_MAX */
+#include <cstdio>		/* renameat2(), RENAME_NOREPLACE */
+#include <cstring>		/* strcmp(), strerror() */
+#include <dirent.h>		/* getdents64(), IFTODT() */
+#include <fcntl.h>		/* openat(), AT_REMOVEDIR */
+#include <sys/sendfile.h>	/* sendfile() */
+#include <sys/stat.h>		/* fstatat(), mkdirat(), fchmod() */
+#include <unistd.h>		/* unlinkat(), copy_file_range(), close() */
+
+/**
+ * FileOperationJob::DirNode - 一个正在处理的目录
+ *
+ * 子项持有父目录的引用，父目录的fd在所有子项完成前保持打开。
+ * 锚点是每个源所在的目录，只提供fd，本身不会被处理。
+ */
+struct FileOperationJob::DirNode {
+	std::shared_ptr<DirNode> parent;
+	std::string name;		/* 在父目录中的名称；锚点为完整路径 */
+	int fd;				/* 源目录 */
+	int dest_fd;			/* 复制的目标目录 */
+	mode_t mode;			/* 源目录的权限（复制完成后设置） */
+	bool anchor;
+	std::atomic<size_t> pending;	/* 未完成的子项数，加上读取目录本身 */
+
+	DirNode(void)
+		: fd(-1), dest_fd(-1), mode(0), anchor(false), pending(1) {}
+
+	~DirNode(void) { close_fds(); }
+
+	void close_fds(void)
+	{
+		if (fd >= 0) {
+			close(fd);
+			fd = -1;
+		}
+		if (dest_fd >= 0) {
+			close(dest_fd);
+			dest_fd = -1;
+		}
+	}
+};
+
+/**
+ * FileOperationJob::FileOperationJob - 构造函数
+ */
+FileOperationJob::FileOperationJob(uint64_t id, FileOperationKind kind,
+				   std::vector<std::string> sources,
+				   std::string destination)
+	: job_id(id), kind(kind), sources(std::move(sources)),
+	  destination(std::move(destination)),
+	  started(std::chrono::steady_clock::now()), active(0), workers(0),
+	  phase_index(0), phase_kind(FileOperationKind::DELETE),
+	  cancelled(false), done_flag(false), state(FileOperationState::RUNNING),
+	  found(0), done(0), bytes(0), errors(0), last_report_ms(0),
+	  finished_ms(0)
+{
+}
+
+/**
+ * FileOperationJob::start - 检查参数并开始执行
+ * @pool: 执行操作的线程池
+ * @progress_callback: 进度回调
+ *
+ * 移动的重命名在这里直接完成（每个源一次系统调用），需要复制的
+ * 源交给工作任务。
+ */
+std::expected<void, std::string>
+FileOperationJob::start(ThreadPool &pool, ProgressCallback progress_callback)
+{
+	if (sources.empty())
+		return std::unexpected(std::string("没有要处理的文件"));
+	if (pool.size() == 0)
+		return std::unexpected(std::string("线程池未运行"));
+
+	/* 去掉末尾的斜杠，只接受根目录以外的绝对路径 */
+	std::vector<std::string> paths;
+	for (std::string source : sources) {
+		while (source.size() > 1 && source.back() == '/')
+			source.pop_back();
+		if (source.empty() || source[0] != '/')
+			return std::unexpected(std::format("不是绝对路径: {}",
+							   source));
+		if (source == "/")
+			return std::unexpected(std::string("不能处理根目录"));
+		paths.push_back(std::move(source));
+	}
+
+	std::string target_dir = destination;
+	if (kind != FileOperationKind::DELETE) {
+		while (target_dir.size() > 1 && target_dir.back() == '/')
+			target_dir.pop_back();
+
+		struct stat st;
+		if (stat(target_dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+			return std::unexpected(std::format("目标不是目录: {}",
+							   target_dir));
+
+		for (const std::string &path : paths) {
+			if (target_dir == path || target_dir.starts_with(path + "/"))
+				return std::unexpected(std::format(
+					"不能放到自身或其子目录中: {}", path));
+		}
+	}
+
+	callback = std::move(progress_callback);
+
+	if (kind == FileOperationKind::MOVE) {
+		/* 同一文件系统内直接重命名，跨文件系统的先复制再删除 */
+		std::vector<std::string> cross_device;
+		const std::string prefix = (target_dir == "/") ? "" : target_dir;
+
+		for (const std::string &path : paths) {
+			const std::string target = prefix +
+						   path.substr(path.find_last_of('/'));
+			found++;
+
+			int ret = renameat2(AT_FDCWD, path.c_str(), AT_FDCWD,
+					    target.c_str(), RENAME_NOREPLACE);
+			if (ret != 0 && errno == EINVAL) {
+				/* 文件系统不支持RENAME_NOREPLACE */
+				struct stat st;
+				if (lstat(target.c_str(), &st) == 0)
+					errno = EEXIST;
+				else
+					ret = rename(path.c_str(), target.c_str());
+			}
+
+			if (ret == 0) {
+				done++;
+			} else if (errno == EXDEV) {
+				found--;
+				cross_device.push_back(path);
+			} else {
+				record_error(nullptr, path.c_str(), errno);
+			}
+		}
+
+		if (!cross_device.empty()) {
+			phases.push_back({ FileOperationKind::COPY, cross_device });
+			phases.push_back({ FileOperationKind::DELETE,
+					   std::move(cross_device) });
+		}
+	} else {
+		phases.push_back({ kind, std::move(paths) });
+	}
+
+	size_t count = std::min<size_t>(pool.size(), FILE_OPERATION_MAX_THREADS);
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		workers = count;
+		begin_phase_locked();
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		auto self = shared_from_this();
+		if (!pool.submit([self]() { self->worker(); }))
+			finish_worker(); /* 没有提交成功的任务由这里替它退出 */
+	}
+
+	return {};
+}
+
+/**
+ * FileOperationJob::cancel - 取消操作
+ */
+void FileOperationJob::cancel(void)
+{
+	cancelled = true;
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		queue.clear();
+	}
+	queue_cond.notify_all();
+}
+
+/**
+ * FileOperationJob::progress - 获取当前进度
+ */
+FileOperationProgress FileOperationJob::progress(void) const
+{
+	FileOperationProgress result;
+
+	result.id = job_id;
+	result.kind = kind;
+	result.state = state;
+	result.found = found;
+	result.done = done;
+	result.bytes = bytes;
+	result.errors = errors;
+	result.elapsed_ms = done_flag ? finished_ms.load() : elapsed_ms();
+
+	std::lock_guard<std::mutex> lock(error_mutex);
+	result.first_error = first_error;
+	return result;
+}
+
+/**
+ * FileOperationJob::elapsed_ms - 开始以来的毫秒数
+ */
+int64_t FileOperationJob::elapsed_ms(void) const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - started).count();
+}
+
+/**
+ * FileOperationJob::worker - 工作任务主循环
+ *
+ * 队列为空且没有任务在处理条目时当前阶段完成，由先发现的任务开始
+ * 下一个阶段。
+ */
+void FileOperationJob::worker(void)
+{
+	std::vector<char> dents(DIR_READ_BUFFER_SIZE);
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	while (true) {
+		queue_cond.wait(lock, [this]() {
+			return cancelled || !queue.empty() || active == 0;
+		});
+		if (cancelled)
+			break;
+
+		if (queue.empty()) {
+			if (!begin_phase_locked())
+				break;
+			queue_cond.notify_all();
+			continue;
+		}
+
+		/* 后进先出：深度优先，同时打开的目录数与深度成正比 */
+		WorkItem item = std::move(queue.back());
+		queue.pop_back();
+		active++;
+		lock.unlock();
+
+		if (item.type == DT_DIR) {
+			process_directory(item, dents);
+		} else {
+			process_entry(*item.parent, item.name.c_str(), item.type);
+			item_done();
+			finish_child(std::move(item.parent));
+		}
+		item = WorkItem();	/* 在锁外释放目录 */
+
+		lock.lock();
+		active--;
+		if (active == 0 && queue.empty())
+			queue_cond.notify_all();
+	}
+
+	/* 其他任务可能还在等待条目 */
+	queue_cond.notify_all();
+	lock.unlock();
+
+	finish_worker();
+}
+
+/**
+ * FileOperationJob::finish_worker - 一个工作任务退出，最后一个报告结束
+ */
+void FileOperationJob::finish_worker(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		if (--workers > 0)
+			return;
+		queue.clear();
+	}
+
+	if (cancelled)
+		state = FileOperationState::CANCELLED;
+	else if (errors > 0)
+		state = FileOperationState::FAILED;
+	else
+		state = FileOperationState::DONE;
+	finished_ms = elapsed_ms();
+	done_flag = true;
+
+	FileOperationProgress result = progress();
+	log_debug("文件操作 {} 结束: {} 项，{} 个错误，{} ms", job_id,
+		  result.done, result.errors, result.elapsed_ms);
+
+	if (callback)
+		callback(result);
+}
+
+/**
+ * FileOperationJob::begin_phase_locked - 开始下一个阶段
+ *
+ * 每个源打开它所在的目录作为锚点。移动时如果复制阶段有失败，
+ * 跳过删除阶段，源保持不变。
+ */
+bool FileOperationJob::begin_phase_locked(void)
+{
+	while (queue.empty() && phase_index < phases.size()) {
+		const Phase &phase = phases[phase_index++];
+
+		if (kind == FileOperationKind::MOVE &&
+		    phase.kind == FileOperationKind::DELETE && errors > 0)
+			continue;
+		phase_kind = phase.kind;
+
+		for (const std::string &source : phase.sources) {
+			const size_t slash = source.find_last_of('/');
+			const std::string name = source.substr(slash + 1);
+
+			auto anchor = std::make_shared<DirNode>();
+			anchor->anchor = true;
+			anchor->name = (slash == 0) ? "/" : source.substr(0, slash);
+			anchor->fd = open(anchor->name.c_str(),
+					  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (anchor->fd < 0) {
+				record_error(nullptr, source.c_str(), errno);
+				continue;
+			}
+
+			if (phase_kind == FileOperationKind::COPY) {
+				anchor->dest_fd = open(destination.c_str(),
+						       O_RDONLY | O_DIRECTORY |
+						       O_CLOEXEC);
+				if (anchor->dest_fd < 0) {
+					record_error(nullptr, destination.c_str(),
+						     errno);
+					continue;
+				}
+			}
+
+			struct stat st;
+			if (fstatat(anchor->fd, name.c_str(), &st,
+				    AT_SYMLINK_NOFOLLOW) != 0) {
+				record_error(anchor.get(), name.c_str(), errno);
+				continue;
+			}
+
+			found++;
+			anchor->pending++;
+			queue.push_back(WorkItem{ anchor, name,
+						  static_cast<unsigned char>(
+							  IFTODT(st.st_mode)) });
+		}
+	}
+
+	return !queue.empty();
+}
+
+/**
+ * FileOperationJob::process_directory - 处理一个目录
+ * @item: 目录条目
+ * @dents: getdents64()缓冲区
+ *
+ * 删除时非目录的子项直接在这里unlinkat()；复制时常规文件放回队列
+ * 由其他任务并行复制，符号链接直接复制。每读取一批目录项放入队列
+ * 一次。
+ */
+void FileOperationJob::process_directory(WorkItem &item,
+					 std::vector<char> &dents)
+{
+	const DirNode &parent = *item.parent;
+	const char *name = item.name.c_str();
+
+	auto node = std::make_shared<DirNode>();
+	node->parent = item.parent;
+	node->name = item.name;
+	node->fd = openat(parent.fd, name,
+			  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (node->fd < 0) {
+		record_error(&parent, name, errno);
+		item_done();
+		finish_child(std::move(item.parent));
+		return;
+	}
+
+	if (phase_kind == FileOperationKind::COPY) {
+		struct stat st;
+		node->mode = (fstat(node->fd, &st) == 0) ? (st.st_mode & 07777) :
+							   0755;
+
+		/* 先以可写的权限创建，所有子项复制完成后再设置原来的权限 */
+		if (mkdirat(parent.dest_fd, name, 0700) != 0 ||
+		    (node->dest_fd = openat(parent.dest_fd, name,
+					    O_RDONLY | O_DIRECTORY | O_NOFOLLOW |
+					    O_CLOEXEC)) < 0) {
+			record_error(&parent, name, errno);
+			item_done();
+			finish_child(std::move(item.parent));
+			return;
+		}
+	}
+
+	std::vector<WorkItem> children;
+
+	while (!cancelled) {
+		ssize_t n = getdents64(node->fd, dents.data(), dents.size());
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			record_error(&parent, name, errno);
+			break;
+		}
+		if (n == 0)
+			break;
+
+		for (ssize_t pos = 0; pos < n;) {
+			const struct dirent64 *entry =
+				reinterpret_cast<const struct dirent64 *>(
+					dents.data() + pos);
+			pos += entry->d_reclen;
+
+			if (strcmp(entry->d_name, ".") == 0 ||
+			    strcmp(entry->d_name, "..") == 0)
+				continue;
+
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN) {
+				struct stat st;
+				if (fstatat(node->fd, entry->d_name, &st,
+					    AT_SYMLINK_NOFOLLOW) != 0) {
+					record_error(node.get(), entry->d_name,
+						     errno);
+					continue;
+				}
+				type = IFTODT(st.st_mode);
+			}
+
+			found++;
+			if (type == DT_DIR ||
+			    (phase_kind == FileOperationKind::COPY &&
+			     type == DT_REG)) {
+				node->pending++;
+				children.push_back({ node, entry->d_name, type });
+			} else {
+				process_entry(*node, entry->d_name, type);
+				item_done();
+			}
+		}
+
+		push_items(children);
+	}
+
+	/* 读取目录本身完成 */
+	finish_child(std::move(node));
+}
+
+/**
+ * FileOperationJob::process_entry - 删除或复制一个非目录条目
+ *
+ * 复制时设备文件、FIFO和socket报告为不支持。
+ */
+void FileOperationJob::process_entry(const DirNode &parent, const char *name,
+				     unsigned char type)
+{
+	if (phase_kind == FileOperationKind::DELETE) {
+		if (unlinkat(parent.fd, name, 0) != 0)
+			record_error(&parent, name, errno);
+		return;
+	}
+
+	switch (type) {
+	case DT_REG:
+		copy_file(parent, name);
+		break;
+	case DT_LNK: {
+		char target[PATH_MAX];
+		ssize_t length = readlinkat(parent.fd, name, target,
+					    sizeof(target) - 1);
+		if (length < 0) {
+			record_error(&parent, name, errno);
+			break;
+		}
+		target[length] = '\0';
+		if (symlinkat(target, parent.dest_fd, name) != 0)
+			record_error(&parent, name, errno);
+		break;
+	}
+	default:
+		record_error(&parent, name, EOPNOTSUPP);
+		break;
+	}
+}
+
+/**
+ * FileOperationJob::copy_file - 复制一个常规文件
+ *
+ * 优先用copy_file_range()（同一文件系统上可能直接共享数据块），
+ * 不支持时退回到sendfile()，都不经过用户态缓冲区。失败或取消时
+ * 删除复制了一半的目标文件。
+ */
+void FileOperationJob::copy_file(const DirNode &parent, const char *name)
+{
+	int in_fd = openat(parent.fd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (in_fd < 0) {
+		record_error(&parent, name, errno);
+		return;
+	}
+
+	struct stat st;
+	if (fstat(in_fd, &st) != 0) {
+		record_error(&parent, name, errno);
+		close(in_fd);
+		return;
+	}
+
+	int out_fd = openat(parent.dest_fd, name,
+			    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+			    st.st_mode & 07777);
+	if (out_fd < 0) {
+		record_error(&parent, name, errno);
+		close(in_fd);
+		return;
+	}
+
+	bool use_copy_range = true;
+	int err = 0;
+
+	while (!cancelled) {
+		ssize_t n;
+		if (use_copy_range) {
+			n = copy_file_range(in_fd, nullptr, out_fd, nullptr,
+					    FILE_OPERATION_COPY_CHUNK, 0);
+			if (n < 0 && (errno == EXDEV || errno == ENOSYS ||
+				      errno == EINVAL || errno == EOPNOTSUPP)) {
+				use_copy_range = false;
+				continue;
+			}
+		} else {
+			n = sendfile(out_fd, in_fd, nullptr,
+				     FILE_OPERATION_COPY_CHUNK);
+		}
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = errno;
+			break;
+		}
+		if (n == 0)
+			break;
+		bytes += n;
+	}
+
+	close(in_fd);
+	if (close(out_fd) != 0 && err == 0)
+		err = errno;
+
+	if (err != 0 || cancelled) {
+		unlinkat(parent.dest_fd, name, 0);
+		if (err != 0)
+			record_error(&parent, name, err);
+	}
+}
+
+/**
+ * FileOperationJob::finish_child - 一个子项完成
+ * @node: 子项所在的目录
+ *
+ * 最后一个子项完成时结束该目录（删除时rmdir，复制时设置权限），
+ * 并继续向上通知父目录。取消后不再处理目录。
+ */
+void FileOperationJob::finish_child(std::shared_ptr<DirNode> node)
+{
+	while (node && !node->anchor && !cancelled) {
+		if (node->pending.fetch_sub(1) != 1)
+			return;
+
+		if (phase_kind == FileOperationKind::DELETE) {
+			node->close_fds();
+			if (unlinkat(node->parent->fd, node->name.c_str(),
+				     AT_REMOVEDIR) != 0)
+				record_error(node->parent.get(), node->name.c_str(),
+					     errno);
+		} else {
+			if (fchmod(node->dest_fd, node->mode) != 0)
+				record_error(node->parent.get(), node->name.c_str(),
+					     errno);
+			node->close_fds();
+		}
+		item_done();
+
+		node = node->parent;
+	}
+}
+
+/**
+ * FileOperationJob::push_items - 把一批条目放入队列
+ */
+void FileOperationJob::push_items(std::vector<WorkItem> &items)
+{
+	if (items.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		if (!cancelled) {
+			for (WorkItem &item : items)
+				queue.push_back(std::move(item));
+		}
+	}
+	items.clear();
+	queue_cond.notify_all();
+}
+
+/**
+ * FileOperationJob::record_error - 记录一个条目失败
+ * @parent: 条目所在的目录，为nullptr时name是完整路径
+ * @name: 条目名称
+ * @err: 错误码
+ *
+ * 只在出错时沿父目录拼出完整路径，只保留第一个错误。
+ */
+void FileOperationJob::record_error(const DirNode *parent, const char *name,
+				    int err)
+{
+	errors++;
+
+	std::lock_guard<std::mutex> lock(error_mutex);
+	if (!first_error.empty())
+		return;
+
+	std::string path = name;
+	for (const DirNode *node = parent; node; node = node->parent.get()) {
+		if (node->name.ends_with('/'))
+			path = node->name + path;
+		else
+			path = node->name + "/" + path;
+	}
+	first_error = std::format("{}: {}", path, strerror(err));
+}
+
+/**
+ * FileOperationJob::item_done - 一个条目处理完成
+ *
+ * 每个间隔只有一个任务（比较交换成功的）调用进度回调。
+ */
+void FileOperationJob::item_done(void)
+{
+	done++;
+
+	if (!callback)
+		return;
+
+	const int64_t now = elapsed_ms();
+	int64_t last = last_report_ms.load(std::memory_order_relaxed);
+	if (now - last < FILE_OPERATION_REPORT_INTERVAL)
+		return;
+	if (!last_report_ms.compare_exchange_strong(last, now))
+		return;
+
+	callback(progress());
+}
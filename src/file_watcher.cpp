@@ -0,0 +1,477 @@
+/*
+ * Mikufy v2.11-nova - 文件系统监视器实现
+ *
+ * 本文件实现了FileWatcher类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/file_watcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <unordered_set>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * FileWatcher::FileWatcher - 构造函数
+ * @file_manager: 收到变化时使其缓存失效的文件管理器
+ */
+FileWatcher::FileWatcher(FileManager *file_manager)
+	: file_manager(file_manager), inotify_fd(-1), wake_fd(-1),
+	  overflowed(false)
+{
+}
+
+/**
+ * FileWatcher::~FileWatcher - 析构函数
+ */
+FileWatcher::~FileWatcher(void)
+{
+	stop();
+}
+
+/**
+ * FileWatcher::start - 创建inotify实例并启动监视线程
+ * @callback: 增量回调
+ *
+ * 返回: 成功返回true，inotify不可用或已在运行返回false
+ */
+bool FileWatcher::start(DeltaCallback callback)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (inotify_fd >= 0)
+		return false;
+
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+		return false;
+
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wake_fd < 0) {
+		close(inotify_fd);
+		inotify_fd = -1;
+		return false;
+	}
+
+	this->callback = std::move(callback);
+	thread = std::jthread([this](std::stop_token token) {
+		thread_func(token);
+	});
+
+	return true;
+}
+
+/**
+ * FileWatcher::stop - 停止监视线程，移除所有监视
+ *
+ * 关闭inotify实例会一并移除其上的所有监视。
+ */
+void FileWatcher::stop(void)
+{
+	if (thread.joinable()) {
+		thread.request_stop();
+
+		uint64_t one = 1;
+		ssize_t ret = write(wake_fd, &one, sizeof(one));
+		(void)ret;
+
+		thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	wd_paths.clear();
+	path_wds.clear();
+
+	if (inotify_fd >= 0) {
+		close(inotify_fd);
+		inotify_fd = -1;
+	}
+
+	if (wake_fd >= 0) {
+		close(wake_fd);
+		wake_fd = -1;
+	}
+}
+
+/**
+ * FileWatcher::is_running - 检查监视线程是否在运行
+ */
+bool FileWatcher::is_running(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return inotify_fd >= 0;
+}
+
+/**
+ * FileWatcher::watch_directories - 设置要监视的目录
+ * @directories: 目录路径列表
+ *
+ * 路径末尾的/被去掉，保证与事件中拼出的路径一致。
+ *
+ * 返回: 实际在监视的目录
+ */
+std::vector<std::string> FileWatcher::watch_directories(
+	const std::vector<std::string> &directories)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::string> watched;
+
+	if (inotify_fd < 0)
+		return watched;
+
+	std::unordered_set<std::string> wanted;
+	for (const auto &directory : directories) {
+		if (wanted.size() >= FILE_WATCH_MAX_DIRS)
+			break;
+
+		std::string normalized = directory;
+		while (normalized.size() > 1 && normalized.back() == '/')
+			normalized.pop_back();
+		if (!normalized.empty())
+			wanted.insert(std::move(normalized));
+	}
+
+	std::vector<std::string> stale;
+	for (const auto &pair : path_wds) {
+		if (!wanted.contains(pair.first))
+			stale.push_back(pair.first);
+	}
+	for (const auto &directory : stale)
+		remove_watch_locked(directory);
+
+	for (const auto &directory : wanted) {
+		if (path_wds.contains(directory)) {
+			watched.push_back(directory);
+			continue;
+		}
+
+		int wd = inotify_add_watch(inotify_fd, directory.c_str(),
+					   FILE_WATCH_EVENTS);
+		if (wd < 0)
+			continue;
+
+		/* 同一目录经不同路径（符号链接）添加时内核返回同一个wd */
+		auto existing = wd_paths.find(wd);
+		if (existing != wd_paths.end())
+			path_wds.erase(existing->second);
+
+		wd_paths[wd] = directory;
+		path_wds[directory] = wd;
+		watched.push_back(directory);
+	}
+
+	return watched;
+}
+
+/**
+ * FileWatcher::remove_watch_locked - 移除一个目录的监视（调用者持有锁）
+ * @directory: 目录路径
+ *
+ * 对应关系立即删除，之后内核发来的IN_IGNORED找不到目录而被忽略。
+ */
+void FileWatcher::remove_watch_locked(const std::string &directory)
+{
+	auto it = path_wds.find(directory);
+	if (it == path_wds.end())
+		return;
+
+	inotify_rm_watch(inotify_fd, it->second);
+	wd_paths.erase(it->second);
+	path_wds.erase(it);
+}
+
+/**
+ * FileWatcher::thread_func - 监视线程主循环
+ * @token: 停止令牌
+ *
+ * 没有待发送的变化时无限等待；批次中第一个事件到达后最多等待
+ * FILE_WATCH_COALESCE_MS，持续不断的变化也会按这个间隔分批发送。
+ */
+void FileWatcher::thread_func(std::stop_token token)
+{
+	struct pollfd fds[2];
+	fds[0].fd = inotify_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = wake_fd;
+	fds[1].events = POLLIN;
+
+	while (!token.stop_requested()) {
+		int timeout = -1;
+		bool batching = !pending.empty() || overflowed;
+
+		if (batching) {
+			auto remaining = std::chrono::duration_cast<
+				std::chrono::milliseconds>(
+				batch_deadline - std::chrono::steady_clock::now());
+			timeout = std::max<int>(0, static_cast<int>(remaining.count()));
+		}
+
+		int ret = poll(fds, 2, timeout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+			continue; /* 停止通知，由循环条件退出 */
+
+		if (fds[0].revents & POLLIN) {
+			read_events();
+			if (!batching && (!pending.empty() || overflowed))
+				batch_deadline = std::chrono::steady_clock::now() +
+					std::chrono::milliseconds(FILE_WATCH_COALESCE_MS);
+		}
+
+		if ((!pending.empty() || overflowed) &&
+		    std::chrono::steady_clock::now() >= batch_deadline)
+			flush_pending();
+	}
+}
+
+/**
+ * FileWatcher::read_events - 读取并解析inotify中所有可读的事件
+ */
+void FileWatcher::read_events(void)
+{
+	alignas(struct inotify_event) char buffer[16384];
+
+	while (true) {
+		ssize_t len = read(inotify_fd, buffer, sizeof(buffer));
+
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			return; /* EAGAIN：已读完 */
+
+		for (char *ptr = buffer; ptr < buffer + len;) {
+			const struct inotify_event *event =
+				reinterpret_cast<const struct inotify_event *>(ptr);
+			ptr += sizeof(struct inotify_event) + event->len;
+			handle_event(*event);
+		}
+	}
+}
+
+/**
+ * FileWatcher::handle_event - 把一个inotify事件转换为增量
+ * @event: inotify事件
+ *
+ * IN_MOVED_FROM先记为删除；同一批内出现相同cookie的IN_MOVED_TO时
+ * 改为一次重命名，没有出现说明移到了未监视的地方，保留为删除。
+ */
+void FileWatcher::handle_event(const struct inotify_event &event)
+{
+	if (event.mask & IN_Q_OVERFLOW) {
+		overflowed = true;
+		return;
+	}
+
+	std::string directory;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = wd_paths.find(event.wd);
+		if (it == wd_paths.end())
+			return;
+		directory = it->second;
+
+		if (event.mask & IN_IGNORED) {
+			path_wds.erase(directory);
+			wd_paths.erase(it);
+			return;
+		}
+
+		/* 监视的目录本身被删除或移走 */
+		if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+			remove_watch_locked(directory);
+	}
+
+	FileDelta delta;
+	delta.is_directory = (event.mask & IN_ISDIR) != 0;
+
+	if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+		size_t slash = directory.find_last_of('/');
+		delta.kind = FileDelta::Kind::REMOVE;
+		delta.directory = (slash == 0 || slash == std::string::npos) ?
+				  "/" : directory.substr(0, slash);
+		delta.path = directory;
+		delta.is_directory = true;
+		delta.is_hidden = slash != std::string::npos &&
+				  directory[slash + 1] == '.';
+		add_delta(std::move(delta));
+		return;
+	}
+
+	if (event.len == 0)
+		return;
+
+	const std::string name(event.name);
+	delta.directory = directory;
+	delta.path = (directory == "/") ? "/" + name : directory + "/" + name;
+	delta.is_hidden = name[0] == '.';
+
+	if (event.mask & IN_MOVED_TO) {
+		auto move = moves.find(event.cookie);
+		if (move != moves.end()) {
+			FileDelta &from = pending[move->second];
+			from.kind = FileDelta::Kind::RENAME;
+			from.old_directory = std::move(from.directory);
+			from.old_path = std::move(from.path);
+			from.directory = std::move(delta.directory);
+			from.path = std::move(delta.path);
+			from.is_hidden = delta.is_hidden;
+			moves.erase(move);
+			return;
+		}
+		delta.kind = FileDelta::Kind::ADD;
+	} else if (event.mask & IN_MOVED_FROM) {
+		delta.kind = FileDelta::Kind::REMOVE;
+		moves[event.cookie] = pending.size();
+		pending.push_back(std::move(delta));
+		return;
+	} else if (event.mask & IN_CREATE) {
+		delta.kind = FileDelta::Kind::ADD;
+	} else if (event.mask & IN_DELETE) {
+		delta.kind = FileDelta::Kind::REMOVE;
+	} else if (event.mask & (IN_CLOSE_WRITE | IN_ATTRIB)) {
+		delta.kind = FileDelta::Kind::MODIFY;
+	} else {
+		return;
+	}
+
+	add_delta(std::move(delta));
+}
+
+/**
+ * FileWatcher::add_delta - 把一项变化加入当前批次
+ * @delta: 变化
+ *
+ * 新建或修改之后紧跟的修改（一次保存会产生多个事件）不重复记录；
+ * 删除一个同时被监视的子目录时，父目录的IN_DELETE和子目录自身的
+ * IN_DELETE_SELF只记录一次。
+ */
+void FileWatcher::add_delta(FileDelta delta)
+{
+	if (!pending.empty()) {
+		const FileDelta &last = pending.back();
+		if (last.path == delta.path &&
+		    ((delta.kind == FileDelta::Kind::MODIFY &&
+		      (last.kind == FileDelta::Kind::ADD ||
+		       last.kind == FileDelta::Kind::MODIFY)) ||
+		     (delta.kind == FileDelta::Kind::REMOVE &&
+		      last.kind == FileDelta::Kind::REMOVE)))
+			return;
+	}
+
+	pending.push_back(std::move(delta));
+}
+
+/**
+ * FileWatcher::flush_pending - 使缓存失效并把当前批次交给回调
+ *
+ * 一批内变化超过FILE_WATCH_MAX_DELTAS的目录只发送一个RESCAN，
+ * 队列溢出时所有监视的目录都发送RESCAN。文件大小在这里才stat，
+ * 被合并掉的中间状态不需要查询。
+ */
+void FileWatcher::flush_pending(void)
+{
+	std::vector<FileDelta> batch;
+	std::vector<std::string> rescans;
+
+	if (overflowed) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto &pair : path_wds)
+			rescans.push_back(pair.first);
+	} else {
+		std::unordered_map<std::string, size_t> counts;
+		for (const auto &delta : pending) {
+			counts[delta.directory]++;
+			if (delta.kind == FileDelta::Kind::RENAME &&
+			    delta.old_directory != delta.directory)
+				counts[delta.old_directory]++;
+		}
+
+		/*
+		 * 变化过多的目录的增量全部丢弃，其中仍在监视的目录发送RESCAN；
+		 * 已经不再监视的目录（例如本批中被删除）不需要重新加载
+		 */
+		std::unordered_set<std::string> bursts;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const auto &pair : counts) {
+				if (pair.second <= FILE_WATCH_MAX_DELTAS)
+					continue;
+				bursts.insert(pair.first);
+				if (path_wds.contains(pair.first))
+					rescans.push_back(pair.first);
+			}
+		}
+
+		for (FileDelta delta : pending) {
+			if (delta.kind == FileDelta::Kind::RENAME) {
+				bool from_burst = bursts.contains(delta.old_directory);
+				bool to_burst = bursts.contains(delta.directory);
+
+				/* 只有一端需要重新加载时，另一端按移入/移出处理 */
+				if (from_burst && to_burst)
+					continue;
+				if (to_burst) {
+					delta.kind = FileDelta::Kind::REMOVE;
+					delta.directory = delta.old_directory;
+					delta.path = delta.old_path;
+				} else if (from_burst) {
+					delta.kind = FileDelta::Kind::ADD;
+				}
+				if (from_burst || to_burst) {
+					delta.old_directory.clear();
+					delta.old_path.clear();
+				}
+			} else if (bursts.contains(delta.directory)) {
+				continue;
+			}
+
+			if (delta.kind != FileDelta::Kind::REMOVE &&
+			    !delta.is_directory) {
+				struct stat st;
+				if (stat(delta.path.c_str(), &st) == 0)
+					delta.size = st.st_size;
+			}
+			batch.push_back(std::move(delta));
+		}
+	}
+
+	for (const auto &directory : rescans) {
+		FileDelta delta;
+		delta.kind = FileDelta::Kind::RESCAN;
+		delta.directory = directory;
+		delta.is_directory = true;
+		batch.push_back(std::move(delta));
+	}
+
+	if (file_manager) {
+		for (const auto &delta : pending) {
+			file_manager->invalidate_path(delta.path);
+			if (delta.kind == FileDelta::Kind::RENAME)
+				file_manager->invalidate_path(delta.old_path);
+		}
+		if (overflowed) {
+			for (const auto &directory : rescans)
+				file_manager->invalidate_path(directory);
+		}
+	}
+
+	pending.clear();
+	moves.clear();
+	overflowed = false;
+
+	if (!batch.empty() && callback)
+		callback(batch);
+}
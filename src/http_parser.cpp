@@ -0,0 +1,507 @@
+/*
+ * Mikufy v2.11-nova - HTTP请求解析器实现
+ *
+ * 本文件实现了HttpRequestParser类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/http_parser.h"
+#include <algorithm>		/* std::min, std::count */
+#include <charconv>		/* std::from_chars */
+#include <cstring>		/* memcpy() */
+#include <new>			/* placement new */
+#include <strings.h>		/* strncasecmp() */
+
+/* 分块大小行（含扩展）的最大长度 */
+#define HTTP_CHUNK_LINE_MAX	1024
+
+/**
+ * trim - 去除首尾的空格和制表符
+ */
+static std::string_view trim(std::string_view text)
+{
+	const size_t first = text.find_first_not_of(" \t");
+	if (first == std::string_view::npos)
+		return {};
+
+	const size_t last = text.find_last_not_of(" \t\r");
+	return text.substr(first, last - first + 1);
+}
+
+/**
+ * equals_nocase - 不区分大小写比较
+ */
+static bool equals_nocase(std::string_view a, std::string_view b)
+{
+	return a.size() == b.size() &&
+	       strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+/**
+ * contains_token - 逗号分隔的列表中是否包含指定值（不区分大小写）
+ */
+static bool contains_token(std::string_view list, std::string_view token)
+{
+	while (!list.empty()) {
+		const size_t comma = list.find(',');
+		if (equals_nocase(trim(list.substr(0, comma)), token))
+			return true;
+		if (comma == std::string_view::npos)
+			break;
+		list.remove_prefix(comma + 1);
+	}
+	return false;
+}
+
+/**
+ * hex_value - 十六进制数字的值，不是十六进制数字时返回-1
+ */
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/**
+ * url_decode - URL解码到out
+ *
+ * %XX解码为对应字节，+解码为空格；不完整的%XX原样保留。解码后
+ * 不会比原文长，out至少有text.size()字节。
+ *
+ * 返回值: 写入的字节数
+ */
+static size_t url_decode(std::string_view text, char *out)
+{
+	size_t length = 0;
+
+	for (size_t i = 0; i < text.size(); i++) {
+		int high, low;
+		if (text[i] == '%' && i + 2 < text.size() &&
+		    (high = hex_value(text[i + 1])) >= 0 &&
+		    (low = hex_value(text[i + 2])) >= 0) {
+			out[length++] = static_cast<char>(high << 4 | low);
+			i += 2;
+		} else if (text[i] == '+') {
+			out[length++] = ' ';
+		} else {
+			out[length++] = text[i];
+		}
+	}
+
+	return length;
+}
+
+/**
+ * HttpHeaders::find - 按名称（不区分大小写）查找请求头
+ */
+const std::string_view *HttpHeaders::find(std::string_view name) const
+{
+	for (auto it = fields.rbegin(); it != fields.rend(); ++it) {
+		if (equals_nocase(it->name, name))
+			return &it->value;
+	}
+	return nullptr;
+}
+
+/**
+ * HttpQuery::find - 查找查询参数
+ */
+const std::string_view *HttpQuery::find(std::string_view name) const
+{
+	for (auto it = fields.rbegin(); it != fields.rend(); ++it) {
+		if (it->name == name)
+			return &it->value;
+	}
+	return nullptr;
+}
+
+/**
+ * HttpRequestParser::HttpRequestParser - 构造函数
+ * @max_header_size: 请求头的最大长度
+ * @max_body_size: 缓存在内存中的请求体的最大长度
+ */
+HttpRequestParser::HttpRequestParser(size_t max_header_size,
+				     uint64_t max_body_size)
+	: max_header_size(max_header_size), max_body_size(max_body_size),
+	  state(State::HEADERS), scan_offset(0), remaining(0), received(0),
+	  error(0)
+{
+}
+
+/**
+ * HttpRequestParser::reset - 准备解析下一个请求
+ */
+void HttpRequestParser::reset(void)
+{
+	state = State::HEADERS;
+	scan_offset = 0;
+	remaining = 0;
+	received = 0;
+	error = 0;
+	current = HttpRequest();
+	sink = nullptr;
+}
+
+/**
+ * HttpRequestParser::set_body_sink - 把请求体交给回调
+ */
+void HttpRequestParser::set_body_sink(BodySink body_sink)
+{
+	sink = std::move(body_sink);
+}
+
+/**
+ * HttpRequestParser::fail - 进入错误状态
+ * @status: 应答的HTTP状态码
+ */
+HttpParseStatus HttpRequestParser::fail(int status)
+{
+	error = status;
+	return HttpParseStatus::ERROR;
+}
+
+/**
+ * HttpRequestParser::deliver - 交付一段请求体数据
+ *
+ * 没有回调时追加到current.body，超过max_body_size返回false。
+ */
+bool HttpRequestParser::deliver(const char *data, size_t length)
+{
+	received += length;
+
+	if (sink) {
+		sink(data, length);
+		return true;
+	}
+
+	if (received > max_body_size)
+		return false;
+
+	current.body.append(data, length);
+	return true;
+}
+
+/**
+ * HttpRequestParser::parse_head - 解析请求行和请求头
+ * @raw: 不含结束空行的请求头（在接收缓冲区中）
+ *
+ * 请求头原文复制到current.arena，字段数组和解码后的查询参数也放在
+ * 其中，各字段只保存指向arena的string_view。字段数先按行数和'&'数
+ * 取上限，整个请求只分配这一次。
+ *
+ * 同时确定请求体的分帧方式：Transfer-Encoding优先于Content-Length，
+ * 两者都没有时没有请求体。
+ */
+bool HttpRequestParser::parse_head(std::string_view raw)
+{
+	const size_t line_end = std::min(raw.find("\r\n"), raw.size());
+	const std::string_view request_line = raw.substr(0, line_end);
+
+	/* 请求行: METHOD SP TARGET SP VERSION */
+	const size_t sp1 = request_line.find(' ');
+	const size_t sp2 = (sp1 == std::string_view::npos) ?
+			   std::string_view::npos :
+			   request_line.find(' ', sp1 + 1);
+	if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+		error = 400;
+		return false;
+	}
+
+	if (!request_line.substr(sp2 + 1).starts_with("HTTP/1.")) {
+		error = 400;
+		return false;
+	}
+
+	const std::string_view raw_target = request_line.substr(sp1 + 1,
+								sp2 - sp1 - 1);
+	const size_t question = raw_target.find('?');
+	const std::string_view raw_query = (question == std::string_view::npos) ?
+					   std::string_view() :
+					   raw_target.substr(question + 1);
+
+	const size_t max_headers = std::count(raw.begin(), raw.end(), '\n');
+	const size_t max_params = raw_query.empty() ? 0 :
+				  std::count(raw_query.begin(), raw_query.end(),
+					     '&') + 1;
+	const size_t fields_size = (max_headers + max_params) *
+				   sizeof(HttpField);
+
+	current.arena = std::make_unique_for_overwrite<std::byte[]>(
+		fields_size + raw.size() + raw_query.size());
+	HttpField *fields = reinterpret_cast<HttpField *>(current.arena.get());
+	char *text = reinterpret_cast<char *>(current.arena.get() + fields_size);
+	memcpy(text, raw.data(), raw.size());
+
+	/* 以下只使用arena中的副本 */
+	const std::string_view head(text, raw.size());
+	const std::string_view version = head.substr(sp2 + 1, line_end - sp2 - 1);
+	const std::string_view target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+	current.method = head.substr(0, sp1);
+	current.path = target;
+
+	/* 请求头 */
+	std::string_view connection;
+	std::string_view transfer_encoding;
+	bool has_length = false;
+	size_t header_count = 0;
+	size_t pos = line_end + 2;
+
+	while (pos < head.size()) {
+		size_t end = head.find("\r\n", pos);
+		if (end == std::string_view::npos)
+			end = head.size();
+
+		const std::string_view line = head.substr(pos, end - pos);
+		pos = end + 2;
+
+		const size_t colon = line.find(':');
+		if (colon == std::string_view::npos || colon == 0)
+			continue;
+
+		const std::string_view name = trim(line.substr(0, colon));
+		const std::string_view value = trim(line.substr(colon + 1));
+
+		if (equals_nocase(name, "Content-Length")) {
+			uint64_t length = 0;
+			auto [ptr, ec] = std::from_chars(value.data(),
+							 value.data() + value.size(),
+							 length);
+			if (ec != std::errc() || ptr != value.data() + value.size() ||
+			    (has_length && length != current.content_length)) {
+				error = 400;
+				return false;
+			}
+			current.content_length = length;
+			has_length = true;
+		} else if (equals_nocase(name, "Transfer-Encoding")) {
+			transfer_encoding = value;
+		} else if (equals_nocase(name, "Connection")) {
+			connection = value;
+		} else if (equals_nocase(name, "Expect")) {
+			current.expect_continue = equals_nocase(value, "100-continue");
+		}
+
+		new (&fields[header_count++]) HttpField{ name, value };
+	}
+	current.headers = HttpHeaders(std::span<const HttpField>(fields,
+								 header_count));
+
+	/* 查询参数：没有'='的项忽略，名称和值都解码到请求头之后 */
+	HttpField *params = fields + header_count;
+	size_t param_count = 0;
+	char *decoded = text + head.size();
+	std::string_view query = (question == std::string_view::npos) ?
+				 std::string_view() :
+				 target.substr(question + 1);
+
+	while (!query.empty()) {
+		const size_t amp = query.find('&');
+		const std::string_view pair = query.substr(0, amp);
+		query = (amp == std::string_view::npos) ? std::string_view() :
+							 query.substr(amp + 1);
+
+		const size_t eq = pair.find('=');
+		if (eq == std::string_view::npos)
+			continue;
+
+		const size_t name_length = url_decode(pair.substr(0, eq), decoded);
+		const std::string_view name(decoded, name_length);
+		decoded += name_length;
+
+		const size_t value_length = url_decode(pair.substr(eq + 1), decoded);
+		const std::string_view value(decoded, value_length);
+		decoded += value_length;
+
+		new (&params[param_count++]) HttpField{ name, value };
+	}
+	current.query = HttpQuery(std::span<const HttpField>(params, param_count));
+
+	if (!transfer_encoding.empty()) {
+		/* 只支持chunked，且必须是最后一个编码 */
+		const size_t comma = transfer_encoding.rfind(',');
+		const std::string_view last = trim(comma == std::string_view::npos ?
+						   transfer_encoding :
+						   transfer_encoding.substr(comma + 1));
+		if (!equals_nocase(last, "chunked")) {
+			error = 400;
+			return false;
+		}
+		current.chunked = true;
+		current.content_length = 0;
+	}
+
+	if (version == "HTTP/1.1")
+		current.keep_alive = !contains_token(connection, "close");
+	else
+		current.keep_alive = contains_token(connection, "keep-alive");
+
+	return true;
+}
+
+/**
+ * HttpRequestParser::parse - 解析缓冲区中的数据
+ * @buffer: 接收缓冲区
+ *
+ * 已处理的数据在返回前一次性从缓冲区移除，分块很多时也不会
+ * 反复移动剩余数据。
+ *
+ * 按Content-Length接收且请求体缓存在内存中时，缓冲区预留到整个
+ * 请求体的大小，收齐后如果缓冲区中恰好只有请求体（没有流水线
+ * 请求），直接把缓冲区交换给current.body。
+ */
+HttpParseStatus HttpRequestParser::parse(std::string &buffer)
+{
+	size_t pos = 0;
+	auto finish = [&](HttpParseStatus status) {
+		buffer.erase(0, pos);
+		return status;
+	};
+
+	while (true) {
+		switch (state) {
+		case State::HEADERS: {
+			/* 标记可能跨越上次的末尾，回退3个字节 */
+			const size_t from = (scan_offset >= 3) ? scan_offset - 3 : 0;
+			const size_t end = buffer.find("\r\n\r\n", from);
+
+			if (end == std::string::npos) {
+				if (buffer.size() > max_header_size)
+					return fail(400);
+				scan_offset = buffer.size();
+				return HttpParseStatus::INCOMPLETE;
+			}
+
+			if (end > max_header_size)
+				return fail(400);
+			if (!parse_head(std::string_view(buffer).substr(0, end)))
+				return HttpParseStatus::ERROR;
+
+			pos = end + 4;
+			if (current.chunked)
+				state = State::CHUNK_SIZE;
+			else if (current.content_length > 0)
+				state = State::BODY;
+			else
+				state = State::DONE;
+			remaining = current.content_length;
+
+			return finish(HttpParseStatus::HEADERS_COMPLETE);
+		}
+
+		case State::BODY:
+			if (!sink) {
+				if (current.content_length > max_body_size)
+					return fail(413);
+
+				if (buffer.size() < remaining) {
+					if (buffer.capacity() < remaining)
+						buffer.reserve(remaining);
+					return HttpParseStatus::INCOMPLETE;
+				}
+
+				if (buffer.size() == remaining) {
+					current.body.swap(buffer);
+					buffer.clear();
+				} else {
+					current.body.assign(buffer, 0, remaining);
+					pos = remaining;
+				}
+				received = remaining;
+				remaining = 0;
+				state = State::DONE;
+				break;
+			}
+
+			{
+				const size_t take = std::min<uint64_t>(buffer.size(),
+								       remaining);
+				if (take > 0)
+					deliver(buffer.data(), take);
+				pos = take;
+				remaining -= take;
+			}
+
+			if (remaining > 0)
+				return finish(HttpParseStatus::INCOMPLETE);
+			state = State::DONE;
+			break;
+
+		case State::CHUNK_SIZE: {
+			const size_t eol = buffer.find("\r\n", pos);
+			if (eol == std::string::npos) {
+				if (buffer.size() - pos > HTTP_CHUNK_LINE_MAX)
+					return fail(400);
+				return finish(HttpParseStatus::INCOMPLETE);
+			}
+
+			/* 分块大小（十六进制），之后可以有";扩展" */
+			const char *first = buffer.data() + pos;
+			const char *last = buffer.data() + eol;
+			uint64_t size = 0;
+			auto [ptr, ec] = std::from_chars(first, last, size, 16);
+			if (ec != std::errc() || ptr == first)
+				return fail(400);
+			while (ptr < last && (*ptr == ' ' || *ptr == '\t'))
+				ptr++;
+			if (ptr < last && *ptr != ';')
+				return fail(400);
+
+			pos = eol + 2;
+			remaining = size;
+			state = (size == 0) ? State::TRAILERS : State::CHUNK_DATA;
+			break;
+		}
+
+		case State::CHUNK_DATA: {
+			const size_t take = std::min<uint64_t>(buffer.size() - pos,
+							       remaining);
+			if (take > 0 && !deliver(buffer.data() + pos, take))
+				return fail(413);
+			pos += take;
+			remaining -= take;
+
+			if (remaining > 0)
+				return finish(HttpParseStatus::INCOMPLETE);
+			state = State::CHUNK_END;
+			break;
+		}
+
+		case State::CHUNK_END:
+			if (buffer.size() - pos < 2)
+				return finish(HttpParseStatus::INCOMPLETE);
+			if (buffer.compare(pos, 2, "\r\n") != 0)
+				return fail(400);
+			pos += 2;
+			state = State::CHUNK_SIZE;
+			break;
+
+		case State::TRAILERS: {
+			/* 尾部字段没有用处，逐行跳过直到空行 */
+			const size_t eol = buffer.find("\r\n", pos);
+			if (eol == std::string::npos) {
+				if (buffer.size() - pos > max_header_size)
+					return fail(400);
+				return finish(HttpParseStatus::INCOMPLETE);
+			}
+
+			const bool empty_line = (eol == pos);
+			pos = eol + 2;
+			if (empty_line)
+				state = State::DONE;
+			break;
+		}
+
+		case State::DONE:
+			current.content_length = received;
+			return finish(HttpParseStatus::COMPLETE);
+		}
+	}
+}
@@ -0,0 +1,267 @@
+/*
+ * Mikufy v2.11-nova - JSON字段提取实现
+ *
+ * 本文件实现了JsonFields类的所有方法。解析使用nlohmann::json的
+ * SAX接口，JsonFieldsSax接收事件并写入绑定的变量。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/json_fields.h"
+#include "../headers/main.h"	/* json */
+#include <climits>		/* INT_MIN, INT_MAX */
+#include <cmath>		/* std::trunc */
+#include <format>		/* std::format */
+
+/**
+ * JsonFieldsSax - 把SAX事件写入JsonFields绑定的变量
+ *
+ * 只处理顶层对象的直接成员；depth为1时的值属于顶层字段。
+ */
+class JsonFieldsSax
+{
+public:
+	explicit JsonFieldsSax(JsonFields &fields)
+		: fields(fields), depth(0), current(nullptr) {}
+
+	/* 可选字段为null时按缺少处理，变量保持原值 */
+	bool null(void)
+	{
+		if (!scalar())
+			return true;
+		if (current->required)
+			return mismatch();
+		current = nullptr;
+		return true;
+	}
+
+	bool boolean(bool value)
+	{
+		if (!scalar())
+			return true;
+		if (current->kind != JsonFields::Kind::BOOL)
+			return mismatch();
+		*static_cast<bool *>(current->target) = value;
+		return store();
+	}
+
+	bool number_integer(json::number_integer_t value)
+	{
+		if (!scalar())
+			return true;
+		if (value >= 0)
+			return number_unsigned(static_cast<json::number_unsigned_t>(value));
+		if (current->kind != JsonFields::Kind::INT || value < INT_MIN)
+			return mismatch();
+		*static_cast<int *>(current->target) = static_cast<int>(value);
+		return store();
+	}
+
+	bool number_unsigned(json::number_unsigned_t value)
+	{
+		if (!scalar())
+			return true;
+
+		switch (current->kind) {
+		case JsonFields::Kind::SIZE:
+			*static_cast<size_t *>(current->target) = value;
+			return store();
+		case JsonFields::Kind::INT:
+			if (value > INT_MAX)
+				return mismatch();
+			*static_cast<int *>(current->target) = static_cast<int>(value);
+			return store();
+		default:
+			return mismatch();
+		}
+	}
+
+	bool number_float(json::number_float_t value, const json::string_t &text)
+	{
+		(void)text;
+
+		if (!scalar())
+			return true;
+
+		/* 只接受整数值，例如前端算出的 12.0 */
+		if (std::trunc(value) != value || value < INT_MIN || value > 9.0e15)
+			return mismatch();
+		if (value < 0)
+			return number_integer(static_cast<json::number_integer_t>(value));
+		return number_unsigned(static_cast<json::number_unsigned_t>(value));
+	}
+
+	bool string(json::string_t &value)
+	{
+		if (!scalar())
+			return true;
+		if (current->kind != JsonFields::Kind::STRING)
+			return mismatch();
+		*static_cast<std::string *>(current->target) = std::move(value);
+		return store();
+	}
+
+	bool binary(json::binary_t &value)
+	{
+		(void)value;
+		return scalar() ? mismatch() : true;
+	}
+
+	bool start_object(size_t elements)
+	{
+		(void)elements;
+		return start_container();
+	}
+
+	bool end_object(void)
+	{
+		depth--;
+		return true;
+	}
+
+	bool start_array(size_t elements)
+	{
+		(void)elements;
+		return start_container();
+	}
+
+	bool end_array(void)
+	{
+		depth--;
+		return true;
+	}
+
+	bool key(json::string_t &name)
+	{
+		if (depth != 1)
+			return true;
+
+		current = nullptr;
+		for (size_t i = 0; i < fields.count; i++) {
+			if (fields.fields[i].key == name) {
+				current = &fields.fields[i];
+				break;
+			}
+		}
+		return true;
+	}
+
+	bool parse_error(size_t position, const std::string &token,
+			 const nlohmann::detail::exception &e)
+	{
+		(void)position;
+		(void)token;
+		return fields.message.empty() ? fail(e.what()) : false;
+	}
+
+private:
+	JsonFields &fields;
+	int depth;			/* 当前所在的嵌套层数 */
+	JsonFields::Field *current;	/* 当前顶层成员对应的绑定 */
+
+	/*
+	 * scalar - 当前标量是否要写入绑定的变量
+	 *
+	 * 顶层必须是对象，所以depth为0时出现标量是错误，由parse()报告。
+	 */
+	bool scalar(void) const
+	{
+		return depth == 1 && current;
+	}
+
+	bool start_container(void)
+	{
+		if (scalar())
+			return mismatch();
+		depth++;
+		return true;
+	}
+
+	bool store(void)
+	{
+		current->seen = true;
+		current = nullptr;
+		return true;
+	}
+
+	bool mismatch(void)
+	{
+		return fail(std::format("Invalid field: {}", current->key));
+	}
+
+	bool fail(std::string reason)
+	{
+		fields.message = std::move(reason);
+		return false;
+	}
+};
+
+/**
+ * JsonFields::add - 追加一个绑定
+ *
+ * 超过JSON_FIELDS_MAX是调用者的错误，多出的绑定被忽略。
+ */
+void JsonFields::add(std::string_view key, Kind kind, void *target,
+		     bool required)
+{
+	if (count >= JSON_FIELDS_MAX)
+		return;
+	fields[count++] = { key, kind, target, required, false };
+}
+
+void JsonFields::bind(std::string_view key, std::string &target, bool required)
+{
+	add(key, Kind::STRING, &target, required);
+}
+
+void JsonFields::bind(std::string_view key, size_t &target, bool required)
+{
+	add(key, Kind::SIZE, &target, required);
+}
+
+void JsonFields::bind(std::string_view key, int &target, bool required)
+{
+	add(key, Kind::INT, &target, required);
+}
+
+void JsonFields::bind(std::string_view key, bool &target, bool required)
+{
+	add(key, Kind::BOOL, &target, required);
+}
+
+/**
+ * JsonFields::parse - 解析JSON文本并填充绑定的变量
+ *
+ * 顶层是标量时SAX只产生一个depth为0的值事件，不算错误，这里通过
+ * 第一个非空白字符检查。
+ */
+bool JsonFields::parse(std::string_view text)
+{
+	message.clear();
+	for (size_t i = 0; i < count; i++)
+		fields[i].seen = false;
+
+	const size_t first = text.find_first_not_of(" \t\r\n");
+	if (first == std::string_view::npos || text[first] != '{') {
+		message = "JSON body must be an object";
+		return false;
+	}
+
+	JsonFieldsSax sax(*this);
+	if (!json::sax_parse(text, &sax)) {
+		if (message.empty())
+			message = "Invalid JSON";
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (fields[i].required && !fields[i].seen) {
+			message = std::format("Missing field: {}", fields[i].key);
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,160 @@
+/*
+ * Mikufy v2.11-nova - 异步日志实现
+ *
+ * 本文件实现了Logger类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/logger.h"
+#include <cstdio>		/* fwrite(), fflush() */
+#include <cstdlib>		/* getenv(), atexit() */
+#include <strings.h>		/* strcasecmp() */
+
+/**
+ * level_from_env - 从 MIKUFY_LOG_LEVEL 读取日志级别
+ */
+static LogLevel level_from_env(void)
+{
+	const char *value = getenv("MIKUFY_LOG_LEVEL");
+	if (!value)
+		return LogLevel::INFO;
+
+	if (strcasecmp(value, "debug") == 0)
+		return LogLevel::DEBUG;
+	if (strcasecmp(value, "warn") == 0 || strcasecmp(value, "warning") == 0)
+		return LogLevel::WARN;
+	if (strcasecmp(value, "error") == 0)
+		return LogLevel::ERROR;
+	if (strcasecmp(value, "off") == 0 || strcasecmp(value, "none") == 0)
+		return LogLevel::OFF;
+	return LogLevel::INFO;
+}
+
+/**
+ * flush_at_exit - 进程退出时写完剩余日志
+ */
+static void flush_at_exit(void)
+{
+	Logger::instance().flush();
+}
+
+/**
+ * Logger::instance - 获取全局日志
+ *
+ * 日志对象不析构，写出线程随进程结束；退出前由atexit处理函数
+ * 等待缓冲区写完。
+ */
+Logger &Logger::instance(void)
+{
+	static Logger *logger = [] {
+		Logger *created = new Logger();
+		atexit(flush_at_exit);
+		return created;
+	}();
+	return *logger;
+}
+
+/**
+ * Logger::Logger - 构造函数
+ *
+ * 读取日志级别并启动写出线程。
+ */
+Logger::Logger(void)
+	: threshold(level_from_env()), dropped(0), appended(0), written(0)
+{
+	std::thread(&Logger::writer_loop, this).detach();
+}
+
+/**
+ * Logger::set_level - 设置输出的最低级别
+ */
+void Logger::set_level(LogLevel level)
+{
+	threshold.store(level, std::memory_order_relaxed);
+}
+
+/**
+ * Logger::write - 追加一条日志
+ * @level: 日志级别
+ * @message: 日志内容（不含换行）
+ */
+void Logger::write(LogLevel level, std::string_view message)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (out_pending.size() + err_pending.size() + message.size() >
+	    LOG_QUEUE_MAX_BYTES) {
+		dropped++;
+		return;
+	}
+
+	std::string &pending = (level >= LogLevel::WARN) ? err_pending :
+							   out_pending;
+	pending.append(message);
+	pending += '\n';
+
+	if (appended++ == written)
+		cond.notify_all();
+}
+
+/**
+ * Logger::flush - 等待已追加的日志全部写出
+ */
+void Logger::flush(void)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const uint64_t target = appended;
+	cond.wait(lock, [this, target] { return written >= target; });
+}
+
+/**
+ * Logger::writer_loop - 写出线程主循环
+ *
+ * 取走两个待写缓冲区后在锁外写出，写出期间新日志继续追加到空的
+ * 缓冲区中。
+ */
+void Logger::writer_loop(void)
+{
+	std::string out_batch;
+	std::string err_batch;
+
+	while (true) {
+		uint64_t batch_end;
+		uint64_t lost;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this] { return appended != written; });
+
+			out_batch.swap(out_pending);
+			err_batch.swap(err_pending);
+			batch_end = appended;
+			lost = dropped;
+			dropped = 0;
+		}
+
+		if (lost > 0)
+			err_batch += std::format("日志写出过慢，已丢弃 {} 条日志\n",
+						 lost);
+
+		if (!out_batch.empty()) {
+			fwrite(out_batch.data(), 1, out_batch.size(), stdout);
+			fflush(stdout);
+			out_batch.clear();
+		}
+
+		if (!err_batch.empty()) {
+			fwrite(err_batch.data(), 1, err_batch.size(), stderr);
+			fflush(stderr);
+			err_batch.clear();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			written = batch_end;
+		}
+		cond.notify_all();
+	}
+}
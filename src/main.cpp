@@ -24,6 +24,7 @@
 #include "../headers/file_manager.h"
 #include "../headers/web_server.h"
 #include "../headers/window_manager.h"
+#include "../headers/startup_trace.h"
 
 #include <iostream>		/* std::cout, std::cerr */
 #include <csignal>		/* signal(), SIGINT, SIGTERM */
@@ -33,6 +34,8 @@
 #include <dirent.h>		/* opendir(), closedir() */
 #include <cstring>		/* getcwd() */
 #include <format>		/* C++23 std::format */
+#include <functional>		/* std::ref */
+#include <thread>		/* std::thread 后端与窗口并行初始化 */
 
 /*
  * ============================================================================
@@ -172,6 +175,124 @@ static void print_version(void)
 	std::cout << "构建日期: " << __DATE__ << " " << __TIME__ << std::endl;
 }
 
+/*
+ * resolve_web_root - 确定web资源根目录
+ *
+ * 优先使用可执行文件所在目录下的web目录，不存在时使用当前工作
+ * 目录下的web目录。
+ *
+ * 返回值: web资源根目录
+ */
+static std::string resolve_web_root(void)
+{
+	std::string exec_dir = get_executable_path();
+	std::string web_root;
+
+	if (!exec_dir.empty()) {
+		web_root = exec_dir + "/web";
+		std::cout << "可执行文件目录: " << exec_dir << std::endl;
+		std::cout << "Web资源目录: " << web_root << std::endl;
+
+		/* 验证目录是否存在 */
+		DIR *dir = opendir(web_root.c_str());
+		if (dir) {
+			closedir(dir);
+			std::cout << "Web资源目录验证成功" << std::endl;
+			return web_root;
+		}
+		std::cout << "警告: Web资源目录不存在: " << web_root << std::endl;
+	} else {
+		std::cout << "警告: 无法获取可执行文件路径" << std::endl;
+	}
+
+	/* 后备：使用当前工作目录 */
+	char cwd[PATH_MAX];
+	if (getcwd(cwd, sizeof(cwd)) != NULL) {
+		web_root = std::string(cwd) + "/web";
+		std::cout << "使用当前工作目录: " << web_root << std::endl;
+	} else {
+		web_root = "web";
+		std::cout << "使用相对路径" << std::endl;
+	}
+	return web_root;
+}
+
+/*
+ * BackendStartup - 后端启动线程的结果
+ */
+struct BackendStartup {
+	FileManager *file_manager = NULL;	/* 文件管理器 */
+	WebServer *web_server = NULL;		/* Web服务器 */
+	bool ok = false;			/* 是否已开始监听 */
+	std::string error;			/* 失败原因 */
+};
+
+/*
+ * start_backend - 创建文件管理器和Web服务器并开始监听
+ *
+ * 在独立线程中运行，与主线程的GTK和WebKit初始化重叠，不调用任何
+ * GTK函数。失败时已创建的对象仍留在@result中，由主线程释放。
+ *
+ * @port: Web服务器端口
+ * @result: 输出参数，启动结果
+ */
+static void start_backend(int port, BackendStartup &result)
+{
+	try {
+		/*
+		 * FileManager负责所有文件系统操作，包括文件读写、目录遍历等。
+		 * libmagic在第一次使用时才加载
+		 */
+		std::cout << "正在初始化文件管理器..." << std::endl;
+		result.file_manager = new FileManager();
+		std::cout << "文件管理器初始化完成" << std::endl;
+		StartupTrace::instance().mark("file-manager");
+
+		/* WebServer提供HTTP服务，处理前端请求 */
+		std::cout << std::format("正在启动Web服务器 (端口: {})...", port)
+			  << std::endl;
+		result.web_server = new WebServer(result.file_manager);
+
+		/*
+		 * 设置web资源根目录，同时检查内置的首屏资源
+		 */
+		result.web_server->set_web_root_path(resolve_web_root());
+		StartupTrace::instance().mark("web-assets");
+
+		/*
+		 * 设置打开文件夹对话框的回调函数
+		 * 当前端请求打开文件夹时，通过此回调调用WindowManager
+		 */
+		result.web_server->set_open_folder_callback([]() -> std::string {
+			try {
+				if (g_window_manager)
+					return g_window_manager->
+						get_current_working_directory();
+			} catch (const std::exception &e) {
+				std::cerr << "回调函数异常: " << e.what()
+					  << std::endl;
+			} catch (...) {
+				std::cerr << "回调函数发生未知异常"
+					  << std::endl;
+			}
+			return "";
+		});
+
+		/*
+		 * 启动Web服务器
+		 * 服务器将在独立线程中运行，处理HTTP请求
+		 */
+		if (!result.web_server->start(port)) {
+			result.error = "无法启动Web服务器";
+			return;
+		}
+		StartupTrace::instance().mark("web-server-listening");
+		result.ok = true;
+	} catch (const std::exception &e) {
+		result.error = e.what();
+	}
+}
+
 /*
  * ============================================================================
  * 主函数
@@ -185,13 +306,14 @@ static void print_version(void)
  * 该函数执行以下步骤：
  * 1. 解析命令行参数
  * 2. 注册信号处理器
- * 3. 创建并初始化文件管理器
- * 4. 创建并启动Web服务器
- * 5. 创建并初始化窗口管理器
- * 6. 加载前端页面
- * 7. 显示窗口
- * 8. 运行GTK主循环
- * 9. 清理资源并退出
+ * 3. 在后端线程中创建文件管理器、启动Web服务器，同时在主线程中
+ *    创建并初始化窗口管理器
+ * 4. 等待两边完成，加载前端页面
+ * 5. 显示窗口
+ * 6. 运行GTK主循环
+ * 7. 清理资源并退出
+ *
+ * 各阶段的完成时间记录在StartupTrace中，前端初始化完成后写入日志。
  *
  * 命令行参数:
  * - -h, --help: 显示帮助信息并退出
@@ -207,6 +329,8 @@ int main(int argc, char *argv[])
 {
 	int port = WEB_SERVER_PORT;	/* Web服务器端口 */
 
+	StartupTrace::instance().mark("main");
+
 	/*
 	 * ====================================================================
 	 * 第一步：解析命令行参数
@@ -267,135 +391,53 @@ int main(int argc, char *argv[])
 	 * ====================================================================
 	 * 第四步：初始化各个子系统
 	 * ====================================================================
+	 *
+	 * 后端（文件管理器、Web服务器）在独立线程中启动，同时主线程
+	 * 初始化GTK和WebKit。两边都完成后再加载前端页面。
 	 */
 
+	BackendStartup backend;
+	std::thread backend_thread;
+
 	try {
-		/*
-		 * ----------------------------------------------------------------
-		 * 1. 创建文件管理器
-		 * ----------------------------------------------------------------
-		 * FileManager负责所有文件系统操作，包括文件读写、目录遍历等
-		 */
-		std::cout << "正在初始化文件管理器..." << std::endl;
-		g_file_manager = new FileManager();
-		if (!g_file_manager) {
-			std::cerr << "错误: 无法创建文件管理器"
-				  << std::endl;
-			return 1;
-		}
-		std::cout << "文件管理器初始化完成" << std::endl;
+		backend_thread = std::thread(start_backend, port, std::ref(backend));
 
 		/*
 		 * ----------------------------------------------------------------
-		 * 2. 创建Web服务器
+		 * 1. 创建窗口管理器
 		 * ----------------------------------------------------------------
-		 * WebServer提供HTTP服务，处理前端请求
-		 */
-		std::cout << std::format("正在启动Web服务器 (端口: {})...", port)
-			  << std::endl;
-		g_web_server = new WebServer(g_file_manager);
-		if (!g_web_server) {
-			std::cerr << "错误: 无法创建Web服务器" << std::endl;
-			delete g_file_manager;
-			return 1;
-		}
-
-		/*
-		 * 设置web资源根目录
-		 * 使用可执行文件所在目录
+		 * WindowManager负责GTK窗口和WebView的管理，GTK只能在主线程中
+		 * 使用
 		 */
-		std::string exec_dir = get_executable_path();
-		std::string web_root;
-
-		if (!exec_dir.empty()) {
-			web_root = exec_dir + "/web";
-			std::cout << "可执行文件目录: " << exec_dir << std::endl;
-			std::cout << "Web资源目录: " << web_root << std::endl;
-
-			/* 验证目录是否存在 */
-			DIR *dir = opendir(web_root.c_str());
-			if (dir) {
-				closedir(dir);
-				std::cout << "Web资源目录验证成功" << std::endl;
-			} else {
-				std::cout << "警告: Web资源目录不存在: " << web_root << std::endl;
-				/* 后备：使用当前工作目录 */
-				char cwd[PATH_MAX];
-				if (getcwd(cwd, sizeof(cwd)) != NULL) {
-					web_root = std::string(cwd) + "/web";
-					std::cout << "使用当前工作目录: " << web_root << std::endl;
-				} else {
-					web_root = "web";
-					std::cout << "使用相对路径" << std::endl;
-				}
-			}
-		} else {
-			std::cout << "警告: 无法获取可执行文件路径" << std::endl;
-			/* 使用当前工作目录 */
-			char cwd[PATH_MAX];
-			if (getcwd(cwd, sizeof(cwd)) != NULL) {
-				web_root = std::string(cwd) + "/web";
-				std::cout << "使用当前工作目录: " << web_root << std::endl;
-			} else {
-				web_root = "web";
-				std::cout << "使用相对路径" << std::endl;
-			}
-		}
-
-		g_web_server->set_web_root_path(web_root);
-
-		/*
-		 * 设置打开文件夹对话框的回调函数
-		 * 当前端请求打开文件夹时，通过此回调调用WindowManager
-		 */
-		g_web_server->set_open_folder_callback([]() -> std::string {
-			try {
-				if (g_window_manager)
-					return g_window_manager->
-						get_current_working_directory();
-			} catch (const std::exception &e) {
-				std::cerr << "回调函数异常: " << e.what()
-					  << std::endl;
-			} catch (...) {
-				std::cerr << "回调函数发生未知异常"
-					  << std::endl;
-			}
-			return "";
-		});
+		std::cout << "正在初始化窗口..." << std::endl;
+		g_window_manager = new WindowManager(nullptr);
 
 		/*
-		 * 启动Web服务器
-		 * 服务器将在独立线程中运行，处理HTTP请求
+		 * 初始化窗口
+		 * 创建GTK窗口和WebView组件
 		 */
-		if (!g_web_server->start(port)) {
-			std::cerr << "错误: 无法启动Web服务器" << std::endl;
-			delete g_web_server;
-			delete g_file_manager;
-			return 1;
-		}
-		std::cout << "Web服务器启动成功" << std::endl;
+		const bool window_ok = g_window_manager->init();
+		StartupTrace::instance().mark("window-ready");
 
 		/*
 		 * ----------------------------------------------------------------
-		 * 3. 创建窗口管理器
+		 * 2. 等待后端启动完成
 		 * ----------------------------------------------------------------
-		 * WindowManager负责GTK窗口和WebView的管理
 		 */
-		std::cout << "正在初始化窗口..." << std::endl;
-		g_window_manager = new WindowManager(g_web_server);
-		if (!g_window_manager) {
-			std::cerr << "错误: 无法创建窗口管理器" << std::endl;
-			g_web_server->stop();
+		backend_thread.join();
+		g_file_manager = backend.file_manager;
+		g_web_server = backend.web_server;
+
+		if (!backend.ok) {
+			std::cerr << "错误: " << backend.error << std::endl;
+			delete g_window_manager;
 			delete g_web_server;
 			delete g_file_manager;
 			return 1;
 		}
+		std::cout << "Web服务器启动成功" << std::endl;
 
-		/*
-		 * 初始化窗口
-		 * 创建GTK窗口和WebView组件
-		 */
-		if (!g_window_manager->init()) {
+		if (!window_ok) {
 			std::cerr << "错误: 无法初始化窗口" << std::endl;
 			delete g_window_manager;
 			g_web_server->stop();
@@ -403,32 +445,34 @@ int main(int argc, char *argv[])
 			delete g_file_manager;
 			return 1;
 		}
+		g_window_manager->set_web_server(g_web_server);
 		std::cout << "窗口初始化完成" << std::endl;
 
 		/*
 		 * ----------------------------------------------------------------
-		 * 4. 加载前端页面
+		 * 3. 加载前端页面
 		 * ----------------------------------------------------------------
 		 * 在WebView中加载前端HTML页面
 		 */
 		std::cout << "正在加载前端页面..." << std::endl;
-		g_window_manager->load_frontend_page();
+		g_window_manager->load_frontend_page(port);
 		std::cout << "前端页面加载完成" << std::endl;
 
 		/*
 		 * ----------------------------------------------------------------
-		 * 5. 显示窗口
+		 * 4. 显示窗口
 		 * ----------------------------------------------------------------
 		 * 将窗口显示到屏幕上
 		 */
 		std::cout << "正在显示窗口..." << std::endl;
 		g_window_manager->show();
+		StartupTrace::instance().mark("window-shown");
 		std::cout << "Mikufy 已启动!" << std::endl;
 		std::cout << std::endl;
 
 		/*
 		 * ----------------------------------------------------------------
-		 * 6. 运行GTK主循环
+		 * 5. 运行GTK主循环
 		 * ----------------------------------------------------------------
 		 * 启动GTK主事件循环，开始处理窗口事件
 		 * 该方法会阻塞直到窗口关闭
@@ -439,7 +483,12 @@ int main(int argc, char *argv[])
 		/* 捕获并处理异常 */
 		std::cerr << "错误: " << e.what() << std::endl;
 
-		/* 清理资源 */
+		/* 等待后端线程，清理资源 */
+		if (backend_thread.joinable()) {
+			backend_thread.join();
+			g_file_manager = backend.file_manager;
+			g_web_server = backend.web_server;
+		}
 		delete g_window_manager;
 		delete g_web_server;
 		delete g_file_manager;
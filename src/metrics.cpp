@@ -0,0 +1,268 @@
+/*
+ * Mikufy v2.11-nova - 运行指标实现
+ *
+ * 本文件实现了MetricHistogram和Metrics类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/metrics.h"
+#include <algorithm>		/* std::lower_bound */
+#include <cstdio>		/* snprintf() */
+
+/* 直方图各桶的上界（秒），最后一个桶之后是+Inf */
+static const double histogram_bounds[METRICS_HISTOGRAM_BUCKETS] = {
+	0.00005, 0.0001, 0.00025, 0.0005,
+	0.001, 0.0025, 0.005, 0.01,
+	0.025, 0.05, 0.1, 0.25,
+	0.5, 1.0, 2.5, 10.0
+};
+
+/* 各桶上界的纳秒值，observe()中用整数比较 */
+static const uint64_t histogram_bounds_ns[METRICS_HISTOGRAM_BUCKETS] = {
+	50000ULL, 100000ULL, 250000ULL, 500000ULL,
+	1000000ULL, 2500000ULL, 5000000ULL, 10000000ULL,
+	25000000ULL, 50000000ULL, 100000000ULL, 250000000ULL,
+	500000000ULL, 1000000000ULL, 2500000000ULL, 10000000000ULL
+};
+
+/**
+ * format_double - 输出浮点数（Prometheus接受%g格式）
+ */
+static void format_double(std::string &out, double value)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%.9g", value);
+	out += text;
+}
+
+/**
+ * append_series - 输出一行 name{labels} value 的开头部分
+ *
+ * @extra: 追加在labels之后的标签（直方图的le），可以为空
+ */
+static void append_series(std::string &out, std::string_view name,
+			  std::string_view suffix, std::string_view labels,
+			  std::string_view extra)
+{
+	out += name;
+	out += suffix;
+
+	if (!labels.empty() || !extra.empty()) {
+		out += '{';
+		out += labels;
+		if (!labels.empty() && !extra.empty())
+			out += ',';
+		out += extra;
+		out += '}';
+	}
+	out += ' ';
+}
+
+/*
+ * ============================================================================
+ * MetricHistogram
+ * ============================================================================
+ */
+
+/**
+ * MetricHistogram::MetricHistogram - 构造函数
+ */
+MetricHistogram::MetricHistogram(void) : sum_ns(0)
+{
+	for (auto &bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * MetricHistogram::observe - 记录一次耗时
+ * @elapsed: 耗时
+ */
+void MetricHistogram::observe(std::chrono::steady_clock::duration elapsed)
+{
+	const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   elapsed).count();
+	const uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+
+	/* 第一个不小于耗时的上界所在的桶（上界包含在桶内，le语义） */
+	const uint64_t *end = histogram_bounds_ns + METRICS_HISTOGRAM_BUCKETS;
+	const uint64_t *it = std::lower_bound(histogram_bounds_ns, end, value);
+	buckets[it - histogram_bounds_ns].fetch_add(1, std::memory_order_relaxed);
+	sum_ns.fetch_add(value, std::memory_order_relaxed);
+}
+
+/**
+ * MetricHistogram::render - 以Prometheus文本格式输出
+ *
+ * 各桶分别读取，与并发的observe()之间不是一个快照，累计计数仍然
+ * 单调，_count取累计到+Inf的值，与各桶一致。
+ */
+void MetricHistogram::render(std::string &out, std::string_view name,
+			     std::string_view labels) const
+{
+	uint64_t cumulative = 0;
+
+	for (int i = 0; i <= METRICS_HISTOGRAM_BUCKETS; i++) {
+		cumulative += buckets[i].load(std::memory_order_relaxed);
+
+		std::string le = "le=\"";
+		if (i < METRICS_HISTOGRAM_BUCKETS)
+			format_double(le, histogram_bounds[i]);
+		else
+			le += "+Inf";
+		le += '"';
+
+		append_series(out, name, "_bucket", labels, le);
+		out += std::to_string(cumulative);
+		out += '\n';
+	}
+
+	append_series(out, name, "_sum", labels, "");
+	format_double(out, sum_ns.load(std::memory_order_relaxed) / 1e9);
+	out += '\n';
+
+	append_series(out, name, "_count", labels, "");
+	out += std::to_string(cumulative);
+	out += '\n';
+}
+
+/*
+ * ============================================================================
+ * Metrics
+ * ============================================================================
+ */
+
+/**
+ * Metrics::instance - 获取全局注册表
+ *
+ * 注册表不析构：其他模块的静态对象退出时可能仍在更新指标。
+ */
+Metrics &Metrics::instance(void)
+{
+	static Metrics *metrics = new Metrics();
+	return *metrics;
+}
+
+/**
+ * Metrics::counter - 注册（或取得已注册的）计数器
+ */
+MetricCounter &Metrics::counter(const std::string &name,
+				const std::string &help,
+				const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto [it, inserted] = families.try_emplace(name);
+	Family &family = it->second;
+	if (inserted) {
+		family.help = help;
+		family.is_histogram = false;
+	}
+
+	for (auto &series : family.counters) {
+		if (series.first == labels)
+			return *series.second;
+	}
+
+	family.counters.emplace_back(labels, std::make_unique<MetricCounter>());
+	return *family.counters.back().second;
+}
+
+/**
+ * Metrics::histogram - 注册（或取得已注册的）直方图
+ */
+MetricHistogram &Metrics::histogram(const std::string &name,
+				    const std::string &help,
+				    const std::string &labels)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto [it, inserted] = families.try_emplace(name);
+	Family &family = it->second;
+	if (inserted) {
+		family.help = help;
+		family.is_histogram = true;
+	}
+
+	for (auto &series : family.histograms) {
+		if (series.first == labels)
+			return *series.second;
+	}
+
+	family.histograms.emplace_back(labels,
+				       std::make_unique<MetricHistogram>());
+	return *family.histograms.back().second;
+}
+
+/**
+ * Metrics::render - 以Prometheus文本格式导出所有指标
+ * @out: 输出追加到末尾
+ */
+void Metrics::render(std::string &out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (const auto &[name, family] : families) {
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		out += family.help;
+		out += "\n# TYPE ";
+		out += name;
+		out += family.is_histogram ? " histogram\n" : " counter\n";
+
+		for (const auto &[labels, counter] : family.counters) {
+			append_series(out, name, "", labels, "");
+			out += std::to_string(counter->get());
+			out += '\n';
+		}
+
+		for (const auto &[labels, histogram] : family.histograms)
+			histogram->render(out, name, labels);
+	}
+}
+
+/**
+ * Metrics::render_gauge - 输出一个瞬时值
+ */
+void Metrics::render_gauge(std::string &out, std::string_view name,
+			   std::string_view help, double value)
+{
+	out += "# HELP ";
+	out += name;
+	out += ' ';
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += " gauge\n";
+	append_series(out, name, "", "", "");
+	format_double(out, value);
+	out += '\n';
+}
+
+/**
+ * Metrics::label - 格式化一个标签
+ *
+ * 按Prometheus文本格式转义反斜杠、双引号和换行。
+ */
+std::string Metrics::label(std::string_view name, std::string_view value)
+{
+	std::string out(name);
+	out += "=\"";
+
+	for (char c : value) {
+		if (c == '\\' || c == '"') {
+			out += '\\';
+			out += c;
+		} else if (c == '\n') {
+			out += "\\n";
+		} else {
+			out += c;
+		}
+	}
+
+	out += '"';
+	return out;
+}
@@ -0,0 +1,203 @@
+/*
+ * Mikufy v2.11-nova - 文件类型缓存实现
+ *
+ * 本文件实现了MimeCache类的所有方法。
+ *
+ * 缓存文件是文本格式，第一行是MIME_CACHE_FILE_HEADER，之后每行
+ * 一个条目：设备号 inode 修改时间(纳秒) 大小 是否二进制 MIME类型。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/mime_cache.h"
+#include <charconv>		/* std::from_chars */
+#include <cstdio>		/* std::rename */
+#include <cstdlib>		/* getenv() */
+#include <fstream>		/* std::ifstream, std::ofstream */
+#include <unistd.h>		/* getpid() */
+
+/**
+ * MimeCache::MimeCache - 构造函数
+ * @file_path: 缓存文件路径，为空表示不持久化
+ */
+MimeCache::MimeCache(std::string file_path)
+	: file_path(std::move(file_path)), dirty(false)
+{
+	load();
+}
+
+/**
+ * MimeCache::~MimeCache - 析构函数
+ */
+MimeCache::~MimeCache(void)
+{
+	save();
+}
+
+/**
+ * MimeCache::default_path - 默认的缓存文件路径
+ */
+std::string MimeCache::default_path(void)
+{
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	if (cache_home && cache_home[0] == '/')
+		return std::string(cache_home) + "/" + MIME_CACHE_FILE_NAME;
+
+	const char *home = getenv("HOME");
+	if (home && home[0] == '/')
+		return std::string(home) + "/.cache/" + MIME_CACHE_FILE_NAME;
+
+	return "";
+}
+
+/**
+ * MimeCache::KeyHash::operator() - 计算缓存键的哈希值
+ */
+size_t MimeCache::KeyHash::operator()(const Key &key) const
+{
+	/* inode在同一设备内基本唯一，其余字段只需打散 */
+	uint64_t h = key.ino;
+	h ^= key.dev + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	h ^= static_cast<uint64_t>(key.mtime_ns) + 0x9e3779b97f4a7c15ULL +
+	     (h << 6) + (h >> 2);
+	h ^= key.size + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	return static_cast<size_t>(h);
+}
+
+/**
+ * MimeCache::make_key - 从stat结果构造缓存键
+ */
+MimeCache::Key MimeCache::make_key(const struct stat &st)
+{
+	Key key;
+	key.dev = static_cast<uint64_t>(st.st_dev);
+	key.ino = static_cast<uint64_t>(st.st_ino);
+	key.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL +
+		       st.st_mtim.tv_nsec;
+	key.size = static_cast<uint64_t>(st.st_size);
+	return key;
+}
+
+/**
+ * MimeCache::lookup - 查找文件的判定结果
+ */
+bool MimeCache::lookup(const struct stat &st, MimeInfo &info)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = entries.find(make_key(st));
+	if (it == entries.end())
+		return false;
+
+	info = it->second;
+	return true;
+}
+
+/**
+ * MimeCache::store - 保存文件的判定结果
+ *
+ * 达到上限时淘汰一半条目。缓存的只是推测结果，被淘汰的文件下次
+ * 打开时重新判定即可，不值得为此维护LRU顺序。
+ */
+void MimeCache::store(const struct stat &st, const MimeInfo &info)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (entries.size() >= MIME_CACHE_MAX_ENTRIES) {
+		auto it = entries.begin();
+		for (size_t i = 0; i < MIME_CACHE_MAX_ENTRIES / 2 &&
+				   it != entries.end(); i++)
+			it = entries.erase(it);
+	}
+
+	entries.insert_or_assign(make_key(st), info);
+	dirty = true;
+}
+
+/**
+ * MimeCache::load - 加载缓存文件
+ */
+void MimeCache::load(void)
+{
+	if (file_path.empty())
+		return;
+
+	std::ifstream file(file_path);
+	if (!file.is_open())
+		return;
+
+	std::string line;
+	if (!std::getline(file, line) || line != MIME_CACHE_FILE_HEADER)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while (std::getline(file, line) &&
+	       entries.size() < MIME_CACHE_MAX_ENTRIES) {
+		const char *p = line.data();
+		const char *end = p + line.size();
+		Key key;
+		int binary = 0;
+
+		/* 依次解析五个数字字段，每个后面跟一个空格 */
+		auto parse = [&](auto &value) {
+			auto result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || result.ptr == end ||
+			    *result.ptr != ' ')
+				return false;
+			p = result.ptr + 1;
+			return true;
+		};
+
+		if (!parse(key.dev) || !parse(key.ino) || !parse(key.mtime_ns) ||
+		    !parse(key.size) || !parse(binary) || p == end)
+			continue;
+
+		MimeInfo info;
+		info.mime_type.assign(p, end);
+		info.is_binary = (binary != 0);
+		entries.emplace(key, std::move(info));
+	}
+}
+
+/**
+ * MimeCache::save - 把缓存写入缓存文件
+ */
+bool MimeCache::save(void)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!dirty || file_path.empty())
+		return true;
+
+	/* 创建缓存目录（逐级，已存在时忽略） */
+	for (size_t pos = file_path.find('/', 1); pos != std::string::npos;
+	     pos = file_path.find('/', pos + 1))
+		mkdir(file_path.substr(0, pos).c_str(), 0755);
+
+	/* 把pid加入临时文件名，同时运行的多个实例不会写同一个文件 */
+	const std::string tmp_path = file_path + ".tmp." +
+				     std::to_string(getpid());
+	std::ofstream file(tmp_path, std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << MIME_CACHE_FILE_HEADER << '\n';
+	for (const auto &pair : entries) {
+		const Key &key = pair.first;
+		file << key.dev << ' ' << key.ino << ' ' << key.mtime_ns << ' '
+		     << key.size << ' ' << (pair.second.is_binary ? 1 : 0) << ' '
+		     << pair.second.mime_type << '\n';
+	}
+
+	file.close();
+	if (!file || std::rename(tmp_path.c_str(), file_path.c_str()) != 0) {
+		unlink(tmp_path.c_str());
+		return false;
+	}
+
+	dirty = false;
+	return true;
+}
@@ -0,0 +1,563 @@
+/*
+ * Mikufy v2.11-nova - Piece 树实现
+ *
+ * 本文件实现了 PieceTree 类的所有方法。红黑树的插入、删除和修复
+ * 过程与《算法导论》中带哨兵的版本一致，额外在结构变化处维护
+ * subtree_length 和 subtree_line_feeds 两个统计字段。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循 Linux 内核代码风格规范
+ */
+
+#include "../headers/piece_tree.h"
+
+/*
+ * ============================================================================
+ * 构造函数和析构函数
+ * ============================================================================
+ */
+
+/**
+ * PieceTree - 构造函数
+ *
+ * 初始化哨兵节点，哨兵为黑色且统计信息为0，使得统计字段的
+ * 计算不需要判断子树是否为空。
+ */
+PieceTree::PieceTree(void)
+	: nil(&nil_node)
+	, root(&nil_node)
+	, count(0)
+{
+	nil_node.line_feeds = 0;
+	nil_node.subtree_length = 0;
+	nil_node.subtree_line_feeds = 0;
+	nil_node.parent = nil;
+	nil_node.left = nil;
+	nil_node.right = nil;
+	nil_node.red = false;
+}
+
+/**
+ * ~PieceTree - 析构函数
+ */
+PieceTree::~PieceTree(void)
+{
+	clear();
+}
+
+/**
+ * clear - 删除所有节点
+ */
+void PieceTree::clear(void)
+{
+	destroy(root);
+	root = nil;
+	nil->parent = nil;
+	count = 0;
+}
+
+/**
+ * destroy - 递归释放子树
+ *
+ * 红黑树高度不超过 2log(n+1)，递归深度有保证。
+ */
+void PieceTree::destroy(PieceNode *node)
+{
+	if (node == nil)
+		return;
+
+	destroy(node->left);
+	destroy(node->right);
+	delete node;
+}
+
+/*
+ * ============================================================================
+ * 遍历
+ * ============================================================================
+ */
+
+PieceNode *PieceTree::minimum(PieceNode *node) const
+{
+	while (node->left != nil)
+		node = node->left;
+	return node;
+}
+
+PieceNode *PieceTree::maximum(PieceNode *node) const
+{
+	while (node->right != nil)
+		node = node->right;
+	return node;
+}
+
+PieceNode *PieceTree::first(void) const
+{
+	return (root == nil) ? nullptr : minimum(root);
+}
+
+PieceNode *PieceTree::last(void) const
+{
+	return (root == nil) ? nullptr : maximum(root);
+}
+
+/**
+ * next - 中序后继节点
+ */
+PieceNode *PieceTree::next(PieceNode *node) const
+{
+	if (node->right != nil)
+		return minimum(node->right);
+
+	PieceNode *parent = node->parent;
+	while (parent != nil && node == parent->right) {
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return (parent == nil) ? nullptr : parent;
+}
+
+/**
+ * prev - 中序前驱节点
+ */
+PieceNode *PieceTree::prev(PieceNode *node) const
+{
+	if (node->left != nil)
+		return maximum(node->left);
+
+	PieceNode *parent = node->parent;
+	while (parent != nil && node == parent->left) {
+		node = parent;
+		parent = parent->parent;
+	}
+
+	return (parent == nil) ? nullptr : parent;
+}
+
+/*
+ * ============================================================================
+ * 查找
+ * ============================================================================
+ */
+
+/**
+ * find_by_offset - 查找包含指定位置的节点
+ *
+ * 从根向下，根据左子树的字节数决定走向，O(log n)。
+ */
+PieceNode *PieceTree::find_by_offset(size_t pos, size_t &piece_start) const
+{
+	size_t line_feeds_before;
+	return find_by_offset(pos, piece_start, line_feeds_before);
+}
+
+PieceNode *PieceTree::find_by_offset(size_t pos, size_t &piece_start,
+				     size_t &line_feeds_before) const
+{
+	PieceNode *node = root;
+	size_t base = 0;
+	size_t before = 0;
+
+	while (node != nil) {
+		const size_t left_length = node->left->subtree_length;
+
+		if (pos < left_length) {
+			node = node->left;
+			continue;
+		}
+
+		pos -= left_length;
+		base += left_length;
+		before += node->left->subtree_line_feeds;
+
+		if (pos < node->piece.length) {
+			piece_start = base;
+			line_feeds_before = before;
+			return node;
+		}
+
+		pos -= node->piece.length;
+		base += node->piece.length;
+		before += node->line_feeds;
+		node = node->right;
+	}
+
+	return nullptr;
+}
+
+/**
+ * find_by_line_feed - 查找包含第 index 个换行符的节点
+ *
+ * 与 find_by_offset 相同的下降过程，比较的是换行符数量。
+ */
+PieceNode *PieceTree::find_by_line_feed(size_t index, size_t &piece_start,
+					size_t &line_feeds_before) const
+{
+	PieceNode *node = root;
+	size_t base = 0;
+	size_t before = 0;
+
+	while (node != nil) {
+		const size_t left_line_feeds = node->left->subtree_line_feeds;
+
+		if (index < left_line_feeds) {
+			node = node->left;
+			continue;
+		}
+
+		index -= left_line_feeds;
+		before += left_line_feeds;
+		base += node->left->subtree_length;
+
+		if (index < node->line_feeds) {
+			piece_start = base;
+			line_feeds_before = before;
+			return node;
+		}
+
+		index -= node->line_feeds;
+		before += node->line_feeds;
+		base += node->piece.length;
+		node = node->right;
+	}
+
+	return nullptr;
+}
+
+/**
+ * offset_of - 计算节点 Piece 在文档中的起始位置
+ *
+ * 从节点向上走到根，累加所有位于其左侧的内容。
+ */
+size_t PieceTree::offset_of(const PieceNode *node) const
+{
+	size_t offset = node->left->subtree_length;
+
+	while (node->parent != nil) {
+		const PieceNode *parent = node->parent;
+		if (node == parent->right)
+			offset += parent->left->subtree_length +
+				  parent->piece.length;
+		node = parent;
+	}
+
+	return offset;
+}
+
+/*
+ * ============================================================================
+ * 统计信息维护
+ * ============================================================================
+ */
+
+/**
+ * recompute - 根据子节点重新计算节点的统计信息
+ */
+void PieceTree::recompute(PieceNode *node)
+{
+	node->subtree_length = node->left->subtree_length +
+			       node->piece.length +
+			       node->right->subtree_length;
+	node->subtree_line_feeds = node->left->subtree_line_feeds +
+				   node->line_feeds +
+				   node->right->subtree_line_feeds;
+}
+
+/**
+ * update_path - 从节点到根重新计算统计信息
+ */
+void PieceTree::update_path(PieceNode *node)
+{
+	while (node != nil) {
+		recompute(node);
+		node = node->parent;
+	}
+}
+
+/*
+ * ============================================================================
+ * 旋转
+ * ============================================================================
+ */
+
+/**
+ * rotate_left - 左旋
+ *
+ * 旋转不改变子树内容，只需重新计算参与旋转的两个节点
+ * （先算下沉的 x，再算上升的 y）。
+ */
+void PieceTree::rotate_left(PieceNode *x)
+{
+	PieceNode *y = x->right;
+
+	x->right = y->left;
+	if (y->left != nil)
+		y->left->parent = x;
+
+	y->parent = x->parent;
+	if (x->parent == nil)
+		root = y;
+	else if (x == x->parent->left)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+
+	y->left = x;
+	x->parent = y;
+
+	recompute(x);
+	recompute(y);
+}
+
+/**
+ * rotate_right - 右旋
+ */
+void PieceTree::rotate_right(PieceNode *x)
+{
+	PieceNode *y = x->left;
+
+	x->left = y->right;
+	if (y->right != nil)
+		y->right->parent = x;
+
+	y->parent = x->parent;
+	if (x->parent == nil)
+		root = y;
+	else if (x == x->parent->right)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+
+	y->right = x;
+	x->parent = y;
+
+	recompute(x);
+	recompute(y);
+}
+
+/*
+ * ============================================================================
+ * 修改
+ * ============================================================================
+ */
+
+/**
+ * insert_before - 在指定节点之前插入 Piece
+ *
+ * 新节点挂在 pos 的左子树最右端（或 pos 的左孩子位置），
+ * 保证中序顺序上紧邻 pos 之前。
+ */
+PieceNode *PieceTree::insert_before(PieceNode *pos, const Piece &piece,
+				    size_t line_feeds)
+{
+	PieceNode *z = new PieceNode;
+	z->piece = piece;
+	z->line_feeds = line_feeds;
+	z->left = nil;
+	z->right = nil;
+	z->red = true;
+
+	if (root == nil) {
+		z->parent = nil;
+		root = z;
+	} else if (!pos) {
+		PieceNode *parent = maximum(root);
+		parent->right = z;
+		z->parent = parent;
+	} else if (pos->left == nil) {
+		pos->left = z;
+		z->parent = pos;
+	} else {
+		PieceNode *parent = maximum(pos->left);
+		parent->right = z;
+		z->parent = parent;
+	}
+
+	update_path(z);
+	insert_fixup(z);
+	count++;
+
+	return z;
+}
+
+/**
+ * insert_fixup - 插入后恢复红黑性质
+ */
+void PieceTree::insert_fixup(PieceNode *z)
+{
+	while (z->parent->red) {
+		PieceNode *grandparent = z->parent->parent;
+
+		if (z->parent == grandparent->left) {
+			PieceNode *uncle = grandparent->right;
+			if (uncle->red) {
+				z->parent->red = false;
+				uncle->red = false;
+				grandparent->red = true;
+				z = grandparent;
+			} else {
+				if (z == z->parent->right) {
+					z = z->parent;
+					rotate_left(z);
+				}
+				z->parent->red = false;
+				z->parent->parent->red = true;
+				rotate_right(z->parent->parent);
+			}
+		} else {
+			PieceNode *uncle = grandparent->left;
+			if (uncle->red) {
+				z->parent->red = false;
+				uncle->red = false;
+				grandparent->red = true;
+				z = grandparent;
+			} else {
+				if (z == z->parent->left) {
+					z = z->parent;
+					rotate_right(z);
+				}
+				z->parent->red = false;
+				z->parent->parent->red = true;
+				rotate_left(z->parent->parent);
+			}
+		}
+	}
+
+	root->red = false;
+}
+
+/**
+ * update - 原地修改节点的 Piece
+ *
+ * 树结构不变，只需更新到根路径上的统计信息。
+ */
+void PieceTree::update(PieceNode *node, const Piece &piece, size_t line_feeds)
+{
+	node->piece = piece;
+	node->line_feeds = line_feeds;
+	update_path(node);
+}
+
+/**
+ * transplant - 用子树 v 替换子树 u 在父节点中的位置
+ */
+void PieceTree::transplant(PieceNode *u, PieceNode *v)
+{
+	if (u->parent == nil)
+		root = v;
+	else if (u == u->parent->left)
+		u->parent->left = v;
+	else
+		u->parent->right = v;
+
+	v->parent = u->parent;
+}
+
+/**
+ * erase - 删除节点
+ *
+ * 结构调整完成后，从 x 的父节点（哨兵的 parent 也会被正确设置）
+ * 一路向上重新计算统计信息，再做颜色修复。
+ */
+void PieceTree::erase(PieceNode *z)
+{
+	PieceNode *y = z;
+	PieceNode *x;
+	bool y_was_red = y->red;
+
+	if (z->left == nil) {
+		x = z->right;
+		transplant(z, z->right);
+	} else if (z->right == nil) {
+		x = z->left;
+		transplant(z, z->left);
+	} else {
+		y = minimum(z->right);
+		y_was_red = y->red;
+		x = y->right;
+
+		if (y->parent == z) {
+			x->parent = y;
+		} else {
+			transplant(y, y->right);
+			y->right = z->right;
+			y->right->parent = y;
+		}
+
+		transplant(z, y);
+		y->left = z->left;
+		y->left->parent = y;
+		y->red = z->red;
+	}
+
+	update_path(x->parent);
+
+	if (!y_was_red)
+		erase_fixup(x);
+
+	nil->parent = nil;
+	delete z;
+	count--;
+}
+
+/**
+ * erase_fixup - 删除后恢复红黑性质
+ */
+void PieceTree::erase_fixup(PieceNode *x)
+{
+	while (x != root && !x->red) {
+		if (x == x->parent->left) {
+			PieceNode *w = x->parent->right;
+			if (w->red) {
+				w->red = false;
+				x->parent->red = true;
+				rotate_left(x->parent);
+				w = x->parent->right;
+			}
+			if (!w->left->red && !w->right->red) {
+				w->red = true;
+				x = x->parent;
+			} else {
+				if (!w->right->red) {
+					w->left->red = false;
+					w->red = true;
+					rotate_right(w);
+					w = x->parent->right;
+				}
+				w->red = x->parent->red;
+				x->parent->red = false;
+				w->right->red = false;
+				rotate_left(x->parent);
+				x = root;
+			}
+		} else {
+			PieceNode *w = x->parent->left;
+			if (w->red) {
+				w->red = false;
+				x->parent->red = true;
+				rotate_right(x->parent);
+				w = x->parent->left;
+			}
+			if (!w->right->red && !w->left->red) {
+				w->red = true;
+				x = x->parent;
+			} else {
+				if (!w->left->red) {
+					w->right->red = false;
+					w->red = true;
+					rotate_left(w);
+					w = x->parent->left;
+				}
+				w->red = x->parent->red;
+				x->parent->red = false;
+				w->left->red = false;
+				rotate_right(x->parent);
+				x = root;
+			}
+		}
+	}
+
+	x->red = false;
+}
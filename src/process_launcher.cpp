@@ -4,8 +4,11 @@
  * 本文件实现了ProcessLauncher类，提供智能进程启动和GUI检测功能。
  *
  * 核心实现:
- * - X11窗口检测：枚举窗口树，检查_NET_WM_PID属性
- * - Wayland连接检测：检查/proc/[pid]/fd中的wayland连接
+ * - X11窗口检测：启动前订阅根窗口的CreateNotify，新窗口及其
+ *   PropertyNotify到达时检查_NET_WM_PID属性
+ * - 显示服务器连接检测：/proc/[pid]/fd 中出现新的socket时，用
+ *   sock_diag查询其对端是否是Wayland或X11的监听socket
+ * - 进程退出检测：pidfd可读即退出，与X11连接一起poll()等待
  * - PTY进程管理：forkpty创建伪终端
  * - GUI进程重启：检测到GUI后终止PTY，重新fork+execve
  * - RAII资源管理
@@ -24,12 +27,25 @@
 #include <termios.h>
 #include <pty.h>
 #include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
 #include <cstring>
+#include <cstdlib>
+#include <format>
 #include <filesystem>
 #include <thread>
 #include <algorithm>
+#include <map>
+#include <mutex>
 #include <regex>
-#include <dirent.h>
+#include <unordered_set>
 
 #ifdef HAVE_X11
 #include <X11/Xlib.h>
@@ -38,6 +54,436 @@
 
 namespace mikufy {
 
+/* 检测显示服务器连接的间隔（毫秒），socket连接没有可以等待的事件 */
+#define DETECTION_PROBE_INTERVAL_MS	20
+
+/*
+ * ============================================================================
+ * 辅助函数
+ * ============================================================================
+ */
+
+/**
+ * open_pidfd - 打开进程的pidfd
+ *
+ * 进程退出后pidfd变为可读，可以与其他fd一起poll()。
+ *
+ * @param pid: 子进程ID
+ * @return int: pidfd，内核不支持时返回-1
+ */
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/**
+ * display_socket_paths - 当前会话的显示服务器socket地址
+ *
+ * Wayland为 $XDG_RUNTIME_DIR/$WAYLAND_DISPLAY（未设置时为
+ * wayland-0，也可以是绝对路径）；X11为 /tmp/.X11-unix/X<编号>，
+ * 同时包含同名的抽象socket（首字节为'\0'）。
+ *
+ * @return std::vector<std::string>: socket地址
+ */
+static std::vector<std::string> display_socket_paths()
+{
+	std::vector<std::string> paths;
+
+	const char *wayland = getenv("WAYLAND_DISPLAY");
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	std::string name = (wayland && *wayland) ? wayland : "wayland-0";
+	if (name[0] == '/')
+		paths.push_back(name);
+	else if (runtime && *runtime)
+		paths.push_back(std::format("{}/{}", runtime, name));
+
+	const char *display = getenv("DISPLAY");
+	if (display && display[0] == ':') {
+		int number = atoi(display + 1);
+		std::string x11 = std::format("/tmp/.X11-unix/X{}", number);
+		paths.push_back(std::string(1, '\0') + x11);
+		paths.push_back(std::move(x11));
+	}
+
+	return paths;
+}
+
+/**
+ * FileIdentity - 可执行文件的标识，文件被替换或重新编译后改变
+ */
+struct FileIdentity {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+
+	bool operator==(const FileIdentity &other) const
+	{
+		return dev == other.dev && ino == other.ino &&
+		       size == other.size &&
+		       mtime.tv_sec == other.mtime.tv_sec &&
+		       mtime.tv_nsec == other.mtime.tv_nsec;
+	}
+};
+
+/**
+ * file_identity - 读取可执行文件的标识
+ *
+ * @param path: 文件路径
+ * @return std::optional<FileIdentity>: 文件不存在时返回std::nullopt
+ */
+static std::optional<FileIdentity> file_identity(const std::string &path)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return std::nullopt;
+
+	return FileIdentity{st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+}
+
+/**
+ * CachedVerdict - 一个可执行文件的检测结果
+ */
+struct CachedVerdict {
+	FileIdentity identity;
+	ProcessType type;
+};
+
+/* 检测结果缓存（可执行文件路径 -> 结果），所有实例共享 */
+static std::mutex verdict_mutex;
+static std::map<std::string, CachedVerdict> verdict_cache;
+
+/*
+ * ============================================================================
+ * DisplayProbe - 显示服务器连接检测
+ * ============================================================================
+ */
+
+/**
+ * DisplayProbe - 检测进程是否连接了Wayland或X11显示服务器
+ *
+ * socket的readlink只有"socket:[inode]"，看不出连接的是谁。
+ * 每次检测只读取 /proc/[pid]/fd，出现新的socket inode时才用一次
+ * sock_diag转储查询对端：服务器accept的socket继承监听socket的
+ * 地址，对端地址就是显示服务器的socket路径。
+ */
+class DisplayProbe {
+public:
+	explicit DisplayProbe(pid_t pid)
+		: fd_path(std::format("/proc/{}/fd", pid)),
+		  server_paths(display_socket_paths()) {}
+
+	/**
+	 * connected - 检查进程是否已连接显示服务器
+	 *
+	 * @return bool: 已连接返回true
+	 */
+	bool connected()
+	{
+		if (server_paths.empty())
+			return false;
+
+		std::vector<uint32_t> fresh;
+
+		DIR *dir = opendir(fd_path.c_str());
+		if (!dir)
+			return false;
+
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != nullptr) {
+			if (entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN)
+				continue;
+
+			char target[64];
+			ssize_t len = readlinkat(dirfd(dir), entry->d_name, target,
+						 sizeof(target) - 1);
+			if (len <= 0)
+				continue;
+			target[len] = '\0';
+
+			unsigned long inode = 0;
+			if (sscanf(target, "socket:[%lu]", &inode) == 1 &&
+			    seen.insert(inode).second)
+				fresh.push_back(static_cast<uint32_t>(inode));
+		}
+		closedir(dir);
+
+		return !fresh.empty() && peers_are_display(fresh);
+	}
+
+private:
+	const std::string fd_path;
+	const std::vector<std::string> server_paths;
+	std::unordered_set<unsigned long> seen;	/* 已检查过的socket inode */
+
+	/**
+	 * peers_are_display - 检查socket中是否有对端是显示服务器的
+	 *
+	 * @param inodes: 进程新打开的socket inode
+	 * @return bool: 有连接到显示服务器的socket返回true
+	 */
+	bool peers_are_display(const std::vector<uint32_t> &inodes) const
+	{
+		int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+				NETLINK_SOCK_DIAG);
+		if (fd < 0)
+			return false;
+
+		struct {
+			struct nlmsghdr header;
+			struct unix_diag_req request;
+		} message;
+		memset(&message, 0, sizeof(message));
+		message.header.nlmsg_len = sizeof(message);
+		message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+		message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+		message.request.sdiag_family = AF_UNIX;
+		message.request.udiag_states = ~0U;
+		message.request.udiag_show = UDIAG_SHOW_NAME | UDIAG_SHOW_PEER;
+
+		if (send(fd, &message, sizeof(message), 0) < 0) {
+			close(fd);
+			return false;
+		}
+
+		/* 一次转储中收集：进程socket的对端、显示服务器一侧的socket */
+		std::vector<uint32_t> peers;
+		std::unordered_set<uint32_t> server_sockets;
+		alignas(struct nlmsghdr) char buffer[32768];
+		bool done = false;
+
+		while (!done) {
+			ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+			if (len < 0 && errno == EINTR)
+				continue;
+			if (len <= 0)
+				break;
+
+			int remaining = static_cast<int>(len);
+			for (struct nlmsghdr *header = (struct nlmsghdr *)buffer;
+			     NLMSG_OK(header, remaining);
+			     header = NLMSG_NEXT(header, remaining)) {
+				if (header->nlmsg_type == NLMSG_DONE ||
+				    header->nlmsg_type == NLMSG_ERROR) {
+					done = true;
+					break;
+				}
+
+				auto *diag = (struct unix_diag_msg *)NLMSG_DATA(header);
+				const bool mine = std::find(inodes.begin(), inodes.end(),
+							    diag->udiag_ino) !=
+						  inodes.end();
+				int attr_len = static_cast<int>(header->nlmsg_len -
+						NLMSG_LENGTH(sizeof(*diag)));
+
+				for (struct rtattr *attr = (struct rtattr *)(diag + 1);
+				     RTA_OK(attr, attr_len);
+				     attr = RTA_NEXT(attr, attr_len)) {
+					if (attr->rta_type == UNIX_DIAG_PEER && mine) {
+						peers.push_back(*(uint32_t *)RTA_DATA(attr));
+					} else if (attr->rta_type == UNIX_DIAG_NAME) {
+						std::string name((const char *)RTA_DATA(attr),
+								 RTA_PAYLOAD(attr));
+						/* 路径地址可能带有结尾的'\0'，抽象地址没有 */
+						if (!name.empty() && name[0] != '\0')
+							name = name.substr(0, name.find('\0'));
+						if (std::find(server_paths.begin(),
+							      server_paths.end(),
+							      name) != server_paths.end())
+							server_sockets.insert(diag->udiag_ino);
+					}
+				}
+			}
+		}
+
+		close(fd);
+
+		for (uint32_t peer : peers) {
+			if (server_sockets.count(peer))
+				return true;
+		}
+		return false;
+	}
+};
+
+#ifdef HAVE_X11
+/*
+ * ============================================================================
+ * X11Watch - X11窗口创建监视
+ * ============================================================================
+ */
+
+/* 监视器的显示连接，这些连接上的错误被忽略 */
+static std::mutex x_error_mutex;
+static std::vector<Display *> x_error_displays;
+static XErrorHandler x_previous_handler = nullptr;
+static bool x_error_installed = false;
+
+/**
+ * trap_x_error - 忽略监视器连接上的X11错误
+ *
+ * 新窗口可能在检查属性之前就被销毁，BadWindow不应终止进程。
+ * 其他连接（例如GTK的连接）上的错误交给原来的处理函数。
+ */
+static int trap_x_error(Display *display, XErrorEvent *event)
+{
+	XErrorHandler previous;
+	{
+		std::lock_guard<std::mutex> lock(x_error_mutex);
+		if (std::find(x_error_displays.begin(), x_error_displays.end(),
+			      display) != x_error_displays.end())
+			return 0;
+		previous = x_previous_handler;
+	}
+
+	return previous ? previous(display, event) : 0;
+}
+
+/**
+ * register_x_error_display - 登记监视器的显示连接
+ *
+ * 错误处理函数是进程全局的，只在第一次登记时安装一次，之后不再
+ * 恢复：并发的监视器各自保存、恢复会互相覆盖，恢复时也可能覆盖
+ * 别处之后安装的处理函数。未登记的连接上的错误照常转交。
+ */
+static void register_x_error_display(Display *display)
+{
+	std::lock_guard<std::mutex> lock(x_error_mutex);
+	if (!x_error_installed) {
+		x_previous_handler = XSetErrorHandler(trap_x_error);
+		x_error_installed = true;
+	}
+	x_error_displays.push_back(display);
+}
+
+/**
+ * unregister_x_error_display - 注销监视器的显示连接
+ */
+static void unregister_x_error_display(Display *display)
+{
+	std::lock_guard<std::mutex> lock(x_error_mutex);
+	auto it = std::find(x_error_displays.begin(), x_error_displays.end(),
+			    display);
+	if (it != x_error_displays.end())
+		x_error_displays.erase(it);
+}
+
+/**
+ * X11Watch - 订阅根窗口的子窗口创建事件
+ *
+ * 必须在启动进程之前创建，这样进程的顶层窗口（重设父窗口之前
+ * 都是根窗口的子窗口）一定会产生CreateNotify。_NET_WM_PID通常在
+ * 窗口创建后才设置，所以对每个新窗口再订阅PropertyNotify。监视器
+ * 使用自己的显示连接，连接上的错误在监视期间被忽略。
+ */
+class X11Watch {
+public:
+	X11Watch() : display(XOpenDisplay(nullptr)), net_wm_pid(None)
+	{
+		if (!display)
+			return;
+
+		register_x_error_display(display);
+		net_wm_pid = XInternAtom(display, "_NET_WM_PID", False);
+		XSelectInput(display, DefaultRootWindow(display),
+			     SubstructureNotifyMask);
+		XFlush(display);
+	}
+
+	~X11Watch()
+	{
+		if (!display)
+			return;
+
+		/* 关闭时会同步连接，之后才注销 */
+		XCloseDisplay(display);
+		unregister_x_error_display(display);
+	}
+
+	X11Watch(const X11Watch &) = delete;
+	X11Watch &operator=(const X11Watch &) = delete;
+
+	/**
+	 * fd - X11连接的文件描述符，用于poll()
+	 *
+	 * @return int: 文件描述符，没有X11显示时返回-1
+	 */
+	int fd() const { return display ? ConnectionNumber(display) : -1; }
+
+	/**
+	 * process_events - 处理已到达的事件
+	 *
+	 * @param pid: 被检测的进程ID
+	 * @return bool: 出现属于该进程的窗口返回true
+	 */
+	bool process_events(pid_t pid)
+	{
+		if (!display)
+			return false;
+
+		while (XPending(display) > 0) {
+			XEvent event;
+			XNextEvent(display, &event);
+
+			if (event.type == CreateNotify) {
+				Window window = event.xcreatewindow.window;
+				XSelectInput(display, window, PropertyChangeMask);
+				if (window_pid_is(window, pid))
+					return true;
+			} else if (event.type == PropertyNotify &&
+				   event.xproperty.atom == net_wm_pid &&
+				   event.xproperty.state == PropertyNewValue) {
+				if (window_pid_is(event.xproperty.window, pid))
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	Display *display;
+	Atom net_wm_pid;
+
+	/**
+	 * window_pid_is - 检查窗口的_NET_WM_PID属性
+	 */
+	bool window_pid_is(Window window, pid_t pid)
+	{
+		Atom type;
+		int format;
+		unsigned long nitems, bytes_after;
+		unsigned char *prop = nullptr;
+		bool match = false;
+
+		if (XGetWindowProperty(display, window, net_wm_pid, 0, 1, False,
+				       XA_CARDINAL, &type, &format, &nitems,
+				       &bytes_after, &prop) == Success &&
+		    prop && type == XA_CARDINAL && nitems == 1)
+			match = *(unsigned long *)prop == (unsigned long)pid;
+
+		if (prop)
+			XFree(prop);
+		return match;
+	}
+};
+#else
+/**
+ * X11Watch - 没有X11支持时的空实现，只依靠显示服务器连接检测
+ */
+class X11Watch {
+public:
+	int fd() const { return -1; }
+	bool process_events(pid_t pid) { (void)pid; return false; }
+};
+#endif
+
 /*
  * ============================================================================
  * ProcessLauncher::Impl 内部实现类
@@ -79,123 +525,84 @@ struct ProcessLauncher::Impl {
 	}
 
 	/**
-	 * detect_x11_window - 检测X11窗口创建
+	 * record_verdict - 记录可执行文件的检测结果
 	 *
-	 * @param pid: 进程ID
-	 * @return bool: 是否检测到X11窗口
+	 * @param executable: 可执行文件路径
+	 * @param identity: 启动时的文件标识
+	 * @param type: 检测结果
 	 */
-	bool detect_x11_window(pid_t pid)
+	static void record_verdict(const std::string &executable,
+				   const std::optional<FileIdentity> &identity,
+				   ProcessType type)
 	{
-#ifdef HAVE_X11
-		Display *display = XOpenDisplay(nullptr);
-		if (!display)
-			return false;
-
-		Window root = DefaultRootWindow(display);
-		Atom net_wm_pid = XInternAtom(display, "_NET_WM_PID", True);
-
-		if (net_wm_pid == None) {
-			XCloseDisplay(display);
-			return false;
-		}
-
-		/* 使用迭代方式枚举窗口树，限制深度为3层 */
-		std::vector<std::pair<Window, int>> window_stack;
-		window_stack.push_back({root, 0});
-
-		while (!window_stack.empty()) {
-			auto [win, depth] = window_stack.back();
-			window_stack.pop_back();
+		if (!identity)
+			return;
 
-			/* 限制枚举深度，避免遍历整个窗口树 */
-			if (depth > 3)
-				continue;
-
-			/* 检查当前窗口的 PID */
-			Atom type;
-			int format;
-			unsigned long nitems, bytes_after;
-			unsigned char *prop = nullptr;
-
-			if (XGetWindowProperty(display, win, net_wm_pid, 0, 1,
-					       False, XA_CARDINAL, &type, &format,
-					       &nitems, &bytes_after, &prop) ==
-			    Success) {
-				if (prop && type == XA_CARDINAL && nitems == 1) {
-					unsigned long *pid_ptr = (unsigned long *)prop;
-					if (*pid_ptr == (unsigned long)pid) {
-						XFree(prop);
-						XCloseDisplay(display);
-						return true;
-					}
-				}
-				if (prop)
-					XFree(prop);
-			}
-
-			/* 添加子窗口到栈，增加深度计数 */
-			Window parent, *children = nullptr;
-			unsigned int nchildren;
-
-			if (XQueryTree(display, win, &root, &parent,
-				       &children, &nchildren)) {
-				/* 限制每层最多检查20个子窗口 */
-				unsigned int max_children = std::min(nchildren, 20u);
-				for (unsigned int i = 0; i < max_children; i++) {
-					window_stack.push_back({children[i], depth + 1});
-				}
-				if (children)
-					XFree(children);
-			}
-		}
-
-		XCloseDisplay(display);
-		return false;
-#else
-		(void)pid;
-		return false;
-#endif
+		std::lock_guard<std::mutex> lock(verdict_mutex);
+		verdict_cache[executable] = CachedVerdict{*identity, type};
 	}
 
 	/**
-	 * detect_wayland_connection - 检测Wayland连接
+	 * detect_gui - 等待进程打开窗口、连接显示服务器或退出
 	 *
-	 * @param pid: 进程ID
-	 * @return bool: 是否检测到Wayland连接
+	 * 同时poll() pidfd（进程退出时可读）和X11连接（有新窗口事件时
+	 * 可读），每DETECTION_PROBE_INTERVAL_MS检查一次显示服务器连接。
+	 *
+	 * @param pid: 子进程ID
+	 * @param x11: 启动前创建的X11窗口监视器
+	 * @param decisive: 输出参数，检测到GUI或进程已退出时为true，
+	 *                  超时时为false（进程可能只是启动得慢）
+	 * @return ProcessType: 检测到窗口或连接返回GUI，进程退出或超时
+	 *         返回CLI
 	 */
-	bool detect_wayland_connection(pid_t pid)
+	ProcessType detect_gui(pid_t pid, X11Watch &x11, bool &decisive)
 	{
-		std::string fd_path = std::format("/proc/{}/fd", pid);
-
-		DIR *dir = opendir(fd_path.c_str());
-		if (!dir)
-			return false;
+		const auto deadline = std::chrono::steady_clock::now() +
+				      std::chrono::milliseconds(detection_timeout_ms);
+		int pidfd = open_pidfd(pid);
+		DisplayProbe probe(pid);
+		ProcessType type = ProcessType::CLI;
 
-		struct dirent *entry;
-		bool has_wayland = false;
+		decisive = true;
+		while (true) {
+			/* 进程已退出，说明是CLI程序（快速退出）；不回收，由调用者处理 */
+			siginfo_t info;
+			memset(&info, 0, sizeof(info));
+			if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0 ||
+			    info.si_pid == pid)
+				break;
+
+			if (x11.process_events(pid)) {
+				type = ProcessType::GUI;
+				break;
+			}
 
-		while ((entry = readdir(dir)) != nullptr) {
-			if (entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN)
-				continue;
+			if (probe.connected()) {
+				type = ProcessType::GUI;
+				break;
+			}
 
-			std::string link_path =
-				std::format("{}/{}", fd_path, entry->d_name);
-			char target[256] = {0};
-			ssize_t len = readlink(link_path.c_str(), target,
-					       sizeof(target) - 1);
-
-			if (len > 0) {
-				std::string target_str(target, len);
-				if (target_str.find("wayland-0") != std::string::npos ||
-				    target_str.find("wl_display") != std::string::npos) {
-					has_wayland = true;
-					break;
-				}
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+						deadline - std::chrono::steady_clock::now())
+						.count();
+			if (remaining <= 0) {
+				decisive = false;
+				break;
 			}
+
+			struct pollfd fds[2];
+			nfds_t count = 0;
+			if (pidfd >= 0)
+				fds[count++] = {pidfd, POLLIN, 0};
+			if (x11.fd() >= 0)
+				fds[count++] = {x11.fd(), POLLIN, 0};
+			poll(fds, count, std::min<long long>(remaining,
+							     DETECTION_PROBE_INTERVAL_MS));
 		}
 
-		closedir(dir);
-		return has_wayland;
+		if (pidfd >= 0)
+			close(pidfd);
+		return type;
 	}
 
 	/**
@@ -325,6 +732,8 @@ struct ProcessLauncher::Impl {
 							  uint32_t timeout_ms)
 	{
 		auto start_time = std::chrono::steady_clock::now();
+		int pidfd = open_pidfd(pid);
+		std::expected<int, std::string> exit_code;
 
 		while (true) {
 			int status;
@@ -333,25 +742,57 @@ struct ProcessLauncher::Impl {
 			if (result > 0) {
 				/* 进程已结束 */
 				if (WIFEXITED(status))
-					return WEXITSTATUS(status);
-				if (WIFSIGNALED(status))
-					return 128 + WTERMSIG(status);
-				return -1;
+					exit_code = WEXITSTATUS(status);
+				else if (WIFSIGNALED(status))
+					exit_code = 128 + WTERMSIG(status);
+				else
+					exit_code = -1;
+				break;
 			}
 
-			if (result == -1 && errno == ECHILD)
-				return -1;
+			if (result == -1 && errno == ECHILD) {
+				exit_code = -1;
+				break;
+			}
 
 			/* 检查超时 */
 			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
 					       std::chrono::steady_clock::now() -
 					       start_time)
 					       .count();
-			if (elapsed >= timeout_ms)
-				return std::unexpected("Timeout waiting for process");
+			if (elapsed >= timeout_ms) {
+				exit_code = std::unexpected("Timeout waiting for process");
+				break;
+			}
 
-			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			/* pidfd在进程退出时可读；内核不支持时退回短暂休眠 */
+			if (pidfd >= 0) {
+				struct pollfd pfd = {pidfd, POLLIN, 0};
+				poll(&pfd, 1, static_cast<int>(timeout_ms - elapsed));
+			} else {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
 		}
+
+		if (pidfd >= 0)
+			close(pidfd);
+		return exit_code;
+	}
+
+	/**
+	 * terminate - 终止进程并回收
+	 *
+	 * @param pid: 进程ID
+	 * @param grace_ms: SIGTERM后等待的时间（毫秒）
+	 */
+	void terminate(pid_t pid, uint32_t grace_ms)
+	{
+		kill(pid, SIGTERM);
+		if (wait_for_process(pid, grace_ms))
+			return;
+
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
 	}
 };
 
@@ -404,9 +845,19 @@ std::expected<LaunchResult, std::string> ProcessLauncher::launch_with_detection(
 	const std::vector<std::string> &args,
 	const std::string &working_dir)
 {
+	/* 之前检测过且文件未变化：直接按上次的结果启动 */
+	std::optional<ProcessType> cached = cached_type(executable);
+	if (cached == ProcessType::GUI)
+		return spawn_gui_direct(executable, args, working_dir);
+	if (cached == ProcessType::CLI)
+		return spawn_cli_in_pty(executable, args, working_dir);
+
 	LaunchResult result;
+	const std::optional<FileIdentity> identity = file_identity(executable);
+
+	/* 步骤1: 订阅窗口创建事件后在PTY中启动进程进行检测 */
+	X11Watch x11;
 
-	/* 步骤1: 在PTY中启动进程进行检测 */
 	int pty_fd;
 	auto detection_pid = pImpl_->spawn_in_pty(executable, args, working_dir,
 						  &pty_fd);
@@ -417,61 +868,18 @@ std::expected<LaunchResult, std::string> ProcessLauncher::launch_with_detection(
 	result.pid = *detection_pid;
 	result.pty_fd = pty_fd;
 
-	auto start_time = std::chrono::steady_clock::now();
-	bool is_gui = false;
-
-	/* 步骤2: 在超时时间内检测窗口创建 */
-	while (true) {
-		/* 检查进程是否已退出 */
-		int status;
-		pid_t wait_result = waitpid(result.pid, &status, WNOHANG);
-
-		if (wait_result == result.pid) {
-			/* 进程已退出，说明是CLI程序（快速退出） */
-			result.type = ProcessType::CLI;
-			result.success = true;
-			return result;
-		}
-
-		if (wait_result == -1 && errno == ECHILD) {
-			result.type = ProcessType::CLI;
-			result.success = true;
-			return result;
-		}
-
-		/* 检测X11窗口 */
-		if (pImpl_->detect_x11_window(result.pid)) {
-			is_gui = true;
-			break;
-		}
-
-		/* 检测Wayland连接 */
-		if (pImpl_->detect_wayland_connection(result.pid)) {
-			is_gui = true;
-			break;
-		}
-
-		/* 检查超时 */
-		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-				       std::chrono::steady_clock::now() -
-				       start_time)
-				       .count();
-		if (elapsed >= pImpl_->detection_timeout_ms)
-			break;
-
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
-	}
+	/* 步骤2: 在超时时间内等待窗口创建、显示服务器连接或进程退出 */
+	bool decisive;
+	const ProcessType type = pImpl_->detect_gui(result.pid, x11, decisive);
+	if (decisive)
+		Impl::record_verdict(executable, identity, type);
 
 	/* 步骤3: 根据检测结果处理 */
-	if (is_gui) {
+	if (type == ProcessType::GUI) {
 		/* GUI程序：终止PTY进程，重新用fork+execve启动 */
 		close(result.pty_fd);
 		result.pty_fd = -1;
-
-		kill(result.pid, SIGTERM);
-		pImpl_->wait_for_process(result.pid, 1000);
-		kill(result.pid, SIGKILL);
-		waitpid(result.pid, nullptr, WNOHANG);
+		pImpl_->terminate(result.pid, 1000);
 
 		/* 重新启动GUI程序（无PTY） */
 		auto gui_pid = pImpl_->spawn_direct(executable, args, working_dir);
@@ -508,6 +916,32 @@ uint32_t ProcessLauncher::get_detection_timeout() const
 	return pImpl_->detection_timeout_ms;
 }
 
+/**
+ * ProcessLauncher::cached_type - 查询可执行文件之前的检测结果
+ */
+std::optional<ProcessType> ProcessLauncher::cached_type(
+	const std::string &executable)
+{
+	const std::optional<FileIdentity> identity = file_identity(executable);
+	if (!identity)
+		return std::nullopt;
+
+	std::lock_guard<std::mutex> lock(verdict_mutex);
+	auto it = verdict_cache.find(executable);
+	if (it == verdict_cache.end() || !(it->second.identity == *identity))
+		return std::nullopt;
+
+	return it->second.type;
+}
+
+/**
+ * ProcessLauncher::terminate_process - 终止子进程并回收
+ */
+void ProcessLauncher::terminate_process(pid_t pid, uint32_t grace_ms)
+{
+	pImpl_->terminate(pid, grace_ms);
+}
+
 /**
  * ProcessLauncher::spawn_cli_in_pty - 直接在PTY中启动CLI程序
  */
@@ -0,0 +1,341 @@
+/*
+ * Mikufy v2.11-nova - 终端回滚缓冲区实现
+ *
+ * 本文件实现了ScrollbackPagePool类和Scrollback类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/scrollback.h"
+#include "../headers/metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* 因超出保留上限被丢弃的历史输出（已被消费，不影响推送） */
+static MetricCounter &evicted_bytes = Metrics::instance().counter(
+	"mikufy_terminal_scrollback_evicted_bytes_total",
+	"终端回滚缓冲区超出上限后丢弃的历史输出字节数");
+
+/*
+ * ============================================================================
+ * ScrollbackPagePool实现
+ * ============================================================================
+ */
+
+/**
+ * ScrollbackPagePool::instance - 获取全局页池
+ */
+ScrollbackPagePool &ScrollbackPagePool::instance(void)
+{
+	static ScrollbackPagePool *pool = new ScrollbackPagePool();
+	return *pool;
+}
+
+/**
+ * ScrollbackPagePool::acquire - 取一页
+ */
+char *ScrollbackPagePool::acquire(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!free_pages.empty()) {
+			char *page = free_pages.back();
+			free_pages.pop_back();
+			return page;
+		}
+	}
+
+	return new char[SCROLLBACK_PAGE_SIZE];
+}
+
+/**
+ * ScrollbackPagePool::release - 归还一页
+ * @page: acquire()返回的页
+ */
+void ScrollbackPagePool::release(char *page)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (free_pages.size() < SCROLLBACK_POOL_MAX_FREE) {
+			free_pages.push_back(page);
+			return;
+		}
+	}
+
+	delete[] page;
+}
+
+/*
+ * ============================================================================
+ * Scrollback实现
+ * ============================================================================
+ */
+
+/**
+ * Scrollback::Scrollback - 构造函数
+ * @memory_limit: 内存中最多保留的字节数
+ * @spill_limit: 换出文件最多保留的字节数，0表示不换出
+ *
+ * 不预先分配任何页，没有输出的进程不占用缓冲区内存。
+ */
+Scrollback::Scrollback(size_t memory_limit, size_t spill_limit)
+	: mem_seq(0), base_seq(0), spill_fd(-1), spill_failed(false),
+	  memory_limit(std::max<size_t>(memory_limit, SCROLLBACK_PAGE_SIZE)),
+	  spill_limit(spill_limit == 0 ? 0 :
+		      std::max<size_t>(spill_limit, SCROLLBACK_PAGE_SIZE)),
+	  write_page(nullptr), write_offset(0), head(0), consumed(0)
+{
+}
+
+/**
+ * Scrollback::~Scrollback - 析构函数
+ */
+Scrollback::~Scrollback(void)
+{
+	ScrollbackPagePool &pool = ScrollbackPagePool::instance();
+
+	for (char *page : pages)
+		pool.release(page);
+
+	if (spill_fd >= 0)
+		close(spill_fd);
+}
+
+/**
+ * Scrollback::write_span - 获取当前页的空闲区域（生产者）
+ *
+ * 只有换页时才加锁，同一页内的连续写入不需要同步。
+ */
+std::span<char> Scrollback::write_span(void)
+{
+	if (write_page && write_offset < SCROLLBACK_PAGE_SIZE)
+		return { write_page + write_offset,
+			 SCROLLBACK_PAGE_SIZE - write_offset };
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!make_room_locked())
+		return {};
+
+	write_page = ScrollbackPagePool::instance().acquire();
+	write_offset = 0;
+	pages.push_back(write_page);
+
+	return { write_page, SCROLLBACK_PAGE_SIZE };
+}
+
+/**
+ * Scrollback::commit_write - 提交写入的数据（生产者）
+ * @size: 写入write_span()区域的字节数
+ *
+ * release保证读取方看到新的head时也能看到页内的数据。
+ */
+void Scrollback::commit_write(size_t size)
+{
+	write_offset += size;
+	head.store(head.load(std::memory_order_relaxed) + size,
+		   std::memory_order_release);
+}
+
+/**
+ * Scrollback::make_room_locked - 为新页腾出空间（调用者持有锁）
+ *
+ * 内存页已达上限时处理最早的一页：开启换出时写入换出文件，否则
+ * 在它已被消费后丢弃。最早的页还没被消费且无法换出时返回false。
+ */
+bool Scrollback::make_room_locked(void)
+{
+	const size_t max_pages = memory_limit / SCROLLBACK_PAGE_SIZE;
+
+	while (pages.size() >= max_pages) {
+		if (spill_limit > 0 && !spill_failed && spill_front_locked())
+			continue;
+
+		if (mem_seq + SCROLLBACK_PAGE_SIZE >
+		    consumed.load(std::memory_order_acquire))
+			return false;
+
+		drop_front_locked();
+	}
+
+	return true;
+}
+
+/**
+ * Scrollback::spill_front_locked - 把最早的一页写入换出文件
+ *
+ * 换出文件以序号为偏移写入，超过spill_limit的最早部分用
+ * FALLOC_FL_PUNCH_HOLE释放磁盘空间，文件始终是稀疏的。
+ * 换出文件中的数据也只有被消费后才能丢弃。
+ *
+ * 返回: 成功返回true；换出文件已满或不可用返回false
+ */
+bool Scrollback::spill_front_locked(void)
+{
+	if (spill_fd < 0) {
+		spill_fd = open(SCROLLBACK_SPILL_DIR,
+				O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+		if (spill_fd < 0) {
+			spill_failed = true;
+			return false;
+		}
+	}
+
+	uint64_t spill_end = mem_seq + SCROLLBACK_PAGE_SIZE;
+	if (spill_end - base_seq > spill_limit) {
+		uint64_t new_base = spill_end - spill_limit;
+		if (new_base > consumed.load(std::memory_order_acquire))
+			return false;
+
+		fallocate(spill_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			  static_cast<off_t>(base_seq),
+			  static_cast<off_t>(new_base - base_seq));
+		evicted_bytes.add(new_base - base_seq);
+		base_seq = new_base;
+	}
+
+	char *page = pages.front();
+	size_t written = 0;
+
+	while (written < SCROLLBACK_PAGE_SIZE) {
+		ssize_t ret = pwrite(spill_fd, page + written,
+				     SCROLLBACK_PAGE_SIZE - written,
+				     static_cast<off_t>(mem_seq + written));
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			spill_failed = true;
+			return false;
+		}
+		written += ret;
+	}
+
+	ScrollbackPagePool::instance().release(page);
+	pages.pop_front();
+	mem_seq += SCROLLBACK_PAGE_SIZE;
+
+	return true;
+}
+
+/**
+ * Scrollback::drop_front_locked - 丢弃最早的一页
+ *
+ * 换出文件中更早的数据随之失效，保证保留范围始终连续。
+ */
+void Scrollback::drop_front_locked(void)
+{
+	evicted_bytes.add(SCROLLBACK_PAGE_SIZE + (mem_seq - base_seq));
+	ScrollbackPagePool::instance().release(pages.front());
+	pages.pop_front();
+	mem_seq += SCROLLBACK_PAGE_SIZE;
+	base_seq = mem_seq;
+}
+
+/**
+ * Scrollback::read_from - 从指定序号开始读取
+ * @seq: 起始序号
+ * @max_bytes: 最多读取的字节数
+ * @visitor: 读取回调
+ *
+ * 比已写入位置更靠后的序号（例如来自同pid的旧进程）按已写入位置处理。
+ *
+ * 返回: 读到的最后一个字节之后的序号
+ */
+uint64_t Scrollback::read_from(uint64_t seq, size_t max_bytes,
+			       const SeqVisitor &visitor)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const uint64_t end = head.load(std::memory_order_acquire);
+	seq = std::clamp(seq, base_seq, end);
+
+	size_t total = 0;
+	while (total < max_bytes && seq < end) {
+		size_t want = static_cast<size_t>(
+			std::min<uint64_t>(max_bytes - total, end - seq));
+
+		if (seq < mem_seq) {
+			/* 已换出到磁盘的部分 */
+			want = static_cast<size_t>(std::min<uint64_t>(
+				{ want, mem_seq - seq, SCROLLBACK_PAGE_SIZE }));
+			spill_scratch.resize(SCROLLBACK_PAGE_SIZE);
+
+			ssize_t ret = pread(spill_fd, spill_scratch.data(), want,
+					    static_cast<off_t>(seq));
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret <= 0)
+				break;
+
+			visitor(seq, std::string_view(spill_scratch.data(), ret));
+			seq += ret;
+			total += ret;
+			continue;
+		}
+
+		uint64_t rel = seq - mem_seq;
+		size_t index = static_cast<size_t>(rel / SCROLLBACK_PAGE_SIZE);
+		size_t offset = static_cast<size_t>(rel % SCROLLBACK_PAGE_SIZE);
+		want = std::min(want, SCROLLBACK_PAGE_SIZE - offset);
+
+		visitor(seq, std::string_view(pages[index] + offset, want));
+		seq += want;
+		total += want;
+	}
+
+	return seq;
+}
+
+/**
+ * Scrollback::advance - 前移消费位置
+ * @seq: 新的消费位置，不会超过已写入位置
+ */
+void Scrollback::advance(uint64_t seq)
+{
+	seq = std::min(seq, head.load(std::memory_order_acquire));
+
+	uint64_t current = consumed.load(std::memory_order_relaxed);
+	while (current < seq &&
+	       !consumed.compare_exchange_weak(current, seq,
+					       std::memory_order_release,
+					       std::memory_order_relaxed))
+		;
+}
+
+/**
+ * Scrollback::first_seq - 最早仍可读取的序号
+ */
+uint64_t Scrollback::first_seq(void)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return base_seq;
+}
+
+/**
+ * Scrollback::end_seq - 已写入的总字节数
+ */
+uint64_t Scrollback::end_seq(void) const
+{
+	return head.load(std::memory_order_acquire);
+}
+
+/**
+ * Scrollback::consumed_seq - 当前消费位置
+ */
+uint64_t Scrollback::consumed_seq(void) const
+{
+	return consumed.load(std::memory_order_acquire);
+}
+
+/**
+ * Scrollback::unconsumed - 消费位置之后尚未读取的字节数
+ */
+size_t Scrollback::unconsumed(void) const
+{
+	uint64_t consumed_now = consumed.load(std::memory_order_acquire);
+	return static_cast<size_t>(end_seq() - consumed_now);
+}
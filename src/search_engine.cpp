@@ -0,0 +1,818 @@
+/*
+ * Mikufy v2.11-nova - 全文搜索实现
+ *
+ * 本文件实现了SearchPattern和SearchJob类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/search_engine.h"
+#include <algorithm>		/* std::min */
+#include <cerrno>		/* errno */
+#include <cstring>		/* memmem(), memchr(), memrchr() */
+#include <dirent.h>		/* opendir(), readdir() */
+#include <fcntl.h>		/* open() */
+#include <sys/mman.h>		/* mmap(), madvise() */
+#include <sys/stat.h>		/* fstat(), lstat() */
+#include <unistd.h>		/* read(), close() */
+#include <re2/re2.h>		/* RE2 */
+
+/**
+ * ascii_lower - ASCII字母转为小写，其他字节不变
+ */
+static inline char ascii_lower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/**
+ * is_word_char - 是否是单词字符（字母、数字、下划线和非ASCII字节）
+ */
+static inline bool is_word_char(char c)
+{
+	const unsigned char uc = static_cast<unsigned char>(c);
+	return (uc >= '0' && uc <= '9') || (uc >= 'a' && uc <= 'z') ||
+	       (uc >= 'A' && uc <= 'Z') || uc == '_' || uc >= 0x80;
+}
+
+/**
+ * find_byte - memchr()，没有找到时返回end
+ */
+static inline const char *find_byte(const char *begin, const char *end, char c)
+{
+	const void *hit = memchr(begin, c, end - begin);
+	return hit ? static_cast<const char *>(hit) : end;
+}
+
+/**
+ * count_line_feeds - 统计文本中的换行符
+ */
+static size_t count_line_feeds(std::string_view text)
+{
+	const char *p = text.data();
+	const char *end = p + text.size();
+	size_t count = 0;
+
+	while ((p = find_byte(p, end, '\n')) != end) {
+		count++;
+		p++;
+	}
+	return count;
+}
+
+/**
+ * add_match - 追加一处匹配并截取预览
+ * @line: 匹配所在行（不含换行符）
+ *
+ * 行不超过SEARCH_PREVIEW_MAX时预览即整行；否则从匹配之前
+ * SEARCH_PREVIEW_CONTEXT字节处截取，两端对齐到UTF-8字符边界。
+ */
+static void add_match(std::vector<SearchMatch> &matches, std::string_view line,
+		      size_t line_number, size_t column, size_t length,
+		      uint64_t offset)
+{
+	if (!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+
+	size_t start = 0;
+	if (line.size() > SEARCH_PREVIEW_MAX && column > SEARCH_PREVIEW_CONTEXT) {
+		start = std::min<size_t>(column - SEARCH_PREVIEW_CONTEXT,
+					 line.size() - SEARCH_PREVIEW_MAX);
+		while (start > 0 && (line[start] & 0xc0) == 0x80)
+			start--;
+	}
+
+	size_t count = std::min<size_t>(line.size() - start, SEARCH_PREVIEW_MAX);
+	while (start + count < line.size() && count > 0 &&
+	       (line[start + count] & 0xc0) == 0x80)
+		count--;
+
+	SearchMatch &match = matches.emplace_back();
+	match.line = line_number;
+	match.column = column;
+	match.length = length;
+	match.offset = offset;
+	match.preview.assign(line.substr(start, count));
+	match.preview_column = column - start;
+}
+
+/*
+ * ============================================================================
+ * SearchPattern
+ * ============================================================================
+ */
+
+/**
+ * SearchPattern::compile - 编译搜索模式
+ * @options: 搜索参数
+ */
+std::expected<SearchPattern, std::string>
+SearchPattern::compile(const SearchOptions &options)
+{
+	if (options.pattern.empty())
+		return std::unexpected(std::string("搜索内容为空"));
+	if (options.pattern.find('\n') != std::string::npos)
+		return std::unexpected(std::string("搜索内容不能包含换行符"));
+
+	SearchPattern result;
+	result.options = options;
+	if (result.options.max_results == 0)
+		result.options.max_results = SEARCH_DEFAULT_MAX_RESULTS;
+
+	if (options.regex) {
+		/*
+		 * (?m)使^和$匹配行首和行尾，整块定位候选行和行内匹配使用
+		 * 同一个RE2；.默认不匹配换行符
+		 */
+		RE2::Options re_options;
+		re_options.set_case_sensitive(options.case_sensitive);
+		re_options.set_log_errors(false);
+
+		auto compiled = std::make_shared<const RE2>("(?m)" + options.pattern,
+							    re_options);
+		if (!compiled->ok()) {
+			/* 错误信息中的模式片段可能带有加上的(?m) */
+			std::string error = compiled->error();
+			const size_t prefix = error.find(": (?m)");
+			if (prefix != std::string::npos)
+				error.erase(prefix + 2, 4);
+			return std::unexpected(std::format("正则表达式无效: {}",
+							   error));
+		}
+		result.regex = std::move(compiled);
+
+		/* \A和\z在整块中只匹配块的两端，整块定位会漏掉候选行 */
+		result.regex_prefilter =
+			options.pattern.find("\\A") == std::string::npos &&
+			options.pattern.find("\\z") == std::string::npos;
+	} else if (!options.case_sensitive) {
+		result.folded = options.pattern;
+		for (char &c : result.folded)
+			c = ascii_lower(c);
+	}
+
+	return result;
+}
+
+/**
+ * SearchPattern::find_literal - 查找字面量的下一次出现
+ *
+ * 区分大小写时直接用memmem()。不区分大小写时首字符的大小写两种
+ * 形式各用memchr()找下一次出现，取较近的一个比较其余字节；两个
+ * 候选位置分别缓存，只重新查找被越过的那一个。
+ */
+const char *SearchPattern::find_literal(const char *begin,
+					const char *end) const
+{
+	const size_t length = options.pattern.size();
+	if (static_cast<size_t>(end - begin) < length)
+		return nullptr;
+
+	if (options.case_sensitive)
+		return static_cast<const char *>(memmem(begin, end - begin,
+						options.pattern.data(), length));
+
+	const char lower = folded[0];
+	const char upper = (lower >= 'a' && lower <= 'z') ?
+			   static_cast<char>(lower - ('a' - 'A')) : lower;
+	const char *last = end - length + 1;	/* 匹配起始位置的上界（不含） */
+	const char *next_lower = nullptr;
+	const char *next_upper = (upper == lower) ? last : nullptr;
+
+	for (const char *from = begin; from < last;) {
+		if (!next_lower || next_lower < from)
+			next_lower = find_byte(from, last, lower);
+		if (!next_upper || next_upper < from)
+			next_upper = find_byte(from, last, upper);
+
+		const char *candidate = std::min(next_lower, next_upper);
+		if (candidate == last)
+			return nullptr;
+
+		size_t i = 1;
+		while (i < length && ascii_lower(candidate[i]) == folded[i])
+			i++;
+		if (i == length)
+			return candidate;
+
+		from = candidate + 1;
+	}
+
+	return nullptr;
+}
+
+/**
+ * SearchPattern::is_word_boundary - 检查[begin, end)两侧是否不是单词字符
+ */
+bool SearchPattern::is_word_boundary(std::string_view line, size_t begin,
+				     size_t end) const
+{
+	if (begin > 0 && is_word_char(line[begin - 1]))
+		return false;
+	if (end < line.size() && is_word_char(line[end]))
+		return false;
+	return true;
+}
+
+/**
+ * SearchPattern::scan - 在由完整行组成的文本块中查找
+ */
+size_t SearchPattern::scan(std::string_view block, size_t first_line,
+			   uint64_t base_offset,
+			   std::vector<SearchMatch> &matches, size_t limit) const
+{
+	if (matches.size() >= limit)
+		return 0;
+
+	return regex ? scan_regex(block, first_line, base_offset, matches, limit) :
+		       scan_literal(block, first_line, base_offset, matches, limit);
+}
+
+/**
+ * SearchPattern::scan_literal - 字面量查找
+ *
+ * 直接在整个文本块中查找，只在找到匹配时才统计上一个匹配到这里
+ * 之间的换行符，没有匹配的区域只被memmem()/memchr()扫描一次。
+ */
+size_t SearchPattern::scan_literal(std::string_view block, size_t first_line,
+				   uint64_t base_offset,
+				   std::vector<SearchMatch> &matches,
+				   size_t limit) const
+{
+	const char *begin = block.data();
+	const char *end = begin + block.size();
+	const char *counted = begin;	/* 换行符已统计到此处 */
+	const char *line_begin = begin;
+	const char *from = begin;
+	size_t line = first_line;
+	size_t found = 0;
+
+	while (matches.size() < limit) {
+		const char *hit = find_literal(from, end);
+		if (!hit)
+			break;
+
+		const char *feed;
+		while ((feed = find_byte(counted, hit, '\n')) != hit) {
+			line++;
+			line_begin = feed + 1;
+			counted = feed + 1;
+		}
+		counted = hit;
+
+		const char *line_end = find_byte(hit, end, '\n');
+		const std::string_view line_view(line_begin, line_end - line_begin);
+		const size_t column = hit - line_begin;
+		const size_t length = options.pattern.size();
+
+		if (options.whole_word &&
+		    !is_word_boundary(line_view, column, column + length)) {
+			from = hit + 1;
+			continue;
+		}
+
+		add_match(matches, line_view, line, column, length,
+			  base_offset + (hit - begin));
+		found++;
+		from = hit + length;
+	}
+
+	return found;
+}
+
+/**
+ * SearchPattern::scan_regex - 正则表达式查找
+ *
+ * RE2用自动机匹配，耗时与文本长度成线性，不会因为很长的行耗尽
+ * 线程栈；模式有字面量前缀时用memchr()跳到候选位置。先在整个
+ * 文本块中查找，跳过没有匹配的行（只统计换行符），再在候选行内
+ * 从上一次匹配之后继续查找，匹配结果以行内查找为准。空匹配之后
+ * 前进一个字节，避免停在原地。与grep相同，末尾换行符之后的空串
+ * 不算一行（空文本块除外）。
+ */
+size_t SearchPattern::scan_regex(std::string_view block, size_t first_line,
+				 uint64_t base_offset,
+				 std::vector<SearchMatch> &matches,
+				 size_t limit) const
+{
+	const char *begin = block.data();
+	const char *end = begin + block.size();
+	const char *line_begin = begin;
+	size_t line = first_line;
+	size_t found = 0;
+	bool prefilter = regex_prefilter;
+
+	while (matches.size() < limit) {
+		if (prefilter) {
+			re2::StringPiece hit;
+			if (!regex->Match(block, line_begin - begin, block.size(),
+					  RE2::UNANCHORED, &hit, 1))
+				break;
+
+			const char *feed;
+			while ((feed = find_byte(line_begin, hit.data(), '\n')) !=
+			       hit.data()) {
+				line++;
+				line_begin = feed + 1;
+			}
+
+			/*
+			 * 跨行的整块匹配（例如\s匹配了换行符）不对应行内匹配，
+			 * 之后每次整块查找都可能扫描很远；剩余部分改为逐行查找
+			 */
+			const char *hit_end = hit.data() + hit.size();
+			if (find_byte(hit.data(), hit_end, '\n') != hit_end)
+				prefilter = false;
+		}
+
+		if (line_begin == end && line_begin != begin)
+			break;
+
+		const char *line_end = find_byte(line_begin, end, '\n');
+		const std::string_view line_view(line_begin, line_end - line_begin);
+		size_t from = 0;
+		re2::StringPiece match;
+
+		while (matches.size() < limit &&
+		       regex->Match(line_view, from, line_view.size(),
+				    RE2::UNANCHORED, &match, 1)) {
+			const size_t column = match.data() - line_begin;
+			const size_t length = match.size();
+
+			if (!options.whole_word ||
+			    is_word_boundary(line_view, column, column + length)) {
+				add_match(matches, line_view, line, column, length,
+					  base_offset + (line_begin - begin) + column);
+				found++;
+			}
+
+			from = column + (length ? length : 1);
+			if (from > line_view.size())
+				break;
+		}
+
+		if (line_end == end)
+			break;
+		line_begin = line_end + 1;
+		line++;
+	}
+
+	return found;
+}
+
+/**
+ * SearchPattern::search_buffer - 搜索TextBuffer的当前内容
+ *
+ * 每个Piece分成三段：第一个换行符之前的部分接在上一个Piece留下
+ * 的不完整行之后；最后一个换行符之后的部分留给下一个Piece；中间
+ * 的完整行直接在Piece中查找。
+ */
+size_t SearchPattern::search_buffer(TextBuffer &buffer,
+				    std::vector<SearchMatch> &matches,
+				    size_t limit,
+				    const std::atomic<bool> *cancel) const
+{
+	std::string carry;		/* 跨Piece的不完整行 */
+	uint64_t carry_offset = 0;
+	uint64_t offset = 0;
+	size_t line = 0;
+	size_t found = 0;
+
+	buffer.visit_chunks([&](std::string_view chunk) {
+		if (cancel && cancel->load(std::memory_order_relaxed))
+			return false;
+
+		const char *data = chunk.data();
+		const char *end = data + chunk.size();
+		const char *first_feed = find_byte(data, end, '\n');
+
+		if (first_feed == end) {
+			if (carry.empty())
+				carry_offset = offset;
+			carry.append(chunk);
+			offset += chunk.size();
+			return true;
+		}
+
+		size_t lines_from = 0;
+		if (!carry.empty()) {
+			carry.append(data, first_feed - data + 1);
+			found += scan(carry, line, carry_offset, matches, limit);
+			carry.clear();
+			line++;
+			lines_from = first_feed - data + 1;
+		}
+
+		const char *last_feed = static_cast<const char *>(
+			memrchr(data, '\n', chunk.size()));
+		const size_t lines_end = last_feed - data + 1;
+
+		if (lines_end > lines_from) {
+			const std::string_view lines = chunk.substr(lines_from,
+						lines_end - lines_from);
+			found += scan(lines, line, offset + lines_from, matches,
+				      limit);
+			line += count_line_feeds(lines);
+		}
+
+		carry.assign(chunk.substr(lines_end));
+		carry_offset = offset + lines_end;
+		offset += chunk.size();
+
+		return matches.size() < limit;
+	});
+
+	/* 没有换行符结尾的最后一行；与scan()一致，末尾换行符之后不算一行 */
+	if ((!carry.empty() || offset == 0) && matches.size() < limit &&
+	    !(cancel && cancel->load(std::memory_order_relaxed)))
+		found += scan(carry, line, carry_offset, matches, limit);
+
+	return found;
+}
+
+/*
+ * ============================================================================
+ * SearchJob
+ * ============================================================================
+ */
+
+/**
+ * SearchJob::SearchJob - 构造函数
+ */
+SearchJob::SearchJob(FileManager *file_manager, std::string root,
+		     SearchPattern pattern, BufferLookup lookup)
+	: file_manager(file_manager), root(std::move(root)),
+	  pattern(std::move(pattern)), lookup(std::move(lookup)),
+	  started(std::chrono::steady_clock::now()), active(0), workers(0),
+	  finished(false), cancelled(false), result_count(0), file_count(0),
+	  truncated(false)
+{
+}
+
+/**
+ * SearchJob::start - 开始搜索
+ * @pool: 执行搜索的线程池
+ * @ready: 就绪回调
+ *
+ * 每个工作任务持有本对象的引用，连接先关闭时搜索也能安全地结束。
+ * 一个任务都没有提交成功时返回false。
+ */
+bool SearchJob::start(ThreadPool &pool, ReadyCallback ready_callback)
+{
+	ready = std::move(ready_callback);
+
+	size_t count = std::min<size_t>(pool.size(), SEARCH_MAX_THREADS);
+	if (count == 0)
+		count = 1;
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		queue.push_back(WorkItem{ root, true });
+		workers = count;
+	}
+
+	size_t submitted = 0;
+	for (size_t i = 0; i < count; i++) {
+		auto self = shared_from_this();
+		if (pool.submit([self]() { self->worker(); }))
+			submitted++;
+		else
+			finish_worker(); /* 没有提交成功的任务由这里替它退出 */
+	}
+
+	return submitted > 0;
+}
+
+/**
+ * SearchJob::cancel - 取消搜索
+ */
+void SearchJob::cancel(void)
+{
+	cancelled = true;
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		queue.clear();
+	}
+	queue_cond.notify_all();
+
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		output.clear();
+	}
+	output_cond.notify_all();
+}
+
+/**
+ * SearchJob::take_output - 取走等待发送的输出
+ * @out: 输出追加到末尾
+ */
+bool SearchJob::take_output(std::string &out)
+{
+	std::lock_guard<std::mutex> lock(output_mutex);
+
+	if (!output.empty()) {
+		out += output;
+		output.clear();
+		output_cond.notify_all();
+	}
+
+	return finished;
+}
+
+/**
+ * SearchJob::worker - 工作任务主循环
+ *
+ * 队列为空且没有任务在处理工作项时（不会再产生新的工作项）搜索
+ * 完成。
+ */
+void SearchJob::worker(void)
+{
+	std::string read_buffer;
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	while (true) {
+		queue_cond.wait(lock, [this]() {
+			return stopping() || !queue.empty() || active == 0;
+		});
+		if (stopping() || queue.empty())
+			break;
+
+		/* 后进先出：深度优先，队列不会因为大目录树而变得很长 */
+		WorkItem item = std::move(queue.back());
+		queue.pop_back();
+		active++;
+		lock.unlock();
+
+		if (item.is_directory)
+			scan_directory(item.path);
+		else
+			search_file(item.path, read_buffer);
+
+		lock.lock();
+		active--;
+		if (active == 0 && queue.empty())
+			queue_cond.notify_all();
+	}
+
+	/* 其他任务可能还在等待工作项 */
+	queue_cond.notify_all();
+	lock.unlock();
+
+	finish_worker();
+}
+
+/**
+ * SearchJob::finish_worker - 一个工作任务退出
+ *
+ * 最后一个退出的任务追加done事件。
+ */
+void SearchJob::finish_worker(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		if (--workers > 0)
+			return;
+	}
+
+	if (cancelled)
+		return;
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - started);
+
+	json data;
+	data["files"] = file_count.load();
+	data["matches"] = std::min(result_count.load(), pattern.max_results());
+	data["truncated"] = truncated.load();
+	data["elapsedMs"] = elapsed.count();
+
+	append_output("event: done\ndata: " + data.dump() + "\n\n", true);
+}
+
+/**
+ * SearchJob::scan_directory - 读取目录项，子目录和文件放入队列
+ *
+ * 优先使用d_type，只有文件系统不提供类型或是符号链接时才stat。
+ */
+void SearchJob::scan_directory(const std::string &path)
+{
+	DIR *dir = opendir(path.c_str());
+	if (!dir)
+		return;
+
+	std::vector<WorkItem> items;
+	struct dirent *entry;
+
+	while (!stopping() && (entry = readdir(dir)) != nullptr) {
+		/* 跳过.、..和隐藏文件（如.git） */
+		if (entry->d_name[0] == '.')
+			continue;
+
+		std::string child = path;
+		if (child.empty() || child.back() != '/')
+			child += '/';
+		child += entry->d_name;
+
+		unsigned char type = entry->d_type;
+		if (type == DT_UNKNOWN || type == DT_LNK) {
+			struct stat st;
+			if ((type == DT_UNKNOWN ? lstat(child.c_str(), &st) :
+						  stat(child.c_str(), &st)) != 0)
+				continue;
+
+			if (S_ISDIR(st.st_mode))
+				type = (type == DT_LNK) ? DT_LNK : DT_DIR;
+			else if (S_ISREG(st.st_mode))
+				type = DT_REG;
+			else if (S_ISLNK(st.st_mode) && stat(child.c_str(), &st) == 0 &&
+				 S_ISREG(st.st_mode))
+				type = DT_REG;
+		}
+
+		/* 不进入符号链接指向的目录，避免循环 */
+		if (type == DT_DIR)
+			items.push_back(WorkItem{ std::move(child), true });
+		else if (type == DT_REG)
+			items.push_back(WorkItem{ std::move(child), false });
+	}
+
+	closedir(dir);
+
+	if (items.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		if (stopping())
+			return;
+		for (WorkItem &item : items)
+			queue.push_back(std::move(item));
+	}
+	queue_cond.notify_all();
+}
+
+/**
+ * SearchJob::search_file - 搜索一个文件并输出结果
+ * @path: 文件路径
+ * @read_buffer: 工作任务复用的读缓冲区
+ *
+ * 已打开的文件搜索TextBuffer（包含未保存的编辑）。磁盘上的文件
+ * 先按FileManager缓存的判定跳过二进制文件，小文件read()到复用的
+ * 缓冲区，大文件mmap()。
+ */
+void SearchJob::search_file(const std::string &path, std::string &read_buffer)
+{
+	/*
+	 * 多找一个匹配：已经输出max个时仍然搜索剩余文件，由emit()分辨
+	 * 恰好max个和超过max个
+	 */
+	const size_t max = pattern.max_results();
+	const size_t used = result_count.load(std::memory_order_relaxed);
+	if (used > max || stopping())
+		return;
+	const size_t limit = max - used + 1;
+
+	std::vector<SearchMatch> matches;
+
+	if (lookup) {
+		std::shared_ptr<TextBuffer> buffer = lookup(path);
+		if (buffer) {
+			pattern.search_buffer(*buffer, matches, limit, &cancelled);
+			file_count++;
+			emit(path, matches);
+			return;
+		}
+	}
+
+	if (file_manager && file_manager->is_binary_file(path))
+		return;
+
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size > SEARCH_MAX_FILE_SIZE) {
+		close(fd);
+		return;
+	}
+
+	const size_t size = st.st_size;
+	void *map = nullptr;
+	std::string_view content;
+
+	if (size >= SEARCH_MMAP_MIN_SIZE) {
+		map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return;
+		}
+		madvise(map, size, MADV_SEQUENTIAL);
+		content = std::string_view(static_cast<const char *>(map), size);
+	} else {
+		read_buffer.resize_and_overwrite(size, [fd](char *buf, size_t n) {
+			size_t got = 0;
+			while (got < n) {
+				const ssize_t ret = read(fd, buf + got, n - got);
+				if (ret < 0 && errno == EINTR)
+					continue;
+				if (ret <= 0)
+					break;
+				got += ret;
+			}
+			return got;
+		});
+		content = read_buffer;
+	}
+
+	close(fd);
+	file_count++;
+
+	pattern.scan(content, 0, 0, matches, limit);
+
+	if (map)
+		munmap(map, size);
+
+	emit(path, matches);
+}
+
+/**
+ * SearchJob::emit - 把一个文件的匹配编码为results事件
+ *
+ * 多个任务同时接近上限时按原子计数截断，输出的匹配总数不超过
+ * max_results；只有确实存在第max_results + 1个匹配时才标记
+ * truncated。文件内容可能不是合法的UTF-8，非法字节替换为U+FFFD。
+ */
+void SearchJob::emit(const std::string &path,
+		     const std::vector<SearchMatch> &matches)
+{
+	if (matches.empty())
+		return;
+
+	const size_t max = pattern.max_results();
+	const size_t before = result_count.fetch_add(matches.size());
+	if (before >= max) {
+		truncated = true;
+		return;
+	}
+
+	size_t count = matches.size();
+	if (before + count > max) {
+		count = max - before;
+		truncated = true;
+	}
+
+	json list = json::array();
+	for (size_t i = 0; i < count; i++) {
+		const SearchMatch &match = matches[i];
+		list.push_back({
+			{ "line", match.line },
+			{ "column", match.column },
+			{ "length", match.length },
+			{ "offset", match.offset },
+			{ "preview", match.preview },
+			{ "previewColumn", match.preview_column },
+		});
+	}
+
+	json data;
+	data["path"] = path;
+	data["matches"] = std::move(list);
+
+	append_output("event: results\ndata: " +
+		      data.dump(-1, ' ', false, json::error_handler_t::replace) +
+		      "\n\n", false);
+}
+
+/**
+ * SearchJob::append_output - 追加SSE事件
+ * @event: 编码好的事件
+ * @last: 是否是最后一个事件（done）
+ *
+ * 积压超过SEARCH_OUTPUT_HIGH_WATER时等待连接取走，慢的客户端
+ * 会让搜索暂停而不是无限占用内存。
+ */
+void SearchJob::append_output(std::string event, bool last)
+{
+	bool notify;
+	{
+		std::unique_lock<std::mutex> lock(output_mutex);
+		output_cond.wait(lock, [this]() {
+			return cancelled || output.size() < SEARCH_OUTPUT_HIGH_WATER;
+		});
+		if (cancelled)
+			return;
+
+		notify = output.empty() || last;
+		output += event;
+		if (last)
+			finished = true;
+	}
+
+	if (notify && ready)
+		ready();
+}
@@ -0,0 +1,187 @@
+/*
+ * Mikufy v2.11-nova - 启动耗时跟踪实现
+ *
+ * 本文件实现了StartupTrace类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/startup_trace.h"
+#include "../headers/metrics.h"
+#include "../headers/logger.h"
+#include <cstdio>		/* fopen(), fgets() */
+#include <cstdlib>		/* strtoull() */
+#include <cstring>		/* strrchr() */
+#include <format>		/* std::format */
+#include <time.h>		/* clock_gettime(), CLOCK_BOOTTIME */
+#include <unistd.h>		/* gettid(), sysconf() */
+
+/**
+ * StartupTrace::instance - 获取全局跟踪对象
+ *
+ * main()开始时调用一次，之后各线程使用同一个对象。
+ */
+StartupTrace &StartupTrace::instance(void)
+{
+	static StartupTrace *trace = new StartupTrace();
+	return *trace;
+}
+
+/**
+ * StartupTrace::StartupTrace - 构造函数
+ */
+StartupTrace::StartupTrace(void)
+	: done(false), origin_us(process_start_us())
+{
+	entries.reserve(STARTUP_TRACE_MAX_MARKS);
+}
+
+/**
+ * StartupTrace::now_us - 当前的CLOCK_BOOTTIME（微秒）
+ *
+ * /proc/self/stat 中的启动时间也是开机以来的时间，两者可以直接相减。
+ */
+int64_t StartupTrace::now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * StartupTrace::process_start_us - 进程启动时的CLOCK_BOOTTIME（微秒）
+ *
+ * 启动时间是 /proc/self/stat 的第22个字段（时钟滴答数）。第2个字段
+ * 是括号中的进程名，可能含空格，从最后一个')'之后开始数。
+ */
+int64_t StartupTrace::process_start_us(void)
+{
+	const int64_t fallback = now_us();
+
+	FILE *fp = fopen("/proc/self/stat", "re");
+	if (!fp)
+		return fallback;
+
+	char line[1024];
+	const bool ok = fgets(line, sizeof(line), fp) != nullptr;
+	fclose(fp);
+	if (!ok)
+		return fallback;
+
+	const char *p = strrchr(line, ')');
+	if (!p)
+		return fallback;
+
+	/* ')'之后是第3个字段，启动时间在其后第19个 */
+	for (int field = 2; field < 22 && *p; p++) {
+		if (*p == ' ')
+			field++;
+	}
+
+	const long ticks_per_second = sysconf(_SC_CLK_TCK);
+	char *end;
+	const unsigned long long ticks = strtoull(p, &end, 10);
+	if (end == p || ticks_per_second <= 0)
+		return fallback;
+
+	const int64_t start = static_cast<int64_t>(ticks) * 1000000 /
+			      ticks_per_second;
+	return start <= fallback ? start : fallback;
+}
+
+/**
+ * StartupTrace::append_locked - 追加一个时间点（调用者持有mutex）
+ */
+void StartupTrace::append_locked(std::string_view name)
+{
+	if (done || entries.size() >= STARTUP_TRACE_MAX_MARKS)
+		return;
+
+	entries.push_back({ std::string(name), now_us() - origin_us, gettid() });
+}
+
+/**
+ * StartupTrace::mark - 记录一个阶段完成
+ */
+void StartupTrace::mark(std::string_view name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	append_locked(name);
+}
+
+/**
+ * StartupTrace::finish - 记录最后一个阶段并结束跟踪
+ *
+ * 日志在锁外写入。
+ */
+bool StartupTrace::finish(std::string_view name)
+{
+	std::vector<StartupMark> snapshot;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (done)
+			return false;
+
+		append_locked(name);
+		done = true;
+		snapshot = entries;
+	}
+
+	int64_t previous = 0;
+	for (const StartupMark &mark : snapshot) {
+		log_info("启动阶段: {:<24} {:>8.1f} ms（+{:.1f} ms，线程 {}）",
+			 mark.name, mark.elapsed_us / 1000.0,
+			 (mark.elapsed_us - previous) / 1000.0, mark.tid);
+		previous = mark.elapsed_us;
+	}
+	log_info("启动完成，可以交互: {:.1f} ms", previous / 1000.0);
+	return true;
+}
+
+/**
+ * StartupTrace::finished - 跟踪是否已结束
+ */
+bool StartupTrace::finished(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return done;
+}
+
+/**
+ * StartupTrace::marks - 取得已记录的时间点
+ */
+std::vector<StartupMark> StartupTrace::marks(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries;
+}
+
+/**
+ * StartupTrace::render - 以Prometheus文本格式输出各阶段耗时
+ *
+ * 同名的阶段只输出第一次记录的时间。
+ */
+void StartupTrace::render(std::string &out) const
+{
+	const std::vector<StartupMark> snapshot = marks();
+	if (snapshot.empty())
+		return;
+
+	out += "# HELP mikufy_startup_phase_seconds Time from process start "
+	       "until each startup phase completed\n";
+	out += "# TYPE mikufy_startup_phase_seconds gauge\n";
+
+	for (size_t i = 0; i < snapshot.size(); i++) {
+		bool repeated = false;
+		for (size_t j = 0; j < i && !repeated; j++)
+			repeated = snapshot[j].name == snapshot[i].name;
+		if (repeated)
+			continue;
+
+		out += std::format("mikufy_startup_phase_seconds{{{}}} {:.6f}\n",
+				   Metrics::label("phase", snapshot[i].name),
+				   snapshot[i].elapsed_us / 1000000.0);
+	}
+}
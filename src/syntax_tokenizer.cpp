@@ -0,0 +1,762 @@
+/*
+ * Mikufy v2.11-nova - 语法词法分析实现
+ *
+ * 本文件实现了SyntaxLanguage类和语言规则表。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/syntax_tokenizer.h"
+#include <algorithm>		/* std::min */
+#include <unordered_map>	/* std::unordered_map 语言名称表 */
+
+/*
+ * 词法状态（跨行的结构），取值不超过 SYNTAX_STATE_MASK
+ */
+enum LexState : uint8_t {
+	STATE_NORMAL = SYNTAX_STATE_INITIAL,
+	STATE_BLOCK_COMMENT,		/* 块注释中 */
+	STATE_TRIPLE_DOUBLE,		/* """ 字符串中 */
+	STATE_TRIPLE_SINGLE,		/* ''' 字符串中 */
+	STATE_BACKTICK,			/* 反引号字符串中 */
+	STATE_STRING_DOUBLE,		/* 行尾反斜杠续行的 " 字符串 */
+	STATE_STRING_SINGLE,		/* 行尾反斜杠续行的 ' 字符串 */
+	STATE_PREPROCESSOR,		/* 行尾反斜杠续行的预处理指令 */
+	STATE_MARKUP_TAG		/* 标签的属性中（标签名之后、'>' 之前） */
+};
+
+/* 短字符字面量最长的字节数（如 '\u{10FFFF}'） */
+#define SHORT_CHAR_LITERAL_MAX	12
+
+/* 不区分大小写的关键字最长的字节数 */
+#define KEYWORD_MAX_LENGTH	32
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool is_word_start(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+	       c == '$' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+static bool is_word_char(char c)
+{
+	return is_word_start(c) || is_digit(c);
+}
+
+static bool ends_with_backslash(std::string_view line)
+{
+	return !line.empty() && line.back() == '\\';
+}
+
+/**
+ * scan_number - 数字字面量的结尾
+ *
+ * 包括前缀（0x）、小数点、指数和后缀（10u、1.5f、1_000），十六进制
+ * 数字中的 e 不当作指数。
+ */
+static size_t scan_number(std::string_view line, size_t i)
+{
+	const bool hex = line[i] == '0' && i + 1 < line.size() &&
+			 (line[i + 1] == 'x' || line[i + 1] == 'X');
+
+	for (i++; i < line.size(); i++) {
+		const char c = line[i];
+		const char prev = line[i - 1];
+
+		if (is_word_char(c) && c != '$')
+			continue;
+		if (c == '.')
+			continue;
+		if ((c == '+' || c == '-') && !hex && (prev == 'e' || prev == 'E'))
+			continue;
+		break;
+	}
+	return i;
+}
+
+/**
+ * SyntaxLanguage::SyntaxLanguage - 构造函数
+ */
+SyntaxLanguage::SyntaxLanguage(std::string name, const Rules &rules,
+			       std::string_view keywords)
+	: language_name(std::move(name)), rules(rules)
+{
+	size_t pos = 0;
+	while (pos < keywords.size()) {
+		size_t end = keywords.find(' ', pos);
+		if (end == std::string_view::npos)
+			end = keywords.size();
+		if (end > pos)
+			this->keywords.insert(keywords.substr(pos, end - pos));
+		pos = end + 1;
+	}
+}
+
+/*
+ * ============================================================================
+ * 语言规则表
+ * ============================================================================
+ */
+
+static const std::string_view C_KEYWORDS =
+	"auto break case char const continue default do double else enum "
+	"extern float for goto if inline int long register restrict return "
+	"short signed sizeof static struct switch typedef union unsigned void "
+	"volatile while bool true false NULL _Bool _Static_assert";
+
+static const std::string_view CPP_KEYWORDS =
+	"auto break case char const continue default do double else enum "
+	"extern float for goto if inline int long register return short "
+	"signed sizeof static struct switch typedef union unsigned void "
+	"volatile while bool true false NULL alignas alignof and asm catch "
+	"class concept consteval constexpr constinit const_cast co_await "
+	"co_return co_yield decltype delete dynamic_cast explicit export "
+	"final friend mutable namespace new noexcept not nullptr operator or "
+	"override private protected public reinterpret_cast requires "
+	"static_assert static_cast template this thread_local throw try "
+	"typeid typename using virtual wchar_t char8_t char16_t char32_t";
+
+static const std::string_view JS_KEYWORDS =
+	"async await break case catch class const continue debugger default "
+	"delete do else export extends false finally for from function if "
+	"import in instanceof let new null of return static super switch this "
+	"throw true try typeof undefined var void while with yield";
+
+static const std::string_view TS_KEYWORDS =
+	"async await break case catch class const continue debugger default "
+	"delete do else export extends false finally for from function if "
+	"import in instanceof let new null of return static super switch this "
+	"throw true try typeof undefined var void while with yield abstract "
+	"any as boolean declare enum implements interface keyof namespace "
+	"never number private protected public readonly string type unknown";
+
+static const std::string_view PYTHON_KEYWORDS =
+	"False None True and as assert async await break class continue def "
+	"del elif else except finally for from global if import in is lambda "
+	"nonlocal not or pass raise return try while with yield self match case";
+
+static const std::string_view JAVA_KEYWORDS =
+	"abstract assert boolean break byte case catch char class const "
+	"continue default do double else enum extends final finally float for "
+	"goto if implements import instanceof int interface long native new "
+	"package private protected public return short static strictfp super "
+	"switch synchronized this throw throws transient try void volatile "
+	"while true false null var record";
+
+static const std::string_view GO_KEYWORDS =
+	"break case chan const continue default defer else fallthrough for "
+	"func go goto if import interface map package range return select "
+	"struct switch type var true false nil iota";
+
+static const std::string_view RUST_KEYWORDS =
+	"as async await break const continue crate dyn else enum extern false "
+	"fn for if impl in let loop match mod move mut pub ref return self "
+	"Self static struct super trait true type unsafe use where while";
+
+static const std::string_view SHELL_KEYWORDS =
+	"if then else elif fi case esac for select while until do done in "
+	"function time return exit local export readonly declare unset";
+
+static const std::string_view PHP_KEYWORDS =
+	"abstract and array as break case catch class clone const continue "
+	"declare default do echo else elseif empty endfor endforeach endif "
+	"endswitch endwhile extends false final finally fn for foreach "
+	"function global if implements include include_once instanceof "
+	"interface isset list match namespace new null or print private "
+	"protected public readonly require require_once return static switch "
+	"throw trait true try unset use var while yield";
+
+static const std::string_view RUBY_KEYWORDS =
+	"BEGIN END alias and begin break case class def defined? do else "
+	"elsif end ensure false for if in module next nil not or redo rescue "
+	"retry return self super then true undef unless until when while "
+	"yield";
+
+static const std::string_view LUA_KEYWORDS =
+	"and break do else elseif end false for function goto if in local nil "
+	"not or repeat return then true until while";
+
+static const std::string_view KOTLIN_KEYWORDS =
+	"as break class continue do else false for fun if in interface is "
+	"null object package return super this throw true try typealias val "
+	"var when while by catch constructor finally get import init set "
+	"private protected public internal override open data sealed";
+
+static const std::string_view SWIFT_KEYWORDS =
+	"associatedtype class deinit enum extension fileprivate func import "
+	"init inout internal let open operator private protocol public "
+	"static struct subscript typealias var break case continue default "
+	"defer do else fallthrough for guard if in repeat return switch where "
+	"while as catch false is nil self Self super throw throws true try";
+
+static const std::string_view DART_KEYWORDS =
+	"abstract as assert async await break case catch class const continue "
+	"default do dynamic else enum export extends extension external "
+	"factory false final finally for get if implements import in is late "
+	"library new null operator part required rethrow return set static "
+	"super switch this throw true try typedef var void while with yield";
+
+static const std::string_view SQL_KEYWORDS =
+	"select from where insert into values update set delete create table "
+	"drop alter add index view primary key foreign references not null "
+	"and or in is like between join inner left right outer full on as "
+	"group by order having limit offset union all distinct case when then "
+	"else end exists begin commit rollback transaction default unique "
+	"true false";
+
+static const std::string_view HASKELL_KEYWORDS =
+	"case class data deriving do else if import in infix infixl infixr "
+	"instance let module newtype of then type where";
+
+static const std::string_view SCALA_KEYWORDS =
+	"abstract case catch class def do else extends false final finally "
+	"for forSome if implicit import lazy match new null object override "
+	"package private protected return sealed super this throw trait try "
+	"true type val var while with yield";
+
+static const std::string_view CMAKE_KEYWORDS =
+	"if elseif else endif foreach endforeach while endwhile function "
+	"endfunction macro endmacro return set unset option project "
+	"add_executable add_library target_link_libraries "
+	"target_include_directories include find_package message";
+
+static const std::string_view LITERAL_KEYWORDS = "true false null";
+
+/**
+ * SyntaxLanguage::find - 按语言名称查找词法规则
+ */
+const SyntaxLanguage *SyntaxLanguage::find(std::string_view name)
+{
+	static const std::vector<SyntaxLanguage> languages = [] {
+		/* C 系：// 与块注释，双引号字符串，单引号字符 */
+		const Rules c_rules = {
+			.line_comment = "//", .line_comment_alt = {},
+			.block_open = "/*", .block_close = "*/", .quotes = "\"'",
+			.escapes = true, .triple_quotes = false,
+			.multiline_backtick = false, .short_char_literals = false,
+			.preprocessor = true, .comment_after_space = false,
+			.case_insensitive = false, .markup = false
+		};
+
+		Rules jvm_rules = c_rules;		/* Java、Kotlin、Swift 等 */
+		jvm_rules.preprocessor = false;
+
+		Rules js_rules = jvm_rules;		/* 模板字符串可以跨行 */
+		js_rules.quotes = "\"'`";
+		js_rules.multiline_backtick = true;
+
+		Rules rust_rules = jvm_rules;
+		rust_rules.short_char_literals = true;
+
+		Rules triple_rules = jvm_rules;		/* Kotlin、Swift、Scala 的 """ */
+		triple_rules.triple_quotes = true;
+
+		Rules php_rules = jvm_rules;
+		php_rules.line_comment_alt = "#";
+
+		Rules css_rules = jvm_rules;
+		css_rules.line_comment = {};
+
+		Rules json_rules = css_rules;
+		json_rules.block_open = json_rules.block_close = {};
+		json_rules.quotes = "\"";
+
+		/* # 注释系 */
+		const Rules hash_rules = {
+			.line_comment = "#", .line_comment_alt = {},
+			.block_open = {}, .block_close = {}, .quotes = "\"'",
+			.escapes = true, .triple_quotes = false,
+			.multiline_backtick = false, .short_char_literals = false,
+			.preprocessor = false, .comment_after_space = false,
+			.case_insensitive = false, .markup = false
+		};
+
+		Rules python_rules = hash_rules;
+		python_rules.triple_quotes = true;
+
+		Rules shell_rules = hash_rules;
+		shell_rules.quotes = "\"'`";
+		shell_rules.comment_after_space = true;
+
+		Rules make_rules = hash_rules;
+		make_rules.comment_after_space = true;
+
+		Rules cmake_rules = hash_rules;
+		cmake_rules.quotes = "\"";
+		cmake_rules.case_insensitive = true;
+
+		Rules ini_rules = hash_rules;
+		ini_rules.line_comment_alt = ";";
+		ini_rules.quotes = "\"";
+
+		Rules yaml_rules = hash_rules;
+		yaml_rules.comment_after_space = true;
+
+		Rules lua_rules = hash_rules;
+		lua_rules.line_comment = "--";
+		lua_rules.block_open = "--[[";
+		lua_rules.block_close = "]]";
+
+		Rules sql_rules = hash_rules;
+		sql_rules.line_comment = "--";
+		sql_rules.block_open = "/*";
+		sql_rules.block_close = "*/";
+		sql_rules.escapes = false;
+		sql_rules.case_insensitive = true;
+
+		Rules haskell_rules = hash_rules;
+		haskell_rules.line_comment = "--";
+		haskell_rules.block_open = "{-";
+		haskell_rules.block_close = "-}";
+		haskell_rules.quotes = "\"";
+
+		Rules ml_rules = hash_rules;		/* OCaml、F# 的 (* *) */
+		ml_rules.line_comment = {};
+		ml_rules.block_open = "(*";
+		ml_rules.block_close = "*)";
+		ml_rules.quotes = "\"";
+
+		Rules fsharp_rules = ml_rules;
+		fsharp_rules.line_comment = "//";
+
+		Rules erlang_rules = hash_rules;
+		erlang_rules.line_comment = "%";
+		erlang_rules.quotes = "\"";
+
+		Rules lisp_rules = hash_rules;
+		lisp_rules.line_comment = ";";
+		lisp_rules.quotes = "\"";
+
+		Rules asm_rules = hash_rules;
+		asm_rules.line_comment = ";";
+		asm_rules.line_comment_alt = "#";
+		asm_rules.comment_after_space = true;
+
+		Rules vhdl_rules = hash_rules;
+		vhdl_rules.line_comment = "--";
+		vhdl_rules.quotes = "\"";
+		vhdl_rules.case_insensitive = true;
+
+		/* 标记语言 */
+		Rules markup_rules = hash_rules;
+		markup_rules.line_comment = {};
+		markup_rules.block_open = "<!--";
+		markup_rules.block_close = "-->";
+		markup_rules.escapes = false;
+		markup_rules.markup = true;
+
+		return std::vector<SyntaxLanguage>{
+			{ "c", c_rules, C_KEYWORDS },
+			{ "cpp", c_rules, CPP_KEYWORDS },
+			{ "javascript", js_rules, JS_KEYWORDS },
+			{ "typescript", js_rules, TS_KEYWORDS },
+			{ "python", python_rules, PYTHON_KEYWORDS },
+			{ "java", jvm_rules, JAVA_KEYWORDS },
+			{ "go", js_rules, GO_KEYWORDS },
+			{ "rust", rust_rules, RUST_KEYWORDS },
+			{ "shell", shell_rules, SHELL_KEYWORDS },
+			{ "html", markup_rules, {} },
+			{ "xml", markup_rules, {} },
+			{ "css", css_rules, {} },
+			{ "json", json_rules, LITERAL_KEYWORDS },
+			{ "php", php_rules, PHP_KEYWORDS },
+			{ "ruby", hash_rules, RUBY_KEYWORDS },
+			{ "lua", lua_rules, LUA_KEYWORDS },
+			{ "kotlin", triple_rules, KOTLIN_KEYWORDS },
+			{ "swift", triple_rules, SWIFT_KEYWORDS },
+			{ "dart", triple_rules, DART_KEYWORDS },
+			{ "scala", triple_rules, SCALA_KEYWORDS },
+			{ "groovy", triple_rules, JAVA_KEYWORDS },
+			{ "sql", sql_rules, SQL_KEYWORDS },
+			{ "r", hash_rules, "if else repeat while function for in next "
+					   "break TRUE FALSE NULL NA" },
+			{ "nim", python_rules, "proc func var let const type object if "
+					       "elif else for while return import" },
+			{ "elixir", python_rules, "def defp defmodule do end if else "
+						  "case cond fn when true false nil" },
+			{ "erlang", erlang_rules, "case of end if receive after when "
+						  "fun try catch begin" },
+			{ "haskell", haskell_rules, HASKELL_KEYWORDS },
+			{ "ocaml", ml_rules, "let in if then else match with fun "
+					     "function type module open rec" },
+			{ "fsharp", fsharp_rules, "let in if then else match with fun "
+						  "function type module open rec" },
+			{ "clojure", lisp_rules, "def defn fn let if do loop recur" },
+			{ "verilog", jvm_rules, "module endmodule input output inout "
+						"wire reg always assign begin end if "
+						"else case endcase posedge negedge" },
+			{ "systemverilog", jvm_rules, "module endmodule input output "
+						      "logic always_ff always_comb "
+						      "assign begin end if else" },
+			{ "vhdl", vhdl_rules, "entity architecture is begin end port "
+					      "signal process if then else elsif "
+					      "library use" },
+			{ "asm", asm_rules, {} },
+			{ "toml", python_rules, "true false" },
+			{ "yaml", yaml_rules, LITERAL_KEYWORDS },
+			{ "ini", ini_rules, {} },
+			{ "cmake", cmake_rules, CMAKE_KEYWORDS },
+			{ "make", make_rules, "ifeq ifneq ifdef ifndef else endif "
+					      "include define endef export" }
+		};
+	}();
+
+	static const std::unordered_map<std::string_view,
+					const SyntaxLanguage *> by_name = [] {
+		std::unordered_map<std::string_view, const SyntaxLanguage *> map;
+		for (const SyntaxLanguage &language : languages)
+			map.emplace(language.name(), &language);
+		return map;
+	}();
+
+	const auto it = by_name.find(name);
+	return it != by_name.end() ? it->second : nullptr;
+}
+
+/*
+ * ============================================================================
+ * 词法分析
+ * ============================================================================
+ */
+
+/**
+ * SyntaxLanguage::scan_string - 找字符串的结尾引号
+ */
+bool SyntaxLanguage::scan_string(std::string_view line, size_t from,
+				 char quote, size_t &end) const
+{
+	for (size_t i = from; i < line.size(); i++) {
+		if (line[i] == '\\' && rules.escapes) {
+			i++;
+			continue;
+		}
+		if (line[i] == quote) {
+			end = i + 1;
+			return true;
+		}
+	}
+
+	end = line.size();
+	return false;
+}
+
+/**
+ * SyntaxLanguage::is_keyword - 单词是否为关键字
+ */
+bool SyntaxLanguage::is_keyword(std::string_view word) const
+{
+	if (!rules.case_insensitive)
+		return keywords.contains(word);
+
+	if (word.size() > KEYWORD_MAX_LENGTH)
+		return false;
+
+	char lower[KEYWORD_MAX_LENGTH];
+	for (size_t i = 0; i < word.size(); i++) {
+		const char c = word[i];
+		lower[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c;
+	}
+	return keywords.contains(std::string_view(lower, word.size()));
+}
+
+/**
+ * SyntaxLanguage::lex_line - 分析一行
+ *
+ * 先结束上一行延续下来的结构，然后从左到右识别：行首 #、块注释、
+ * 行注释、字符串、数字、单词。块注释开头在行注释之前检查（Lua 的
+ * "--[[" 以 "--" 开头）。
+ */
+uint8_t SyntaxLanguage::lex_line(std::string_view line, uint8_t state,
+				 std::vector<SyntaxToken> *tokens) const
+{
+	if (rules.markup)
+		return lex_markup(line, state, tokens);
+
+	const size_t n = line.size();
+	const auto emit = [tokens](size_t start, size_t end,
+				   SyntaxTokenKind kind) {
+		if (tokens && end > start)
+			tokens->push_back({ static_cast<uint32_t>(start),
+					    static_cast<uint32_t>(end - start),
+					    kind });
+	};
+
+	size_t i = 0;
+	size_t end;
+
+	switch (state) {
+	case STATE_BLOCK_COMMENT:
+		end = line.find(rules.block_close);
+		if (end == std::string_view::npos || rules.block_close.empty()) {
+			emit(0, n, SyntaxTokenKind::COMMENT);
+			return STATE_BLOCK_COMMENT;
+		}
+		i = end + rules.block_close.size();
+		emit(0, i, SyntaxTokenKind::COMMENT);
+		break;
+	case STATE_TRIPLE_DOUBLE:
+	case STATE_TRIPLE_SINGLE:
+		end = line.find(state == STATE_TRIPLE_DOUBLE ? "\"\"\"" : "'''");
+		if (end == std::string_view::npos) {
+			emit(0, n, SyntaxTokenKind::STRING);
+			return state;
+		}
+		i = end + 3;
+		emit(0, i, SyntaxTokenKind::STRING);
+		break;
+	case STATE_BACKTICK:
+		if (!scan_string(line, 0, '`', i)) {
+			emit(0, n, SyntaxTokenKind::STRING);
+			return STATE_BACKTICK;
+		}
+		emit(0, i, SyntaxTokenKind::STRING);
+		break;
+	case STATE_STRING_DOUBLE:
+	case STATE_STRING_SINGLE:
+		if (!scan_string(line, 0,
+				 state == STATE_STRING_DOUBLE ? '"' : '\'', i)) {
+			emit(0, n, SyntaxTokenKind::STRING);
+			if (ends_with_backslash(line))
+				return state;
+			return STATE_NORMAL;
+		}
+		emit(0, i, SyntaxTokenKind::STRING);
+		break;
+	case STATE_PREPROCESSOR:
+		emit(0, n, SyntaxTokenKind::PREPROCESSOR);
+		return ends_with_backslash(line) ? STATE_PREPROCESSOR : STATE_NORMAL;
+	default:
+		break;
+	}
+
+	bool line_start = (i == 0);
+
+	while (i < n) {
+		const char c = line[i];
+
+		if (c == ' ' || c == '\t') {
+			i++;
+			continue;
+		}
+
+		if (rules.preprocessor && line_start && c == '#') {
+			emit(i, n, SyntaxTokenKind::PREPROCESSOR);
+			return ends_with_backslash(line) ? STATE_PREPROCESSOR :
+							   STATE_NORMAL;
+		}
+		line_start = false;
+
+		if (!rules.block_open.empty() &&
+		    line.substr(i).starts_with(rules.block_open)) {
+			end = line.find(rules.block_close,
+					i + rules.block_open.size());
+			if (end == std::string_view::npos) {
+				emit(i, n, SyntaxTokenKind::COMMENT);
+				return STATE_BLOCK_COMMENT;
+			}
+			end += rules.block_close.size();
+			emit(i, end, SyntaxTokenKind::COMMENT);
+			i = end;
+			continue;
+		}
+
+		const std::string_view rest = line.substr(i);
+		if ((!rules.line_comment.empty() &&
+		     rest.starts_with(rules.line_comment)) ||
+		    (!rules.line_comment_alt.empty() &&
+		     rest.starts_with(rules.line_comment_alt))) {
+			if (!rules.comment_after_space || i == 0 ||
+			    line[i - 1] == ' ' || line[i - 1] == '\t') {
+				emit(i, n, SyntaxTokenKind::COMMENT);
+				return STATE_NORMAL;
+			}
+		}
+
+		if (rules.triple_quotes && (c == '"' || c == '\'') &&
+		    rest.starts_with(c == '"' ? "\"\"\"" : "'''")) {
+			end = line.find(c == '"' ? "\"\"\"" : "'''", i + 3);
+			if (end == std::string_view::npos) {
+				emit(i, n, SyntaxTokenKind::STRING);
+				return c == '"' ? STATE_TRIPLE_DOUBLE :
+						  STATE_TRIPLE_SINGLE;
+			}
+			emit(i, end + 3, SyntaxTokenKind::STRING);
+			i = end + 3;
+			continue;
+		}
+
+		if (rules.quotes.find(c) != std::string_view::npos) {
+			if (c == '\'' && rules.short_char_literals) {
+				/* 'a' 和 '\n' 是字符，'a 是生命周期 */
+				const std::string_view window = line.substr(
+					i + 1, SHORT_CHAR_LITERAL_MAX);
+				const size_t close = window.find('\'', 1);
+				if (close == std::string_view::npos ||
+				    (close > 1 && window[0] != '\\')) {
+					i++;
+					continue;
+				}
+			}
+
+			const bool closed = scan_string(line, i + 1, c, end);
+			emit(i, end, SyntaxTokenKind::STRING);
+			if (!closed) {
+				if (c == '`' && rules.multiline_backtick)
+					return STATE_BACKTICK;
+				if (rules.escapes && ends_with_backslash(line))
+					return c == '"' ? STATE_STRING_DOUBLE :
+							  STATE_STRING_SINGLE;
+				return STATE_NORMAL;
+			}
+			i = end;
+			continue;
+		}
+
+		if (is_digit(c) || (c == '.' && i + 1 < n && is_digit(line[i + 1]))) {
+			end = scan_number(line, i);
+			emit(i, end, SyntaxTokenKind::NUMBER);
+			i = end;
+			continue;
+		}
+
+		if (is_word_start(c)) {
+			const size_t start = i;
+			while (i < n && is_word_char(line[i]))
+				i++;
+			if (tokens && is_keyword(line.substr(start, i - start)))
+				emit(start, i, SyntaxTokenKind::KEYWORD);
+			continue;
+		}
+
+		i++;
+	}
+
+	return STATE_NORMAL;
+}
+
+/**
+ * SyntaxLanguage::lex_markup - 标记语言的 lex_line()
+ *
+ * 标签外只识别注释和标签开头（标签名作为关键字），引号只在标签内
+ * 当作属性值，正文中的撇号不会被当成字符串。
+ */
+uint8_t SyntaxLanguage::lex_markup(std::string_view line, uint8_t state,
+				   std::vector<SyntaxToken> *tokens) const
+{
+	const size_t n = line.size();
+	const auto emit = [tokens](size_t start, size_t end,
+				   SyntaxTokenKind kind) {
+		if (tokens && end > start)
+			tokens->push_back({ static_cast<uint32_t>(start),
+					    static_cast<uint32_t>(end - start),
+					    kind });
+	};
+
+	size_t i = 0;
+	size_t end;
+
+	if (state == STATE_BLOCK_COMMENT) {
+		end = line.find(rules.block_close);
+		if (end == std::string_view::npos) {
+			emit(0, n, SyntaxTokenKind::COMMENT);
+			return STATE_BLOCK_COMMENT;
+		}
+		i = end + rules.block_close.size();
+		emit(0, i, SyntaxTokenKind::COMMENT);
+		state = STATE_NORMAL;
+	} else if (state != STATE_MARKUP_TAG) {
+		state = STATE_NORMAL;
+	}
+
+	while (i < n) {
+		if (state == STATE_MARKUP_TAG) {
+			const char c = line[i];
+			if (c == '>') {
+				state = STATE_NORMAL;
+				i++;
+			} else if (c == '"' || c == '\'') {
+				scan_string(line, i + 1, c, end);
+				emit(i, end, SyntaxTokenKind::STRING);
+				i = end;
+			} else {
+				i++;
+			}
+			continue;
+		}
+
+		const size_t open = line.find('<', i);
+		if (open == std::string_view::npos)
+			break;
+
+		if (line.substr(open).starts_with(rules.block_open)) {
+			end = line.find(rules.block_close,
+					open + rules.block_open.size());
+			if (end == std::string_view::npos) {
+				emit(open, n, SyntaxTokenKind::COMMENT);
+				return STATE_BLOCK_COMMENT;
+			}
+			end += rules.block_close.size();
+			emit(open, end, SyntaxTokenKind::COMMENT);
+			i = end;
+			continue;
+		}
+
+		size_t start = open + 1;
+		if (start < n && (line[start] == '/' || line[start] == '!' ||
+				  line[start] == '?'))
+			start++;
+		end = start;
+		while (end < n && (is_word_char(line[end]) || line[end] == '-' ||
+				   line[end] == ':' || line[end] == '.'))
+			end++;
+
+		if (end == start) {
+			i = open + 1;
+			continue;
+		}
+
+		emit(start, end, SyntaxTokenKind::KEYWORD);
+		state = STATE_MARKUP_TAG;
+		i = end;
+	}
+
+	return state;
+}
+
+/**
+ * syntax_tokens_to_utf16 - 把词法单元的字节偏移换算成 UTF-16 单位
+ *
+ * UTF-8 的续字节（10xxxxxx）不计数，四字节序列的首字节计为两个
+ * 单位（代理对），其余字节各计一个。
+ */
+void syntax_tokens_to_utf16(std::string_view line,
+			    std::span<const SyntaxToken> tokens,
+			    std::vector<SyntaxToken> &out)
+{
+	out.clear();
+	out.reserve(tokens.size());
+
+	size_t pos = 0;
+	uint32_t units = 0;
+	const auto advance = [&line, &pos, &units](size_t target) {
+		target = std::min(target, line.size());
+		for (; pos < target; pos++) {
+			const unsigned char b = static_cast<unsigned char>(line[pos]);
+			if ((b & 0xc0) != 0x80)
+				units += b >= 0xf0 ? 2 : 1;
+		}
+	};
+
+	for (const SyntaxToken &token : tokens) {
+		advance(token.start);
+		const uint32_t start = units;
+		advance(static_cast<size_t>(token.start) + token.length);
+		out.push_back({ start, units - start, token.kind });
+	}
+}
@@ -7,7 +7,7 @@
  * - 使用forkpty创建伪终端
  * - 使用epoll进行事件驱动I/O
  * - 独立IO线程持续读取进程输出
- * - 环形缓冲区高效管理数据
+ * - 分页回滚缓冲区保存输出历史
  * - RAII资源管理
  *
  * MiraTrive/MikuTrive
@@ -17,86 +17,30 @@
  */
 
 #include "../headers/terminal_manager.h"
-#include <iostream>
+#include "../headers/metrics.h"
+#include "../headers/logger.h"
 #include <cstring>
 #include <cerrno>
 #include <cstdlib>
 #include <algorithm>
 
-/*
- * ============================================================================
- * RingBuffer实现
- * ============================================================================
- */
-
-/**
- * RingBuffer::write - 写入数据到缓冲区
- */
-size_t RingBuffer::write(const char *data, size_t size)
-{
-	size_t written = 0;
-
-	while (written < size && !full_) {
-		buffer_[head_] = data[written];
-		head_ = (head_ + 1) % RING_BUFFER_SIZE;
-
-		if (head_ == tail_)
-			full_ = true;
+/* 从PTY读取的输出字节数（速率由采集端计算） */
+static MetricCounter &pty_read_bytes = Metrics::instance().counter(
+	"mikufy_terminal_pty_read_bytes_total", "从终端PTY读取的输出字节数");
 
-		written++;
-	}
-
-	return written;
-}
-
-/**
- * RingBuffer::read - 从缓冲区读取数据
- */
-size_t RingBuffer::read(char *buffer, size_t size)
-{
-	size_t read_count = 0;
+/* 写入PTY的输入字节数 */
+static MetricCounter &pty_input_bytes = Metrics::instance().counter(
+	"mikufy_terminal_pty_input_bytes_total", "写入终端PTY的输入字节数");
 
-	while (read_count < size && (!full_ || head_ != tail_)) {
-		buffer[read_count] = buffer_[tail_];
-		tail_ = (tail_ + 1) % RING_BUFFER_SIZE;
-		full_ = false;
-		read_count++;
-	}
+/* PTY写不下、输入放入队列等待EPOLLOUT的次数 */
+static MetricCounter &input_deferred = Metrics::instance().counter(
+	"mikufy_terminal_input_deferred_total",
+	"PTY暂时写不下、输入排队等待可写的次数");
 
-	return read_count;
-}
-
-/**
- * RingBuffer::available - 获取可读取的字节数
- */
-size_t RingBuffer::available() const
-{
-	if (full_)
-		return RING_BUFFER_SIZE;
-
-	if (head_ >= tail_)
-		return head_ - tail_;
-
-	return RING_BUFFER_SIZE - tail_ + head_;
-}
-
-/**
- * RingBuffer::capacity - 获取缓冲区容量
- */
-size_t RingBuffer::capacity() const
-{
-	return RING_BUFFER_SIZE;
-}
-
-/**
- * RingBuffer::clear - 清空缓冲区
- */
-void RingBuffer::clear()
-{
-	head_ = 0;
-	tail_ = 0;
-	full_ = false;
-}
+/* 回滚缓冲区已满、暂停读取PTY的次数（进程写输出被阻塞） */
+static MetricCounter &throttle_events = Metrics::instance().counter(
+	"mikufy_terminal_throttled_total",
+	"回滚缓冲区已满导致暂停读取PTY的次数");
 
 /*
  * ============================================================================
@@ -109,7 +53,10 @@ void RingBuffer::clear()
  */
 TerminalProcess::TerminalProcess(pid_t pid, int pty_fd,
 				 const std::string &command,
-				 const std::string &working_dir)
+				 const std::string &working_dir,
+				 size_t scrollback_limit, size_t spill_limit)
+	: output_(scrollback_limit, spill_limit), throttled_(false),
+	  finished_time_(0), pid_fd_(-1), epoll_fd_(-1), input_offset_(0)
 {
 	info_.pid = pid;
 	info_.pty_fd = pty_fd;
@@ -120,6 +67,16 @@ TerminalProcess::TerminalProcess(pid_t pid, int pty_fd,
 	info_.exit_code = -1;
 
 	set_nonblocking(pty_fd);
+
+	pty_tag_ = { EpollTag::Kind::PTY, this };
+	exit_tag_ = { EpollTag::Kind::EXIT, this };
+
+#ifdef SYS_pidfd_open
+	/* Linux 5.3+：进程退出时pidfd变为可读 */
+	pid_fd_ = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+	if (pid_fd_ >= 0)
+		fcntl(pid_fd_, F_SETFD, FD_CLOEXEC);
+#endif
 }
 
 /**
@@ -129,6 +86,9 @@ TerminalProcess::~TerminalProcess()
 {
 	if (info_.pty_fd >= 0)
 		close(info_.pty_fd);
+
+	if (pid_fd_ >= 0)
+		close(pid_fd_);
 }
 
 /**
@@ -150,6 +110,9 @@ void TerminalProcess::set_size(const TerminalSize &size)
 	if (info_.pty_fd < 0)
 		return;
 
+	if (size.cols == info_.size.cols && size.rows == info_.size.rows)
+		return;
+
 	struct winsize ws;
 	ws.ws_col = size.cols;
 	ws.ws_row = size.rows;
@@ -172,8 +135,12 @@ TerminalSize TerminalProcess::get_size() const
 
 /**
  * TerminalProcess::send_input - 发送输入到进程
+ *
+ * 输入先追加到队列末尾再写出，队列中已有输入时保持顺序。PTY只有
+ * 在队列由空变为非空时才注册EPOLLOUT，连续的小输入不会重复调用
+ * epoll_ctl()。
  */
-std::expected<void, std::string> TerminalProcess::send_input(const std::string &input)
+std::expected<void, std::string> TerminalProcess::send_input(std::string_view input)
 {
 	std::lock_guard<std::mutex> lock(mutex_);
 
@@ -183,94 +150,265 @@ std::expected<void, std::string> TerminalProcess::send_input(const std::string &
 	if (!info_.is_running)
 		return std::unexpected("Process is not running");
 
-	ssize_t written = write(info_.pty_fd, input.c_str(), input.length());
+	if (input.empty())
+		return {};
+
+	std::lock_guard<std::mutex> input_lock(input_mutex_);
+
+	const size_t queued = input_queue_.size() - input_offset_;
+	if (queued + input.size() > TERMINAL_INPUT_QUEUE_LIMIT)
+		return std::unexpected("Input queue is full");
 
-	if (written < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK)
-			return std::unexpected("Write would block");
+	const bool was_empty = queued == 0;
+	input_queue_.append(input);
 
-		return std::unexpected(std::format("Write failed: {}", strerror(errno)));
+	int err = write_queued_locked();
+	if (err != 0) {
+		input_queue_.clear();
+		input_offset_ = 0;
+		if (!was_empty)
+			update_pty_events_locked();
+		return std::unexpected(std::format("Write failed: {}", strerror(err)));
 	}
 
-	if (static_cast<size_t>(written) != input.length())
-		return std::unexpected("Partial write");
+	if (was_empty && input_offset_ < input_queue_.size()) {
+		input_deferred.add();
+		update_pty_events_locked();
+	}
 
 	return {};
 }
 
+/**
+ * TerminalProcess::write_queued_locked - 尽量写出输入队列
+ *
+ * 写完的前缀只记录偏移，队列写空或偏移超过一半时才移动剩余数据。
+ */
+int TerminalProcess::write_queued_locked()
+{
+	int err = 0;
+
+	while (input_offset_ < input_queue_.size()) {
+		ssize_t written = write(info_.pty_fd,
+					input_queue_.data() + input_offset_,
+					input_queue_.size() - input_offset_);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				err = errno;
+			break;
+		}
+
+		input_offset_ += written;
+		pty_input_bytes.add(written);
+	}
+
+	if (input_offset_ == input_queue_.size()) {
+		input_queue_.clear();
+		input_offset_ = 0;
+	} else if (input_offset_ > input_queue_.size() / 2) {
+		input_queue_.erase(0, input_offset_);
+		input_offset_ = 0;
+	}
+
+	return err;
+}
+
+/**
+ * TerminalProcess::flush_input - 把排队的输入写入PTY
+ *
+ * info_.pty_fd只在析构时关闭，IO线程调用时一直有效，不需要mutex_。
+ */
+void TerminalProcess::flush_input()
+{
+	std::lock_guard<std::mutex> lock(input_mutex_);
+
+	if (input_queue_.empty())
+		return;
+
+	if (write_queued_locked() != 0) {
+		/* 进程已退出（EIO），剩余输入不会再被读取 */
+		input_queue_.clear();
+		input_offset_ = 0;
+	}
+
+	if (input_queue_.empty())
+		update_pty_events_locked();
+}
+
 /**
  * TerminalProcess::read_output - 读取输出（非阻塞）
  *
- * 从环形缓冲区读取已缓存的数据，如果缓冲区为空则尝试从PTY读取一次。
+ * 取走消费位置之后已缓存的全部数据。PTY由IO线程读取，这里不再
+ * 直接读PTY，因此不会与IO线程竞争生产者的位置。
  */
 std::expected<TerminalOutput, std::string> TerminalProcess::read_output()
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-
 	TerminalOutput output;
+	output.is_eof = false;
+	output.is_error = false;
 
 	if (info_.pty_fd < 0) {
 		output.is_eof = true;
 		return output;
 	}
 
-	/* 如果缓冲区为空，尝试从PTY读取一次 */
-	if (output_buffer_.available() == 0) {
-		char buffer[8192];
-		ssize_t bytes_read;
-
-		bytes_read = read(info_.pty_fd, buffer, sizeof(buffer));
-
-		if (bytes_read > 0) {
-			output_buffer_.write(buffer, bytes_read);
-		} else if (bytes_read == 0) {
-			output.is_eof = true;
-			return output;
-		} else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-			output.is_error = true;
-			return output;
-		}
-	}
-
-	/* 从环形缓冲区读取数据 */
-	if (output_buffer_.available() > 0) {
-		std::vector<char> data(output_buffer_.available());
-		size_t read_count = output_buffer_.read(data.data(), data.size());
-		output.stdout_data.assign(data.data(), data.data() + read_count);
-	}
+	size_t pending = output_.unconsumed();
+	output.stdout_data.reserve(pending);
+	consume_output(pending, [&output](std::string_view chunk) {
+		output.stdout_data.append(chunk);
+	});
 
 	return output;
 }
 
 /**
- * TerminalProcess::read_from_pty - 从PTY读取数据到缓冲区（由IO线程调用）
+ * TerminalProcess::consume_output - 从消费位置开始直接取走输出
+ */
+size_t TerminalProcess::consume_output(size_t max_bytes,
+				       const OutputVisitor &visitor)
+{
+	uint64_t start = output_.consumed_seq();
+	uint64_t end = read_output_from(start, max_bytes,
+		[&visitor](uint64_t seq, std::string_view chunk) {
+			(void)seq;
+			visitor(chunk);
+		});
+
+	return static_cast<size_t>(end - start);
+}
+
+/**
+ * TerminalProcess::read_output_from - 从指定序号开始读取输出
  *
- * 这个函数只从PTY读取数据到环形缓冲区，不从缓冲区读取。
+ * 读取的数据此后才允许被丢弃；消费位置前移后如果PTY因为未读
+ * 输出达到上限而暂停，重新激活PTY事件，由IO线程继续读取。
  */
-void TerminalProcess::read_from_pty()
+uint64_t TerminalProcess::read_output_from(uint64_t seq, size_t max_bytes,
+					   const Scrollback::SeqVisitor &visitor)
 {
-	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t before = output_.consumed_seq();
+	uint64_t end = output_.read_from(seq, max_bytes, visitor);
+
+	output_.advance(end);
+	if (output_.consumed_seq() != before)
+		resume_if_throttled();
+
+	return end;
+}
+
+/**
+ * TerminalProcess::output_cursor - 获取消费位置
+ */
+uint64_t TerminalProcess::output_cursor() const
+{
+	return output_.consumed_seq();
+}
+
+/**
+ * TerminalProcess::resume_if_throttled - 消费位置前移后解除PTY的背压
+ *
+ * 与read_from_pty()中的检查配对，见那里的说明。
+ */
+void TerminalProcess::resume_if_throttled()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (throttled_.exchange(false))
+		rearm_pty();
+}
 
+/**
+ * TerminalProcess::read_from_pty - 从PTY读取数据到缓冲区（由IO线程调用）
+ *
+ * 这个函数只从PTY读取数据到回滚缓冲区，不从缓冲区读取。
+ *
+ * 未读输出达到上限时先设置throttled_再检查一次空间：消费位置在
+ * 设置之前的前移由这里继续读取，在设置之后的前移由读取方看到
+ * throttled_并重新激活事件，两种情况都不会丢失唤醒。
+ */
+bool TerminalProcess::read_from_pty()
+{
 	if (info_.pty_fd < 0)
-		return;
+		return false;
 
-	char buffer[8192];
-	ssize_t bytes_read;
+	size_t total = 0;
+	bool closed = false;
 
 	while (true) {
-		bytes_read = read(info_.pty_fd, buffer, sizeof(buffer));
+		std::span<char> span = output_.write_span();
+
+		if (span.empty()) {
+			if (!throttled_.load())
+				throttle_events.add();
+			throttled_.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (output_.write_span().empty() ||
+			    !throttled_.exchange(false))
+				break;
+			continue;
+		}
+
+		ssize_t bytes_read = read(info_.pty_fd, span.data(), span.size());
 
 		if (bytes_read < 0) {
-			if (errno == EAGAIN || errno == EWOULDBLOCK)
-				break;
+			if (errno == EINTR)
+				continue;
+			/* 进程退出后PTY读取返回EIO */
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				closed = true;
 			break;
 		}
 
-		if (bytes_read == 0)
+		if (bytes_read == 0) {
+			closed = true;
 			break;
+		}
 
-		output_buffer_.write(buffer, bytes_read);
+		output_.commit_write(bytes_read);
+		pty_read_bytes.add(bytes_read);
+		total += bytes_read;
 	}
+
+	return total > 0 || closed;
+}
+
+/**
+ * TerminalProcess::set_epoll_fd - 记录PTY所在的epoll实例
+ */
+void TerminalProcess::set_epoll_fd(int epoll_fd)
+{
+	epoll_fd_ = epoll_fd;
+}
+
+/**
+ * TerminalProcess::rearm_pty - 重新激活PTY的边沿触发事件
+ *
+ * 对边沿触发的fd执行EPOLL_CTL_MOD会重新检查就绪状态，PTY中
+ * 还有数据时IO线程会立即收到事件。
+ */
+void TerminalProcess::rearm_pty()
+{
+	std::lock_guard<std::mutex> lock(input_mutex_);
+	update_pty_events_locked();
+}
+
+/**
+ * TerminalProcess::update_pty_events_locked - 按输入队列设置PTY的事件掩码
+ *
+ * 与rearm_pty()共用input_mutex_，两者的EPOLL_CTL_MOD不会互相覆盖。
+ */
+void TerminalProcess::update_pty_events_locked()
+{
+	if (epoll_fd_ < 0)
+		return;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+	if (!input_queue_.empty())
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = &pty_tag_;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, info_.pty_fd, &ev);
 }
 
 /**
@@ -279,10 +417,22 @@ void TerminalProcess::read_from_pty()
 bool TerminalProcess::is_running() const
 {
 	std::lock_guard<std::mutex> lock(mutex_);
+	return is_running_locked();
+}
 
+/**
+ * TerminalProcess::is_running_locked - 检查进程是否运行（调用者持有锁）
+ *
+ * 有pidfd时退出由IO线程通过mark_exited()记录，这里不需要系统调用。
+ */
+bool TerminalProcess::is_running_locked() const
+{
 	if (!info_.is_running)
 		return false;
 
+	if (pid_fd_ >= 0)
+		return true;
+
 	int status;
 	pid_t result = waitpid(info_.pid, &status, WNOHANG);
 
@@ -300,6 +450,45 @@ bool TerminalProcess::is_running() const
 	return true;
 }
 
+/**
+ * TerminalProcess::mark_exited - 记录进程已退出
+ *
+ * SIGCHLD被设置为自动回收时waitpid取不到退出码，exit_code保持-1。
+ */
+void TerminalProcess::mark_exited()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (info_.is_running) {
+		int status;
+		if (waitpid(info_.pid, &status, WNOHANG) > 0 && WIFEXITED(status))
+			info_.exit_code = WEXITSTATUS(status);
+	}
+
+	info_.is_running = false;
+}
+
+/**
+ * TerminalProcess::should_reap - 检查进程是否可以被清理
+ * @now: 当前时间
+ *
+ * 进程结束后缓冲区中可能还有最后一段输出，给读取方一点时间取走，
+ * 避免输出的结尾丢失。
+ */
+bool TerminalProcess::should_reap(time_t now)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (is_running_locked())
+		return false;
+
+	if (finished_time_ == 0)
+		finished_time_ = now;
+
+	return output_.unconsumed() == 0 ||
+	       now - finished_time_ >= TERMINAL_OUTPUT_LINGER_SEC;
+}
+
 /**
  * TerminalProcess::get_pid - 获取进程ID
  */
@@ -318,6 +507,30 @@ int TerminalProcess::get_pty_fd() const
 	return info_.pty_fd;
 }
 
+/**
+ * TerminalProcess::get_pid_fd - 获取pidfd
+ */
+int TerminalProcess::get_pid_fd() const
+{
+	return pid_fd_;
+}
+
+/**
+ * TerminalProcess::pty_tag - 获取PTY事件标签
+ */
+EpollTag *TerminalProcess::pty_tag()
+{
+	return &pty_tag_;
+}
+
+/**
+ * TerminalProcess::exit_tag - 获取退出事件标签
+ */
+EpollTag *TerminalProcess::exit_tag()
+{
+	return &exit_tag_;
+}
+
 /**
  * TerminalProcess::get_command - 获取执行的命令
  */
@@ -372,7 +585,10 @@ void TerminalProcess::kill_process()
  * TerminalManager::TerminalManager - 构造函数
  */
 TerminalManager::TerminalManager()
-	: epoll_fd_(-1), running_(false)
+	: epoll_fd_(-1), running_(false), wake_fd_(-1),
+	  wake_tag_{ EpollTag::Kind::WAKE, nullptr }, unwatched_count_(0),
+	  needs_sweep_(false), scrollback_limit_(SCROLLBACK_DEFAULT_LIMIT),
+	  spill_limit_(SCROLLBACK_DEFAULT_SPILL_LIMIT)
 {
 }
 
@@ -397,6 +613,22 @@ std::expected<void, std::string> TerminalManager::start()
 	if (epoll_fd_ < 0)
 		return std::unexpected(std::format("epoll_create1 failed: {}", strerror(errno)));
 
+	wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &wake_tag_;
+
+	if (wake_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+		std::string error = std::format("eventfd setup failed: {}", strerror(errno));
+		if (wake_fd_ >= 0)
+			close(wake_fd_);
+		close(epoll_fd_);
+		wake_fd_ = -1;
+		epoll_fd_ = -1;
+		return std::unexpected(error);
+	}
+
 	setup_signal_handler();
 
 	running_ = true;
@@ -417,15 +649,22 @@ void TerminalManager::stop()
 		return;
 
 	running_ = false;
+	wake_io_thread();
 
 	if (io_thread_.joinable())
 		io_thread_.join();
 
 	std::lock_guard<std::mutex> lock(processes_mutex_);
 
-	for (auto &[pid, process] : processes_) {
+	for (auto &[pid, process] : processes_)
 		process->terminate();
-		processes_.erase(pid);
+	processes_.clear();
+	finished_.clear();
+	unwatched_count_ = 0;
+
+	if (wake_fd_ >= 0) {
+		close(wake_fd_);
+		wake_fd_ = -1;
 	}
 
 	if (epoll_fd_ >= 0) {
@@ -473,21 +712,45 @@ std::expected<pid_t, std::string> TerminalManager::execute_command(
 	}
 
 	auto process = std::make_unique<TerminalProcess>(pid, pty_fd,
-							 command, working_dir);
+							 command, working_dir,
+							 scrollback_limit_.load(),
+							 spill_limit_.load());
+
+	/* data.ptr直接指向进程，事件分发不需要查表 */
+	process->set_epoll_fd(epoll_fd_);
 
 	struct epoll_event ev;
 	ev.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
-	ev.data.fd = pty_fd;
+	ev.data.ptr = process->pty_tag();
 
 	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pty_fd, &ev) < 0) {
-		close(pty_fd);
+		std::string error = std::format("epoll_ctl failed: {}", strerror(errno));
 		kill(pid, SIGKILL);
-		return std::unexpected(std::format("epoll_ctl failed: {}", strerror(errno)));
+		return std::unexpected(error); /* 析构函数关闭pty_fd */
+	}
+
+	int pid_fd = process->get_pid_fd();
+	if (pid_fd >= 0) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = process->exit_tag();
+
+		if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pid_fd, &ev) < 0) {
+			std::string error = std::format("epoll_ctl failed: {}", strerror(errno));
+			epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, pty_fd, nullptr);
+			kill(pid, SIGKILL);
+			return std::unexpected(error);
+		}
 	}
 
 	std::lock_guard<std::mutex> lock(processes_mutex_);
 	processes_[pid] = std::move(process);
 
+	/* 没有pidfd时退回到定期waitpid检查 */
+	if (pid_fd < 0) {
+		unwatched_count_++;
+		wake_io_thread();
+	}
+
 	return pid;
 }
 
@@ -495,7 +758,7 @@ std::expected<pid_t, std::string> TerminalManager::execute_command(
  * TerminalManager::send_input - 发送输入到进程
  */
 std::expected<void, std::string> TerminalManager::send_input(
-	pid_t pid, const std::string &input)
+	pid_t pid, std::string_view input)
 {
 	std::lock_guard<std::mutex> lock(processes_mutex_);
 
@@ -522,6 +785,52 @@ std::expected<TerminalOutput, std::string> TerminalManager::get_output(pid_t pid
 	return it->second->read_output();
 }
 
+/**
+ * TerminalManager::read_output_from - 不经拷贝地从指定序号读取进程输出
+ */
+std::expected<uint64_t, std::string> TerminalManager::read_output_from(
+	pid_t pid, uint64_t seq, size_t max_bytes,
+	const Scrollback::SeqVisitor &visitor)
+{
+	std::lock_guard<std::mutex> lock(processes_mutex_);
+
+	auto it = processes_.find(pid);
+
+	if (it == processes_.end())
+		return std::unexpected("Process not found");
+
+	return it->second->read_output_from(seq, max_bytes, visitor);
+}
+
+/**
+ * TerminalManager::get_output_cursor - 获取进程输出的消费位置
+ */
+std::expected<uint64_t, std::string> TerminalManager::get_output_cursor(pid_t pid)
+{
+	std::lock_guard<std::mutex> lock(processes_mutex_);
+
+	auto it = processes_.find(pid);
+
+	if (it == processes_.end())
+		return std::unexpected("Process not found");
+
+	return it->second->output_cursor();
+}
+
+/**
+ * TerminalManager::set_scrollback_limits - 设置新进程的输出保留上限
+ * @memory_limit: 每个进程在内存中最多保留的字节数
+ * @spill_limit: 每个进程换出到磁盘最多保留的字节数，0表示不换出
+ *
+ * 只影响之后启动的进程。
+ */
+void TerminalManager::set_scrollback_limits(size_t memory_limit,
+					     size_t spill_limit)
+{
+	scrollback_limit_.store(memory_limit);
+	spill_limit_.store(spill_limit);
+}
+
 /**
  * TerminalManager::set_terminal_size - 设置终端尺寸
  */
@@ -553,6 +862,8 @@ std::expected<void, std::string> TerminalManager::terminate_process(pid_t pid)
 		return std::unexpected("Process not found");
 
 	it->second->terminate();
+	finished_.push_back(pid);
+	wake_io_thread();
 
 	return {};
 }
@@ -570,6 +881,8 @@ std::expected<void, std::string> TerminalManager::kill_process(pid_t pid)
 		return std::unexpected("Process not found");
 
 	it->second->kill_process();
+	finished_.push_back(pid);
+	wake_io_thread();
 
 	return {};
 }
@@ -626,6 +939,14 @@ void TerminalManager::set_output_callback(OutputCallback callback)
 	output_callback_ = callback;
 }
 
+/**
+ * TerminalManager::set_output_ready_callback - 设置输出就绪通知回调
+ */
+void TerminalManager::set_output_ready_callback(OutputReadyCallback callback)
+{
+	output_ready_callback_ = callback;
+}
+
 /**
  * TerminalManager::io_thread_func - IO线程函数
  */
@@ -639,43 +960,73 @@ void TerminalManager::io_thread_func(std::stop_token token)
 
 /**
  * TerminalManager::handle_epoll_events - 处理epoll事件
+ *
+ * 事件标签直接给出进程，PTY读取不需要持有processes_mutex_。
+ * 进程只会在IO线程中被清理，因此同一批事件中的标签都有效。
  */
 void TerminalManager::handle_epoll_events()
 {
 	struct epoll_event events[MAX_EPOLL_EVENTS];
+	int timeout = needs_sweep_ ? EPOLL_TIMEOUT_MS : -1;
 
-	int nfds = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, EPOLL_TIMEOUT_MS);
+	int nfds = epoll_wait(epoll_fd_, events, MAX_EPOLL_EVENTS, timeout);
 
 	if (nfds < 0) {
 		if (errno == EINTR)
 			return;
 
-		std::cerr << std::format("epoll_wait failed: {}", strerror(errno))
-			  << std::endl;
+		log_error("epoll_wait failed: {}", strerror(errno));
 		return;
 	}
 
+	std::vector<pid_t> ready;
+	std::vector<pid_t> exited;
+
 	for (int i = 0; i < nfds; ++i) {
-		int fd = events[i].data.fd;
+		auto *tag = static_cast<EpollTag *>(events[i].data.ptr);
 
+		switch (tag->kind) {
+		case EpollTag::Kind::WAKE: {
+			uint64_t value;
+			ssize_t ret = read(wake_fd_, &value, sizeof(value));
+			(void)ret;
+			break;
+		}
+		case EpollTag::Kind::PTY:
+			/* 只有输入队列非空时才注册了EPOLLOUT */
+			if (events[i].events & EPOLLOUT)
+				tag->process->flush_input();
+
+			/* IO线程只从PTY读取数据到缓冲区，不调用read_output() */
+			if ((events[i].events & ~EPOLLOUT) &&
+			    tag->process->read_from_pty())
+				ready.push_back(tag->process->get_pid());
+			break;
+		case EpollTag::Kind::EXIT:
+			/*
+			 * 进程已退出：先取走PTY中剩余的输出再标记结束，
+			 * 读取方看到进程结束时缓冲区里已经是全部输出
+			 */
+			tag->process->read_from_pty();
+			tag->process->mark_exited();
+			epoll_ctl(epoll_fd_, EPOLL_CTL_DEL,
+				  tag->process->get_pid_fd(), nullptr);
+			exited.push_back(tag->process->get_pid());
+			break;
+		}
+	}
+
+	if (!exited.empty()) {
 		std::lock_guard<std::mutex> lock(processes_mutex_);
+		finished_.insert(finished_.end(), exited.begin(), exited.end());
+	}
 
-		for (auto &[pid, process] : processes_) {
-			if (process->get_pty_fd() == fd) {
-						/* IO线程只从PTY读取数据到缓冲区，不调用read_output() */
-						process->read_from_pty();
-			
-						/* 获取进程状态，检查是否结束 */
-						bool is_eof = false;
-						if (!process->is_running())
-							is_eof = true;
-			
-						if (is_eof) {
-							epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
-						}
-			
-						break;
-					}		}
+	/* 不持有锁时通知，接收方可以直接调用get_output() */
+	if (output_ready_callback_) {
+		for (pid_t pid : ready)
+			output_ready_callback_(pid);
+		for (pid_t pid : exited)
+			output_ready_callback_(pid);
 	}
 }
 
@@ -684,26 +1035,79 @@ void TerminalManager::handle_epoll_events()
  */
 void TerminalManager::cleanup_finished_processes()
 {
-	std::lock_guard<std::mutex> lock(processes_mutex_);
+	std::vector<pid_t> reaped;
+	time_t now = time(nullptr);
+
+	{
+		std::lock_guard<std::mutex> lock(processes_mutex_);
 
-	auto it = processes_.begin();
+		/* 没有pidfd的进程只能逐个waitpid检查 */
+		if (unwatched_count_ > 0) {
+			for (const auto &[pid, process] : processes_) {
+				if (process->get_pid_fd() < 0 &&
+				    !process->is_running() &&
+				    std::find(finished_.begin(), finished_.end(),
+					      pid) == finished_.end())
+					finished_.push_back(pid);
+			}
+		}
+
+		auto it = finished_.begin();
+
+		while (it != finished_.end()) {
+			auto process = processes_.find(*it);
+
+			if (process == processes_.end()) {
+				it = finished_.erase(it);
+				continue;
+			}
+
+			if (!process->second->should_reap(now)) {
+				++it;
+				continue;
+			}
 
-	while (it != processes_.end()) {
-		if (!it->second->is_running()) {
 			/* 不向用户输出进程信息 */
-			/* std::cout << std::format("Process {} finished", it->first) << std::endl; */
+			/* std::cout << std::format("Process {} finished", *it) << std::endl; */
 
-			int fd = it->second->get_pty_fd();
+			int fd = process->second->get_pty_fd();
 			if (fd >= 0)
 				epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
 
-			it = processes_.erase(it);
-		} else {
-			++it;
+			int pid_fd = process->second->get_pid_fd();
+			if (pid_fd >= 0)
+				epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, pid_fd, nullptr);
+			else
+				unwatched_count_--;
+
+			reaped.push_back(*it);
+			processes_.erase(process);
+			it = finished_.erase(it);
 		}
+
+		needs_sweep_ = !finished_.empty() || unwatched_count_ > 0;
+	}
+
+	/* 通知读取方进程已被清理 */
+	if (output_ready_callback_) {
+		for (pid_t pid : reaped)
+			output_ready_callback_(pid);
 	}
 }
 
+/**
+ * TerminalManager::wake_io_thread - 唤醒阻塞在epoll_wait中的IO线程
+ */
+void TerminalManager::wake_io_thread()
+{
+	if (wake_fd_ < 0)
+		return;
+
+	uint64_t one = 1;
+	ssize_t ret = write(wake_fd_, &one, sizeof(one));
+	(void)ret;
+}
+
 /**
  * TerminalManager::setup_signal_handler - 设置SIGCHLD信号处理器
  */
@@ -818,92 +1222,80 @@ std::expected<pid_t, std::string> launch_with_detection(
 		/* 创建进程启动器 */
 		ProcessLauncher launcher;
 
-		/* 检测并启动进程 */
-		auto launch_result = launcher.launch_with_detection(
-			exec_str, parsed.args, working_dir);
+		/* 已知是CLI程序时不再检测，直接交给 terminal_helper */
+		if (ProcessLauncher::cached_type(exec_str) != ProcessType::CLI) {
+			/* 检测并启动进程 */
+			auto launch_result = launcher.launch_with_detection(
+				exec_str, parsed.args, working_dir);
 
-		if (!launch_result)
-			return std::unexpected(launch_result.error());
+			if (!launch_result)
+				return std::unexpected(launch_result.error());
+
+			/* GUI程序：已直接启动，返回PID */
+			if (launch_result->type == ProcessType::GUI)
+				return launch_result->pid;
 
-		/* 根据检测结果处理 */
-		if (launch_result->type == ProcessType::CLI) {
-			/* CLI程序：使用 terminal_helper 独立程序运行 */
-			/* 终止 PTY 进程 */
+			/* CLI程序：终止检测用的 PTY 进程，改用 terminal_helper 运行 */
 			close(launch_result->pty_fd);
-			kill(launch_result->pid, SIGTERM);
-
-			/* 快速等待 */
-			for (int i = 0; i < 10; i++) {
-				int status;
-				pid_t result = waitpid(launch_result->pid, &status, WNOHANG);
-				if (result == launch_result->pid)
-					break;
-				usleep(10000); /* 10ms * 10 = 100ms */
-			}
+			launcher.terminate_process(launch_result->pid, 100);
+		}
 
-			kill(launch_result->pid, SIGKILL);
-			waitpid(launch_result->pid, nullptr, WNOHANG);
+		/* 构建命令字符串 */
+		std::string cmd = exec_str;
+		for (const auto &arg : parsed.args) {
+			cmd += " " + arg;
+		}
 
-			/* 构建命令字符串 */
-			std::string cmd = exec_str;
-			for (const auto &arg : parsed.args) {
-				cmd += " " + arg;
-			}
+		/* 启动 terminal_helper 独立程序 */
+		pid_t helper_pid = fork();
 
-			/* 启动 terminal_helper 独立程序 */
-			pid_t helper_pid = fork();
-
-			if (helper_pid < 0)
-				return std::unexpected("fork failed");
-
-			if (helper_pid == 0) {
-				/* 子进程：执行 terminal_helper */
-				/* 优先从当前目录查找，然后检查系统安装路径 */
-				const char *helper_path = nullptr;
-
-				if (access("./terminal_helper", X_OK) == 0) {
-					helper_path = "./terminal_helper";
-				} else if (access("/usr/local/bin/terminal_helper", X_OK) == 0) {
-					helper_path = "/usr/local/bin/terminal_helper";
-				} else if (access("/usr/bin/terminal_helper", X_OK) == 0) {
-					helper_path = "/usr/bin/terminal_helper";
-				} else if (access("/usr/share/mikufy/terminal_helper", X_OK) == 0) {
-					/* RPM/DEB包安装路径 */
-					helper_path = "/usr/share/mikufy/terminal_helper";
-				} else {
-					/* 用户级安装路径 */
-					const char *home = getenv("HOME");
-					if (home) {
-						char user_path[512];
-						snprintf(user_path, sizeof(user_path), "%s/.local/share/MIKUFY/terminal_helper", home);
-						if (access(user_path, X_OK) == 0) {
-							helper_path = user_path;
-						} else if (access("/opt/mikufy/terminal_helper", X_OK) == 0) {
-							/* 可选安装路径 */
-							helper_path = "/opt/mikufy/terminal_helper";
-						} else {
-							_exit(127);
-						}
+		if (helper_pid < 0)
+			return std::unexpected("fork failed");
+
+		if (helper_pid == 0) {
+			/* 子进程：执行 terminal_helper */
+			/* 优先从当前目录查找，然后检查系统安装路径 */
+			const char *helper_path = nullptr;
+
+			if (access("./terminal_helper", X_OK) == 0) {
+				helper_path = "./terminal_helper";
+			} else if (access("/usr/local/bin/terminal_helper", X_OK) == 0) {
+				helper_path = "/usr/local/bin/terminal_helper";
+			} else if (access("/usr/bin/terminal_helper", X_OK) == 0) {
+				helper_path = "/usr/bin/terminal_helper";
+			} else if (access("/usr/share/mikufy/terminal_helper", X_OK) == 0) {
+				/* RPM/DEB包安装路径 */
+				helper_path = "/usr/share/mikufy/terminal_helper";
+			} else {
+				/* 用户级安装路径 */
+				const char *home = getenv("HOME");
+				if (home) {
+					char user_path[512];
+					snprintf(user_path, sizeof(user_path), "%s/.local/share/MIKUFY/terminal_helper", home);
+					if (access(user_path, X_OK) == 0) {
+						helper_path = user_path;
+					} else if (access("/opt/mikufy/terminal_helper", X_OK) == 0) {
+						/* 可选安装路径 */
+						helper_path = "/opt/mikufy/terminal_helper";
 					} else {
 						_exit(127);
 					}
+				} else {
+					_exit(127);
 				}
-
-				/* 使用 posix_spawn 加速启动 */
-				char *argv[] = { (char *)"terminal_helper",
-						(char *)cmd.c_str(),
-						(char *)working_dir.c_str(),
-						nullptr };
-				execv(helper_path, argv);
-				_exit(127);
 			}
 
-			/* 返回 terminal_helper 的 PID */
-			return helper_pid;
-		} else {
-			/* GUI程序：已直接启动，返回PID */
-			return launch_result->pid;
+			/* 使用 posix_spawn 加速启动 */
+			char *argv[] = { (char *)"terminal_helper",
+					(char *)cmd.c_str(),
+					(char *)working_dir.c_str(),
+					nullptr };
+			execv(helper_path, argv);
+			_exit(127);
 		}
+
+		/* 返回 terminal_helper 的 PID */
+		return helper_pid;
 	} else {
 		/* 不是 ./xxx 命令，直接使用 terminal_helper 运行 */
 		/* 比如：python3 hello.py, ls -la 等命令 */
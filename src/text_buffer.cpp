@@ -14,9 +14,37 @@
  */
 
 #include "../headers/text_buffer.h"
-#include <iostream>
+#include "../headers/metrics.h"
+#include "../headers/logger.h"
 #include <cstring>
 #include <format>
+#include <climits>		/* PATH_MAX */
+#include <cstdlib>		/* mkostemp(), realpath() */
+#include <sys/uio.h>		/* writev() */
+
+/* 编辑耗时（持有写锁期间），按操作区分 */
+static MetricHistogram &insert_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_edit_seconds", "TextBuffer编辑耗时（持有写锁期间）",
+	Metrics::label("op", "insert"));
+static MetricHistogram &delete_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_edit_seconds", "", Metrics::label("op", "delete"));
+static MetricHistogram &replace_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_edit_seconds", "", Metrics::label("op", "replace"));
+static MetricHistogram &undo_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_edit_seconds", "", Metrics::label("op", "undo"));
+static MetricHistogram &redo_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_edit_seconds", "", Metrics::label("op", "redo"));
+
+/* 加载（含同步建立的索引）和后台索引的耗时 */
+static MetricHistogram &load_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_load_seconds", "TextBuffer加载文件耗时（含同步索引）");
+static MetricHistogram &index_latency = Metrics::instance().histogram(
+	"mikufy_textbuffer_index_seconds", "TextBuffer后台索引耗时");
+
+/* 经过词法分析的行数（滚动未修改的区域时不增长） */
+static MetricCounter &syntax_lines = Metrics::instance().counter(
+	"mikufy_textbuffer_syntax_lines_total",
+	"经过语法词法分析的行数");
 
 /*
  * ============================================================================
@@ -27,27 +55,23 @@
 /**
  * TextBuffer - 构造函数
  *
- * 初始化文本缓冲区，预分配添加缓冲区。
+ * 初始化文本缓冲区。添加缓冲区在第一次编辑时才分配。
  */
 TextBuffer::TextBuffer(void)
 	: mmap_data(nullptr)
 	, mmap_size(0)
 	, mmap_fd(-1)
-	, add_buffer(nullptr)
-	, add_buffer_size(INITIAL_ADD_BUFFER_SIZE)
-	, add_buffer_used(0)
-	, line_cache_valid(false)
+	, compacted(false)
+	, syntax_language(nullptr)
+	, syntax_valid(0)
 	, line_count(0)
 	, char_count(0)
+	, index_cancel(false)
+	, indexing(false)
+	, history_memory(0)
+	, history_limit(UNDO_MEMORY_LIMIT)
+	, coalesce_break(true)
 {
-	/*
-	 * 预分配添加缓冲区
-	 */
-	add_buffer = new char[add_buffer_size];
-	if (!add_buffer) {
-		std::cerr << "无法分配添加缓冲区内存" << std::endl;
-		add_buffer_size = 0;
-	}
 }
 
 /**
@@ -58,10 +82,6 @@ TextBuffer::TextBuffer(void)
 TextBuffer::~TextBuffer(void)
 {
 	close();
-	if (add_buffer) {
-		delete[] add_buffer;
-		add_buffer = nullptr;
-	}
 }
 
 /*
@@ -77,19 +97,22 @@ TextBuffer::~TextBuffer(void)
  */
 bool TextBuffer::load_file(const std::string &path)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	stop_indexing();
+
+	std::lock_guard<RwMutex> lock(mutex);
+	MetricTimer timer(load_latency);
 
 	/*
 	 * 先关闭之前的映射
 	 */
-	close();
+	close_locked();
 
 	/*
 	 * 打开文件
 	 */
 	mmap_fd = open(path.c_str(), O_RDONLY);
 	if (mmap_fd < 0) {
-		std::cerr << std::format("无法打开文件: {}", path) << std::endl;
+		log_warn("无法打开文件: {}", path);
 		return false;
 	}
 
@@ -98,7 +121,7 @@ bool TextBuffer::load_file(const std::string &path)
 	 */
 	struct stat st;
 	if (fstat(mmap_fd, &st) < 0) {
-		std::cerr << std::format("无法获取文件大小: {}", path) << std::endl;
+		log_warn("无法获取文件大小: {}", path);
 		::close(mmap_fd);
 		mmap_fd = -1;
 		return false;
@@ -110,32 +133,55 @@ bool TextBuffer::load_file(const std::string &path)
 	 * 检查文件大小限制
 	 */
 	if (mmap_size > MAX_FILE_SIZE) {
-		std::cerr << std::format("文件过大: {} 字节", mmap_size) << std::endl;
+		log_warn("文件过大: {} 字节", mmap_size);
 		::close(mmap_fd);
 		mmap_fd = -1;
+		mmap_size = 0;
 		return false;
 	}
 
 	/*
-	 * mmap 映射文件
+	 * mmap 映射文件（空文件不能映射）
 	 */
-	mmap_data = static_cast<char *>(
-		mmap(nullptr, mmap_size, PROT_READ, MAP_PRIVATE, mmap_fd, 0));
+	if (mmap_size > 0) {
+		mmap_data = static_cast<char *>(
+			mmap(nullptr, mmap_size, PROT_READ, MAP_PRIVATE, mmap_fd, 0));
+
+		if (mmap_data == MAP_FAILED) {
+			log_error("mmap 失败: {}", strerror(errno));
+			::close(mmap_fd);
+			mmap_fd = -1;
+			mmap_data = nullptr;
+			mmap_size = 0;
+			return false;
+		}
+	}
 
-	if (mmap_data == MAP_FAILED) {
-		std::cerr << std::format("mmap 失败: {}", strerror(errno)) << std::endl;
-		::close(mmap_fd);
-		mmap_fd = -1;
-		mmap_data = nullptr;
-		return false;
+	/*
+	 * 建立原始缓冲区的换行符索引
+	 *
+	 * 大文件只同步扫描开头部分，足够显示第一屏；其余部分交给
+	 * 后台线程，完整行数稍后通过 get_line_count() 获得。
+	 */
+	original_line_feeds.clear();
+	indexing = (mmap_size >= ASYNC_INDEX_MIN_SIZE);
+
+	if (indexing) {
+		madvise(mmap_data, mmap_size, MADV_SEQUENTIAL);
+		scan_line_feeds(mmap_data, 0, INDEX_PREFIX_SIZE,
+				original_line_feeds);
+	} else {
+		build_line_feed_index(mmap_data, 0, mmap_size,
+				      original_line_feeds);
 	}
 
 	/*
 	 * 创建初始 Piece（指向整个原始缓冲区）
 	 */
-	pieces.clear();
 	if (mmap_size > 0) {
-		pieces.push_back(Piece(PieceType::ORIGINAL, 0, mmap_size));
+		pieces.insert_before(nullptr,
+				     Piece(PieceType::ORIGINAL, 0, mmap_size),
+				     original_line_feeds.size());
 	}
 
 	/*
@@ -143,19 +189,18 @@ bool TextBuffer::load_file(const std::string &path)
 	 */
 	file_path = path;
 
-	/*
-	 * 重建行缓存
-	 */
-	rebuild_line_cache();
-
 	/*
 	 * 计算统计信息
 	 */
-	line_count = line_cache.size();
-	char_count = mmap_size;
+	update_statistics();
 
-	std::cout << std::format("文件加载成功: {}, 大小: {} 字节, 行数: {}",
-				 path, mmap_size, line_count) << std::endl;
+	if (indexing) {
+		index_cancel = false;
+		index_thread = std::thread(&TextBuffer::index_worker, this);
+	}
+
+	log_debug("文件加载成功: {}, 大小: {} 字节, 行数: {}{}", path, mmap_size,
+		  line_count, indexing ? "（后台索引中）" : "");
 
 	return true;
 }
@@ -167,8 +212,17 @@ bool TextBuffer::load_file(const std::string &path)
  */
 void TextBuffer::close(void)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	stop_indexing();
+
+	std::lock_guard<RwMutex> lock(mutex);
+	close_locked();
+}
 
+/**
+ * close_locked - 关闭文件映射（调用者持有锁）
+ */
+void TextBuffer::close_locked(void)
+{
 	/*
 	 * 解除 mmap 映射
 	 */
@@ -191,15 +245,14 @@ void TextBuffer::close(void)
 	mmap_size = 0;
 
 	/*
-	 * 清空 Piece 列表
+	 * 清空 Piece 树和换行符索引
 	 */
 	pieces.clear();
-
-	/*
-	 * 清空行缓存
-	 */
-	line_cache.clear();
-	line_cache_valid = false;
+	original_line_feeds.clear();
+	add_line_feeds.clear();
+	std::vector<size_t>().swap(original_checkpoints);
+	compacted = false;
+	reset_syntax_locked();
 
 	/*
 	 * 重置统计信息
@@ -208,9 +261,10 @@ void TextBuffer::close(void)
 	char_count = 0;
 
 	/*
-	 * 重置添加缓冲区
+	 * 清空撤销历史（Piece 引用的缓冲区即将释放），释放添加缓冲区
 	 */
-	add_buffer_used = 0;
+	clear_history_locked();
+	add_buffer.clear();
 
 	/*
 	 * 清空文件路径
@@ -226,10 +280,19 @@ void TextBuffer::close(void)
 
 size_t TextBuffer::get_line_count(void)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<RwMutex> lock(mutex);
 	return line_count;
 }
 
+/**
+ * is_indexing - 是否正在后台建立换行符索引
+ */
+bool TextBuffer::is_indexing(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return indexing;
+}
+
 /**
  * get_char_count - 获取总字符数
  *
@@ -239,7 +302,7 @@ size_t TextBuffer::get_line_count(void)
  */
 size_t TextBuffer::get_char_count(void)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<RwMutex> lock(mutex);
 	return char_count;
 }
 
@@ -250,61 +313,260 @@ size_t TextBuffer::get_char_count(void)
  */
 bool TextBuffer::get_line(size_t line, std::string &content)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<RwMutex> lock(mutex);
 
-	if (!line_cache_valid || line >= line_cache.size())
+	if (line >= line_count)
 		return false;
 
-	const LineInfo &info = line_cache[line];
+	size_t start = line_start(line);
+	size_t end = line_end(line);
 
-	/*
-	 * 获取行内容
-	 */
-	return get_text(info.start_index, info.start_index + info.length,
-		       content);
+	content.clear();
+	if (end == start)
+		return true; /* 空行 */
+
+	return get_text_locked(start, end, content);
 }
 
 /**
  * get_lines - 获取指定行范围的内容
  *
  * 获取从 start_line 到 end_line 的所有行内容。
+ * 基于 visit_lines_locked()，只在这里把视图复制成字符串。
  */
 bool TextBuffer::get_lines(size_t start_line, size_t end_line,
 			   std::vector<std::string> &lines)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<RwMutex> lock(mutex);
+
+	if (end_line > start_line)
+		lines.reserve(lines.size() +
+			      std::min(end_line, line_count) -
+			      std::min(start_line, line_count));
+
+	return visit_lines_locked(start_line, end_line,
+		[&lines](size_t line, std::span<const std::string_view> fragments) {
+			(void)line;
+			std::string &content = lines.emplace_back();
+			for (std::string_view fragment : fragments)
+				content.append(fragment);
+		});
+}
+
+/**
+ * visit_lines - 零拷贝遍历指定行范围
+ */
+bool TextBuffer::visit_lines(size_t start_line, size_t end_line,
+			     const LineVisitor &visitor)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return visit_lines_locked(start_line, end_line, visitor);
+}
 
-	if (!line_cache_valid)
-		return false;
+/**
+ * visit_chunks - 零拷贝按顺序遍历所有 Piece 的内容
+ */
+bool TextBuffer::visit_chunks(const ChunkVisitor &visitor)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+
+	for (PieceNode *node = pieces.first(); node; node = pieces.next(node)) {
+		const Piece &piece = node->piece;
+		if (piece.length > 0 &&
+		    !visitor(std::string_view(piece_data(piece), piece.length)))
+			return false;
+	}
 
+	return true;
+}
+
+/**
+ * visit_lines_locked - 零拷贝遍历指定行范围（调用者持有锁）
+ *
+ * 起始位置通过换行符索引定位（O(log n)），之后沿中序遍历顺序
+ * 用 memchr 在每个 Piece 内寻找行尾，整个窗口只遍历一次。
+ */
+bool TextBuffer::visit_lines_locked(size_t start_line, size_t end_line,
+				    const LineVisitor &visitor)
+{
 	/*
 	 * 修正行号范围
 	 */
-	if (start_line >= line_cache.size())
-		start_line = line_cache.size();
-	if (end_line > line_cache.size())
-		end_line = line_cache.size();
+	if (start_line >= line_count)
+		start_line = line_count;
+	if (end_line > line_count)
+		end_line = line_count;
 	if (start_line >= end_line)
 		return false;
 
+	PieceNode *node;
+	size_t offset_in_piece;
+	size_t start = line_start(start_line);
+	if (!find_piece_for_position(start, node, offset_in_piece))
+		return false;
+
 	/*
-	 * 预分配空间
+	 * 一行通常只落在一两个 Piece 内，分段数组在窗口内复用
 	 */
-	lines.reserve(end_line - start_line);
+	std::vector<std::string_view> fragments;
+	fragments.reserve(4);
+
+	size_t line = start_line;
+	while (line < end_line && node) {
+		const Piece &piece = node->piece;
+		const char *data = piece_data(piece) + offset_in_piece;
+		size_t length = piece.length - offset_in_piece;
+		const char *feed = static_cast<const char *>(
+			memchr(data, '\n', length));
+
+		if (!feed) {
+			/* 行延续到下一个 Piece */
+			if (length > 0)
+				fragments.emplace_back(data, length);
+			node = pieces.next(node);
+			offset_in_piece = 0;
+			continue;
+		}
+
+		size_t line_length = feed - data;
+		if (line_length > 0)
+			fragments.emplace_back(data, line_length);
+		visitor(line, fragments);
+		fragments.clear();
+		line++;
+
+		offset_in_piece += line_length + 1;
+		if (offset_in_piece == piece.length) {
+			node = pieces.next(node);
+			offset_in_piece = 0;
+		}
+	}
 
 	/*
-	 * 逐行获取内容
+	 * 文档末尾没有换行符的最后一行
 	 */
-	for (size_t i = start_line; i < end_line; ++i) {
-		std::string line_content;
-		if (!get_line(i, line_content))
-			return false;
-		lines.push_back(std::move(line_content));
-	}
+	if (line < end_line)
+		visitor(line, fragments);
 
 	return true;
 }
 
+/**
+ * visit_tokens - 遍历指定行范围及其词法单元
+ *
+ * 整个范围只遍历一次：从 min(start_line, 第一个待确认的行 - 1) 开始，
+ * 待确认的边界行（frontier）分析后更新下一行的状态；收敛后边界跳到
+ * 下一处修改，其间窗口之前的行只被 visit_lines_locked() 经过，不再
+ * 分析。窗口内的行总是分析一次以生成词法单元。
+ */
+bool TextBuffer::visit_tokens(size_t start_line, size_t end_line,
+			      const TokenVisitor &visitor)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+
+	if (end_line > line_count)
+		end_line = line_count;
+	if (start_line >= end_line)
+		return false;
+
+	/* 跨越多个 Piece 的行拼接到复用的缓冲区中 */
+	std::string joined;
+	const auto join = [&joined](std::span<const std::string_view> fragments) {
+		if (fragments.size() == 1)
+			return fragments[0];
+
+		joined.clear();
+		for (std::string_view fragment : fragments)
+			joined.append(fragment);
+		return std::string_view(joined);
+	};
+
+	if (!syntax_language)
+		return visit_lines_locked(start_line, end_line,
+			[&visitor, &join](size_t line,
+					  std::span<const std::string_view> fragments) {
+				visitor(line, join(fragments), {});
+			});
+
+	std::lock_guard<std::mutex> syntax_lock(syntax_mutex);
+	const SyntaxLanguage &language = *syntax_language;
+
+	/* 第一次使用或后台索引期间新增的行先标记为待确认 */
+	if (syntax_states.size() < line_count)
+		syntax_states.resize(line_count, SYNTAX_STATE_DIRTY);
+	if (syntax_valid == 0) {
+		syntax_states[0] = SYNTAX_STATE_INITIAL;
+		syntax_valid = 1;
+	}
+
+	std::vector<SyntaxToken> tokens;
+	size_t lexed = 0;
+
+	bool ok = visit_lines_locked(std::min(start_line, syntax_valid - 1),
+				     end_line,
+		[&](size_t line, std::span<const std::string_view> fragments) {
+			const bool frontier = (line + 1 == syntax_valid);
+			const bool in_window = (line >= start_line);
+			if (!frontier && !in_window)
+				return;
+
+			const std::string_view text = join(fragments);
+			tokens.clear();
+			const uint8_t next = language.lex_line(text,
+				syntax_states[line] & SYNTAX_STATE_MASK,
+				in_window ? &tokens : nullptr);
+			lexed++;
+
+			if (frontier) {
+				const size_t next_line = line + 1;
+				if (next_line >= syntax_states.size()) {
+					syntax_valid = next_line;
+				} else if (syntax_states[next_line] == next) {
+					/* 收敛：到下一处修改之前的状态都正确 */
+					auto dirty = std::find_if(
+						syntax_states.begin() + next_line + 1,
+						syntax_states.end(),
+						[](uint8_t state) {
+							return (state & SYNTAX_STATE_DIRTY) != 0;
+						});
+					syntax_valid = dirty - syntax_states.begin();
+				} else {
+					syntax_states[next_line] = next;
+					syntax_valid = next_line + 1;
+				}
+			}
+
+			if (in_window)
+				visitor(line, text, tokens);
+		});
+
+	syntax_lines.add(lexed);
+	return ok;
+}
+
+/**
+ * set_language - 设置语法高亮的语言
+ */
+void TextBuffer::set_language(const SyntaxLanguage *language)
+{
+	std::lock_guard<RwMutex> lock(mutex);
+
+	if (syntax_language == language)
+		return;
+
+	syntax_language = language;
+	reset_syntax_locked();
+}
+
+/**
+ * get_language - 当前的词法规则
+ */
+const SyntaxLanguage *TextBuffer::get_language(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return syntax_language;
+}
+
 /**
  * get_text - 获取指定索引范围的文本
  *
@@ -313,12 +575,22 @@ bool TextBuffer::get_lines(size_t start_line, size_t end_line,
 bool TextBuffer::get_text(size_t start_pos, size_t end_pos,
 			  std::string &text)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_lock<RwMutex> lock(mutex);
+	return get_text_locked(start_pos, end_pos, text);
+}
 
+/**
+ * get_text_locked - 获取指定索引范围的文本（调用者持有锁）
+ *
+ * 定位起始 Piece 为 O(log n)，之后沿中序遍历顺序复制。
+ */
+bool TextBuffer::get_text_locked(size_t start_pos, size_t end_pos,
+				 std::string &text)
+{
 	/*
 	 * 检查范围有效性
 	 */
-	size_t total_chars = get_char_count();
+	size_t total_chars = pieces.length();
 	if (start_pos > total_chars)
 		start_pos = total_chars;
 	if (end_pos > total_chars)
@@ -329,8 +601,9 @@ bool TextBuffer::get_text(size_t start_pos, size_t end_pos,
 	/*
 	 * 查找起始 Piece
 	 */
-	size_t piece_index, offset_in_piece;
-	if (!find_piece_for_position(start_pos, piece_index, offset_in_piece))
+	PieceNode *node;
+	size_t offset_in_piece;
+	if (!find_piece_for_position(start_pos, node, offset_in_piece))
 		return false;
 
 	/*
@@ -339,47 +612,17 @@ bool TextBuffer::get_text(size_t start_pos, size_t end_pos,
 	text.clear();
 	text.reserve(end_pos - start_pos);
 
-	size_t current_pos = start_pos;
-
-	while (piece_index < pieces.size() && current_pos < end_pos) {
-		const Piece &piece = pieces[piece_index];
+	size_t remaining = end_pos - start_pos;
 
-		/*
-		 * 计算当前 Piece 的可用范围
-		 */
-		size_t piece_start = offset_in_piece;
-		size_t piece_end = piece.length;
-		size_t copy_start = piece_start;
-		size_t copy_end = piece_end;
-
-		/*
-		 * 调整到请求范围内
-		 */
-		if (current_pos < start_pos) {
-			copy_start = offset_in_piece - (start_pos - current_pos);
-		}
+	while (node && remaining > 0) {
+		const Piece &piece = node->piece;
+		size_t copy_length = std::min(piece.length - offset_in_piece,
+					      remaining);
 
-		size_t remaining = end_pos - current_pos;
-		if (copy_end - copy_start > remaining) {
-			copy_end = copy_start + remaining;
-		}
+		text.append(piece_data(piece) + offset_in_piece, copy_length);
 
-		/*
-		 * 提取文本
-		 */
-		const char *buffer = (piece.type == PieceType::ORIGINAL) ?
-					     mmap_data :
-					     add_buffer;
-		size_t buffer_offset = piece.offset + copy_start;
-		size_t copy_length = copy_end - copy_start;
-
-		text.append(buffer + buffer_offset, copy_length);
-
-		/*
-		 * 更新位置
-		 */
-		current_pos += copy_length;
-		piece_index++;
+		remaining -= copy_length;
+		node = pieces.next(node);
 		offset_in_piece = 0;
 	}
 
@@ -399,31 +642,48 @@ bool TextBuffer::get_text(size_t start_pos, size_t end_pos,
  */
 bool TextBuffer::insert(size_t pos, const std::string &text)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<RwMutex> lock(mutex);
+	wait_for_index(lock);
+	MetricTimer timer(insert_latency);
 
 	if (text.empty())
 		return true;
 
-	/*
-	 * 检查位置有效性
-	 */
-	size_t total_chars = get_char_count();
-	if (pos > total_chars)
-		pos = total_chars;
+	if (pos > pieces.length())
+		pos = pieces.length();
 
-	/*
-	 * 查找插入位置的 Piece
-	 */
-	size_t piece_index, offset_in_piece;
-	if (!find_piece_for_position(pos, piece_index, offset_in_piece))
+	const size_t first_line = find_line_for_position(pos);
+
+	EditRecord record;
+	Piece piece;
+	if (!insert_locked(pos, text, &piece))
 		return false;
 
+	record.pos = pos;
+	record.inserted.push_back(piece);
+	record.inserted_length = piece.length;
+	record_edit_locked(std::move(record));
+
+	update_statistics();
+	invalidate_syntax_locked(first_line, first_line,
+				 find_line_for_position(pos + piece.length));
+
+	return true;
+}
+
+/**
+ * insert_locked - 插入文本（调用者持有锁）
+ *
+ * 文本追加到添加缓冲区，再把指向它的新 Piece 插入到 pos。
+ */
+bool TextBuffer::insert_locked(size_t pos, const std::string &text,
+			       Piece *inserted)
+{
 	/*
-	 * 如果不在 Piece 开头，需要分割
+	 * 检查位置有效性
 	 */
-	if (offset_in_piece > 0) {
-		split_piece(piece_index, offset_in_piece);
-	}
+	if (pos > pieces.length())
+		pos = pieces.length();
 
 	/*
 	 * 追加文本到添加缓冲区
@@ -432,21 +692,38 @@ bool TextBuffer::insert(size_t pos, const std::string &text)
 	if (!append_to_add_buffer(text, add_offset))
 		return false;
 
-	/*
-	 * 创建新 Piece 并插入
-	 */
 	Piece new_piece(PieceType::ADD, add_offset, text.length());
-	pieces.insert(pieces.begin() + piece_index, new_piece);
+	if (inserted)
+		*inserted = new_piece;
 
+	return insert_piece_locked(pos, new_piece);
+}
+
+/**
+ * insert_piece_locked - 在 pos 处插入一个 Piece（调用者持有锁）
+ *
+ * 插入位置落在 Piece 中间时先分割该 Piece，新 Piece 插入到分割点
+ * 之前；能与前一个 Piece 合并时直接扩展前一个 Piece。
+ */
+bool TextBuffer::insert_piece_locked(size_t pos, const Piece &piece)
+{
 	/*
-	 * 尝试合并相邻 Pieces
+	 * 查找插入位置的 Piece，不在 Piece 开头时需要分割
 	 */
-	merge_pieces(piece_index);
+	PieceNode *node;
+	size_t offset_in_piece;
+	if (!find_piece_for_position(pos, node, offset_in_piece))
+		return false;
+
+	if (node && offset_in_piece > 0)
+		node = split_piece(node, offset_in_piece);
 
 	/*
-	 * 重建行缓存
+	 * 尝试合并到前一个 Piece，否则插入新 Piece
 	 */
-	rebuild_line_cache();
+	PieceNode *prev = node ? pieces.prev(node) : pieces.last();
+	if (!merge_pieces(prev, piece))
+		pieces.insert_before(node, piece, count_line_feeds(piece));
 
 	return true;
 }
@@ -458,12 +735,45 @@ bool TextBuffer::insert(size_t pos, const std::string &text)
  */
 bool TextBuffer::delete_range(size_t start_pos, size_t end_pos)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<RwMutex> lock(mutex);
+	wait_for_index(lock);
+	MetricTimer timer(delete_latency);
+
+	if (end_pos > pieces.length())
+		end_pos = pieces.length();
+	if (start_pos >= end_pos)
+		return true;
+
+	const size_t first_line = find_line_for_position(start_pos);
+	const size_t last_line = find_line_for_position(end_pos);
 
+	EditRecord record;
+	if (!delete_range_locked(start_pos, end_pos, &record.removed))
+		return false;
+
+	record.pos = start_pos;
+	record.removed_length = end_pos - start_pos;
+	record_edit_locked(std::move(record));
+
+	update_statistics();
+	invalidate_syntax_locked(first_line, last_line, first_line);
+
+	return true;
+}
+
+/**
+ * delete_range_locked - 删除指定范围（调用者持有锁）
+ *
+ * 起点落在 Piece 中间时先分割，然后从起点开始依次删除完整覆盖的
+ * Piece，最后一个部分覆盖的 Piece 截掉开头。
+ */
+bool TextBuffer::delete_range_locked(size_t start_pos, size_t end_pos,
+				     std::vector<Piece> *removed)
+{
 	/*
 	 * 检查范围有效性
 	 */
-	size_t total_chars = get_char_count();
+	size_t total_chars = pieces.length();
 	if (start_pos >= total_chars)
 		return true;
 	if (end_pos > total_chars)
@@ -472,48 +782,44 @@ bool TextBuffer::delete_range(size_t start_pos, size_t end_pos)
 		return true;
 
 	/*
-	 * 查找起始 Piece
-	 */
-	size_t start_piece, start_offset;
-	if (!find_piece_for_position(start_pos, start_piece, start_offset))
-		return false;
-
-	/*
-	 * 查找结束 Piece
+	 * 查找起始 Piece，必要时分割
 	 */
-	size_t end_piece, end_offset;
-	if (!find_piece_for_position(end_pos, end_piece, end_offset))
+	PieceNode *node;
+	size_t offset_in_piece;
+	if (!find_piece_for_position(start_pos, node, offset_in_piece))
 		return false;
 
-	/*
-	 * 分割起始 Piece（如果需要）
-	 */
-	if (start_offset > 0) {
-		split_piece(start_piece, start_offset);
-		start_piece++;
-	}
+	if (node && offset_in_piece > 0)
+		node = split_piece(node, offset_in_piece);
 
 	/*
-	 * 分割结束 Piece（如果需要）
+	 * 删除覆盖范围内的 Pieces
 	 */
-	if (end_offset > 0 && end_offset <
-				pieces[end_piece].length) {
-		split_piece(end_piece, end_offset);
-	}
+	size_t remaining = end_pos - start_pos;
+
+	while (node && remaining > 0) {
+		PieceNode *next = pieces.next(node);
+
+		if (node->piece.length <= remaining) {
+			if (removed)
+				append_piece(*removed, node->piece);
+			remaining -= node->piece.length;
+			pieces.erase(node);
+		} else {
+			if (removed)
+				append_piece(*removed,
+					     Piece(node->piece.type,
+						   node->piece.offset, remaining));
+			Piece tail(node->piece.type,
+				   node->piece.offset + remaining,
+				   node->piece.length - remaining);
+			pieces.update(node, tail, count_line_feeds(tail));
+			remaining = 0;
+		}
 
-	/*
-	 * 删除中间的 Pieces
-	 */
-	if (end_piece > start_piece) {
-		pieces.erase(pieces.begin() + start_piece,
-			     pieces.begin() + end_piece);
+		node = next;
 	}
 
-	/*
-	 * 重建行缓存
-	 */
-	rebuild_line_cache();
-
 	return true;
 }
 
@@ -525,171 +831,820 @@ bool TextBuffer::delete_range(size_t start_pos, size_t end_pos)
 bool TextBuffer::replace(size_t start_pos, size_t end_pos,
 			 const std::string &text)
 {
-	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_lock<RwMutex> lock(mutex);
+	wait_for_index(lock);
+	MetricTimer timer(replace_latency);
+
+	if (end_pos > pieces.length())
+		end_pos = pieces.length();
+	if (start_pos > end_pos)
+		start_pos = end_pos;
 
 	/*
-	 * 先删除，再插入
+	 * 先删除，再插入，最后统一更新统计信息；两者记录为一步
 	 */
-	if (!delete_range(start_pos, end_pos))
-		return false;
+	const size_t first_line = find_line_for_position(start_pos);
+	const size_t last_line = find_line_for_position(end_pos);
 
-	if (!text.empty() && !insert(start_pos, text))
-		return false;
+	EditRecord record;
+	record.pos = start_pos;
+	record.removed_length = end_pos - start_pos;
 
-	return true;
+	bool ok = delete_range_locked(start_pos, end_pos, &record.removed);
+
+	if (ok && !text.empty()) {
+		Piece piece;
+		ok = insert_locked(start_pos, text, &piece);
+		if (ok) {
+			record.inserted.push_back(piece);
+			record.inserted_length = piece.length;
+		}
+	}
+
+	const size_t inserted_end = start_pos + record.inserted_length;
+	if (ok && (record.removed_length > 0 || record.inserted_length > 0))
+		record_edit_locked(std::move(record));
+
+	update_statistics();
+	invalidate_syntax_locked(first_line, last_line,
+				 find_line_for_position(inserted_end));
+
+	return ok;
 }
 
 /*
  * ============================================================================
- * 私有方法 - 缓冲区管理
+ * 撤销和重做
  * ============================================================================
  */
 
 /**
- * grow_add_buffer - 扩展添加缓冲区
+ * undo - 撤销最近一次编辑
  *
- * 当添加缓冲区空间不足时，扩展缓冲区大小。
+ * 删除该步插入的内容，再放回被删除的 Piece。
  */
-bool TextBuffer::grow_add_buffer(size_t required_size)
+bool TextBuffer::undo(size_t &cursor)
 {
-	/*
-	 * 计算新大小
-	 */
-	size_t new_size = add_buffer_size + ADD_BUFFER_GROW_SIZE;
-	while (new_size < add_buffer_used + required_size) {
-		new_size += ADD_BUFFER_GROW_SIZE;
-	}
+	std::unique_lock<RwMutex> lock(mutex);
+	wait_for_index(lock);
+	MetricTimer timer(undo_latency);
 
-	/*
-	 * 分配新缓冲区
-	 */
-	char *new_buffer = new char[new_size];
-	if (!new_buffer) {
-		std::cerr << "无法扩展添加缓冲区" << std::endl;
+	if (undo_stack.empty())
 		return false;
-	}
 
-	/*
-	 * 复制旧内容
-	 */
-	memcpy(new_buffer, add_buffer, add_buffer_used);
+	EditRecord record = std::move(undo_stack.back());
+	undo_stack.pop_back();
 
-	/*
-	 * 释放旧缓冲区
-	 */
-	delete[] add_buffer;
+	const size_t first_line = find_line_for_position(record.pos);
+	const size_t last_line = find_line_for_position(record.pos +
+							record.inserted_length);
 
-	/*
-	 * 更新指针和大小
-	 */
-	add_buffer = new_buffer;
-	add_buffer_size = new_size;
+	if (!swap_pieces_locked(record.pos, record.inserted_length,
+				record.removed)) {
+		/* 树与历史不再一致，历史作废 */
+		clear_history_locked();
+		reset_syntax_locked();
+		update_statistics();
+		return false;
+	}
+
+	cursor = record.pos + record.removed_length;
+	redo_stack.push_back(std::move(record));
+	coalesce_break = true;
+
+	update_statistics();
+	invalidate_syntax_locked(first_line, last_line,
+				 find_line_for_position(cursor));
 
 	return true;
 }
 
 /**
- * append_to_add_buffer - 追加内容到添加缓冲区
- *
- * 将文本追加到添加缓冲区，并返回添加的位置和长度。
+ * redo - 重做最近一次撤销的编辑
  */
-bool TextBuffer::append_to_add_buffer(const std::string &text, size_t &offset)
+bool TextBuffer::redo(size_t &cursor)
 {
-	/*
-	 * 检查空间是否足够
-	 */
-	if (add_buffer_used + text.length() > add_buffer_size) {
-		if (!grow_add_buffer(text.length()))
-			return false;
+	std::unique_lock<RwMutex> lock(mutex);
+	wait_for_index(lock);
+	MetricTimer timer(redo_latency);
+
+	if (redo_stack.empty())
+		return false;
+
+	EditRecord record = std::move(redo_stack.back());
+	redo_stack.pop_back();
+
+	const size_t first_line = find_line_for_position(record.pos);
+	const size_t last_line = find_line_for_position(record.pos +
+							record.removed_length);
+
+	if (!swap_pieces_locked(record.pos, record.removed_length,
+				record.inserted)) {
+		/* 树与历史不再一致，历史作废 */
+		clear_history_locked();
+		reset_syntax_locked();
+		update_statistics();
+		return false;
 	}
 
-	/*
-	 * 保存偏移
-	 */
-	offset = add_buffer_used;
+	cursor = record.pos + record.inserted_length;
+	undo_stack.push_back(std::move(record));
+	coalesce_break = true;
 
-	/*
-	 * 追加文本
-	 */
-	memcpy(add_buffer + add_buffer_used, text.data(), text.length());
-	add_buffer_used += text.length();
+	update_statistics();
+	invalidate_syntax_locked(first_line, last_line,
+				 find_line_for_position(cursor));
 
 	return true;
 }
 
-/*
- * ============================================================================
- * 私有方法 - Piece 操作
- * ============================================================================
- */
+bool TextBuffer::can_undo(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return !undo_stack.empty();
+}
 
-/**
- * split_piece - 分割 Piece
- *
- * 在指定位置分割 Piece，将一个 Piece 分割为两个。
- */
-size_t TextBuffer::split_piece(size_t index, size_t offset)
+bool TextBuffer::can_redo(void)
 {
-	if (index >= pieces.size())
-		return index;
+	std::shared_lock<RwMutex> lock(mutex);
+	return !redo_stack.empty();
+}
 
-	Piece &piece = pieces[index];
+void TextBuffer::break_undo_group(void)
+{
+	std::lock_guard<RwMutex> lock(mutex);
+	coalesce_break = true;
+}
 
-	/*
-	 * 如果在开头或结尾，不需要分割
-	 */
-	if (offset == 0 || offset >= piece.length)
-		return index;
+void TextBuffer::set_undo_limit(size_t bytes)
+{
+	std::lock_guard<RwMutex> lock(mutex);
+	history_limit = bytes;
+	trim_history_locked();
+}
 
-	/*
-	 * 创建新的 Piece（后半部分）
-	 */
-	Piece second_piece(piece.type, piece.offset + offset,
-			   piece.length - offset);
+size_t TextBuffer::undo_memory_usage(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return history_memory;
+}
 
-	/*
-	 * 修改原 Piece（前半部分）
-	 */
-	piece.length = offset;
+/**
+ * record_edit_locked - 记录一次编辑并清空重做栈
+ */
+void TextBuffer::record_edit_locked(EditRecord record)
+{
+	for (const EditRecord &old : redo_stack)
+		history_memory -= old.charge();
+	redo_stack.clear();
+
+	/* 单次按键：字节数不超过 UNDO_COALESCE_MAX_BYTES 且不含换行符 */
+	auto is_keystroke = [this](const std::vector<Piece> &list,
+				   size_t length) {
+		if (length == 0 || length > UNDO_COALESCE_MAX_BYTES)
+			return false;
+		for (const Piece &piece : list) {
+			if (count_line_feeds(piece) > 0)
+				return false;
+		}
+		return true;
+	};
 
-	/*
-	 * 插入新 Piece
-	 */
-	pieces.insert(pieces.begin() + index + 1, second_piece);
+	record.time = std::chrono::steady_clock::now();
+	record.coalescable = (record.inserted_length > 0) ?
+		is_keystroke(record.inserted, record.inserted_length) :
+		is_keystroke(record.removed, record.removed_length);
+
+	if (!coalesce_edit_locked(record)) {
+		history_memory += record.charge();
+		undo_stack.push_back(std::move(record));
+	}
 
-	return index + 1;
+	coalesce_break = false;
+	trim_history_locked();
 }
 
 /**
- * merge_pieces - 合并相邻的 Piece
+ * coalesce_edit_locked - 尝试把编辑合并到上一步
  *
- * 合并类型相同且连续的相邻 Piece，减少 Piece 列表大小。
+ * 只有上一步和这一步都是单次按键、间隔不超过 UNDO_COALESCE_MS 时
+ * 才合并。换行符不会被合并，因此一步撤销最多回到行首。
  */
-void TextBuffer::merge_pieces(size_t index)
+bool TextBuffer::coalesce_edit_locked(const EditRecord &record)
 {
-	if (index == 0 || index >= pieces.size())
-		return;
+	if (coalesce_break || undo_stack.empty() || !record.coalescable)
+		return false;
 
-	Piece &prev = pieces[index - 1];
-	Piece &curr = pieces[index];
+	EditRecord &prev = undo_stack.back();
+	if (!prev.coalescable ||
+	    record.time - prev.time >
+		    std::chrono::milliseconds(UNDO_COALESCE_MS))
+		return false;
 
-	/*
-	 * 检查是否可以合并
-	 */
-	if (prev.type != curr.type)
-		return;
+	const size_t old_charge = prev.charge();
 
-	/*
-	 * 检查是否连续
-	 */
-	if (prev.offset + prev.length != curr.offset)
-		return;
+	if (record.removed_length == 0) {
+		/* 连续输入：紧接在上一步插入的内容之后 */
+		if (prev.inserted_length == 0 ||
+		    record.pos != prev.pos + prev.inserted_length)
+			return false;
+
+		for (const Piece &piece : record.inserted)
+			append_piece(prev.inserted, piece);
+		prev.inserted_length += record.inserted_length;
+	} else if (record.inserted_length == 0 && prev.inserted_length == 0) {
+		if (record.pos + record.removed_length == prev.pos) {
+			/* 退格：删除的内容在上一步删除的内容之前 */
+			std::vector<Piece> merged = record.removed;
+			for (const Piece &piece : prev.removed)
+				append_piece(merged, piece);
+			prev.removed = std::move(merged);
+			prev.pos = record.pos;
+		} else if (record.pos == prev.pos) {
+			/* 向前删除 */
+			for (const Piece &piece : record.removed)
+				append_piece(prev.removed, piece);
+		} else {
+			return false;
+		}
+		prev.removed_length += record.removed_length;
+	} else {
+		return false;
+	}
+
+	prev.time = record.time;
+	history_memory = history_memory - old_charge + prev.charge();
+
+	return true;
+}
+
+/**
+ * append_piece - 把 Piece 追加到列表末尾
+ *
+ * 与最后一个 Piece 类型相同且内存中相邻时直接扩展，连续输入和
+ * 连续删除的记录因此保持只有一个 Piece。
+ */
+void TextBuffer::append_piece(std::vector<Piece> &list,
+			      const Piece &piece) const
+{
+	if (!list.empty()) {
+		Piece &last = list.back();
+		if (last.type == piece.type &&
+		    last.offset + last.length == piece.offset &&
+		    !(piece.type == PieceType::ADD &&
+		      add_buffer.is_allocation_start(piece.offset))) {
+			last.length += piece.length;
+			return;
+		}
+	}
+
+	list.push_back(piece);
+}
+
+/**
+ * swap_pieces_locked - 把 [pos, pos + length) 替换为一组 Piece
+ */
+bool TextBuffer::swap_pieces_locked(size_t pos, size_t length,
+				    const std::vector<Piece> &replacement)
+{
+	if (length > 0 && !delete_range_locked(pos, pos + length))
+		return false;
+
+	for (const Piece &piece : replacement) {
+		if (!insert_piece_locked(pos, piece))
+			return false;
+		pos += piece.length;
+	}
+
+	return true;
+}
+
+/**
+ * trim_history_locked - 丢弃最早的记录直到不超过内存上限
+ */
+void TextBuffer::trim_history_locked(void)
+{
+	while (history_memory > history_limit && !undo_stack.empty()) {
+		history_memory -= undo_stack.front().charge();
+		undo_stack.pop_front();
+	}
+}
+
+/**
+ * clear_history_locked - 清空撤销和重做历史
+ */
+void TextBuffer::clear_history_locked(void)
+{
+	undo_stack.clear();
+	redo_stack.clear();
+	history_memory = 0;
+	coalesce_break = true;
+}
+
+/*
+ * ============================================================================
+ * 内存管理
+ * ============================================================================
+ */
+
+/**
+ * compact - 压缩后台缓冲区占用的内存
+ *
+ * 映射是只读的 MAP_PRIVATE，页从未被写入，MADV_DONTNEED 之后再访问
+ * 会从文件重新读入相同的内容。添加缓冲区和撤销历史仍被 Piece 引用，
+ * 保持不变。
+ */
+bool TextBuffer::compact(void)
+{
+	std::lock_guard<RwMutex> lock(mutex);
+
+	if (compacted || indexing || !mmap_data)
+		return false;
+
+	std::vector<size_t> checkpoints;
+	checkpoints.reserve(original_line_feeds.size() /
+			    LINE_CHECKPOINT_INTERVAL + 1);
+	for (size_t i = 0; i < original_line_feeds.size();
+	     i += LINE_CHECKPOINT_INTERVAL)
+		checkpoints.push_back(original_line_feeds[i]);
+
+	original_checkpoints.swap(checkpoints);
+	std::vector<size_t>().swap(original_line_feeds);
+	compacted = true;
+	reset_syntax_locked();
+
+	madvise(mmap_data, mmap_size, MADV_DONTNEED);
+	return true;
+}
+
+/**
+ * restore_index - 恢复完整的换行符索引
+ */
+bool TextBuffer::restore_index(void)
+{
+	std::lock_guard<RwMutex> lock(mutex);
+
+	if (!compacted)
+		return false;
+
+	expand_index_locked();
+	return true;
+}
+
+/**
+ * expand_index_locked - 从原始缓冲区重建完整索引
+ *
+ * 检查点数量给出了换行符总数的上界，一次预留，不反复扩容。
+ */
+void TextBuffer::expand_index_locked(void)
+{
+	if (!compacted)
+		return;
+
+	std::vector<size_t> feeds;
+	feeds.reserve(original_checkpoints.size() * LINE_CHECKPOINT_INTERVAL);
+
+	madvise(mmap_data, mmap_size, MADV_SEQUENTIAL);
+	build_line_feed_index(mmap_data, 0, mmap_size, feeds);
+	madvise(mmap_data, mmap_size, MADV_NORMAL);
+
+	original_line_feeds.swap(feeds);
+	std::vector<size_t>().swap(original_checkpoints);
+	compacted = false;
+}
+
+/**
+ * is_compacted - 是否处于压缩状态
+ */
+bool TextBuffer::is_compacted(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+	return compacted;
+}
+
+/**
+ * advise_range - 对原始缓冲区 [begin, end) 调用 madvise
+ *
+ * 起始地址向下对齐到页（mmap_data 本身页对齐）。
+ */
+void TextBuffer::advise_range(size_t begin, size_t end, int advice) const
+{
+	static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+	if (begin >= end)
+		return;
+
+	const size_t aligned = begin & ~(page_size - 1);
+	madvise(mmap_data + aligned, end - aligned, advice);
+}
+
+/**
+ * advise_window - 提示内核预读可见窗口附近的内容
+ * @start_line: 窗口起始行（包含）
+ * @end_line: 窗口结束行（不包含）
+ *
+ * 窗口对应的文档范围可能由多个 Piece 组成，只对其中的原始
+ * Piece 区域提示（添加缓冲区在堆上，总是驻留）。
+ */
+void TextBuffer::advise_window(size_t start_line, size_t end_line)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+
+	if (!mmap_data || end_line <= start_line)
+		return;
+
+	const size_t span = end_line - start_line;
+	const size_t line_feeds = pieces.line_feed_count();
+	const size_t first = start_line > span ? start_line - span : 0;
+	const size_t last = std::min(end_line + span, line_feeds);
+	if (first > last)
+		return;
+
+	const size_t begin = line_start(first);
+	const size_t end = line_end(last);
+
+	size_t piece_start = 0;
+	PieceNode *node = pieces.find_by_offset(begin, piece_start);
+	while (node && piece_start < end) {
+		const Piece &piece = node->piece;
+		if (piece.type == PieceType::ORIGINAL) {
+			size_t from = piece.offset +
+				      (begin > piece_start ? begin - piece_start : 0);
+			size_t to = piece.offset +
+				    std::min(piece.length, end - piece_start);
+			advise_range(from, to, MADV_WILLNEED);
+		}
+		piece_start += piece.length;
+		node = pieces.next(node);
+	}
+}
+
+/**
+ * memory_usage - 估算占用的内存（字节）
+ */
+size_t TextBuffer::memory_usage(void)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+
+	size_t bytes = (original_line_feeds.capacity() +
+			original_checkpoints.capacity() +
+			add_line_feeds.capacity()) * sizeof(size_t);
+	bytes += syntax_states.capacity();
+	bytes += add_buffer.memory_usage();
+	bytes += history_memory;
+	bytes += pieces.piece_count() * sizeof(PieceNode);
+	if (!compacted)
+		bytes += mmap_size;
+	return bytes;
+}
+
+/*
+ * ============================================================================
+ * 文件保存
+ * ============================================================================
+ */
+
+/**
+ * write_all_iov - 写出整个iovec数组
+ * @fd: 目标文件描述符
+ * @iov: iovec数组，部分写入时会被修改
+ * @count: iovec数量
+ *
+ * 返回值: 成功返回true，失败返回false（errno已设置）
+ */
+static bool write_all_iov(int fd, struct iovec *iov, int count)
+{
+	while (count > 0) {
+		ssize_t ret = writev(fd, iov, count);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		/* 跳过已写完的iovec，调整写了一部分的那个 */
+		size_t done = static_cast<size_t>(ret);
+		while (count > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+			iov->iov_len -= done;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * copy_range - 用copy_file_range()把源文件的一段追加到目标文件
+ * @in_fd: 源文件
+ * @offset: 源文件中的起始偏移
+ * @out_fd: 目标文件，从当前文件位置开始写
+ * @length: 字节数
+ * @copied: 输出参数，已复制的字节数
+ *
+ * 返回值: 成功返回0，失败返回errno
+ */
+static int copy_range(int in_fd, off_t offset, int out_fd, size_t length,
+		      size_t &copied)
+{
+	copied = 0;
+
+	while (copied < length) {
+		ssize_t ret = copy_file_range(in_fd, &offset, out_fd, nullptr,
+					      length - copied, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		if (ret == 0)
+			return EIO; /* 原文件在加载后被截断 */
+
+		copied += ret;
+	}
+
+	return 0;
+}
+
+/**
+ * write_pieces_locked - 按文本顺序把所有 Piece 写入 fd
+ *
+ * 相邻的 Piece 攒成一个 iovec 数组一起提交。文件系统不支持
+ * copy_file_range()（跨文件系统、老内核等）时，剩下的 ORIGINAL
+ * Piece 也直接从映射区域写出。
+ */
+std::expected<size_t, std::string> TextBuffer::write_pieces_locked(int fd)
+{
+	struct iovec iov[SAVE_MAX_IOVECS];
+	int count = 0;
+	size_t written = 0;
+	bool use_copy_range = (mmap_fd >= 0);
+
+	auto flush = [&]() {
+		const bool ok = write_all_iov(fd, iov, count);
+		count = 0;
+		return ok;
+	};
+
+	for (PieceNode *node = pieces.first(); node; node = pieces.next(node)) {
+		const Piece &piece = node->piece;
+		size_t skip = 0;
+
+		if (use_copy_range && piece.type == PieceType::ORIGINAL &&
+		    piece.length >= SAVE_COPY_RANGE_MIN) {
+			if (!flush())
+				return std::unexpected(std::format("写入失败: {}",
+							strerror(errno)));
+
+			const int err = copy_range(mmap_fd, piece.offset, fd,
+						   piece.length, skip);
+			if (err == 0) {
+				written += piece.length;
+				continue;
+			}
+			if (err != EXDEV && err != ENOSYS && err != EINVAL &&
+			    err != EOPNOTSUPP)
+				return std::unexpected(std::format("复制失败: {}",
+							strerror(err)));
+
+			/* 不支持：已复制的部分保留，其余改为写出 */
+			use_copy_range = false;
+		}
+
+		iov[count].iov_base = const_cast<char *>(piece_data(piece)) + skip;
+		iov[count].iov_len = piece.length - skip;
+		count++;
+		written += piece.length;
+
+		if (count == SAVE_MAX_IOVECS && !flush())
+			return std::unexpected(std::format("写入失败: {}",
+						strerror(errno)));
+	}
+
+	if (!flush())
+		return std::unexpected(std::format("写入失败: {}", strerror(errno)));
+
+	return written;
+}
+
+/**
+ * save - 把当前内容写入文件
+ *
+ * 目标是符号链接时替换链接指向的文件；已有文件沿用原来的权限，
+ * 新文件使用0644。任何一步失败都删除临时文件，目标文件保持不变。
+ */
+std::expected<size_t, std::string> TextBuffer::save(const std::string &path)
+{
+	std::shared_lock<RwMutex> lock(mutex);
+
+	std::string target = path.empty() ? file_path : path;
+	if (target.empty())
+		return std::unexpected(std::string("没有要保存的文件路径"));
+
+	char resolved[PATH_MAX];
+	if (realpath(target.c_str(), resolved))
+		target = resolved;
+
+	mode_t mode = 0644;
+	struct stat st;
+	if (stat(target.c_str(), &st) == 0) {
+		if (!S_ISREG(st.st_mode))
+			return std::unexpected(std::format("不是普通文件: {}",
+							   target));
+		mode = st.st_mode & 07777;
+	}
+
+	/* 临时文件与目标在同一目录，rename() 不会跨文件系统 */
+	const size_t slash = target.rfind('/');
+	const std::string dir = (slash == std::string::npos) ?
+				"" : target.substr(0, slash + 1);
+	const std::string name = (slash == std::string::npos) ?
+				 target : target.substr(slash + 1);
+	std::string temp = dir + "." + name + ".mikufy-XXXXXX";
+
+	const int fd = mkostemp(temp.data(), O_CLOEXEC);
+	if (fd < 0)
+		return std::unexpected(std::format("无法创建临时文件: {}: {}",
+						   temp, strerror(errno)));
+
+	auto result = write_pieces_locked(fd);
+	lock.unlock();
+
+	if (result && (fchmod(fd, mode) != 0 || fsync(fd) != 0))
+		result = std::unexpected(std::format("同步失败: {}",
+						     strerror(errno)));
+
+	if (::close(fd) != 0 && result)
+		result = std::unexpected(std::format("写入失败: {}",
+						     strerror(errno)));
+
+	if (result && rename(temp.c_str(), target.c_str()) != 0)
+		result = std::unexpected(std::format("重命名失败: {}",
+						     strerror(errno)));
+
+	if (!result) {
+		unlink(temp.c_str());
+		log_error("保存失败: {}: {}", target, result.error());
+		return result;
+	}
+
+	log_debug("文件保存成功: {}, 大小: {} 字节", target, *result);
+
+	return result;
+}
+
+/*
+ * ============================================================================
+ * 私有方法 - 缓冲区管理
+ * ============================================================================
+ */
+
+/**
+ * AddArena::append - 追加内容
+ *
+ * 当前分配放不下时分配新块：不超过一个块的内容分配 ADD_CHUNK_SIZE，
+ * 更大的内容分配能容纳它的整数个块，多出的部分留给之后的追加。
+ */
+size_t AddArena::append(std::string_view text)
+{
+	if (used + text.size() > block_end) {
+		const size_t start = slots.size() << ADD_CHUNK_SHIFT;
+		const size_t count = std::max<size_t>(1,
+			(text.size() + ADD_CHUNK_SIZE - 1) >> ADD_CHUNK_SHIFT);
+
+		auto block = std::make_unique_for_overwrite<char[]>(
+			count << ADD_CHUNK_SHIFT);
+		for (size_t i = 0; i < count; i++)
+			slots.push_back(Slot{ block.get() + (i << ADD_CHUNK_SHIFT),
+					      i == 0 });
+		blocks.push_back(std::move(block));
+
+		used = start;
+		block_end = start + (count << ADD_CHUNK_SHIFT);
+	}
+
+	const size_t offset = used;
+	memcpy(const_cast<char *>(data(offset)), text.data(), text.size());
+	used += text.size();
+
+	return offset;
+}
+
+/**
+ * AddArena::clear - 释放所有块
+ */
+void AddArena::clear(void)
+{
+	blocks.clear();
+	slots.clear();
+	used = 0;
+	block_end = 0;
+}
+
+/**
+ * append_to_add_buffer - 追加内容到添加缓冲区
+ *
+ * 将文本追加到添加缓冲区，并返回添加的位置。
+ * 同时把新文本中的换行符追加到添加缓冲区的换行符索引。
+ */
+bool TextBuffer::append_to_add_buffer(const std::string &text, size_t &offset)
+{
+	if (text.empty())
+		return false;
+
+	offset = add_buffer.append(text);
+
+	/*
+	 * 记录换行符位置（逻辑偏移只增不减，索引保持有序）
+	 */
+	const size_t first = add_line_feeds.size();
+	scan_line_feeds(text.data(), 0, text.length(), add_line_feeds);
+	for (size_t i = first; i < add_line_feeds.size(); i++)
+		add_line_feeds[i] += offset;
+
+	return true;
+}
+
+/*
+ * ============================================================================
+ * 私有方法 - Piece 操作
+ * ============================================================================
+ */
+
+/**
+ * split_piece - 分割 Piece
+ *
+ * 在指定位置分割 Piece，将一个 Piece 分割为两个。
+ */
+PieceNode *TextBuffer::split_piece(PieceNode *node, size_t offset)
+{
+	const Piece piece = node->piece;
+
+	/*
+	 * 如果在开头或结尾，不需要分割
+	 */
+	if (offset == 0 || offset >= piece.length)
+		return node;
+
+	/*
+	 * 原节点保留前半部分，后半部分作为新节点插入到其后
+	 */
+	Piece first_piece(piece.type, piece.offset, offset);
+	Piece second_piece(piece.type, piece.offset + offset,
+			   piece.length - offset);
+
+	pieces.update(node, first_piece, count_line_feeds(first_piece));
+
+	return pieces.insert_before(pieces.next(node), second_piece,
+				    count_line_feeds(second_piece));
+}
+
+/**
+ * merge_pieces - 尝试把新 Piece 合并到前一个 Piece
+ *
+ * 类型相同、缓冲区内连续且合并后不超过 MAX_PIECE_SIZE 时合并。
+ */
+bool TextBuffer::merge_pieces(PieceNode *prev, const Piece &piece)
+{
+	if (!prev)
+		return false;
+
+	const Piece &prev_piece = prev->piece;
+
+	/*
+	 * 检查是否可以合并
+	 */
+	if (prev_piece.type != piece.type)
+		return false;
+
+	/*
+	 * 检查是否连续
+	 */
+	if (prev_piece.offset + prev_piece.length != piece.offset)
+		return false;
+
+	/*
+	 * 逻辑偏移相邻但位于两次分配，内存中不连续
+	 */
+	if (piece.type == PieceType::ADD &&
+	    add_buffer.is_allocation_start(piece.offset))
+		return false;
+
+	if (prev_piece.length + piece.length > MAX_PIECE_SIZE)
+		return false;
 
 	/*
 	 * 合并
 	 */
-	prev.length += curr.length;
-	pieces.erase(pieces.begin() + index);
+	Piece merged(prev_piece.type, prev_piece.offset,
+		     prev_piece.length + piece.length);
+	pieces.update(prev, merged, count_line_feeds(merged));
+
+	return true;
 }
 
 /**
@@ -697,45 +1652,112 @@ void TextBuffer::merge_pieces(size_t index)
  *
  * 查找包含字符位置 pos 的 Piece。
  */
-bool TextBuffer::find_piece_for_position(size_t pos, size_t &piece_index,
-				 size_t &offset_in_piece)
+bool TextBuffer::find_piece_for_position(size_t pos, PieceNode *&node,
+					 size_t &offset_in_piece)
 {
+	if (pos > pieces.length())
+		return false;
+
 	/*
-	 * 边界情况
+	 * 文档末尾没有对应的 Piece
 	 */
-	if (pos == 0) {
-		piece_index = 0;
+	if (pos == pieces.length()) {
+		node = nullptr;
 		offset_in_piece = 0;
-		return !pieces.empty();
+		return true;
 	}
 
-	/*
-	 * 线性搜索（对于小列表足够快）
-	 * 对于大列表，可以使用二分搜索优化
-	 */
-	size_t current_pos = 0;
-	for (size_t i = 0; i < pieces.size(); ++i) {
-		const Piece &piece = pieces[i];
+	size_t piece_start = 0;
+	node = pieces.find_by_offset(pos, piece_start);
+	offset_in_piece = pos - piece_start;
 
-		if (current_pos + piece.length > pos) {
-			piece_index = i;
-			offset_in_piece = pos - current_pos;
-			return true;
-		}
+	return node != nullptr;
+}
+
+/**
+ * count_line_feeds - 统计 Piece 内的换行符数量
+ */
+size_t TextBuffer::count_line_feeds(const Piece &piece) const
+{
+	return count_feeds_before(piece.type, piece.offset + piece.length) -
+	       count_feeds_before(piece.type, piece.offset);
+}
 
-		current_pos += piece.length;
+/**
+ * count_feeds_between - 统计 data[begin, end) 中的换行符
+ */
+static size_t count_feeds_between(const char *data, size_t begin, size_t end)
+{
+	size_t count = 0;
+	const char *p = data + begin;
+	const char *last = data + end;
+
+	while (p < last) {
+		p = static_cast<const char *>(memchr(p, '\n', last - p));
+		if (!p)
+			break;
+		count++;
+		p++;
+	}
+	return count;
+}
+
+/**
+ * count_feeds_before - 缓冲区中 offset 之前的换行符数量
+ */
+size_t TextBuffer::count_feeds_before(PieceType type, size_t offset) const
+{
+	if (type == PieceType::ADD || !compacted) {
+		const std::vector<size_t> &index =
+			(type == PieceType::ORIGINAL) ? original_line_feeds :
+							add_line_feeds;
+		return static_cast<size_t>(
+			std::lower_bound(index.begin(), index.end(), offset) -
+			index.begin());
 	}
 
 	/*
-	 * 位置超出范围
+	 * offset 之前最近的检查点是第 i * INTERVAL 个换行符，
+	 * 从它之后扫描到 offset
 	 */
-	if (!pieces.empty()) {
-		piece_index = pieces.size() - 1;
-		offset_in_piece = pieces.back().length;
-		return true;
+	auto it = std::lower_bound(original_checkpoints.begin(),
+				   original_checkpoints.end(), offset);
+	if (it == original_checkpoints.begin())
+		return count_feeds_between(mmap_data, 0, offset);
+
+	const size_t i = static_cast<size_t>(it - original_checkpoints.begin()) - 1;
+	return i * LINE_CHECKPOINT_INTERVAL + 1 +
+	       count_feeds_between(mmap_data, original_checkpoints[i] + 1,
+				   offset);
+}
+
+/**
+ * feed_position - 缓冲区中第 rank 个换行符的偏移
+ */
+size_t TextBuffer::feed_position(PieceType type, size_t rank) const
+{
+	if (type == PieceType::ADD)
+		return add_line_feeds[rank];
+	if (!compacted)
+		return original_line_feeds[rank];
+
+	size_t pos = original_checkpoints[rank / LINE_CHECKPOINT_INTERVAL];
+	for (size_t n = rank % LINE_CHECKPOINT_INTERVAL; n > 0; n--) {
+		const char *next = static_cast<const char *>(
+			memchr(mmap_data + pos + 1, '\n', mmap_size - pos - 1));
+		pos = static_cast<size_t>(next - mmap_data);
 	}
+	return pos;
+}
 
-	return false;
+/**
+ * piece_data - 获取 Piece 内容的起始指针
+ */
+const char *TextBuffer::piece_data(const Piece &piece) const
+{
+	if (piece.type == PieceType::ORIGINAL)
+		return mmap_data + piece.offset;
+	return add_buffer.data(piece.offset);
 }
 
 /*
@@ -745,96 +1767,295 @@ bool TextBuffer::find_piece_for_position(size_t pos, size_t &piece_index,
  */
 
 /**
- * rebuild_line_cache - 重建行缓存
+ * line_feed_offset - 获取第 index 个换行符在文档中的位置
+ */
+size_t TextBuffer::line_feed_offset(size_t index)
+{
+	size_t piece_start = 0;
+	size_t line_feeds_before = 0;
+	PieceNode *node = pieces.find_by_line_feed(index, piece_start,
+						   line_feeds_before);
+	if (!node)
+		return pieces.length();
+
+	const Piece &piece = node->piece;
+
+	/*
+	 * Piece 内第一个换行符在索引中的下标，加上 Piece 内的序号
+	 */
+	const size_t rank = count_feeds_before(piece.type, piece.offset) +
+			    (index - line_feeds_before);
+	size_t buffer_pos = feed_position(piece.type, rank);
+
+	return piece_start + (buffer_pos - piece.offset);
+}
+
+/**
+ * line_start - 获取指定行的起始位置
+ */
+size_t TextBuffer::line_start(size_t line)
+{
+	if (line == 0)
+		return 0;
+
+	return line_feed_offset(line - 1) + 1;
+}
+
+/**
+ * line_end - 获取指定行的结束位置（不含换行符）
+ */
+size_t TextBuffer::line_end(size_t line)
+{
+	if (line < pieces.line_feed_count())
+		return line_feed_offset(line);
+
+	return pieces.length();
+}
+
+/**
+ * update_statistics - 编辑后刷新 line_count 和 char_count
  *
- * 遍历所有 Piece，重建行信息缓存。
+ * 行数等于换行符数，最后一个换行符之后还有内容时再加一行
+ * （与文本编辑器的习惯一致：空文件0行，"a\n"为1行）。
+ * 后台索引期间只统计已索引部分中完整的行。
  */
-bool TextBuffer::rebuild_line_cache(void)
+void TextBuffer::update_statistics(void)
 {
-	line_cache.clear();
+	const size_t line_feeds = pieces.line_feed_count();
 
-	size_t current_pos = 0;
-	size_t line_start = 0;
-	size_t piece_index = 0;
+	char_count = pieces.length();
+	line_count = line_feeds;
+	if (!indexing && line_start(line_feeds) < char_count)
+		line_count++;
+}
 
-	for (const auto &piece : pieces) {
-		const char *buffer = (piece.type == PieceType::ORIGINAL) ?
-					     mmap_data :
-					     add_buffer;
-		size_t buffer_offset = piece.offset;
+/*
+ * ============================================================================
+ * 私有方法 - 语法状态
+ * ============================================================================
+ */
 
-		/*
-		 * 遍历 Piece 中的字符
-		 */
-		for (size_t i = 0; i < piece.length; ++i) {
-			char ch = buffer[buffer_offset + i];
+/**
+ * invalidate_syntax_locked - 编辑后更新语法状态表
+ * @first_line: 编辑起点所在的行（行首状态不受影响）
+ * @old_last_line: 编辑前被替换范围的终点所在的行
+ * @new_last_line: 编辑后插入内容的终点所在的行
+ *
+ * 状态表可能比行数短（尚未分析到的部分），超出表尾的行不需要处理，
+ * 下次分析时补齐为待确认。之后的行整体前移或后移，保存的状态仍然
+ * 可以作为收敛的依据。
+ */
+void TextBuffer::invalidate_syntax_locked(size_t first_line,
+					  size_t old_last_line,
+					  size_t new_last_line)
+{
+	const size_t begin = first_line + 1;
+	if (begin > syntax_states.size())
+		return;
 
-			/*
-			 * 遇到换行符，结束当前行
-			 */
-			if (ch == '\n') {
-				LineInfo info;
-				info.start_index = line_start;
-				info.length = current_pos - line_start + 1;
-				info.piece_index = piece_index;
-				line_cache.push_back(info);
+	const size_t old_end = std::min(old_last_line + 1, syntax_states.size());
+	const size_t removed = old_end - begin;
+	const size_t added = new_last_line - first_line;
 
-				/*
-				 * 开始新行
-				 */
-				line_start = current_pos + 1;
-			}
+	if (added > removed)
+		syntax_states.insert(syntax_states.begin() + old_end,
+				     added - removed, SYNTAX_STATE_DIRTY);
+	else if (removed > added)
+		syntax_states.erase(syntax_states.begin() + begin + added,
+				    syntax_states.begin() + old_end);
 
-			current_pos++;
+	std::fill_n(syntax_states.begin() + begin, added, SYNTAX_STATE_DIRTY);
+	if (begin + added < syntax_states.size())
+		syntax_states[begin + added] |= SYNTAX_STATE_DIRTY;
+
+	syntax_valid = std::min(syntax_valid, begin);
+}
+
+/**
+ * reset_syntax_locked - 丢弃所有语法状态
+ */
+void TextBuffer::reset_syntax_locked(void)
+{
+	std::vector<uint8_t>().swap(syntax_states);
+	syntax_valid = 0;
+}
+
+/*
+ * ============================================================================
+ * 私有方法 - 换行符索引
+ * ============================================================================
+ */
+
+/**
+ * scan_line_feeds - 扫描区域内的换行符
+ */
+void TextBuffer::scan_line_feeds(const char *data, size_t begin, size_t end,
+				 std::vector<size_t> &out,
+				 const std::atomic<bool> *cancel)
+{
+	const char *p = data + begin;
+	const char *last = data + end;
+
+	while (p < last) {
+		/* 按片扫描，片之间检查取消标志 */
+		const char *slice_end = last;
+		if (cancel) {
+			if (cancel->load(std::memory_order_relaxed))
+				return;
+			if (static_cast<size_t>(last - p) > INDEX_CANCEL_CHECK_SIZE)
+				slice_end = p + INDEX_CANCEL_CHECK_SIZE;
 		}
 
-		piece_index++;
+		while (p < slice_end) {
+			const char *feed = static_cast<const char *>(
+				memchr(p, '\n', slice_end - p));
+			if (!feed) {
+				p = slice_end;
+				break;
+			}
+			out.push_back(feed - data);
+			p = feed + 1;
+		}
+	}
+}
+
+/**
+ * build_line_feed_index - 建立区域内的换行符索引
+ */
+void TextBuffer::build_line_feed_index(const char *data, size_t begin,
+				       size_t end, std::vector<size_t> &out,
+				       const std::atomic<bool> *cancel)
+{
+	size_t thread_count = std::thread::hardware_concurrency();
+	if (thread_count > MAX_INDEX_THREADS)
+		thread_count = MAX_INDEX_THREADS;
+
+	if (end - begin < PARALLEL_INDEX_MIN_SIZE || thread_count < 2) {
+		scan_line_feeds(data, begin, end, out, cancel);
+		return;
 	}
 
 	/*
-	 * 处理最后一行（如果没有换行符结尾）
+	 * 分块并行扫描，块边界不需要对齐到行，换行符只会落在
+	 * 某一个块中
 	 */
-	if (current_pos > line_start) {
-		LineInfo info;
-		info.start_index = line_start;
-		info.length = current_pos - line_start;
-		info.piece_index = piece_index - 1;
-		line_cache.push_back(info);
+	const size_t chunk_size = (end - begin + thread_count - 1) / thread_count;
+	std::vector<std::vector<size_t>> chunks(thread_count);
+	std::vector<std::thread> workers;
+	workers.reserve(thread_count);
+
+	for (size_t i = 0; i < thread_count; i++) {
+		size_t chunk_begin = begin + i * chunk_size;
+		size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+		if (chunk_begin >= chunk_end)
+			break;
+		workers.emplace_back(scan_line_feeds, data, chunk_begin,
+				     chunk_end, std::ref(chunks[i]), cancel);
 	}
 
-	line_cache_valid = true;
+	for (auto &worker : workers)
+		worker.join();
 
-	return true;
+	if (cancel && cancel->load(std::memory_order_relaxed))
+		return;
+
+	size_t total = out.size();
+	for (const auto &chunk : chunks)
+		total += chunk.size();
+	out.reserve(total);
+
+	for (const auto &chunk : chunks)
+		out.insert(out.end(), chunk.begin(), chunk.end());
 }
 
 /**
- * find_line_for_position - 查找包含指定位置的行
+ * index_worker - 后台索引线程主函数
  *
- * 查找包含字符位置 pos 的行号。
+ * 扫描期间不持有锁，mmap 区域在 stop_indexing() 回收本线程之前
+ * 不会被解除映射。stop_indexing() 置位 index_cancel 后，各扫描线程
+ * 最多再扫描 INDEX_CANCEL_CHECK_SIZE 就返回，关闭大文件不必等完整
+ * 扫描结束。
  */
-size_t TextBuffer::find_line_for_position(size_t pos)
+void TextBuffer::index_worker(void)
 {
-	if (!line_cache_valid)
-		return 0;
+	MetricTimer timer(index_latency);
+	std::vector<size_t> rest;
+	build_line_feed_index(mmap_data, INDEX_PREFIX_SIZE, mmap_size, rest,
+			      &index_cancel);
+
+	std::lock_guard<RwMutex> lock(mutex);
+
+	if (index_cancel)
+		return;
+
+	original_line_feeds.insert(original_line_feeds.end(), rest.begin(),
+				   rest.end());
 
 	/*
-	 * 二分查找
+	 * 索引期间不允许编辑，树中只有一个原始 Piece
 	 */
-	auto it = std::upper_bound(
-		line_cache.begin(), line_cache.end(), pos,
-		[](size_t pos, const LineInfo &info) {
-			return pos < info.start_index;
-		});
+	PieceNode *node = pieces.first();
+	if (node)
+		pieces.update(node, node->piece, original_line_feeds.size());
 
-	if (it == line_cache.begin())
-		return 0;
+	indexing = false;
+	update_statistics();
+	index_cond.notify_all();
+
+	/* 顺序扫描结束，之后按编辑器的随机访问处理预读 */
+	madvise(mmap_data, mmap_size, MADV_NORMAL);
+
+	log_debug("后台索引完成: {}, 行数: {}", file_path, line_count);
+}
+
+/**
+ * stop_indexing - 取消并回收后台索引线程
+ */
+void TextBuffer::stop_indexing(void)
+{
+	if (!index_thread.joinable())
+		return;
 
-	it--;
+	index_cancel = true;
+	index_thread.join();
 
-	if (pos >= it->start_index + it->length)
-		return line_cache.size();
+	std::lock_guard<RwMutex> lock(mutex);
+	indexing = false;
+	index_cond.notify_all();
+}
+
+/**
+ * wait_for_index - 等待后台索引完成
+ */
+void TextBuffer::wait_for_index(std::unique_lock<RwMutex> &lock)
+{
+	index_cond.wait(lock, [this]() { return !indexing; });
+	expand_index_locked();
+}
+
+/**
+ * find_line_for_position - 查找包含指定位置的行
+ *
+ * 查找包含字符位置 pos 的行号。
+ */
+size_t TextBuffer::find_line_for_position(size_t pos)
+{
+	if (pos >= pieces.length())
+		return pieces.line_feed_count();
+
+	size_t piece_start = 0;
+	size_t line_feeds_before = 0;
+	PieceNode *node = pieces.find_by_offset(pos, piece_start,
+						line_feeds_before);
+	if (!node)
+		return pieces.line_feed_count();
+
+	/*
+	 * 加上 Piece 内 pos 之前的换行符
+	 */
+	Piece head(node->piece.type, node->piece.offset, pos - piece_start);
 
-	return std::distance(line_cache.begin(), it);
+	return line_feeds_before + count_line_feeds(head);
 }
 
 /**
@@ -844,17 +2065,11 @@ size_t TextBuffer::find_line_for_position(size_t pos)
  */
 bool TextBuffer::get_piece_text(const Piece &piece, std::string &text)
 {
-	const char *buffer = (piece.type == PieceType::ORIGINAL) ?
-				     mmap_data :
-				     add_buffer;
-
-	if (!buffer || piece.offset + piece.length >
-			     ((piece.type == PieceType::ORIGINAL) ?
-					    mmap_size :
-					    add_buffer_size))
+	if (piece.offset + piece.length >
+	    ((piece.type == PieceType::ORIGINAL) ? mmap_size : add_buffer.size()))
 		return false;
 
-	text.assign(buffer + piece.offset, piece.length);
+	text.assign(piece_data(piece), piece.length);
 	return true;
 }
 
@@ -865,21 +2080,11 @@ bool TextBuffer::get_piece_text(const Piece &piece, std::string &text)
  */
 bool TextBuffer::get_char(size_t pos, char &ch)
 {
-	size_t piece_index, offset_in_piece;
-	if (!find_piece_for_position(pos, piece_index, offset_in_piece))
-		return false;
-
-	if (piece_index >= pieces.size())
-		return false;
-
-	const Piece &piece = pieces[piece_index];
-	const char *buffer = (piece.type == PieceType::ORIGINAL) ?
-				     mmap_data :
-				     add_buffer;
-
-	if (!buffer || offset_in_piece >= piece.length)
+	PieceNode *node;
+	size_t offset_in_piece;
+	if (!find_piece_for_position(pos, node, offset_in_piece) || !node)
 		return false;
 
-	ch = buffer[piece.offset + offset_in_piece];
+	ch = piece_data(node->piece)[offset_in_piece];
 	return true;
 }
@@ -0,0 +1,210 @@
+/*
+ * Mikufy v2.11-nova - 文本缓冲区注册表实现
+ *
+ * 本文件实现了TextBufferRegistry类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/text_buffer_registry.h"
+#include "../headers/metrics.h"
+#include "../headers/logger.h"
+#include <algorithm>		/* std::sort */
+
+/* 后台缓冲区压缩和恢复的次数 */
+static MetricCounter &compactions = Metrics::instance().counter(
+	"mikufy_textbuffer_compactions_total",
+	"压缩为检查点索引的后台TextBuffer数");
+static MetricCounter &restores = Metrics::instance().counter(
+	"mikufy_textbuffer_restores_total",
+	"重新获得焦点时重建完整索引的已压缩TextBuffer数");
+
+/**
+ * TextBufferRegistry::TextBufferRegistry - 构造函数
+ * @budget: 内存预算（字节）
+ */
+TextBufferRegistry::TextBufferRegistry(size_t budget)
+	: focus_counter(0), budget(budget)
+{
+}
+
+/**
+ * TextBufferRegistry::find - 后台访问一个已打开的缓冲区
+ */
+std::shared_ptr<TextBuffer> TextBufferRegistry::find(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = entries.find(path);
+	return it != entries.end() ? it->second.buffer : nullptr;
+}
+
+/**
+ * TextBufferRegistry::acquire - 前台访问一个已打开的缓冲区
+ *
+ * 恢复索引在注册表锁外进行，只阻塞这一个缓冲区。
+ */
+std::shared_ptr<TextBuffer> TextBufferRegistry::acquire(const std::string &path)
+{
+	std::shared_ptr<TextBuffer> buffer;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = entries.find(path);
+		if (it == entries.end())
+			return nullptr;
+
+		it->second.focus_seq = ++focus_counter;
+		it->second.focus_time = std::chrono::steady_clock::now();
+		buffer = it->second.buffer;
+	}
+
+	if (buffer->restore_index()) {
+		restores.add();
+		log_debug("恢复文本缓冲区索引: {}", path);
+	}
+	return buffer;
+}
+
+/**
+ * TextBufferRegistry::insert - 注册新加载的缓冲区
+ */
+std::shared_ptr<TextBuffer> TextBufferRegistry::insert(
+	const std::string &path, std::shared_ptr<TextBuffer> buffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto [it, inserted] = entries.try_emplace(path);
+	if (inserted)
+		it->second.buffer = std::move(buffer);
+	it->second.focus_seq = ++focus_counter;
+	it->second.focus_time = std::chrono::steady_clock::now();
+	return it->second.buffer;
+}
+
+/**
+ * TextBufferRegistry::erase - 移除一个缓冲区
+ *
+ * 缓冲区在最后一个持有者释放时析构（解除映射），不在锁内。
+ */
+bool TextBufferRegistry::erase(const std::string &path)
+{
+	std::shared_ptr<TextBuffer> released;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = entries.find(path);
+		if (it == entries.end())
+			return false;
+
+		released = std::move(it->second.buffer);
+		entries.erase(it);
+	}
+	return true;
+}
+
+/**
+ * TextBufferRegistry::clear - 移除所有缓冲区
+ */
+void TextBufferRegistry::clear(void)
+{
+	std::unordered_map<std::string, Entry> released;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released.swap(entries);
+	}
+}
+
+/**
+ * TextBufferRegistry::snapshot - 取得所有缓冲区
+ */
+std::vector<std::shared_ptr<TextBuffer>> TextBufferRegistry::snapshot(void)
+{
+	std::vector<std::shared_ptr<TextBuffer>> buffers;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	buffers.reserve(entries.size());
+	for (const auto &pair : entries)
+		buffers.push_back(pair.second.buffer);
+	return buffers;
+}
+
+/**
+ * TextBufferRegistry::set_budget - 设置内存预算
+ */
+void TextBufferRegistry::set_budget(size_t bytes)
+{
+	budget.store(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * TextBufferRegistry::trim - 按内存预算和空闲时间压缩后台缓冲区
+ *
+ * 在注册表锁内只复制条目，按焦点顺序从旧到新处理：超过空闲时间的
+ * 一律压缩，其余的压缩到合计不超过预算为止。
+ */
+size_t TextBufferRegistry::trim(void)
+{
+	std::unique_lock<std::mutex> trim_lock(trim_mutex, std::try_to_lock);
+	if (!trim_lock.owns_lock())
+		return 0;
+
+	struct Candidate {
+		std::string path;
+		std::shared_ptr<TextBuffer> buffer;
+		uint64_t focus_seq;
+		std::chrono::steady_clock::time_point focus_time;
+	};
+
+	std::vector<Candidate> candidates;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		candidates.reserve(entries.size());
+		for (const auto &[path, entry] : entries)
+			candidates.push_back({ path, entry.buffer, entry.focus_seq,
+					       entry.focus_time });
+	}
+
+	if (candidates.size() < 2)
+		return 0;
+
+	std::sort(candidates.begin(), candidates.end(),
+		  [](const Candidate &a, const Candidate &b) {
+			  return a.focus_seq < b.focus_seq;
+		  });
+
+	std::vector<size_t> usage(candidates.size());
+	size_t total = 0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		usage[i] = candidates[i].buffer->memory_usage();
+		total += usage[i];
+	}
+
+	const size_t limit = budget.load(std::memory_order_relaxed);
+	const auto now = std::chrono::steady_clock::now();
+	const auto idle_timeout = std::chrono::seconds(TEXTBUFFER_IDLE_TIMEOUT);
+	size_t compacted = 0;
+
+	/* 最后一个是当前获得焦点的缓冲区，不处理 */
+	for (size_t i = 0; i + 1 < candidates.size(); i++) {
+		const Candidate &candidate = candidates[i];
+		const bool idle = now - candidate.focus_time >= idle_timeout;
+
+		if (total <= limit && !idle)
+			break;
+
+		if (!candidate.buffer->compact())
+			continue;
+
+		const size_t after = candidate.buffer->memory_usage();
+		total -= std::min(total, usage[i] - std::min(usage[i], after));
+		compacted++;
+		compactions.add();
+		log_debug("压缩后台文本缓冲区: {}（{} -> {} 字节）",
+			  candidate.path, usage[i], after);
+	}
+
+	return compacted;
+}
@@ -0,0 +1,142 @@
+/*
+ * Mikufy v2.11-nova - 线程池实现
+ *
+ * 本文件实现了ThreadPool类的所有方法。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/thread_pool.h"
+#include "../headers/logger.h"
+
+/**
+ * ThreadPool::ThreadPool - 构造函数
+ */
+ThreadPool::ThreadPool(void)
+	: stopping(false)
+{
+}
+
+/**
+ * ThreadPool::~ThreadPool - 析构函数
+ */
+ThreadPool::~ThreadPool(void)
+{
+	stop();
+}
+
+/**
+ * ThreadPool::start - 创建工作线程
+ * @thread_count: 工作线程数量，为0时按CPU核心数选择
+ *
+ * 返回: 成功返回true，线程池已在运行时返回false
+ */
+bool ThreadPool::start(size_t thread_count)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!workers.empty())
+		return false;
+
+	if (thread_count == 0) {
+		thread_count = std::thread::hardware_concurrency();
+		if (thread_count == 0)
+			thread_count = 4;
+	}
+
+	stopping = false;
+	workers.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; i++)
+		workers.emplace_back(&ThreadPool::worker_loop, this);
+
+	return true;
+}
+
+/**
+ * ThreadPool::stop - 停止线程池
+ *
+ * 设置停止标志并唤醒所有工作线程。工作线程会先清空任务队列
+ * 再退出，因此已提交的任务不会丢失。
+ */
+void ThreadPool::stop(void)
+{
+	std::vector<std::thread> joining;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (workers.empty())
+			return;
+		stopping = true;
+		joining.swap(workers);
+	}
+
+	cond.notify_all();
+
+	for (auto &worker : joining) {
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+/**
+ * ThreadPool::submit - 提交任务
+ * @task: 要执行的任务
+ *
+ * 返回: 成功入队返回true，线程池未运行或正在停止返回false
+ */
+bool ThreadPool::submit(Task task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (workers.empty() || stopping)
+			return false;
+		tasks.push_back(std::move(task));
+	}
+
+	cond.notify_one();
+	return true;
+}
+
+/**
+ * ThreadPool::size - 获取工作线程数量
+ */
+size_t ThreadPool::size(void) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return workers.size();
+}
+
+/**
+ * ThreadPool::worker_loop - 工作线程主循环
+ *
+ * 等待任务到达并执行。收到停止通知且队列为空时退出。
+ */
+void ThreadPool::worker_loop(void)
+{
+	while (true) {
+		Task task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this]() {
+				return stopping || !tasks.empty();
+			});
+
+			if (tasks.empty())
+				return; /* stopping且队列已空 */
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		try {
+			task();
+		} catch (const std::exception &e) {
+			log_error("线程池任务异常: {}", e.what());
+		} catch (...) {
+			log_error("线程池任务发生未知异常");
+		}
+	}
+}
@@ -0,0 +1,246 @@
+/*
+ * Mikufy v2.11-nova - 内置前端资源实现
+ *
+ * 本文件嵌入首屏需要的前端资源，并实现了WebAssetBundle类的所有
+ * 方法。
+ *
+ * .incbin 的路径相对于编译时的工作目录（项目根目录，与 -Iheaders
+ * 相同）。新增首屏资源时在下面的列表和embedded_files中各加一项。
+ *
+ * MiraTrive/MikuTrive
+ *
+ * 本文件遵循Linux内核代码风格规范
+ */
+
+#include "../headers/web_assets.h"
+#include <algorithm>		/* std::sort, std::lower_bound */
+#include <cerrno>		/* errno, EINTR */
+#include <cstdint>		/* uint64_t */
+#include <cstring>		/* memcmp() */
+#include <fcntl.h>		/* open() */
+#include <format>		/* std::format */
+#include <iterator>		/* std::size */
+#include <sys/stat.h>		/* fstat() */
+#include <unistd.h>		/* read(), close() */
+
+/*
+ * WEB_ASSET_EMBED - 把文件嵌入只读数据段
+ *
+ * 定义 symbol_start 和 symbol_end 两个符号，分别指向内容的开头和
+ * 结尾。每个资源放在单独的段中，链接时可以按需排列。
+ */
+#define WEB_ASSET_EMBED(symbol, file)					\
+	__asm__(".pushsection .rodata." #symbol ", \"a\", @progbits\n"	\
+		".balign 16\n"						\
+		".globl " #symbol "_start\n"				\
+		".hidden " #symbol "_start\n"				\
+		#symbol "_start:\n"					\
+		".incbin \"" file "\"\n"				\
+		".globl " #symbol "_end\n"				\
+		".hidden " #symbol "_end\n"				\
+		#symbol "_end:\n"					\
+		".popsection\n");					\
+	extern "C" const char symbol##_start[];				\
+	extern "C" const char symbol##_end[]
+
+WEB_ASSET_EMBED(mikufy_asset_index_html, "web/index.html");
+WEB_ASSET_EMBED(mikufy_asset_style_css, "web/style.css");
+WEB_ASSET_EMBED(mikufy_asset_app_js, "web/app.js");
+WEB_ASSET_EMBED(mikufy_asset_virtual_editor_js, "web/virtual_editor.js");
+WEB_ASSET_EMBED(mikufy_asset_logo_png, "web/Mikufy.png");
+WEB_ASSET_EMBED(mikufy_asset_icon_hight, "web/Icons/Hight.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_folder_open, "web/Icons/Folder-Open.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_folder_new, "web/Icons/Folder-New.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_file, "web/Icons/File.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_setting, "web/Icons/Setting.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_terminal, "web/Icons/Terminal.svg");
+WEB_ASSET_EMBED(mikufy_asset_icon_put_away, "web/Icons/Put-away.png");
+
+/* 嵌入的资源（构造时复制到按路径排序的索引中） */
+static const struct {
+	std::string_view path;
+	std::string_view mime_type;
+	const char *start;
+	const char *end;
+} embedded_files[] = {
+	{ "/index.html", "text/html",
+	  mikufy_asset_index_html_start, mikufy_asset_index_html_end },
+	{ "/style.css", "text/css",
+	  mikufy_asset_style_css_start, mikufy_asset_style_css_end },
+	{ "/app.js", "application/javascript",
+	  mikufy_asset_app_js_start, mikufy_asset_app_js_end },
+	{ "/virtual_editor.js", "application/javascript",
+	  mikufy_asset_virtual_editor_js_start,
+	  mikufy_asset_virtual_editor_js_end },
+	{ "/Mikufy.png", "image/png",
+	  mikufy_asset_logo_png_start, mikufy_asset_logo_png_end },
+	{ "/Icons/Hight.svg", "image/svg+xml",
+	  mikufy_asset_icon_hight_start, mikufy_asset_icon_hight_end },
+	{ "/Icons/Folder-Open.svg", "image/svg+xml",
+	  mikufy_asset_icon_folder_open_start,
+	  mikufy_asset_icon_folder_open_end },
+	{ "/Icons/Folder-New.svg", "image/svg+xml",
+	  mikufy_asset_icon_folder_new_start,
+	  mikufy_asset_icon_folder_new_end },
+	{ "/Icons/File.svg", "image/svg+xml",
+	  mikufy_asset_icon_file_start, mikufy_asset_icon_file_end },
+	{ "/Icons/Setting.svg", "image/svg+xml",
+	  mikufy_asset_icon_setting_start, mikufy_asset_icon_setting_end },
+	{ "/Icons/Terminal.svg", "image/svg+xml",
+	  mikufy_asset_icon_terminal_start, mikufy_asset_icon_terminal_end },
+	{ "/Icons/Put-away.png", "image/png",
+	  mikufy_asset_icon_put_away_start, mikufy_asset_icon_put_away_end },
+};
+
+/**
+ * content_hash - 内容的FNV-1a哈希
+ */
+static uint64_t content_hash(std::string_view data)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : data) {
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * same_as_file - 文件内容是否与data相同
+ *
+ * 先比较大小，再分块读取比较，不为整个文件分配内存。
+ *
+ * 返回值: 内容相同返回true；文件不存在时通过@missing报告
+ */
+static bool same_as_file(const std::string &file_path, std::string_view data,
+			 bool &missing)
+{
+	missing = false;
+
+	int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0) {
+		missing = true;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		missing = true;
+		return false;
+	}
+
+	if (static_cast<size_t>(st.st_size) != data.size()) {
+		close(fd);
+		return false;
+	}
+
+	char chunk[64 * 1024];
+	size_t offset = 0;
+	bool same = true;
+	while (same && offset < data.size()) {
+		ssize_t ret = read(fd, chunk, sizeof(chunk));
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0 || static_cast<size_t>(ret) > data.size() - offset) {
+			same = false;
+			break;
+		}
+		same = memcmp(chunk, data.data() + offset, ret) == 0;
+		offset += ret;
+	}
+	close(fd);
+
+	return same;
+}
+
+/**
+ * WebAssetBundle::WebAssetBundle - 构造函数
+ *
+ * 条目按路径排序后建立。内容复制一次到共享字符串中，发送时与
+ * static_cache中的文件一样只增加引用计数。
+ */
+WebAssetBundle::WebAssetBundle(void)
+	: count(std::size(embedded_files))
+{
+	size_t order[std::size(embedded_files)];
+	for (size_t i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order, order + count, [](size_t a, size_t b) {
+		return embedded_files[a].path < embedded_files[b].path;
+	});
+
+	entries = std::make_unique<Entry[]>(count);
+
+	for (size_t i = 0; i < count; i++) {
+		const auto &file = embedded_files[order[i]];
+		const std::string_view data(file.start, file.end - file.start);
+
+		Entry &entry = entries[i];
+		entry.asset.path = file.path;
+		entry.asset.mime_type = file.mime_type;
+		entry.asset.content = std::make_shared<const std::string>(data);
+		entry.asset.etag = std::format("\"a-{:x}-{:x}\"",
+					       content_hash(data), data.size());
+		entry.overridden.store(false, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * WebAssetBundle::lookup - 二分查找路径对应的条目
+ */
+WebAssetBundle::Entry *WebAssetBundle::lookup(std::string_view path) const
+{
+	Entry *begin = entries.get();
+	Entry *end = begin + count;
+	Entry *it = std::lower_bound(begin, end, path,
+				     [](const Entry &entry, std::string_view key) {
+					     return entry.asset.path < key;
+				     });
+	return (it != end && it->asset.path == path) ? it : nullptr;
+}
+
+/**
+ * WebAssetBundle::bind - 与web目录中的文件比较
+ */
+size_t WebAssetBundle::bind(const std::string &web_root)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		Entry &entry = entries[i];
+		const std::string file_path = web_root +
+					      std::string(entry.asset.path);
+
+		bool missing;
+		const bool same = same_as_file(file_path, *entry.asset.content,
+					       missing);
+		const bool overridden = !same && !missing;
+
+		entry.overridden.store(overridden, std::memory_order_relaxed);
+		if (!overridden)
+			kept++;
+	}
+
+	return kept;
+}
+
+/**
+ * WebAssetBundle::find - 查找内置资源
+ */
+const WebAsset *WebAssetBundle::find(std::string_view path) const
+{
+	const Entry *entry = lookup(path);
+	if (!entry || entry->overridden.load(std::memory_order_relaxed))
+		return nullptr;
+	return &entry->asset;
+}
+
+/**
+ * WebAssetBundle::invalidate - 不再使用对应的内置资源
+ */
+void WebAssetBundle::invalidate(std::string_view path)
+{
+	if (Entry *entry = lookup(path))
+		entry->overridden.store(true, std::memory_order_relaxed);
+}
@@ -14,47 +14,72 @@
  */
 
 #include "../headers/web_server.h"
+#include "../headers/json_fields.h"
 #include "../headers/text_buffer.h"
 #include "../headers/terminal_manager.h"
 #include "../headers/process_launcher.h"
 #include "../headers/terminal_window.h"
-#include <iostream>
 #include <cstring>
 #include <sstream>
 #include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
-#include <poll.h>
 #include <sys/select.h>
 #include <sys/types.h>
 #include <limits.h>
 #include <stdio.h>	/* popen(), pclose() */
 #include <sys/wait.h>	/* WIFEXITED(), WEXITSTATUS() */
+#include <sys/eventfd.h>	/* eventfd() */
+#include <netinet/tcp.h>	/* TCP_NODELAY */
+#include <strings.h>	/* strcasecmp(), strncasecmp() */
+#include <charconv>	/* std::from_chars() */
+#include <sys/sendfile.h>	/* sendfile() */
+#include <sys/uio.h>	/* struct iovec */
 #include <unordered_map>
 
+/* 发送的响应字节数（含响应头和推送数据） */
+static MetricCounter &http_bytes_sent = Metrics::instance().counter(
+	"mikufy_http_sent_bytes_total", "发送给客户端的字节数");
+
+/* 接受的连接数 */
+static MetricCounter &http_connections = Metrics::instance().counter(
+	"mikufy_http_connections_total", "接受的客户端连接数");
+
 /**
  * WebServer::WebServer - Web服务器构造函数
  * @file_manager: 文件管理器指针，用于文件操作
  *
- * 初始化WebServer实例，设置默认参数并注册所有API路由。
+ * 初始化WebServer实例，设置默认参数并为路由表注册指标。
  *
  * 注意：构造函数不会自动启动服务器，需要显式调用start()方法。
  */
 WebServer::WebServer(FileManager *file_manager)
 	: file_manager(file_manager), server_socket(-1),
-	  port(WEB_SERVER_PORT), running(false), web_root_path(""),
-	  terminal_manager(std::make_unique<TerminalManager>())
+	  port(WEB_SERVER_PORT), running(false), epoll_fd(-1), wake_fd(-1),
+	  next_file_job_id(1), streams_enabled(false), web_root_path(""),
+	  terminal_manager(std::make_unique<TerminalManager>()),
+	  file_watcher(std::make_unique<FileWatcher>(file_manager)),
+	  static_cache(STATIC_CACHE_SIZE)
 {
-	register_routes(); /* 注册所有API路由处理器 */
+	register_route_metrics();
 
-	/* 启动终端管理器 */
+	/* 启动终端管理器，进程有新输出时唤醒事件循环推送 */
 	if (terminal_manager) {
+		terminal_manager->set_output_ready_callback([this](pid_t pid) {
+			notify_terminal_stream(pid);
+		});
+
 		auto result = terminal_manager->start();
 		if (!result.has_value()) {
-			std::cerr << "启动终端管理器失败: " << result.error()
-				  << std::endl;
+			log_error("启动终端管理器失败: {}", result.error());
 		}
 	}
+
+	/* 启动目录监视器，目录有变化时唤醒事件循环推送 */
+	if (!file_watcher->start([this](const std::vector<FileDelta> &deltas) {
+		    notify_watch_stream(deltas);
+	    }))
+		log_error("启动目录监视器失败: {}", strerror(errno));
 }
 
 /**
@@ -66,15 +91,14 @@ WebServer::~WebServer(void)
 {
 	stop(); /* 停止服务器并释放资源 */
 
+	/* 停止目录监视器 */
+	file_watcher->stop();
+
 	/* 停止终端管理器 */
 	if (terminal_manager)
 		terminal_manager->stop();
 
 	/* 清理所有 TextBuffer */
-	std::lock_guard<std::mutex> lock(text_buffers_mutex);
-	for (auto &pair : text_buffers) {
-		delete pair.second;
-	}
 	text_buffers.clear();
 }
 
@@ -88,6 +112,9 @@ WebServer::~WebServer(void)
 void WebServer::set_web_root_path(const std::string &path)
 {
 	web_root_path = path;
+
+	const size_t kept = web_assets.bind(path);
+	log_info("内置前端资源: {}/{} 个从内存提供", kept, web_assets.size());
 }
 
 /**
@@ -125,8 +152,9 @@ bool WebServer::start(int port_num)
 
 	port = port_num;
 
-	/* 创建TCP socket */
-	server_socket = socket(AF_INET, SOCK_STREAM, 0);
+	/* 创建非阻塞TCP socket */
+	server_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			       0);
 	if (server_socket < 0)
 		return false;
 
@@ -134,8 +162,7 @@ bool WebServer::start(int port_num)
 	int opt = 1;
 	if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt,
 		       sizeof(opt)) < 0) {
-		close(server_socket);
-		server_socket = -1;
+		close_server_fds();
 		return false;
 	}
 
@@ -148,21 +175,61 @@ bool WebServer::start(int port_num)
 
 	if (bind(server_socket, (struct sockaddr *)&server_addr,
 		 sizeof(server_addr)) < 0) {
-		close(server_socket);
-		server_socket = -1;
+		close_server_fds();
 		return false;
 	}
 
-	/* 开始监听，最大10个待处理连接 */
-	if (listen(server_socket, 10) < 0) {
-		close(server_socket);
-		server_socket = -1;
+	/* 开始监听，前端并发加载资源时可能同时发起多个连接 */
+	if (listen(server_socket, SOMAXCONN) < 0) {
+		close_server_fds();
+		return false;
+	}
+
+	/* 创建epoll实例和工作线程唤醒用的eventfd */
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (epoll_fd < 0 || wake_fd < 0) {
+		close_server_fds();
 		return false;
 	}
 
-	/* 设置为非阻塞模式，避免阻塞主线程 */
-	int flags = fcntl(server_socket, F_GETFL, 0);
-	fcntl(server_socket, F_SETFL, flags | O_NONBLOCK);
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = server_socket;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_socket, &ev) < 0) {
+		close_server_fds();
+		return false;
+	}
+
+	ev.data.fd = wake_fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+		close_server_fds();
+		return false;
+	}
+
+	/* 启动请求处理线程池 */
+	size_t worker_count = std::thread::hardware_concurrency();
+	if (worker_count == 0 || worker_count > HTTP_MAX_WORKER_THREADS)
+		worker_count = HTTP_MAX_WORKER_THREADS;
+	worker_pool.start(worker_count);
+
+	size_t search_count = std::thread::hardware_concurrency();
+	if (search_count == 0 || search_count > SEARCH_MAX_THREADS)
+		search_count = SEARCH_MAX_THREADS;
+	search_pool.start(search_count);
+
+	size_t file_count = std::thread::hardware_concurrency();
+	if (file_count == 0 || file_count > FILE_OPERATION_MAX_THREADS)
+		file_count = FILE_OPERATION_MAX_THREADS;
+	file_pool.start(file_count);
+
+	upload_pool.start(HTTP_UPLOAD_WRITER_THREADS);
+
+	{
+		std::lock_guard<std::mutex> streams_lock(ready_streams_mutex);
+		streams_enabled = true;
+	}
 
 	running = true;
 
@@ -176,7 +243,7 @@ bool WebServer::start(int port_num)
  * WebServer::stop - 停止Web服务器
  *
  * 停止服务器运行，关闭所有连接并清理资源。
- * 会等待服务器线程正常结束。
+ * 会等待服务器线程和正在执行的请求处理器正常结束。
  */
 void WebServer::stop(void)
 {
@@ -187,15 +254,62 @@ void WebServer::stop(void)
 
 	running = false; /* 通知服务器线程退出 */
 
-	/* 关闭服务器socket，中断accept调用 */
+	/* 等待服务器线程结束，事件循环退出前会关闭所有连接 */
+	if (server_thread.joinable())
+		server_thread.join();
+
+	/*
+	 * 等待正在处理的请求结束，之后不会再有人写wake_fd。事件循环
+	 * 退出前已取消所有搜索，搜索线程很快退出。
+	 */
+	worker_pool.stop();
+	search_pool.stop();
+	upload_pool.stop();
+
+	/* 取消后台文件操作，已处理的条目保持原样 */
+	{
+		std::lock_guard<std::mutex> jobs_lock(file_jobs_mutex);
+		for (auto &pair : file_jobs)
+			pair.second->cancel();
+	}
+	file_pool.stop();
+
+	{
+		std::lock_guard<std::mutex> completions_lock(completions_mutex);
+		completions.clear();
+	}
+
+	/* 关闭wake_fd之前停止接收终端输出通知 */
+	{
+		std::lock_guard<std::mutex> streams_lock(ready_streams_mutex);
+		streams_enabled = false;
+		ready_streams.clear();
+		ready_searches.clear();
+		watch_events.clear();
+	}
+
+	close_server_fds();
+}
+
+/**
+ * WebServer::close_server_fds - 关闭监听socket、epoll和eventfd
+ */
+void WebServer::close_server_fds(void)
+{
 	if (server_socket >= 0) {
 		close(server_socket);
 		server_socket = -1;
 	}
 
-	/* 等待服务器线程结束 */
-	if (server_thread.joinable())
-		server_thread.join();
+	if (wake_fd >= 0) {
+		close(wake_fd);
+		wake_fd = -1;
+	}
+
+	if (epoll_fd >= 0) {
+		close(epoll_fd);
+		epoll_fd = -1;
+	}
 }
 
 /**
@@ -211,486 +325,1364 @@ bool WebServer::is_running(void) const
 /**
  * WebServer::server_loop - 服务器主循环
  *
- * 使用poll系统调用监听客户端连接请求。
- * 使用poll而不是select以避免FD_SETSIZE限制。
- * 每100ms检查一次是否有新连接。
+ * 使用epoll同时监听：
+ * - 监听socket：有新连接时全部accept
+ * - wake_fd：工作线程处理完请求，取回响应开始发送；
+ *   终端有新输出、监视的目录有变化或搜索有新结果，推送给订阅连接
+ * - 客户端连接：读取请求、继续发送未发完的响应
+ *
+ * epoll_wait每100ms超时一次以检查running标志，
+ * 每秒清理一次超时的空闲keep-alive连接，并按内存预算压缩后台
+ * TextBuffer。
  *
  * 注意：此函数在单独的线程中运行。
  */
 void WebServer::server_loop(void)
 {
-	while (running) {
-		/* 检查server_socket是否有效 */
-		if (server_socket < 0) {
-			std::cerr << "错误: 服务器socket无效" << std::endl;
-			break;
-		}
+	struct epoll_event events[HTTP_MAX_EVENTS];
+	auto last_sweep = std::chrono::steady_clock::now();
 
-		/* 使用poll代替select，避免FD_SETSIZE限制 */
-		struct pollfd fds[1];
-		fds[0].fd = server_socket;
-		fds[0].events = POLLIN; /* 监听可读事件 */
-		fds[0].revents = 0;
+	/*
+	 * sendfile()没有MSG_NOSIGNAL，只在本线程屏蔽SIGPIPE：对端关闭
+	 * 时返回EPIPE而不是终止进程，也不影响终端子进程继承的信号处理。
+	 */
+	sigset_t sigpipe_set;
+	sigemptyset(&sigpipe_set);
+	sigaddset(&sigpipe_set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe_set, nullptr);
 
-		int ready = poll(fds, 1, 100); /* 100ms超时 */
+	while (running) {
+		int ready = epoll_wait(epoll_fd, events, HTTP_MAX_EVENTS, 100);
 
 		if (ready < 0) {
 			if (errno == EINTR)
 				continue; /* 被信号中断，继续循环 */
-			std::cerr << "poll调用失败: " << strerror(errno)
-				  << std::endl;
+			log_error("epoll_wait调用失败: {}", strerror(errno));
 			break;
 		}
 
-		/* 有新连接到达 */
-		if (ready > 0 && (fds[0].revents & POLLIN)) {
-			int client_socket = accept_client();
-			if (client_socket >= 0)
-				handle_client(client_socket);
+		for (int i = 0; i < ready; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == server_socket)
+				accept_clients();
+			else if (fd == wake_fd) {
+				complete_requests();
+				resume_uploads();
+				pump_terminal_streams();
+				pump_watch_streams();
+				pump_search_streams();
+			}
+			else
+				handle_connection_event(fd, events[i].events);
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - last_sweep >= std::chrono::seconds(1)) {
+			close_idle_connections();
+			/* 压缩会获取各缓冲区的锁，放到工作线程执行 */
+			worker_pool.submit([this]() { text_buffers.trim(); });
+			last_sweep = now;
 		}
 	}
+
+	/* 退出前关闭所有连接，取消进行中的搜索 */
+	for (auto &pair : connections) {
+		if (pair.second->search_job)
+			pair.second->search_job->cancel();
+		close(pair.first);
+	}
+	connections.clear();
+	terminal_streams.clear();
+	watch_streams.clear();
 }
 
 /**
- * WebServer::accept_client - 接受客户端连接
+ * WebServer::accept_clients - 接受所有待处理的客户端连接
  *
- * 接受一个等待中的客户端连接请求。
- *
- * 返回: 成功返回客户端socket描述符，失败返回-1
+ * 循环调用accept4()直到返回EAGAIN。新连接设置为非阻塞并关闭
+ * Nagle算法（请求/响应都很小，延迟比吞吐更重要），然后注册
+ * 读事件。
  */
-int WebServer::accept_client(void)
+void WebServer::accept_clients(void)
 {
-	struct sockaddr_in client_addr;
-	socklen_t client_addr_len = sizeof(client_addr);
+	while (true) {
+		int client_socket = accept4(server_socket, nullptr, nullptr,
+					    SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_socket < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				log_error("accept调用失败: {}", strerror(errno));
+			return;
+		}
 
-	int client_socket =
-		accept(server_socket, (struct sockaddr *)&client_addr,
-		       &client_addr_len);
-	if (client_socket < 0)
-		return -1;
+		int opt = 1;
+		setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &opt,
+			   sizeof(opt));
 
-	return client_socket;
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = client_socket;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+			close(client_socket);
+			continue;
+		}
+
+		connections[client_socket] =
+			std::make_unique<HttpConnection>(client_socket);
+		http_connections.add();
+	}
 }
 
 /**
- * WebServer::handle_client - 处理客户端请求
- * @client_socket: 客户端socket描述符
+ * WebServer::handle_connection_event - 处理单个连接上的epoll事件
+ * @fd: 客户端socket描述符
+ * @events: epoll事件掩码
  *
- * 接收、解析并处理HTTP请求，然后发送响应。
- * 支持GET和POST请求，能够处理带请求体的请求（如POST JSON）。
- *
- * 请求处理流程：
- * 1. 循环接收请求数据，直到收到完整的HTTP请求
- * 2. 解析HTTP请求行、请求头和请求体
- * 3. 根据URL路径查找对应的路由处理器
- * 4. 执行处理器生成HTTP响应
- * 5. 发送响应给客户端
- * 6. 关闭连接
- *
- * 注意：每次处理完请求后关闭连接（HTTP/1.0风格）。
+ * 连接在任意时刻处于三种状态之一，监听的事件也随之不同：
+ * - 读取请求：EPOLLIN | EPOLLRDHUP
+ * - 请求处理中（busy）：不监听任何事件
+ * - 发送响应：EPOLLOUT
+ * 推送连接（终端输出、目录变化、搜索结果）只监听EPOLLRDHUP（积压时加上
+ * EPOLLOUT），对端关闭或发来任何数据都直接关闭。
  */
-void WebServer::handle_client(int client_socket)
+void WebServer::handle_connection_event(int fd, uint32_t events)
 {
-	/* 接收请求数据 */
-	char buffer[8192];
-	std::string request;
+	auto it = connections.find(fd);
+	if (it == connections.end())
+		return;
 
-	/* 循环接收直到收到完整的请求 */
-	while (true) {
-		ssize_t bytes_read = recv(client_socket, buffer,
-				  sizeof(buffer) - 1, 0);
-
-		if (bytes_read <= 0)
-			break; /* 连接关闭或错误 */
-
-		buffer[bytes_read] = '\0';
-		request.append(buffer, bytes_read);
-
-		/* 检查是否已经收到完整的请求头 */
-		size_t header_end = request.find("\r\n\r\n");
-		if (header_end != std::string::npos) {
-			/* 查找Content-Length以确定是否还有请求体 */
-			size_t content_length_pos =
-				request.find("Content-Length:");
-			if (content_length_pos != std::string::npos &&
-			    content_length_pos < header_end) {
-				/* 提取Content-Length的值 */
-				size_t colon_pos =
-					request.find(':', content_length_pos);
-				size_t end_pos =
-					request.find("\r\n", colon_pos);
-				std::string length_str = request.substr(
-					colon_pos + 1,
-					end_pos - colon_pos - 1);
-				/* 去除首尾空白字符 */
-				length_str.erase(0, length_str.find_first_not_of(
-							" \t"));
-				length_str.erase(length_str.find_last_not_of(
-							" \t\r\n") + 1);
-				size_t content_length =
-					std::stoul(length_str);
-
-				/* 检查是否已经收到完整的body */
-				size_t body_start = header_end + 4;
-				if (request.length() >=
-				    body_start + content_length)
-					break; /* 收到完整请求 */
-			} else {
-				/* 没有Content-Length，可能是GET请求，已经收到完整请求 */
-				break;
-			}
-		} else if (request.length() > 8192) {
-			/* 没有找到请求头结束符，并且已经接收了很多数据，可能是错误的请求 */
-			break;
+	HttpConnection &conn = *it->second;
+	conn.last_active = std::chrono::steady_clock::now();
+
+	if (events & (EPOLLERR | EPOLLHUP)) {
+		if (conn.busy) {
+			/*
+			 * 请求仍在工作线程中处理，不能关闭fd（否则fd号
+			 * 可能被新连接复用）。先停止监听，等响应回来后
+			 * 再关闭。
+			 */
+			conn.peer_closed = true;
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+			return;
 		}
+		close_connection(fd);
+		return;
 	}
 
-	/* 解析HTTP请求 */
-	std::string method, path;
-	std::map<std::string, std::string> headers;
-	std::string body;
-
-	if (!parse_http_request(request, method, path, headers, body)) {
-		close(client_socket);
+	if (conn.is_stream()) {
+		bool alive;
+		if (events & (EPOLLIN | EPOLLRDHUP))
+			alive = false;
+		else if (conn.search_job)
+			alive = pump_search_stream(conn);
+		else if (conn.watch_stream)
+			alive = flush_connection(conn);
+		else
+			alive = pump_terminal_stream(conn);
+
+		if (!alive)
+			close_connection(fd);
 		return;
 	}
 
-	std::cout << "收到HTTP请求: " << method << " " << path << std::endl;
-
-	/* 处理请求 */
-	HttpResponse response;
-
-	/* 去除查询参数获取路由路径 */
-	std::string route_path = path;
-	size_t query_pos = path.find('?');
-	if (query_pos != std::string::npos)
-		route_path = path.substr(0, query_pos);
-
-	/* 查找路由处理器 */
-	auto it = routes.find(route_path);
-	if (it != routes.end()) {
-		std::cout << "路由匹配成功: " << route_path << ", body长度: "
-			  << body.length() << std::endl;
-		response = it->second(path, headers, body);
-	} else {
-		/* 处理静态文件请求 */
-		response = handle_static_file(path);
+	if (events & EPOLLOUT) {
+		if (!flush_connection(conn))
+			close_connection(fd);
+		return;
 	}
 
-	/* 发送HTTP响应 */
-	send_http_response(client_socket, response);
-
-	/* 关闭连接 */
-	close(client_socket);
+	if (events & (EPOLLIN | EPOLLRDHUP)) {
+		if (!read_connection(conn) || !dispatch_request(conn))
+			close_connection(fd);
+	}
 }
 
-
 /**
- * WebServer::parse_http_request - 解析HTTP请求
- * @request: 原始HTTP请求数据
- * @method: 输出参数，存储HTTP方法（GET、POST等）
- * @path: 输出参数，存储请求路径
- * @headers: 输出参数，存储请求头键值对
- * @body: 输出参数，存储请求体内容
+ * WebServer::read_connection - 读取连接上的可读数据
+ * @conn: 连接状态
  *
- * 解析原始HTTP请求数据，提取请求方法、路径、请求头和请求体。
- * 支持标准HTTP/1.1格式。
- *
- * 优化要点:
- * - 使用string_view避免字符串拷贝（C++17特性）
- * - 优化空白字符去除，使用find_first_not_of和find_last_not_of
- * - 减少不必要的字符串操作
+ * 数据直接接收到in_buffer的末尾。解析器按Content-Length预留了
+ * 缓冲区时，一次recv()可以填满剩余空间，不经过中间缓冲区。
+ * 读到EAGAIN或累计HTTP_READ_BUDGET字节后返回（epoll是水平触发，
+ * 剩余数据会再次触发可读事件）。对端关闭写方向时设置peer_closed，
+ * 缓冲区中已收到的完整请求仍会被处理。
  *
- * 返回: 解析成功返回true，失败返回false
+ * 返回: 连接仍然可用返回true，需要关闭返回false
  */
-bool WebServer::parse_http_request(
-	const std::string &request, std::string &method, std::string &path,
-	std::map<std::string, std::string> &headers, std::string &body)
+bool WebServer::read_connection(HttpConnection &conn)
 {
-	/*
-	 * 解析请求行 (如: GET /index.html HTTP/1.1)
-	 * 请求行格式: METHOD PATH VERSION
-	 */
-	const size_t line_end = request.find("\r\n");
-	if (line_end == std::string::npos)
-		return false;
+	size_t budget = HTTP_READ_BUDGET;
+
+	while (budget > 0) {
+		const size_t old_size = conn.in_buffer.size();
+		const size_t room = conn.in_buffer.capacity() - old_size;
+		const size_t want = std::min(budget, std::max<size_t>(room, 16384));
+		ssize_t bytes_read = 0;
+
+		conn.in_buffer.resize_and_overwrite(old_size + want,
+			[&](char *data, size_t) {
+				bytes_read = recv(conn.fd, data + old_size, want, 0);
+				return old_size + (bytes_read > 0 ? bytes_read : 0);
+			});
+
+		if (bytes_read > 0) {
+			budget -= bytes_read;
+			continue;
+		}
 
-	const std::string request_line = request.substr(0, line_end);
+		if (bytes_read == 0) {
+			conn.peer_closed = true;
+			return true;
+		}
 
-	/*
-	 * 使用istringstream解析请求行
-	 * 提取方法和路径
-	 */
-	std::istringstream line_stream(request_line);
-	line_stream >> method >> path;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return true;
 
-	/*
-	 * 验证方法和路径是否有效
-	 */
-	if (method.empty() || path.empty())
-		return false;
+		return false; /* 连接错误 */
+	}
 
-	/*
-	 * 查找请求头结束位置（"\r\n\r\n"）
-	 */
-	const size_t header_end = request.find("\r\n\r\n", line_end);
-	if (header_end == std::string::npos)
-		return false;
+	return true;
+}
+
+/**
+ * WebServer::begin_request_body - 请求头解析完成后决定如何接收请求体
+ * @conn: 连接状态
+ *
+ * 在事件循环线程中执行。
+ */
+void WebServer::begin_request_body(HttpConnection &conn)
+{
+	HttpRequest &request = conn.parser.request();
+
+	if ((request.method == "PUT" || request.method == "POST") &&
+	    request.route_path() == FILE_UPLOAD_PATH) {
+		conn.upload = begin_upload(request.query);
+
+		const int fd = conn.fd;
+		std::shared_ptr<HttpUpload> upload = conn.upload;
+		conn.parser.set_body_sink([this, fd, upload](const char *data,
+							     size_t length) {
+			queue_upload_data(fd, upload, data, length);
+		});
+	}
 
 	/*
-	 * 解析请求头
-	 * 从请求行结束位置开始，到"\r\n\r\n"结束
+	 * 上一个响应已经发送完毕（dispatch_request保证），socket发送
+	 * 缓冲区是空的，这几个字节可以一次写完。
 	 */
-	size_t header_pos = line_end + 2; /* 跳过第一个"\r\n" */
-
-	while (header_pos < header_end) {
-		/*
-		 * 查找当前行的结束位置
-		 */
-		const size_t line_end_pos = request.find("\r\n", header_pos);
-		if (line_end_pos == std::string::npos || line_end_pos >= header_end)
-			break;
-
-		/*
-		 * 提取当前行
-		 */
-		const std::string line = request.substr(header_pos,
-							line_end_pos - header_pos);
-
-		/*
-		 * 查找冒号分隔符
-		 */
-		const size_t colon_pos = line.find(':');
-		if (colon_pos != std::string::npos) {
-			/*
-			 * 提取键和值
-			 */
-			std::string key = line.substr(0, colon_pos);
-			std::string value = line.substr(colon_pos + 1);
-
-			/*
-			 * 优化：去除键的尾部空白字符
-			 * 使用find_last_not_of一次性查找
-			 */
-			const size_t key_end = key.find_last_not_of(" \t\r");
-			if (key_end != std::string::npos)
-				key.resize(key_end + 1);
+	if (request.expect_continue &&
+	    (request.chunked || request.content_length > 0)) {
+		static constexpr std::string_view reply =
+			"HTTP/1.1 100 Continue\r\n\r\n";
+		ssize_t ret = send(conn.fd, reply.data(), reply.size(),
+				   MSG_NOSIGNAL);
+		(void)ret;
+	}
+}
 
-			/*
-			 * 优化：去除值的首尾空白字符
-			 * 使用find_first_not_of和find_last_not_of
-			 */
-			const size_t value_start = value.find_first_not_of(" \t");
-			const size_t value_end = value.find_last_not_of(" \t\r");
+/**
+ * WebServer::dispatch_request - 解析缓冲区中的下一个请求并交给线程池
+ * @conn: 连接状态
+ *
+ * 同一连接上的请求严格按顺序处理：只有上一个响应发送完毕后才会
+ * 处理下一个，保证流水线请求的响应顺序。请求体是流式上传时，
+ * 收到的数据在这里由解析器写入临时文件。
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::dispatch_request(HttpConnection &conn)
+{
+	if (conn.busy || conn.has_pending_output())
+		return true;
 
-			if (value_start != std::string::npos &&
-			    value_end != std::string::npos) {
-				value = value.substr(value_start,
-						    value_end - value_start + 1);
-			} else {
-				value.clear();
-			}
+	HttpParseStatus status;
+	while ((status = conn.parser.parse(conn.in_buffer)) ==
+	       HttpParseStatus::HEADERS_COMPLETE)
+		begin_request_body(conn);
 
-			/*
-			 * 添加到请求头映射
-			 */
-			headers[key] = value;
+	if (status == HttpParseStatus::INCOMPLETE) {
+		/* 上传的写入队列已满：暂停读取，写入线程排空后恢复 */
+		if (conn.upload && conn.upload->pause_if_full()) {
+			conn.upload_paused = true;
+			update_connection_events(conn.fd, 0);
 		}
-
-		/*
-		 * 移动到下一行
-		 */
-		header_pos = line_end_pos + 2;
+		return !conn.peer_closed; /* 请求不完整，等待更多数据 */
 	}
 
-	/*
-	 * 解析请求体（仅POST/PUT请求）
-	 * 使用布尔表达式而非嵌套if
-	 */
-	const bool has_body = (method == "POST" || method == "PUT");
-
-	if (has_body) {
-		/*
-		 * 查找Content-Length头部
-		 */
-		const auto it = headers.find("Content-Length");
-
-		/*
-		 * 如果找到Content-Length，提取请求体
-		 */
-		if (it != headers.end()) {
-			/*
-			 * 解析Content-Length值
-			 */
-			const size_t content_length = std::stoul(it->second);
+	if (status == HttpParseStatus::ERROR) {
+		/* 非法请求：返回错误后关闭连接 */
+		const int code = conn.parser.error_status();
+		HttpResponse response;
+		response.status_code = code;
+		response.status_text = (code == 413) ? "Payload Too Large"
+						     : "Bad Request";
+		response.headers["Content-Type"] = "text/plain";
+		response.headers["Connection"] = "close";
+		response.body = response.status_text;
+
+		conn.in_buffer.clear();
+		conn.upload.reset();
+		conn.out_buffer = build_http_response(response);
+		conn.out_offset = 0;
+		conn.keep_alive = false;
+		return flush_connection(conn);
+	}
 
-			/*
-			 * 计算请求体起始位置（跳过"\r\n\r\n"）
-			 */
-			const size_t body_start = header_end + 4;
+	HttpRequest request = std::move(conn.parser.request());
+	std::shared_ptr<HttpUpload> upload = std::move(conn.upload);
+	conn.parser.reset();
+
+	/* 推送是长连接，直接在事件循环线程中接管（只计请求数） */
+	if (request.method == "GET" &&
+	    (request.route_path() == TERMINAL_STREAM_PATH ||
+	     request.route_path() == FILE_WATCH_STREAM_PATH ||
+	     request.route_path() == SEARCH_STREAM_PATH))
+		metrics_for_route(request.route_path()).requests->add();
+
+	if (request.method == "GET") {
+		if (request.route_path() == TERMINAL_STREAM_PATH)
+			return start_terminal_stream(conn, request);
+		if (request.route_path() == FILE_WATCH_STREAM_PATH)
+			return start_watch_stream(conn);
+		if (request.route_path() == SEARCH_STREAM_PATH)
+			return start_search_stream(conn, request);
+	}
 
-			/*
-			 * 验证请求体长度是否合法
-			 */
-			if (body_start + content_length <= request.length()) {
-				body = request.substr(body_start, content_length);
+	conn.busy = true;
+	update_connection_events(conn.fd, 0);
+
+	int fd = conn.fd;
+	bool submitted = worker_pool.submit(
+		[this, fd, request = std::move(request),
+		 upload = std::move(upload)]() {
+			HttpCompletion completion;
+			completion.fd = fd;
+			completion.keep_alive = request.keep_alive;
+
+			const RouteMetrics &metrics =
+				metrics_for_route(request.route_path());
+			metrics.requests->add();
+
+			HttpResponse response;
+			{
+				MetricTimer timer(*metrics.latency);
+				response = upload ? finish_upload(*upload) :
+					   handle_request(request);
 			}
-		}
+			response.headers["Connection"] = request.keep_alive ?
+							 "keep-alive" : "close";
+			completion.data = build_http_response(response);
+			completion.shared_body = std::move(response.shared_body);
+			completion.file_body = std::move(response.file_body);
+			post_completion(std::move(completion));
+		});
+
+	if (!submitted) {
+		conn.busy = false;
+		return false;
 	}
 
 	return true;
 }
 
 /**
- * WebServer::build_http_response - 构造HTTP响应字符串
- * @response: 响应结构体，包含状态码、状态文本、响应头和响应体
+ * WebServer::handle_request - 处理一个完整的HTTP请求
+ * @request: 解析后的请求
  *
- * 将HttpResponse结构体转换为符合HTTP/1.1规范的响应字符串。
+ * 根据URL路径查找对应的路由处理器，未匹配时按静态文件处理。
  *
- * 返回: HTTP响应字符串
+ * 注意：在工作线程中执行，处理器抛出的异常转换为500响应。
+ *
+ * 返回: 处理器返回的响应
  */
-std::string WebServer::build_http_response(const HttpResponse &response)
+HttpResponse WebServer::handle_request(const HttpRequest &request)
 {
-	std::ostringstream oss;
+	HttpResponse response;
 
-	/* 状态行 (如: HTTP/1.1 200 OK) */
-	oss << "HTTP/1.1 " << response.status_code << " "
-	    << response.status_text << "\r\n";
+	log_debug("收到HTTP请求: {} {}", request.method, request.path);
 
-	/* 响应头 */
-	for (const auto &header : response.headers)
-		oss << header.first << ": " << header.second << "\r\n";
+	/* 去除查询参数获取路由路径 */
+	const std::string_view route_path = request.route_path();
 
-	/* 空行分隔响应头和响应体 */
-	oss << "\r\n";
+	try {
+		/* 查找路由处理器 */
+		const int index = find_route(route_path);
+		if (index >= 0 && routes[index].handler) {
+			log_debug("路由匹配成功: {}, body长度: {}", route_path,
+				  request.body.length());
+			response = (this->*routes[index].handler)(request.query,
+								  request.headers,
+								  request.body);
+		} else {
+			/* 处理静态文件请求 */
+			response = handle_static_file(request.path,
+						      request.headers);
+		}
+	} catch (const std::exception &e) {
+		log_error("请求处理异常: {}: {}", route_path, e.what());
+		response = HttpResponse();
+		response.status_code = 500;
+		response.status_text = "Internal Server Error";
+		response.headers["Content-Type"] = "application/json";
 
-	/* 响应体 */
-	oss << response.body;
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
 
-	return oss.str();
+	return response;
 }
 
 /**
- * WebServer::send_http_response - 发送HTTP响应
- * @client_socket: 客户端socket描述符
- * @response: 响应结构体
- *
- * 构造并发送HTTP响应给客户端。
+ * WebServer::post_completion - 把响应交回事件循环线程
+ * @completion: 完成的响应
  *
- * 返回: 发送成功返回true，失败返回false
+ * 响应入队后写eventfd唤醒事件循环。
  */
-bool WebServer::send_http_response(int client_socket,
-		   const HttpResponse &response)
+void WebServer::post_completion(HttpCompletion completion)
 {
-	std::string response_str = build_http_response(response);
-
-	ssize_t sent = send(client_socket, response_str.c_str(),
-			    response_str.length(), 0);
+	{
+		std::lock_guard<std::mutex> lock(completions_mutex);
+		completions.push_back(std::move(completion));
+	}
 
-	return (sent == static_cast<ssize_t>(response_str.length()));
+	uint64_t one = 1;
+	ssize_t ret = write(wake_fd, &one, sizeof(one));
+	(void)ret; /* 计数器溢出之前必定已被读取，失败可以忽略 */
 }
 
 /**
- * WebServer::url_decode - URL解码
- * @encoded: URL编码的字符串
- *
- * 将URL编码的字符串解码为原始字符串。
- * 处理%XX格式的十六进制编码和+号表示的空格。
- *
- * 返回: 解码后的字符串
+ * WebServer::complete_requests - 取回工作线程完成的响应并开始发送
  */
-std::string WebServer::url_decode(const std::string &encoded)
+void WebServer::complete_requests(void)
 {
-	std::string decoded;
-	decoded.reserve(encoded.length());
-
-	for (size_t i = 0; i < encoded.length(); ++i) {
-		if (encoded[i] == '%' && i + 2 < encoded.length()) {
-			/* 处理%XX格式的十六进制编码 */
-			std::string hex_str = encoded.substr(i + 1, 2);
-			char decoded_char = static_cast<char>(
-				std::stoi(hex_str, nullptr, 16));
-			decoded += decoded_char;
-			i += 2;
-		} else if (encoded[i] == '+') {
-			/* +号表示空格 */
-			decoded += ' ';
-		} else {
-			/* 普通字符直接保留 */
-			decoded += encoded[i];
-		}
+	uint64_t value;
+	ssize_t ret = read(wake_fd, &value, sizeof(value));
+	(void)ret;
+
+	std::vector<HttpCompletion> ready;
+	{
+		std::lock_guard<std::mutex> lock(completions_mutex);
+		ready.swap(completions);
 	}
 
-	return decoded;
+	for (auto &completion : ready) {
+		auto it = connections.find(completion.fd);
+		if (it == connections.end())
+			continue;
+
+		HttpConnection &conn = *it->second;
+		conn.busy = false;
+		conn.last_active = std::chrono::steady_clock::now();
+		conn.out_buffer = std::move(completion.data);
+		conn.out_offset = 0;
+		conn.out_shared = std::move(completion.shared_body);
+		conn.out_shared_offset = 0;
+		conn.out_file = std::move(completion.file_body);
+		conn.keep_alive = completion.keep_alive;
+
+		if (!flush_connection(conn))
+			close_connection(completion.fd);
+	}
 }
 
 /**
- * WebServer::url_encode - URL编码
- * @decoded: 原始字符串
+ * WebServer::flush_connection - 尽可能多地发送待发送数据
+ * @conn: 连接状态
  *
- * 将字符串进行URL编码，保留字母数字和部分特殊字符。
- * 空格编码为+号，其他特殊字符编码为%XX格式。
+ * 依次发送out_buffer、out_shared和out_file：前两者合并为一次
+ * sendmsg()，文件用sendfile()在内核中直接拷贝到socket。
  *
- * 返回: URL编码后的字符串
+ * 返回: 连接仍然可用返回true，需要关闭返回false
  */
-std::string WebServer::url_encode(const std::string &decoded)
+bool WebServer::flush_connection(HttpConnection &conn)
 {
-	std::string encoded;
-	encoded.reserve(decoded.length() * 3);
+	while (conn.out_offset < conn.out_buffer.size() ||
+	       (conn.out_shared &&
+		conn.out_shared_offset < conn.out_shared->size())) {
+		struct iovec iov[2];
+		size_t count = 0;
+		const size_t head_left = conn.out_buffer.size() - conn.out_offset;
+
+		if (head_left > 0) {
+			iov[count].iov_base = conn.out_buffer.data() + conn.out_offset;
+			iov[count].iov_len = head_left;
+			count++;
+		}
+		if (conn.out_shared &&
+		    conn.out_shared_offset < conn.out_shared->size()) {
+			iov[count].iov_base = const_cast<char *>(
+				conn.out_shared->data() + conn.out_shared_offset);
+			iov[count].iov_len = conn.out_shared->size() -
+					     conn.out_shared_offset;
+			count++;
+		}
 
-	for (char c : decoded) {
-		/* 保留字母数字和部分特殊字符 */
-		if (isalnum(static_cast<unsigned char>(c)) || c == '-' ||
-		    c == '_' || c == '.' || c == '~') {
-			encoded += c;
-		} else if (c == ' ') {
-			/* 空格编码为+号 */
-			encoded += '+';
-		} else {
-			/* 其他字符编码为%XX格式 */
-			char hex[4];
-			snprintf(hex, sizeof(hex), "%%%02X",
-				 static_cast<unsigned char>(c));
-			encoded += hex;
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+
+		ssize_t sent = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				/* 发送缓冲区已满，等待可写后继续 */
+				update_connection_events(conn.fd, EPOLLOUT);
+				return true;
+			}
+			return false;
 		}
+
+		http_bytes_sent.add(sent);
+		const size_t from_head = std::min<size_t>(sent, head_left);
+		conn.out_offset += from_head;
+		conn.out_shared_offset += sent - from_head;
 	}
 
-	return encoded;
+	while (conn.out_file && conn.out_file->length > 0) {
+		ssize_t sent = sendfile(conn.fd, conn.out_file->fd,
+					&conn.out_file->offset,
+					conn.out_file->length);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				update_connection_events(conn.fd, EPOLLOUT);
+				return true;
+			}
+			return false;
+		}
+		if (sent == 0)
+			return false; /* 文件被截短，已发出的Content-Length无法满足 */
+		http_bytes_sent.add(sent);
+		conn.out_file->length -= sent;
+	}
+
+	/* 响应发送完毕 */
+	conn.out_buffer.clear();
+	conn.out_buffer.shrink_to_fit();
+	conn.out_offset = 0;
+	conn.out_shared.reset();
+	conn.out_shared_offset = 0;
+	conn.out_file.reset();
+
+	if (!conn.keep_alive)
+		return false;
+
+	/* 推送连接不再读取请求，只关心对端是否关闭 */
+	if (conn.is_stream()) {
+		update_connection_events(conn.fd, EPOLLRDHUP);
+		return true;
+	}
+
+	update_connection_events(conn.fd, EPOLLIN | EPOLLRDHUP);
+
+	/* 处理已经在缓冲区中的流水线请求 */
+	return dispatch_request(conn);
 }
 
 /**
- * WebServer::parse_query_string - 解析URL查询参数
- * @query_string: URL查询字符串（如: path=/home&name=test.txt）
- *
- * 解析URL查询字符串，提取键值对。
+ * WebServer::update_connection_events - 修改连接的epoll监听事件
+ * @fd: 客户端socket描述符
+ * @events: 新的事件掩码
  *
- * 返回: 参数映射表
+ * 连接因出错已从epoll中移除时重新添加，让错误在下一轮事件中
+ * 被正常处理。
  */
-std::map<std::string, std::string>
-WebServer::parse_query_string(const std::string &query_string)
+void WebServer::update_connection_events(int fd, uint32_t events)
 {
-	std::map<std::string, std::string> params;
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.fd = fd;
 
-	std::istringstream stream(query_string);
-	std::string pair;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0 && errno == ENOENT)
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
 
-	while (std::getline(stream, pair, '&')) {
-		size_t pos = pair.find('=');
-		if (pos != std::string::npos) {
-			std::string key = url_decode(pair.substr(0, pos));
-			std::string value = url_decode(pair.substr(pos + 1));
-			params[key] = value;
-		}
+/**
+ * WebServer::close_connection - 关闭连接并释放其状态
+ * @fd: 客户端socket描述符
+ */
+void WebServer::close_connection(int fd)
+{
+	auto it = connections.find(fd);
+	if (it != connections.end() && it->second->stream_pid >= 0) {
+		auto stream = terminal_streams.find(it->second->stream_pid);
+		if (stream != terminal_streams.end() && stream->second == fd)
+			terminal_streams.erase(stream);
 	}
 
-	return params;
-}
+	if (it != connections.end() && it->second->watch_stream)
+		std::erase(watch_streams, fd);
+
+	if (it != connections.end() && it->second->search_job)
+		it->second->search_job->cancel();
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	connections.erase(fd);
+}
+
+/**
+ * WebServer::close_idle_connections - 关闭超时的空闲keep-alive连接
+ *
+ * 正在处理请求的连接、推送连接和暂停读取的上传连接不会被关闭。
+ */
+void WebServer::close_idle_connections(void)
+{
+	const auto deadline = std::chrono::steady_clock::now() -
+		std::chrono::milliseconds(HTTP_KEEP_ALIVE_TIMEOUT_MS);
+	std::vector<int> idle;
+
+	for (const auto &pair : connections) {
+		if (!pair.second->busy && !pair.second->is_stream() &&
+		    !pair.second->upload_paused &&
+		    pair.second->last_active < deadline)
+			idle.push_back(pair.first);
+	}
+
+	for (int fd : idle)
+		close_connection(fd);
+}
+
+
+/*
+ * ============================================================================
+ * 终端输出推送
+ * ============================================================================
+ */
+
+/**
+ * WebServer::start_terminal_stream - 把连接切换为终端输出推送
+ * @conn: 连接状态
+ * @request: 解析后的请求
+ *
+ * 进程不存在时返回404（EventSource收到非200响应后不会重连）。
+ * EventSource自动重连时带上最后收到的id（Last-Event-ID），
+ * 从该序号继续推送，断线期间的输出不会丢失。
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::start_terminal_stream(HttpConnection &conn,
+				      const HttpRequest &request)
+{
+	const HttpQuery &query = request.query;
+
+	pid_t pid = -1;
+	const std::string_view pid_str = query.get("pid");
+	std::from_chars(pid_str.data(), pid_str.data() + pid_str.size(), pid);
+
+	if (pid <= 0 || !terminal_manager ||
+	    !terminal_manager->get_process_info(pid).has_value()) {
+		HttpResponse response;
+		response.status_code = 404;
+		response.status_text = "Not Found";
+		response.headers["Content-Type"] = "application/json";
+		response.headers["Connection"] = "close";
+
+		json result;
+		result["success"] = false;
+		result["error"] = "Process not found";
+		response.body = result.dump();
+
+		conn.out_buffer = build_http_response(response);
+		conn.out_offset = 0;
+		conn.keep_alive = false;
+		return flush_connection(conn);
+	}
+
+	/* 同一进程只保留最新的订阅者 */
+	auto old = terminal_streams.find(pid);
+	if (old != terminal_streams.end() && old->second != conn.fd)
+		close_connection(old->second);
+
+	/* 续传位置：Last-Event-ID优先，其次since参数，否则从未读输出开始 */
+	std::string resume(query.get("since"));
+	if (const std::string_view *last_id = request.headers.find("Last-Event-ID"))
+		resume = *last_id;
+
+	uint64_t seq = 0;
+	if (resume.empty() ||
+	    std::from_chars(resume.data(), resume.data() + resume.size(),
+			    seq).ec != std::errc())
+		seq = terminal_manager->get_output_cursor(pid).value_or(0);
+
+	log_debug("终端输出推送: pid {}, 起始序号 {}", pid, seq);
+
+	conn.stream_pid = pid;
+	conn.stream_seq = seq;
+	conn.keep_alive = true;
+	conn.in_buffer.clear();
+	conn.out_buffer = "HTTP/1.1 200 OK\r\n"
+			  "Content-Type: text/event-stream\r\n"
+			  "Cache-Control: no-cache\r\n"
+			  "Connection: keep-alive\r\n"
+			  "\r\n";
+	conn.out_offset = 0;
+	terminal_streams[pid] = conn.fd;
+
+	return pump_terminal_stream(conn);
+}
+
+/**
+ * WebServer::notify_terminal_stream - 通知事件循环进程有新输出
+ * @pid: 进程ID
+ *
+ * 同一进程的多次通知在被处理前只入队一次。
+ */
+void WebServer::notify_terminal_stream(pid_t pid)
+{
+	std::lock_guard<std::mutex> lock(ready_streams_mutex);
+
+	if (!streams_enabled)
+		return;
+
+	if (std::find(ready_streams.begin(), ready_streams.end(), pid) !=
+	    ready_streams.end())
+		return;
+
+	ready_streams.push_back(pid);
+
+	uint64_t one = 1;
+	ssize_t ret = write(wake_fd, &one, sizeof(one));
+	(void)ret;
+}
 
 /**
- * WebServer::register_routes - 注册HTTP路由
+ * WebServer::pump_terminal_streams - 推送所有收到通知的进程的输出
+ */
+void WebServer::pump_terminal_streams(void)
+{
+	std::vector<pid_t> ready;
+	{
+		std::lock_guard<std::mutex> lock(ready_streams_mutex);
+		ready.swap(ready_streams);
+	}
+
+	for (pid_t pid : ready) {
+		auto stream = terminal_streams.find(pid);
+		if (stream == terminal_streams.end())
+			continue; /* 没有订阅者，输出留给轮询接口 */
+
+		int fd = stream->second;
+		auto it = connections.find(fd);
+		if (it == connections.end())
+			continue;
+
+		if (!pump_terminal_stream(*it->second))
+			close_connection(fd);
+	}
+}
+
+/**
+ * WebServer::pump_terminal_stream - 读取进程输出并写入推送连接
+ * @conn: 推送连接
  *
- * 注册所有API路由及其对应的处理函数。
- * 每个API路由使用lambda表达式绑定到对应的处理方法。
+ * 循环读取输出直到没有新数据、连接积压过多或用完本轮预算。
+ * 用完预算时重新入队，让事件循环先处理其他连接。
+ * 进程已结束且输出已取完时推送exit事件，发送完后关闭连接。
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::pump_terminal_stream(HttpConnection &conn)
+{
+	/* exit事件已发出，只需要把剩余数据发完 */
+	if (!conn.keep_alive)
+		return flush_connection(conn);
+
+	const pid_t pid = conn.stream_pid;
+	bool exited = false;
+
+	for (int budget = TERMINAL_STREAM_PUMP_BUDGET; budget > 0; budget--) {
+		if (conn.out_buffer.size() - conn.out_offset >=
+		    TERMINAL_STREAM_HIGH_WATER) {
+			if (!flush_connection(conn))
+				return false;
+			if (conn.out_buffer.size() - conn.out_offset >=
+			    TERMINAL_STREAM_HIGH_WATER)
+				return true; /* 等待EPOLLOUT后继续 */
+		}
+
+		/* 直接从终端的回滚缓冲区转义写入发送缓冲区 */
+		auto next = terminal_manager->read_output_from(pid,
+			conn.stream_seq, TERMINAL_STREAM_HIGH_WATER,
+			[this, &conn](uint64_t seq, std::string_view chunk) {
+				append_stream_output(conn, chunk,
+						     seq + chunk.size());
+			});
+		if (!next.has_value()) {
+			exited = true; /* 进程已被清理 */
+			break;
+		}
+
+		bool idle = next.value() == conn.stream_seq;
+		conn.stream_seq = next.value();
+
+		if (idle) {
+			auto info = terminal_manager->get_process_info(pid);
+			if (!info.has_value() || !info->is_running)
+				exited = true;
+			break;
+		}
+
+		if (budget == 1)
+			notify_terminal_stream(pid);
+	}
+
+	if (exited) {
+		if (!conn.stream_partial.empty()) {
+			std::string partial;
+			partial.swap(conn.stream_partial);
+			conn.out_buffer += "id: ";
+			conn.out_buffer += std::to_string(conn.stream_seq);
+			conn.out_buffer += "\nevent: output\ndata: {\"output\":\"";
+			append_json_string(conn.out_buffer, partial);
+			conn.out_buffer += "\"}\n\n";
+		}
+
+		conn.out_buffer += "event: exit\ndata: {\"pid\":";
+		conn.out_buffer += std::to_string(pid);
+		conn.out_buffer += "}\n\n";
+		conn.keep_alive = false;
+		terminal_streams.erase(pid);
+	}
+
+	return flush_connection(conn);
+}
+
+/**
+ * WebServer::append_stream_output - 把一段终端输出编码为SSE事件
+ * @conn: 推送连接
+ * @data: 终端输出
+ *
+ * @end_seq: data之后的输出序号
+ *
+ * 事件数据是单行JSON，输出中的换行和控制字符都已转义。事件id是
+ * 已发送部分之后的序号，不包含暂存的不完整字符，重连时从字符
+ * 边界继续。
+ */
+void WebServer::append_stream_output(HttpConnection &conn,
+				     std::string_view data, uint64_t end_seq)
+{
+	std::string joined;
+	if (!conn.stream_partial.empty()) {
+		joined = std::move(conn.stream_partial);
+		joined.append(data);
+		data = joined;
+	}
+
+	/* 找到末尾可能不完整的UTF-8字符的起始位置 */
+	size_t complete = data.size();
+	for (size_t back = 1; back <= 3 && back <= data.size(); back++) {
+		unsigned char c = static_cast<unsigned char>(data[data.size() - back]);
+		if ((c & 0xc0) == 0x80)
+			continue; /* 后续字节，继续向前找首字节 */
+
+		size_t need = (c >= 0xf0) ? 4 : (c >= 0xe0) ? 3 :
+			      (c >= 0xc0) ? 2 : 1;
+		if (need > back)
+			complete = data.size() - back;
+		break;
+	}
+
+	conn.stream_partial.assign(data.substr(complete));
+	if (complete == 0)
+		return;
+
+	conn.out_buffer += "id: ";
+	conn.out_buffer += std::to_string(end_seq - conn.stream_partial.size());
+	conn.out_buffer += "\nevent: output\ndata: {\"output\":\"";
+	append_json_string(conn.out_buffer, data.substr(0, complete));
+	conn.out_buffer += "\"}\n\n";
+}
+
+/*
+ * ============================================================================
+ * 目录变化推送
+ * ============================================================================
+ */
+
+/**
+ * WebServer::start_watch_stream - 把连接切换为目录变化推送
+ * @conn: 连接状态
+ *
+ * 监视器不可用时返回503，前端退回到按命令猜测是否刷新。
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::start_watch_stream(HttpConnection &conn)
+{
+	if (!file_watcher->is_running()) {
+		HttpResponse response;
+		response.status_code = 503;
+		response.status_text = "Service Unavailable";
+		response.headers["Content-Type"] = "application/json";
+		response.headers["Connection"] = "close";
+
+		json result;
+		result["success"] = false;
+		result["error"] = "File watcher is not available";
+		response.body = result.dump();
+
+		conn.out_buffer = build_http_response(response);
+		conn.out_offset = 0;
+		conn.keep_alive = false;
+		return flush_connection(conn);
+	}
+
+	conn.watch_stream = true;
+	conn.keep_alive = true;
+	conn.in_buffer.clear();
+	conn.out_buffer = "HTTP/1.1 200 OK\r\n"
+			  "Content-Type: text/event-stream\r\n"
+			  "Cache-Control: no-cache\r\n"
+			  "Connection: keep-alive\r\n"
+			  "\r\n";
+	conn.out_offset = 0;
+	watch_streams.push_back(conn.fd);
+
+	return flush_connection(conn);
+}
+
+/**
+ * WebServer::notify_watch_stream - 编码一批目录变化并唤醒事件循环
+ * @deltas: 目录变化
+ *
+ * 目录列表不显示隐藏文件，隐藏项的变化不推送；在隐藏名称和普通
+ * 名称之间的重命名转换为新增或删除。文件项的字段与
+ * /api/directory-contents 一致，前端可以直接插入列表。
+ */
+void WebServer::notify_watch_stream(const std::vector<FileDelta> &deltas)
+{
+	json changes = json::array();
+
+	for (const auto &delta : deltas) {
+		FileDelta::Kind kind = delta.kind;
+		bool old_hidden = kind == FileDelta::Kind::RENAME &&
+			file_manager->get_file_name(delta.old_path)[0] == '.';
+
+		if (kind == FileDelta::Kind::RENAME) {
+			if (old_hidden && delta.is_hidden)
+				continue;
+			if (old_hidden)
+				kind = FileDelta::Kind::ADD;
+			else if (delta.is_hidden)
+				kind = FileDelta::Kind::REMOVE;
+		} else if (kind != FileDelta::Kind::RESCAN && delta.is_hidden) {
+			continue;
+		}
+
+		json change;
+		switch (kind) {
+		case FileDelta::Kind::ADD:
+			change["type"] = "add";
+			break;
+		case FileDelta::Kind::REMOVE:
+			change["type"] = "remove";
+			break;
+		case FileDelta::Kind::RENAME:
+			change["type"] = "rename";
+			break;
+		case FileDelta::Kind::MODIFY:
+			change["type"] = "modify";
+			break;
+		case FileDelta::Kind::RESCAN:
+			change["type"] = "rescan";
+			break;
+		}
+
+		/* 转换为删除的重命名，删除的是原来的路径 */
+		bool use_old = delta.kind == FileDelta::Kind::RENAME &&
+			       kind == FileDelta::Kind::REMOVE;
+		change["directory"] = use_old ? delta.old_directory : delta.directory;
+
+		if (kind != FileDelta::Kind::RESCAN) {
+			const std::string &item_path = use_old ? delta.old_path :
+								 delta.path;
+			change["path"] = item_path;
+			change["name"] = file_manager->get_file_name(item_path);
+			change["isDirectory"] = delta.is_directory;
+			change["size"] = delta.size;
+			change["mimeType"] = delta.is_directory ? "inode/directory" : "";
+			change["isBinary"] = false;
+		}
+
+		if (kind == FileDelta::Kind::RENAME) {
+			change["oldDirectory"] = delta.old_directory;
+			change["oldPath"] = delta.old_path;
+		}
+
+		changes.push_back(std::move(change));
+	}
+
+	if (changes.empty())
+		return;
+
+	json data;
+	data["changes"] = std::move(changes);
+
+	std::lock_guard<std::mutex> lock(ready_streams_mutex);
+
+	if (!streams_enabled)
+		return;
+
+	bool idle = watch_events.empty();
+	watch_events += "event: changes\ndata: ";
+	watch_events += data.dump();
+	watch_events += "\n\n";
+
+	if (idle) {
+		uint64_t one = 1;
+		ssize_t ret = write(wake_fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+/**
+ * file_operation_json - 把文件操作进度编码为JSON
+ */
+static json file_operation_json(const FileOperationProgress &progress)
+{
+	static const char *const kinds[] = { "delete", "copy", "move" };
+	static const char *const states[] = { "running", "done", "failed",
+					      "cancelled" };
+
+	json result;
+	result["id"] = progress.id;
+	result["type"] = kinds[static_cast<int>(progress.kind)];
+	result["state"] = states[static_cast<int>(progress.state)];
+	result["found"] = progress.found;
+	result["done"] = progress.done;
+	result["bytes"] = progress.bytes;
+	result["errors"] = progress.errors;
+	result["error"] = progress.first_error;
+	result["elapsedMs"] = progress.elapsed_ms;
+	return result;
+}
+
+/**
+ * WebServer::notify_file_operation - 编码文件操作进度并唤醒事件循环
+ * @progress: 任务进度
+ *
+ * 与目录变化共用推送连接和待推送缓冲区。
+ */
+void WebServer::notify_file_operation(const FileOperationProgress &progress)
+{
+	const std::string data = file_operation_json(progress).dump();
+
+	std::lock_guard<std::mutex> lock(ready_streams_mutex);
+
+	if (!streams_enabled)
+		return;
+
+	bool idle = watch_events.empty();
+	watch_events += "event: operation\ndata: ";
+	watch_events += data;
+	watch_events += "\n\n";
+
+	if (idle) {
+		uint64_t one = 1;
+		ssize_t ret = write(wake_fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+/**
+ * WebServer::pump_watch_streams - 把等待推送的目录变化写入所有推送连接
+ *
+ * 积压过多的连接直接关闭而不是无限缓存：客户端重连后重新加载
+ * 目录即可恢复一致。
+ */
+void WebServer::pump_watch_streams(void)
+{
+	std::string events;
+	{
+		std::lock_guard<std::mutex> lock(ready_streams_mutex);
+		events.swap(watch_events);
+	}
+
+	if (events.empty())
+		return;
+
+	const std::vector<int> streams = watch_streams;
+	for (int fd : streams) {
+		auto it = connections.find(fd);
+		if (it == connections.end())
+			continue;
+
+		HttpConnection &conn = *it->second;
+		if (conn.out_buffer.size() - conn.out_offset >=
+		    TERMINAL_STREAM_HIGH_WATER) {
+			close_connection(fd);
+			continue;
+		}
+
+		conn.out_buffer += events;
+		if (!flush_connection(conn))
+			close_connection(fd);
+	}
+}
+
+/*
+ * ============================================================================
+ * 工作区搜索推送
+ * ============================================================================
+ */
+
+/**
+ * WebServer::start_search_stream - 开始工作区搜索，把连接切换为结果推送
+ * @conn: 连接状态
+ * @request: 解析后的请求
+ *
+ * 搜索内容非法或根目录不存在时返回400。已打开的文件按
+ * open-file-virtual 时的路径查找，搜索其中未保存的内容。
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::start_search_stream(HttpConnection &conn,
+				    const HttpRequest &request)
+{
+	const HttpQuery &query = request.query;
+
+	SearchOptions options;
+	options.pattern = query.get("query");
+	options.regex = query.get("regex") == "1" || query.get("regex") == "true";
+	options.case_sensitive = query.get("caseSensitive") == "1" ||
+				 query.get("caseSensitive") == "true";
+	options.whole_word = query.get("wholeWord") == "1" ||
+			     query.get("wholeWord") == "true";
+
+	const std::string_view max_str = query.get("maxResults");
+	size_t max_results = 0;
+	if (std::from_chars(max_str.data(), max_str.data() + max_str.size(),
+			    max_results).ec == std::errc() && max_results > 0)
+		options.max_results = max_results;
+
+	std::string root(query.get("path"));
+	auto pattern = SearchPattern::compile(options);
+	std::string error;
+	if (!pattern.has_value())
+		error = pattern.error();
+	else if (root.empty() || !file_manager->is_directory(root))
+		error = "Directory not found";
+
+	if (!error.empty()) {
+		HttpResponse response;
+		response.status_code = 400;
+		response.status_text = "Bad Request";
+		response.headers["Content-Type"] = "application/json";
+		response.headers["Connection"] = "close";
+
+		json result;
+		result["success"] = false;
+		result["error"] = error;
+		response.body = result.dump();
+
+		conn.out_buffer = build_http_response(response);
+		conn.out_offset = 0;
+		conn.keep_alive = false;
+		return flush_connection(conn);
+	}
+
+	while (root.size() > 1 && root.back() == '/')
+		root.pop_back();
+
+	auto job = std::make_shared<SearchJob>(
+		file_manager, root, std::move(pattern.value()),
+		[this](const std::string &file_path) {
+			return text_buffers.find(file_path);
+		});
+
+	log_debug("工作区搜索: {}", root);
+
+	/* done事件之后关闭连接，keep_alive在此之前保持为true */
+	conn.search_job = job;
+	conn.keep_alive = true;
+	conn.in_buffer.clear();
+	conn.out_buffer = "HTTP/1.1 200 OK\r\n"
+			  "Content-Type: text/event-stream\r\n"
+			  "Cache-Control: no-cache\r\n"
+			  "Connection: close\r\n"
+			  "\r\n";
+	conn.out_offset = 0;
+
+	const int fd = conn.fd;
+	const SearchJob *raw = job.get();
+	if (!job->start(search_pool, [this, fd, raw]() {
+		    notify_search_stream(fd, raw);
+	    }))
+		return false;
+
+	return pump_search_stream(conn);
+}
+
+/**
+ * WebServer::notify_search_stream - 通知事件循环搜索有新结果
+ * @fd: 推送连接
+ * @job: 搜索任务
+ */
+void WebServer::notify_search_stream(int fd, const SearchJob *job)
+{
+	std::lock_guard<std::mutex> lock(ready_streams_mutex);
+
+	if (!streams_enabled)
+		return;
+
+	bool idle = ready_searches.empty();
+	ready_searches.emplace_back(fd, job);
+
+	if (idle) {
+		uint64_t one = 1;
+		ssize_t ret = write(wake_fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+/**
+ * WebServer::pump_search_streams - 推送所有收到通知的搜索的结果
+ *
+ * 通知到达前连接可能已经关闭，fd号甚至已被新连接复用，只处理
+ * 仍然持有同一个搜索任务的连接。
+ */
+void WebServer::pump_search_streams(void)
+{
+	std::vector<std::pair<int, const SearchJob *>> ready;
+	{
+		std::lock_guard<std::mutex> lock(ready_streams_mutex);
+		ready.swap(ready_searches);
+	}
+
+	for (const auto &[fd, job] : ready) {
+		auto it = connections.find(fd);
+		if (it == connections.end() || it->second->search_job.get() != job)
+			continue;
+
+		if (!pump_search_stream(*it->second))
+			close_connection(fd);
+	}
+}
+
+/**
+ * WebServer::pump_search_stream - 取走搜索结果写入推送连接
+ * @conn: 推送连接
+ *
+ * 返回: 连接仍然可用返回true，需要关闭返回false
+ */
+bool WebServer::pump_search_stream(HttpConnection &conn)
+{
+	/* done事件已取走，只需要把剩余数据发完 */
+	if (!conn.keep_alive)
+		return flush_connection(conn);
+
+	if (conn.out_buffer.size() - conn.out_offset >=
+	    TERMINAL_STREAM_HIGH_WATER) {
+		if (!flush_connection(conn))
+			return false;
+		if (conn.out_buffer.size() - conn.out_offset >=
+		    TERMINAL_STREAM_HIGH_WATER)
+			return true; /* 等待EPOLLOUT后继续 */
+	}
+
+	if (conn.search_job->take_output(conn.out_buffer))
+		conn.keep_alive = false;
+
+	return flush_connection(conn);
+}
+
+/**
+ * WebServer::build_http_response - 构造HTTP响应字符串
+ * @response: 响应结构体，包含状态码、状态文本、响应头和响应体
+ *
+ * 将HttpResponse结构体转换为符合HTTP/1.1规范的响应字符串。
+ * 未设置Content-Length时按响应体长度自动补充。
+ *
+ * 返回: HTTP响应字符串
+ */
+std::string WebServer::build_http_response(const HttpResponse &response)
+{
+	std::ostringstream oss;
+
+	/* 状态行 (如: HTTP/1.1 200 OK) */
+	oss << "HTTP/1.1 " << response.status_code << " "
+	    << response.status_text << "\r\n";
+
+	/* 响应头 */
+	for (const auto &header : response.headers)
+		oss << header.first << ": " << header.second << "\r\n";
+
+	/*
+	 * keep-alive连接依赖Content-Length确定响应体边界
+	 * 304响应没有响应体，不发送Content-Length
+	 */
+	size_t body_length = response.body.size();
+	if (response.shared_body)
+		body_length = response.shared_body->size();
+	else if (response.file_body)
+		body_length = response.file_body->length;
+
+	if (response.status_code != 304 &&
+	    response.headers.find("Content-Length") == response.headers.end())
+		oss << "Content-Length: " << body_length << "\r\n";
+
+	/* 空行分隔响应头和响应体 */
+	oss << "\r\n";
+
+	/* 响应体（共享响应体和文件响应体由flush_connection()发送） */
+	if (!response.shared_body && !response.file_body)
+		oss << response.body;
+
+	return oss.str();
+}
+
+/**
+ * WebServer::url_encode - URL编码
+ * @decoded: 原始字符串
+ *
+ * 将字符串进行URL编码，保留字母数字和部分特殊字符。
+ * 空格编码为+号，其他特殊字符编码为%XX格式。
+ *
+ * 返回: URL编码后的字符串
+ */
+std::string WebServer::url_encode(const std::string &decoded)
+{
+	std::string encoded;
+	encoded.reserve(decoded.length() * 3);
+
+	for (char c : decoded) {
+		/* 保留字母数字和部分特殊字符 */
+		if (isalnum(static_cast<unsigned char>(c)) || c == '-' ||
+		    c == '_' || c == '.' || c == '~') {
+			encoded += c;
+		} else if (c == ' ') {
+			/* 空格编码为+号 */
+			encoded += '+';
+		} else {
+			/* 其他字符编码为%XX格式 */
+			char hex[4];
+			snprintf(hex, sizeof(hex), "%%%02X",
+				 static_cast<unsigned char>(c));
+			encoded += hex;
+		}
+	}
+
+	return encoded;
+}
+
+/**
+ * WebServer::routes - HTTP路由表
+ *
+ * 每个API路由对应一个处理方法。路由索引在编译时由这张表建立，
+ * 路径重复时编译失败。处理函数为nullptr的路径（推送、上传）只用于
+ * 指标，请求在事件循环中单独处理。
  *
  * API列表：
  * - /api/open-folder: 打开文件夹对话框
@@ -705,209 +1697,227 @@ WebServer::parse_query_string(const std::string &query_string)
  * - /api/file-info: 获取文件信息
  * - /api/save-all: 批量保存文件
  * - /api/refresh: 刷新文件列表
+ * - /api/watch-directories: 设置监视的目录（变化通过推送连接发送）
  * - /api/change-wallpaper: 更换壁纸
  */
-void WebServer::register_routes(void)
-{
-	routes["/api/open-folder"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_open_folder_dialog(path, headers, body);
-	};
-
-	routes["/api/directory-contents"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_get_directory_contents(path, headers, body);
-	};
-
-	routes["/api/read-file"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_read_file(path, headers, body);
-	};
+constexpr WebServer::Route WebServer::routes[] = {
+	{ "/api/open-folder", &WebServer::handle_open_folder_dialog },
+	{ "/api/directory-contents", &WebServer::handle_get_directory_contents },
+	{ "/api/read-file", &WebServer::handle_read_file },
+	{ "/api/read-binary-file", &WebServer::handle_read_binary_file },
+	{ "/api/save-file", &WebServer::handle_save_file },
+	{ "/api/create-folder", &WebServer::handle_create_folder },
+	{ "/api/create-file", &WebServer::handle_create_file },
+	{ "/api/delete", &WebServer::handle_delete },
+	{ "/api/file-operation", &WebServer::handle_file_operation },
+	{ "/api/file-operation-status", &WebServer::handle_file_operation_status },
+	{ "/api/cancel-file-operation", &WebServer::handle_cancel_file_operation },
+	{ "/api/rename", &WebServer::handle_rename },
+	{ "/api/file-info", &WebServer::handle_get_file_info },
+	{ "/api/save-all", &WebServer::handle_save_all },
+	{ "/api/refresh", &WebServer::handle_refresh },
+	{ "/api/refresh-directory", &WebServer::handle_refresh_directory },
+	{ "/api/watch-directories", &WebServer::handle_watch_directories },
+	{ "/api/change-wallpaper", &WebServer::handle_change_wallpaper },
+	{ "/api/get-wallpapers", &WebServer::handle_get_wallpapers },
+
+	/* 高性能编辑器 API 路由（基于 TextBuffer 虚拟化渲染） */
+	{ "/api/open-file-virtual", &WebServer::handle_open_file_virtual },
+	{ "/api/get-lines", &WebServer::handle_get_lines },
+	{ "/api/get-line-count", &WebServer::handle_get_line_count },
+	{ "/api/edit-insert", &WebServer::handle_edit_insert },
+	{ "/api/edit-delete", &WebServer::handle_edit_delete },
+	{ "/api/edit-replace", &WebServer::handle_edit_replace },
+	{ "/api/edit-undo", &WebServer::handle_edit_undo },
+	{ "/api/edit-redo", &WebServer::handle_edit_redo },
+	{ "/api/search-buffer", &WebServer::handle_search_buffer },
+	{ "/api/save-file-virtual", &WebServer::handle_save_file_virtual },
+	{ "/api/close-file-virtual", &WebServer::handle_close_file_virtual },
+
+	/* 终端 API 路由 */
+	{ "/api/terminal-info", &WebServer::handle_terminal_info },
+	{ "/api/terminal-execute", &WebServer::handle_terminal_execute },
+	{ "/api/terminal-get-output", &WebServer::handle_terminal_get_output },
+	{ "/api/terminal-send-input", &WebServer::handle_terminal_send_input },
+	{ TERMINAL_INPUT_BATCH_PATH, &WebServer::handle_terminal_input_batch },
+	{ "/api/terminal-kill-process", &WebServer::handle_terminal_kill_process },
+
+	/* 运行状态 */
+	{ "/api/metrics", &WebServer::handle_metrics },
+	{ "/api/startup-trace", &WebServer::handle_startup_trace },
+
+	/* 推送和上传 */
+	{ FILE_UPLOAD_PATH, nullptr },
+	{ TERMINAL_STREAM_PATH, nullptr },
+	{ FILE_WATCH_STREAM_PATH, nullptr },
+	{ SEARCH_STREAM_PATH, nullptr },
+};
+
+constexpr RouteIndex WebServer::route_index(WebServer::routes);
 
-	routes["/api/read-binary-file"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_read_binary_file(path, headers, body);
-	};
-
-	routes["/api/save-file"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_save_file(path, headers, body);
-	};
-
-	routes["/api/create-folder"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_create_folder(path, headers, body);
-	};
-
-	routes["/api/create-file"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_create_file(path, headers, body);
-	};
-
-	routes["/api/delete"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_delete(path, headers, body);
-	};
-
-	routes["/api/rename"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_rename(path, headers, body);
-	};
-
-	routes["/api/file-info"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_get_file_info(path, headers, body);
-	};
-
-	routes["/api/save-all"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_save_all(path, headers, body);
-	};
-
-	routes["/api/refresh"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_refresh(path, headers, body);
-	};
+/**
+ * WebServer::find_route - 查找路由
+ * @route: 不含查询字符串的路径
+ */
+int WebServer::find_route(std::string_view route)
+{
+	return route_index.find(route);
+}
 
-	routes["/api/refresh-directory"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_refresh_directory(path, headers, body);
+/**
+ * WebServer::register_route_metrics - 为每个路由注册指标
+ *
+ * 推送路径和流式上传也在路由表中；推送连接只计请求数，不计耗时。
+ */
+void WebServer::register_route_metrics(void)
+{
+	Metrics &registry = Metrics::instance();
+	auto add = [&](std::string_view route) {
+		const std::string label = Metrics::label("route", route);
+		RouteMetrics metrics;
+		metrics.requests = &registry.counter(
+			"mikufy_http_requests_total", "按路由统计的HTTP请求数",
+			label);
+		metrics.latency = &registry.histogram(
+			"mikufy_http_request_duration_seconds",
+			"按路由统计的请求处理耗时（不含发送）", label);
+		return metrics;
 	};
 
-	routes["/api/change-wallpaper"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_change_wallpaper(path, headers, body);
-	};
+	route_metrics.reserve(std::size(routes));
+	for (const Route &route : routes)
+		route_metrics.push_back(add(route.path));
 
-	routes["/api/get-wallpapers"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_get_wallpapers(path, headers, body);
-	};
+	/* 静态文件的路径不固定，合计为一个 */
+	static_metrics = add("static");
+}
 
-	/*
-	 * 高性能编辑器 API 路由（基于 TextBuffer 虚拟化渲染）
-	 */
-	routes["/api/open-file-virtual"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_open_file_virtual(path, headers, body);
-	};
+/**
+ * WebServer::metrics_for_route - 查找路由的指标
+ * @route: 不含查询字符串的路径
+ */
+const WebServer::RouteMetrics &
+WebServer::metrics_for_route(std::string_view route) const
+{
+	const int index = find_route(route);
+	return index >= 0 ? route_metrics[index] : static_metrics;
+}
 
-	routes["/api/get-lines"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_get_lines(path, headers, body);
-	};
+/**
+ * WebServer::handle_metrics - 导出运行指标
+ *
+ * 请求日志只在debug级别输出；需要观察请求量和耗时时采集本接口，
+ * 例如按 rate(mikufy_http_requests_total[1m]) 计算每秒请求数。
+ */
+HttpResponse WebServer::handle_metrics(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+	(void)body;
 
-	routes["/api/get-line-count"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_get_line_count(path, headers, body);
-	};
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "text/plain; version=0.0.4; charset=utf-8";
+	response.headers["Cache-Control"] = "no-cache";
+
+	Metrics::instance().render(response.body);
+
+	/* 在注册表锁外读取大小，不等待正在编辑的缓冲区 */
+	std::vector<std::shared_ptr<TextBuffer>> buffers = text_buffers.snapshot();
+
+	size_t buffer_chars = 0;
+	size_t buffer_memory = 0;
+	size_t buffers_compacted = 0;
+	for (const auto &buffer : buffers) {
+		buffer_chars += buffer->get_char_count();
+		buffer_memory += buffer->memory_usage();
+		if (buffer->is_compacted())
+			buffers_compacted++;
+	}
 
-	routes["/api/edit-insert"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_edit_insert(path, headers, body);
-	};
+	Metrics::render_gauge(response.body, "mikufy_textbuffers_open",
+			      "已打开的TextBuffer数量", buffers.size());
+	Metrics::render_gauge(response.body, "mikufy_textbuffer_chars",
+			      "已打开的TextBuffer合计字节数", buffer_chars);
+	Metrics::render_gauge(response.body, "mikufy_textbuffer_memory_bytes",
+			      "已打开的TextBuffer估算占用的内存", buffer_memory);
+	Metrics::render_gauge(response.body, "mikufy_textbuffers_compacted",
+			      "处于压缩状态的TextBuffer数量",
+			      buffers_compacted);
+	Metrics::render_gauge(response.body, "mikufy_static_cache_bytes",
+			      "静态资源缓存占用的字节数",
+			      static_cache.memory_usage());
+
+	StartupTrace::instance().render(response.body);
 
-	routes["/api/edit-delete"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_edit_delete(path, headers, body);
-	};
+	return response;
+}
 
-	routes["/api/edit-replace"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_edit_replace(path, headers, body);
-	};
+/**
+ * WebServer::handle_startup_trace - 处理启动耗时API
+ * @query: 查询参数（未使用）
+ * @headers: 请求头（未使用）
+ * @body: JSON请求体，可以为空
+ *
+ * 请求体：{ "mark": "阶段名称", "finish": true }，前端在初始化的各个
+ * 阶段上报，finish为true时结束跟踪并把各阶段耗时写入日志。请求体
+ * 为空时只查询。
+ *
+ * 返回: JSON响应，包含success、finished和marks字段
+ */
+HttpResponse WebServer::handle_startup_trace(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
 
-	routes["/api/close-file-virtual"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_close_file_virtual(path, headers, body);
-	};
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
 
-	/*
-	 * 终端 API 路由
-	 */
-	routes["/api/terminal-info"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_terminal_info(path, headers, body);
-	};
+	StartupTrace &trace = StartupTrace::instance();
 
-	routes["/api/terminal-execute"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_terminal_execute(path, headers, body);
-	};
+	try {
+		if (!body.empty()) {
+			json request = json::parse(body);
+			const std::string mark = request.value("mark", "");
+			if (!mark.empty()) {
+				if (request.value("finish", false))
+					trace.finish("frontend:" + mark);
+				else
+					trace.mark("frontend:" + mark);
+			}
+		}
 
-	routes["/api/terminal-get-output"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_terminal_get_output(path, headers, body);
-	};
+		json marks = json::array();
+		for (const StartupMark &mark : trace.marks())
+			marks.push_back({ { "name", mark.name },
+					  { "ms", mark.elapsed_us / 1000.0 },
+					  { "tid", mark.tid } });
 
-	routes["/api/terminal-send-input"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_terminal_send_input(path, headers, body);
-	};
+		json result;
+		result["success"] = true;
+		result["finished"] = trace.finished();
+		result["marks"] = std::move(marks);
+		response.body = result.dump();
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
 
-	routes["/api/terminal-kill-process"] = [this](
-			const std::string &path,
-			const std::map<std::string, std::string> &headers,
-			const std::string &body) {
-		return handle_terminal_kill_process(path, headers, body);
-	};
+	return response;
 }
 
 /**
  * WebServer::handle_open_folder_dialog - 处理打开文件夹对话框API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
  * @body: 请求体（未使用）
  *
@@ -916,10 +1926,10 @@ void WebServer::register_routes(void)
  * 返回: JSON响应，包含success和path字段
  */
 HttpResponse WebServer::handle_open_folder_dialog(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -934,10 +1944,10 @@ HttpResponse WebServer::handle_open_folder_dialog(
 		if (open_folder_callback)
 			folder_path = open_folder_callback();
 	} catch (const std::exception &e) {
-		std::cerr << "打开文件夹对话框异常: " << e.what() << std::endl;
+		log_error("打开文件夹对话框异常: {}", e.what());
 		folder_path = "";
 	} catch (...) {
-		std::cerr << "打开文件夹对话框发生未知异常" << std::endl;
+		log_error("打开文件夹对话框发生未知异常");
 		folder_path = "";
 	}
 
@@ -952,17 +1962,19 @@ HttpResponse WebServer::handle_open_folder_dialog(
 
 /**
  * WebServer::handle_get_directory_contents - 处理获取目录内容API
- * @path: 请求路径，包含查询参数path
+ * @query: 查询参数，包含path
  * @headers: 请求头（未使用）
  * @body: 请求体（未使用）
  *
- * 获取指定目录下的所有文件和子目录列表。
+ * 分页获取指定目录下的文件和子目录列表，目录在前、按名称排序。
  * 查询参数：path - 目录路径
+ *           limit - 每页条目数（可选，默认 MAX_DIR_ENTRIES）
+ *           cursor - 上一页返回的nextCursor（可选）
  *
- * 返回: JSON响应，包含success和files数组
+ * 返回: JSON响应，包含success、files数组、total、nextCursor和hasMore
  */
 HttpResponse WebServer::handle_get_directory_contents(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
 	(void)headers;
@@ -973,14 +1985,8 @@ HttpResponse WebServer::handle_get_directory_contents(
 	response.status_text = "OK";
 	response.headers["Content-Type"] = "application/json";
 
-	/* 解析查询参数 */
-	size_t query_pos = path.find('?');
-	std::string query_str = (query_pos != std::string::npos) ?
-				path.substr(query_pos + 1) :
-				"";
-	auto params = parse_query_string(query_str);
 
-	std::string directory_path = params["path"];
+	std::string directory_path(query.get("path"));
 
 	if (directory_path.empty()) {
 		json result;
@@ -990,16 +1996,21 @@ HttpResponse WebServer::handle_get_directory_contents(
 		return response;
 	}
 
-	std::vector<FileInfo> files;
-	bool success = file_manager->get_directory_contents(directory_path,
-					     files);
+	const std::string_view limit_str = query.get("limit");
+	size_t limit = MAX_DIR_ENTRIES;
+	std::from_chars(limit_str.data(), limit_str.data() + limit_str.size(),
+			limit);
+
+	DirectoryPage page;
+	bool success = file_manager->list_directory(directory_path,
+						    std::string(query.get("cursor")), limit, page);
 
 	json result;
 	result["success"] = success;
 
 	if (success) {
 		json files_array = json::array();
-		for (const auto &file : files) {
+		for (const auto &file : page.files) {
 			json file_obj;
 			file_obj["name"] = file.name;
 			file_obj["path"] = file.path;
@@ -1010,6 +2021,12 @@ HttpResponse WebServer::handle_get_directory_contents(
 			files_array.push_back(file_obj);
 		}
 		result["files"] = files_array;
+		result["total"] = page.total;
+		result["hasMore"] = !page.next_cursor.empty();
+		if (page.next_cursor.empty())
+			result["nextCursor"] = nullptr;
+		else
+			result["nextCursor"] = page.next_cursor;
 	}
 
 	response.body = result.dump();
@@ -1019,7 +2036,7 @@ HttpResponse WebServer::handle_get_directory_contents(
 
 /**
  * WebServer::handle_read_file - 处理读取文件API
- * @path: 请求路径，包含查询参数path
+ * @query: 查询参数，包含path
  * @headers: 请求头（未使用）
  * @body: 请求体（未使用）
  *
@@ -1029,7 +2046,7 @@ HttpResponse WebServer::handle_get_directory_contents(
  * 返回: JSON响应，包含success和content字段
  */
 HttpResponse WebServer::handle_read_file(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
 	(void)headers;
@@ -1040,14 +2057,8 @@ HttpResponse WebServer::handle_read_file(
 	response.status_text = "OK";
 	response.headers["Content-Type"] = "application/json";
 
-	/* 解析查询参数 */
-	size_t query_pos = path.find('?');
-	std::string query_str = (query_pos != std::string::npos) ?
-				path.substr(query_pos + 1) :
-				"";
-	auto params = parse_query_string(query_str);
 
-	std::string file_path = params["path"];
+	std::string file_path(query.get("path"));
 	if (file_path.empty()) {
 		json result;
 		result["success"] = false;
@@ -1056,12 +2067,12 @@ HttpResponse WebServer::handle_read_file(
 		return response;
 	}
 
-	std::string content;
+	FileContent content;
 	bool success = file_manager->read_file(file_path, content);
 
 	json result;
 	result["success"] = success;
-	result["content"] = content;
+	result["content"] = success ? *content : std::string();
 
 	response.body = result.dump();
 	return response;
@@ -1069,24 +2080,17 @@ HttpResponse WebServer::handle_read_file(
 
 /* 处理读取二进制文件API（用于图片、视频等） */
 HttpResponse WebServer::handle_read_binary_file(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)headers;
 	(void)body;
 
 	HttpResponse response;
 	response.status_code = 200;
 	response.status_text = "OK";
 
-	/* 解析查询参数 */
-	size_t query_pos = path.find('?');
-	std::string query_str = (query_pos != std::string::npos) ?
-				path.substr(query_pos + 1) :
-				"";
-	auto params = parse_query_string(query_str);
 
-	std::string file_path = params["path"];
+	std::string file_path(query.get("path"));
 	if (file_path.empty()) {
 		response.status_code = 400;
 		response.status_text = "Bad Request";
@@ -1094,28 +2098,27 @@ HttpResponse WebServer::handle_read_binary_file(
 		return response;
 	}
 
-	/* 获取文件MIME类型 */
-	std::string mime_type = file_manager->get_mime_type(file_path);
-	response.headers["Content-Type"] = mime_type;
-
-	/* 读取文件内容 */
-	std::vector<char> content;
-	bool success = file_manager->read_file_binary(file_path, content);
-
-	if (!success) {
+	/* 读取文件内容：以sendfile()直接发送，不读入内存 */
+	struct stat st;
+	if (stat(file_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+	    !set_file_body(response, file_path, st, false)) {
 		response.status_code = 404;
 		response.status_text = "Not Found";
 		response.body = "File not found or cannot be read";
 		return response;
 	}
 
-	response.body = std::string(content.begin(), content.end());
+	/* 获取文件MIME类型 */
+	response.headers["Content-Type"] = file_manager->get_mime_type(file_path);
+
+	/* 预览图片等重复请求时只需校验 */
+	check_not_modified(response, st, "", headers);
 	return response;
 }
 
 /**
  * WebServer::handle_save_file - 处理保存文件API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
  * @body: JSON请求体，包含path和content字段
  *
@@ -1125,10 +2128,10 @@ HttpResponse WebServer::handle_read_binary_file(
  * 返回: JSON响应，包含success字段
  */
 HttpResponse WebServer::handle_save_file(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -1159,13 +2162,13 @@ HttpResponse WebServer::handle_save_file(
 
 /* 处理创建文件夹API */
 HttpResponse WebServer::handle_create_folder(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
-	std::cout << "收到创建文件夹请求，body: " << body << std::endl;
+	log_debug("收到创建文件夹请求，body: {}", body);
 
 	HttpResponse response;
 	response.status_code = 200;
@@ -1177,8 +2180,7 @@ HttpResponse WebServer::handle_create_folder(
 		std::string parent_path = request["parentPath"];
 		std::string name = request["name"];
 
-		std::cout << "创建文件夹: parentPath=" << parent_path
-			  << ", name=" << name << std::endl;
+		log_debug("创建文件夹: parentPath={}, name={}", parent_path, name);
 
 		std::string folder_path = parent_path;
 		if (folder_path.back() != '/')
@@ -1187,15 +2189,15 @@ HttpResponse WebServer::handle_create_folder(
 
 		bool success = file_manager->create_directory(folder_path);
 
-		std::cout << "创建文件夹结果: "
-			  << (success ? "成功" : "失败") << std::endl;
+		if (!success)
+			log_warn("创建文件夹失败: {}", folder_path);
 
 		json result;
 		result["success"] = success;
 
 		response.body = result.dump();
 	} catch (const std::exception &e) {
-		std::cout << "创建文件夹异常: " << e.what() << std::endl;
+		log_warn("创建文件夹异常: {}", e.what());
 		json result;
 		result["success"] = false;
 		result["error"] = e.what();
@@ -1207,13 +2209,13 @@ HttpResponse WebServer::handle_create_folder(
 
 /* 处理创建文件API */
 HttpResponse WebServer::handle_create_file(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
-	std::cout << "收到创建文件请求，body: " << body << std::endl;
+	log_debug("收到创建文件请求，body: {}", body);
 
 	HttpResponse response;
 	response.status_code = 200;
@@ -1225,8 +2227,7 @@ HttpResponse WebServer::handle_create_file(
 		std::string parent_path = request["parentPath"];
 		std::string name = request["name"];
 
-		std::cout << "创建文件: parentPath=" << parent_path
-			  << ", name=" << name << std::endl;
+		log_debug("创建文件: parentPath={}, name={}", parent_path, name);
 
 		std::string file_path = parent_path;
 		if (file_path.back() != '/')
@@ -1235,15 +2236,15 @@ HttpResponse WebServer::handle_create_file(
 
 		bool success = file_manager->create_file(file_path);
 
-		std::cout << "创建文件结果: " << (success ? "成功" : "失败")
-			  << std::endl;
+		if (!success)
+			log_warn("创建文件失败: {}", file_path);
 
 		json result;
 		result["success"] = success;
 
 		response.body = result.dump();
 	} catch (const std::exception &e) {
-		std::cout << "创建文件异常: " << e.what() << std::endl;
+		log_warn("创建文件异常: {}", e.what());
 		json result;
 		result["success"] = false;
 		result["error"] = e.what();
@@ -1255,10 +2256,10 @@ HttpResponse WebServer::handle_create_file(
 
 /* 处理删除API */
 HttpResponse WebServer::handle_delete(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -1287,12 +2288,188 @@ HttpResponse WebServer::handle_delete(
 	return response;
 }
 
+/**
+ * WebServer::handle_file_operation - 开始后台文件操作
+ * @query: 查询参数（未使用）
+ * @headers: 请求头（未使用）
+ * @body: JSON请求体，包含type、paths和destination
+ *
+ * 任务在file_pool中执行，请求立即返回任务ID，进度通过目录变化推送
+ * 连接的 "event: operation" 推送。
+ *
+ * 返回: JSON响应，包含success和id
+ */
+HttpResponse WebServer::handle_file_operation(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	json result;
+	try {
+		json request = json::parse(body);
+		std::string type = request.value("type", std::string());
+		std::vector<std::string> paths =
+			request.value("paths", std::vector<std::string>());
+		std::string destination = request.value("destination",
+							std::string());
+
+		FileOperationKind kind;
+		if (type == "delete")
+			kind = FileOperationKind::DELETE;
+		else if (type == "copy")
+			kind = FileOperationKind::COPY;
+		else if (type == "move")
+			kind = FileOperationKind::MOVE;
+		else
+			throw std::invalid_argument("未知的操作类型: " + type);
+
+		std::lock_guard<std::mutex> lock(file_jobs_mutex);
+
+		/* 只保留最近结束的 FILE_OPERATION_KEEP_FINISHED 个任务 */
+		size_t finished = 0;
+		for (const auto &pair : file_jobs)
+			finished += pair.second->finished();
+		for (auto it = file_jobs.begin(); it != file_jobs.end() &&
+		     finished > FILE_OPERATION_KEEP_FINISHED;) {
+			if (it->second->finished()) {
+				it = file_jobs.erase(it);
+				finished--;
+			} else {
+				++it;
+			}
+		}
+
+		const uint64_t id = next_file_job_id;
+		auto job = std::make_shared<FileOperationJob>(
+			id, kind, std::move(paths), std::move(destination));
+		auto started = job->start(file_pool,
+			[this](const FileOperationProgress &progress) {
+				notify_file_operation(progress);
+			});
+
+		if (started.has_value()) {
+			file_jobs[id] = job;
+			next_file_job_id++;
+			result["success"] = true;
+			result["id"] = id;
+		} else {
+			result["success"] = false;
+			result["error"] = started.error();
+		}
+	} catch (const json::exception &e) {
+		result["success"] = false;
+		result["error"] = "Invalid JSON request";
+	} catch (const std::exception &e) {
+		result["success"] = false;
+		result["error"] = e.what();
+	}
+
+	response.body = result.dump();
+	return response;
+}
+
+/**
+ * WebServer::handle_file_operation_status - 查询后台文件操作的进度
+ * @query: 查询参数，包含id
+ * @headers: 请求头（未使用）
+ * @body: 请求体（未使用）
+ *
+ * 返回: JSON响应，包含success和operation（格式同推送的进度）
+ */
+HttpResponse WebServer::handle_file_operation_status(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)headers;
+	(void)body;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	const std::string_view id_str = query.get("id");
+	uint64_t id = 0;
+	std::from_chars(id_str.data(), id_str.data() + id_str.size(), id);
+
+	std::shared_ptr<FileOperationJob> job;
+	{
+		std::lock_guard<std::mutex> lock(file_jobs_mutex);
+		auto it = file_jobs.find(id);
+		if (it != file_jobs.end())
+			job = it->second;
+	}
+
+	json result;
+	result["success"] = (job != nullptr);
+	if (job)
+		result["operation"] = file_operation_json(job->progress());
+	else
+		result["error"] = "Operation not found";
+
+	response.body = result.dump();
+	return response;
+}
+
+/**
+ * WebServer::handle_cancel_file_operation - 取消后台文件操作
+ * @query: 查询参数（未使用）
+ * @headers: 请求头（未使用）
+ * @body: JSON请求体，包含id
+ *
+ * 返回: JSON响应，包含success
+ */
+HttpResponse WebServer::handle_cancel_file_operation(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	json result;
+	try {
+		json request = json::parse(body);
+		uint64_t id = request.value("id", (uint64_t)0);
+
+		std::shared_ptr<FileOperationJob> job;
+		{
+			std::lock_guard<std::mutex> lock(file_jobs_mutex);
+			auto it = file_jobs.find(id);
+			if (it != file_jobs.end())
+				job = it->second;
+		}
+
+		const bool running = job && !job->finished();
+		if (running)
+			job->cancel();
+		result["success"] = running;
+	} catch (const std::exception &e) {
+		result["success"] = false;
+		result["error"] = e.what();
+	}
+
+	response.body = result.dump();
+	return response;
+}
+
 /* 处理重命名API */
 HttpResponse WebServer::handle_rename(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -1324,7 +2501,7 @@ HttpResponse WebServer::handle_rename(
 
 /* 处理获取文件信息API */
 HttpResponse WebServer::handle_get_file_info(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
 	(void)headers;
@@ -1335,14 +2512,8 @@ HttpResponse WebServer::handle_get_file_info(
 	response.status_text = "OK";
 	response.headers["Content-Type"] = "application/json";
 
-	/* 解析查询参数 */
-	size_t query_pos = path.find('?');
-	std::string query_str = (query_pos != std::string::npos) ?
-				path.substr(query_pos + 1) :
-				"";
-	auto params = parse_query_string(query_str);
 
-	std::string file_path = params["path"];
+	std::string file_path(query.get("path"));
 	if (file_path.empty()) {
 		json result;
 		result["success"] = false;
@@ -1366,10 +2537,10 @@ HttpResponse WebServer::handle_get_file_info(
 
 /* 处理保存所有文件API */
 HttpResponse WebServer::handle_save_all(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -1378,50 +2549,343 @@ HttpResponse WebServer::handle_save_all(
 	response.status_text = "OK";
 	response.headers["Content-Type"] = "application/json";
 
-	try {
-		json request = json::parse(body);
-		json files = request["files"];
+	try {
+		json request = json::parse(body);
+		json files = request["files"];
+
+		bool all_success = true;
+
+		for (const auto &file : files) {
+			std::string file_path = file[0];
+			std::string content = file[1];
+
+			/*
+			 * 写入文件
+			 */
+			if (!file_manager->write_file(file_path, content)) {
+				log_error("文件写入失败: {}", file_path);
+				all_success = false;
+			} else {
+				log_info("文件保存成功: {} (size={} bytes)",
+					 file_path, content.length());
+			}
+		}
+
+		json result;
+		result["success"] = all_success;
+
+		response.body = result.dump();
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
+/**
+ * HttpUpload::enqueue - 追加一段请求体
+ * @data: 数据
+ * @length: 字节数
+ *
+ * 小块数据合并到队尾，除了正在写入的一块，队列中的数据块都不小于
+ * HTTP_UPLOAD_CHUNK_SIZE（最后一块除外）。
+ *
+ * 返回: 需要提交写入任务返回true
+ */
+bool HttpUpload::enqueue(const char *data, size_t length)
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+
+	if (error != 0 || length == 0)
+		return false;
+
+	if (!chunks.empty() && chunks.back().size() + length <= HTTP_UPLOAD_CHUNK_SIZE)
+		chunks.back().append(data, length);
+	else
+		chunks.emplace_back(data, length);
+	queued += length;
+
+	if (writing)
+		return false;
+	writing = true;
+	return true;
+}
+
+/**
+ * HttpUpload::pause_if_full - 队列超过上限时标记暂停
+ */
+bool HttpUpload::pause_if_full(void)
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+
+	if (queued < HTTP_UPLOAD_QUEUE_LIMIT || error != 0)
+		return false;
+	paused = true;
+	return true;
+}
+
+/**
+ * HttpUpload::drain - 写出队列中的数据
+ * @resume: 暂停读取后队列降到上限一半以下时调用一次
+ *
+ * 在写入线程中执行，队列为空时结束。同一时刻只有一个写入任务，
+ * 数据按接收顺序写入。
+ */
+void HttpUpload::drain(const std::function<void(void)> &resume)
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	while (!chunks.empty()) {
+		std::string chunk = std::move(chunks.front());
+		chunks.pop_front();
+
+		const bool failed = error != 0;
+		lock.unlock();
+
+		int err = 0;
+		size_t written = 0;
+		while (!failed && written < chunk.size()) {
+			ssize_t ret = ::write(fd, chunk.data() + written,
+					      chunk.size() - written);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				break;
+			}
+			written += ret;
+		}
+
+		lock.lock();
+		queued -= chunk.size();
+		size += written;
+		if (err != 0 && error == 0)
+			error = err;
+
+		if (paused && (queued <= HTTP_UPLOAD_QUEUE_LIMIT / 2 || error != 0)) {
+			paused = false;
+			lock.unlock();
+			resume();
+			lock.lock();
+		}
+	}
+
+	writing = false;
+	queue_drained.notify_all();
+}
+
+/**
+ * HttpUpload::abort - 写入任务无法提交
+ * @err: 错误码
+ */
+void HttpUpload::abort(int err)
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+
+	if (error == 0)
+		error = err;
+	chunks.clear();
+	queued = 0;
+	writing = false;
+	queue_drained.notify_all();
+}
+
+/**
+ * HttpUpload::wait_drained - 等待写入任务结束
+ */
+void HttpUpload::wait_drained(void)
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	queue_drained.wait(lock, [this]() { return !writing; });
+}
+
+/**
+ * WebServer::queue_upload_data - 把一段上传数据交给写入线程
+ * @fd: 连接
+ * @upload: 上传状态
+ * @data: 数据
+ * @length: 字节数
+ */
+void WebServer::queue_upload_data(int fd,
+				  const std::shared_ptr<HttpUpload> &upload,
+				  const char *data, size_t length)
+{
+	if (!upload->enqueue(data, length))
+		return;
+
+	bool submitted = upload_pool.submit([this, fd, upload]() {
+		upload->drain([&]() { notify_upload_resume(fd, upload.get()); });
+	});
+	if (!submitted)
+		upload->abort(ECANCELED);
+}
+
+/**
+ * WebServer::notify_upload_resume - 通知事件循环恢复读取上传连接
+ * @fd: 连接
+ * @upload: 上传状态（只用于确认连接未被替换）
+ */
+void WebServer::notify_upload_resume(int fd, const HttpUpload *upload)
+{
+	std::lock_guard<std::mutex> lock(ready_streams_mutex);
+
+	if (!streams_enabled)
+		return;
+
+	bool idle = ready_uploads.empty();
+	ready_uploads.emplace_back(fd, upload);
+
+	if (idle) {
+		uint64_t one = 1;
+		ssize_t ret = write(wake_fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+/**
+ * WebServer::resume_uploads - 恢复读取所有收到通知的上传连接
+ *
+ * 连接已关闭或已被新连接复用时忽略。
+ */
+void WebServer::resume_uploads(void)
+{
+	std::vector<std::pair<int, const HttpUpload *>> ready;
+	{
+		std::lock_guard<std::mutex> lock(ready_streams_mutex);
+		ready.swap(ready_uploads);
+	}
+
+	for (const auto &[fd, upload] : ready) {
+		auto it = connections.find(fd);
+		HttpConnection *conn = it != connections.end() ?
+				       it->second.get() : nullptr;
+		if (!conn || conn->upload.get() != upload || !conn->upload_paused)
+			continue;
+
+		conn->upload_paused = false;
+		conn->last_active = std::chrono::steady_clock::now();
+		update_connection_events(fd, EPOLLIN | EPOLLRDHUP);
+	}
+}
+
+/**
+ * WebServer::begin_upload - 为流式上传创建临时文件
+ * @path: 请求目标，path参数为目标文件
+ *
+ * 临时文件建在目标文件所在的目录，保证rename()不跨文件系统。
+ * 目标是符号链接时替换链接指向的文件，链接本身保持不变。
+ *
+ * 返回: 上传状态，出错时error已设置，请求体会被丢弃
+ */
+std::shared_ptr<HttpUpload> WebServer::begin_upload(const HttpQuery &query)
+{
+	auto upload = std::make_shared<HttpUpload>();
+
+	std::string target(query.get("path"));
+
+	if (target.empty() || target[0] != '/' || target.back() == '/') {
+		upload->error = EINVAL;
+		return upload;
+	}
+
+	char resolved[PATH_MAX];
+	if (realpath(target.c_str(), resolved))
+		target = resolved;
+
+	struct stat st;
+	if (stat(target.c_str(), &st) == 0 && !S_ISREG(st.st_mode)) {
+		upload->error = EISDIR;
+		return upload;
+	}
+
+	const size_t slash = target.rfind('/');
+	std::string temp = target.substr(0, slash + 1) + "." +
+			   target.substr(slash + 1) + ".mikufy-XXXXXX";
+
+	upload->fd = mkostemp(temp.data(), O_CLOEXEC);
+	if (upload->fd < 0) {
+		upload->error = errno;
+		return upload;
+	}
+
+	upload->target_path = std::move(target);
+	upload->temp_path = std::move(temp);
+
+	log_info("开始接收上传: {}", upload->target_path);
+
+	return upload;
+}
+
+/**
+ * WebServer::finish_upload - 提交接收完毕的上传
+ * @upload: 上传状态
+ *
+ * mkostemp()创建的文件权限是0600：已有文件沿用原来的权限，
+ * 新文件使用0644。fsync()之后再重命名，掉电时目标文件要么是旧
+ * 内容，要么是完整的新内容。
+ *
+ * 返回: JSON响应，包含success字段
+ */
+HttpResponse WebServer::finish_upload(HttpUpload &upload)
+{
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	/* 写入线程写完之后size和error才是最终结果 */
+	upload.wait_drained();
 
-		bool all_success = true;
+	if (upload.error == 0) {
+		struct stat st;
+		const mode_t mode = (stat(upload.target_path.c_str(), &st) == 0) ?
+				    (st.st_mode & 07777) : 0644;
 
-		for (const auto &file : files) {
-			std::string file_path = file[0];
-			std::string content = file[1];
+		if (fchmod(upload.fd, mode) != 0 || fsync(upload.fd) != 0)
+			upload.error = errno;
+	}
 
-			/*
-			 * 写入文件
-			 */
-			if (!file_manager->write_file(file_path, content)) {
-				std::cerr << "文件写入失败: " << file_path
-					  << std::endl;
-				all_success = false;
-			} else {
-				std::cout << "文件保存成功: " << file_path
-					  << " (size=" << content.length()
-					  << " bytes)" << std::endl;
-			}
-		}
+	if (upload.error == 0) {
+		const int fd = upload.fd;
+		upload.fd = -1;
 
-		json result;
-		result["success"] = all_success;
+		if (close(fd) != 0 ||
+		    rename(upload.temp_path.c_str(),
+			   upload.target_path.c_str()) != 0)
+			upload.error = errno;
+		else
+			upload.committed = true;
+	}
 
-		response.body = result.dump();
-	} catch (const std::exception &e) {
-		json result;
-		result["success"] = false;
-		result["error"] = e.what();
-		response.body = result.dump();
+	json result;
+	result["success"] = upload.committed;
+
+	if (upload.committed) {
+		file_manager->invalidate_path(upload.target_path);
+		result["size"] = upload.size;
+		log_info("文件保存成功: {} (size={} bytes)", upload.target_path,
+			 upload.size);
+	} else {
+		result["error"] = strerror(upload.error);
+		log_error("文件上传失败: {}: {}",
+			  upload.target_path.empty() ? "(无效路径)" :
+			  upload.target_path,
+			  strerror(upload.error));
 	}
 
+	response.body = result.dump();
 	return response;
 }
 
 /* 处理刷新API */
 HttpResponse WebServer::handle_refresh(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -1440,19 +2904,21 @@ HttpResponse WebServer::handle_refresh(
 
 /**
  * WebServer::handle_refresh_directory - 处理增量刷新目录API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
- * @body: JSON请求体，包含directory字段
+ * @body: JSON请求体，包含directory字段，可选limit和cursor（同
+ *        get-directory-contents）
  *
  * 只刷新指定目录的内容，用于智能刷新功能。
  *
- * 返回: JSON响应，包含success、directory、files字段
+ * 返回: JSON响应，包含success、directory、files、total、next_cursor
+ *       和has_more字段
  */
 HttpResponse WebServer::handle_refresh_directory(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -1472,17 +2938,27 @@ HttpResponse WebServer::handle_refresh_directory(
 			return response;
 		}
 
+		size_t limit = request.value("limit", (size_t)MAX_DIR_ENTRIES);
+		std::string cursor = request.value("cursor", std::string());
+
 		/* 只刷新指定目录 */
-		std::vector<FileInfo> files;
-		bool success = file_manager->get_directory_contents(directory, files);
+		DirectoryPage page;
+		bool success = file_manager->list_directory(directory, cursor,
+							    limit, page);
 
 		json result;
 		result["success"] = success;
 		result["directory"] = directory;
+		result["total"] = page.total;
+		result["has_more"] = !page.next_cursor.empty();
+		if (page.next_cursor.empty())
+			result["next_cursor"] = nullptr;
+		else
+			result["next_cursor"] = page.next_cursor;
 
 		/* 转换文件信息为JSON数组 */
 		json files_array = json::array();
-		for (const auto &file : files) {
+		for (const auto &file : page.files) {
 			json file_obj;
 			file_obj["name"] = file.name;
 			file_obj["path"] = file.path;
@@ -1510,12 +2986,59 @@ HttpResponse WebServer::handle_refresh_directory(
 	return response;
 }
 
+/**
+ * WebServer::handle_watch_directories - 处理设置监视目录API
+ * @query: 查询参数（未使用）
+ * @headers: 请求头（未使用）
+ * @body: JSON请求体，包含directories数组
+ *
+ * 前端每次切换显示的目录后调用，只监视当前可见的目录。
+ *
+ * 返回: JSON响应，包含success、directories字段
+ */
+HttpResponse WebServer::handle_watch_directories(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	try {
+		json request = json::parse(body);
+		std::vector<std::string> directories =
+			request.value("directories", std::vector<std::string>());
+
+		json result;
+		if (!file_watcher->is_running()) {
+			result["success"] = false;
+			result["error"] = "File watcher is not available";
+		} else {
+			result["success"] = true;
+			result["directories"] =
+				file_watcher->watch_directories(directories);
+		}
+		response.body = result.dump();
+	} catch (const json::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = "Invalid JSON request";
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
 /* 处理更换壁纸API */
 HttpResponse WebServer::handle_change_wallpaper(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -1589,8 +3112,9 @@ HttpResponse WebServer::handle_change_wallpaper(
 		// 替换背景图片文件名
 		cssContent.replace(pos, endPos - pos + 2, newPattern + "')");
 
-		// 写回style.css文件
+		// 写回style.css文件，此后由web目录提供
 		success = file_manager->write_file(cssPath, cssContent);
+		web_assets.invalidate("/style.css");
 
 		if (!success) {
 			json result;
@@ -1617,7 +3141,7 @@ HttpResponse WebServer::handle_change_wallpaper(
 
 /**
  * WebServer::handle_get_wallpapers - 处理获取壁纸列表API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
  * @body: 请求体（未使用）
  *
@@ -1632,10 +3156,10 @@ HttpResponse WebServer::handle_change_wallpaper(
  * 返回: JSON响应，包含success和wallpapers数组
  */
 HttpResponse WebServer::handle_get_wallpapers(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 	(void)body;
 
@@ -1776,31 +3300,221 @@ HttpResponse WebServer::handle_get_wallpapers(
 	return response;
 }
 
+/**
+ * accepts_encoding - 检查Accept-Encoding是否接受指定编码
+ * @accept: Accept-Encoding的值
+ * @encoding: 编码名称（如"br"）
+ *
+ * 按逗号分隔逐项比较，带q=0的项视为不接受。
+ */
+static bool accepts_encoding(std::string_view accept, std::string_view encoding)
+{
+	while (!accept.empty()) {
+		size_t comma = accept.find(',');
+		std::string_view item = accept.substr(0, comma);
+		accept = (comma == std::string_view::npos) ?
+			 std::string_view() : accept.substr(comma + 1);
+
+		while (!item.empty() && (item.front() == ' ' || item.front() == '\t'))
+			item.remove_prefix(1);
+
+		size_t semicolon = item.find(';');
+		std::string_view name = item.substr(0, semicolon);
+		while (!name.empty() && (name.back() == ' ' || name.back() == '\t'))
+			name.remove_suffix(1);
+
+		if (name.size() != encoding.size() ||
+		    strncasecmp(name.data(), encoding.data(), name.size()) != 0)
+			continue;
+
+		if (semicolon != std::string_view::npos) {
+			std::string_view params = item.substr(semicolon + 1);
+			size_t q = params.find("q=");
+			if (q != std::string_view::npos &&
+			    params.substr(q + 2).find_first_not_of("0.") ==
+			    std::string_view::npos)
+				return false;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * format_http_date - 把时间格式化为HTTP日期（RFC 7231 IMF-fixdate）
+ * @t: 时间
+ *
+ * 不使用strftime()：GTK会设置本地化的LC_TIME，星期和月份名称
+ * 必须是英文。
+ */
+static std::string format_http_date(time_t t)
+{
+	static const char *const days[] = {
+		"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+	};
+	static const char *const months[] = {
+		"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+	};
+
+	struct tm tm;
+	gmtime_r(&t, &tm);
+
+	return std::format("{}, {:02} {} {} {:02}:{:02}:{:02} GMT",
+			   days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon],
+			   tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+/**
+ * timespec_before - a是否早于b（精确到纳秒）
+ *
+ * 源文件和压缩版本可能在同一秒内写入，只比较秒会把编辑前生成的
+ * 压缩版本当成最新的。
+ */
+static bool timespec_before(const struct timespec &a, const struct timespec &b)
+{
+	if (a.tv_sec != b.tv_sec)
+		return a.tv_sec < b.tv_sec;
+	return a.tv_nsec < b.tv_nsec;
+}
+
+/**
+ * WebServer::check_not_modified - 设置缓存校验头并处理条件请求
+ * @response: 要填充的响应
+ * @st: 文件的stat结果
+ * @etag_suffix: 区分同一文件不同编码版本的ETag后缀
+ * @headers: 请求头
+ *
+ * ETag由inode、大小和纳秒级修改时间组成，编辑后必然变化。
+ * Cache-Control: no-cache让WebView每次都校验，不会用到旧的脚本。
+ *
+ * 返回: 响应被改为304时返回true
+ */
+bool WebServer::check_not_modified(HttpResponse &response, const struct stat &st,
+				   std::string_view etag_suffix,
+				   const HttpHeaders &headers)
+{
+	const uint64_t mtime_ns =
+		static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL +
+		static_cast<uint64_t>(st.st_mtim.tv_nsec);
+	const std::string etag = std::format("\"{:x}-{:x}-{:x}{}\"",
+					     static_cast<uint64_t>(st.st_ino),
+					     static_cast<uint64_t>(st.st_size),
+					     mtime_ns, etag_suffix);
+	const std::string last_modified = format_http_date(st.st_mtim.tv_sec);
+
+	response.headers["ETag"] = etag;
+	response.headers["Last-Modified"] = last_modified;
+	response.headers["Cache-Control"] = "no-cache";
+
+	bool not_modified;
+	if (const std::string_view *inm = headers.find("If-None-Match"))
+		not_modified = (*inm == "*" ||
+				inm->find(etag) != std::string::npos);
+	else if (const std::string_view *ims = headers.find("If-Modified-Since"))
+		not_modified = (*ims == last_modified);
+	else
+		not_modified = false;
+
+	if (!not_modified)
+		return false;
+
+	response.status_code = 304;
+	response.status_text = "Not Modified";
+	response.body.clear();
+	response.shared_body.reset();
+	response.file_body.reset();
+	return true;
+}
+
+/**
+ * WebServer::set_file_body - 把文件设为响应体
+ * @response: 要填充的响应
+ * @file_path: 文件路径
+ * @st: 文件的stat结果
+ * @cacheable: 是否允许放入static_cache
+ *
+ * 返回: 成功返回true，文件无法打开返回false
+ */
+bool WebServer::set_file_body(HttpResponse &response, const std::string &file_path,
+			      const struct stat &st, bool cacheable)
+{
+	if (cacheable && static_cast<size_t>(st.st_size) <= STATIC_CACHE_MAX_FILE) {
+		FileContent content = static_cache.get(file_path, st);
+		if (!content) {
+			struct stat read_st;
+			content = read_static_file(file_path, read_st);
+			if (!content)
+				return false;
+			static_cache.put(file_path, read_st, content);
+		}
+		response.shared_body = std::move(content);
+		return true;
+	}
+
+	int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0)
+		return false;
+
+	struct stat fd_st;
+	if (fstat(fd, &fd_st) != 0 || !S_ISREG(fd_st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	response.file_body = std::make_shared<HttpFileBody>(fd, fd_st.st_size);
+	return true;
+}
+
 /**
  * WebServer::handle_static_file - 处理静态文件请求
  * @path: 请求路径
+ * @headers: 请求头
  *
  * 处理静态文件请求，从web目录提供HTML、CSS、JS、图片等静态资源。
  * 根路径"/"会自动重定向到index.html。
  *
+ * 内置的首屏资源（见WebAssetBundle）不访问文件系统，直接发送内存中
+ * 的内容；ETag按内容计算。
+ *
+ * 客户端接受br或gzip且存在不比原文件旧的预压缩文件时发送压缩
+ * 版本；原文件被修改（如更换壁纸改写style.css）后旧的压缩文件
+ * 自动不再使用。
+ *
  * 返回: HTTP响应
  */
-HttpResponse WebServer::handle_static_file(const std::string &path)
+HttpResponse WebServer::handle_static_file(std::string_view path,
+					      const HttpHeaders &headers)
 {
 	HttpResponse response;
 
-	/* 解析路径 */
-	std::string file_path = path;
-
-	/* 移除查询字符串 */
-	size_t query_pos = file_path.find('?');
-	if (query_pos != std::string::npos)
-		file_path = file_path.substr(0, query_pos);
+	/* 解析路径（移除查询字符串） */
+	std::string file_path(path.substr(0, path.find('?')));
 
 	/* 处理根路径 */
 	if (file_path == "/" || file_path == "")
 		file_path = "/index.html";
 
+	/* 首屏资源直接从内存发送 */
+	if (const WebAsset *asset = web_assets.find(file_path)) {
+		response.status_code = 200;
+		response.status_text = "OK";
+		response.headers["Content-Type"] = std::string(asset->mime_type);
+		response.headers["ETag"] = asset->etag;
+		response.headers["Cache-Control"] = "no-cache";
+
+		const std::string_view *inm = headers.find("If-None-Match");
+		if (inm && (*inm == "*" || inm->find(asset->etag) != std::string::npos)) {
+			response.status_code = 304;
+			response.status_text = "Not Modified";
+			return response;
+		}
+
+		response.shared_body = asset->content;
+		return response;
+	}
+
 	/* 构建完整的文件路径 */
 	std::string full_path;
 	if (!web_root_path.empty()) {
@@ -1809,16 +3523,12 @@ HttpResponse WebServer::handle_static_file(const std::string &path)
 		full_path = "web" + file_path;
 	}
 
-	std::cout << "静态文件请求: " << path << " -> " << full_path
-		  << " (web_root_path: " << (web_root_path.empty() ? "empty" : web_root_path) << ")"
-		  << std::endl;
-
-	/* 读取文件 */
-	std::string content = read_static_file(full_path);
+	log_debug("静态文件请求: {} -> {}", path, full_path);
 
-	if (content.empty()) {
+	struct stat st;
+	if (stat(full_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
 		/* 文件不存在，返回404错误 */
-		std::cout << "文件不存在: " << full_path << std::endl;
+		log_debug("文件不存在: {}", full_path);
 		response.status_code = 404;
 		response.status_text = "Not Found";
 		response.headers["Content-Type"] = "text/plain";
@@ -1826,13 +3536,57 @@ HttpResponse WebServer::handle_static_file(const std::string &path)
 		return response;
 	}
 
-	std::cout << "文件读取成功: " << full_path << " (大小: "
-		  << content.size() << " bytes)" << std::endl;
-
 	response.status_code = 200;
 	response.status_text = "OK";
 	response.headers["Content-Type"] = get_http_mime_type(full_path);
-	response.body = content;
+
+	/* 选择预压缩版本 */
+	static const struct {
+		const char *encoding;
+		const char *extension;
+		const char *etag_suffix;
+	} variants[] = {
+		{ "br", ".br", "-br" },
+		{ "gzip", ".gz", "-gz" },
+	};
+
+	const std::string_view *accept = headers.find("Accept-Encoding");
+	std::string send_path = full_path;
+	struct stat send_st = st;
+	const char *etag_suffix = "";
+
+	for (const auto &variant : variants) {
+		const std::string variant_path = full_path + variant.extension;
+		struct stat variant_st;
+		if (stat(variant_path.c_str(), &variant_st) != 0 ||
+		    !S_ISREG(variant_st.st_mode) ||
+		    timespec_before(variant_st.st_mtim, st.st_mtim))
+			continue;
+
+		/* 存在压缩版本时响应随Accept-Encoding变化 */
+		response.headers["Vary"] = "Accept-Encoding";
+
+		if (!accept || !accepts_encoding(*accept, variant.encoding) ||
+		    send_path != full_path)
+			continue;
+
+		send_path = variant_path;
+		send_st = variant_st;
+		etag_suffix = variant.etag_suffix;
+		response.headers["Content-Encoding"] = variant.encoding;
+	}
+
+	/* ETag按原文件计算，压缩版本只加后缀 */
+	if (check_not_modified(response, st, etag_suffix, headers))
+		return response;
+
+	if (!set_file_body(response, send_path, send_st, true)) {
+		response = HttpResponse();
+		response.status_code = 404;
+		response.status_text = "Not Found";
+		response.headers["Content-Type"] = "text/plain";
+		response.body = "404 Not Found: " + full_path;
+	}
 
 	return response;
 }
@@ -1840,24 +3594,41 @@ HttpResponse WebServer::handle_static_file(const std::string &path)
 /**
  * WebServer::read_static_file - 读取静态文件内容
  * @file_path: 文件路径
+ * @st: 输出参数，打开后fstat的结果
  *
- * 以二进制模式读取静态文件内容。
+ * 按fstat得到的大小一次分配，直接read()进字符串。
  *
- * 返回: 文件内容，失败返回空字符串
+ * 返回: 文件内容，失败返回nullptr
  */
-std::string WebServer::read_static_file(const std::string &file_path)
+FileContent WebServer::read_static_file(const std::string &file_path,
+					struct stat &st)
 {
-	std::ifstream file(file_path, std::ios::binary);
+	int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+	if (fd < 0)
+		return nullptr; /* 文件打开失败 */
 
-	if (!file.is_open())
-		return ""; /* 文件打开失败 */
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return nullptr;
+	}
 
-	std::stringstream buffer;
-	buffer << file.rdbuf();
+	auto content = std::make_shared<std::string>(st.st_size, '\0');
+	size_t total = 0;
+	while (total < content->size()) {
+		ssize_t ret = read(fd, content->data() + total,
+				   content->size() - total);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		total += ret;
+	}
+	close(fd);
 
-	file.close();
+	if (total != content->size())
+		return nullptr; /* 读取期间文件被截短 */
 
-	return buffer.str();
+	return content;
 }
 
 /**
@@ -1973,6 +3744,168 @@ std::string WebServer::get_http_mime_type(const std::string &file_path)
  * ============================================================================
  */
 
+/**
+ * WebServer::append_json_string - 追加 JSON 字符串内容
+ * @out: 输出缓冲区
+ * @text: 原始文本
+ *
+ * 只转义引号、反斜杠和控制字符，其余字节原样追加（不包含两侧引号）。
+ * 不需要转义的连续字节整段追加。
+ */
+void WebServer::append_json_string(std::string &out, std::string_view text)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	size_t run_start = 0;
+
+	for (size_t i = 0; i < text.size(); i++) {
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		out.append(text.data() + run_start, i - run_start);
+		run_start = i + 1;
+
+		switch (c) {
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		case '\b':
+			out += "\\b";
+			break;
+		case '\f':
+			out += "\\f";
+			break;
+		default:
+			out += "\\u00";
+			out += hex_digits[c >> 4];
+			out += hex_digits[c & 0x0f];
+			break;
+		}
+	}
+
+	out.append(text.data() + run_start, text.size() - run_start);
+}
+
+/**
+ * language_name - 返回给前端的语言名称
+ *
+ * 没有对应词法规则的文件统一为 plaintext，前端据此决定是否请求
+ * 词法单元。
+ */
+static std::string language_name(const SyntaxLanguage *language)
+{
+	return language ? language->name() : "plaintext";
+}
+
+/**
+ * WebServer::encode_lines_frame - 把行范围编码为二进制行帧
+ * @buffer: 文本缓冲区
+ * @start_line: 起始行号（包含）
+ * @end_line: 结束行号（不包含）
+ * @with_tokens: 在偏移表之后追加词法单元区
+ * @out: 输出缓冲区
+ *
+ * 先写入占位的帧头，再顺序追加各行文本，最后追加偏移表（和词法单元
+ * 区）并回填帧头，行数不需要预先知道。
+ */
+bool WebServer::encode_lines_frame(TextBuffer &buffer, size_t start_line,
+				   size_t end_line, bool with_tokens,
+				   std::string &out)
+{
+	std::vector<uint32_t> offsets;
+	offsets.reserve(end_line > start_line ? end_line - start_line + 1 : 1);
+	offsets.push_back(0);
+
+	out.assign(LINES_FRAME_HEADER_SIZE, '\0');
+	out.reserve(LINES_FRAME_HEADER_SIZE + offsets.capacity() * 68);
+
+	std::vector<uint32_t> token_index;
+	std::vector<uint32_t> token_words;
+	bool ok;
+
+	if (with_tokens) {
+		token_index.reserve(offsets.capacity());
+		token_index.push_back(0);
+
+		std::vector<SyntaxToken> columns;
+		ok = buffer.visit_tokens(start_line, end_line,
+			[&](size_t line, std::string_view text,
+			    std::span<const SyntaxToken> tokens) {
+				(void)line;
+				out.append(text);
+				offsets.push_back(static_cast<uint32_t>(
+					out.size() - LINES_FRAME_HEADER_SIZE));
+
+				syntax_tokens_to_utf16(text, tokens, columns);
+				for (const SyntaxToken &token : columns) {
+					token_words.push_back(token.start);
+					token_words.push_back(
+						(token.length << LINES_FRAME_TOKEN_KIND_BITS) |
+						static_cast<uint32_t>(token.kind));
+				}
+				token_index.push_back(static_cast<uint32_t>(
+					token_words.size() / 2));
+			});
+	} else {
+		ok = buffer.visit_lines(start_line, end_line,
+			[&out, &offsets](size_t line,
+					 std::span<const std::string_view> fragments) {
+				(void)line;
+				for (std::string_view fragment : fragments)
+					out.append(fragment);
+				offsets.push_back(static_cast<uint32_t>(
+					out.size() - LINES_FRAME_HEADER_SIZE));
+			});
+	}
+	if (!ok)
+		return false;
+
+	const uint32_t text_length = offsets.back();
+	out.append((4 - out.size() % 4) % 4, '\0');
+
+	const auto put_u32 = [&out](size_t pos, uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			out[pos + i] = static_cast<char>((value >> (i * 8)) & 0xff);
+	};
+
+	size_t table_pos = out.size();
+	out.resize(table_pos + offsets.size() * 4);
+	for (size_t i = 0; i < offsets.size(); i++)
+		put_u32(table_pos + i * 4, offsets[i]);
+
+	if (with_tokens) {
+		table_pos = out.size();
+		out.resize(table_pos + (token_index.size() + token_words.size()) * 4);
+		for (uint32_t index : token_index) {
+			put_u32(table_pos, index);
+			table_pos += 4;
+		}
+		for (uint32_t word : token_words) {
+			put_u32(table_pos, word);
+			table_pos += 4;
+		}
+	}
+
+	put_u32(0, LINES_FRAME_MAGIC);
+	put_u32(4, static_cast<uint32_t>(start_line));
+	put_u32(8, static_cast<uint32_t>(offsets.size() - 1));
+	put_u32(12, text_length);
+
+	return true;
+}
+
 /**
  * WebServer::escape_html - 转义 HTML 特殊字符
  *
@@ -2079,6 +4012,13 @@ std::string WebServer::detect_language_simple(const std::string &filename)
 		{ ".mk", "make" }
 	};
 
+	/* 没有扩展名的 Makefile 等按完整文件名匹配 */
+	const size_t slash_pos = filename.find_last_of('/');
+	const auto by_name = ext_to_lang.find(filename.substr(
+		slash_pos == std::string::npos ? 0 : slash_pos + 1));
+	if (by_name != ext_to_lang.end())
+		return by_name->second;
+
 	/* 查找文件扩展名 */
 	const size_t dot_pos = filename.find_last_of('.');
 	if (dot_pos != std::string::npos) {
@@ -2099,7 +4039,7 @@ std::string WebServer::detect_language_simple(const std::string &filename)
 
 /**
  * WebServer::handle_terminal_info - 处理获取终端信息API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
  * @body: JSON请求体，包含path字段
  *
@@ -2108,10 +4048,10 @@ std::string WebServer::detect_language_simple(const std::string &filename)
  * 返回: JSON响应，包含success、user、hostname、path、isRoot字段
  */
 HttpResponse WebServer::handle_terminal_info(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2162,7 +4102,7 @@ HttpResponse WebServer::handle_terminal_info(
 
 /**
  * WebServer::handle_terminal_execute - 处理执行终端命令API
- * @path: 请求路径（未使用）
+ * @query: 查询参数（未使用）
  * @headers: 请求头（未使用）
  * @body: JSON请求体，包含command和path字段
  *
@@ -2172,10 +4112,10 @@ HttpResponse WebServer::handle_terminal_info(
  * 返回: JSON响应，包含success、output、error、newPath、isRoot、pid字段
  */
 HttpResponse WebServer::handle_terminal_execute(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2357,10 +4297,10 @@ HttpResponse WebServer::handle_terminal_execute(
  * 使用 TextBuffer (Piece Table) 架构打开文件，支持大文件的高效编辑。
  */
 HttpResponse WebServer::handle_open_file_virtual(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2381,34 +4321,28 @@ HttpResponse WebServer::handle_open_file_virtual(
 		}
 
 		/*
-		 * 检查是否已经打开
+		 * 检查是否已经打开（再次打开即切换到该标签）
 		 */
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it != text_buffers.end()) {
-				/*
-							 * 文件已打开，直接返回信息
-							 */
-							json result;
-							result["success"] = true;
-							result["totalLines"] = it->second->get_line_count();
-							result["totalChars"] = it->second->get_char_count();
-							result["language"] = "plaintext";
-							response.body = result.dump();
-							return response;
-						}		}
+		if (auto opened = text_buffers.acquire(file_path)) {
+			json result;
+			result["success"] = true;
+			result["totalLines"] = opened->get_line_count();
+			result["totalChars"] = opened->get_char_count();
+			result["indexing"] = opened->is_indexing();
+			result["language"] = language_name(opened->get_language());
+			response.body = result.dump();
+			return response;
+		}
 
 		/*
 		 * 创建新的 TextBuffer
 		 */
-		TextBuffer *buffer = new TextBuffer();
+		auto buffer = std::make_shared<TextBuffer>();
 
 		/*
 		 * 加载文件
 		 */
 		if (!buffer->load_file(file_path)) {
-			delete buffer;
 			json result;
 			result["success"] = false;
 			result["error"] = "Failed to load file";
@@ -2416,24 +4350,25 @@ HttpResponse WebServer::handle_open_file_virtual(
 			return response;
 		}
 
+		buffer->set_language(
+			SyntaxLanguage::find(detect_language_simple(file_path)));
+
 		/*
-		 * 保存到 map
+		 * 注册（并发打开同一文件时保留先插入的那个）
 		 */
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			text_buffers[file_path] = buffer;
-		}
+		buffer = text_buffers.insert(file_path, buffer);
 
 		json result;
 		result["success"] = true;
 		result["totalLines"] = buffer->get_line_count();
 		result["totalChars"] = buffer->get_char_count();
-		result["language"] = "plaintext";
+		result["indexing"] = buffer->is_indexing();
+		result["language"] = language_name(buffer->get_language());
 
 		response.body = result.dump();
 
-		std::cout << "虚拟打开文件成功: " << file_path << ", 行数: "
-			  << buffer->get_line_count() << std::endl;
+		log_debug("虚拟打开文件成功: {}, 行数: {}", file_path,
+			  buffer->get_line_count());
 
 	} catch (const std::exception &e) {
 		json result;
@@ -2451,11 +4386,10 @@ HttpResponse WebServer::handle_open_file_virtual(
  * 从 TextBuffer 中获取指定行范围的文本内容，用于虚拟滚动渲染。
  */
 HttpResponse WebServer::handle_get_lines(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
-	(void)headers;
+	(void)query;
 
 	HttpResponse response;
 	response.status_code = 200;
@@ -2463,10 +4397,24 @@ HttpResponse WebServer::handle_get_lines(
 	response.headers["Content-Type"] = "application/json";
 
 	try {
-		json request = json::parse(body);
-		std::string file_path = request["path"];
-		size_t start_line = request["start_line"];
-		size_t end_line = request["end_line"];
+		/* 只取需要的字段，不建立json文档 */
+		std::string file_path;
+		size_t start_line = 0;
+		size_t end_line = 0;
+		bool want_tokens = false;
+
+		JsonFields fields;
+		fields.bind("path", file_path);
+		fields.bind("start_line", start_line);
+		fields.bind("end_line", end_line);
+		fields.bind("tokens", want_tokens, false);
+		if (!fields.parse(body)) {
+			json result;
+			result["success"] = false;
+			result["error"] = fields.error();
+			response.body = result.dump();
+			return response;
+		}
 
 		if (file_path.empty()) {
 			json result;
@@ -2479,47 +4427,131 @@ HttpResponse WebServer::handle_get_lines(
 		/*
 		 * 获取 TextBuffer
 		 */
-		TextBuffer *buffer = nullptr;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it == text_buffers.end()) {
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.acquire(file_path);
+		if (!buffer) {
+			json result;
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
+		}
+
+		/* 预读窗口前后的内容，滚动时不等待缺页 */
+		buffer->advise_window(start_line, end_line);
+
+		const SyntaxLanguage *language = buffer->get_language();
+		want_tokens = want_tokens && language;
+
+		/*
+		 * 客户端声明接受二进制行帧时，跳过 JSON 编码
+		 */
+		const std::string_view *accept = headers.find("Accept");
+		const bool want_frame = accept &&
+					accept->find(LINES_FRAME_MIME) !=
+					std::string_view::npos;
+
+		if (want_frame) {
+			std::string frame;
+			if (!encode_lines_frame(*buffer, start_line, end_line,
+						want_tokens, frame)) {
 				json result;
 				result["success"] = false;
-				result["error"] = "File not opened";
+				result["error"] = "Failed to get lines";
 				response.body = result.dump();
 				return response;
 			}
-			buffer = it->second;
+
+			response.headers["Content-Type"] = LINES_FRAME_MIME;
+			response.body = std::move(frame);
+			return response;
 		}
 
 		/*
-		 * 获取行内容
+		 * 直接从 TextBuffer 的行视图序列化响应体，窗口内的每一行
+		 * 只被复制一次（转义后写入 body），不构造中间字符串和 json 数组
 		 */
-		std::vector<std::string> lines;
-		if (!buffer->get_lines(start_line, end_line, lines)) {
+		std::string out;
+		out.reserve(256 + (end_line > start_line ?
+				   (end_line - start_line) * 64 : 0));
+		out += "{\"success\":true,\"startLine\":";
+		out += std::to_string(start_line);
+		out += ",\"endLine\":";
+		out += std::to_string(end_line);
+		out += ",\"language\":\"";
+		out += language_name(language);
+		out += "\",\"lines\":[";
+
+		bool first = true;
+		bool ok;
+
+		if (want_tokens) {
+			/* 词法单元另外拼接，最后接在 lines 之后 */
+			std::string token_json = ",\"tokens\":[";
+			std::vector<SyntaxToken> columns;
+
+			ok = buffer->visit_tokens(start_line, end_line,
+				[&](size_t line, std::string_view text,
+				    std::span<const SyntaxToken> tokens) {
+					(void)line;
+					if (!first) {
+						out += ',';
+						token_json += ',';
+					}
+					first = false;
+
+					out += '"';
+					append_json_string(out, text);
+					out += '"';
+
+					syntax_tokens_to_utf16(text, tokens, columns);
+					token_json += '[';
+					for (size_t i = 0; i < columns.size(); i++) {
+						if (i > 0)
+							token_json += ',';
+						token_json += std::to_string(columns[i].start);
+						token_json += ',';
+						token_json += std::to_string(columns[i].length);
+						token_json += ',';
+						token_json += std::to_string(
+							static_cast<int>(columns[i].kind));
+					}
+					token_json += ']';
+				});
+
+			token_json += ']';
+			if (ok) {
+				out += ']';
+				out += token_json;
+				out += '}';
+			}
+		} else {
+			ok = buffer->visit_lines(start_line, end_line,
+				[this, &out, &first](size_t line,
+						     std::span<const std::string_view> fragments) {
+					(void)line;
+					if (!first)
+						out += ',';
+					first = false;
+
+					out += '"';
+					for (std::string_view fragment : fragments)
+						append_json_string(out, fragment);
+					out += '"';
+				});
+			if (ok)
+				out += "]}";
+		}
+
+		if (!ok) {
 			json result;
 			result["success"] = false;
 			result["error"] = "Failed to get lines";
-			response.body = result.dump();
-			return response;
-	}
-
-	/*
-		 * 返回结果
-		 */
-		json result;
-		result["success"] = true;
-		result["startLine"] = start_line;
-		result["endLine"] = end_line;
-		result["lines"] = json::array();
-		result["language"] = "plaintext";
-
-		for (const auto &line : lines) {
-			result["lines"].push_back(line);
+			response.body = result.dump();
+			return response;
 		}
 
-		response.body = result.dump();
+		response.body = std::move(out);
 
 	} catch (const std::exception &e) {
 		json result;
@@ -2537,10 +4569,10 @@ HttpResponse WebServer::handle_get_lines(
  * 获取当前打开文件的总行数。
  */
 HttpResponse WebServer::handle_get_line_count(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2563,18 +4595,14 @@ HttpResponse WebServer::handle_get_line_count(
 		/*
 		 * 获取 TextBuffer
 		 */
-		TextBuffer *buffer = nullptr;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it == text_buffers.end()) {
-				json result;
-				result["success"] = false;
-				result["error"] = "File not opened";
-				response.body = result.dump();
-				return response;
-			}
-			buffer = it->second;
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.find(file_path);
+		if (!buffer) {
+			json result;
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
 		}
 
 		/*
@@ -2585,6 +4613,7 @@ HttpResponse WebServer::handle_get_line_count(
 		json result;
 		result["success"] = true;
 		result["totalLines"] = line_count;
+		result["indexing"] = buffer->is_indexing();
 
 		response.body = result.dump();
 
@@ -2604,10 +4633,10 @@ HttpResponse WebServer::handle_get_line_count(
  * 在指定位置插入文本到 TextBuffer 中。
  */
 HttpResponse WebServer::handle_edit_insert(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2616,10 +4645,21 @@ HttpResponse WebServer::handle_edit_insert(
 	response.headers["Content-Type"] = "application/json";
 
 	try {
-		json request = json::parse(body);
-		std::string file_path = request["path"];
-		size_t position = request["position"];
-		std::string text = request["text"];
+		std::string file_path;
+		size_t position = 0;
+		std::string text;
+
+		JsonFields fields;
+		fields.bind("path", file_path);
+		fields.bind("position", position);
+		fields.bind("text", text);
+		if (!fields.parse(body)) {
+			json result;
+			result["success"] = false;
+			result["error"] = fields.error();
+			response.body = result.dump();
+			return response;
+		}
 
 		if (file_path.empty()) {
 			json result;
@@ -2632,18 +4672,14 @@ HttpResponse WebServer::handle_edit_insert(
 		/*
 		 * 获取 TextBuffer
 		 */
-		TextBuffer *buffer = nullptr;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it == text_buffers.end()) {
-				json result;
-				result["success"] = false;
-				result["error"] = "File not opened";
-				response.body = result.dump();
-				return response;
-			}
-			buffer = it->second;
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.acquire(file_path);
+		if (!buffer) {
+			json result;
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
 		}
 
 		/*
@@ -2682,10 +4718,10 @@ HttpResponse WebServer::handle_edit_insert(
  * 删除指定范围的文本。
  */
 HttpResponse WebServer::handle_edit_delete(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2710,18 +4746,14 @@ HttpResponse WebServer::handle_edit_delete(
 		/*
 		 * 获取 TextBuffer
 		 */
-		TextBuffer *buffer = nullptr;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it == text_buffers.end()) {
-				json result;
-				result["success"] = false;
-				result["error"] = "File not opened";
-				response.body = result.dump();
-				return response;
-			}
-			buffer = it->second;
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.acquire(file_path);
+		if (!buffer) {
+			json result;
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
 		}
 
 		/*
@@ -2760,10 +4792,10 @@ HttpResponse WebServer::handle_edit_delete(
  * 将指定范围的文本替换为新文本。
  */
 HttpResponse WebServer::handle_edit_replace(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2789,18 +4821,14 @@ HttpResponse WebServer::handle_edit_replace(
 		/*
 		 * 获取 TextBuffer
 		 */
-		TextBuffer *buffer = nullptr;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it == text_buffers.end()) {
-				json result;
-				result["success"] = false;
-				result["error"] = "File not opened";
-				response.body = result.dump();
-				return response;
-			}
-			buffer = it->second;
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.acquire(file_path);
+		if (!buffer) {
+			json result;
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
 		}
 
 		/*
@@ -2833,16 +4861,248 @@ HttpResponse WebServer::handle_edit_replace(
 	return response;
 }
 
+/**
+ * WebServer::handle_edit_undo - 撤销
+ */
+HttpResponse WebServer::handle_edit_undo(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+	return handle_edit_history(body, false);
+}
+
+/**
+ * WebServer::handle_edit_redo - 重做
+ */
+HttpResponse WebServer::handle_edit_redo(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+	return handle_edit_history(body, true);
+}
+
+/**
+ * WebServer::handle_edit_history - 撤销或重做虚拟文件的编辑
+ *
+ * 请求体：{ "path": "已打开的文件路径" }
+ * 没有可撤销（重做）的编辑时success为false。
+ */
+HttpResponse WebServer::handle_edit_history(const std::string &body, bool redo)
+{
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	try {
+		json request = json::parse(body);
+		std::string file_path = request["path"];
+
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.acquire(file_path);
+
+		json result;
+
+		if (!buffer) {
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
+		}
+
+		size_t cursor = 0;
+		const bool done = redo ? buffer->redo(cursor) :
+					 buffer->undo(cursor);
+
+		result["success"] = done;
+		if (done)
+			result["cursor"] = cursor;
+		else
+			result["error"] = redo ? "Nothing to redo" : "Nothing to undo";
+		result["newTotalLines"] = buffer->get_line_count();
+		result["canUndo"] = buffer->can_undo();
+		result["canRedo"] = buffer->can_redo();
+
+		response.body = result.dump();
+
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
+/**
+ * WebServer::handle_search_buffer - 在已打开的文件中搜索
+ *
+ * 请求体：{ "path": "已打开的文件路径", "query": "搜索内容",
+ *          "regex": false, "caseSensitive": false, "wholeWord": false,
+ *          "maxResults": 数量（可选） }
+ * 匹配的字段与 /api/search 的 results 事件相同。
+ */
+HttpResponse WebServer::handle_search_buffer(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	try {
+		json request = json::parse(body);
+		std::string file_path = request["path"];
+
+		SearchOptions options;
+		options.pattern = request.value("query", "");
+		options.regex = request.value("regex", false);
+		options.case_sensitive = request.value("caseSensitive", false);
+		options.whole_word = request.value("wholeWord", false);
+		size_t max_results = request.value("maxResults", (size_t)0);
+		if (max_results > 0)
+			options.max_results = max_results;
+
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.find(file_path);
+
+		json result;
+
+		if (!buffer) {
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
+		}
+
+		auto pattern = SearchPattern::compile(options);
+		if (!pattern.has_value()) {
+			result["success"] = false;
+			result["error"] = pattern.error();
+			response.body = result.dump();
+			return response;
+		}
+
+		/* 多找一个用于判断是否截断 */
+		std::vector<SearchMatch> matches;
+		pattern->search_buffer(*buffer, matches, options.max_results + 1);
+		const bool truncated = matches.size() > options.max_results;
+		if (truncated)
+			matches.pop_back();
+
+		json items = json::array();
+		for (const auto &match : matches) {
+			json item;
+			item["line"] = match.line;
+			item["column"] = match.column;
+			item["length"] = match.length;
+			item["offset"] = match.offset;
+			item["preview"] = match.preview;
+			item["previewColumn"] = match.preview_column;
+			items.push_back(std::move(item));
+		}
+
+		result["success"] = true;
+		result["matches"] = std::move(items);
+		result["truncated"] = truncated;
+
+		response.body = result.dump(-1, ' ', false,
+					    json::error_handler_t::replace);
+
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
+/**
+ * WebServer::handle_save_file_virtual - 保存虚拟文件
+ *
+ * 请求体：{ "path": "已打开的文件路径", "target": "另存为路径（可选）" }
+ * 另存为后 TextBuffer 仍以原路径登记，后续编辑和保存都针对原路径。
+ */
+HttpResponse WebServer::handle_save_file_virtual(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	try {
+		json request = json::parse(body);
+		std::string file_path = request["path"];
+		std::string target = request.value("target", file_path);
+
+		if (file_path.empty()) {
+			json result;
+			result["success"] = false;
+			result["error"] = "Path parameter is required";
+			response.body = result.dump();
+			return response;
+		}
+
+		std::shared_ptr<TextBuffer> buffer =
+			text_buffers.find(file_path);
+
+		json result;
+
+		if (!buffer) {
+			result["success"] = false;
+			result["error"] = "File not opened";
+			response.body = result.dump();
+			return response;
+		}
+
+		auto saved = buffer->save(target);
+		result["success"] = saved.has_value();
+
+		if (saved) {
+			file_manager->invalidate_path(target);
+			result["size"] = *saved;
+		} else {
+			result["error"] = saved.error();
+		}
+
+		response.body = result.dump();
+
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
 /**
  * WebServer::handle_close_file_virtual - 关闭虚拟文件
  *
  * 关闭并释放 TextBuffer 资源。
  */
 HttpResponse WebServer::handle_close_file_virtual(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2865,23 +5125,13 @@ HttpResponse WebServer::handle_close_file_virtual(
 		/*
 		 * 查找并删除 TextBuffer
 		 */
-		bool found = false;
-		{
-			std::lock_guard<std::mutex> lock(text_buffers_mutex);
-			auto it = text_buffers.find(file_path);
-			if (it != text_buffers.end()) {
-				delete it->second;
-				text_buffers.erase(it);
-				found = true;
-			}
-		}
+		bool found = text_buffers.erase(file_path);
 
 		json result;
 		result["success"] = found;
 
-		if (found) {
-			std::cout << "关闭虚拟文件: " << file_path << std::endl;
-		}
+		if (found)
+			log_debug("关闭虚拟文件: {}", file_path);
 
 		response.body = result.dump();
 
@@ -2899,10 +5149,10 @@ HttpResponse WebServer::handle_close_file_virtual(
  * WebServer::handle_terminal_get_output - 获取交互式进程的输出
  */
 HttpResponse WebServer::handle_terminal_get_output(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -2911,8 +5161,18 @@ HttpResponse WebServer::handle_terminal_get_output(
 	response.headers["Content-Type"] = "application/json";
 
 	try {
-		json request = json::parse(body);
-		pid_t pid = request["pid"];
+		pid_t pid = -1;
+
+		JsonFields fields;
+		fields.bind("pid", pid);
+		if (!fields.parse(body)) {
+			json result;
+			result["success"] = false;
+			result["error"] = fields.error();
+			result["is_running"] = false;
+			response.body = result.dump();
+			return response;
+		}
 
 		if (!terminal_manager) {
 			json result;
@@ -2966,10 +5226,10 @@ HttpResponse WebServer::handle_terminal_get_output(
  * WebServer::handle_terminal_send_input - 向交互式进程发送输入
  */
 HttpResponse WebServer::handle_terminal_send_input(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -3011,14 +5271,124 @@ HttpResponse WebServer::handle_terminal_send_input(
 	return response;
 }
 
+/**
+ * WebServer::handle_terminal_input_batch - 批量提交终端输入和尺寸变化
+ *
+ * 每个进程的事件按到达顺序应用：连续的输入拼接后只调用一次
+ * send_input()，连续的尺寸变化只应用最后一次；输入和尺寸变化交替
+ * 出现时，先完成前一种再开始后一种。一个进程出错后忽略它其余的
+ * 事件。
+ */
+HttpResponse WebServer::handle_terminal_input_batch(
+	const HttpQuery &query, const HttpHeaders &headers,
+	const std::string &body)
+{
+	(void)query;
+	(void)headers;
+
+	HttpResponse response;
+	response.status_code = 200;
+	response.status_text = "OK";
+	response.headers["Content-Type"] = "application/json";
+
+	/* 输入和尺寸变化不会同时待处理：一种到达时先完成另一种 */
+	struct PendingInput {
+		pid_t pid;
+		std::string input;	/* 尚未写入的输入 */
+		bool resize;		/* 有尚未应用的尺寸变化 */
+		TerminalSize size;
+		std::expected<void, std::string> status;
+	};
+
+	try {
+		json request = json::parse(body);
+
+		if (!terminal_manager) {
+			json result;
+			result["success"] = false;
+			result["error"] = "Terminal manager not initialized";
+			response.body = result.dump();
+			return response;
+		}
+
+		auto flush_input = [this](PendingInput &p) {
+			if (p.status.has_value() && !p.input.empty())
+				p.status = terminal_manager->send_input(p.pid, p.input);
+			p.input.clear();
+		};
+		auto apply_resize = [this](PendingInput &p) {
+			if (p.status.has_value() && p.resize)
+				p.status = terminal_manager->set_terminal_size(p.pid,
+									       p.size);
+			p.resize = false;
+		};
+
+		/* 进程数很少，按首次出现的顺序线性查找 */
+		std::vector<PendingInput> pending;
+		for (const json &event : request.at("events")) {
+			const pid_t pid = event.at("pid").get<pid_t>();
+
+			auto it = std::find_if(pending.begin(), pending.end(),
+					       [pid](const PendingInput &p) {
+						       return p.pid == pid;
+					       });
+			if (it == pending.end()) {
+				pending.push_back({ pid, "", false, TerminalSize(), {} });
+				it = pending.end() - 1;
+			}
+
+			if (auto input = event.find("input");
+			    input != event.end() && input->is_string()) {
+				apply_resize(*it);
+				it->input += input->get_ref<const std::string &>();
+			}
+
+			if (event.contains("cols") && event.contains("rows")) {
+				const int cols = event["cols"].get<int>();
+				const int rows = event["rows"].get<int>();
+				if (cols > 0 && rows > 0) {
+					flush_input(*it);
+					it->resize = true;
+					it->size = TerminalSize(cols, rows);
+				}
+			}
+		}
+
+		json results = json::array();
+		for (PendingInput &p : pending) {
+			apply_resize(p);
+			flush_input(p);
+
+			json item;
+			item["pid"] = p.pid;
+			item["success"] = p.status.has_value();
+			if (!p.status.has_value())
+				item["error"] = p.status.error();
+			results.push_back(std::move(item));
+		}
+
+		json result;
+		result["success"] = true;
+		result["results"] = std::move(results);
+		response.body = result.dump();
+	} catch (const std::exception &e) {
+		json result;
+		result["success"] = false;
+		result["error"] = e.what();
+		response.body = result.dump();
+	}
+
+	return response;
+}
+
 /**
  * WebServer::handle_terminal_kill_process - 终止交互式进程
  */
 HttpResponse WebServer::handle_terminal_kill_process(
-	const std::string &path, const std::map<std::string, std::string> &headers,
+	const HttpQuery &query, const HttpHeaders &headers,
 	const std::string &body)
 {
-	(void)path;
+	(void)query;
 	(void)headers;
 
 	HttpResponse response;
@@ -14,6 +14,7 @@
  */
 
 #include "../headers/window_manager.h"
+#include "../headers/startup_trace.h"
 #include <iostream>
 #include <format>
 
@@ -56,6 +57,7 @@ bool WindowManager::init(void)
 {
 	/* 初始化 GTK (GTK4: gtk_init 不再需要参数) */
 	gtk_init();
+	StartupTrace::instance().mark("gtk-init");
 
 	/* 创建主循环 */
 	main_loop = g_main_loop_new(nullptr, FALSE);
@@ -75,6 +77,7 @@ bool WindowManager::init(void)
 		main_loop = nullptr;
 		return false;
 	}
+	StartupTrace::instance().mark("web-view-created");
 
 	return true;
 }
@@ -195,12 +198,15 @@ bool WindowManager::create_web_view(void)
 /**
  * WindowManager::load_frontend_page - 加载前端页面
  *
+ * @port: Web服务器端口
+ *
  * 加载Web前端页面到WebView中。
- * 从本地Web服务器获取页面内容。
+ * 从本地Web服务器获取页面内容。服务器只监听127.0.0.1，直接使用
+ * IPv4地址，不先尝试localhost解析出的::1。
  */
-void WindowManager::load_frontend_page(void)
+void WindowManager::load_frontend_page(int port)
 {
-	std::string url = std::format("http://localhost:{}/", WEB_SERVER_PORT);
+	std::string url = std::format("http://127.0.0.1:{}/", port);
 	std::cout << std::format("正在加载前端页面: {}", url) << std::endl;
 	webkit_web_view_load_uri(web_view, url.c_str());
 }
@@ -357,7 +363,8 @@ gboolean WindowManager::on_window_close(GtkWidget *widget,
  * @load_event: 加载事件类型
  * @user_data: 用户数据（未使用）
  *
- * 处理WebView页面加载状态变化事件，记录加载过程。
+ * 处理WebView页面加载状态变化事件，记录加载过程。页面提交和加载
+ * 完成的时间记录到StartupTrace。
  */
 void WindowManager::on_web_view_load_changed(WebKitWebView *web_view,
 					     WebKitLoadEvent load_event,
@@ -367,12 +374,14 @@ void WindowManager::on_web_view_load_changed(WebKitWebView *web_view,
 
 	if (load_event == WEBKIT_LOAD_FINISHED) {
 		std::cout << "WebView 页面加载完成" << std::endl;
+		StartupTrace::instance().mark("web-view-load-finished");
 	} else if (load_event == WEBKIT_LOAD_STARTED) {
 		std::cout << "WebView 开始加载页面" << std::endl;
 	} else if (load_event == WEBKIT_LOAD_REDIRECTED) {
 		std::cout << "WebView 页面重定向" << std::endl;
 	} else if (load_event == WEBKIT_LOAD_COMMITTED) {
 		std::cout << "WebView 页面提交" << std::endl;
+		StartupTrace::instance().mark("web-view-committed");
 		const gchar *uri = webkit_web_view_get_uri(web_view);
 		if (uri)
 			std::cout << std::format("WebView URI: {}", uri) << std::endl;
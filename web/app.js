@@ -50,8 +50,12 @@ const AppState = {
     // 文件内容缓存（Map类型，用于存储未保存的内容）
     // 键：文件路径，值：文件内容
     contentCache: new Map(),
-    // 文件树数据（当前目录下的文件列表）
+    // 文件树数据（当前目录下已加载的文件列表）
     fileTree: [],
+    // 下一页的游标（null表示已全部加载）
+    fileTreeCursor: null,
+    // 当前目录的条目总数
+    fileTreeTotal: 0,
     // 右键菜单选中的项（文件或文件夹信息）
     contextSelected: null,
     // 新建对话框类型（'folder' 或 'file'）
@@ -68,7 +72,18 @@ const AppState = {
     terminalHistoryIndex: -1,     // 命令历史索引
     terminalHeight: 126,          // 终端高度（默认为6个行数高度）
     terminalCurrentPid: null,     // 当前活动进程的ID
-    terminalPollInterval: null,   // 轮询进程输出的定时器
+    terminalSize: null,           // 最近一次发给进程的终端尺寸 { pid, cols, rows }
+    terminalPollInterval: null,   // 轮询进程输出的定时器（推送不可用时的后备）
+    terminalEventSource: null,    // 进程输出推送连接
+    // 目录变化推送连接，连接正常时不再按命令猜测是否需要刷新
+    fileWatchSource: null,
+    fileWatchActive: false,
+    // 进行中的后台文件操作（{ id, type }），没有时为null
+    fileOperation: null,
+    // 推送不可用时查询文件操作进度的定时器
+    fileOperationPoll: null,
+    // 复制或剪切的项（{ path, name, cut }），没有时为null
+    fileClipboard: null,
     // 图标映射表（根据文件扩展名映射到对应的图标文件）
     // 键：文件扩展名，值：图标文件名
     iconMap: {
@@ -208,35 +223,43 @@ const BackendAPI = {
     },
 
     /**
-     * 获取指定目录下的文件列表
+     * 分页获取指定目录下的文件列表
      *
-     * 调用后端API获取指定目录下的所有文件和子目录
-     * 返回的文件列表包含每个文件/目录的详细信息
+     * 后端已按“目录在前、名称不区分大小写”排序，第一页的耗时与目录
+     * 大小无关（只对本页的文件取大小）
      *
      * @async
      * @param {string} path 要查询的目录路径（绝对路径）
-     * @returns {Promise<Array<Object>>} 文件列表数组，每个元素包含：
-     *   - name {string}: 文件或目录名称
-     *   - path {string}: 完整路径
-     *   - isDirectory {boolean}: 是否为目录
-     *   - size {number}: 文件大小（字节）
-     *   - modifiedTime {string}: 修改时间
-     * @throws {Error} 网络请求失败时抛出错误
+     * @param {string|null} cursor 上一页返回的nextCursor，null表示第一页
+     * @param {number} limit 每页条目数
+     * @returns {Promise<Object>} 分页结果，包含：
+     *   - files {Array<Object>}: 本页的文件列表，每个元素包含name、path、
+     *     isDirectory、size、mimeType、isBinary
+     *   - total {number}: 目录中的条目总数
+     *   - nextCursor {string|null}: 下一页的游标，没有更多时为null
      *
      * @example
-     * const files = await BackendAPI.getDirectoryContents('/home/user/project');
-     * files.forEach(file => {
+     * const page = await BackendAPI.getDirectoryPage('/home/user/project', null, 500);
+     * page.files.forEach(file => {
      *     console.log(file.name, file.isDirectory ? '目录' : '文件');
      * });
      */
-    async getDirectoryContents(path) {
+    async getDirectoryPage(path, cursor, limit) {
         try {
-            const response = await fetch(`/api/directory-contents?path=${encodeURIComponent(path)}`);
+            let url = `/api/directory-contents?path=${encodeURIComponent(path)}&limit=${limit}`;
+            if (cursor) {
+                url += `&cursor=${encodeURIComponent(cursor)}`;
+            }
+            const response = await fetch(url);
             const data = await response.json();
-            return data.files || [];
+            return {
+                files: data.files || [],
+                total: data.total || 0,
+                nextCursor: data.nextCursor || null
+            };
         } catch (error) {
             console.error('获取目录内容失败:', error);
-            return [];
+            return { files: [], total: 0, nextCursor: null };
         }
     },
 
@@ -286,12 +309,13 @@ const BackendAPI = {
      */
     async saveFile(path, content) {
         try {
-            const response = await fetch('/api/save-file', {
-                method: 'POST',
+            // 内容直接作为请求体，后端边接收边写入临时文件，收齐后原子替换
+            const response = await fetch('/api/upload-file?path=' + encodeURIComponent(path), {
+                method: 'PUT',
                 headers: {
-                    'Content-Type': 'application/json'
+                    'Content-Type': 'application/octet-stream'
                 },
-                body: JSON.stringify({ path, content })
+                body: content
             });
             const data = await response.json();
             return data.success || false;
@@ -403,6 +427,83 @@ const BackendAPI = {
         }
     },
 
+    /**
+     * 开始后台文件操作
+     *
+     * 操作在后端的线程池中执行，立即返回任务ID；进度通过目录变化推送的
+     * "operation" 事件到达，推送不可用时用getFileOperationStatus查询
+     *
+     * @async
+     * @param {string} type 操作类型：'delete'、'copy' 或 'move'
+     * @param {Array<string>} paths 要处理的文件或文件夹（绝对路径）
+     * @param {string} destination 复制或移动的目标目录（删除时忽略）
+     * @returns {Promise<Object>} 结果，包含success、id，失败时包含error
+     *
+     * @example
+     * const result = await BackendAPI.startFileOperation('delete', ['/home/user/project/node_modules']);
+     * if (result.success) {
+     *     console.log('任务ID:', result.id);
+     * }
+     */
+    async startFileOperation(type, paths, destination = '') {
+        try {
+            const response = await fetch('/api/file-operation', {
+                method: 'POST',
+                headers: {
+                    'Content-Type': 'application/json'
+                },
+                body: JSON.stringify({ type, paths, destination })
+            });
+            return await response.json();
+        } catch (error) {
+            console.error('开始文件操作失败:', error);
+            return { success: false, error: error.message };
+        }
+    },
+
+    /**
+     * 查询后台文件操作的进度
+     *
+     * @async
+     * @param {number} id 任务ID
+     * @returns {Promise<Object|null>} 进度（id、type、state、found、done、
+     *   bytes、errors、error、elapsedMs），任务不存在时返回null
+     */
+    async getFileOperationStatus(id) {
+        try {
+            const response = await fetch(`/api/file-operation-status?id=${id}`);
+            const data = await response.json();
+            return data.success ? data.operation : null;
+        } catch (error) {
+            console.error('查询文件操作进度失败:', error);
+            return null;
+        }
+    },
+
+    /**
+     * 取消后台文件操作
+     *
+     * @async
+     * @param {number} id 任务ID
+     * @returns {Promise<boolean>} 任务存在且未结束返回true
+     */
+    async cancelFileOperation(id) {
+        try {
+            const response = await fetch('/api/cancel-file-operation', {
+                method: 'POST',
+                headers: {
+                    'Content-Type': 'application/json'
+                },
+                body: JSON.stringify({ id })
+            });
+            const data = await response.json();
+            return data.success || false;
+        } catch (error) {
+            console.error('取消文件操作失败:', error);
+            return false;
+        }
+    },
+
     /**
      * 重命名文件或文件夹
      *
@@ -475,7 +576,7 @@ const BackendAPI = {
 /**
      * 保存所有打开的文件
      *
-     * 该方法将指定的文件内容列表发送到后端进行保存。
+     * 该方法将指定的文件内容列表逐个上传到后端保存。
      * 不再依赖contentCache，每次保存都接收完整的文件列表。
      *
      * @param {Array} files - 文件列表，每个元素是[路径, 内容]的数组
@@ -488,22 +589,11 @@ const BackendAPI = {
      * }
      */
     async saveAll(files) {
-        try {
-            const response = await fetch('/api/save-all', {
-                method: 'POST',
-                headers: {
-                    'Content-Type': 'application/json'
-                },
-                body: JSON.stringify({
-                    files: files
-                })
-            });
-            const data = await response.json();
-            return data.success || false;
-        } catch (error) {
-            console.error('保存所有文件失败:', error);
-            return false;
-        }
+        // 每个文件单独上传，后端并行处理，不需要把所有内容拼成一个JSON
+        const results = await Promise.all(
+            files.map(([path, content]) => this.saveFile(path, content))
+        );
+        return results.every(Boolean);
     },
 
     /**
@@ -640,30 +730,82 @@ const BackendAPI = {
     },
 
     /**
-     * 向交互式进程发送输入
+     * 订阅交互式进程的输出推送（Server-Sent Events）
+     *
+     * output 事件的 data 为 {output}，exit 事件表示进程已结束
      *
-     * @async
      * @param {number} pid 进程ID
-     * @param {string} input 输入内容
-     * @returns {Promise<Object>} 包含 success 的对象
+     * @returns {EventSource} 推送连接
+     */
+    openProcessStream(pid) {
+        return new EventSource(`/api/terminal-stream?pid=${encodeURIComponent(pid)}`);
+    },
+
+    /**
+     * 设置后端监视的目录
+     *
+     * 这些目录中的新增、删除、重命名、修改通过 openWatchStream() 推送
+     *
+     * @async
+     * @param {string[]} directories 目录路径列表，替换之前的设置
+     * @returns {Promise<boolean>} 设置成功返回true
      */
-    async sendProcessInput(pid, input) {
+    async watchDirectories(directories) {
         try {
-            const response = await fetch('/api/terminal-send-input', {
+            const response = await fetch('/api/watch-directories', {
                 method: 'POST',
                 headers: {
                     'Content-Type': 'application/json'
                 },
-                body: JSON.stringify({ pid, input })
+                body: JSON.stringify({ directories })
             });
             const data = await response.json();
-            return data;
+            return data.success || false;
         } catch (error) {
-            console.error('发送进程输入失败:', error);
-            return { success: false };
+            console.error('设置监视目录失败:', error);
+            return false;
         }
     },
 
+    /**
+     * 订阅目录变化推送（Server-Sent Events）
+     *
+     * changes 事件的 data 为 {changes: [...]}，每项的 type 为
+     * add/remove/rename/modify/rescan
+     *
+     * @returns {EventSource} 推送连接
+     */
+    openWatchStream() {
+        return new EventSource('/api/watch-stream');
+    },
+
+    /**
+     * 向交互式进程发送输入
+     *
+     * 同一帧内的输入合并到一次 /api/terminal-input-batch 请求中
+     *
+     * @param {number} pid 进程ID
+     * @param {string} input 输入内容
+     * @returns {Promise<Object>} 包含 success 的对象
+     */
+    sendProcessInput(pid, input) {
+        return TerminalInputBatch.push({ pid, input });
+    },
+
+    /**
+     * 设置交互式进程的终端尺寸
+     *
+     * 与输入一样按帧合并，拖动调整大小时每帧只应用最后一次尺寸
+     *
+     * @param {number} pid 进程ID
+     * @param {number} cols 列数
+     * @param {number} rows 行数
+     * @returns {Promise<Object>} 包含 success 的对象
+     */
+    resizeProcess(pid, cols, rows) {
+        return TerminalInputBatch.push({ pid, cols, rows });
+    },
+
     /**
      * 终止交互式进程
      *
@@ -688,6 +830,89 @@ const BackendAPI = {
         }
     }
 };
+
+/**
+ * 终端输入批量提交
+ *
+ * 按键、粘贴和尺寸变化先放入队列，下一帧时一次提交给后端，快速输入
+ * 不会变成大量的小请求。每个事件的 Promise 以所属进程的结果完成
+ *
+ * 同一时间只有一个请求在途：不同的 keep-alive 连接由后端不同的线程
+ * 处理，并发的两批可能后发先至，打乱输入顺序。上一批完成前到达的
+ * 事件留给下一批，上一批完成后再提交
+ */
+const TerminalInputBatch = {
+    // 等待提交的事件
+    events: [],
+    // 等待结果的回调，每项为 {pid, resolve}
+    waiters: [],
+    // 是否有等待提交的事件（已安排下一帧，或等上一批完成后提交）
+    scheduled: false,
+    // 是否有请求在途
+    sending: false,
+
+    /**
+     * 加入一个事件
+     *
+     * @param {Object} event {pid, input} 或 {pid, cols, rows}
+     * @returns {Promise<Object>} 包含 success 的对象
+     */
+    push(event) {
+        this.events.push(event);
+        const promise = new Promise(resolve => {
+            this.waiters.push({ pid: event.pid, resolve });
+        });
+
+        if (!this.scheduled) {
+            this.scheduled = true;
+            if (!this.sending) {
+                requestAnimationFrame(() => this.flush());
+            }
+        }
+        return promise;
+    },
+
+    /**
+     * 提交队列中的所有事件
+     *
+     * 完成后如果期间又有事件加入，安排下一帧提交下一批
+     *
+     * @async
+     */
+    async flush() {
+        const events = this.events;
+        const waiters = this.waiters;
+        this.events = [];
+        this.waiters = [];
+        this.scheduled = false;
+        this.sending = true;
+
+        let results = [];
+        try {
+            const response = await fetch('/api/terminal-input-batch', {
+                method: 'POST',
+                headers: {
+                    'Content-Type': 'application/json'
+                },
+                body: JSON.stringify({ events })
+            });
+            const data = await response.json();
+            results = data.results || [];
+        } catch (error) {
+            console.error('发送进程输入失败:', error);
+        }
+
+        for (const waiter of waiters) {
+            const result = results.find(r => r.pid === waiter.pid);
+            waiter.resolve(result || { success: false });
+        }
+
+        this.sending = false;
+        if (this.scheduled) {
+            requestAnimationFrame(() => this.flush());
+        }
+    }
+};
 // ============================================================================
 // DOM元素引用缓存
 // ============================================================================
@@ -735,8 +960,16 @@ const DOM = {
     // 右键菜单
     contextMenu: null,        // 右键菜单容器
     contextRename: null,      // 重命名菜单项
+    contextCopy: null,        // 复制菜单项
+    contextCut: null,         // 剪切菜单项
+    contextPaste: null,       // 粘贴菜单项
     contextDelete: null,      // 删除菜单项
 
+    // 后台文件操作进度
+    fileOperationStatus: null, // 进度容器
+    fileOperationText: null,   // 进度文本
+    fileOperationCancel: null, // 取消按钮
+
     // 新建对话框
     newDialog: null,          // 新建对话框容器
     newDialogTitle: null,     // 新建对话框标题
@@ -824,7 +1057,13 @@ function initDOM() {
     console.log('[initDOM] DOM.codeEditor 元素:', DOM.codeEditor);
     DOM.contextMenu = document.getElementById('context-menu');
     DOM.contextRename = document.getElementById('context-rename');
+    DOM.contextCopy = document.getElementById('context-copy');
+    DOM.contextCut = document.getElementById('context-cut');
+    DOM.contextPaste = document.getElementById('context-paste');
     DOM.contextDelete = document.getElementById('context-delete');
+    DOM.fileOperationStatus = document.getElementById('file-operation-status');
+    DOM.fileOperationText = document.getElementById('file-operation-text');
+    DOM.fileOperationCancel = document.getElementById('file-operation-cancel');
     DOM.newDialog = document.getElementById('new-dialog');
     DOM.newDialogTitle = document.getElementById('new-dialog-title');
     DOM.newDialogInput = document.getElementById('new-dialog-input');
@@ -918,11 +1157,104 @@ function hideMessageDialog() {
     DOM.messageDialog.style.display = 'none';
 }
 
+// 文件树每页加载的条目数
+const FILE_TREE_PAGE_SIZE = 500;
+
+/**
+ * 比较两个文件树条目，与后端的排序一致
+ *
+ * 目录在前，同类型按名称排序（ASCII字母不区分大小写，相同时按原样比较），
+ * 保证推送的增量条目与分页加载的条目顺序一致
+ *
+ * @param {Object} a 文件信息
+ * @param {Object} b 文件信息
+ * @returns {number} 比较结果
+ */
+function compareFileTreeEntries(a, b) {
+    if (a.isDirectory !== b.isDirectory) {
+        return a.isDirectory ? -1 : 1;
+    }
+
+    const length = Math.min(a.name.length, b.name.length);
+    for (let i = 0; i < length; i++) {
+        let ca = a.name.charCodeAt(i);
+        let cb = b.name.charCodeAt(i);
+        if (ca >= 65 && ca <= 90) ca += 32;
+        if (cb >= 65 && cb <= 90) cb += 32;
+        if (ca !== cb) {
+            return ca - cb;
+        }
+    }
+    if (a.name.length !== b.name.length) {
+        return a.name.length - b.name.length;
+    }
+    return a.name < b.name ? -1 : (a.name > b.name ? 1 : 0);
+}
+
+/**
+ * 创建一个文件树项
+ * @param {Object} file 文件信息
+ * @returns {HTMLElement} 文件树项元素
+ */
+function createFileTreeItem(file) {
+    const item = document.createElement('div');
+    item.className = 'file-tree-item' + (file.isDirectory ? ' directory' : '');
+    item.dataset.path = file.path;
+    item.dataset.name = file.name;
+    item.dataset.isDirectory = file.isDirectory;
+
+    // 如果是目录，添加展开按钮
+    if (file.isDirectory) {
+        const expandBtn = document.createElement('button');
+        expandBtn.className = 'file-tree-expand-btn';
+        expandBtn.innerHTML = `<img src="../Icons/Spread-out.png" alt="展开">`;
+        expandBtn.onclick = (e) => {
+            e.stopPropagation();
+            enterDirectory(file.path, file.name);
+        };
+        item.appendChild(expandBtn);
+    }
+
+    // LICENSE文件特殊处理
+    if (!file.isDirectory && file.name === 'LICENSE') {
+        const licenseBadge = document.createElement('img');
+        licenseBadge.className = 'license-badge';
+        licenseBadge.src = '../Icons/LICENSE-24.svg';
+        licenseBadge.alt = 'LICENSE';
+        item.appendChild(licenseBadge);
+    }
+
+    // 根据文件类型获取对应的图标
+    const icon = document.createElement('img');
+    icon.className = 'file-tree-icon';
+    icon.src = `../Icons/${getFileIcon(file.name, file.isDirectory)}`;
+    icon.alt = file.name;
+    item.appendChild(icon);
+
+    // 创建文件名显示元素
+    const name = document.createElement('span');
+    name.className = 'file-tree-name';
+    name.textContent = file.name;
+    item.appendChild(name);
+
+    // 绑定点击事件
+    item.onclick = () => handleFileItemClick(file);
+
+    // 绑定右键菜单事件
+    item.oncontextmenu = (e) => {
+        e.preventDefault();
+        showContextMenu(e, file);
+    };
+
+    return item;
+}
+
 /**
  * 渲染文件树
  *
- * 在文件树容器中渲染文件和文件夹列表
+ * 在文件树容器中渲染已加载的文件和文件夹列表
  * 使用DocumentFragment进行批量DOM操作，提高性能
+ * 还有未加载的条目时在末尾显示“加载更多”
  *
  * @param {Array<Object>} files 文件列表数组，每个元素包含：
  *   - name {string}: 文件或目录名称
@@ -941,84 +1273,27 @@ function renderFileTree(files) {
     // 清空文件树容器
     DOM.fileTree.innerHTML = '';
 
-    // 限制显示的文件数量，防止一次性渲染太多文件
-    const MAX_FILES_DISPLAY = 500;
-    const displayFiles = files.slice(0, MAX_FILES_DISPLAY);
-
-    // 如果文件数量超过限制，显示提示信息
-    if (files.length > MAX_FILES_DISPLAY) {
-        const warningDiv = document.createElement('div');
-        warningDiv.className = 'file-tree-warning';
-        warningDiv.textContent = `文件过多，仅显示前 ${MAX_FILES_DISPLAY} 个文件（共 ${files.length} 个）`;
-        warningDiv.style.cssText = 'padding: 10px; background: rgba(255, 152, 0, 0.2); color: #ff9800; font-size: 12px; text-align: center;';
-        DOM.fileTree.appendChild(warningDiv);
-    }
-
     // 排序规则：目录在前，文件在后，同类型按名称排序
-    const sortedFiles = displayFiles.sort((a, b) => {
-        if (a.isDirectory !== b.isDirectory) {
-            return a.isDirectory ? -1 : 1;
-        }
-        return a.name.localeCompare(b.name);
-    });
+    const sortedFiles = files.slice().sort(compareFileTreeEntries);
 
     // 使用DocumentFragment进行批量DOM操作
     const fragment = document.createDocumentFragment();
 
     // 遍历排序后的文件列表
     sortedFiles.forEach(file => {
-        const item = document.createElement('div');
-        item.className = 'file-tree-item' + (file.isDirectory ? ' directory' : '');
-        item.dataset.path = file.path;
-        item.dataset.name = file.name;
-        item.dataset.isDirectory = file.isDirectory;
-
-        // 如果是目录，添加展开按钮
-        if (file.isDirectory) {
-            const expandBtn = document.createElement('button');
-            expandBtn.className = 'file-tree-expand-btn';
-            expandBtn.innerHTML = `<img src="../Icons/Spread-out.png" alt="展开">`;
-            expandBtn.onclick = (e) => {
-                e.stopPropagation();
-                enterDirectory(file.path, file.name);
-            };
-            item.appendChild(expandBtn);
-        }
-
-        // LICENSE文件特殊处理
-        if (!file.isDirectory && file.name === 'LICENSE') {
-            const licenseBadge = document.createElement('img');
-            licenseBadge.className = 'license-badge';
-            licenseBadge.src = '../Icons/LICENSE-24.svg';
-            licenseBadge.alt = 'LICENSE';
-            item.appendChild(licenseBadge);
-        }
-
-        // 根据文件类型获取对应的图标
-        const icon = document.createElement('img');
-        icon.className = 'file-tree-icon';
-        icon.src = `../Icons/${getFileIcon(file.name, file.isDirectory)}`;
-        icon.alt = file.name;
-        item.appendChild(icon);
-
-        // 创建文件名显示元素
-        const name = document.createElement('span');
-        name.className = 'file-tree-name';
-        name.textContent = file.name;
-        item.appendChild(name);
-
-        // 绑定点击事件
-        item.onclick = () => handleFileItemClick(file);
-
-        // 绑定右键菜单事件
-        item.oncontextmenu = (e) => {
-            e.preventDefault();
-            showContextMenu(e, file);
-        };
-
-        fragment.appendChild(item);
+        fragment.appendChild(createFileTreeItem(file));
     });
 
+    // 还有下一页时显示加载更多
+    if (AppState.fileTreeCursor) {
+        const moreDiv = document.createElement('div');
+        moreDiv.className = 'file-tree-load-more';
+        moreDiv.textContent = `加载更多（已显示 ${files.length} / 共 ${AppState.fileTreeTotal} 项）`;
+        moreDiv.style.cssText = 'padding: 10px; background: rgba(255, 152, 0, 0.2); color: #ff9800; font-size: 12px; text-align: center; cursor: pointer;';
+        moreDiv.onclick = () => loadMoreDirectoryContents();
+        fragment.appendChild(moreDiv);
+    }
+
     // 一次性将所有文件树项添加到DOM中
     DOM.fileTree.appendChild(fragment);
 }
@@ -2167,9 +2442,18 @@ async function loadDirectoryContents(path) {
     console.log('正在加载目录内容:', path);
 
     try {
-        const files = await BackendAPI.getDirectoryContents(path);
-        console.log('获取到的文件列表:', files);
-        renderFileTree(files);
+        // 只加载第一页，其余的由“加载更多”按需加载
+        const page = await BackendAPI.getDirectoryPage(path, null, FILE_TREE_PAGE_SIZE);
+        console.log('获取到的文件列表:', page.files);
+        AppState.fileTree = page.files;
+        AppState.fileTreeCursor = page.nextCursor;
+        AppState.fileTreeTotal = page.total;
+        renderFileTree(page.files);
+
+        // 只监视当前显示的目录，之后的变化由推送增量更新
+        if (AppState.fileWatchSource) {
+            BackendAPI.watchDirectories([path]);
+        }
     } catch (error) {
         console.error('加载目录内容失败:', error);
     } finally {
@@ -2177,6 +2461,243 @@ async function loadDirectoryContents(path) {
     }
 }
 
+/**
+ * 加载当前目录的下一页
+ *
+ * 推送的增量可能已经加入了下一页中的条目，按路径去重
+ */
+async function loadMoreDirectoryContents() {
+    const path = AppState.currentPath;
+    const cursor = AppState.fileTreeCursor;
+    if (AppState.isLoading || !path || !cursor) {
+        return;
+    }
+
+    AppState.isLoading = true;
+
+    try {
+        const page = await BackendAPI.getDirectoryPage(path, cursor, FILE_TREE_PAGE_SIZE);
+
+        // 加载期间切换了目录
+        if (AppState.currentPath !== path) {
+            return;
+        }
+
+        const known = new Set(AppState.fileTree.map(file => file.path));
+        const files = AppState.fileTree.concat(page.files.filter(file => !known.has(file.path)));
+        AppState.fileTree = files;
+        AppState.fileTreeCursor = page.nextCursor;
+        AppState.fileTreeTotal = page.total;
+        renderFileTree(files);
+    } catch (error) {
+        console.error('加载更多目录内容失败:', error);
+    } finally {
+        AppState.isLoading = false;
+    }
+}
+
+/**
+ * 去掉目录路径末尾的斜杠，与后端推送的路径保持一致
+ * @param {string} path 目录路径
+ * @returns {string} 规范化后的路径
+ */
+function normalizeDirectoryPath(path) {
+    return path && path.length > 1 && path.endsWith('/') ? path.slice(0, -1) : path;
+}
+
+/**
+ * 订阅目录变化推送
+ *
+ * 连接（重连）成功后重新加载当前目录，保证断线期间的变化不会遗漏。
+ * 推送不可用时保持fileWatchActive为false，终端命令后退回到智能刷新。
+ */
+function startFileWatch() {
+    if (typeof EventSource === 'undefined' || AppState.fileWatchSource) {
+        return;
+    }
+
+    const source = BackendAPI.openWatchStream();
+    AppState.fileWatchSource = source;
+
+    source.onopen = () => {
+        AppState.fileWatchActive = true;
+        if (AppState.currentPath) {
+            loadDirectoryContents(AppState.currentPath);
+        }
+    };
+
+    source.addEventListener('changes', (event) => {
+        applyFileChanges(JSON.parse(event.data).changes);
+    });
+
+    source.addEventListener('operation', (event) => {
+        updateFileOperation(JSON.parse(event.data));
+    });
+
+    source.onerror = () => {
+        AppState.fileWatchActive = false;
+
+        // 后端没有监视器：不再重连
+        if (source.readyState === EventSource.CLOSED) {
+            AppState.fileWatchSource = null;
+        }
+    };
+}
+
+/**
+ * 把一批目录变化应用到当前显示的文件列表
+ *
+ * 所有操作都是幂等的：新增和修改按路径覆盖，删除不存在的项无影响。
+ *
+ * @param {Array<Object>} changes 后端推送的变化列表
+ */
+function applyFileChanges(changes) {
+    const current = normalizeDirectoryPath(AppState.currentPath);
+    if (!current) {
+        return;
+    }
+
+    let files = AppState.fileTree;
+    let changed = false;
+    let rescan = false;
+
+    const removePath = (path) => {
+        const next = files.filter(file => file.path !== path);
+        changed = changed || next.length !== files.length;
+        files = next;
+    };
+
+    const upsert = (change) => {
+        removePath(change.path);
+        files.push({
+            name: change.name,
+            path: change.path,
+            isDirectory: change.isDirectory,
+            size: change.size,
+            mimeType: change.mimeType,
+            isBinary: change.isBinary
+        });
+        changed = true;
+    };
+
+    for (const change of changes) {
+        // 当前目录自身被删除或移走
+        if (change.type === 'remove' && change.path === current) {
+            rescan = true;
+            continue;
+        }
+
+        if (change.type === 'rename' && change.oldDirectory === current) {
+            removePath(change.oldPath);
+        }
+
+        if (change.directory !== current) {
+            continue;
+        }
+
+        switch (change.type) {
+            case 'rescan':
+                rescan = true;
+                break;
+            case 'remove':
+                removePath(change.path);
+                break;
+            case 'add':
+            case 'modify':
+            case 'rename':
+                upsert(change);
+                break;
+        }
+    }
+
+    if (rescan) {
+        loadDirectoryContents(AppState.currentPath);
+    } else if (changed) {
+        AppState.fileTree = files;
+        renderFileTree(files);
+    }
+}
+
+/**
+ * 开始一个后台文件操作并显示进度
+ *
+ * 同一时间只跟踪一个操作；推送可用时进度由 "operation" 事件更新，
+ * 否则定时查询
+ *
+ * @param {string} type 操作类型：'delete'、'copy' 或 'move'
+ * @param {Array<string>} paths 要处理的文件或文件夹
+ * @param {string} destination 目标目录（删除时忽略）
+ * @returns {Promise<boolean>} 成功开始返回true
+ */
+async function runFileOperation(type, paths, destination = '') {
+    if (AppState.fileOperation) {
+        showMessage('请等待当前的文件操作完成', '提示');
+        return false;
+    }
+
+    const result = await BackendAPI.startFileOperation(type, paths, destination);
+    if (!result.success) {
+        showMessage(result.error || '文件操作失败', '错误');
+        return false;
+    }
+
+    AppState.fileOperation = { id: result.id, type };
+    DOM.fileOperationText.textContent = '正在准备…';
+    DOM.fileOperationCancel.disabled = false;
+    DOM.fileOperationStatus.style.display = 'flex';
+
+    if (!AppState.fileWatchActive) {
+        AppState.fileOperationPoll = setInterval(async () => {
+            const operation = await BackendAPI.getFileOperationStatus(result.id);
+            if (operation) {
+                updateFileOperation(operation);
+            }
+        }, 500);
+    }
+    return true;
+}
+
+/**
+ * 更新后台文件操作进度
+ *
+ * 操作结束时隐藏进度并重新加载当前目录（推送可能因积压被丢弃）
+ *
+ * @param {Object} operation 后端推送或查询到的进度
+ */
+function updateFileOperation(operation) {
+    const current = AppState.fileOperation;
+    if (!current || current.id !== operation.id) {
+        return;
+    }
+
+    const names = { delete: '删除', copy: '复制', move: '移动' };
+    const action = names[operation.type] || '处理';
+
+    if (operation.state === 'running') {
+        let text = `正在${action}：${operation.done} / ${operation.found} 项`;
+        if (operation.bytes > 0) {
+            text += `，${(operation.bytes / (1024 * 1024)).toFixed(1)} MB`;
+        }
+        DOM.fileOperationText.textContent = text;
+        return;
+    }
+
+    if (AppState.fileOperationPoll) {
+        clearInterval(AppState.fileOperationPoll);
+        AppState.fileOperationPoll = null;
+    }
+    AppState.fileOperation = null;
+    DOM.fileOperationStatus.style.display = 'none';
+
+    if (operation.state === 'failed') {
+        showMessage(`${action}失败（${operation.errors} 项）：${operation.error}`, '错误');
+    }
+
+    if (AppState.currentPath) {
+        loadDirectoryContents(AppState.currentPath);
+    }
+}
+
 /**
  * 显示右键菜单
  * @param {Event} event 事件对象
@@ -2582,6 +3103,9 @@ function initEventListeners() {
         toggleTerminal();
     };
 
+    // 窗口大小变化时终端的行列数也会变化
+    window.addEventListener('resize', () => syncTerminalSize());
+
     // 返回按钮
     DOM.btnBack.onclick = goBack;
     
@@ -2608,18 +3132,62 @@ function initEventListeners() {
         }
     };
     
+    DOM.contextCopy.onclick = () => {
+        if (!AppState.contextSelected) {
+            return;
+        }
+
+        const { path, name } = AppState.contextSelected;
+        AppState.fileClipboard = { path, name, cut: false };
+        hideContextMenu();
+    };
+
+    DOM.contextCut.onclick = () => {
+        if (!AppState.contextSelected) {
+            return;
+        }
+
+        const { path, name } = AppState.contextSelected;
+        AppState.fileClipboard = { path, name, cut: true };
+        hideContextMenu();
+    };
+
+    DOM.contextPaste.onclick = async () => {
+        hideContextMenu();
+
+        const clipboard = AppState.fileClipboard;
+        if (!clipboard || !AppState.currentPath) {
+            showMessage('没有复制或剪切的项', '提示');
+            return;
+        }
+
+        const started = await runFileOperation(clipboard.cut ? 'move' : 'copy',
+                                               [clipboard.path], AppState.currentPath);
+        // 剪切的项只能粘贴一次
+        if (started && clipboard.cut) {
+            AppState.fileClipboard = null;
+        }
+    };
+
+    // 删除在后台执行，大目录树不会阻塞界面
     DOM.contextDelete.onclick = async () => {
         if (!AppState.contextSelected) {
             return;
         }
-        
-        const success = await BackendAPI.deleteItem(AppState.contextSelected.path);
-        if (success) {
-            hideContextMenu();
-            await loadDirectoryContents(AppState.currentPath);
-        } else {
-            showMessage('删除失败', '错误');
+
+        const path = AppState.contextSelected.path;
+        hideContextMenu();
+        await runFileOperation('delete', [path]);
+    };
+
+    DOM.fileOperationCancel.onclick = async () => {
+        if (!AppState.fileOperation) {
+            return;
         }
+
+        DOM.fileOperationCancel.disabled = true;
+        DOM.fileOperationText.textContent = '正在取消…';
+        await BackendAPI.cancelFileOperation(AppState.fileOperation.id);
     };
     
     // 新建对话框事件
@@ -3270,6 +3838,7 @@ function init() {
     console.log('[init] DOM初始化完成');
     initEventListeners();
     console.log('[init] 事件监听器初始化完成');
+    startFileWatch();
 
     // 显示了解页面
     showAboutPage();
@@ -3287,6 +3856,24 @@ function init() {
     console.log('[init] 标签页渲染完成');
 
     console.log('Mikufy v2.11-nova 初始化完成');
+
+    reportStartupInteractive();
+}
+
+/**
+ * reportStartupInteractive - 上报前端可以交互的时间
+ *
+ * 初始化后的第一帧绘制完成时即可交互，通知后端结束启动耗时跟踪
+ * （结果写入日志，也可以从 /api/startup-trace 查询）。
+ */
+function reportStartupInteractive() {
+    requestAnimationFrame(() => {
+        fetch('/api/startup-trace', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/json' },
+            body: JSON.stringify({ mark: 'interactive', finish: true })
+        }).catch(() => {});
+    });
 }
 
 /**
@@ -3775,7 +4362,7 @@ async function handleTerminalInput(event) {
             }
 
             // 如果命令需要刷新文件树，使用智能刷新
-            if (result.success && result.should_refresh) {
+            if (result.success && result.should_refresh && !AppState.fileWatchActive) {
                 // 使用后端返回的should_refresh标志
                 await smartRefresh(command, AppState.terminalPath);
             }
@@ -3799,6 +4386,7 @@ async function handleTerminalInput(event) {
             // 如果是交互式进程，启动轮询
             if (result.interactive && result.pid) {
                 AppState.terminalCurrentPid = result.pid;
+                syncTerminalSize();
                 startPollingProcess(result.pid);
                 
                 // 滚动到底部
@@ -3900,6 +4488,7 @@ function initTerminalResize() {
 
             DOM.terminalView.style.height = `${newHeight}px`;
             AppState.terminalHeight = newHeight;
+            syncTerminalSize();
 
             animationFrameId = null;
         });
@@ -3925,11 +4514,143 @@ function initTerminalResize() {
 }
 
 /**
- * 开始轮询交互式进程的输出
+ * 把终端区域的行列数同步给当前的交互式进程
+ *
+ * 按终端内容区域的字体和行高计算行列数，与上次发送的相同时不发送。
+ * 拖动调整大小时每帧最多调用一次，发送由 TerminalInputBatch 合并
+ */
+function syncTerminalSize() {
+    const pid = AppState.terminalCurrentPid;
+    const content = DOM.terminalContent;
+    if (!pid || !content) {
+        return;
+    }
+
+    const style = getComputedStyle(content);
+    const width = content.clientWidth -
+        parseFloat(style.paddingLeft) - parseFloat(style.paddingRight);
+    const height = content.clientHeight -
+        parseFloat(style.paddingTop) - parseFloat(style.paddingBottom);
+
+    // 等宽字体，用一段字符的平均宽度计算列数
+    const probe = document.createElement('span');
+    probe.style.position = 'absolute';
+    probe.style.visibility = 'hidden';
+    probe.style.whiteSpace = 'pre';
+    probe.textContent = 'M'.repeat(16);
+    content.appendChild(probe);
+    const charWidth = probe.getBoundingClientRect().width / 16;
+    probe.remove();
+    const lineHeight = parseFloat(style.lineHeight) || 21;
+
+    const cols = Math.floor(width / charWidth);
+    const rows = Math.floor(height / lineHeight);
+    if (!(cols > 0) || !(rows > 0)) {
+        // 终端隐藏时没有尺寸
+        return;
+    }
+
+    const last = AppState.terminalSize;
+    if (last && last.pid === pid && last.cols === cols && last.rows === rows) {
+        return;
+    }
+
+    AppState.terminalSize = { pid, cols, rows };
+    BackendAPI.resizeProcess(pid, cols, rows);
+}
+
+/**
+ * 显示交互式进程的一段输出
+ *
+ * @param {string} output 输出内容
+ */
+function appendProcessOutput(output) {
+    if (!output || !output.trim()) {
+        return;
+    }
+
+    const outputLine = document.createElement('div');
+    outputLine.className = 'terminal-output-line';
+    outputLine.textContent = output;
+    DOM.terminalContent.appendChild(outputLine);
+
+    // 滚动到底部
+    DOM.terminalContent.scrollTop = DOM.terminalContent.scrollHeight;
+}
+
+/**
+ * 交互式进程结束后的处理
+ */
+function finishProcess() {
+    stopPollingProcess();
+
+    // 不显示进程结束信息，直接创建新的提示符行
+    // const endLine = document.createElement('div');
+    // endLine.className = 'terminal-output-line';
+    // endLine.style.color = '#888';
+    // endLine.textContent = `Process ${pid} exited`;
+    // DOM.terminalContent.appendChild(endLine);
+
+    // 清空当前进程ID
+    AppState.terminalCurrentPid = null;
+
+    // 创建新的提示符行
+    displayNewPrompt();
+}
+
+/**
+ * 开始接收交互式进程的输出
+ *
+ * 优先使用后端推送（输出一产生就到达，进程空闲时没有请求），
+ * 断线后自动续传，推送不可用时退回到每100ms轮询一次。
  *
  * @param {number} pid 进程ID
  */
 async function startPollingProcess(pid) {
+    // 关闭旧的推送连接和轮询定时器
+    stopPollingProcess();
+
+    if (typeof EventSource === 'undefined') {
+        startPollingProcessFallback(pid);
+        return;
+    }
+
+    const source = BackendAPI.openProcessStream(pid);
+    AppState.terminalEventSource = source;
+
+    source.addEventListener('output', (event) => {
+        appendProcessOutput(JSON.parse(event.data).output);
+    });
+
+    source.addEventListener('exit', () => {
+        finishProcess();
+    });
+
+    source.onerror = () => {
+        // 连接被替换或已关闭时不再处理
+        if (AppState.terminalEventSource !== source) {
+            return;
+        }
+
+        // 连接暂时中断：浏览器会带上Last-Event-ID自动重连，
+        // 后端从断开处继续推送，输出不会丢失
+        if (source.readyState === EventSource.CONNECTING) {
+            return;
+        }
+
+        // 推送被拒绝（如进程已被清理）：改用轮询取完剩余输出
+        source.close();
+        AppState.terminalEventSource = null;
+        startPollingProcessFallback(pid);
+    };
+}
+
+/**
+ * 轮询交互式进程的输出（推送不可用时的后备方式）
+ *
+ * @param {number} pid 进程ID
+ */
+function startPollingProcessFallback(pid) {
     // 清除旧的轮询定时器
     if (AppState.terminalPollInterval) {
         clearInterval(AppState.terminalPollInterval);
@@ -3939,42 +4660,27 @@ async function startPollingProcess(pid) {
     // 每隔100ms轮询一次
     AppState.terminalPollInterval = setInterval(async () => {
         const result = await BackendAPI.getProcessOutput(pid);
-        
-        if (result.success && result.output && result.output.trim()) {
-            // 显示输出
-            const outputLine = document.createElement('div');
-            outputLine.className = 'terminal-output-line';
-            outputLine.textContent = result.output;
-            DOM.terminalContent.appendChild(outputLine);
-            
-            // 滚动到底部
-            DOM.terminalContent.scrollTop = DOM.terminalContent.scrollHeight;
+
+        if (result.success) {
+            appendProcessOutput(result.output);
         }
 
         // 如果进程已结束，停止轮询
         if (!result.is_running) {
-            stopPollingProcess();
-            
-            // 不显示进程结束信息，直接创建新的提示符行
-            // const endLine = document.createElement('div');
-            // endLine.className = 'terminal-output-line';
-            // endLine.style.color = '#888';
-            // endLine.textContent = `Process ${pid} exited`;
-            // DOM.terminalContent.appendChild(endLine);
-            
-            // 清空当前进程ID
-            AppState.terminalCurrentPid = null;
-            
-            // 创建新的提示符行
-            displayNewPrompt();
+            finishProcess();
         }
     }, 100);
 }
 
 /**
- * 停止轮询交互式进程的输出
+ * 停止接收交互式进程的输出
  */
 function stopPollingProcess() {
+    if (AppState.terminalEventSource) {
+        AppState.terminalEventSource.close();
+        AppState.terminalEventSource = null;
+    }
+
     if (AppState.terminalPollInterval) {
         clearInterval(AppState.terminalPollInterval);
         AppState.terminalPollInterval = null;
@@ -17,6 +17,25 @@
  * 版本：v2.11-nova
  */
 
+// ============================================================================
+// 常量定义
+// ============================================================================
+
+// /api/get-lines 二进制行帧（与 headers/web_server.h 保持一致）
+const LINES_FRAME_MIME = 'application/x-mikufy-lines';
+const LINES_FRAME_MAGIC = 0x4e4c4b4d; // "MKLN"
+const LINES_FRAME_TOKEN_KIND_BITS = 4;
+
+// 词法单元类型（SyntaxTokenKind）对应的颜色
+const TOKEN_COLORS = {
+	1: '#6a9955',   // 注释
+	2: '#ce9178',   // 字符串
+	3: '#b5cea8',   // 数字
+	4: '#569cd6',   // 关键字
+	5: '#c586c0'    // 预处理指令
+};
+const TEXT_COLOR = '#ffffff';
+
 // ============================================================================
 // 高性能虚拟编辑器类
 // ============================================================================
@@ -55,8 +74,11 @@ class VirtualEditor {
 		this.startLine = 0;           // 可见区域起始行
 		this.endLine = 0;             // 可见区域结束行
 		this.visibleLines = [];       // 可见行内容
+		this.visibleTokens = [];      // 可见行的词法单元（每行 [起始列, 长度, 类型, ...]）
+		this.language = 'plaintext';  // 语法高亮的语言
 		this.isScrolling = false;     // 是否正在滚动
 		this.renderScheduled = false; // 是否已调度渲染
+		this.textDecoder = new TextDecoder('utf-8'); // 行帧解码器
 
 		// 创建 DOM 结构
 		this.createDOM();
@@ -240,29 +262,39 @@ class VirtualEditor {
 		}
 
 		try {
-			// 从后端获取行数据
+			// 从后端获取行数据（优先请求二进制行帧，省去 JSON 编解码）
 			const response = await fetch('/api/get-lines', {
 				method: 'POST',
 				headers: {
-					'Content-Type': 'application/json'
+					'Content-Type': 'application/json',
+					'Accept': `${LINES_FRAME_MIME}, application/json`
 				},
 				body: JSON.stringify({
 					path: this.currentFile,
 					start_line: this.startLine,
-					end_line: this.endLine
+					end_line: this.endLine,
+					tokens: this.language !== 'plaintext'
 				})
 			});
 
-			const data = await response.json();
-
-			if (!data.success) {
-				console.error('Failed to get lines:', data.error);
-				return;
+			const contentType = response.headers.get('Content-Type') || '';
+			if (contentType.startsWith(LINES_FRAME_MIME)) {
+				const frame = this.decodeLinesFrame(await response.arrayBuffer());
+				this.visibleLines = frame.lines;
+				this.visibleTokens = frame.tokens;
+			} else {
+				const data = await response.json();
+
+				if (!data.success) {
+					console.error('Failed to get lines:', data.error);
+					return;
+				}
+
+				this.visibleLines = data.lines;
+				this.visibleTokens = data.tokens || [];
+				this.language = data.language;
 			}
 
-			this.visibleLines = data.lines;
-			this.language = data.language;
-
 			// 更新 spacer 高度
 			this.spacer.style.height = `${this.totalLines * this.config.lineHeight}px`;
 
@@ -280,6 +312,56 @@ class VirtualEditor {
 		}
 	}
 
+	/**
+	 * 解码二进制行帧
+	 *
+	 * 帧格式见 headers/web_server.h 中的 LINES_FRAME_MIME：
+	 * 16 字节帧头、4 字节对齐的文本区、n + 1 项 uint32 偏移表，
+	 * 之后可能还有词法单元区（n + 1 项索引和每个两项的词法单元）。
+	 * 返回 { lines, tokens }，tokens 的格式与 JSON 响应相同。
+	 */
+	decodeLinesFrame(buffer) {
+		const view = new DataView(buffer);
+		if (buffer.byteLength < 16 || view.getUint32(0, true) !== LINES_FRAME_MAGIC) {
+			throw new Error('Invalid lines frame');
+		}
+
+		const count = view.getUint32(8, true);
+		const textLength = view.getUint32(12, true);
+		const text = new Uint8Array(buffer, 16, textLength);
+		const tableOffset = 16 + Math.ceil(textLength / 4) * 4;
+
+		const lines = new Array(count);
+		let start = view.getUint32(tableOffset, true);
+		for (let i = 0; i < count; i++) {
+			const end = view.getUint32(tableOffset + (i + 1) * 4, true);
+			lines[i] = start === end ? '' : this.textDecoder.decode(text.subarray(start, end));
+			start = end;
+		}
+
+		const tokens = [];
+		const indexOffset = tableOffset + (count + 1) * 4;
+		if (buffer.byteLength > indexOffset) {
+			const wordsOffset = indexOffset + (count + 1) * 4;
+			let first = view.getUint32(indexOffset, true);
+			for (let i = 0; i < count; i++) {
+				const last = view.getUint32(indexOffset + (i + 1) * 4, true);
+				const spans = new Array((last - first) * 3);
+				for (let t = first; t < last; t++) {
+					const packed = view.getUint32(wordsOffset + t * 8 + 4, true);
+					const k = (t - first) * 3;
+					spans[k] = view.getUint32(wordsOffset + t * 8, true);
+					spans[k + 1] = packed >>> LINES_FRAME_TOKEN_KIND_BITS;
+					spans[k + 2] = packed & ((1 << LINES_FRAME_TOKEN_KIND_BITS) - 1);
+				}
+				tokens.push(spans);
+				first = last;
+			}
+		}
+
+		return { lines, tokens };
+	}
+
 	/**
 	 * 清空 Canvas
 	 */
@@ -321,22 +403,54 @@ class VirtualEditor {
 		const charWidth = this.config.charWidth;
 
 		// 设置样式
-		ctx.fillStyle = '#ffffff';
+		ctx.fillStyle = TEXT_COLOR;
 		ctx.font = `${this.config.fontSize}px ${this.config.fontFamily}`;
 		ctx.textAlign = 'left';
 		ctx.textBaseline = 'top';
 
-		// 绘制每一行的文本
+		// 绘制每一行的文本（Canvas 直接绘制原文，不需要转义）
 		for (let i = 0; i < this.visibleLines.length; i++) {
 			const line = this.visibleLines[i];
 			const y = (i * lineHeight) - (this.startLine * lineHeight) + this.scrollTop;
 
 			if (y >= -lineHeight && y <= this.height) {
-				// 转义 HTML 特殊字符
-				const escapedLine = this.escapeHTML(line);
-				ctx.fillText(escapedLine, 0, y);
+				const spans = this.visibleTokens[i];
+				if (spans && spans.length > 0) {
+					this.drawTokenizedLine(ctx, line, spans, y);
+				} else {
+					ctx.fillText(line, 0, y);
+				}
+			}
+		}
+	}
+
+	/**
+	 * 按词法单元分段绘制一行
+	 *
+	 * 词法单元之间的文本用默认颜色，每段的宽度用 measureText 累加，
+	 * 与整行绘制时的字形位置一致。
+	 */
+	drawTokenizedLine(ctx, line, spans, y) {
+		let x = 0;
+		let pos = 0;
+
+		const drawSegment = (end, color) => {
+			if (end <= pos) {
+				return;
 			}
+			const segment = line.slice(pos, end);
+			ctx.fillStyle = color;
+			ctx.fillText(segment, x, y);
+			x += ctx.measureText(segment).width;
+			pos = end;
+		};
+
+		for (let k = 0; k < spans.length; k += 3) {
+			drawSegment(spans[k], TEXT_COLOR);
+			drawSegment(spans[k] + spans[k + 1], TOKEN_COLORS[spans[k + 2]] || TEXT_COLOR);
 		}
+		drawSegment(line.length, TEXT_COLOR);
+		ctx.fillStyle = TEXT_COLOR;
 	}
 
 	/**
@@ -389,6 +503,11 @@ class VirtualEditor {
 			// 调度渲染
 			this.scheduleRender();
 
+			// 大文件的完整行数由后端异步统计
+			if (data.indexing) {
+				this.pollLineCount(filePath);
+			}
+
 			console.log(`File opened: ${filePath}, Lines: ${this.totalLines}`);
 			return true;
 
@@ -398,6 +517,81 @@ class VirtualEditor {
 		}
 	}
 
+	/**
+	 * 轮询后台索引进度，直到总行数确定
+	 * @filePath - 正在索引的文件路径
+	 */
+	async pollLineCount(filePath) {
+		while (this.currentFile === filePath) {
+			await new Promise(resolve => setTimeout(resolve, 200));
+
+			try {
+				const response = await fetch('/api/get-line-count', {
+					method: 'POST',
+					headers: {
+						'Content-Type': 'application/json'
+					},
+					body: JSON.stringify({
+						path: filePath
+					})
+				});
+
+				const data = await response.json();
+
+				if (!data.success || this.currentFile !== filePath) {
+					return;
+				}
+
+				this.totalLines = data.totalLines;
+				this.spacer.style.height = `${this.totalLines * this.config.lineHeight}px`;
+				this.updateVisibleRange();
+				this.scheduleRender();
+
+				if (!data.indexing) {
+					return;
+				}
+			} catch (error) {
+				console.error('Poll line count error:', error);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * 保存文件
+	 *
+	 * 内容由后端的 TextBuffer 直接写入磁盘，不经过前端
+	 * @targetPath - 另存为的路径（可选，默认保存到当前文件）
+	 * @returns {Promise<boolean>} 保存成功返回 true
+	 */
+	async saveFile(targetPath) {
+		if (!this.currentFile) {
+			return false;
+		}
+
+		try {
+			const response = await fetch('/api/save-file-virtual', {
+				method: 'POST',
+				headers: {
+					'Content-Type': 'application/json'
+				},
+				body: JSON.stringify({
+					path: this.currentFile,
+					target: targetPath || this.currentFile
+				})
+			});
+			const data = await response.json();
+			if (!data.success) {
+				console.error('Save file error:', data.error);
+			}
+			return data.success || false;
+
+		} catch (error) {
+			console.error('Save file error:', error);
+			return false;
+		}
+	}
+
 	/**
 	 * 关闭文件
 	 */
@@ -422,6 +616,7 @@ class VirtualEditor {
 			this.currentFile = null;
 			this.totalLines = 0;
 			this.visibleLines = [];
+			this.visibleTokens = [];
 
 			// 清空 Canvas
 			this.clearCanvas();